@@ -0,0 +1,135 @@
+#include "stdafx.h"
+#include "AcRxValueArray.h"
+
+#include <new>
+
+namespace acad_sheetset_to_pdf {
+
+AcRxValueArray::AcRxValueArray()
+    : m_reserved(0)
+{
+}
+
+AcRxValueArray::AcRxValueArray(const AcRxValueArray& other)
+    : m_pColumn(other.m_pColumn != nullptr ? other.m_pColumn->clone() : nullptr),
+      m_values(other.m_values),
+      m_reserved(other.m_reserved)
+{
+}
+
+AcRxValueArray::AcRxValueArray(AcRxValueArray&& other) = default;
+
+AcRxValueArray::~AcRxValueArray()
+{
+}
+
+AcRxValueArray& AcRxValueArray::operator=(const AcRxValueArray& other)
+{
+    if (this != &other)
+        *this = AcRxValueArray(other);
+    return *this;
+}
+
+AcRxValueArray& AcRxValueArray::operator=(AcRxValueArray&& other) = default;
+
+const AcRxValueType& AcRxValueArray::type() const
+{
+    return m_pColumn != nullptr ? m_pColumn->type() : AcRxValueType::Desc<void>::value();
+}
+
+Acad::ErrorStatus AcRxValueArray::reserve(size_t count)
+{
+    try
+    {
+        if (m_pColumn != nullptr)
+            m_pColumn->reserve(count);
+        else if (m_values.empty())
+            m_reserved = count;
+        else
+            m_values.reserve(count);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return Acad::eOutOfMemory;
+    }
+    return Acad::eOk;
+}
+
+void AcRxValueArray::clear()
+{
+    m_pColumn.reset();
+    m_values.clear();
+    m_reserved = 0;
+}
+
+Acad::ErrorStatus AcRxValueArray::append(const AcRxValue& value)
+{
+    try
+    {
+        if (m_pColumn == nullptr && m_values.empty())
+            m_pColumn.reset(newColumn(value));
+        if (m_pColumn != nullptr)
+        {
+            if (m_pColumn->append(value))
+                return Acad::eOk;
+            spill(1);
+        }
+        m_values.push_back(value);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return Acad::eOutOfMemory;
+    }
+    return Acad::eOk;
+}
+
+/* The column for values of the type of value, or null if it has none.  The
+most common types first, as in PropertyWriter::add: every miss is a
+comparison of type descriptors. */
+AcRxValueArray::Column* AcRxValueArray::newColumn(const AcRxValue& value) const
+{
+    if (rxvalue_cast<double>(&value) != nullptr)
+        return newColumn<double>();
+    if (rxvalue_cast<Adesk::Int32>(&value) != nullptr)
+        return newColumn<Adesk::Int32>();
+    if (rxvalue_cast<AcGePoint3d>(&value) != nullptr)
+        return newColumn<AcGePoint3d>();
+    if (rxvalue_cast<AcDbObjectId>(&value) != nullptr)
+        return newColumn<AcDbObjectId>();
+    if (rxvalue_cast<Adesk::Int64>(&value) != nullptr)
+        return newColumn<Adesk::Int64>();
+    if (rxvalue_cast<AcCmColor>(&value) != nullptr)
+        return newColumn<AcCmColor>();
+    if (rxvalue_cast<AcGeVector3d>(&value) != nullptr)
+        return newColumn<AcGeVector3d>();
+    if (rxvalue_cast<AcGeMatrix3d>(&value) != nullptr)
+        return newColumn<AcGeMatrix3d>();
+    if (rxvalue_cast<Adesk::Int16>(&value) != nullptr)
+        return newColumn<Adesk::Int16>();
+    if (rxvalue_cast<Adesk::UInt16>(&value) != nullptr)
+        return newColumn<Adesk::UInt16>();
+    if (rxvalue_cast<Adesk::UInt32>(&value) != nullptr)
+        return newColumn<Adesk::UInt32>();
+    if (rxvalue_cast<Adesk::UInt64>(&value) != nullptr)
+        return newColumn<Adesk::UInt64>();
+    if (rxvalue_cast<float>(&value) != nullptr)
+        return newColumn<float>();
+    if (rxvalue_cast<AcGePoint2d>(&value) != nullptr)
+        return newColumn<AcGePoint2d>();
+    return nullptr;
+}
+
+/* Turns the column into AcRxValues, with room for extra more, leaving the
+array as it was if that runs out of memory. */
+void AcRxValueArray::spill(size_t extra)
+{
+    const size_t length = m_pColumn->length();
+    std::vector<AcRxValue> values;
+    values.reserve(length + extra);
+    for (size_t i = 0; i < length; ++i)
+        values.push_back(m_pColumn->at(i));
+    m_values.swap(values);
+    m_pColumn.reset();
+}
+
+} // namespace acad_sheetset_to_pdf
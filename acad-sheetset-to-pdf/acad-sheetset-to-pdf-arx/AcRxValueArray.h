@@ -0,0 +1,253 @@
+#pragma once
+
+#include <type_traits>
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// The column an AcRxValueArray keeps values of type T in, or 0 for the
+/// types it keeps as AcRxValues: bool, strings and anything not listed.
+/// </summary>
+template<class T> struct AcRxValueColumn { enum { kind = 0 }; };
+template<> struct AcRxValueColumn<Adesk::Int16> { enum { kind = 1 }; };
+template<> struct AcRxValueColumn<Adesk::Int32> { enum { kind = 2 }; };
+template<> struct AcRxValueColumn<Adesk::Int64> { enum { kind = 3 }; };
+template<> struct AcRxValueColumn<Adesk::UInt16> { enum { kind = 4 }; };
+template<> struct AcRxValueColumn<Adesk::UInt32> { enum { kind = 5 }; };
+template<> struct AcRxValueColumn<Adesk::UInt64> { enum { kind = 6 }; };
+template<> struct AcRxValueColumn<float> { enum { kind = 7 }; };
+template<> struct AcRxValueColumn<double> { enum { kind = 8 }; };
+template<> struct AcRxValueColumn<AcGePoint2d> { enum { kind = 9 }; };
+template<> struct AcRxValueColumn<AcGePoint3d> { enum { kind = 10 }; };
+template<> struct AcRxValueColumn<AcGeVector3d> { enum { kind = 11 }; };
+template<> struct AcRxValueColumn<AcGeMatrix3d> { enum { kind = 12 }; };
+template<> struct AcRxValueColumn<AcCmColor> { enum { kind = 13 }; };
+template<> struct AcRxValueColumn<AcDbObjectId> { enum { kind = 14 }; };
+
+/// <summary>
+/// An array of AcRxValues that stores them by type rather than one by one.
+///
+/// As long as every value appended has the same type, and that type has an
+/// AcRxValueColumn, the values are kept unwrapped in a single std::vector
+/// of that type: 8 bytes per double rather than the 32 of an AcRxValue, and
+/// no heap block per value for the types an AcRxValue boxes, such as
+/// AcGeMatrix3d and AcCmColor.  data() then gives the column itself, for
+/// reading or editing every value in one loop.  The first value of another
+/// type turns the array into a plain vector of AcRxValues, once, and it
+/// stays one until cleared.
+///
+/// cast() is rxvalue_cast for an element, and at() makes the AcRxValue of
+/// one, boxing it if its type calls for that.  Pointers returned by cast()
+/// and data() stay valid only until the next append.  An array is not
+/// thread safe, except that any number of threads may read one that no
+/// thread is changing.
+/// </summary>
+class AcRxValueArray
+{
+public:
+    AcRxValueArray();
+    AcRxValueArray(const AcRxValueArray& other);
+    AcRxValueArray(AcRxValueArray&& other);
+    ~AcRxValueArray();
+
+    AcRxValueArray& operator=(const AcRxValueArray& other);
+    AcRxValueArray& operator=(AcRxValueArray&& other);
+
+    size_t length() const { return m_pColumn != nullptr ? m_pColumn->length() : m_values.size(); }
+    bool isEmpty() const { return length() == 0; }
+
+    /// <summary>
+    /// Whether the values are kept in a column.  An empty array is not.
+    /// </summary>
+    bool isColumnar() const { return m_pColumn != nullptr; }
+
+    /// <summary>
+    /// The type of every value if the array is columnar, otherwise that of
+    /// no value.
+    /// </summary>
+    const AcRxValueType& type() const;
+
+    /// <summary>
+    /// Makes room for count values of the type of those already there, or,
+    /// for an empty array, of the first value appended.
+    /// </summary>
+    Acad::ErrorStatus reserve(size_t count);
+
+    /// <summary>
+    /// Removes every value; the next one appended may start a column of any
+    /// type.
+    /// </summary>
+    void clear();
+
+    /// <summary>
+    /// Appends a value, finding its column by its type.
+    /// </summary>
+    Acad::ErrorStatus append(const AcRxValue& value);
+
+    /// <summary>
+    /// Appends a value whose type is known, without making an AcRxValue of
+    /// it when it goes into a column.
+    /// </summary>
+    template<class T, class = std::enable_if_t<AcRxValueColumn<T>::kind != 0>>
+    Acad::ErrorStatus append(const T& value)
+    {
+        std::vector<T>* pColumn = column<T>();
+        if (pColumn == nullptr)
+            return append(&value, 1);
+        try
+        {
+            pColumn->push_back(value);
+        }
+        catch (const std::bad_alloc&)
+        {
+            return Acad::eOutOfMemory;
+        }
+        return Acad::eOk;
+    }
+
+    /// <summary>
+    /// Appends count values of a type that has a column, copying them into
+    /// the column in one go if they belong there.  pValues must not point
+    /// into the array itself.
+    /// </summary>
+    template<class T, class = std::enable_if_t<AcRxValueColumn<T>::kind != 0>>
+    Acad::ErrorStatus append(const T* pValues, size_t count)
+    {
+        try
+        {
+            if (m_pColumn == nullptr && m_values.empty())
+                m_pColumn.reset(newColumn<T>());
+            if (std::vector<T>* pColumn = column<T>())
+            {
+                pColumn->insert(pColumn->end(), pValues, pValues + count);
+                return Acad::eOk;
+            }
+            if (m_pColumn != nullptr)
+                spill(count);
+            for (size_t i = 0; i < count; ++i)
+                m_values.push_back(AcRxValue(pValues[i]));
+        }
+        catch (const std::bad_alloc&)
+        {
+            return Acad::eOutOfMemory;
+        }
+        return Acad::eOk;
+    }
+
+    /// <summary>
+    /// The value at index.
+    /// </summary>
+    AcRxValue at(size_t index) const
+    {
+        return m_pColumn != nullptr ? m_pColumn->at(index) : m_values[index];
+    }
+
+    /// <summary>
+    /// The value at index if it is a T, as rxvalue_cast would return it, or
+    /// null.
+    /// </summary>
+    template<class T>
+    const T* cast(size_t index) const
+    {
+        if (m_pColumn == nullptr)
+            return rxvalue_cast<T>(&m_values[index]);
+        if constexpr (AcRxValueColumn<T>::kind != 0)
+        {
+            if (const std::vector<T>* pColumn = column<T>())
+                return pColumn->data() + index;
+        }
+        return nullptr;
+    }
+
+    /// <summary>
+    /// The length() values of the array if it is a column of T, or null.
+    /// </summary>
+    template<class T>
+    const T* data() const
+    {
+        const std::vector<T>* pColumn = column<T>();
+        return pColumn != nullptr ? pColumn->data() : nullptr;
+    }
+
+    template<class T>
+    T* data()
+    {
+        std::vector<T>* pColumn = column<T>();
+        return pColumn != nullptr ? pColumn->data() : nullptr;
+    }
+
+private:
+    class Column
+    {
+    public:
+        explicit Column(int kind) : m_kind(kind) {}
+        virtual ~Column() {}
+
+        int kind() const { return m_kind; }
+
+        virtual const AcRxValueType& type() const = 0;
+        virtual size_t length() const = 0;
+        virtual Column* clone() const = 0;
+        virtual void reserve(size_t count) = 0;
+
+        /* Appends value and returns true if it is of the column's type. */
+        virtual bool append(const AcRxValue& value) = 0;
+
+        virtual AcRxValue at(size_t index) const = 0;
+
+    private:
+        int m_kind;
+    };
+
+    template<class T>
+    class TypedColumn final : public Column
+    {
+    public:
+        TypedColumn() : Column(AcRxValueColumn<T>::kind) {}
+
+        const AcRxValueType& type() const override { return AcRxValueType::Desc<T>::value(); }
+        size_t length() const override { return m_values.size(); }
+        Column* clone() const override { return new TypedColumn(*this); }
+        void reserve(size_t count) override { m_values.reserve(count); }
+
+        bool append(const AcRxValue& value) override
+        {
+            const T* pValue = rxvalue_cast<T>(&value);
+            if (pValue == nullptr)
+                return false;
+            m_values.push_back(*pValue);
+            return true;
+        }
+
+        AcRxValue at(size_t index) const override { return AcRxValue(m_values[index]); }
+
+        std::vector<T> m_values;
+    };
+
+    /* The values if the array is a column of T, or null. */
+    template<class T>
+    std::vector<T>* column() const
+    {
+        static_assert(AcRxValueColumn<T>::kind != 0, "T has no column");
+        return m_pColumn != nullptr && m_pColumn->kind() == AcRxValueColumn<T>::kind
+                   ? &static_cast<TypedColumn<T>*>(m_pColumn.get())->m_values
+                   : nullptr;
+    }
+
+    template<class T>
+    Column* newColumn() const
+    {
+        std::unique_ptr<TypedColumn<T>> pColumn(new TypedColumn<T>);
+        pColumn->reserve(m_reserved);
+        return pColumn.release();
+    }
+
+    Column* newColumn(const AcRxValue& value) const;
+    void spill(size_t extra);
+
+    std::unique_ptr<Column> m_pColumn;
+    std::vector<AcRxValue>  m_values;       // when there is no column
+    size_t                  m_reserved;     // for the column of an empty array
+};
+
+} // namespace acad_sheetset_to_pdf
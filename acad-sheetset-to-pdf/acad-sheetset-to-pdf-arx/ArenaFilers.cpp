@@ -0,0 +1,1245 @@
+#include "stdafx.h"
+#include "ArenaFilers.h"
+
+#include <cstring>
+#include <limits>
+#include <new>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+static_assert(sizeof(AcGePoint2d) == 2 * sizeof(double), "points are stored as they lie in memory");
+static_assert(sizeof(AcGePoint3d) == 3 * sizeof(double), "points are stored as they lie in memory");
+static_assert(sizeof(AcGeVector2d) == 2 * sizeof(double), "vectors are stored as they lie in memory");
+static_assert(sizeof(AcGeVector3d) == 3 * sizeof(double), "vectors are stored as they lie in memory");
+
+const ACHAR kEmbeddedObject[] = ACRX_T("Embedded Object");
+
+/* A DXF item starts with a varint of its group code, zigzagged, shifted
+up four bits over its kind.  A run then has a byte of the kind of its
+values and a varint of their count.  The values are:
+
+    kReal       double
+    kPoint      three doubles
+    kShort,     varints, zigzagged
+    kLong,
+    kInt64
+    kText       varint count of ACHARs, then the ACHARs
+    kBinary     varint count of bytes, then the bytes
+    kHandle     varint
+    kObjectId   Adesk::IntDbId, as AcDbObjectId::asOldId() gives it */
+const unsigned kKindBits = 4;
+
+Adesk::UInt64 zigzag(Adesk::Int64 value)
+{
+    return (static_cast<Adesk::UInt64>(value) << 1) ^ static_cast<Adesk::UInt64>(value >> 63);
+}
+
+Adesk::Int64 unzigzag(Adesk::UInt64 value)
+{
+    return static_cast<Adesk::Int64>((value >> 1) ^ (0 - (value & 1)));
+}
+
+} // namespace
+
+/* FilerArena -------------------------------------------------------------- */
+
+FilerArena::FilerArena(size_t capacity)
+    : m_size(0),
+      m_position(0)
+{
+    if (capacity != 0)
+        grow(capacity);
+}
+
+bool FilerArena::setPosition(size_t position)
+{
+    if (position > m_size)
+        return false;
+    m_position = position;
+    return true;
+}
+
+Acad::ErrorStatus FilerArena::assign(const void* pData, size_t size)
+{
+    clear();
+    if (!put(pData, size))
+        return Acad::eOutOfMemory;
+    m_position = 0;
+    return Acad::eOk;
+}
+
+/* Makes room for size bytes past the position, at least doubling the
+capacity so that an arena written a field at a time grows in amortised
+constant time. */
+bool FilerArena::grow(size_t size)
+{
+    const size_t needed = m_position + size;
+    if (needed < m_position)
+        return false;
+    try
+    {
+        m_bytes.resize(std::max(needed, std::max<size_t>(m_bytes.size() * 2, 4096)));
+    }
+    catch (const std::bad_alloc&)
+    {
+        return false;
+    }
+    return true;
+}
+
+/* ArenaDwgFiler ----------------------------------------------------------- */
+
+ArenaDwgFiler::ArenaDwgFiler(AcDb::FilerType filerType, size_t capacity)
+    : m_arena(capacity),
+      m_filerType(filerType),
+      m_status(Acad::eOk)
+{
+}
+
+ArenaDwgFiler::~ArenaDwgFiler()
+{
+}
+
+void ArenaDwgFiler::clear()
+{
+    m_arena.clear();
+    m_status = Acad::eOk;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readHardOwnershipId(AcDbHardOwnershipId* pVal)
+{
+    return readId(pVal);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeHardOwnershipId(const AcDbHardOwnershipId& val)
+{
+    return writeId(val);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readSoftOwnershipId(AcDbSoftOwnershipId* pVal)
+{
+    return readId(pVal);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeSoftOwnershipId(const AcDbSoftOwnershipId& val)
+{
+    return writeId(val);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readHardPointerId(AcDbHardPointerId* pVal)
+{
+    return readId(pVal);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeHardPointerId(const AcDbHardPointerId& val)
+{
+    return writeId(val);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readSoftPointerId(AcDbSoftPointerId* pVal)
+{
+    return readId(pVal);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeSoftPointerId(const AcDbSoftPointerId& val)
+{
+    return writeId(val);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readInt8(Adesk::Int8* pVal)
+{
+    return readRaw(pVal);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeInt8(Adesk::Int8 val)
+{
+    return writeRaw(&val);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readString(ACHAR** pVal)
+{
+    *pVal = nullptr;
+    size_t length;
+    const Acad::ErrorStatus es = readLength(&length, sizeof(ACHAR));
+    if (es != Acad::eOk)
+        return es;
+    ACHAR* const pString = new (std::nothrow) ACHAR[length + 1];
+    if (pString == nullptr)
+        return fail(Acad::eOutOfMemory);
+    m_arena.get(pString, length * sizeof(ACHAR));
+    pString[length] = 0;
+    *pVal = pString;
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeString(const ACHAR* pVal)
+{
+    const size_t length = pVal != nullptr ? std::wcslen(pVal) : 0;
+    if (m_status != Acad::eOk)
+        return m_status;
+    if (!m_arena.putVarUInt(length) || !m_arena.put(pVal, length * sizeof(ACHAR)))
+        return fail(Acad::eOutOfMemory);
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readString(AcString& val)
+{
+    size_t length;
+    const Acad::ErrorStatus es = readLength(&length, sizeof(ACHAR));
+    if (es != Acad::eOk)
+        return es;
+    if (length == 0)
+    {
+        val.setEmpty();
+        return Acad::eOk;
+    }
+    /* The arena's characters need not be aligned; they are copied out
+    before AcString reads them. */
+    try
+    {
+        m_text.resize(length);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return fail(Acad::eOutOfMemory);
+    }
+    m_arena.get(m_text.data(), length * sizeof(ACHAR));
+    val = AcString(m_text.data(), static_cast<Adesk::UInt32>(length));
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeString(const AcString& val)
+{
+    const size_t length = static_cast<size_t>(val.length());
+    if (m_status != Acad::eOk)
+        return m_status;
+    if (!m_arena.putVarUInt(length) || !m_arena.put(val.kwszPtr(), length * sizeof(ACHAR)))
+        return fail(Acad::eOutOfMemory);
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readBChunk(ads_binary* pVal)
+{
+    pVal->clen = 0;
+    pVal->buf = nullptr;
+    size_t length;
+    const Acad::ErrorStatus es = readLength(&length, 1);
+    if (es != Acad::eOk)
+        return es;
+    if (length > static_cast<size_t>(std::numeric_limits<short>::max()))
+        return fail(Acad::eInvalidInput);
+    char* const pBuffer = new (std::nothrow) char[length != 0 ? length : 1];
+    if (pBuffer == nullptr)
+        return fail(Acad::eOutOfMemory);
+    m_arena.get(pBuffer, length);
+    pVal->clen = static_cast<short>(length);
+    pVal->buf = pBuffer;
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeBChunk(const ads_binary& val)
+{
+    if (m_status != Acad::eOk)
+        return m_status;
+    if (val.clen < 0 || (val.clen != 0 && val.buf == nullptr))
+        return fail(Acad::eInvalidInput);
+    if (!m_arena.putVarUInt(static_cast<Adesk::UInt64>(val.clen)) || !m_arena.put(val.buf, size_t(val.clen)))
+        return fail(Acad::eOutOfMemory);
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readAcDbHandle(AcDbHandle* pVal)
+{
+    Adesk::UInt64 value;
+    const Acad::ErrorStatus es = readVarUInt(&value);
+    if (es == Acad::eOk)
+        *pVal = value;
+    return es;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeAcDbHandle(const AcDbHandle& val)
+{
+    return writeVarUInt(static_cast<Adesk::UInt64>(val));
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readInt64(Adesk::Int64* pVal)
+{
+    return readVarInt(pVal);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeInt64(Adesk::Int64 val)
+{
+    return writeVarInt(val);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readInt32(Adesk::Int32* pVal)
+{
+    Adesk::Int64 value;
+    const Acad::ErrorStatus es = readSigned(&value, std::numeric_limits<Adesk::Int32>::min(),
+                                            std::numeric_limits<Adesk::Int32>::max());
+    if (es == Acad::eOk)
+        *pVal = static_cast<Adesk::Int32>(value);
+    return es;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeInt32(Adesk::Int32 val)
+{
+    return writeVarInt(val);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readInt16(Adesk::Int16* pVal)
+{
+    Adesk::Int64 value;
+    const Acad::ErrorStatus es = readSigned(&value, std::numeric_limits<Adesk::Int16>::min(),
+                                            std::numeric_limits<Adesk::Int16>::max());
+    if (es == Acad::eOk)
+        *pVal = static_cast<Adesk::Int16>(value);
+    return es;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeInt16(Adesk::Int16 val)
+{
+    return writeVarInt(val);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readUInt64(Adesk::UInt64* pVal)
+{
+    return readVarUInt(pVal);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeUInt64(Adesk::UInt64 val)
+{
+    return writeVarUInt(val);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readUInt32(Adesk::UInt32* pVal)
+{
+    Adesk::UInt64 value;
+    const Acad::ErrorStatus es = readUnsigned(&value, std::numeric_limits<Adesk::UInt32>::max());
+    if (es == Acad::eOk)
+        *pVal = static_cast<Adesk::UInt32>(value);
+    return es;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeUInt32(Adesk::UInt32 val)
+{
+    return writeVarUInt(val);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readUInt16(Adesk::UInt16* pVal)
+{
+    Adesk::UInt64 value;
+    const Acad::ErrorStatus es = readUnsigned(&value, std::numeric_limits<Adesk::UInt16>::max());
+    if (es == Acad::eOk)
+        *pVal = static_cast<Adesk::UInt16>(value);
+    return es;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeUInt16(Adesk::UInt16 val)
+{
+    return writeVarUInt(val);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readUInt8(Adesk::UInt8* pVal)
+{
+    return readRaw(pVal);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeUInt8(Adesk::UInt8 val)
+{
+    return writeRaw(&val);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readBool(bool* pVal)
+{
+    Adesk::UInt8 value;
+    const Acad::ErrorStatus es = readRaw(&value);
+    if (es == Acad::eOk)
+        *pVal = value != 0;
+    return es;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeBool(bool val)
+{
+    const Adesk::UInt8 value = val ? 1 : 0;
+    return writeRaw(&value);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readDouble(double* pVal)
+{
+    return readRaw(pVal);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeDouble(double val)
+{
+    return writeRaw(&val);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readPoint2d(AcGePoint2d* pVal)
+{
+    return readRaw(pVal);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writePoint2d(const AcGePoint2d& val)
+{
+    return writeRaw(&val);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readPoint3d(AcGePoint3d* pVal)
+{
+    return readRaw(pVal);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writePoint3d(const AcGePoint3d& val)
+{
+    return writeRaw(&val);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readVector2d(AcGeVector2d* pVal)
+{
+    return readRaw(pVal);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeVector2d(const AcGeVector2d& val)
+{
+    return writeRaw(&val);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readVector3d(AcGeVector3d* pVal)
+{
+    return readRaw(pVal);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeVector3d(const AcGeVector3d& val)
+{
+    return writeRaw(&val);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readScale3d(AcGeScale3d* pVal)
+{
+    double values[3];
+    const Acad::ErrorStatus es = readRaw(values, 3);
+    if (es == Acad::eOk)
+    {
+        pVal->sx = values[0];
+        pVal->sy = values[1];
+        pVal->sz = values[2];
+    }
+    return es;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeScale3d(const AcGeScale3d& val)
+{
+    const double values[3] = { val.sx, val.sy, val.sz };
+    return writeRaw(values, 3);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readBytes(void* pDest, Adesk::UIntPtr nBytes)
+{
+    return readRaw(static_cast<Adesk::UInt8*>(pDest), nBytes);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeBytes(const void* pSrc, Adesk::UIntPtr nBytes)
+{
+    return writeRaw(static_cast<const Adesk::UInt8*>(pSrc), nBytes);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readAddress(void** pVal)
+{
+    Adesk::UIntPtr value;
+    const Acad::ErrorStatus es = readRaw(&value);
+    if (es == Acad::eOk)
+        *pVal = reinterpret_cast<void*>(value);
+    return es;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeAddress(const void* pVal)
+{
+    const Adesk::UIntPtr value = reinterpret_cast<Adesk::UIntPtr>(pVal);
+    return writeRaw(&value);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::seek(Adesk::Int64 nOffset, int nMethod)
+{
+    if (m_status != Acad::eOk)
+        return m_status;
+    Adesk::Int64 base;
+    switch (nMethod)
+    {
+    case AcDb::kSeekFromStart:
+        base = 0;
+        break;
+    case AcDb::kSeekFromCurrent:
+        base = static_cast<Adesk::Int64>(m_arena.position());
+        break;
+    case AcDb::kSeekFromEnd:
+        base = static_cast<Adesk::Int64>(m_arena.size());
+        break;
+    default:
+        return fail(Acad::eInvalidInput);
+    }
+    const Adesk::Int64 target = base + nOffset;
+    if (target < 0 || !m_arena.setPosition(static_cast<size_t>(target)))
+        return fail(Acad::eInvalidInput);
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readDoubles(double* pVals, size_t count)
+{
+    return readRaw(pVals, count);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeDoubles(const double* pVals, size_t count)
+{
+    return writeRaw(pVals, count);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readPoint2ds(AcGePoint2d* pVals, size_t count)
+{
+    return readRaw(pVals, count);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writePoint2ds(const AcGePoint2d* pVals, size_t count)
+{
+    return writeRaw(pVals, count);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readPoint3ds(AcGePoint3d* pVals, size_t count)
+{
+    return readRaw(pVals, count);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writePoint3ds(const AcGePoint3d* pVals, size_t count)
+{
+    return writeRaw(pVals, count);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readObjectIds(AcDbObjectId* pVals, size_t count)
+{
+    if (m_status != Acad::eOk)
+        return m_status;
+    if (count > m_arena.remaining() / sizeof(Adesk::IntDbId))
+        return fail(Acad::eEndOfFile);
+    const Adesk::UInt8* p = m_arena.take(count * sizeof(Adesk::IntDbId));
+    for (size_t i = 0; i < count; ++i, p += sizeof(Adesk::IntDbId))
+    {
+        Adesk::IntDbId value;
+        std::memcpy(&value, p, sizeof(value));
+        pVals[i].setFromOldId(value);
+    }
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeObjectIds(const AcDbObjectId* pVals, size_t count)
+{
+    if (m_status != Acad::eOk)
+        return m_status;
+    if (count > std::numeric_limits<size_t>::max() / sizeof(Adesk::IntDbId))
+        return fail(Acad::eOutOfMemory);
+    Adesk::UInt8* p = m_arena.extend(count * sizeof(Adesk::IntDbId));
+    if (p == nullptr)
+        return fail(Acad::eOutOfMemory);
+    for (size_t i = 0; i < count; ++i, p += sizeof(Adesk::IntDbId))
+    {
+        const Adesk::IntDbId value = pVals[i].asOldId();
+        std::memcpy(p, &value, sizeof(value));
+    }
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readArray(AcGeDoubleArray& vals)
+{
+    size_t length;
+    Acad::ErrorStatus es = readLength(&length, sizeof(double));
+    if (es == Acad::eOk)
+    {
+        vals.setLogicalLength(static_cast<int>(length));
+        es = readDoubles(vals.asArrayPtr(), length);
+    }
+    return es;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeArray(const AcGeDoubleArray& vals)
+{
+    const Acad::ErrorStatus es = writeVarUInt(static_cast<Adesk::UInt64>(vals.length()));
+    return es == Acad::eOk ? writeDoubles(vals.asArrayPtr(), size_t(vals.length())) : es;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readArray(AcGePoint2dArray& vals)
+{
+    size_t length;
+    Acad::ErrorStatus es = readLength(&length, sizeof(AcGePoint2d));
+    if (es == Acad::eOk)
+    {
+        vals.setLogicalLength(static_cast<int>(length));
+        es = readPoint2ds(vals.asArrayPtr(), length);
+    }
+    return es;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeArray(const AcGePoint2dArray& vals)
+{
+    const Acad::ErrorStatus es = writeVarUInt(static_cast<Adesk::UInt64>(vals.length()));
+    return es == Acad::eOk ? writePoint2ds(vals.asArrayPtr(), size_t(vals.length())) : es;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readArray(AcGePoint3dArray& vals)
+{
+    size_t length;
+    Acad::ErrorStatus es = readLength(&length, sizeof(AcGePoint3d));
+    if (es == Acad::eOk)
+    {
+        vals.setLogicalLength(static_cast<int>(length));
+        es = readPoint3ds(vals.asArrayPtr(), length);
+    }
+    return es;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeArray(const AcGePoint3dArray& vals)
+{
+    const Acad::ErrorStatus es = writeVarUInt(static_cast<Adesk::UInt64>(vals.length()));
+    return es == Acad::eOk ? writePoint3ds(vals.asArrayPtr(), size_t(vals.length())) : es;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readArray(AcDbObjectIdArray& vals)
+{
+    size_t length;
+    Acad::ErrorStatus es = readLength(&length, sizeof(Adesk::IntDbId));
+    if (es == Acad::eOk)
+    {
+        vals.setLogicalLength(static_cast<int>(length));
+        es = readObjectIds(vals.asArrayPtr(), length);
+    }
+    return es;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeArray(const AcDbObjectIdArray& vals)
+{
+    const Acad::ErrorStatus es = writeVarUInt(static_cast<Adesk::UInt64>(vals.length()));
+    return es == Acad::eOk ? writeObjectIds(vals.asArrayPtr(), size_t(vals.length())) : es;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readVarUInt(Adesk::UInt64* pVal)
+{
+    if (m_status != Acad::eOk)
+        return m_status;
+    if (!m_arena.getVarUInt(*pVal))
+        return fail(Acad::eEndOfFile);
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeVarUInt(Adesk::UInt64 val)
+{
+    if (m_status != Acad::eOk)
+        return m_status;
+    if (!m_arena.putVarUInt(val))
+        return fail(Acad::eOutOfMemory);
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readVarInt(Adesk::Int64* pVal)
+{
+    if (m_status != Acad::eOk)
+        return m_status;
+    if (!m_arena.getVarInt(*pVal))
+        return fail(Acad::eEndOfFile);
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeVarInt(Adesk::Int64 val)
+{
+    if (m_status != Acad::eOk)
+        return m_status;
+    if (!m_arena.putVarInt(val))
+        return fail(Acad::eOutOfMemory);
+    return Acad::eOk;
+}
+
+template <class T>
+Acad::ErrorStatus ArenaDwgFiler::readRaw(T* pVal, size_t count)
+{
+    if (m_status != Acad::eOk)
+        return m_status;
+    if (count > m_arena.remaining() / sizeof(T))
+        return fail(Acad::eEndOfFile);
+    std::memcpy(pVal, m_arena.take(count * sizeof(T)), count * sizeof(T));
+    return Acad::eOk;
+}
+
+template <class T>
+Acad::ErrorStatus ArenaDwgFiler::writeRaw(const T* pVals, size_t count)
+{
+    if (m_status != Acad::eOk)
+        return m_status;
+    if (count > std::numeric_limits<size_t>::max() / sizeof(T) || !m_arena.put(pVals, count * sizeof(T)))
+        return fail(Acad::eOutOfMemory);
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readId(AcDbObjectId* pVal)
+{
+    Adesk::IntDbId value;
+    const Acad::ErrorStatus es = readRaw(&value);
+    if (es == Acad::eOk)
+        pVal->setFromOldId(value);
+    return es;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::writeId(const AcDbObjectId& val)
+{
+    const Adesk::IntDbId value = val.asOldId();
+    return writeRaw(&value);
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readSigned(Adesk::Int64* pVal, Adesk::Int64 minimum, Adesk::Int64 maximum)
+{
+    const Acad::ErrorStatus es = readVarInt(pVal);
+    if (es == Acad::eOk && (*pVal < minimum || *pVal > maximum))
+        return fail(Acad::eInvalidInput);
+    return es;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::readUnsigned(Adesk::UInt64* pVal, Adesk::UInt64 maximum)
+{
+    const Acad::ErrorStatus es = readVarUInt(pVal);
+    if (es == Acad::eOk && *pVal > maximum)
+        return fail(Acad::eInvalidInput);
+    return es;
+}
+
+/* Reads the count before a string or an array, which has to fit in what
+is left of the arena, and in an AcArray. */
+Acad::ErrorStatus ArenaDwgFiler::readLength(size_t* pLength, size_t elementSize)
+{
+    Adesk::UInt64 length;
+    const Acad::ErrorStatus es = readVarUInt(&length);
+    if (es != Acad::eOk)
+        return es;
+    if (length > m_arena.remaining() / elementSize)
+        return fail(Acad::eEndOfFile);
+    if (length > static_cast<Adesk::UInt64>(std::numeric_limits<int>::max()))
+        return fail(Acad::eInvalidInput);
+    *pLength = static_cast<size_t>(length);
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus ArenaDwgFiler::fail(Acad::ErrorStatus es)
+{
+    if (m_status == Acad::eOk)
+        m_status = es;
+    return m_status;
+}
+
+/* ArenaDxfFiler ----------------------------------------------------------- */
+
+ArenaDxfFiler::ArenaDxfFiler(AcDbDatabase* pDb, AcDb::FilerType filerType, size_t capacity)
+    : m_arena(capacity),
+      m_pDb(pDb),
+      m_filerType(filerType),
+      m_status(Acad::eOk),
+      m_cursor(),
+      m_lastItem(),
+      m_canPushBack(false)
+{
+}
+
+ArenaDxfFiler::~ArenaDxfFiler()
+{
+}
+
+void ArenaDxfFiler::clear()
+{
+    m_arena.clear();
+    m_status = Acad::eOk;
+    rewindFiler();
+}
+
+int ArenaDxfFiler::rewindFiler()
+{
+    m_arena.setPosition(0);
+    m_cursor = Cursor();
+    m_canPushBack = false;
+    return Acad::eOk;
+}
+
+/* Reads the next item, or the next value of the run being read, as the
+DXF reader would have made it into a resbuf.  The end of the arena
+returns Acad::eEndOfFile without making it the filer's status. */
+Acad::ErrorStatus ArenaDxfFiler::readResBuf(resbuf* pRb)
+{
+    if (m_status != Acad::eOk)
+        return m_status;
+    if (pRb == nullptr)
+        return Acad::eNullPtr;
+
+    m_lastItem = m_cursor;
+    m_lastItem.position = m_arena.position();
+    int code;
+    Kind kind;
+    if (m_cursor.runLeft != 0)
+    {
+        code = m_cursor.runCode;
+        kind = m_cursor.runKind;
+        --m_cursor.runLeft;
+    }
+    else
+    {
+        if (m_arena.remaining() == 0)
+            return Acad::eEndOfFile;
+        if (!readHeader(code, kind))
+            return fail(Acad::eInvalidInput);
+        if (kind == kRun)
+        {
+            Adesk::UInt8 runKind;
+            Adesk::UInt64 count;
+            if (!m_arena.get(&runKind, 1) || runKind >= kRun || !m_arena.getVarUInt(count) || count == 0)
+                return fail(Acad::eInvalidInput);
+            kind = static_cast<Kind>(runKind);
+            m_cursor.runCode = code;
+            m_cursor.runKind = kind;
+            m_cursor.runLeft = count - 1;
+        }
+    }
+
+    pRb->restype = static_cast<short>(code);
+    const Acad::ErrorStatus es = readValue(kind, pRb);
+    if (es != Acad::eOk)
+        return fail(es);
+    m_canPushBack = true;
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus ArenaDxfFiler::writeResBuf(const resbuf& rb)
+{
+    const AcDb::DxfCode code = static_cast<AcDb::DxfCode>(rb.restype);
+    switch (acdbGroupCodeToType(code))
+    {
+    case AcDb::kDwgReal:
+        return writeDouble(code, rb.resval.rreal);
+    case AcDb::kDwgInt32:
+        return writeInt32(code, rb.resval.rlong);
+    case AcDb::kDwgInt16:
+        return writeInt16(code, rb.resval.rint);
+    case AcDb::kDwgInt8:
+        return writeInt8(code, static_cast<Adesk::Int8>(rb.resval.rint));
+    case AcDb::kDwgText:
+        return writeString(code, rb.resval.rstring);
+    case AcDb::kDwgBChunk:
+        return writeBChunk(code, rb.resval.rbinary);
+    case AcDb::kDwgHandle:
+        return writeAcDbHandle(code, AcDbHandle(rb.resval.rstring));
+    case AcDb::kDwgHardOwnershipId:
+    case AcDb::kDwgSoftOwnershipId:
+    case AcDb::kDwgHardPointerId:
+    case AcDb::kDwgSoftPointerId:
+    {
+        AcDbObjectId id;
+        if (rb.resval.rlname[0] != 0 || rb.resval.rlname[1] != 0)
+            acdbGetObjectId(id, rb.resval.rlname);
+        return writeObjectId(code, id);
+    }
+    case AcDb::kDwg3Real:
+        return writePoint3d(code, AcGePoint3d(rb.resval.rpoint[0], rb.resval.rpoint[1], rb.resval.rpoint[2]));
+    case AcDb::kDwgInt64:
+        return writeInt64(code, rb.resval.mnInt64);
+    default:
+        return fail(Acad::eInvalidInput);
+    }
+}
+
+Acad::ErrorStatus ArenaDxfFiler::writeObjectId(AcDb::DxfCode code, const AcDbObjectId& id)
+{
+    const Adesk::IntDbId value = id.asOldId();
+    return put(code, kObjectId, &value, sizeof(value));
+}
+
+Acad::ErrorStatus ArenaDxfFiler::writeInt8(AcDb::DxfCode code, Adesk::Int8 val)
+{
+    return writeInt16(code, val);
+}
+
+Acad::ErrorStatus ArenaDxfFiler::writeString(AcDb::DxfCode code, const ACHAR* pVal)
+{
+    const size_t length = pVal != nullptr ? std::wcslen(pVal) : 0;
+    const Acad::ErrorStatus es = put(code, kText, nullptr, 0);
+    if (es != Acad::eOk)
+        return es;
+    if (!m_arena.putVarUInt(length) || !m_arena.put(pVal, length * sizeof(ACHAR)))
+        return fail(Acad::eOutOfMemory);
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus ArenaDxfFiler::writeString(AcDb::DxfCode code, const AcString& val)
+{
+    return writeString(code, val.kwszPtr());
+}
+
+Acad::ErrorStatus ArenaDxfFiler::writeBChunk(AcDb::DxfCode code, const ads_binary& val)
+{
+    if (m_status != Acad::eOk)
+        return m_status;
+    if (val.clen < 0 || (val.clen != 0 && val.buf == nullptr))
+        return fail(Acad::eInvalidInput);
+    const Acad::ErrorStatus es = put(code, kBinary, nullptr, 0);
+    if (es != Acad::eOk)
+        return es;
+    if (!m_arena.putVarUInt(static_cast<Adesk::UInt64>(val.clen)) || !m_arena.put(val.buf, size_t(val.clen)))
+        return fail(Acad::eOutOfMemory);
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus ArenaDxfFiler::writeAcDbHandle(AcDb::DxfCode code, const AcDbHandle& val)
+{
+    const Acad::ErrorStatus es = put(code, kHandle, nullptr, 0);
+    if (es != Acad::eOk)
+        return es;
+    if (!m_arena.putVarUInt(static_cast<Adesk::UInt64>(val)))
+        return fail(Acad::eOutOfMemory);
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus ArenaDxfFiler::writeInt64(AcDb::DxfCode code, Adesk::Int64 val)
+{
+    const Acad::ErrorStatus es = put(code, kInt64, nullptr, 0);
+    if (es != Acad::eOk)
+        return es;
+    if (!m_arena.putVarInt(val))
+        return fail(Acad::eOutOfMemory);
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus ArenaDxfFiler::writeInt32(AcDb::DxfCode code, Adesk::Int32 val)
+{
+    const Acad::ErrorStatus es = put(code, kLong, nullptr, 0);
+    if (es != Acad::eOk)
+        return es;
+    if (!m_arena.putVarInt(val))
+        return fail(Acad::eOutOfMemory);
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus ArenaDxfFiler::writeInt16(AcDb::DxfCode code, Adesk::Int16 val)
+{
+    const Acad::ErrorStatus es = put(code, kShort, nullptr, 0);
+    if (es != Acad::eOk)
+        return es;
+    if (!m_arena.putVarInt(val))
+        return fail(Acad::eOutOfMemory);
+    return Acad::eOk;
+}
+
+/* Unsigned values come back in the signed resval fields of their width,
+as AutoCAD's own DXF filers give them. */
+Acad::ErrorStatus ArenaDxfFiler::writeUInt64(AcDb::DxfCode code, Adesk::UInt64 val)
+{
+    return writeInt64(code, static_cast<Adesk::Int64>(val));
+}
+
+Acad::ErrorStatus ArenaDxfFiler::writeUInt32(AcDb::DxfCode code, Adesk::UInt32 val)
+{
+    return writeInt32(code, static_cast<Adesk::Int32>(val));
+}
+
+Acad::ErrorStatus ArenaDxfFiler::writeUInt16(AcDb::DxfCode code, Adesk::UInt16 val)
+{
+    return writeInt16(code, static_cast<Adesk::Int16>(val));
+}
+
+Acad::ErrorStatus ArenaDxfFiler::writeUInt8(AcDb::DxfCode code, Adesk::UInt8 val)
+{
+    return writeInt16(code, val);
+}
+
+Acad::ErrorStatus ArenaDxfFiler::writeBool(AcDb::DxfCode code, bool val)
+{
+    return writeInt16(code, val ? 1 : 0);
+}
+
+Acad::ErrorStatus ArenaDxfFiler::writeDouble(AcDb::DxfCode code, double val, int)
+{
+    return put(code, kReal, &val, sizeof(val));
+}
+
+Acad::ErrorStatus ArenaDxfFiler::writePoint2d(AcDb::DxfCode code, const AcGePoint2d& val, int)
+{
+    const double values[3] = { val.x, val.y, 0.0 };
+    return put(code, kPoint, values, sizeof(values));
+}
+
+Acad::ErrorStatus ArenaDxfFiler::writePoint3d(AcDb::DxfCode code, const AcGePoint3d& val, int)
+{
+    return put(code, kPoint, &val, sizeof(val));
+}
+
+Acad::ErrorStatus ArenaDxfFiler::writeVector2d(AcDb::DxfCode code, const AcGeVector2d& val, int)
+{
+    const double values[3] = { val.x, val.y, 0.0 };
+    return put(code, kPoint, values, sizeof(values));
+}
+
+Acad::ErrorStatus ArenaDxfFiler::writeVector3d(AcDb::DxfCode code, const AcGeVector3d& val, int)
+{
+    return put(code, kPoint, &val, sizeof(val));
+}
+
+Acad::ErrorStatus ArenaDxfFiler::writeScale3d(AcDb::DxfCode code, const AcGeScale3d& val, int)
+{
+    const double values[3] = { val.sx, val.sy, val.sz };
+    return put(code, kPoint, values, sizeof(values));
+}
+
+Acad::ErrorStatus ArenaDxfFiler::pushBackItem()
+{
+    if (!m_canPushBack)
+        return Acad::eNotApplicable;
+    m_arena.setPosition(m_lastItem.position);
+    m_cursor = m_lastItem;
+    m_canPushBack = false;
+    return Acad::eOk;
+}
+
+bool ArenaDxfFiler::atEOF()
+{
+    return m_cursor.runLeft == 0 && m_arena.remaining() == 0;
+}
+
+bool ArenaDxfFiler::atSubclassData(const ACHAR* subClassName)
+{
+    return nextIsString(AcDb::kDxfSubclass, subClassName);
+}
+
+bool ArenaDxfFiler::atExtendedData()
+{
+    int code;
+    Kind kind;
+    return peek(code, kind) && (code >= AcDb::kDxfXdAsciiString || code == AcDb::kDxfXDataStart);
+}
+
+bool ArenaDxfFiler::atEndOfObject()
+{
+    int code;
+    Kind kind;
+    return !peek(code, kind) || code == AcDb::kDxfStart;
+}
+
+Acad::ErrorStatus ArenaDxfFiler::writeEmbeddedObjectStart()
+{
+    return writeString(AcDb::kDxfEmbeddedObjectStart, kEmbeddedObject);
+}
+
+bool ArenaDxfFiler::atEmbeddedObjectStart()
+{
+    return nextIsString(AcDb::kDxfEmbeddedObjectStart, kEmbeddedObject);
+}
+
+Acad::ErrorStatus ArenaDxfFiler::writeDoubles(AcDb::DxfCode code, const double* pVals, size_t count)
+{
+    if (count == 0)
+        return m_status;
+    Acad::ErrorStatus es = put(code, kRun, nullptr, 0);
+    if (es != Acad::eOk)
+        return es;
+    const Adesk::UInt8 kind = kReal;
+    if (!m_arena.put(&kind, 1) || !m_arena.putVarUInt(count) || !m_arena.put(pVals, count * sizeof(double)))
+        return fail(Acad::eOutOfMemory);
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus ArenaDxfFiler::writePoint3ds(AcDb::DxfCode code, const AcGePoint3d* pVals, size_t count)
+{
+    if (count == 0)
+        return m_status;
+    Acad::ErrorStatus es = put(code, kRun, nullptr, 0);
+    if (es != Acad::eOk)
+        return es;
+    const Adesk::UInt8 kind = kPoint;
+    if (!m_arena.put(&kind, 1) || !m_arena.putVarUInt(count) || !m_arena.put(pVals, count * sizeof(AcGePoint3d)))
+        return fail(Acad::eOutOfMemory);
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus ArenaDxfFiler::writeObjectIds(AcDb::DxfCode code, const AcDbObjectId* pVals, size_t count)
+{
+    if (count == 0)
+        return m_status;
+    Acad::ErrorStatus es = put(code, kRun, nullptr, 0);
+    if (es != Acad::eOk)
+        return es;
+    const Adesk::UInt8 kind = kObjectId;
+    Adesk::UInt8* p = nullptr;
+    if (!m_arena.put(&kind, 1) || !m_arena.putVarUInt(count) ||
+        (p = m_arena.extend(count * sizeof(Adesk::IntDbId))) == nullptr)
+        return fail(Acad::eOutOfMemory);
+    for (size_t i = 0; i < count; ++i, p += sizeof(Adesk::IntDbId))
+    {
+        const Adesk::IntDbId value = pVals[i].asOldId();
+        std::memcpy(p, &value, sizeof(value));
+    }
+    return Acad::eOk;
+}
+
+/* Writes the header of an item and size bytes of its value, if the
+caller does not write the value itself. */
+Acad::ErrorStatus ArenaDxfFiler::put(int code, Kind kind, const void* pData, size_t size)
+{
+    if (m_status != Acad::eOk)
+        return m_status;
+    if (!m_arena.putVarUInt((zigzag(code) << kKindBits) | kind) || !m_arena.put(pData, size))
+        return fail(Acad::eOutOfMemory);
+    return Acad::eOk;
+}
+
+bool ArenaDxfFiler::readHeader(int& code, Kind& kind)
+{
+    Adesk::UInt64 header;
+    if (!m_arena.getVarUInt(header) || (header & ((1u << kKindBits) - 1)) > kRun)
+        return false;
+    const Adesk::Int64 value = unzigzag(header >> kKindBits);
+    if (value < std::numeric_limits<short>::min() || value > std::numeric_limits<short>::max())
+        return false;
+    code = static_cast<int>(value);
+    kind = static_cast<Kind>(header & ((1u << kKindBits) - 1));
+    return true;
+}
+
+/* The code and kind of the next item, leaving it to be read; false at the
+end or at damage. */
+bool ArenaDxfFiler::peek(int& code, Kind& kind)
+{
+    if (m_status != Acad::eOk)
+        return false;
+    if (m_cursor.runLeft != 0)
+    {
+        code = m_cursor.runCode;
+        kind = m_cursor.runKind;
+        return true;
+    }
+    const size_t position = m_arena.position();
+    const bool found = m_arena.remaining() != 0 && readHeader(code, kind);
+    m_arena.setPosition(position);
+    return found;
+}
+
+Acad::ErrorStatus ArenaDxfFiler::readValue(Kind kind, resbuf* pRb)
+{
+    switch (kind)
+    {
+    case kReal:
+        return m_arena.get(&pRb->resval.rreal, sizeof(double)) ? Acad::eOk : Acad::eEndOfFile;
+    case kPoint:
+        return m_arena.get(pRb->resval.rpoint, 3 * sizeof(double)) ? Acad::eOk : Acad::eEndOfFile;
+    case kShort:
+    case kLong:
+    case kInt64:
+    {
+        Adesk::Int64 value;
+        if (!m_arena.getVarInt(value))
+            return Acad::eEndOfFile;
+        if (kind == kShort)
+            pRb->resval.rint = static_cast<short>(value);
+        else if (kind == kLong)
+            pRb->resval.rlong = static_cast<Adesk::Int32>(value);
+        else
+            pRb->resval.mnInt64 = value;
+        return Acad::eOk;
+    }
+    case kText:
+    {
+        Adesk::UInt64 length;
+        if (!m_arena.getVarUInt(length) || length > m_arena.remaining() / sizeof(ACHAR))
+            return Acad::eEndOfFile;
+        try
+        {
+            m_text.resize(static_cast<size_t>(length) + 1);
+        }
+        catch (const std::bad_alloc&)
+        {
+            return Acad::eOutOfMemory;
+        }
+        m_arena.get(m_text.data(), static_cast<size_t>(length) * sizeof(ACHAR));
+        m_text[static_cast<size_t>(length)] = 0;
+        pRb->resval.rstring = m_text.data();
+        return Acad::eOk;
+    }
+    case kBinary:
+    {
+        Adesk::UInt64 length;
+        if (!m_arena.getVarUInt(length) || length > m_arena.remaining())
+            return Acad::eEndOfFile;
+        if (length > static_cast<Adesk::UInt64>(std::numeric_limits<short>::max()))
+            return Acad::eInvalidInput;
+        try
+        {
+            m_chunk.resize(static_cast<size_t>(length) + 1);
+        }
+        catch (const std::bad_alloc&)
+        {
+            return Acad::eOutOfMemory;
+        }
+        m_arena.get(m_chunk.data(), static_cast<size_t>(length));
+        pRb->resval.rbinary.clen = static_cast<short>(length);
+        pRb->resval.rbinary.buf = m_chunk.data();
+        return Acad::eOk;
+    }
+    case kHandle:
+    {
+        Adesk::UInt64 value;
+        if (!m_arena.getVarUInt(value))
+            return Acad::eEndOfFile;
+        m_text.resize(17);
+        AcDbHandle(value).getIntoAsciiBuffer(m_text.data(), m_text.size());
+        pRb->resval.rstring = m_text.data();
+        return Acad::eOk;
+    }
+    case kObjectId:
+    {
+        Adesk::IntDbId value;
+        if (!m_arena.get(&value, sizeof(value)))
+            return Acad::eEndOfFile;
+        AcDbObjectId id;
+        id.setFromOldId(value);
+        pRb->resval.rlname[0] = 0;
+        pRb->resval.rlname[1] = 0;
+        if (!id.isNull())
+            acdbGetAdsName(pRb->resval.rlname, id);
+        return Acad::eOk;
+    }
+    default:
+        return Acad::eInvalidInput;
+    }
+}
+
+/* Whether the next item is the string pValue under code, reading past it
+if it is. */
+bool ArenaDxfFiler::nextIsString(int code, const ACHAR* pValue)
+{
+    if (m_status != Acad::eOk || m_cursor.runLeft != 0 || pValue == nullptr)
+        return false;
+    const size_t position = m_arena.position();
+    int itemCode;
+    Kind kind;
+    Adesk::UInt64 length;
+    if (m_arena.remaining() != 0 && readHeader(itemCode, kind) && itemCode == code && kind == kText &&
+        m_arena.getVarUInt(length) && length == std::wcslen(pValue))
+    {
+        const Adesk::UInt8* const pChars = m_arena.take(static_cast<size_t>(length) * sizeof(ACHAR));
+        if (pChars != nullptr && std::memcmp(pChars, pValue, static_cast<size_t>(length) * sizeof(ACHAR)) == 0)
+        {
+            m_canPushBack = false;
+            return true;
+        }
+    }
+    m_arena.setPosition(position);
+    return false;
+}
+
+Acad::ErrorStatus ArenaDxfFiler::fail(Acad::ErrorStatus es)
+{
+    if (m_status == Acad::eOk)
+        m_status = es;
+    return m_status;
+}
+
+} // namespace acad_sheetset_to_pdf
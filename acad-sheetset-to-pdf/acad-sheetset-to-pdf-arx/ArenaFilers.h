@@ -0,0 +1,429 @@
+#pragma once
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// The bytes an arena filer writes and reads back, and the position in
+/// them.
+///
+/// Writing at the position overwrites and then extends what is there, as
+/// a file does.  Integers go in as varints, seven bits a byte; everything
+/// else goes in as it lies in memory.  The memory is kept when the arena
+/// is cleared, so one reused for object after object soon stops
+/// allocating.
+/// </summary>
+class FilerArena
+{
+public:
+    enum { kMaxVarIntSize = 10 };
+
+    explicit FilerArena(size_t capacity = 0);
+
+    const Adesk::UInt8* data() const { return m_bytes.data(); }
+    size_t size() const { return m_size; }
+    size_t position() const { return m_position; }
+    size_t remaining() const { return m_size - m_position; }
+
+    /// <summary>
+    /// Moves the position; false, without moving, if it is past the end.
+    /// </summary>
+    bool setPosition(size_t position);
+
+    /// <summary>
+    /// Replaces the contents with a copy of size bytes at pData and moves
+    /// the position to the start, to read what another arena wrote.
+    /// </summary>
+    Acad::ErrorStatus assign(const void* pData, size_t size);
+
+    void clear() { m_size = m_position = 0; }
+
+    /// <summary>
+    /// Room for size bytes at the position, which is moved past them, or
+    /// null if the memory for them could not be had.
+    /// </summary>
+    Adesk::UInt8* extend(size_t size)
+    {
+        Adesk::UInt8* const p = reserve(size);
+        if (p != nullptr)
+            advance(size);
+        return p;
+    }
+
+    /// <summary>
+    /// The next size bytes and moves past them, or null, without moving,
+    /// if fewer are left.
+    /// </summary>
+    const Adesk::UInt8* take(size_t size)
+    {
+        if (m_size - m_position < size)
+            return nullptr;
+        const Adesk::UInt8* const p = m_bytes.data() + m_position;
+        m_position += size;
+        return p;
+    }
+
+    bool put(const void* pData, size_t size)
+    {
+        Adesk::UInt8* const p = extend(size);
+        if (p == nullptr)
+            return false;
+        if (size != 0)
+            std::memcpy(p, pData, size);
+        return true;
+    }
+
+    bool get(void* pData, size_t size)
+    {
+        const Adesk::UInt8* const p = take(size);
+        if (p == nullptr)
+            return false;
+        if (size != 0)
+            std::memcpy(pData, p, size);
+        return true;
+    }
+
+    bool putVarUInt(Adesk::UInt64 value)
+    {
+        Adesk::UInt8* const pStart = reserve(kMaxVarIntSize);
+        if (pStart == nullptr)
+            return false;
+        Adesk::UInt8* p = pStart;
+        while (value >= 0x80)
+        {
+            *p++ = static_cast<Adesk::UInt8>(value | 0x80);
+            value >>= 7;
+        }
+        *p++ = static_cast<Adesk::UInt8>(value);
+        advance(static_cast<size_t>(p - pStart));
+        return true;
+    }
+
+    bool getVarUInt(Adesk::UInt64& value)
+    {
+        if (m_position < m_size && m_bytes[m_position] < 0x80)
+        {
+            value = m_bytes[m_position++];
+            return true;
+        }
+        Adesk::UInt64 result = 0;
+        for (unsigned shift = 0; shift < 64 && m_position < m_size; shift += 7)
+        {
+            const Adesk::UInt8 byte = m_bytes[m_position++];
+            result |= static_cast<Adesk::UInt64>(byte & 0x7F) << shift;
+            if (byte < 0x80)
+            {
+                value = result;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// <summary>
+    /// Signed integers are zigzagged first, so that small negative ones are
+    /// short too.
+    /// </summary>
+    bool putVarInt(Adesk::Int64 value)
+    {
+        return putVarUInt((static_cast<Adesk::UInt64>(value) << 1) ^ static_cast<Adesk::UInt64>(value >> 63));
+    }
+
+    bool getVarInt(Adesk::Int64& value)
+    {
+        Adesk::UInt64 zigzag;
+        if (!getVarUInt(zigzag))
+            return false;
+        value = static_cast<Adesk::Int64>((zigzag >> 1) ^ (0 - (zigzag & 1)));
+        return true;
+    }
+
+private:
+    Adesk::UInt8* reserve(size_t size)
+    {
+        if (m_bytes.size() - m_position < size && !grow(size))
+            return nullptr;
+        return m_bytes.data() + m_position;
+    }
+
+    void advance(size_t size)
+    {
+        m_position += size;
+        if (m_position > m_size)
+            m_size = m_position;
+    }
+
+    bool grow(size_t size);
+
+    std::vector<Adesk::UInt8>   m_bytes;        // sized to the capacity; m_size of them are used
+    size_t                      m_size;
+    size_t                      m_position;
+};
+
+/// <summary>
+/// A DWG filer over a FilerArena, for copying, snapshotting and undoing
+/// objects in memory.
+///
+/// Objects are written with dwgOutFields(), the filer is rewound with
+/// seek(0, AcDb::kSeekFromStart), and the same sequence is read back with
+/// dwgInFields().  Integers wider than a byte are stored as varints and
+/// carry no type, so one can be read back as any integer type it fits in:
+/// reading a value that does not fit, such as 70000 as an Int16, fails with
+/// Acad::eInvalidInput.  Object IDs and addresses are stored as they are in
+/// memory, so the bytes are only good in the session that wrote them.
+///
+/// The first error sticks: filerStatus() returns it and every call after
+/// it does nothing and returns it, until resetFilerStatus().  Reading past
+/// the end fails with Acad::eEndOfFile.
+///
+/// Code that knows it has an ArenaDwgFiler can also write and read arrays
+/// of doubles, points and IDs in one call each.  Strings read with
+/// readString(ACHAR**) are freed with acutDelString(), and binary chunks
+/// read with readBChunk() with delete[].
+/// </summary>
+class ArenaDwgFiler final : public AcDbDwgFiler
+{
+public:
+    explicit ArenaDwgFiler(AcDb::FilerType filerType = AcDb::kCopyFiler, size_t capacity = 0);
+    ~ArenaDwgFiler();
+
+    ArenaDwgFiler(const ArenaDwgFiler&) = delete;
+    ArenaDwgFiler& operator=(const ArenaDwgFiler&) = delete;
+
+    FilerArena& arena() { return m_arena; }
+    const FilerArena& arena() const { return m_arena; }
+
+    /// <summary>
+    /// Empties the arena and resets the status, keeping the memory.
+    /// </summary>
+    void clear();
+
+    Acad::ErrorStatus filerStatus() const override { return m_status; }
+    AcDb::FilerType filerType() const override { return m_filerType; }
+    void setFilerStatus(Acad::ErrorStatus es) override { m_status = es; }
+    void resetFilerStatus() override { m_status = Acad::eOk; }
+
+    Acad::ErrorStatus readHardOwnershipId(AcDbHardOwnershipId* pVal) override;
+    Acad::ErrorStatus writeHardOwnershipId(const AcDbHardOwnershipId& val) override;
+    Acad::ErrorStatus readSoftOwnershipId(AcDbSoftOwnershipId* pVal) override;
+    Acad::ErrorStatus writeSoftOwnershipId(const AcDbSoftOwnershipId& val) override;
+    Acad::ErrorStatus readHardPointerId(AcDbHardPointerId* pVal) override;
+    Acad::ErrorStatus writeHardPointerId(const AcDbHardPointerId& val) override;
+    Acad::ErrorStatus readSoftPointerId(AcDbSoftPointerId* pVal) override;
+    Acad::ErrorStatus writeSoftPointerId(const AcDbSoftPointerId& val) override;
+
+    Acad::ErrorStatus readInt8(Adesk::Int8* pVal) override;
+    Acad::ErrorStatus writeInt8(Adesk::Int8 val) override;
+    Acad::ErrorStatus readString(ACHAR** pVal) override;
+    Acad::ErrorStatus writeString(const ACHAR* pVal) override;
+    Acad::ErrorStatus readString(AcString& val) override;
+    Acad::ErrorStatus writeString(const AcString& val) override;
+    Acad::ErrorStatus readBChunk(ads_binary* pVal) override;
+    Acad::ErrorStatus writeBChunk(const ads_binary& val) override;
+    Acad::ErrorStatus readAcDbHandle(AcDbHandle* pVal) override;
+    Acad::ErrorStatus writeAcDbHandle(const AcDbHandle& val) override;
+
+    Acad::ErrorStatus readInt64(Adesk::Int64* pVal) override;
+    Acad::ErrorStatus writeInt64(Adesk::Int64 val) override;
+    Acad::ErrorStatus readInt32(Adesk::Int32* pVal) override;
+    Acad::ErrorStatus writeInt32(Adesk::Int32 val) override;
+    Acad::ErrorStatus readInt16(Adesk::Int16* pVal) override;
+    Acad::ErrorStatus writeInt16(Adesk::Int16 val) override;
+    Acad::ErrorStatus readUInt64(Adesk::UInt64* pVal) override;
+    Acad::ErrorStatus writeUInt64(Adesk::UInt64 val) override;
+    Acad::ErrorStatus readUInt32(Adesk::UInt32* pVal) override;
+    Acad::ErrorStatus writeUInt32(Adesk::UInt32 val) override;
+    Acad::ErrorStatus readUInt16(Adesk::UInt16* pVal) override;
+    Acad::ErrorStatus writeUInt16(Adesk::UInt16 val) override;
+    Acad::ErrorStatus readUInt8(Adesk::UInt8* pVal) override;
+    Acad::ErrorStatus writeUInt8(Adesk::UInt8 val) override;
+    Acad::ErrorStatus readBool(bool* pVal) override;
+    Acad::ErrorStatus writeBool(bool val) override;
+
+    Acad::ErrorStatus readDouble(double* pVal) override;
+    Acad::ErrorStatus writeDouble(double val) override;
+    Acad::ErrorStatus readPoint2d(AcGePoint2d* pVal) override;
+    Acad::ErrorStatus writePoint2d(const AcGePoint2d& val) override;
+    Acad::ErrorStatus readPoint3d(AcGePoint3d* pVal) override;
+    Acad::ErrorStatus writePoint3d(const AcGePoint3d& val) override;
+    Acad::ErrorStatus readVector2d(AcGeVector2d* pVal) override;
+    Acad::ErrorStatus writeVector2d(const AcGeVector2d& val) override;
+    Acad::ErrorStatus readVector3d(AcGeVector3d* pVal) override;
+    Acad::ErrorStatus writeVector3d(const AcGeVector3d& val) override;
+    Acad::ErrorStatus readScale3d(AcGeScale3d* pVal) override;
+    Acad::ErrorStatus writeScale3d(const AcGeScale3d& val) override;
+
+    Acad::ErrorStatus readBytes(void* pDest, Adesk::UIntPtr nBytes) override;
+    Acad::ErrorStatus writeBytes(const void* pSrc, Adesk::UIntPtr nBytes) override;
+    Acad::ErrorStatus readAddress(void** pVal) override;
+    Acad::ErrorStatus writeAddress(const void* pVal) override;
+
+    Acad::ErrorStatus seek(Adesk::Int64 nOffset, int nMethod) override;
+    Adesk::Int64 tell() const override { return static_cast<Adesk::Int64>(m_arena.position()); }
+
+    /// <summary>
+    /// count values as they lie in memory, without a count before them;
+    /// the reader has to know it.
+    /// </summary>
+    Acad::ErrorStatus readDoubles(double* pVals, size_t count);
+    Acad::ErrorStatus writeDoubles(const double* pVals, size_t count);
+    Acad::ErrorStatus readPoint2ds(AcGePoint2d* pVals, size_t count);
+    Acad::ErrorStatus writePoint2ds(const AcGePoint2d* pVals, size_t count);
+    Acad::ErrorStatus readPoint3ds(AcGePoint3d* pVals, size_t count);
+    Acad::ErrorStatus writePoint3ds(const AcGePoint3d* pVals, size_t count);
+    Acad::ErrorStatus readObjectIds(AcDbObjectId* pVals, size_t count);
+    Acad::ErrorStatus writeObjectIds(const AcDbObjectId* pVals, size_t count);
+
+    /// <summary>
+    /// Whole arrays, each after its length.
+    /// </summary>
+    Acad::ErrorStatus readArray(AcGeDoubleArray& vals);
+    Acad::ErrorStatus writeArray(const AcGeDoubleArray& vals);
+    Acad::ErrorStatus readArray(AcGePoint2dArray& vals);
+    Acad::ErrorStatus writeArray(const AcGePoint2dArray& vals);
+    Acad::ErrorStatus readArray(AcGePoint3dArray& vals);
+    Acad::ErrorStatus writeArray(const AcGePoint3dArray& vals);
+    Acad::ErrorStatus readArray(AcDbObjectIdArray& vals);
+    Acad::ErrorStatus writeArray(const AcDbObjectIdArray& vals);
+
+    Acad::ErrorStatus readVarUInt(Adesk::UInt64* pVal);
+    Acad::ErrorStatus writeVarUInt(Adesk::UInt64 val);
+    Acad::ErrorStatus readVarInt(Adesk::Int64* pVal);
+    Acad::ErrorStatus writeVarInt(Adesk::Int64 val);
+
+private:
+    template <class T> Acad::ErrorStatus readRaw(T* pVal, size_t count = 1);
+    template <class T> Acad::ErrorStatus writeRaw(const T* pVals, size_t count = 1);
+    Acad::ErrorStatus readId(AcDbObjectId* pVal);
+    Acad::ErrorStatus writeId(const AcDbObjectId& val);
+    Acad::ErrorStatus readSigned(Adesk::Int64* pVal, Adesk::Int64 minimum, Adesk::Int64 maximum);
+    Acad::ErrorStatus readUnsigned(Adesk::UInt64* pVal, Adesk::UInt64 maximum);
+    Acad::ErrorStatus readLength(size_t* pLength, size_t elementSize);
+    Acad::ErrorStatus fail(Acad::ErrorStatus es);
+
+    FilerArena          m_arena;
+    AcDb::FilerType     m_filerType;
+    Acad::ErrorStatus   m_status;
+    std::vector<ACHAR>  m_text;         // of the last string read into an AcString
+};
+
+/// <summary>
+/// A DXF filer over a FilerArena, for moving group-code data between
+/// objects in memory without formatting it as text.
+///
+/// Objects are written with dxfOutFields(), the filer is rewound with
+/// rewindFiler(), and dxfInFields() reads the items back with
+/// readItem(resbuf*), each as the resbuf the DXF reader would have made:
+/// restype is the group code, handles come back as hexadecimal strings and
+/// object IDs as ads_names.  The strings and binary chunks such a resbuf
+/// points to belong to the filer and last until the next item is read.
+/// Doubles are stored exactly; precisions are ignored.
+///
+/// The bulk writes put a run of values under one group code, such as the
+/// vertices of a polyline, in one item; they are read back one resbuf at a
+/// time like any other.  pushBackItem() undoes the last read.
+/// </summary>
+class ArenaDxfFiler final : public AcDbDxfFiler
+{
+public:
+    explicit ArenaDxfFiler(AcDbDatabase* pDb = nullptr, AcDb::FilerType filerType = AcDb::kCopyFiler,
+                           size_t capacity = 0);
+    ~ArenaDxfFiler();
+
+    ArenaDxfFiler(const ArenaDxfFiler&) = delete;
+    ArenaDxfFiler& operator=(const ArenaDxfFiler&) = delete;
+
+    FilerArena& arena() { return m_arena; }
+    const FilerArena& arena() const { return m_arena; }
+
+    /// <summary>
+    /// Empties the arena and resets the status, keeping the memory.
+    /// </summary>
+    void clear();
+
+    int rewindFiler() override;
+    Acad::ErrorStatus filerStatus() const override { return m_status; }
+    void resetFilerStatus() override { m_status = Acad::eOk; }
+    AcDb::FilerType filerType() const override { return m_filerType; }
+    AcDbDatabase* database() const override { return m_pDb; }
+
+    Acad::ErrorStatus readResBuf(resbuf* pRb) override;
+    Acad::ErrorStatus writeResBuf(const resbuf& rb) override;
+    Acad::ErrorStatus writeObjectId(AcDb::DxfCode code, const AcDbObjectId& id) override;
+    Acad::ErrorStatus writeInt8(AcDb::DxfCode code, Adesk::Int8 val) override;
+    Acad::ErrorStatus writeString(AcDb::DxfCode code, const ACHAR* pVal) override;
+    Acad::ErrorStatus writeString(AcDb::DxfCode code, const AcString& val) override;
+    Acad::ErrorStatus writeBChunk(AcDb::DxfCode code, const ads_binary& val) override;
+    Acad::ErrorStatus writeAcDbHandle(AcDb::DxfCode code, const AcDbHandle& val) override;
+    Acad::ErrorStatus writeInt64(AcDb::DxfCode code, Adesk::Int64 val) override;
+    Acad::ErrorStatus writeInt32(AcDb::DxfCode code, Adesk::Int32 val) override;
+    Acad::ErrorStatus writeInt16(AcDb::DxfCode code, Adesk::Int16 val) override;
+    Acad::ErrorStatus writeUInt64(AcDb::DxfCode code, Adesk::UInt64 val) override;
+    Acad::ErrorStatus writeUInt32(AcDb::DxfCode code, Adesk::UInt32 val) override;
+    Acad::ErrorStatus writeUInt16(AcDb::DxfCode code, Adesk::UInt16 val) override;
+    Acad::ErrorStatus writeUInt8(AcDb::DxfCode code, Adesk::UInt8 val) override;
+    Acad::ErrorStatus writeBool(AcDb::DxfCode code, bool val) override;
+    Acad::ErrorStatus writeDouble(AcDb::DxfCode code, double val, int prec = kDfltPrec) override;
+    Acad::ErrorStatus writePoint2d(AcDb::DxfCode code, const AcGePoint2d& val, int prec = kDfltPrec) override;
+    Acad::ErrorStatus writePoint3d(AcDb::DxfCode code, const AcGePoint3d& val, int prec = kDfltPrec) override;
+    Acad::ErrorStatus writeVector2d(AcDb::DxfCode code, const AcGeVector2d& val, int prec = kDfltPrec) override;
+    Acad::ErrorStatus writeVector3d(AcDb::DxfCode code, const AcGeVector3d& val, int prec = kDfltPrec) override;
+    Acad::ErrorStatus writeScale3d(AcDb::DxfCode code, const AcGeScale3d& val, int prec = kDfltPrec) override;
+    bool includesDefaultValues() const override { return true; }
+
+    Acad::ErrorStatus pushBackItem() override;
+    bool atEOF() override;
+    bool atSubclassData(const ACHAR* subClassName) override;
+    bool atExtendedData() override;
+    bool atEndOfObject() override;
+    Acad::ErrorStatus writeEmbeddedObjectStart() override;
+    bool atEmbeddedObjectStart() override;
+
+    /// <summary>
+    /// count values under one group code, read back as count items.
+    /// </summary>
+    Acad::ErrorStatus writeDoubles(AcDb::DxfCode code, const double* pVals, size_t count);
+    Acad::ErrorStatus writePoint3ds(AcDb::DxfCode code, const AcGePoint3d* pVals, size_t count);
+    Acad::ErrorStatus writeObjectIds(AcDb::DxfCode code, const AcDbObjectId* pVals, size_t count);
+
+private:
+    enum Kind
+    {
+        kReal,
+        kPoint,
+        kShort,
+        kLong,
+        kInt64,
+        kText,
+        kBinary,
+        kHandle,
+        kObjectId,
+        kRun            // a kind, a count and as many values, all under one code
+    };
+
+    struct Cursor
+    {
+        size_t          position;
+        int             runCode;
+        Kind            runKind;
+        Adesk::UInt64   runLeft;        // values left in the run being read
+    };
+
+    Acad::ErrorStatus put(int code, Kind kind, const void* pData, size_t size);
+    bool readHeader(int& code, Kind& kind);
+    bool peek(int& code, Kind& kind);
+    Acad::ErrorStatus readValue(Kind kind, resbuf* pRb);
+    bool nextIsString(int code, const ACHAR* pValue);
+    Acad::ErrorStatus fail(Acad::ErrorStatus es);
+
+    FilerArena          m_arena;
+    AcDbDatabase*       m_pDb;
+    AcDb::FilerType     m_filerType;
+    Acad::ErrorStatus   m_status;
+    Cursor              m_cursor;       // m_cursor.position is only kept in m_lastItem
+    Cursor              m_lastItem;     // where the last item read started
+    bool                m_canPushBack;
+    std::vector<ACHAR>  m_text;         // of the last string or handle read
+    std::vector<char>   m_chunk;        // of the last binary chunk read
+};
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,218 @@
+#include "stdafx.h"
+#include "AsyncFileWriteStream.h"
+#include "AtomicFile.h"
+#include "MappedFile.h"
+
+#include <cstring>
+#include <new>
+
+namespace acad_sheetset_to_pdf {
+
+AsyncFileWriteStream::AsyncFileWriteStream(const AsyncFileWriteStreamSettings& settings)
+    : m_settings(settings),
+      m_hFile(INVALID_HANDLE_VALUE),
+      m_filled(0),
+      m_total(0),
+      m_stalls(0),
+      m_handedOver(0),
+      m_written(0),
+      m_pendingBytes(0),
+      m_stop(false),
+      m_error(eNotOpen)
+{
+    m_settings.bufferSize = std::max<size_t>(m_settings.bufferSize, 4096);
+    m_settings.bufferCount = std::max(m_settings.bufferCount, 2u);
+}
+
+AsyncFileWriteStream::~AsyncFileWriteStream()
+{
+    close();
+}
+
+Acad::ErrorStatus AsyncFileWriteStream::create(const ACHAR* path)
+{
+    close();
+    if (path == nullptr)
+        return Acad::eNullPtr;
+    try
+    {
+        while (m_buffers.size() < m_settings.bufferCount)
+            m_buffers.emplace_back(new Adesk::UInt8[m_settings.bufferSize]);
+        m_sizes.resize(m_settings.bufferCount);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return Acad::eOutOfMemory;
+    }
+
+    m_hFile = ::CreateFileW(path, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_hFile == INVALID_HANDLE_VALUE)
+        return MappedFile::statusFromWin32(::GetLastError());
+    m_filled = 0;
+    m_total = 0;
+    m_stalls = 0;
+    m_handedOver = 0;
+    m_written = 0;
+    m_pendingBytes = 0;
+    m_stop = false;
+    m_error = eOk;
+    m_writer = std::thread([this] { writerLoop(); });
+    return Acad::eOk;
+}
+
+int AsyncFileWriteStream::read(void*, size_t, size_t* pNumRead)
+{
+    if (pNumRead != nullptr)
+        *pNumRead = 0;
+    return eNotSupported;
+}
+
+int AsyncFileWriteStream::write(const void* pSrcBuf, size_t nNumBytes, size_t* pNumWritten)
+{
+    if (pNumWritten != nullptr)
+        *pNumWritten = 0;
+    const int error = m_error.load(std::memory_order_relaxed);
+    if (error != eOk)
+        return error;
+    if (pSrcBuf == nullptr && nNumBytes != 0)
+        return eInvalidArg;
+
+    const Adesk::UInt8* p = static_cast<const Adesk::UInt8*>(pSrcBuf);
+    size_t left = nNumBytes;
+    while (left != 0)
+    {
+        Adesk::UInt8* const pBuffer = m_buffers[m_handedOver % m_settings.bufferCount].get();
+        const size_t count = std::min(left, m_settings.bufferSize - m_filled);
+        std::memcpy(pBuffer + m_filled, p, count);
+        m_filled += count;
+        p += count;
+        left -= count;
+        if (m_filled == m_settings.bufferSize)
+            handOver();
+    }
+    m_total += nNumBytes;
+    if (pNumWritten != nullptr)
+        *pNumWritten = nNumBytes;
+    return eOk;
+}
+
+Adesk::Int64 AsyncFileWriteStream::tell()
+{
+    return isOpen() ? static_cast<Adesk::Int64>(m_total) : -1;
+}
+
+int AsyncFileWriteStream::close()
+{
+    if (!isOpen())
+        return eNotOpen;
+    drain();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeWriter.notify_one();
+    m_writer.join();
+    ::CloseHandle(m_hFile);
+    m_hFile = INVALID_HANDLE_VALUE;
+    return m_error.exchange(eNotOpen);
+}
+
+int AsyncFileWriteStream::flushBuffers()
+{
+    if (!isOpen())
+        return eNotOpen;
+    drain();
+    if (m_error.load() == eOk && !::FlushFileBuffers(m_hFile))
+        m_error = MappedFile::streamStatusFromWin32(::GetLastError());
+    return m_error.load();
+}
+
+Adesk::Int64 AsyncFileWriteStream::control(Adesk::Int64 nArg)
+{
+    switch (nArg)
+    {
+    case kStatus:
+        return m_error.load();
+    case kDrain:
+        if (isOpen())
+            drain();
+        return m_error.load();
+    case kPendingBytes:
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return static_cast<Adesk::Int64>(m_pendingBytes);
+    }
+    default:
+        return eInvalidArg;
+    }
+}
+
+/* Hands the buffer being filled to the writer and waits, if it must, for
+the next one in the rotation to be written. */
+void AsyncFileWriteStream::handOver()
+{
+    const unsigned count = m_settings.bufferCount;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_sizes[m_handedOver % count] = m_filled;
+        m_pendingBytes += m_filled;
+        ++m_handedOver;
+    }
+    m_wakeWriter.notify_one();
+    m_filled = 0;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_handedOver - m_written >= count)
+    {
+        ++m_stalls;
+        m_bufferWritten.wait(lock, [&] { return m_handedOver - m_written < count; });
+    }
+}
+
+void AsyncFileWriteStream::drain()
+{
+    if (m_filled != 0)
+        handOver();
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_bufferWritten.wait(lock, [&] { return m_written == m_handedOver; });
+}
+
+/* Writes the buffers in the order they were handed over.  After an error
+they are still taken, and dropped, so that no producer waits for ever. */
+void AsyncFileWriteStream::writerLoop()
+{
+    for (;;)
+    {
+        size_t size;
+        const Adesk::UInt8* pBuffer;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeWriter.wait(lock, [&] { return m_stop || m_written != m_handedOver; });
+            if (m_written == m_handedOver)
+                return;
+            const size_t index = static_cast<size_t>(m_written % m_settings.bufferCount);
+            size = m_sizes[index];
+            pBuffer = m_buffers[index].get();
+        }
+
+        if (m_error.load(std::memory_order_relaxed) == eOk)
+        {
+            const DWORD error = writeFileFully(m_hFile, pBuffer, size);
+            if (error != ERROR_SUCCESS)
+            {
+                int expected = eOk;
+                m_error.compare_exchange_strong(expected, MappedFile::streamStatusFromWin32(error));
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_written;
+            m_pendingBytes -= size;
+        }
+        m_bufferWritten.notify_all();
+    }
+}
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "IAcReadWriteStream.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace acad_sheetset_to_pdf {
+
+struct AsyncFileWriteStreamSettings
+{
+    /// <summary>
+    /// Bytes in each buffer.
+    /// </summary>
+    size_t bufferSize = 4 << 20;
+
+    /// <summary>
+    /// Buffers in the rotation, at least two: one being filled while the
+    /// others are written.
+    /// </summary>
+    unsigned bufferCount = 3;
+};
+
+/// <summary>
+/// Writes a file without making the writer wait for the disk.
+///
+/// write() copies into the buffer being filled and returns; a full buffer
+/// is handed to a writer thread of the stream's own, and the next buffer in
+/// the rotation is filled meanwhile.  The writer only holds a producer up
+/// when every buffer is still waiting to be written, which stallCount()
+/// counts.  Buffers are written in the order they were filled.
+///
+/// flushBuffers() is durable: it hands over the buffer being filled, waits
+/// until everything is written and flushes the file to disk.  close() waits
+/// for the writes but does not flush to disk.
+///
+/// The writer's errors surface on the producer's side: control(kStatus)
+/// returns the first of them without waiting, control(kDrain) waits for the
+/// writes first, and write(), flushBuffers() and close() return it once it
+/// has happened.  After an error the rest of the data is dropped.
+///
+/// A stream is used by one producer thread at a time.
+/// </summary>
+class AsyncFileWriteStream : public IAcWriteStream
+{
+public:
+    /// <summary>
+    /// Arguments of control().
+    /// </summary>
+    enum Control
+    {
+        kStatus         = 0,    // first error, or eOk
+        kDrain          = 1,    // waits for the buffers handed over, then as kStatus
+        kPendingBytes   = 2     // bytes handed over that are not written yet
+    };
+
+    explicit AsyncFileWriteStream(const AsyncFileWriteStreamSettings& settings = AsyncFileWriteStreamSettings());
+    ~AsyncFileWriteStream();
+
+    AsyncFileWriteStream(const AsyncFileWriteStream&) = delete;
+    AsyncFileWriteStream& operator=(const AsyncFileWriteStream&) = delete;
+
+    /// <summary>
+    /// Creates the file at path, or truncates it, and starts the writer
+    /// thread.  Any file previously open is closed first.
+    /// </summary>
+    Acad::ErrorStatus create(const ACHAR* path);
+
+    int read(void* pDestBuf, size_t nNumBytes, size_t* pNumRead) override;
+    int write(const void* pSrcBuf, size_t nNumBytes, size_t* pNumWritten) override;
+    Adesk::Int64 tell() override;
+    int close() override;
+    int flushBuffers() override;
+    Adesk::Int64 control(Adesk::Int64 nArg) override;
+
+    bool isOpen() const { return m_hFile != INVALID_HANDLE_VALUE; }
+
+    /// <summary>
+    /// Times write() waited for a buffer to come free.
+    /// </summary>
+    Adesk::UInt64 stallCount() const { return m_stalls; }
+
+private:
+    void handOver();
+    void drain();
+    void writerLoop();
+
+    AsyncFileWriteStreamSettings                    m_settings;
+    HANDLE                                          m_hFile;
+    std::vector<std::unique_ptr<Adesk::UInt8[]>>    m_buffers;
+    std::vector<size_t>                             m_sizes;        // of the buffers handed over
+    size_t                                          m_filled;       // of the buffer being filled
+    Adesk::UInt64                                   m_total;
+    Adesk::UInt64                                   m_stalls;
+
+    std::mutex                                      m_mutex;
+    std::condition_variable                         m_wakeWriter;
+    std::condition_variable                         m_bufferWritten;
+    Adesk::UInt64                                   m_handedOver;   // buffers, ever; m_handedOver % count is being filled
+    Adesk::UInt64                                   m_written;      // buffers, ever
+    Adesk::UInt64                                   m_pendingBytes;
+    bool                                            m_stop;
+    std::atomic<int>                                m_error;
+    std::thread                                     m_writer;
+};
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,806 @@
+#include "stdafx.h"
+#include "AsyncPlotLogger.h"
+#include "AtomicFile.h"
+#include "MappedFile.h"
+
+#include <chrono>
+
+namespace acad_sheetset_to_pdf {
+
+struct AsyncPlotLogger::Slot
+{
+    std::atomic<size_t> sequence;
+    Adesk::Int64        time;               // microseconds since 1970-01-01 UTC
+    Adesk::UInt32       job;
+    Adesk::UInt32       sheet;
+    Adesk::UInt16       length;
+    Adesk::UInt8        categoryLength;
+    Adesk::UInt8        level;
+    bool                truncated;
+    ACHAR               category[kPlotLogCategoryCapacity];
+    ACHAR               message[kPlotLogMessageCapacity];
+};
+
+namespace {
+
+/* Longest formatted record: every character escaped as \u00XX, plus the
+fixed fields. */
+const size_t kMaxLineLength =
+    6 * (AsyncPlotLogger::kPlotLogMessageCapacity + AsyncPlotLogger::kPlotLogCategoryCapacity) + 256;
+const size_t kBatchCapacity = 64 * 1024;
+
+const char* const kLevelNames[] = { "terminal", "ari", "severe", "error", "warning", "message", "information" };
+
+/* Loggers registered for flushing on a crash.  Fixed storage, so that the
+exception handler reads it without taking locks.  s_crashFlushSequence is
+odd while the handler walks the table; a logger taken out of it waits for
+the walk in progress, if any, to end before it may be destroyed. */
+const int kMaxCrashLoggers = 8;
+std::atomic<AsyncPlotLogger*> s_crashLoggers[kMaxCrashLoggers];
+std::atomic<unsigned>         s_crashFlushSequence(0);
+std::mutex                    s_crashMutex;
+PVOID                         s_hCrashHandler = nullptr;
+
+/* Longest time the crash handler waits for the writer to finish a batch.
+The handler also runs for first-chance exceptions that something else will
+handle, so this is what such an exception can cost at most. */
+const std::chrono::milliseconds kEmergencyFlushWait(50);
+
+Adesk::Int64 unixMicroseconds()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/* Formats into a caller-provided buffer that is known to be large enough, so
+that records can be written from an exception handler without allocating. */
+class LineWriter
+{
+public:
+    explicit LineWriter(char* pOut) : m_pOut(pOut), m_pStart(pOut) {}
+
+    size_t size() const { return size_t(m_pOut - m_pStart); }
+
+    void ascii(const char* text)
+    {
+        while (*text != 0)
+            *m_pOut++ = *text++;
+    }
+
+    void number(Adesk::UInt64 value, int minimumDigits = 1)
+    {
+        char digits[20];
+        int count = 0;
+        do
+        {
+            digits[count++] = char('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        while (count < minimumDigits)
+            digits[count++] = '0';
+        while (count > 0)
+            *m_pOut++ = digits[--count];
+    }
+
+    /* ISO 8601 in UTC, using the days-to-civil conversion of Howard Hinnant's
+    date algorithms. */
+    void timestamp(Adesk::Int64 microseconds)
+    {
+        Adesk::Int64 seconds = microseconds / 1000000;
+        Adesk::Int64 fraction = microseconds % 1000000;
+        if (fraction < 0)
+        {
+            fraction += 1000000;
+            --seconds;
+        }
+        Adesk::Int64 days = seconds / 86400;
+        Adesk::Int64 secondOfDay = seconds % 86400;
+        if (secondOfDay < 0)
+        {
+            secondOfDay += 86400;
+            --days;
+        }
+
+        const Adesk::Int64 z = days + 719468;
+        const Adesk::Int64 era = (z >= 0 ? z : z - 146096) / 146097;
+        const Adesk::Int64 dayOfEra = z - era * 146097;
+        const Adesk::Int64 yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+        const Adesk::Int64 dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+        const Adesk::Int64 monthIndex = (5 * dayOfYear + 2) / 153;
+        const Adesk::Int64 day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+        const Adesk::Int64 month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+        const Adesk::Int64 year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+
+        number(Adesk::UInt64(std::max<Adesk::Int64>(year, 0)), 4);
+        *m_pOut++ = '-';
+        number(Adesk::UInt64(month), 2);
+        *m_pOut++ = '-';
+        number(Adesk::UInt64(day), 2);
+        *m_pOut++ = 'T';
+        number(Adesk::UInt64(secondOfDay / 3600), 2);
+        *m_pOut++ = ':';
+        number(Adesk::UInt64(secondOfDay / 60 % 60), 2);
+        *m_pOut++ = ':';
+        number(Adesk::UInt64(secondOfDay % 60), 2);
+        *m_pOut++ = '.';
+        number(Adesk::UInt64(fraction), 6);
+        *m_pOut++ = 'Z';
+    }
+
+    /* A JSON string literal, encoded as UTF-8.  ACHAR is UTF-16 on Windows;
+    a surrogate pair becomes one four-byte sequence, a lone surrogate
+    U+FFFD. */
+    void string(const ACHAR* text, size_t length)
+    {
+        *m_pOut++ = '"';
+        for (size_t i = 0; i < length; ++i)
+        {
+            Adesk::UInt32 c = Adesk::UInt32(text[i]);
+            if (c >= 0xD800 && c <= 0xDBFF && i + 1 < length && Adesk::UInt32(text[i + 1]) >= 0xDC00 &&
+                Adesk::UInt32(text[i + 1]) <= 0xDFFF)
+            {
+                c = 0x10000 + ((c - 0xD800) << 10) + (Adesk::UInt32(text[++i]) - 0xDC00);
+            }
+            else if (c >= 0xD800 && c <= 0xDFFF)
+            {
+                c = 0xFFFD;
+            }
+
+            switch (c)
+            {
+            case '"':
+                ascii("\\\"");
+                break;
+            case '\\':
+                ascii("\\\\");
+                break;
+            case '\n':
+                ascii("\\n");
+                break;
+            case '\r':
+                ascii("\\r");
+                break;
+            case '\t':
+                ascii("\\t");
+                break;
+            default:
+                if (c < 0x20)
+                {
+                    static const char kHex[] = "0123456789abcdef";
+                    ascii("\\u00");
+                    *m_pOut++ = kHex[c >> 4];
+                    *m_pOut++ = kHex[c & 15];
+                }
+                else if (c < 0x80)
+                {
+                    *m_pOut++ = char(c);
+                }
+                else if (c < 0x800)
+                {
+                    *m_pOut++ = char(0xC0 | (c >> 6));
+                    *m_pOut++ = char(0x80 | (c & 0x3F));
+                }
+                else if (c < 0x10000)
+                {
+                    *m_pOut++ = char(0xE0 | (c >> 12));
+                    *m_pOut++ = char(0x80 | ((c >> 6) & 0x3F));
+                    *m_pOut++ = char(0x80 | (c & 0x3F));
+                }
+                else
+                {
+                    *m_pOut++ = char(0xF0 | (c >> 18));
+                    *m_pOut++ = char(0x80 | ((c >> 12) & 0x3F));
+                    *m_pOut++ = char(0x80 | ((c >> 6) & 0x3F));
+                    *m_pOut++ = char(0x80 | (c & 0x3F));
+                }
+            }
+        }
+        *m_pOut++ = '"';
+    }
+
+private:
+    char* m_pOut;
+    char* m_pStart;
+};
+
+size_t formatRecord(char* pOut, Adesk::Int64 time, int level, Adesk::UInt32 job, Adesk::UInt32 sheet,
+                    const ACHAR* category, size_t categoryLength, const ACHAR* message, size_t messageLength,
+                    bool truncated, Adesk::UInt64 discarded)
+{
+    LineWriter line(pOut);
+    line.ascii("{\"time\":\"");
+    line.timestamp(time);
+    line.ascii("\",\"level\":\"");
+    line.ascii(kLevelNames[level]);
+    line.ascii("\",\"job\":");
+    line.number(job);
+    line.ascii(",\"sheet\":");
+    line.number(sheet);
+    line.ascii(",\"category\":");
+    line.string(category, categoryLength);
+    line.ascii(",\"message\":");
+    line.string(message, messageLength);
+    if (truncated)
+        line.ascii(",\"truncated\":true");
+    if (discarded != 0)
+    {
+        line.ascii(",\"discarded\":");
+        line.number(discarded);
+    }
+    line.ascii("}\n");
+    return line.size();
+}
+
+size_t copyText(ACHAR* pOut, size_t capacity, const ACHAR* text, bool& truncated)
+{
+    size_t length = 0;
+    if (text != nullptr)
+    {
+        while (length < capacity && text[length] != 0)
+        {
+            pOut[length] = text[length];
+            ++length;
+        }
+        truncated = length == capacity && text[length] != 0;
+    }
+    return length;
+}
+
+bool isFatalException(DWORD code)
+{
+    /* Stack overflows are left alone: there is no stack left to format on. */
+    switch (code)
+    {
+    case EXCEPTION_ACCESS_VIOLATION:
+    case EXCEPTION_ILLEGAL_INSTRUCTION:
+    case EXCEPTION_PRIV_INSTRUCTION:
+    case EXCEPTION_IN_PAGE_ERROR:
+    case EXCEPTION_INT_DIVIDE_BY_ZERO:
+    case STATUS_HEAP_CORRUPTION:
+        return true;
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+/* PlotLogFileSink --------------------------------------------------------- */
+
+PlotLogFileSink::PlotLogFileSink()
+    : m_hFile(INVALID_HANDLE_VALUE)
+{
+}
+
+PlotLogFileSink::~PlotLogFileSink()
+{
+    close();
+}
+
+Acad::ErrorStatus PlotLogFileSink::open(const ACHAR* path)
+{
+    close();
+    if (path == nullptr)
+        return Acad::eNullPtr;
+
+    /* FILE_APPEND_DATA without FILE_WRITE_DATA makes every write an atomic
+    append.  Sharing everything lets the console driver copy the log while
+    AutoCAD still has it open. */
+    m_hFile = ::CreateFileW(path, FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_hFile == INVALID_HANDLE_VALUE)
+        return MappedFile::statusFromWin32(::GetLastError());
+    return Acad::eOk;
+}
+
+void PlotLogFileSink::close()
+{
+    if (m_hFile != INVALID_HANDLE_VALUE)
+    {
+        ::CloseHandle(m_hFile);
+        m_hFile = INVALID_HANDLE_VALUE;
+    }
+}
+
+Acad::ErrorStatus PlotLogFileSink::write(const char* pData, size_t size)
+{
+    if (m_hFile == INVALID_HANDLE_VALUE)
+        return Acad::eNotOpenForWrite;
+    return MappedFile::statusFromWin32(writeFileFully(m_hFile, pData, size));
+}
+
+Acad::ErrorStatus PlotLogFileSink::flush()
+{
+    if (m_hFile == INVALID_HANDLE_VALUE)
+        return Acad::eNotOpenForWrite;
+    if (!::FlushFileBuffers(m_hFile))
+        return MappedFile::statusFromWin32(::GetLastError());
+    return Acad::eOk;
+}
+
+/* AsyncPlotLogger --------------------------------------------------------- */
+
+AsyncPlotLogger::AsyncPlotLogger(PlotLogSink& sink, const AsyncPlotLoggerSettings& settings)
+    : m_sink(sink)
+    , m_settings(settings)
+    , m_mask(0)
+    , m_enqueuePos(0)
+    , m_dequeuePos(0)
+    , m_writtenPos(0)
+    , m_draining(false)
+    , m_discarded(0)
+    , m_discardedReported(0)
+    , m_job(0)
+    , m_sheet(0)
+    , m_errorInSheet(false)
+    , m_warningInSheet(false)
+    , m_errorInJob(false)
+    , m_warningInJob(false)
+    , m_wakeRequested(false)
+    , m_stop(false)
+    , m_sinkStatus(Acad::eOk)
+    , m_batch(new char[kBatchCapacity])
+{
+    size_t capacity = 2;
+    while (capacity < m_settings.capacity)
+        capacity *= 2;
+    m_mask = capacity - 1;
+    m_slots.reset(new Slot[capacity]);
+    for (size_t i = 0; i < capacity; ++i)
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    m_settings.drainIntervalMilliseconds = std::max(m_settings.drainIntervalMilliseconds, 1u);
+
+    m_writer = std::thread([this] { writerLoop(); });
+}
+
+AsyncPlotLogger::~AsyncPlotLogger()
+{
+    enableCrashFlush(false);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeWriter.notify_one();
+    m_writer.join();
+    m_sink.flush();
+}
+
+Acad::ErrorStatus AsyncPlotLogger::startJob()
+{
+    m_job.fetch_add(1, std::memory_order_relaxed);
+    m_sheet.store(0, std::memory_order_relaxed);
+    m_errorInJob.store(false, std::memory_order_relaxed);
+    m_warningInJob.store(false, std::memory_order_relaxed);
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus AsyncPlotLogger::startSheet()
+{
+    m_sheet.fetch_add(1, std::memory_order_relaxed);
+    m_errorInSheet.store(false, std::memory_order_relaxed);
+    m_warningInSheet.store(false, std::memory_order_relaxed);
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus AsyncPlotLogger::endSheet()
+{
+    return Acad::eOk;
+}
+
+/* A job's records are written out when it ends, so that whoever picks up
+the log after the job (the console driver) finds all of it. */
+Acad::ErrorStatus AsyncPlotLogger::endJob()
+{
+    return flush();
+}
+
+bool AsyncPlotLogger::errorHasHappenedInSheet() const
+{
+    return m_errorInSheet.load(std::memory_order_relaxed);
+}
+
+bool AsyncPlotLogger::warningHasHappenedInSheet() const
+{
+    return m_warningInSheet.load(std::memory_order_relaxed);
+}
+
+bool AsyncPlotLogger::errorHasHappenedInJob() const
+{
+    return m_errorInJob.load(std::memory_order_relaxed);
+}
+
+bool AsyncPlotLogger::warningHasHappenedInJob() const
+{
+    return m_warningInJob.load(std::memory_order_relaxed);
+}
+
+Acad::ErrorStatus AsyncPlotLogger::logTerminalError(const ACHAR* pErrorString)
+{
+    return log(kPlotLogTerminal, ACRX_T("plot"), pErrorString);
+}
+
+Acad::ErrorStatus AsyncPlotLogger::logARIError(const ACHAR* pErrorString)
+{
+    return log(kPlotLogARI, ACRX_T("plot"), pErrorString);
+}
+
+Acad::ErrorStatus AsyncPlotLogger::logSevereError(const ACHAR* pErrorString)
+{
+    return log(kPlotLogSevere, ACRX_T("plot"), pErrorString);
+}
+
+Acad::ErrorStatus AsyncPlotLogger::logError(const ACHAR* pErrorString)
+{
+    return log(kPlotLogError, ACRX_T("plot"), pErrorString);
+}
+
+Acad::ErrorStatus AsyncPlotLogger::logWarning(const ACHAR* pWarningString)
+{
+    return log(kPlotLogWarning, ACRX_T("plot"), pWarningString);
+}
+
+Acad::ErrorStatus AsyncPlotLogger::logMessage(const ACHAR* pMessageString)
+{
+    return log(kPlotLogMessage, ACRX_T("plot"), pMessageString);
+}
+
+Acad::ErrorStatus AsyncPlotLogger::logInformation(const ACHAR* pMessageString)
+{
+    return log(kPlotLogInformation, ACRX_T("plot"), pMessageString);
+}
+
+Acad::ErrorStatus AsyncPlotLogger::log(PlotLogLevel level, const ACHAR* category, const ACHAR* text)
+{
+    if (level < kPlotLogTerminal || level > kPlotLogInformation)
+        return Acad::eInvalidInput;
+
+    if (level <= kPlotLogError)
+    {
+        m_errorInSheet.store(true, std::memory_order_relaxed);
+        m_errorInJob.store(true, std::memory_order_relaxed);
+    }
+    else if (level == kPlotLogWarning)
+    {
+        m_warningInSheet.store(true, std::memory_order_relaxed);
+        m_warningInJob.store(true, std::memory_order_relaxed);
+    }
+
+    const bool mayWait = m_settings.overflow == kPlotLogWait ||
+                         (m_settings.overflow == kPlotLogWaitForErrors && level <= kPlotLogError);
+    for (unsigned attempt = 0; !enqueue(level, category, text); ++attempt)
+    {
+        if (!mayWait)
+        {
+            m_discarded.fetch_add(1, std::memory_order_relaxed);
+            return Acad::eOk;
+        }
+        wake();
+        if (attempt < 64)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    if (level <= m_settings.flushLevel)
+        flush();
+    return Acad::eOk;
+}
+
+bool AsyncPlotLogger::enqueue(PlotLogLevel level, const ACHAR* category, const ACHAR* text)
+{
+    size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+    Slot* pSlot = nullptr;
+    for (;;)
+    {
+        pSlot = &m_slots[pos & m_mask];
+        const size_t sequence = pSlot->sequence.load(std::memory_order_acquire);
+        const std::ptrdiff_t difference = std::ptrdiff_t(sequence - pos);
+        if (difference == 0)
+        {
+            if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0)
+        {
+            return false;
+        }
+        else
+        {
+            pos = m_enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    /* A record is marked truncated if its category or its message was cut. */
+    bool categoryTruncated = false;
+    bool messageTruncated = false;
+    pSlot->time = unixMicroseconds();
+    pSlot->job = m_job.load(std::memory_order_relaxed);
+    pSlot->sheet = m_sheet.load(std::memory_order_relaxed);
+    pSlot->level = Adesk::UInt8(level);
+    pSlot->categoryLength =
+        Adesk::UInt8(copyText(pSlot->category, kPlotLogCategoryCapacity, category, categoryTruncated));
+    pSlot->length = Adesk::UInt16(copyText(pSlot->message, kPlotLogMessageCapacity, text, messageTruncated));
+    pSlot->truncated = categoryTruncated || messageTruncated;
+    pSlot->sequence.store(pos + 1, std::memory_order_release);
+
+    /* m_writtenPos trails the slots freed by at most one batch, which is
+    close enough to decide when the writer is worth waking early. */
+    if (pos + 1 - m_writtenPos.load(std::memory_order_relaxed) > (m_mask + 1) / 2 || level <= kPlotLogError)
+        wake();
+    return true;
+}
+
+void AsyncPlotLogger::wake()
+{
+    if (!m_wakeRequested.exchange(true, std::memory_order_acq_rel))
+        m_wakeWriter.notify_one();
+}
+
+void AsyncPlotLogger::writerLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        const bool stop = m_stop;
+        m_wakeWriter.wait_for(lock, std::chrono::milliseconds(m_settings.drainIntervalMilliseconds),
+                              [this] { return m_stop || m_wakeRequested.load(std::memory_order_acquire); });
+        m_wakeRequested.store(false, std::memory_order_release);
+        lock.unlock();
+        drain();
+        lock.lock();
+        m_drained.notify_all();
+        if (stop)
+            break;
+    }
+}
+
+bool AsyncPlotLogger::acquireDrain(unsigned maxSpins)
+{
+    for (unsigned spin = 0; m_draining.exchange(true, std::memory_order_acquire); ++spin)
+    {
+        if (spin >= maxSpins)
+            return false;
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+void AsyncPlotLogger::drain()
+{
+    acquireDrain(~0u);
+    drainLocked(m_batch.get(), kBatchCapacity, true);
+    m_draining.store(false, std::memory_order_release);
+}
+
+/* Formats every published record into pBatch and writes it out whenever the
+next record might not fit.  Slots are handed back to producers as soon as
+they are formatted; m_writtenPos only moves once the sink has the data. */
+void AsyncPlotLogger::drainLocked(char* pBatch, size_t batchCapacity, bool reportDiscarded)
+{
+    size_t used = 0;
+    size_t pos = m_dequeuePos;
+    auto writeBatch = [&]
+    {
+        if (used != 0)
+        {
+            const Acad::ErrorStatus es = m_sink.write(pBatch, used);
+            Acad::ErrorStatus expected = Acad::eOk;
+            if (es != Acad::eOk)
+                m_sinkStatus.compare_exchange_strong(expected, es);
+            used = 0;
+        }
+        m_writtenPos.store(pos, std::memory_order_release);
+    };
+
+    for (;;)
+    {
+        Slot& slot = m_slots[pos & m_mask];
+        if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+            break;
+        if (batchCapacity - used < kMaxLineLength)
+            writeBatch();
+        used += formatRecord(pBatch + used, slot.time, slot.level, slot.job, slot.sheet, slot.category,
+                             slot.categoryLength, slot.message, slot.length, slot.truncated, 0);
+        slot.sequence.store(pos + m_mask + 1, std::memory_order_release);
+        m_dequeuePos = ++pos;
+    }
+
+    const Adesk::UInt64 discarded = m_discarded.load(std::memory_order_relaxed);
+    if (reportDiscarded && discarded != m_discardedReported)
+    {
+        if (batchCapacity - used < kMaxLineLength)
+            writeBatch();
+        static const ACHAR kNote[] = ACRX_T("records were discarded because the log was full");
+        static const ACHAR kCategory[] = ACRX_T("log");
+        used += formatRecord(pBatch + used, unixMicroseconds(), kPlotLogWarning,
+                             m_job.load(std::memory_order_relaxed), m_sheet.load(std::memory_order_relaxed),
+                             kCategory, sizeof(kCategory) / sizeof(ACHAR) - 1, kNote,
+                             sizeof(kNote) / sizeof(ACHAR) - 1, false, discarded - m_discardedReported);
+        m_discardedReported = discarded;
+    }
+    writeBatch();
+}
+
+Acad::ErrorStatus AsyncPlotLogger::flush()
+{
+    const size_t target = m_enqueuePos.load(std::memory_order_acquire);
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_writtenPos.load(std::memory_order_acquire) < target && !m_stop)
+        {
+            m_wakeRequested.store(true, std::memory_order_release);
+            m_wakeWriter.notify_one();
+            m_drained.wait_for(lock, std::chrono::milliseconds(m_settings.drainIntervalMilliseconds));
+        }
+    }
+
+    acquireDrain(~0u);
+    Acad::ErrorStatus es = m_sink.flush();
+    m_draining.store(false, std::memory_order_release);
+    const Acad::ErrorStatus writeStatus = m_sinkStatus.exchange(Acad::eOk);
+    return writeStatus != Acad::eOk ? writeStatus : es;
+}
+
+void AsyncPlotLogger::emergencyFlush()
+{
+    if (m_writtenPos.load(std::memory_order_acquire) == m_enqueuePos.load(std::memory_order_acquire))
+        return;
+
+    /* The writer normally finishes a batch within milliseconds; if it does
+    not let go, it is probably the thread that crashed, or stuck on the disk. */
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + kEmergencyFlushWait;
+    while (!acquireDrain(64))
+    {
+        if (std::chrono::steady_clock::now() >= deadline)
+            return;
+    }
+    char batch[2 * kMaxLineLength];
+    drainLocked(batch, sizeof(batch), false);
+    m_sink.flush();
+    m_draining.store(false, std::memory_order_release);
+}
+
+void AsyncPlotLogger::enableCrashFlush(bool enable)
+{
+    std::lock_guard<std::mutex> lock(s_crashMutex);
+    int registered = 0;
+    bool present = false;
+    for (std::atomic<AsyncPlotLogger*>& entry : s_crashLoggers)
+    {
+        AsyncPlotLogger* pLogger = entry.load();
+        if (pLogger == this)
+        {
+            if (!enable)
+            {
+                entry.store(nullptr);
+                continue;
+            }
+            present = true;
+        }
+        if (entry.load() != nullptr)
+            ++registered;
+    }
+    if (enable && !present)
+    {
+        for (std::atomic<AsyncPlotLogger*>& entry : s_crashLoggers)
+        {
+            if (entry.load() == nullptr)
+            {
+                entry.store(this);
+                ++registered;
+                break;
+            }
+        }
+    }
+
+    if (registered != 0 && s_hCrashHandler == nullptr)
+        s_hCrashHandler = ::AddVectoredExceptionHandler(0, &AsyncPlotLogger::crashHandler);
+    else if (registered == 0 && s_hCrashHandler != nullptr)
+    {
+        ::RemoveVectoredExceptionHandler(s_hCrashHandler);
+        s_hCrashHandler = nullptr;
+    }
+
+    /* A handler that read this logger from the table before it was taken
+    out may still be flushing it.  The flush is bounded, so this is too. */
+    if (!enable)
+    {
+        const unsigned sequence = s_crashFlushSequence.load();
+        if (sequence % 2 != 0)
+        {
+            while (s_crashFlushSequence.load() == sequence)
+                std::this_thread::yield();
+        }
+    }
+}
+
+/* Vectored handlers also see first-chance exceptions that something else
+will handle; flushing the log early is harmless then, and costs nothing when
+the writer has caught up. */
+LONG NTAPI AsyncPlotLogger::crashHandler(PEXCEPTION_POINTERS pException)
+{
+    if (pException == nullptr || pException->ExceptionRecord == nullptr ||
+        !isFatalException(pException->ExceptionRecord->ExceptionCode))
+        return EXCEPTION_CONTINUE_SEARCH;
+    unsigned sequence = s_crashFlushSequence.load();
+    if (sequence % 2 != 0 || !s_crashFlushSequence.compare_exchange_strong(sequence, sequence + 1))
+        return EXCEPTION_CONTINUE_SEARCH;
+    for (std::atomic<AsyncPlotLogger*>& entry : s_crashLoggers)
+    {
+        AsyncPlotLogger* pLogger = entry.load();
+        if (pLogger != nullptr)
+            pLogger->emergencyFlush();
+    }
+    s_crashFlushSequence.store(sequence + 2);
+    return EXCEPTION_CONTINUE_SEARCH;
+}
+
+/* InstalledPlotLog ------------------------------------------------------- */
+
+InstalledPlotLog::InstalledPlotLog()
+{
+}
+
+InstalledPlotLog::~InstalledPlotLog()
+{
+    uninstall();
+}
+
+Acad::ErrorStatus InstalledPlotLog::install(const ACHAR* path, const AsyncPlotLoggerSettings& settings)
+{
+    if (path == nullptr)
+        return Acad::eNullPtr;
+    uninstall();
+
+    Acad::ErrorStatus es = m_sink.open(path);
+    if (es != Acad::eOk)
+        return es;
+    try
+    {
+        m_pLogger.reset(new AsyncPlotLogger(m_sink, settings));
+        m_pHandler.reset(new AcPlPlotLoggingErrorHandler(m_pLogger.get()));
+    }
+    catch (const std::bad_alloc&)
+    {
+        es = Acad::eOutOfMemory;
+    }
+    if (es == Acad::eOk && !m_lock.lock(m_pHandler.get(), ACRX_T("acad-sheetset-to-pdf")))
+        es = Acad::eAlreadyActive;
+    if (es != Acad::eOk)
+    {
+        m_pHandler.reset();
+        m_pLogger.reset();
+        m_sink.close();
+        return es;
+    }
+    m_pLogger->enableCrashFlush(true);
+    return Acad::eOk;
+}
+
+void InstalledPlotLog::uninstall()
+{
+    if (m_pLogger == nullptr)
+        return;
+    m_lock.unLock(m_pHandler.get());
+    m_pHandler.reset();
+    m_pLogger.reset();
+    m_sink.close();
+}
+
+void plotLogCommand(InstalledPlotLog& log)
+{
+    AcString path;
+    if (acedGetString(1, ACRX_T("\nFile to log plots to <none>: "), path) != RTNORM)
+        return;
+    if (path.isEmpty())
+    {
+        log.uninstall();
+        acutPrintf(ACRX_T("\nPlots are no longer logged.\n"));
+        return;
+    }
+    const Acad::ErrorStatus es = log.install(path.kwszPtr());
+    if (es != Acad::eOk)
+        acutPrintf(ACRX_T("\nCould not log plots to %s: %s\n"), path.kwszPtr(), acadErrorStatusText(es));
+}
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// Severity of a log record, one per AcPlPlotLogger method, most severe
+/// first.
+/// </summary>
+enum PlotLogLevel
+{
+    kPlotLogTerminal,
+    kPlotLogARI,
+    kPlotLogSevere,
+    kPlotLogError,
+    kPlotLogWarning,
+    kPlotLogMessage,
+    kPlotLogInformation
+};
+
+/// <summary>
+/// What a producer does when the ring is full.
+/// </summary>
+enum PlotLogOverflow
+{
+    kPlotLogDiscard,            // drop the record and count it
+    kPlotLogWait,               // wait for the writer thread to make room
+    kPlotLogWaitForErrors       // wait for errors and worse, drop the rest
+};
+
+/// <summary>
+/// Where AsyncPlotLogger writes to.  Only ever called from one thread at a
+/// time, with whole UTF-8 lines.
+/// </summary>
+class PlotLogSink
+{
+public:
+    virtual ~PlotLogSink() {}
+    virtual Acad::ErrorStatus write(const char* pData, size_t size) = 0;
+    virtual Acad::ErrorStatus flush() = 0;
+};
+
+/// <summary>
+/// Appends to a file, which other processes may read, copy and even delete
+/// while it is open.
+/// </summary>
+class PlotLogFileSink : public PlotLogSink
+{
+public:
+    PlotLogFileSink();
+    ~PlotLogFileSink();
+
+    PlotLogFileSink(const PlotLogFileSink&) = delete;
+    PlotLogFileSink& operator=(const PlotLogFileSink&) = delete;
+
+    Acad::ErrorStatus open(const ACHAR* path);
+    void close();
+
+    Acad::ErrorStatus write(const char* pData, size_t size) override;
+    Acad::ErrorStatus flush() override;
+
+private:
+    HANDLE m_hFile;
+};
+
+struct AsyncPlotLoggerSettings
+{
+    /// <summary>
+    /// Records the ring holds, rounded up to a power of two.  Every record
+    /// takes a little over 2 KB.
+    /// </summary>
+    size_t capacity = 1024;
+
+    PlotLogOverflow overflow = kPlotLogWaitForErrors;
+
+    /// <summary>
+    /// Longest time a record waits before the writer thread picks it up.
+    /// The writer is woken earlier when the ring is half full.
+    /// </summary>
+    unsigned drainIntervalMilliseconds = 50;
+
+    /// <summary>
+    /// Records this severe or worse are written and flushed to disk before
+    /// the logging call returns, since the process may not survive them.
+    /// </summary>
+    PlotLogLevel flushLevel = kPlotLogTerminal;
+};
+
+/// <summary>
+/// An AcPlPlotLogger that never makes the plot thread wait for the disk.
+///
+/// AutoCAD's own logger writes every record synchronously, so a slow or
+/// unreachable log share stalls plotting.  Here a logging call copies the
+/// record into a slot of a bounded multi-producer ring (Vyukov's sequence
+/// numbered queue: one compare-and-swap to claim a slot, one release store
+/// to publish it) and returns.  A writer thread drains the ring every
+/// drainIntervalMilliseconds, formats the records as JSON lines and hands
+/// them to the sink in batches of up to 64 KB.
+///
+/// Every record carries the job and sheet it belongs to (counted by
+/// startJob and startSheet), a category and its severity.  Records that
+/// cannot be queued are handled by the overflow policy; discarded ones are
+/// reported in the log once the writer catches up.
+///
+/// Plot errors reach the logger through AutoCAD's logging error handler:
+/// construct an AcPlPlotLoggingErrorHandler with the logger and lock it in
+/// with AcPlPlotErrorHandlerLock.  enableCrashFlush() additionally writes
+/// out whatever is still queued when the process takes a fatal exception.
+/// </summary>
+class AsyncPlotLogger : public AcPlPlotLogger
+{
+public:
+    enum
+    {
+        kPlotLogMessageCapacity = 1024,     // characters kept of a message
+        kPlotLogCategoryCapacity = 32       // characters kept of a category
+    };
+
+    explicit AsyncPlotLogger(PlotLogSink& sink, const AsyncPlotLoggerSettings& settings = AsyncPlotLoggerSettings());
+
+    /// <summary>
+    /// Writes out everything queued and stops the writer thread.
+    /// </summary>
+    ~AsyncPlotLogger();
+
+    AsyncPlotLogger(const AsyncPlotLogger&) = delete;
+    AsyncPlotLogger& operator=(const AsyncPlotLogger&) = delete;
+
+    Acad::ErrorStatus startJob() override;
+    Acad::ErrorStatus startSheet() override;
+    Acad::ErrorStatus logTerminalError(const ACHAR* pErrorString) override;
+    Acad::ErrorStatus logARIError(const ACHAR* pErrorString) override;
+    Acad::ErrorStatus logSevereError(const ACHAR* pErrorString) override;
+    Acad::ErrorStatus logError(const ACHAR* pErrorString) override;
+    Acad::ErrorStatus logWarning(const ACHAR* pWarningString) override;
+    Acad::ErrorStatus logMessage(const ACHAR* pMessageString) override;
+    Acad::ErrorStatus logInformation(const ACHAR* pMessageString) override;
+    Acad::ErrorStatus endSheet() override;
+    bool errorHasHappenedInSheet() const override;
+    bool warningHasHappenedInSheet() const override;
+    Acad::ErrorStatus endJob() override;
+    bool errorHasHappenedInJob() const override;
+    bool warningHasHappenedInJob() const override;
+
+    /// <summary>
+    /// Queues a record.  The AcPlPlotLogger methods log with category
+    /// "plot".  Returns Acad::eOk even if the overflow policy discarded the
+    /// record, so that a full log never fails a plot.
+    /// </summary>
+    Acad::ErrorStatus log(PlotLogLevel level, const ACHAR* category, const ACHAR* text);
+
+    /// <summary>
+    /// Waits until every record queued before the call is written, then
+    /// flushes the sink.  Returns the first error the sink reported since
+    /// the previous flush.
+    /// </summary>
+    Acad::ErrorStatus flush();
+
+    /// <summary>
+    /// Records discarded by the overflow policy so far.
+    /// </summary>
+    Adesk::UInt64 discardedCount() const { return m_discarded.load(std::memory_order_relaxed); }
+
+    /// <summary>
+    /// Registers the logger with a vectored exception handler that, on an
+    /// access violation or similar fatal exception in any thread, writes the
+    /// queued records straight to the sink from the faulting thread, without
+    /// allocating.  The handler never handles the exception itself.  It
+    /// also runs for exceptions that are handled later, so it waits at most
+    /// 50 ms for the writer thread to finish a batch and skips the flush if
+    /// the writer does not.  Disabling it waits for a flush in progress.
+    /// </summary>
+    void enableCrashFlush(bool enable);
+
+private:
+    struct Slot;
+
+    bool enqueue(PlotLogLevel level, const ACHAR* category, const ACHAR* text);
+    void writerLoop();
+    void drain();
+    void drainLocked(char* pBatch, size_t batchCapacity, bool reportDiscarded);
+    void emergencyFlush();
+    bool acquireDrain(unsigned maxSpins);
+    void wake();
+
+    static LONG NTAPI crashHandler(PEXCEPTION_POINTERS pException);
+
+    PlotLogSink&                      m_sink;
+    AsyncPlotLoggerSettings           m_settings;
+    std::unique_ptr<Slot[]>           m_slots;
+    size_t                            m_mask;
+
+    alignas(64) std::atomic<size_t>   m_enqueuePos;
+    alignas(64) size_t                m_dequeuePos;   // owned by whoever holds m_draining
+    std::atomic<size_t>               m_writtenPos;
+    std::atomic<bool>                 m_draining;
+    std::atomic<Adesk::UInt64>        m_discarded;
+    Adesk::UInt64                     m_discardedReported;
+
+    std::atomic<Adesk::UInt32>        m_job;
+    std::atomic<Adesk::UInt32>        m_sheet;
+    std::atomic<bool>                 m_errorInSheet;
+    std::atomic<bool>                 m_warningInSheet;
+    std::atomic<bool>                 m_errorInJob;
+    std::atomic<bool>                 m_warningInJob;
+
+    std::mutex                        m_mutex;        // only for sleeping and flushing
+    std::condition_variable           m_wakeWriter;
+    std::condition_variable           m_drained;
+    std::atomic<bool>                 m_wakeRequested;
+    bool                              m_stop;
+    std::atomic<Acad::ErrorStatus>    m_sinkStatus;
+    std::unique_ptr<char[]>           m_batch;
+    std::thread                       m_writer;
+};
+
+/// <summary>
+/// An AsyncPlotLogger writing to a file, installed as the plot error handler
+/// of the AutoCAD session: install() wraps it in an
+/// AcPlPlotLoggingErrorHandler and locks that in with an
+/// AcPlPlotErrorHandlerLock, so every plot from then on logs through it,
+/// and crash flushing is enabled.  uninstall(), or destroying the object,
+/// releases the lock and writes out whatever is still queued.
+/// </summary>
+class InstalledPlotLog
+{
+public:
+    InstalledPlotLog();
+    ~InstalledPlotLog();
+
+    InstalledPlotLog(const InstalledPlotLog&) = delete;
+    InstalledPlotLog& operator=(const InstalledPlotLog&) = delete;
+
+    /// <summary>
+    /// Logs to the file at path, replacing the log installed before.
+    /// Returns Acad::eAlreadyActive if another application holds the plot
+    /// error handler lock.
+    /// </summary>
+    Acad::ErrorStatus install(const ACHAR* path,
+                              const AsyncPlotLoggerSettings& settings = AsyncPlotLoggerSettings());
+    void uninstall();
+
+    bool isInstalled() const { return m_pLogger != nullptr; }
+
+    /// <summary>
+    /// The installed logger, or null.
+    /// </summary>
+    AsyncPlotLogger* logger() const { return m_pLogger.get(); }
+
+private:
+    PlotLogFileSink                              m_sink;
+    std::unique_ptr<AsyncPlotLogger>             m_pLogger;
+    std::unique_ptr<AcPlPlotLoggingErrorHandler> m_pHandler;
+    AcPlPlotErrorHandlerLock                     m_lock;
+};
+
+/// <summary>
+/// The SHEETSETTOPDFPLOTLOG command: asks for a log file and installs log
+/// on it, or uninstalls log if the answer is empty.
+/// </summary>
+void plotLogCommand(InstalledPlotLog& log);
+
+} // namespace acad_sheetset_to_pdf
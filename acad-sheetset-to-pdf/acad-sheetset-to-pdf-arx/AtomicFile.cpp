@@ -0,0 +1,57 @@
+#include "stdafx.h"
+#include "AtomicFile.h"
+#include "MappedFile.h"
+
+namespace acad_sheetset_to_pdf {
+
+Acad::ErrorStatus writeFileAtomically(const ACHAR* path, const void* pData, size_t size)
+{
+    if (path == nullptr || (pData == nullptr && size != 0))
+        return Acad::eNullPtr;
+
+    std::wstring temporaryPath(path);
+    temporaryPath += L".tmp";
+
+    HANDLE hFile = ::CreateFileW(temporaryPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                                 FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return MappedFile::statusFromWin32(::GetLastError());
+
+    DWORD error = writeFileFully(hFile, pData, size);
+    if (error == ERROR_SUCCESS && !::FlushFileBuffers(hFile))
+        error = ::GetLastError();
+    ::CloseHandle(hFile);
+
+    if (error == ERROR_SUCCESS &&
+        !::MoveFileExW(temporaryPath.c_str(), path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+        error = ::GetLastError();
+    if (error != ERROR_SUCCESS)
+    {
+        ::DeleteFileW(temporaryPath.c_str());
+        return MappedFile::statusFromWin32(error);
+    }
+    return Acad::eOk;
+}
+
+DWORD writeFileFully(HANDLE hFile, const void* pData, size_t size)
+{
+    /* WriteFile's length is a DWORD, so a buffer of 4 GB or more has to go
+       in pieces.  They are 1 GB rather than the 4 GB a DWORD allows, since
+       a single very large write can fail with ERROR_NO_SYSTEM_RESOURCES,
+       on network shares especially, and 1 GB writes cost nothing extra. */
+    const Adesk::UInt8* pBytes = static_cast<const Adesk::UInt8*>(pData);
+    while (size != 0)
+    {
+        const DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 0x40000000));
+        DWORD written = 0;
+        if (!::WriteFile(hFile, pBytes, chunk, &written, nullptr))
+            return ::GetLastError();
+        if (written == 0)
+            return ERROR_WRITE_FAULT;
+        pBytes += written;
+        size -= written;
+    }
+    return ERROR_SUCCESS;
+}
+
+} // namespace acad_sheetset_to_pdf
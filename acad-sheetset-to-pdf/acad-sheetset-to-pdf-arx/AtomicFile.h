@@ -0,0 +1,21 @@
+#pragma once
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// Replaces the file at path with size bytes from pData, so that anyone
+/// reading the file sees either the old content or the new one, never a
+/// half-written mix.  The data goes to path with ".tmp" appended first, is
+/// flushed to disk and then renamed over path.
+/// </summary>
+Acad::ErrorStatus writeFileAtomically(const ACHAR* path, const void* pData, size_t size);
+
+/// <summary>
+/// Writes size bytes from pData to hFile at its file pointer, in as many
+/// WriteFile calls as it takes, and returns ERROR_SUCCESS or the Win32
+/// error that stopped it.  A call that succeeds without writing anything
+/// counts as ERROR_WRITE_FAULT rather than being retried for ever.
+/// </summary>
+DWORD writeFileFully(HANDLE hFile, const void* pData, size_t size);
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,323 @@
+#include "stdafx.h"
+#include "BlockGraphicsCache.h"
+
+#include "Checksum.h"
+#include "DrawStreamBuilder.h"
+
+#include "acdbxref.h"
+
+#include <chrono>
+#include <new>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+Adesk::UInt64 elapsedSince(std::chrono::steady_clock::time_point start)
+{
+    return static_cast<Adesk::UInt64>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+/* Folds the last write time and size of a file into hash.  Returns false if
+there is no such file. */
+bool hashFile(const ACHAR* path, Adesk::UInt64& hash)
+{
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (path == nullptr || *path == 0 || !::GetFileAttributesExW(path, GetFileExInfoStandard, &attributes) ||
+        (attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+        return false;
+    const Adesk::UInt64 stat[2] = {
+        (Adesk::UInt64(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime,
+        (Adesk::UInt64(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow};
+    hash = fnv1a64(stat, sizeof(stat), hash);
+    return true;
+}
+
+/* Whether pDb holds edits its file does not.  AcDbDatabase has no such
+flag; DBMOD has, but acedGetVar reads it of the current document only, so a
+database open in any other document counts as modified.  A database that is
+no document's, as publish and xrefs open them, holds what it was read from. */
+bool isModified(AcDbDatabase* pDb)
+{
+    const AcApDocument* pDocument = acDocManager->document(pDb);
+    if (pDocument == nullptr)
+        return false;
+    if (pDocument != acDocManager->curDocument())
+        return true;
+    resbuf dbmod;
+    return acedGetVar(ACRX_T("DBMOD"), &dbmod) != RTNORM || dbmod.resval.rint != 0;
+}
+
+/* Whether an xref of pDb is not what its file holds now: edited, or
+changed on disk since it was loaded, which AutoCAD notices and offers to
+reload. */
+bool hasModifiedXref(AcDbDatabase* pDb)
+{
+    AcDbXrefGraph graph;
+    if (acdbGetHostDwgXrefGraph(pDb, graph) != Acad::eOk)
+        return true;
+    for (int i = 0; i < graph.numNodes(); ++i)
+    {
+        const AcDbXrefGraphNode* pNode = graph.xrefNode(i);
+        if (pNode == graph.hostDwg())
+            continue;
+        if (pNode->xrefNotificationStatus() == AcDb::kXrfNotifyResolvedUpdateAvailable ||
+            (pNode->database() != nullptr && isModified(pNode->database())))
+            return true;
+    }
+    return false;
+}
+
+/* The fingerprint of pDb's file and its xrefs, and the blocks to give
+streams to.  An xref that cannot be found still counts, as missing, so
+finding it later changes the fingerprint.  The fingerprint only stands for
+the graphics while the databases hold what their files do, so a drawing
+with unsaved edits, in itself or in an xref, is not cached. */
+Acad::ErrorStatus collectBlocks(AcDbDatabase* pDb, Adesk::UInt64& fingerprint, std::vector<AcDbObjectId>& blocks)
+{
+    const ACHAR* pFileName = nullptr;
+    fingerprint = fnv1a64(nullptr, 0);
+    if (pDb->getFilename(pFileName) != Acad::eOk || !hashFile(pFileName, fingerprint))
+        return Acad::eNotApplicable;
+    if (isModified(pDb) || hasModifiedXref(pDb))
+        return Acad::eNotApplicable;
+
+    AcDbBlockTablePointer pTable(pDb->blockTableId(), AcDb::kForRead);
+    if (pTable.openStatus() != Acad::eOk)
+        return pTable.openStatus();
+    AcDbBlockTableIterator* pIterator = nullptr;
+    const Acad::ErrorStatus es = pTable->newIterator(pIterator);
+    if (es != Acad::eOk)
+        return es;
+    std::unique_ptr<AcDbBlockTableIterator> iterator(pIterator);
+    for (; !iterator->done(); iterator->step())
+    {
+        AcDbObjectId id;
+        if (iterator->getRecordId(id) != Acad::eOk)
+            continue;
+        AcDbObjectPointer<AcDbBlockTableRecord> pBlock(id, AcDb::kForRead);
+        if (pBlock.openStatus() != Acad::eOk || pBlock->isLayout())
+            continue;
+        if (pBlock->isFromExternalReference())
+        {
+            AcString path, found;
+            const bool exists = pBlock->pathName(path) == Acad::eOk &&
+                                acdbHostApplicationServices()->findFile(found, path.kwszPtr(), pDb) == Acad::eOk &&
+                                hashFile(found.kwszPtr(), fingerprint);
+            if (!exists)
+                fingerprint = fnv1a64(path.kwszPtr(), path.length() * sizeof(ACHAR), fingerprint);
+        }
+        blocks.push_back(id);
+    }
+    return Acad::eOk;
+}
+
+} // namespace
+
+/* BlockGraphicsCacheStats ------------------------------------------------- */
+
+void BlockGraphicsCacheStats::add(const BlockGraphicsCacheStats& other)
+{
+    documentCount += other.documentCount;
+    blockCount += other.blockCount;
+    loadedCount += other.loadedCount;
+    builtCount += other.builtCount;
+    storedCount += other.storedCount;
+    fingerprintNanoseconds += other.fingerprintNanoseconds;
+    loadNanoseconds += other.loadNanoseconds;
+    buildNanoseconds += other.buildNanoseconds;
+    storeNanoseconds += other.storeNanoseconds;
+}
+
+/* BlockGraphicsCache ------------------------------------------------------ */
+
+BlockGraphicsCache::BlockGraphicsCache()
+{
+}
+
+BlockGraphicsCache::~BlockGraphicsCache()
+{
+    release();
+}
+
+void BlockGraphicsCache::beginDocument(AcPlPlotInfo& plotInfo, const ACHAR* pDocname, Adesk::Int32 nCopies,
+                                       bool bPlotToFile, const ACHAR* pFilename)
+{
+    AcDbDatabase* pDb = nullptr;
+    {
+        AcDbObjectPointer<AcDbLayout> pLayout(plotInfo.layout(), AcDb::kForRead);
+        if (pLayout.openStatus() == Acad::eOk)
+            pDb = pLayout->database();
+    }
+    if (pDb != nullptr)
+        prepare(pDb);
+}
+
+void BlockGraphicsCache::endDocument(AcPlPlotProgress::PlotCancelStatus status)
+{
+    release();
+}
+
+void BlockGraphicsCache::endPlot(AcPlPlotProgress::PlotCancelStatus status)
+{
+    release();
+}
+
+Acad::ErrorStatus BlockGraphicsCache::setDirectory(const ACHAR* directory, Adesk::UInt64 maxBytes)
+{
+    release();
+    m_pCache.reset();
+    m_directory.setEmpty();
+    if (directory == nullptr || *directory == 0)
+        return Acad::eOk;
+
+    try
+    {
+        DrawStreamCacheSettings settings;
+        settings.directory = directory;
+        settings.maxBytes = maxBytes;
+        /* Streams are AutoCAD's own serialization, which a release may
+        change. */
+        settings.generation = (Adesk::UInt64(acdbHostApplicationServices()->releaseMajorVersion()) << 32) |
+                              static_cast<Adesk::UInt32>(acdbHostApplicationServices()->releaseMinorVersion());
+        m_pCache.reset(new DrawStreamCache(settings));
+        m_directory = directory;
+    }
+    catch (const std::bad_alloc&)
+    {
+        return Acad::eOutOfMemory;
+    }
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus BlockGraphicsCache::prepare(AcDbDatabase* pDb)
+{
+    release();
+    if (pDb == nullptr)
+        return Acad::eNullObjectPointer;
+    if (m_pCache == nullptr)
+        return Acad::eNotApplicable;
+
+    m_last = BlockGraphicsCacheStats();
+    try
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        Adesk::UInt64 fingerprint = 0;
+        std::vector<AcDbObjectId> blocks;
+        Acad::ErrorStatus es = collectBlocks(pDb, fingerprint, blocks);
+        m_last.fingerprintNanoseconds = elapsedSince(start);
+        if (es != Acad::eOk)
+            return es;
+
+        std::vector<std::unique_ptr<AcGiDrawStream>> streams;
+        std::vector<Adesk::UInt64> keys;
+        std::vector<unsigned char> loaded;
+        AcArray<AcGiDrawStream*> missing;
+        std::vector<size_t> missingIndices;
+        streams.reserve(blocks.size());
+        keys.reserve(blocks.size());
+        loaded.reserve(blocks.size());
+
+        start = std::chrono::steady_clock::now();
+        for (const AcDbObjectId& id : blocks)
+        {
+            AcDbObjectPointer<AcDbBlockTableRecord> pBlock(id, AcDb::kForRead);
+            if (pBlock.openStatus() != Acad::eOk)
+                return pBlock.openStatus();
+            const Adesk::UInt64 handle = static_cast<Adesk::UInt64>(id.handle());
+            keys.push_back(fnv1a64(&handle, sizeof(handle), fingerprint));
+            streams.emplace_back(new AcGiDrawStream(pBlock.object()));
+            loaded.push_back(m_pCache->load(keys.back(), *streams.back(), pDb) == Acad::eOk);
+            if (!loaded.back())
+            {
+                missing.append(streams.back().get());
+                missingIndices.push_back(streams.size() - 1);
+            }
+        }
+        m_last.loadNanoseconds = elapsedSince(start);
+
+        if (!missing.isEmpty())
+        {
+            start = std::chrono::steady_clock::now();
+            DrawStreamBuilder builder;
+            builder.build(missing, nullptr);
+            m_last.buildNanoseconds = elapsedSince(start);
+
+            start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < missingIndices.size(); ++i)
+            {
+                if (!builder.built()[i])
+                    continue;
+                ++m_last.builtCount;
+                if (m_pCache->store(keys[missingIndices[i]], *streams[missingIndices[i]]) == Acad::eOk)
+                    ++m_last.storedCount;
+            }
+            m_last.storeNanoseconds = elapsedSince(start);
+        }
+
+        /* Blocks keep only streams that hold their graphics; the rest are
+        drawn as usual. */
+        for (size_t i = 0; i < streams.size(); ++i)
+        {
+            if (!streams[i]->isValid())
+                continue;
+            AcDbObjectPointer<AcDbBlockTableRecord> pBlock(blocks[i], AcDb::kForRead);
+            if (pBlock.openStatus() != Acad::eOk)
+                continue;
+            pBlock->setDrawStream(streams[i].get());
+            m_blocks.push_back(blocks[i]);
+            m_streams.push_back(std::move(streams[i]));
+            if (loaded[i])
+                ++m_last.loadedCount;
+        }
+        m_last.blockCount = m_streams.size();
+        m_last.documentCount = 1;
+        m_total.add(m_last);
+    }
+    catch (const std::bad_alloc&)
+    {
+        release();
+        return Acad::eOutOfMemory;
+    }
+    return Acad::eOk;
+}
+
+void BlockGraphicsCache::release()
+{
+    for (size_t i = 0; i < m_blocks.size(); ++i)
+    {
+        AcDbObjectPointer<AcDbBlockTableRecord> pBlock(m_blocks[i], AcDb::kForRead);
+        if (pBlock.openStatus() == Acad::eOk && pBlock->drawStream() == m_streams[i].get())
+            pBlock->setDrawStream(nullptr);
+    }
+    m_blocks.clear();
+    m_streams.clear();
+}
+
+void blockGraphicsCacheCommand(BlockGraphicsCache& cache)
+{
+    AcString directory;
+    if (acedGetString(1, ACRX_T("\nFolder to cache block graphics in <none>: "), directory) != RTNORM)
+        return;
+    const Acad::ErrorStatus es = cache.setDirectory(directory.kwszPtr());
+    if (es != Acad::eOk)
+    {
+        acutPrintf(ACRX_T("\nCould not cache block graphics in %s: %s\n"), directory.kwszPtr(),
+                   acadErrorStatusText(es));
+        return;
+    }
+
+    const BlockGraphicsCacheStats& total = cache.totalStats();
+    acutPrintf(ACRX_T("\n%llu documents, %llu blocks: %llu read from the cache, %llu built, %llu stored.\n"),
+               static_cast<unsigned long long>(total.documentCount),
+               static_cast<unsigned long long>(total.blockCount),
+               static_cast<unsigned long long>(total.loadedCount),
+               static_cast<unsigned long long>(total.builtCount),
+               static_cast<unsigned long long>(total.storedCount));
+    acutPrintf(ACRX_T("Fingerprint %.1f ms, load %.1f ms, build %.1f ms, store %.1f ms.\n"),
+               total.fingerprintNanoseconds / 1e6, total.loadNanoseconds / 1e6, total.buildNanoseconds / 1e6,
+               total.storeNanoseconds / 1e6);
+}
+
+} // namespace acad_sheetset_to_pdf
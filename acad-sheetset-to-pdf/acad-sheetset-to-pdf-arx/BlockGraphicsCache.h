@@ -0,0 +1,108 @@
+#pragma once
+
+#include "DrawStreamCache.h"
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// What BlockGraphicsCache did for one or more documents.  Times are
+/// nanoseconds.
+/// </summary>
+struct BlockGraphicsCacheStats
+{
+    size_t        documentCount = 0;
+    size_t        blockCount = 0;               // blocks given a draw stream
+    size_t        loadedCount = 0;              // of those, read back from the cache
+    size_t        builtCount = 0;               // generated because the cache had no entry
+    size_t        storedCount = 0;
+    Adesk::UInt64 fingerprintNanoseconds = 0;   // stating the drawing and its xrefs
+    Adesk::UInt64 loadNanoseconds = 0;
+    Adesk::UInt64 buildNanoseconds = 0;
+    Adesk::UInt64 storeNanoseconds = 0;
+
+    void add(const BlockGraphicsCacheStats& other);
+};
+
+/// <summary>
+/// A plot reactor that gives the blocks of every drawing plotted draw
+/// streams read from a DrawStreamCache, so that a publish job plotting the
+/// same blocks and xrefs again reads their graphics back instead of
+/// generating them.
+///
+/// At beginDocument every block table record of the layout's database that
+/// is not a layout gets an AcGiDrawStream.  Its key is fnv1a64 over the
+/// block's handle and a fingerprint of the drawing: the last write time and
+/// size of its file and of every xref it resolves, so editing any of them
+/// makes every key new and nothing stale is ever read.  Streams the cache
+/// has are loaded; the others are built together with a DrawStreamBuilder
+/// and stored.  At endDocument, or at endPlot for a plot that never got
+/// there, the streams are taken off their blocks again and deleted.
+///
+/// Drawings that have never been saved have no fingerprint, and those with
+/// unsaved edits, or with an xref edited or changed on disk since it was
+/// loaded, are not what theirs stands for; they are plotted as they would
+/// be without the reactor.  Register it with
+/// acplPlotReactorMgr->addReactor(); it does nothing until setDirectory()
+/// names a folder.  Notifications, setDirectory() and the statistics are
+/// all for AutoCAD's main thread.
+/// </summary>
+class BlockGraphicsCache : public AcPlPlotReactor
+{
+public:
+    BlockGraphicsCache();
+    ~BlockGraphicsCache();
+
+    BlockGraphicsCache(const BlockGraphicsCache&) = delete;
+    BlockGraphicsCache& operator=(const BlockGraphicsCache&) = delete;
+
+    void beginDocument(AcPlPlotInfo& plotInfo, const ACHAR* pDocname, Adesk::Int32 nCopies, bool bPlotToFile,
+                       const ACHAR* pFilename) override;
+    void endDocument(AcPlPlotProgress::PlotCancelStatus status) override;
+    void endPlot(AcPlPlotProgress::PlotCancelStatus status) override;
+
+    /// <summary>
+    /// Folder the streams are cached in, which must exist; null or empty
+    /// stops caching.  Entries are of the running AutoCAD release only, and
+    /// the folder is kept under maxBytes.
+    /// </summary>
+    Acad::ErrorStatus setDirectory(const ACHAR* directory, Adesk::UInt64 maxBytes = 1ull << 30);
+
+    const AcString& directory() const { return m_directory; }
+
+    /// <summary>
+    /// Gives the blocks of pDb their streams, as beginDocument does.
+    /// Returns Acad::eNotApplicable when there is no folder, or pDb has no
+    /// file or is not what its files hold, and releases the streams of an
+    /// earlier prepare() first.
+    /// </summary>
+    Acad::ErrorStatus prepare(AcDbDatabase* pDb);
+
+    /// <summary>
+    /// Takes the streams of the last prepare() off their blocks.
+    /// </summary>
+    void release();
+
+    const BlockGraphicsCacheStats& lastStats() const { return m_last; }
+    const BlockGraphicsCacheStats& totalStats() const { return m_total; }
+
+    /// <summary>
+    /// The cache itself, for its hit and eviction counts, or null.
+    /// </summary>
+    const DrawStreamCache* cache() const { return m_pCache.get(); }
+
+private:
+    std::unique_ptr<DrawStreamCache>                m_pCache;
+    AcString                                        m_directory;
+    std::vector<AcDbObjectId>                       m_blocks;       // of the streams below
+    std::vector<std::unique_ptr<AcGiDrawStream>>    m_streams;
+    BlockGraphicsCacheStats                         m_last;
+    BlockGraphicsCacheStats                         m_total;
+};
+
+/// <summary>
+/// The SHEETSETTOPDFBLOCKCACHE command: asks for the folder to cache block
+/// graphics in, empty to stop, and reports what the cache has done.
+/// </summary>
+void blockGraphicsCacheCommand(BlockGraphicsCache& cache);
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,194 @@
+#include "stdafx.h"
+#include "Checksum.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+/* Slicing-by-4 tables: table[0] is the classic byte-at-a-time table, and
+table[k][b] is the CRC of byte b followed by k zero bytes, so four bytes can
+be folded in with four lookups and no dependency between them. */
+struct Crc32Tables
+{
+    Adesk::UInt32 table[4][256];
+
+    Crc32Tables()
+    {
+        for (Adesk::UInt32 b = 0; b < 256; ++b)
+        {
+            Adesk::UInt32 crc = b;
+            for (int bit = 0; bit < 8; ++bit)
+                crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+            table[0][b] = crc;
+        }
+        for (Adesk::UInt32 b = 0; b < 256; ++b)
+        {
+            for (int k = 1; k < 4; ++k)
+                table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xFF];
+        }
+    }
+};
+
+const Crc32Tables& crc32Tables()
+{
+    static const Crc32Tables tables;
+    return tables;
+}
+
+const Adesk::UInt32 kXxhPrime1 = 2654435761u;
+const Adesk::UInt32 kXxhPrime2 = 2246822519u;
+const Adesk::UInt32 kXxhPrime3 = 3266489917u;
+const Adesk::UInt32 kXxhPrime4 = 668265263u;
+const Adesk::UInt32 kXxhPrime5 = 374761393u;
+
+Adesk::UInt32 rotate32(Adesk::UInt32 value, int bits)
+{
+    return (value << bits) | (value >> (32 - bits));
+}
+
+Adesk::UInt32 load32(const Adesk::UInt8* p)
+{
+    return Adesk::UInt32(p[0]) | (Adesk::UInt32(p[1]) << 8) | (Adesk::UInt32(p[2]) << 16) |
+           (Adesk::UInt32(p[3]) << 24);
+}
+
+Adesk::UInt32 xxhRound(Adesk::UInt32 accumulator, Adesk::UInt32 lane)
+{
+    return rotate32(accumulator + lane * kXxhPrime2, 13) * kXxhPrime1;
+}
+
+} // namespace
+
+Adesk::UInt32 crc32(const void* pData, size_t size, Adesk::UInt32 previous)
+{
+    const Crc32Tables& t = crc32Tables();
+    const Adesk::UInt8* p = static_cast<const Adesk::UInt8*>(pData);
+    Adesk::UInt32 crc = ~previous;
+    for (; size >= 4; size -= 4, p += 4)
+    {
+        crc ^= Adesk::UInt32(p[0]) | (Adesk::UInt32(p[1]) << 8) | (Adesk::UInt32(p[2]) << 16) |
+               (Adesk::UInt32(p[3]) << 24);
+        crc = t.table[3][crc & 0xFF] ^ t.table[2][(crc >> 8) & 0xFF] ^ t.table[1][(crc >> 16) & 0xFF] ^
+              t.table[0][crc >> 24];
+    }
+    for (; size != 0; --size, ++p)
+        crc = (crc >> 8) ^ t.table[0][(crc ^ *p) & 0xFF];
+    return ~crc;
+}
+
+Adesk::UInt64 fnv1a64(const void* pData, size_t size, Adesk::UInt64 previous)
+{
+    const Adesk::UInt8* p = static_cast<const Adesk::UInt8*>(pData);
+    Adesk::UInt64 hash = previous;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= p[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+Adesk::UInt32 adler32(const void* pData, size_t size, Adesk::UInt32 previous)
+{
+    /* 5552 is the most bytes that can be summed before b might overflow 32
+    bits and has to be reduced. */
+    const Adesk::UInt32 kModulus = 65521;
+    const Adesk::UInt8* p = static_cast<const Adesk::UInt8*>(pData);
+    Adesk::UInt32 a = previous & 0xFFFF;
+    Adesk::UInt32 b = previous >> 16;
+    while (size != 0)
+    {
+        const size_t run = std::min<size_t>(size, 5552);
+        for (size_t i = 0; i < run; ++i)
+        {
+            a += p[i];
+            b += a;
+        }
+        a %= kModulus;
+        b %= kModulus;
+        p += run;
+        size -= run;
+    }
+    return (b << 16) | a;
+}
+
+Adesk::UInt32 xxh32(const void* pData, size_t size, Adesk::UInt32 seed)
+{
+    Xxh32Stream stream(seed);
+    stream.update(pData, size);
+    return stream.digest();
+}
+
+/* Xxh32Stream ------------------------------------------------------------- */
+
+void Xxh32Stream::reset(Adesk::UInt32 seed)
+{
+    m_lanes[0] = seed + kXxhPrime1 + kXxhPrime2;
+    m_lanes[1] = seed + kXxhPrime2;
+    m_lanes[2] = seed;
+    m_lanes[3] = seed - kXxhPrime1;
+    m_pendingSize = 0;
+    m_total = 0;
+    m_seed = seed;
+}
+
+void Xxh32Stream::update(const void* pData, size_t size)
+{
+    const Adesk::UInt8* p = static_cast<const Adesk::UInt8*>(pData);
+    m_total += size;
+    if (m_pendingSize != 0)
+    {
+        const size_t count = std::min(size, sizeof(m_pending) - m_pendingSize);
+        std::memcpy(m_pending + m_pendingSize, p, count);
+        m_pendingSize += count;
+        p += count;
+        size -= count;
+        if (m_pendingSize < sizeof(m_pending))
+            return;
+        for (int lane = 0; lane < 4; ++lane)
+            m_lanes[lane] = xxhRound(m_lanes[lane], load32(m_pending + 4 * lane));
+        m_pendingSize = 0;
+    }
+
+    /* Four lanes of four bytes each, folded together in digest(). */
+    Adesk::UInt32 v1 = m_lanes[0], v2 = m_lanes[1], v3 = m_lanes[2], v4 = m_lanes[3];
+    for (; size >= 16; p += 16, size -= 16)
+    {
+        v1 = xxhRound(v1, load32(p));
+        v2 = xxhRound(v2, load32(p + 4));
+        v3 = xxhRound(v3, load32(p + 8));
+        v4 = xxhRound(v4, load32(p + 12));
+    }
+    m_lanes[0] = v1;
+    m_lanes[1] = v2;
+    m_lanes[2] = v3;
+    m_lanes[3] = v4;
+    std::memcpy(m_pending, p, size);
+    m_pendingSize = size;
+}
+
+Adesk::UInt32 Xxh32Stream::digest() const
+{
+    Adesk::UInt32 hash = m_total >= 16 ? rotate32(m_lanes[0], 1) + rotate32(m_lanes[1], 7) +
+                                             rotate32(m_lanes[2], 12) + rotate32(m_lanes[3], 18)
+                                       : m_seed + kXxhPrime5;
+    hash += static_cast<Adesk::UInt32>(m_total);
+
+    const Adesk::UInt8* p = m_pending;
+    const Adesk::UInt8* const pEnd = p + m_pendingSize;
+    for (; pEnd - p >= 4; p += 4)
+        hash = rotate32(hash + load32(p) * kXxhPrime3, 17) * kXxhPrime4;
+    for (; p != pEnd; ++p)
+        hash = rotate32(hash + *p * kXxhPrime5, 11) * kXxhPrime1;
+    hash ^= hash >> 15;
+    hash *= kXxhPrime2;
+    hash ^= hash >> 13;
+    hash *= kXxhPrime3;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,49 @@
+#pragma once
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// CRC-32 (the ISO-HDLC polynomial used by zip and PNG) of size bytes,
+/// continuing from a previous result so that data can be fed in pieces.
+/// </summary>
+Adesk::UInt32 crc32(const void* pData, size_t size, Adesk::UInt32 previous = 0);
+
+/// <summary>
+/// 64-bit FNV-1a hash, for fingerprints and hash tables rather than for
+/// detecting corruption.  Continues from previous like crc32.
+/// </summary>
+Adesk::UInt64 fnv1a64(const void* pData, size_t size, Adesk::UInt64 previous = 14695981039346656037ull);
+
+/// <summary>
+/// Adler-32 of size bytes, the checksum of zlib streams.  Continues from
+/// previous like crc32.
+/// </summary>
+Adesk::UInt32 adler32(const void* pData, size_t size, Adesk::UInt32 previous = 1);
+
+/// <summary>
+/// 32-bit xxHash of size bytes, the checksum of LZ4 frames.
+/// </summary>
+Adesk::UInt32 xxh32(const void* pData, size_t size, Adesk::UInt32 seed = 0);
+
+/// <summary>
+/// xxh32 of data that arrives in pieces: update() with each piece in
+/// order, and digest() returns what xxh32 of all of them together would.
+/// </summary>
+class Xxh32Stream
+{
+public:
+    explicit Xxh32Stream(Adesk::UInt32 seed = 0) { reset(seed); }
+
+    void reset(Adesk::UInt32 seed = 0);
+    void update(const void* pData, size_t size);
+    Adesk::UInt32 digest() const;
+
+private:
+    Adesk::UInt32   m_lanes[4];
+    Adesk::UInt8    m_pending[16];  // bytes not yet folded into the lanes
+    size_t          m_pendingSize;
+    Adesk::UInt64   m_total;
+    Adesk::UInt32   m_seed;
+};
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,512 @@
+#include "stdafx.h"
+#include "DeviceCatalog.h"
+#include "AtomicFile.h"
+#include "Checksum.h"
+
+#include <chrono>
+#include <cwctype>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+/* A catalog image, in native byte order since it never leaves the machine
+that made it:
+
+    CatalogHeader
+    CatalogMedia[mediaCount]
+    UInt32[bucketCount]         index + 1 of a media record, 0 if empty
+    ACHAR[]                     null-terminated strings
+
+String references are byte offsets into the string pool.  The CRC covers
+the whole image but its own field. */
+const Adesk::UInt32 kCatalogMagic = 0x54434D50;     // "PMCT"
+const Adesk::UInt32 kCatalogVersion = 1;
+
+struct CatalogHeader
+{
+    Adesk::UInt32 magic;
+    Adesk::UInt32 version;
+    Adesk::UInt64 sourceTime;
+    Adesk::UInt64 sourceSize;
+    Adesk::UInt32 imageSize;
+    Adesk::UInt32 crc;
+    Adesk::UInt32 maxDeviceDPI;
+    Adesk::UInt32 mediaCount;
+    Adesk::UInt32 bucketCount;
+    Adesk::UInt32 charSize;
+    Adesk::UInt32 fullPath;
+    Adesk::UInt32 deviceName;
+    Adesk::UInt32 recordsOffset;
+    Adesk::UInt32 bucketsOffset;
+    Adesk::UInt32 stringsOffset;
+    Adesk::UInt32 stringsSize;
+};
+static_assert(sizeof(CatalogHeader) == 72, "catalog header layout");
+
+struct CatalogMedia
+{
+    double        pageSize[2];
+    double        printableMin[2];
+    double        printableMax[2];
+    Adesk::UInt32 canonicalName;
+    Adesk::UInt32 localName;
+    Adesk::UInt32 hash;
+    Adesk::UInt32 reserved;
+};
+static_assert(sizeof(CatalogMedia) == 64, "catalog media layout");
+
+const size_t kCrcOffset = offsetof(CatalogHeader, crc);
+
+Adesk::UInt32 hashName(const ACHAR* pName)
+{
+    const Adesk::UInt64 hash = fnv1a64(pName, std::wcslen(pName) * sizeof(ACHAR));
+    return static_cast<Adesk::UInt32>(hash ^ (hash >> 32));
+}
+
+Adesk::UInt32 imageCrc(const Adesk::UInt8* pData, size_t size)
+{
+    const Adesk::UInt32 crc = crc32(pData, kCrcOffset);
+    return crc32(pData + kCrcOffset + sizeof(Adesk::UInt32), size - kCrcOffset - sizeof(Adesk::UInt32), crc);
+}
+
+/* The string pool of a catalog being built. */
+class StringPool
+{
+public:
+    Adesk::UInt32 add(const ACHAR* pText)
+    {
+        const Adesk::UInt32 offset = static_cast<Adesk::UInt32>(m_chars.size() * sizeof(ACHAR));
+        if (pText != nullptr)
+            m_chars.insert(m_chars.end(), pText, pText + std::wcslen(pText));
+        m_chars.push_back(0);
+        return offset;
+    }
+
+    const std::vector<ACHAR>& chars() const { return m_chars; }
+
+private:
+    std::vector<ACHAR> m_chars;
+};
+
+Adesk::UInt64 steadyMilliseconds()
+{
+    return static_cast<Adesk::UInt64>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/* Last write time and size of a PC3 file; both 0 for a device without one,
+such as a system printer. */
+void statSource(const ACHAR* path, Adesk::UInt64& time, Adesk::UInt64& size)
+{
+    time = 0;
+    size = 0;
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (path == nullptr || *path == 0 || !::GetFileAttributesExW(path, GetFileExInfoStandard, &attributes) ||
+        (attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+        return;
+    time = (Adesk::UInt64(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+    size = (Adesk::UInt64(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+}
+
+/* Device paths are compared as Windows compares file names. */
+std::wstring keyOf(const ACHAR* fullPath)
+{
+    std::wstring key(fullPath != nullptr ? fullPath : L"");
+    for (wchar_t& c : key)
+        c = static_cast<wchar_t>(std::towlower(c));
+    return key;
+}
+
+} // namespace
+
+/* DeviceCatalog ----------------------------------------------------------- */
+
+DeviceCatalog::DeviceCatalog()
+    : m_pData(nullptr)
+    , m_size(0)
+{
+}
+
+Acad::ErrorStatus DeviceCatalog::build(const AcPlPlotConfig& config, Adesk::UInt64 sourceTime,
+                                       Adesk::UInt64 sourceSize, std::shared_ptr<const DeviceCatalog>& pCatalog)
+{
+    pCatalog.reset();
+
+    StringPool strings;
+    CatalogHeader header = {};
+    header.magic = kCatalogMagic;
+    header.version = kCatalogVersion;
+    header.sourceTime = sourceTime;
+    header.sourceSize = sourceSize;
+    header.maxDeviceDPI = config.maxDeviceDPI();
+    header.charSize = sizeof(ACHAR);
+    header.fullPath = strings.add(config.fullPath());
+    header.deviceName = strings.add(config.deviceName());
+
+    /* The strings the device hands out are the caller's to free. */
+    AcArray<ACHAR*> names;
+    config.getCanonicalMediaNameList(names);
+    std::vector<CatalogMedia> records;
+    records.reserve(names.length());
+    for (int i = 0; i < names.length(); ++i)
+    {
+        ACHAR* pName = names[i];
+        if (pName == nullptr)
+            continue;
+
+        CatalogMedia record = {};
+        record.canonicalName = strings.add(pName);
+        record.hash = hashName(pName);
+
+        ACHAR* pLocalName = nullptr;
+        config.getLocalMediaName(pName, pLocalName);
+        record.localName = strings.add(pLocalName != nullptr ? pLocalName : pName);
+        acutDelString(pLocalName);
+
+        AcGePoint2d pageSize;
+        AcGeBoundBlock2d printableArea;
+        AcGePoint2d printableMin, printableMax;
+        config.getMediaBounds(pName, pageSize, printableArea);
+        printableArea.getMinMaxPoints(printableMin, printableMax);
+        record.pageSize[0] = pageSize.x;
+        record.pageSize[1] = pageSize.y;
+        record.printableMin[0] = printableMin.x;
+        record.printableMin[1] = printableMin.y;
+        record.printableMax[0] = printableMax.x;
+        record.printableMax[1] = printableMax.y;
+        records.push_back(record);
+        acutDelString(pName);
+    }
+
+    /* At most half full, so that a probe for a missing name ends quickly. */
+    size_t bucketCount = 1;
+    while (bucketCount < records.size() * 2)
+        bucketCount <<= 1;
+    std::vector<Adesk::UInt32> buckets(bucketCount, 0);
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        size_t bucket = records[i].hash & (bucketCount - 1);
+        while (buckets[bucket] != 0)
+            bucket = (bucket + 1) & (bucketCount - 1);
+        buckets[bucket] = static_cast<Adesk::UInt32>(i + 1);
+    }
+
+    const size_t stringsSize = strings.chars().size() * sizeof(ACHAR);
+    const size_t stringsOffset = sizeof(CatalogHeader) + records.size() * sizeof(CatalogMedia) +
+                                 bucketCount * sizeof(Adesk::UInt32);
+    if (stringsOffset + stringsSize > 0xFFFFFFFFu)
+        return Acad::eDataTooLarge;
+    header.mediaCount = static_cast<Adesk::UInt32>(records.size());
+    header.bucketCount = static_cast<Adesk::UInt32>(bucketCount);
+    header.recordsOffset = sizeof(CatalogHeader);
+    header.bucketsOffset = static_cast<Adesk::UInt32>(header.recordsOffset + records.size() * sizeof(CatalogMedia));
+    header.stringsOffset = static_cast<Adesk::UInt32>(stringsOffset);
+    header.stringsSize = static_cast<Adesk::UInt32>(stringsSize);
+    header.imageSize = static_cast<Adesk::UInt32>(stringsOffset + stringsSize);
+
+    std::shared_ptr<DeviceCatalog> pNew(new DeviceCatalog());
+    std::vector<Adesk::UInt8>& image = pNew->m_image;
+    image.resize(header.imageSize);
+    std::memcpy(image.data() + header.recordsOffset, records.data(), records.size() * sizeof(CatalogMedia));
+    std::memcpy(image.data() + header.bucketsOffset, buckets.data(), bucketCount * sizeof(Adesk::UInt32));
+    std::memcpy(image.data() + header.stringsOffset, strings.chars().data(), stringsSize);
+    std::memcpy(image.data(), &header, sizeof(header));
+    header.crc = imageCrc(image.data(), image.size());
+    std::memcpy(image.data() + kCrcOffset, &header.crc, sizeof(header.crc));
+
+    const Acad::ErrorStatus es = pNew->attach(image.data(), image.size());
+    if (es == Acad::eOk)
+        pCatalog = std::move(pNew);
+    return es;
+}
+
+Acad::ErrorStatus DeviceCatalog::load(const ACHAR* path, std::shared_ptr<const DeviceCatalog>& pCatalog)
+{
+    pCatalog.reset();
+    std::shared_ptr<DeviceCatalog> pNew(new DeviceCatalog());
+    Acad::ErrorStatus es = pNew->m_file.open(path, MappedFile::kReadOnly);
+    if (es != Acad::eOk)
+        return es;
+    es = pNew->attach(pNew->m_file.data(), static_cast<size_t>(pNew->m_file.size()));
+    if (es == Acad::eOk)
+        pCatalog = std::move(pNew);
+    return es;
+}
+
+Acad::ErrorStatus DeviceCatalog::attach(const Adesk::UInt8* pData, size_t size)
+{
+    /* Checked once here so that lookups can trust every offset. */
+    if (pData == nullptr || size < sizeof(CatalogHeader))
+        return Acad::eUnsupportedFileFormat;
+    const CatalogHeader* pHeader = reinterpret_cast<const CatalogHeader*>(pData);
+    if (pHeader->magic != kCatalogMagic || pHeader->charSize != sizeof(ACHAR))
+        return Acad::eUnsupportedFileFormat;
+    if (pHeader->version != kCatalogVersion)
+        return Acad::eInvalidDwgVersion;
+    if (pHeader->imageSize != size || pHeader->crc != imageCrc(pData, size))
+        return Acad::eUnsupportedFileFormat;
+
+    const Adesk::UInt64 bucketCount = pHeader->bucketCount;
+    if (pHeader->recordsOffset != sizeof(CatalogHeader) ||
+        pHeader->bucketsOffset != pHeader->recordsOffset + Adesk::UInt64(pHeader->mediaCount) * sizeof(CatalogMedia) ||
+        bucketCount == 0 || (bucketCount & (bucketCount - 1)) != 0 || bucketCount < pHeader->mediaCount * 2ull ||
+        pHeader->stringsOffset != pHeader->bucketsOffset + bucketCount * sizeof(Adesk::UInt32) ||
+        Adesk::UInt64(pHeader->stringsOffset) + pHeader->stringsSize != size ||
+        pHeader->stringsSize < sizeof(ACHAR) || pHeader->stringsSize % sizeof(ACHAR) != 0)
+        return Acad::eUnsupportedFileFormat;
+
+    const ACHAR* pStrings = reinterpret_cast<const ACHAR*>(pData + pHeader->stringsOffset);
+    const size_t stringsLength = pHeader->stringsSize / sizeof(ACHAR);
+    if (pStrings[stringsLength - 1] != 0)
+        return Acad::eUnsupportedFileFormat;
+    const auto validString = [&](Adesk::UInt32 offset)
+    {
+        return offset % sizeof(ACHAR) == 0 && offset < pHeader->stringsSize;
+    };
+    if (!validString(pHeader->fullPath) || !validString(pHeader->deviceName))
+        return Acad::eUnsupportedFileFormat;
+
+    const CatalogMedia* pRecords = reinterpret_cast<const CatalogMedia*>(pData + pHeader->recordsOffset);
+    for (Adesk::UInt32 i = 0; i < pHeader->mediaCount; ++i)
+    {
+        if (!validString(pRecords[i].canonicalName) || !validString(pRecords[i].localName))
+            return Acad::eUnsupportedFileFormat;
+    }
+    const Adesk::UInt32* pBuckets = reinterpret_cast<const Adesk::UInt32*>(pData + pHeader->bucketsOffset);
+    for (Adesk::UInt64 i = 0; i < bucketCount; ++i)
+    {
+        if (pBuckets[i] > pHeader->mediaCount)
+            return Acad::eUnsupportedFileFormat;
+    }
+
+    m_pData = pData;
+    m_size = size;
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus DeviceCatalog::save(const ACHAR* path) const
+{
+    return writeFileAtomically(path, m_pData, m_size);
+}
+
+const ACHAR* DeviceCatalog::string(Adesk::UInt32 offset) const
+{
+    const CatalogHeader* pHeader = reinterpret_cast<const CatalogHeader*>(m_pData);
+    return reinterpret_cast<const ACHAR*>(m_pData + pHeader->stringsOffset + offset);
+}
+
+const ACHAR* DeviceCatalog::fullPath() const
+{
+    return string(reinterpret_cast<const CatalogHeader*>(m_pData)->fullPath);
+}
+
+const ACHAR* DeviceCatalog::deviceName() const
+{
+    return string(reinterpret_cast<const CatalogHeader*>(m_pData)->deviceName);
+}
+
+unsigned int DeviceCatalog::maxDeviceDPI() const
+{
+    return reinterpret_cast<const CatalogHeader*>(m_pData)->maxDeviceDPI;
+}
+
+Adesk::UInt64 DeviceCatalog::sourceTime() const
+{
+    return reinterpret_cast<const CatalogHeader*>(m_pData)->sourceTime;
+}
+
+Adesk::UInt64 DeviceCatalog::sourceSize() const
+{
+    return reinterpret_cast<const CatalogHeader*>(m_pData)->sourceSize;
+}
+
+size_t DeviceCatalog::mediaCount() const
+{
+    return reinterpret_cast<const CatalogHeader*>(m_pData)->mediaCount;
+}
+
+DeviceMedia DeviceCatalog::media(size_t index) const
+{
+    const CatalogHeader* pHeader = reinterpret_cast<const CatalogHeader*>(m_pData);
+    const CatalogMedia& record = reinterpret_cast<const CatalogMedia*>(m_pData + pHeader->recordsOffset)[index];
+    DeviceMedia media;
+    media.canonicalName = string(record.canonicalName);
+    media.localName = string(record.localName);
+    media.pageSize.set(record.pageSize[0], record.pageSize[1]);
+    media.printableMin.set(record.printableMin[0], record.printableMin[1]);
+    media.printableMax.set(record.printableMax[0], record.printableMax[1]);
+    return media;
+}
+
+bool DeviceCatalog::findMedia(const ACHAR* canonicalName, DeviceMedia& media) const
+{
+    if (canonicalName == nullptr)
+        return false;
+    const CatalogHeader* pHeader = reinterpret_cast<const CatalogHeader*>(m_pData);
+    const CatalogMedia* pRecords = reinterpret_cast<const CatalogMedia*>(m_pData + pHeader->recordsOffset);
+    const Adesk::UInt32* pBuckets = reinterpret_cast<const Adesk::UInt32*>(m_pData + pHeader->bucketsOffset);
+    const Adesk::UInt32 mask = pHeader->bucketCount - 1;
+    const Adesk::UInt32 hash = hashName(canonicalName);
+    for (Adesk::UInt32 bucket = hash & mask; pBuckets[bucket] != 0; bucket = (bucket + 1) & mask)
+    {
+        const Adesk::UInt32 index = pBuckets[bucket] - 1;
+        if (pRecords[index].hash == hash && std::wcscmp(string(pRecords[index].canonicalName), canonicalName) == 0)
+        {
+            media = this->media(index);
+            return true;
+        }
+    }
+    return false;
+}
+
+const ACHAR* DeviceCatalog::localMediaName(const ACHAR* canonicalName) const
+{
+    DeviceMedia media;
+    return findMedia(canonicalName, media) ? media.localName : nullptr;
+}
+
+bool DeviceCatalog::getMediaBounds(const ACHAR* canonicalName, AcGePoint2d& pageSize,
+                                   AcGeBoundBlock2d& printableArea) const
+{
+    DeviceMedia media;
+    if (!findMedia(canonicalName, media))
+    {
+        pageSize.set(0.0, 0.0);
+        printableArea.set(AcGePoint2d::kOrigin, AcGePoint2d::kOrigin);
+        return false;
+    }
+    pageSize = media.pageSize;
+    printableArea.set(media.printableMin, media.printableMax);
+    return true;
+}
+
+/* DeviceCatalogCache ------------------------------------------------------ */
+
+DeviceCatalogCache::DeviceCatalogCache(const DeviceCatalogCacheSettings& settings)
+    : m_settings(settings)
+    , m_memoryHits(0)
+    , m_diskHits(0)
+    , m_builds(0)
+{
+}
+
+std::wstring DeviceCatalogCache::cachePath(const std::wstring& key) const
+{
+    static const wchar_t kHexDigits[] = L"0123456789abcdef";
+    const Adesk::UInt64 hash = fnv1a64(key.data(), key.size() * sizeof(wchar_t));
+    std::wstring path(m_settings.directory);
+    if (!path.empty() && path.back() != L'\\' && path.back() != L'/')
+        path += L'\\';
+    for (int shift = 60; shift >= 0; shift -= 4)
+        path += kHexDigits[(hash >> shift) & 0xF];
+    path += L".pmc";
+    return path;
+}
+
+Acad::ErrorStatus DeviceCatalogCache::catalog(const AcPlPlotConfig& config,
+                                              std::shared_ptr<const DeviceCatalog>& pCatalog)
+{
+    /* Devices without a PC3 file, such as "None", are known by name. */
+    const ACHAR* pPath = config.fullPath();
+    return lookup(pPath != nullptr && *pPath != 0 ? pPath : config.deviceName(), &config, pCatalog);
+}
+
+Acad::ErrorStatus DeviceCatalogCache::catalog(const ACHAR* fullPath, std::shared_ptr<const DeviceCatalog>& pCatalog)
+{
+    return lookup(fullPath, nullptr, pCatalog);
+}
+
+Acad::ErrorStatus DeviceCatalogCache::lookup(const ACHAR* fullPath, const AcPlPlotConfig* pConfig,
+                                             std::shared_ptr<const DeviceCatalog>& pCatalog)
+{
+    pCatalog.reset();
+    if (fullPath == nullptr)
+        return Acad::eNullPtr;
+
+    const std::wstring key = keyOf(fullPath);
+    const Adesk::UInt64 now = steadyMilliseconds();
+    std::shared_ptr<const DeviceCatalog> pCached;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::unordered_map<std::wstring, Entry>::iterator it = m_entries.find(key);
+        if (it != m_entries.end())
+        {
+            if (now - it->second.checkedAt < m_settings.revalidateMilliseconds)
+            {
+                m_memoryHits.fetch_add(1, std::memory_order_relaxed);
+                pCatalog = it->second.pCatalog;
+                return Acad::eOk;
+            }
+            pCached = it->second.pCatalog;
+        }
+    }
+
+    /* The PC3 file is looked at without holding the lock. */
+    Adesk::UInt64 sourceTime = 0, sourceSize = 0;
+    statSource(fullPath, sourceTime, sourceSize);
+    const auto current = [&](const std::shared_ptr<const DeviceCatalog>& p)
+    {
+        return p != nullptr && p->sourceTime() == sourceTime && p->sourceSize() == sourceSize &&
+               keyOf(*p->fullPath() != 0 ? p->fullPath() : p->deviceName()) == key;
+    };
+
+    if (current(pCached))
+    {
+        m_memoryHits.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        pCached.reset();
+        const std::wstring path = m_settings.directory.empty() ? std::wstring() : cachePath(key);
+        if (!path.empty() && DeviceCatalog::load(path.c_str(), pCached) == Acad::eOk && current(pCached))
+        {
+            m_diskHits.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            pCached.reset();
+            if (pConfig == nullptr)
+                return Acad::eKeyNotFound;
+            const Acad::ErrorStatus es = DeviceCatalog::build(*pConfig, sourceTime, sourceSize, pCached);
+            if (es != Acad::eOk)
+                return es;
+            m_builds.fetch_add(1, std::memory_order_relaxed);
+
+            /* The catalog is still good for this session if it cannot be
+            saved; the next session simply builds it again. */
+            if (!path.empty())
+                pCached->save(path.c_str());
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Entry& entry = m_entries[key];
+        entry.pCatalog = pCached;
+        entry.checkedAt = now;
+    }
+    pCatalog = std::move(pCached);
+    return Acad::eOk;
+}
+
+void DeviceCatalogCache::invalidate(const ACHAR* fullPath)
+{
+    if (fullPath == nullptr)
+        return;
+    const std::wstring key = keyOf(fullPath);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries.erase(key);
+    }
+    if (!m_settings.directory.empty())
+        ::DeleteFileW(cachePath(key).c_str());
+}
+
+void DeviceCatalogCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+}
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,176 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// One media size of a device, as AcPlPlotConfig reports it.  The names
+/// point into the DeviceCatalog and live as long as it does.
+/// </summary>
+struct DeviceMedia
+{
+    const ACHAR* canonicalName;
+    const ACHAR* localName;
+    AcGePoint2d  pageSize;
+    AcGePoint2d  printableMin;
+    AcGePoint2d  printableMax;
+};
+
+/// <summary>
+/// The media sizes, localized media names, media bounds and maximum DPI of a
+/// plot device, captured once from its AcPlPlotConfig and read without
+/// asking the device again.
+///
+/// A catalog is one contiguous, read-only image that is used in place,
+/// whether it was just built or mapped from a cache file: a header, a table
+/// of fixed-size media records, an open-addressing hash table over the
+/// canonical names and a pool of null-terminated strings.  Lookups are a
+/// hash, a probe or two and a string compare, and allocate nothing.
+/// Catalogs never change once made, so any number of threads may read one.
+/// </summary>
+class DeviceCatalog
+{
+public:
+    DeviceCatalog(const DeviceCatalog&) = delete;
+    DeviceCatalog& operator=(const DeviceCatalog&) = delete;
+
+    /// <summary>
+    /// Captures the catalog of config.  sourceTime and sourceSize identify
+    /// the PC3 file the config was loaded from, 0 if it has none.
+    /// </summary>
+    static Acad::ErrorStatus build(const AcPlPlotConfig& config, Adesk::UInt64 sourceTime, Adesk::UInt64 sourceSize,
+                                   std::shared_ptr<const DeviceCatalog>& pCatalog);
+
+    /// <summary>
+    /// Maps a catalog written by save().  Returns Acad::eUnsupportedFileFormat
+    /// for a file that is not an intact catalog.
+    /// </summary>
+    static Acad::ErrorStatus load(const ACHAR* path, std::shared_ptr<const DeviceCatalog>& pCatalog);
+
+    Acad::ErrorStatus save(const ACHAR* path) const;
+
+    const ACHAR* fullPath() const;
+    const ACHAR* deviceName() const;
+    unsigned int maxDeviceDPI() const;
+    Adesk::UInt64 sourceTime() const;
+    Adesk::UInt64 sourceSize() const;
+
+    size_t mediaCount() const;
+    DeviceMedia media(size_t index) const;
+
+    /// <summary>
+    /// Finds a media size by canonical name.  Returns false if the device has
+    /// no such media.
+    /// </summary>
+    bool findMedia(const ACHAR* canonicalName, DeviceMedia& media) const;
+
+    /// <summary>
+    /// The AcPlPlotConfig queries, answered from the catalog.  Unknown media
+    /// have a null local name and empty bounds, as with the device.
+    /// </summary>
+    const ACHAR* localMediaName(const ACHAR* canonicalName) const;
+    bool getMediaBounds(const ACHAR* canonicalName, AcGePoint2d& pageSize, AcGeBoundBlock2d& printableArea) const;
+
+private:
+    DeviceCatalog();
+
+    Acad::ErrorStatus attach(const Adesk::UInt8* pData, size_t size);
+    const ACHAR* string(Adesk::UInt32 offset) const;
+
+    std::vector<Adesk::UInt8> m_image;      // a catalog that was built
+    MappedFile                m_file;       // a catalog that was loaded
+    const Adesk::UInt8*       m_pData;
+    size_t                    m_size;
+};
+
+struct DeviceCatalogCacheSettings
+{
+    /// <summary>
+    /// Folder the catalogs are saved in, one file per device, so that they
+    /// outlive the process.  Empty keeps them in memory only.
+    /// </summary>
+    std::wstring directory;
+
+    /// <summary>
+    /// How long a catalog is used before the PC3 file's time stamp is checked
+    /// again.  0 checks on every lookup.
+    /// </summary>
+    unsigned revalidateMilliseconds = 1000;
+};
+
+/// <summary>
+/// Catalogs of the plot devices in use, keyed by AcPlPlotConfig::fullPath()
+/// and the last write time and size of that PC3 file.
+///
+/// Mapping paper sizes for every sheet of a job calls
+/// getCanonicalMediaNameList, getLocalMediaName and getMediaBounds
+/// thousands of times, and each call goes back to the device driver.  The
+/// cache captures a device once, saves the catalog to the settings'
+/// directory, and maps it from there in later sessions.  A catalog is
+/// rebuilt as soon as its PC3 file's time stamp or size changes; system
+/// printers, which have no PC3 file, are only rebuilt after invalidate().
+/// Changes to a PMP file alone are not noticed either.
+///
+/// All methods may be called from any thread, but a rebuild calls into the
+/// AcPlPlotConfig, which only AutoCAD's main thread may do.
+/// </summary>
+class DeviceCatalogCache
+{
+public:
+    explicit DeviceCatalogCache(const DeviceCatalogCacheSettings& settings = DeviceCatalogCacheSettings());
+
+    DeviceCatalogCache(const DeviceCatalogCache&) = delete;
+    DeviceCatalogCache& operator=(const DeviceCatalogCache&) = delete;
+
+    /// <summary>
+    /// Returns the catalog of config's device, from memory, from the cache
+    /// directory or by capturing it from config, in that order of
+    /// preference.
+    /// </summary>
+    Acad::ErrorStatus catalog(const AcPlPlotConfig& config, std::shared_ptr<const DeviceCatalog>& pCatalog);
+
+    /// <summary>
+    /// Returns the catalog of the device at fullPath without a config to
+    /// rebuild it from, or Acad::eKeyNotFound if it is not cached or is out
+    /// of date.  Lets callers skip loading the PC3 file altogether.
+    /// </summary>
+    Acad::ErrorStatus catalog(const ACHAR* fullPath, std::shared_ptr<const DeviceCatalog>& pCatalog);
+
+    /// <summary>
+    /// Forgets the catalog of the device at fullPath, in memory and on disk.
+    /// </summary>
+    void invalidate(const ACHAR* fullPath);
+
+    /// <summary>
+    /// Forgets every catalog held in memory.  Saved catalogs stay valid.
+    /// </summary>
+    void clear();
+
+    Adesk::UInt64 memoryHitCount() const { return m_memoryHits.load(std::memory_order_relaxed); }
+    Adesk::UInt64 diskHitCount() const { return m_diskHits.load(std::memory_order_relaxed); }
+    Adesk::UInt64 buildCount() const { return m_builds.load(std::memory_order_relaxed); }
+
+private:
+    struct Entry
+    {
+        std::shared_ptr<const DeviceCatalog> pCatalog;
+        Adesk::UInt64                        checkedAt = 0;   // milliseconds on the steady clock
+    };
+
+    Acad::ErrorStatus lookup(const ACHAR* fullPath, const AcPlPlotConfig* pConfig,
+                             std::shared_ptr<const DeviceCatalog>& pCatalog);
+    std::wstring cachePath(const std::wstring& key) const;
+
+    DeviceCatalogCacheSettings                m_settings;
+    std::mutex                                m_mutex;
+    std::unordered_map<std::wstring, Entry>   m_entries;     // keyed by lower-case full path
+    std::atomic<Adesk::UInt64>                m_memoryHits;
+    std::atomic<Adesk::UInt64>                m_diskHits;
+    std::atomic<Adesk::UInt64>                m_builds;
+};
+
+} // namespace acad_sheetset_to_pdf
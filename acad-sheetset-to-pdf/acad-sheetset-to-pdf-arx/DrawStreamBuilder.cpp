@@ -0,0 +1,205 @@
+#include "stdafx.h"
+#include "DrawStreamBuilder.h"
+#include "ParallelFor.h"
+#include "ReadWriteStreams.h"
+
+#include <new>
+#include <numeric>
+#include <unordered_map>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+bool writeAll(IAcWriteStream& output, const void* pBytes, size_t size)
+{
+    size_t written = 0;
+    return size == 0 || (output.write(pBytes, size, &written) == IAcWriteStream::eOk && written == size);
+}
+
+} // namespace
+
+struct DrawStreamBuilder::Scratch
+{
+    AcArray<AcGiDrawStream*>    streams;    // of the group being built
+    std::vector<Adesk::UInt32>  positions;  // of those streams in the array
+    ArenaStream                 arena;      // serialized streams, one after the other
+};
+
+DrawStreamBuilder::DrawStreamBuilder(unsigned threadCount, Partition partition)
+    : m_threadCount(threadCount),
+      m_partition(partition)
+{
+}
+
+DrawStreamBuilder::~DrawStreamBuilder()
+{
+}
+
+void DrawStreamBuilder::partition(const AcArray<AcGiDrawStream*>& streams, Partition partition,
+                                  DrawStreamGroups& groups)
+{
+    groups.offsets.clear();
+    groups.streams.clear();
+
+    /* Number the groups in the order they first appear, count their
+    streams, then lay them out one after the other, each in array order. */
+    const size_t count = static_cast<size_t>(streams.length());
+    const Adesk::UInt32 kNone = 0xFFFFFFFFu;
+    std::vector<Adesk::UInt32> groupOf(count, kNone);
+    std::unordered_map<const void*, Adesk::UInt32> groupByKey;
+    std::vector<size_t> sizes;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const AcGiDrawStream* pStream = streams[static_cast<int>(i)];
+        if (pStream == nullptr)
+            continue;
+        const AcGiDrawable* pOwner = pStream->getOwner();
+        const void* pKey = pOwner;
+        if (pOwner != nullptr && partition == kByDatabase)
+        {
+            AcDbDatabase* pDatabase = pOwner->id().database();
+            if (pDatabase != nullptr)
+                pKey = pDatabase;
+        }
+
+        Adesk::UInt32 group = static_cast<Adesk::UInt32>(sizes.size());
+        if (pKey != nullptr)
+            group = groupByKey.emplace(pKey, group).first->second;
+        if (group == sizes.size())
+            sizes.push_back(0);
+        groupOf[i] = group;
+        ++sizes[group];
+    }
+
+    groups.offsets.resize(sizes.size() + 1);
+    groups.offsets[0] = 0;
+    for (size_t g = 0; g < sizes.size(); ++g)
+        groups.offsets[g + 1] = groups.offsets[g] + sizes[g];
+    groups.streams.resize(groups.offsets.back());
+    std::vector<size_t> next(groups.offsets.begin(), groups.offsets.end() - 1);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (groupOf[i] != kNone)
+            groups.streams[next[groupOf[i]]++] = static_cast<Adesk::UInt32>(i);
+    }
+}
+
+bool DrawStreamBuilder::build(const AcArray<AcGiDrawStream*>& streams, GraphicsUpdateProc lpFunc,
+                              IAcWriteStream* pOutput)
+{
+    const size_t count = static_cast<size_t>(streams.length());
+    try
+    {
+        m_built.assign(count, 0);
+        m_placements.assign(pOutput != nullptr ? count : 0, Placement());
+        partition(streams, m_partition, m_groups);
+
+        const size_t groupCount = m_groups.size();
+        unsigned threadCount = m_threadCount != 0 ? m_threadCount : defaultThreadCount();
+        threadCount = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threadCount, groupCount)));
+        while (m_scratch.size() < threadCount)
+            m_scratch.push_back(std::unique_ptr<Scratch>(new Scratch()));
+        for (const std::unique_ptr<Scratch>& pScratch : m_scratch)
+            pScratch->arena.clear();
+
+        if (threadCount == 1)
+        {
+            for (size_t g = 0; g < groupCount; ++g)
+                buildGroup(streams, g, lpFunc, pOutput != nullptr, 0);
+        }
+        else
+        {
+            /* Largest groups first, so that a big one is not left to run
+            on its own at the end; ties keep array order. */
+            m_order.resize(groupCount);
+            std::iota(m_order.begin(), m_order.end(), size_t(0));
+            std::stable_sort(m_order.begin(), m_order.end(), [&](size_t a, size_t b)
+            {
+                return m_groups.offsets[a + 1] - m_groups.offsets[a] > m_groups.offsets[b + 1] - m_groups.offsets[b];
+            });
+            parallelFor(groupCount, threadCount, [&](size_t index, unsigned worker)
+            {
+                buildGroup(streams, m_order[index], lpFunc, pOutput != nullptr, worker);
+            });
+        }
+    }
+    catch (const std::bad_alloc&)
+    {
+        return false;
+    }
+
+    bool complete = true;
+    bool writing = pOutput != nullptr;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!m_built[i])
+        {
+            complete = complete && streams[static_cast<int>(i)] == nullptr;
+            continue;
+        }
+        if (pOutput == nullptr)
+            continue;
+
+        /* A stream that fails to go out is not built as far as the caller
+        is concerned, and neither is any after it. */
+        const Placement& placement = m_placements[i];
+        unsigned char length[8];
+        for (int b = 0; b < 8; ++b)
+            length[b] = static_cast<unsigned char>(Adesk::UInt64(placement.size) >> (8 * b));
+        const unsigned char* pBytes = m_scratch[placement.worker]->arena.data() + placement.offset;
+        writing = writing && writeAll(*pOutput, length, sizeof(length)) && writeAll(*pOutput, pBytes, placement.size);
+        if (!writing)
+        {
+            m_built[i] = 0;
+            complete = false;
+        }
+    }
+    return complete;
+}
+
+void DrawStreamBuilder::buildGroup(const AcArray<AcGiDrawStream*>& streams, size_t group, GraphicsUpdateProc lpFunc,
+                                   bool serialize, unsigned worker)
+{
+    Scratch& scratch = *m_scratch[worker];
+    scratch.streams.setLogicalLength(0);
+    scratch.positions.clear();
+    for (size_t k = m_groups.offsets[group]; k < m_groups.offsets[group + 1]; ++k)
+    {
+        const Adesk::UInt32 position = m_groups.streams[k];
+        AcGiDrawStream* pStream = streams[static_cast<int>(position)];
+        if (acdbBeginDrawStreamBuilding(pStream))
+        {
+            scratch.streams.append(pStream);
+            scratch.positions.push_back(position);
+        }
+    }
+    if (scratch.positions.empty())
+        return;
+
+    const bool built = AcGiDrawStream::build(scratch.streams, lpFunc);
+    for (int k = 0; k < scratch.streams.length(); ++k)
+        acdbEndDrawStreamBuilding(scratch.streams[k]);
+    if (!built)
+        return;
+
+    for (size_t k = 0; k < scratch.positions.size(); ++k)
+    {
+        const Adesk::UInt32 position = scratch.positions[k];
+        if (serialize)
+        {
+            const size_t offset = scratch.arena.size();
+            if (!scratch.streams[static_cast<int>(k)]->serializeOut(&scratch.arena))
+            {
+                scratch.arena.truncate(offset);
+                continue;
+            }
+            m_placements[position].worker = worker;
+            m_placements[position].offset = offset;
+            m_placements[position].size = scratch.arena.size() - offset;
+        }
+        m_built[position] = 1;
+    }
+}
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "acgidrawstream.h"
+#include "IAcReadWriteStream.h"
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// Streams that can be built independently of one another: the streams of
+/// group g are streams[offsets[g]] .. streams[offsets[g + 1] - 1], as
+/// positions in the array that was partitioned, in array order.
+/// </summary>
+struct DrawStreamGroups
+{
+    std::vector<size_t>         offsets;
+    std::vector<Adesk::UInt32>  streams;
+
+    size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+};
+
+/// <summary>
+/// Builds AcGiDrawStreams on several threads.
+///
+/// AcGiDrawStream::build takes one flat array and builds it on the calling
+/// thread.  build() splits the array into groups that share nothing and
+/// hands them to worker threads, largest first, one at a time as the
+/// workers come free.  By default the streams whose owners are in one
+/// database make one group, since drawing reads the database; kByOwner
+/// groups the streams of each owner instead, for drawables whose drawing
+/// touches nothing another owner's could.  Streams without an owner are
+/// each a group of their own.
+///
+/// Each group is built with one AcGiDrawStream::build call, bracketed by
+/// acdbBeginDrawStreamBuilding and acdbEndDrawStreamBuilding for each of
+/// its streams.
+///
+/// With an output stream, every stream is serialized as soon as it is
+/// built, into a buffer kept by the worker thread from one build to the
+/// next, and the buffers are then written out in array order, each stream
+/// preceded by its length in bytes as a little-endian 64-bit integer, so
+/// the output is the same whatever the threads did.
+///
+/// lpFunc is called from the worker threads, one group at a time on each.
+/// A builder with one thread builds on the calling thread.  A builder is
+/// used by one thread at a time.
+/// </summary>
+class DrawStreamBuilder
+{
+public:
+    enum Partition
+    {
+        kByDatabase,
+        kByOwner
+    };
+
+    /// <summary>
+    /// threadCount 0 means one per hardware thread.
+    /// </summary>
+    explicit DrawStreamBuilder(unsigned threadCount = 0, Partition partition = kByDatabase);
+    ~DrawStreamBuilder();
+
+    DrawStreamBuilder(const DrawStreamBuilder&) = delete;
+    DrawStreamBuilder& operator=(const DrawStreamBuilder&) = delete;
+
+    /// <summary>
+    /// Splits streams into groups, each in the order its first stream
+    /// appears.  Null streams are left out.
+    /// </summary>
+    static void partition(const AcArray<AcGiDrawStream*>& streams, Partition partition, DrawStreamGroups& groups);
+
+    /// <summary>
+    /// Builds streams and, if pOutput is not null, writes them to it.
+    /// Returns true if every stream was built and written; built() says
+    /// which were.
+    /// </summary>
+    bool build(const AcArray<AcGiDrawStream*>& streams, GraphicsUpdateProc lpFunc, IAcWriteStream* pOutput = nullptr);
+
+    /// <summary>
+    /// For each stream of the last build, whether it was built, and
+    /// serialized if there was an output.
+    /// </summary>
+    const std::vector<unsigned char>& built() const { return m_built; }
+
+    /// <summary>
+    /// The groups of the last build.
+    /// </summary>
+    const DrawStreamGroups& groups() const { return m_groups; }
+
+private:
+    struct Scratch;
+
+    struct Placement
+    {
+        unsigned    worker;
+        size_t      offset;     // in the worker's buffer
+        size_t      size;
+    };
+
+    void buildGroup(const AcArray<AcGiDrawStream*>& streams, size_t group, GraphicsUpdateProc lpFunc,
+                    bool serialize, unsigned worker);
+
+    unsigned                                m_threadCount;
+    Partition                               m_partition;
+    DrawStreamGroups                        m_groups;
+    std::vector<size_t>                     m_order;        // groups, largest first
+    std::vector<unsigned char>              m_built;
+    std::vector<Placement>                  m_placements;   // of each serialized stream
+    std::vector<std::unique_ptr<Scratch>>   m_scratch;      // one per worker
+};
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,340 @@
+#include "stdafx.h"
+#include "DrawStreamCache.h"
+#include "AtomicFile.h"
+#include "Checksum.h"
+#include "Lz4Block.h"
+#include "MappedFile.h"
+#include "ReadWriteStreams.h"
+
+#include <cstring>
+#include <new>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+/* An entry file, in native byte order since it never leaves the machine
+that made it:
+
+    EntryHeader
+    UInt8[packedSize]           the serialized stream, LZ4 block or as is
+
+The CRC covers the whole file but its own field. */
+const Adesk::UInt32 kEntryMagic = 0x43534744;      // "DGSC"
+const Adesk::UInt32 kEntryVersion = 1;
+const wchar_t kEntryExtension[] = L".dsc";
+
+enum Codec
+{
+    kStored = 0,
+    kLz4 = 1
+};
+
+struct EntryHeader
+{
+    Adesk::UInt32 magic;
+    Adesk::UInt32 version;
+    Adesk::UInt64 key;
+    Adesk::UInt64 generation;
+    Adesk::UInt64 rawSize;
+    Adesk::UInt64 packedSize;
+    Adesk::UInt32 codec;
+    Adesk::UInt32 crc;
+};
+static_assert(sizeof(EntryHeader) == 48, "entry header layout");
+
+const size_t kCrcOffset = offsetof(EntryHeader, crc);
+
+Adesk::UInt32 entryCrc(const Adesk::UInt8* pData, size_t size)
+{
+    const Adesk::UInt32 crc = crc32(pData, kCrcOffset);
+    return crc32(pData + kCrcOffset + sizeof(Adesk::UInt32), size - kCrcOffset - sizeof(Adesk::UInt32), crc);
+}
+
+/* Collects what a stream serializes out, after room left for the entry
+header so that a stream saved as it is needs no second copy. */
+class EntryWriteStream : public IAcWriteStream
+{
+public:
+    EntryWriteStream()
+        : m_bytes(sizeof(EntryHeader))
+    {
+    }
+
+    ~EntryWriteStream() {}
+
+    int read(void*, size_t, size_t* pNumRead) override
+    {
+        if (pNumRead != nullptr)
+            *pNumRead = 0;
+        return eNotSupported;
+    }
+
+    int write(const void* pSrcBuf, size_t nNumBytes, size_t* pNumWritten) override
+    {
+        if (pNumWritten != nullptr)
+            *pNumWritten = 0;
+        if (pSrcBuf == nullptr && nNumBytes != 0)
+            return eInvalidArg;
+        try
+        {
+            const Adesk::UInt8* pBytes = static_cast<const Adesk::UInt8*>(pSrcBuf);
+            m_bytes.insert(m_bytes.end(), pBytes, pBytes + nNumBytes);
+        }
+        catch (const std::bad_alloc&)
+        {
+            return eDiskFull;
+        }
+        if (pNumWritten != nullptr)
+            *pNumWritten = nNumBytes;
+        return eOk;
+    }
+
+    Adesk::Int64 tell() override { return static_cast<Adesk::Int64>(m_bytes.size() - sizeof(EntryHeader)); }
+
+    std::vector<Adesk::UInt8>& bytes() { return m_bytes; }
+
+private:
+    std::vector<Adesk::UInt8> m_bytes;
+};
+
+/* Eviction goes by last write time, which a hit moves to now; last access
+times are not kept up to date on most volumes. */
+void markUsed(const std::wstring& path)
+{
+    HANDLE hFile = ::CreateFileW(path.c_str(), FILE_WRITE_ATTRIBUTES,
+                                 FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                                 FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return;
+    FILETIME now;
+    ::GetSystemTimeAsFileTime(&now);
+    ::SetFileTime(hFile, nullptr, nullptr, &now);
+    ::CloseHandle(hFile);
+}
+
+struct EntryFile
+{
+    Adesk::UInt64   writeTime;
+    Adesk::UInt64   size;
+    std::wstring    name;
+};
+
+} // namespace
+
+DrawStreamCache::DrawStreamCache(const DrawStreamCacheSettings& settings)
+    : m_settings(settings),
+      m_bytes(0),
+      m_bytesKnown(false),
+      m_hits(0),
+      m_misses(0),
+      m_stores(0),
+      m_evictions(0)
+{
+    if (!m_settings.directory.empty() && m_settings.directory.back() != L'\\' && m_settings.directory.back() != L'/')
+        m_settings.directory += L'\\';
+}
+
+std::wstring DrawStreamCache::entryPath(Adesk::UInt64 key) const
+{
+    static const wchar_t kHexDigits[] = L"0123456789abcdef";
+    std::wstring path(m_settings.directory);
+    for (int shift = 60; shift >= 0; shift -= 4)
+        path += kHexDigits[(key >> shift) & 0xF];
+    path += kEntryExtension;
+    return path;
+}
+
+Acad::ErrorStatus DrawStreamCache::store(Adesk::UInt64 key, const AcGiDrawStream& stream)
+{
+    if (m_settings.directory.empty())
+        return Acad::eNotApplicable;
+
+    EntryWriteStream output;
+    if (!stream.serializeOut(&output))
+        return Acad::eNotApplicable;
+
+    std::vector<Adesk::UInt8>& raw = output.bytes();
+    const size_t rawSize = raw.size() - sizeof(EntryHeader);
+    std::vector<Adesk::UInt8> packed;
+    std::vector<Adesk::UInt8>* pEntry = &raw;
+    EntryHeader header = {};
+    header.magic = kEntryMagic;
+    header.version = kEntryVersion;
+    header.key = key;
+    header.generation = m_settings.generation;
+    header.rawSize = rawSize;
+    header.packedSize = rawSize;
+    header.codec = kStored;
+    if (m_settings.compress && rawSize != 0)
+    {
+        try
+        {
+            /* Only kept if it saves something. */
+            packed.resize(sizeof(EntryHeader) + rawSize - 1);
+            const size_t packedSize = lz4Compress(raw.data() + sizeof(EntryHeader), rawSize,
+                                                  packed.data() + sizeof(EntryHeader), rawSize - 1);
+            if (packedSize != 0)
+            {
+                packed.resize(sizeof(EntryHeader) + packedSize);
+                header.packedSize = packedSize;
+                header.codec = kLz4;
+                pEntry = &packed;
+            }
+        }
+        catch (const std::bad_alloc&)
+        {
+        }
+    }
+
+    std::vector<Adesk::UInt8>& entry = *pEntry;
+    std::memcpy(entry.data(), &header, sizeof(header));
+    const Adesk::UInt32 crc = entryCrc(entry.data(), entry.size());
+    std::memcpy(entry.data() + kCrcOffset, &crc, sizeof(crc));
+
+    const std::wstring path = entryPath(key);
+    const Acad::ErrorStatus es = writeFileAtomically(path.c_str(), entry.data(), entry.size());
+    if (es != Acad::eOk)
+        return es;
+    m_stores.fetch_add(1, std::memory_order_relaxed);
+
+    /* The first store finds out what the folder holds, and the stores
+    after it add to that.  A replaced entry is counted again, which only
+    brings the next trim forward. */
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_bytes += entry.size();
+    if (m_settings.maxBytes != 0 && (!m_bytesKnown || m_bytes > m_settings.maxBytes))
+        trimLocked();
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus DrawStreamCache::load(Adesk::UInt64 key, AcGiDrawStream& stream, AcDbDatabase* pDb)
+{
+    if (m_settings.directory.empty())
+        return Acad::eKeyNotFound;
+
+    const std::wstring path = entryPath(key);
+    MappedFile file;
+    if (file.open(path.c_str()) != Acad::eOk)
+    {
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+        return Acad::eKeyNotFound;
+    }
+
+    Acad::ErrorStatus es = Acad::eOk;
+    const Adesk::UInt8* const pData = file.data();
+    const Adesk::UInt64 size = file.size();
+    const EntryHeader* pHeader = reinterpret_cast<const EntryHeader*>(pData);
+    if (pData == nullptr || size < sizeof(EntryHeader) || pHeader->magic != kEntryMagic)
+        es = Acad::eUnsupportedFileFormat;
+    else if (pHeader->version != kEntryVersion || pHeader->generation != m_settings.generation)
+        es = Acad::eInvalidDwgVersion;
+    else if (pHeader->key != key || pHeader->packedSize != size - sizeof(EntryHeader) ||
+             (pHeader->codec != kStored && pHeader->codec != kLz4) ||
+             (pHeader->codec == kStored && pHeader->rawSize != pHeader->packedSize) ||
+             pHeader->rawSize > SIZE_MAX || pHeader->crc != entryCrc(pData, static_cast<size_t>(size)))
+        es = Acad::eUnsupportedFileFormat;
+
+    if (es == Acad::eOk)
+    {
+        const Adesk::UInt8* pStream = pData + sizeof(EntryHeader);
+        const size_t rawSize = static_cast<size_t>(pHeader->rawSize);
+        std::unique_ptr<Adesk::UInt8[]> pUnpacked;
+        if (pHeader->codec == kLz4)
+        {
+            pUnpacked.reset(new (std::nothrow) Adesk::UInt8[rawSize != 0 ? rawSize : 1]);
+            if (!pUnpacked)
+                es = Acad::eOutOfMemory;
+            else
+                es = lz4Decompress(pStream, static_cast<size_t>(pHeader->packedSize), pUnpacked.get(), rawSize);
+            pStream = pUnpacked.get();
+        }
+        if (es == Acad::eOk)
+        {
+            MemoryReadStream input(pStream, rawSize);
+            if (!stream.serializeIn(&input, pDb))
+                es = Acad::eInvalidInput;
+        }
+    }
+    file.close();
+
+    if (es == Acad::eOutOfMemory)
+        return es;
+    if (es != Acad::eOk)
+    {
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+        ::DeleteFileW(path.c_str());
+        return es;
+    }
+    m_hits.fetch_add(1, std::memory_order_relaxed);
+    markUsed(path);
+    return Acad::eOk;
+}
+
+void DrawStreamCache::remove(Adesk::UInt64 key)
+{
+    if (!m_settings.directory.empty())
+        ::DeleteFileW(entryPath(key).c_str());
+}
+
+void DrawStreamCache::trim()
+{
+    if (m_settings.directory.empty() || m_settings.maxBytes == 0)
+        return;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    trimLocked();
+}
+
+void DrawStreamCache::trimLocked()
+{
+    std::vector<EntryFile> entries;
+    Adesk::UInt64 total = 0;
+    WIN32_FIND_DATAW data;
+    const std::wstring pattern = m_settings.directory + L"*" + kEntryExtension;
+    HANDLE hFind = ::FindFirstFileW(pattern.c_str(), &data);
+    if (hFind != INVALID_HANDLE_VALUE)
+    {
+        try
+        {
+            do
+            {
+                if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+                    continue;
+                EntryFile entry;
+                entry.writeTime = (Adesk::UInt64(data.ftLastWriteTime.dwHighDateTime) << 32) |
+                                  data.ftLastWriteTime.dwLowDateTime;
+                entry.size = (Adesk::UInt64(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+                entry.name = data.cFileName;
+                total += entry.size;
+                entries.push_back(std::move(entry));
+            } while (::FindNextFileW(hFind, &data));
+        }
+        catch (const std::bad_alloc&)
+        {
+        }
+        ::FindClose(hFind);
+    }
+
+    /* Trimmed to nine tenths so that the next few stores do not trim again
+    straight away.  An entry another process has open is skipped. */
+    if (total > m_settings.maxBytes)
+    {
+        const Adesk::UInt64 target = m_settings.maxBytes - m_settings.maxBytes / 10;
+        std::sort(entries.begin(), entries.end(), [](const EntryFile& a, const EntryFile& b)
+        {
+            return a.writeTime < b.writeTime;
+        });
+        for (size_t i = 0; i < entries.size() && total > target; ++i)
+        {
+            if (::DeleteFileW((m_settings.directory + entries[i].name).c_str()))
+            {
+                total -= entries[i].size;
+                m_evictions.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+    m_bytes = total;
+    m_bytesKnown = true;
+}
+
+} // namespace acad_sheetset_to_pdf
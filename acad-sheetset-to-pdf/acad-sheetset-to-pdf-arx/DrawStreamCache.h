@@ -0,0 +1,114 @@
+#pragma once
+
+#include "acgidrawstream.h"
+#include "IAcReadWriteStream.h"
+
+#include <mutex>
+
+namespace acad_sheetset_to_pdf {
+
+struct DrawStreamCacheSettings
+{
+    /// <summary>
+    /// Folder the streams are saved in, one file per key.  It must exist;
+    /// with it empty nothing is cached.
+    /// </summary>
+    std::wstring directory;
+
+    /// <summary>
+    /// How many bytes of entries the folder may hold.  When a store takes
+    /// it past that, the entries used longest ago are deleted until it is
+    /// back under nine tenths of it.  0 means no limit.
+    /// </summary>
+    Adesk::UInt64 maxBytes = 1ull << 30;
+
+    /// <summary>
+    /// Saved in every entry; entries of any other generation are not read.
+    /// Change it whenever streams saved before can no longer be read back,
+    /// such as after an AutoCAD update.
+    /// </summary>
+    Adesk::UInt64 generation = 0;
+
+    /// <summary>
+    /// Whether entries are LZ4-compressed.  Streams that do not get smaller
+    /// are saved as they are either way, and read straight from the mapped
+    /// file.
+    /// </summary>
+    bool compress = true;
+};
+
+/// <summary>
+/// Serialized AcGiDrawStreams kept on disk from one publish to the next, so
+/// that the graphics of drawables that have not changed, such as xrefs and
+/// blocks, are read back instead of generated again.
+///
+/// Entries are found by content: the key is a hash of everything the
+/// graphics depend on, say fnv1a64 over the xref's file time and size and
+/// the block's handle, so an entry is never stale, only unused.  Keys that
+/// describe the same content from different drawings find the same entry.
+///
+/// store() serializes a stream through an IAcWriteStream into memory,
+/// compresses it and replaces the entry file atomically.  load() maps the
+/// entry, checks its header and CRC, and serializes the stream back in
+/// through an IAcReadStream over the mapped file, or over the decompressed
+/// bytes of a compressed entry.  An entry that cannot be read is deleted.
+/// Every load that hits marks the entry as used, and eviction deletes the
+/// least recently used entries first.
+///
+/// All methods may be called from any thread, and several processes may
+/// share a folder.
+/// </summary>
+class DrawStreamCache
+{
+public:
+    explicit DrawStreamCache(const DrawStreamCacheSettings& settings);
+
+    DrawStreamCache(const DrawStreamCache&) = delete;
+    DrawStreamCache& operator=(const DrawStreamCache&) = delete;
+
+    /// <summary>
+    /// Saves stream under key, replacing what was there.  Returns
+    /// Acad::eNotApplicable if the stream cannot be serialized.
+    /// </summary>
+    Acad::ErrorStatus store(Adesk::UInt64 key, const AcGiDrawStream& stream);
+
+    /// <summary>
+    /// Reads the stream saved under key into stream, resolving its object
+    /// ids in pDb.  Returns Acad::eKeyNotFound if there is none, and
+    /// another error if the entry was damaged, of another generation or did
+    /// not serialize in, in which case it is deleted.
+    /// </summary>
+    Acad::ErrorStatus load(Adesk::UInt64 key, AcGiDrawStream& stream, AcDbDatabase* pDb = nullptr);
+
+    /// <summary>
+    /// Deletes the entry of key.
+    /// </summary>
+    void remove(Adesk::UInt64 key);
+
+    /// <summary>
+    /// Deletes entries, least recently used first, until the folder holds
+    /// no more than nine tenths of maxBytes.  store() calls this when it
+    /// needs to.
+    /// </summary>
+    void trim();
+
+    Adesk::UInt64 hitCount() const { return m_hits.load(std::memory_order_relaxed); }
+    Adesk::UInt64 missCount() const { return m_misses.load(std::memory_order_relaxed); }
+    Adesk::UInt64 storeCount() const { return m_stores.load(std::memory_order_relaxed); }
+    Adesk::UInt64 evictionCount() const { return m_evictions.load(std::memory_order_relaxed); }
+
+private:
+    std::wstring entryPath(Adesk::UInt64 key) const;
+    void trimLocked();
+
+    DrawStreamCacheSettings     m_settings;
+    std::mutex                  m_mutex;            // serializes trimming
+    Adesk::UInt64               m_bytes;            // in the folder, as of the last trim and the stores since
+    bool                        m_bytesKnown;
+    std::atomic<Adesk::UInt64>  m_hits;
+    std::atomic<Adesk::UInt64>  m_misses;
+    std::atomic<Adesk::UInt64>  m_stores;
+    std::atomic<Adesk::UInt64>  m_evictions;
+};
+
+} // namespace acad_sheetset_to_pdf
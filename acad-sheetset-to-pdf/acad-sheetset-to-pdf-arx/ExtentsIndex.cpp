@@ -0,0 +1,301 @@
+#include "stdafx.h"
+#include "ExtentsIndex.h"
+#include "ParallelFor.h"
+
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+const size_t kFanout           = ExtentsIndex::kExtentsIndexFanout;
+const size_t kMaxDepth         = 9;      // 16^8 > 2^32 items
+const size_t kQueryChunk       = 1024;
+
+struct Box
+{
+    double minimum[3];
+    double maximum[3];
+
+    double centre(int axis) const { return minimum[axis] + maximum[axis]; }   // doubled, only compared
+};
+
+/* Sort-Tile-Recursive order of boxes: the positions of boxes, arranged so
+that every run of kFanout consecutive positions forms one node. */
+std::vector<Adesk::UInt32> strOrder(const std::vector<Box>& boxes, unsigned threadCount)
+{
+    const size_t count = boxes.size();
+    std::vector<Adesk::UInt32> order(count);
+    std::iota(order.begin(), order.end(), Adesk::UInt32(0));
+
+    const size_t nodeCount = (count + kFanout - 1) / kFanout;
+    size_t slices = 1;
+    while (slices * slices * slices < nodeCount)
+        ++slices;
+
+    auto byAxis = [&](int axis)
+    {
+        return [&boxes, axis](Adesk::UInt32 a, Adesk::UInt32 b) { return boxes[a].centre(axis) < boxes[b].centre(axis); };
+    };
+
+    std::sort(order.begin(), order.end(), byAxis(0));
+    const size_t slabSize = kFanout * slices * slices;
+    const size_t runSize = kFanout * slices;
+    const size_t slabCount = (count + slabSize - 1) / slabSize;
+    parallelFor(slabCount, threadCount,
+        [&](size_t slab, unsigned)
+        {
+            const size_t slabBegin = slab * slabSize;
+            const size_t slabEnd = std::min(slabBegin + slabSize, count);
+            std::sort(order.begin() + slabBegin, order.begin() + slabEnd, byAxis(1));
+            for (size_t runBegin = slabBegin; runBegin < slabEnd; runBegin += runSize)
+            {
+                const size_t runEnd = std::min(runBegin + runSize, slabEnd);
+                std::sort(order.begin() + runBegin, order.begin() + runEnd, byAxis(2));
+            }
+        });
+    return order;
+}
+
+} // namespace
+
+Acad::ErrorStatus ExtentsIndex::build(const AcGeBoundBlock3d* pExtents, size_t count, unsigned threadCount)
+{
+    if (count > 0 && pExtents == nullptr)
+        return Acad::eNullPtr;
+    std::vector<AcGePoint3d> minPoints(count), maxPoints(count);
+    for (size_t i = 0; i < count; ++i)
+        pExtents[i].getMinMaxPoints(minPoints[i], maxPoints[i]);
+    return build(minPoints.data(), maxPoints.data(), count, threadCount);
+}
+
+Acad::ErrorStatus ExtentsIndex::build(const AcGePoint3d* pMinPoints, const AcGePoint3d* pMaxPoints, size_t count,
+                                      unsigned threadCount)
+{
+    if (count > 0 && (pMinPoints == nullptr || pMaxPoints == nullptr))
+        return Acad::eNullPtr;
+    if (count > 0xFFFFFFFFu)
+        return Acad::eInvalidInput;
+    clear();
+    if (count == 0)
+        return Acad::eOk;
+    if (threadCount == 0)
+        threadCount = defaultThreadCount();
+
+    std::vector<Box> boxes(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            boxes[i].minimum[axis] = std::min(pMinPoints[i][axis], pMaxPoints[i][axis]);
+            boxes[i].maximum[axis] = std::max(pMinPoints[i][axis], pMaxPoints[i][axis]);
+        }
+    }
+
+    // Levels are built bottom-up.  Every level is put in STR order before its
+    // parents are made, so the children of a parent are always contiguous.
+    // Leaves point into m_items, inner nodes into the level below.
+    auto fill = [](Node& node, size_t slot, const Box& box)
+    {
+        node.minX[slot] = box.minimum[0];
+        node.minY[slot] = box.minimum[1];
+        node.minZ[slot] = box.minimum[2];
+        node.maxX[slot] = box.maximum[0];
+        node.maxY[slot] = box.maximum[1];
+        node.maxZ[slot] = box.maximum[2];
+    };
+    auto makeLevel = [&](const std::vector<Box>& children, const Adesk::UInt32* pOrder)
+    {
+        std::vector<Node> level((children.size() + kFanout - 1) / kFanout);
+        for (size_t n = 0; n < level.size(); ++n)
+        {
+            Node& node = level[n];
+            node.firstChild = static_cast<Adesk::UInt32>(n * kFanout);
+            node.childCount = static_cast<Adesk::UInt32>(std::min(kFanout, children.size() - n * kFanout));
+            for (size_t c = 0; c < node.childCount; ++c)
+                fill(node, c, children[pOrder != nullptr ? pOrder[n * kFanout + c] : n * kFanout + c]);
+        }
+        return level;
+    };
+    auto boundsOf = [](const Node& node)
+    {
+        Box box;
+        box.minimum[0] = *std::min_element(node.minX, node.minX + node.childCount);
+        box.minimum[1] = *std::min_element(node.minY, node.minY + node.childCount);
+        box.minimum[2] = *std::min_element(node.minZ, node.minZ + node.childCount);
+        box.maximum[0] = *std::max_element(node.maxX, node.maxX + node.childCount);
+        box.maximum[1] = *std::max_element(node.maxY, node.maxY + node.childCount);
+        box.maximum[2] = *std::max_element(node.maxZ, node.maxZ + node.childCount);
+        return box;
+    };
+
+    m_items = strOrder(boxes, threadCount);
+    std::vector<std::vector<Node>> levels;
+    levels.push_back(makeLevel(boxes, m_items.data()));
+    std::vector<Box>().swap(boxes);
+
+    while (levels.back().size() > 1)
+    {
+        std::vector<Node>& below = levels.back();
+        std::vector<Box> bounds(below.size());
+        for (size_t n = 0; n < below.size(); ++n)
+            bounds[n] = boundsOf(below[n]);
+        const std::vector<Adesk::UInt32> order = strOrder(bounds, threadCount);
+
+        std::vector<Node> sorted(below.size());
+        std::vector<Box> sortedBounds(below.size());
+        for (size_t n = 0; n < order.size(); ++n)
+        {
+            sorted[n] = below[order[n]];
+            sortedBounds[n] = bounds[order[n]];
+        }
+        below.swap(sorted);
+        levels.push_back(makeLevel(sortedBounds, nullptr));
+    }
+
+    // Lay the levels out root first.  Child indices of inner nodes become
+    // absolute by adding the offset of the level below.
+    size_t total = 0;
+    for (const std::vector<Node>& level : levels)
+        total += level.size();
+    m_nodes.reserve(total);
+    for (size_t l = levels.size(); l-- > 0;)
+    {
+        const size_t belowOffset = m_nodes.size() + levels[l].size();
+        for (Node node : levels[l])
+        {
+            if (l > 0)
+                node.firstChild += static_cast<Adesk::UInt32>(belowOffset);
+            m_nodes.push_back(node);
+        }
+    }
+    m_firstLeaf = static_cast<Adesk::UInt32>(total - levels.front().size());
+    m_itemCount = count;
+    return Acad::eOk;
+}
+
+void ExtentsIndex::clear()
+{
+    std::vector<Node>().swap(m_nodes);
+    std::vector<Adesk::UInt32>().swap(m_items);
+    m_firstLeaf = 0;
+    m_itemCount = 0;
+}
+
+void ExtentsIndex::query(const double minimum[3], const double maximum[3], std::vector<Adesk::UInt32>& items) const
+{
+    if (m_nodes.empty())
+        return;
+
+    // Children are pushed in reverse so that they are visited in order.
+    Adesk::UInt32 stack[kMaxDepth * kFanout];
+    size_t depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0)
+    {
+        const Adesk::UInt32 index = stack[--depth];
+        const Node& node = m_nodes[index];
+        bool hits[kFanout];
+        for (size_t c = 0; c < node.childCount; ++c)
+        {
+            hits[c] = node.minX[c] <= maximum[0] && node.maxX[c] >= minimum[0] &&
+                      node.minY[c] <= maximum[1] && node.maxY[c] >= minimum[1] &&
+                      node.minZ[c] <= maximum[2] && node.maxZ[c] >= minimum[2];
+        }
+        if (index >= m_firstLeaf)
+        {
+            for (size_t c = 0; c < node.childCount; ++c)
+            {
+                if (hits[c])
+                    items.push_back(m_items[node.firstChild + c]);
+            }
+        }
+        else
+        {
+            for (size_t c = node.childCount; c-- > 0;)
+            {
+                if (hits[c])
+                    stack[depth++] = node.firstChild + static_cast<Adesk::UInt32>(c);
+            }
+        }
+    }
+}
+
+void ExtentsIndex::queryWindow(const AcGeBoundBlock3d& window, std::vector<Adesk::UInt32>& items) const
+{
+    AcGePoint3d minPoint, maxPoint;
+    window.getMinMaxPoints(minPoint, maxPoint);
+    const double minimum[3] = { std::min(minPoint.x, maxPoint.x), std::min(minPoint.y, maxPoint.y), std::min(minPoint.z, maxPoint.z) };
+    const double maximum[3] = { std::max(minPoint.x, maxPoint.x), std::max(minPoint.y, maxPoint.y), std::max(minPoint.z, maxPoint.z) };
+    query(minimum, maximum, items);
+}
+
+void ExtentsIndex::queryPoint(const AcGePoint3d& point, std::vector<Adesk::UInt32>& items) const
+{
+    const double coordinates[3] = { point.x, point.y, point.z };
+    query(coordinates, coordinates, items);
+}
+
+void ExtentsIndex::batchQuery(size_t count, const std::function<void(size_t, double*, double*)>& box,
+                              ExtentsQueryResult& result, unsigned threadCount) const
+{
+    const size_t chunkCount = (count + kQueryChunk - 1) / kQueryChunk;
+    std::vector<std::vector<Adesk::UInt32>> chunkItems(chunkCount);
+    result.offsets.assign(count + 1, 0);
+
+    parallelFor(chunkCount, threadCount,
+        [&](size_t chunk, unsigned)
+        {
+            const size_t first = chunk * kQueryChunk;
+            const size_t last = std::min(first + kQueryChunk, count);
+            std::vector<Adesk::UInt32>& items = chunkItems[chunk];
+            for (size_t q = first; q < last; ++q)
+            {
+                double minimum[3], maximum[3];
+                box(q, minimum, maximum);
+                const size_t before = items.size();
+                query(minimum, maximum, items);
+                result.offsets[q + 1] = items.size() - before;
+            }
+        });
+
+    for (size_t q = 0; q < count; ++q)
+        result.offsets[q + 1] += result.offsets[q];
+    result.items.clear();
+    result.items.reserve(result.offsets[count]);
+    for (const std::vector<Adesk::UInt32>& items : chunkItems)
+        result.items.insert(result.items.end(), items.begin(), items.end());
+}
+
+void ExtentsIndex::queryWindows(const AcGeBoundBlock3d* pWindows, size_t count, ExtentsQueryResult& result,
+                                unsigned threadCount) const
+{
+    batchQuery(count,
+        [pWindows](size_t q, double* minimum, double* maximum)
+        {
+            AcGePoint3d minPoint, maxPoint;
+            pWindows[q].getMinMaxPoints(minPoint, maxPoint);
+            for (unsigned axis = 0; axis < 3; ++axis)
+            {
+                minimum[axis] = std::min(minPoint[axis], maxPoint[axis]);
+                maximum[axis] = std::max(minPoint[axis], maxPoint[axis]);
+            }
+        },
+        result, threadCount);
+}
+
+void ExtentsIndex::queryPoints(const AcGePoint3d* pPoints, size_t count, ExtentsQueryResult& result,
+                               unsigned threadCount) const
+{
+    batchQuery(count,
+        [pPoints](size_t q, double* minimum, double* maximum)
+        {
+            for (unsigned axis = 0; axis < 3; ++axis)
+                minimum[axis] = maximum[axis] = pPoints[q][axis];
+        },
+        result, threadCount);
+}
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "gebndblk3d.h"
+
+#include <functional>
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// Result of a batch query: the hits of query q are
+/// items[offsets[q]] .. items[offsets[q + 1] - 1], where every item is the
+/// position of a box in the array the index was built from.
+/// </summary>
+struct ExtentsQueryResult
+{
+    std::vector<size_t>        offsets;
+    std::vector<Adesk::UInt32> items;
+};
+
+/// <summary>
+/// A static R-tree over axis-aligned extents, for answering "which entities
+/// touch this window" far faster than AcDbSpatialIndexIterator, which walks
+/// the database's index one entity at a time through AcDbFilteredBlockIterator.
+///
+/// The tree is bulk-loaded with Sort-Tile-Recursive packing (Leutenegger,
+/// Lopez and Edgington): boxes are sorted into slabs along x, each slab into
+/// runs along y and each run along z, and packed kExtentsIndexFanout to a
+/// node, so nodes are full and siblings barely overlap.  Nodes live in
+/// one array, root first and level by level, and keep the bounds of their
+/// children as separate min/max arrays per axis, so that visiting a node is
+/// a linear scan over a few cache lines.
+///
+/// The tree is immutable once built; all queries are const and may run
+/// concurrently from any number of threads.
+/// </summary>
+class ExtentsIndex
+{
+public:
+    enum { kExtentsIndexFanout = 16 };
+
+    /// <summary>
+    /// Builds the tree over count boxes, replacing any previous content.
+    /// Boxes are read through AcGeBoundBlock3d::getMinMaxPoints.  Slab and
+    /// run sorting runs on threadCount threads (0: one per hardware thread).
+    /// Returns Acad::eInvalidInput for more boxes than 32-bit item numbers
+    /// can address.
+    /// </summary>
+    Acad::ErrorStatus build(const AcGeBoundBlock3d* pExtents, size_t count, unsigned threadCount = 0);
+
+    /// <summary>
+    /// Same, from separate minimum and maximum corners.
+    /// </summary>
+    Acad::ErrorStatus build(const AcGePoint3d* pMinPoints, const AcGePoint3d* pMaxPoints, size_t count,
+                            unsigned threadCount = 0);
+
+    void clear();
+    size_t size() const { return m_itemCount; }
+    bool isEmpty() const { return m_itemCount == 0; }
+
+    /// <summary>
+    /// Appends the items whose boxes intersect window (touching counts).
+    /// </summary>
+    void queryWindow(const AcGeBoundBlock3d& window, std::vector<Adesk::UInt32>& items) const;
+
+    /// <summary>
+    /// Appends the items whose boxes contain point (the boundary counts).
+    /// </summary>
+    void queryPoint(const AcGePoint3d& point, std::vector<Adesk::UInt32>& items) const;
+
+    /// <summary>
+    /// Runs count window queries on threadCount threads.  The hits of every
+    /// query are in tree order, which depends only on the boxes.
+    /// </summary>
+    void queryWindows(const AcGeBoundBlock3d* pWindows, size_t count, ExtentsQueryResult& result,
+                      unsigned threadCount = 0) const;
+
+    /// <summary>
+    /// Runs count point queries on threadCount threads.
+    /// </summary>
+    void queryPoints(const AcGePoint3d* pPoints, size_t count, ExtentsQueryResult& result,
+                     unsigned threadCount = 0) const;
+
+private:
+    struct Node
+    {
+        double        minX[kExtentsIndexFanout];
+        double        minY[kExtentsIndexFanout];
+        double        minZ[kExtentsIndexFanout];
+        double        maxX[kExtentsIndexFanout];
+        double        maxY[kExtentsIndexFanout];
+        double        maxZ[kExtentsIndexFanout];
+        Adesk::UInt32 firstChild;   // node index, or position in m_items for leaves
+        Adesk::UInt32 childCount;
+    };
+
+    void query(const double minimum[3], const double maximum[3], std::vector<Adesk::UInt32>& items) const;
+    void batchQuery(size_t count, const std::function<void(size_t, double*, double*)>& box,
+                    ExtentsQueryResult& result, unsigned threadCount) const;
+
+    std::vector<Node>          m_nodes;        // root first, level by level
+    std::vector<Adesk::UInt32> m_items;        // input positions, in leaf order
+    Adesk::UInt32              m_firstLeaf = 0;
+    size_t                     m_itemCount = 0;
+};
+
+} // namespace acad_sheetset_to_pdf
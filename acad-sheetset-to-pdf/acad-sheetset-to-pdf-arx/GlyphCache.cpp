@@ -0,0 +1,664 @@
+#include "stdafx.h"
+#include "GlyphCache.h"
+
+#include <cmath>
+#include <limits>
+#include <new>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+/* What a glyph costs beyond itself and its vectors: the list node and the
+index entry, roughly. */
+const size_t kNodeOverhead = 64;
+
+const Adesk::UInt32 kMaximumStyles = 1u << 24;
+
+/* Deviations are bucketed by their logarithm, and each bucket is
+tessellated at its lower end.  Anything that is not a positive deviation
+is a bucket of its own, passed on as it is. */
+const int kUnbucketed = -128;
+
+int bucketOf(double deviation, unsigned bucketsPerOctave, double& representative)
+{
+    if (!(deviation > 0.0) || !std::isfinite(deviation))
+    {
+        representative = deviation;
+        return kUnbucketed;
+    }
+    const double perOctave = double(std::max(bucketsPerOctave, 1u));
+    const double scaled = std::floor(std::log2(deviation) * perOctave);
+    const int bucket = static_cast<int>(std::max(-127.0, std::min(127.0, scaled)));
+    representative = std::exp2(double(bucket) / perOctave);
+    return bucket;
+}
+
+Adesk::UInt64 glyphKey(Adesk::UInt32 style, int bucket, ACHAR character)
+{
+    return (Adesk::UInt64(style) << 40) | (Adesk::UInt64(Adesk::UInt8(bucket)) << 32) |
+           Adesk::UInt64(Adesk::UInt32(character));
+}
+
+void appendDouble(std::wstring& text, double value)
+{
+    Adesk::UInt16 parts[4];
+    std::memcpy(parts, &value, sizeof(parts));
+    for (const Adesk::UInt16 part : parts)
+        text += static_cast<wchar_t>(part);
+}
+
+/* Whether the characters of a string are drawn and measured one after
+the other: no control codes unless raw, and no surrogate pairs. */
+bool isPlain(const ACHAR* pText, size_t length, bool raw)
+{
+    for (size_t i = 0; i < length; ++i)
+    {
+        const ACHAR c = pText[i];
+        if (!raw && (c == L'\\' || (c == L'%' && i + 1 < length && pText[i + 1] == L'%')))
+            return false;
+        if ((c >= 0xD800 && c <= 0xDFFF) || Adesk::UInt32(c) > 0xFFFF)
+            return false;
+    }
+    return true;
+}
+
+/* The extents of characters laid end to end, each moving the pen by its
+advance: the right edge is as far as any character reaches and, with pen
+ups, the pen's final position. */
+template<class MetricsOf>
+AcGePoint2d layOut(MetricsOf metricsOf, size_t length, bool penUp)
+{
+    double pen = 0.0;
+    double right = 0.0;
+    double top = 0.0;
+    for (size_t i = 0; i < length; ++i)
+    {
+        const auto& metrics = metricsOf(i);
+        right = std::max(right, pen + metrics.right);
+        top = std::max(top, penUp ? metrics.penUpTop : metrics.top);
+        pen += metrics.advance;
+    }
+    return AcGePoint2d(penUp ? std::max(pen, right) : right, top);
+}
+
+bool sameExtent(double a, double b)
+{
+    return std::fabs(a - b) <= 1e-9 * std::max(1.0, std::max(std::fabs(a), std::fabs(b)));
+}
+
+struct GlyphCapture
+{
+    std::vector<int>*   pCounts;
+    std::vector<float>* pCoordinates;
+    bool                flat;
+};
+
+/* Appends score lines to the polylines of a string, as two-point
+polylines. */
+struct ScoreCapture
+{
+    std::vector<int>*         pCounts;
+    std::vector<AcGePoint3d>* pPoints;
+};
+
+void captureScores(const AcGePoint3d* pPoints, int segmentCount, const void* pAction)
+{
+    const ScoreCapture& capture = *static_cast<const ScoreCapture*>(pAction);
+    capture.pCounts->insert(capture.pCounts->end(), size_t(segmentCount), 2);
+    capture.pPoints->insert(capture.pPoints->end(), pPoints, pPoints + 2 * segmentCount);
+}
+
+/* Whether a string that is not raw has control codes that only the wrapped
+engine can draw: backslash codes, and %%c, which is a diameter symbol or a
+phi depending on the font. */
+bool hasEngineCodes(const ACHAR* pText, size_t length)
+{
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (pText[i] == L'\\')
+            return true;
+        if (pText[i] == L'%' && i + 2 < length && pText[i + 1] == L'%' &&
+            (pText[i + 2] == L'c' || pText[i + 2] == L'C'))
+            return true;
+    }
+    return false;
+}
+
+void captureGlyph(int polylineCount, int const* pVertexCounts, AcGePoint3d const* pPoints, void* pVoid)
+{
+    GlyphCapture& capture = *static_cast<GlyphCapture*>(pVoid);
+    size_t pointCount = 0;
+    for (int i = 0; i < polylineCount; ++i)
+    {
+        capture.pCounts->push_back(pVertexCounts[i]);
+        pointCount += size_t(std::max(pVertexCounts[i], 0));
+    }
+    for (size_t i = 0; i < pointCount; ++i)
+    {
+        if (pPoints[i].z != 0.0)
+            capture.flat = false;
+        capture.pCoordinates->push_back(static_cast<float>(pPoints[i].x));
+        capture.pCoordinates->push_back(static_cast<float>(pPoints[i].y));
+    }
+}
+
+} // namespace
+
+/* GlyphCache --- */
+
+GlyphCache::GlyphCache(const GlyphCacheSettings& settings)
+    : m_settings(settings)
+{
+}
+
+GlyphCacheStats GlyphCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void GlyphCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_styles.clear();
+    m_glyphs.clear();
+    m_byKey.clear();
+    m_metrics.clear();
+    m_stats.glyphCount = 0;
+    m_stats.byteCount = 0;
+    m_stats.metricBytes = 0;
+}
+
+Adesk::UInt32 GlyphCache::styleId(const std::wstring& style)
+{
+    const auto found = m_styles.find(style);
+    if (found != m_styles.end())
+        return found->second;
+
+    /* Style ids are 24 bits of the key; running out starts over. */
+    if (m_styles.size() == kMaximumStyles)
+    {
+        m_styles.clear();
+        m_glyphs.clear();
+        m_byKey.clear();
+        m_metrics.clear();
+        m_stats.glyphCount = 0;
+        m_stats.byteCount = 0;
+        m_stats.metricBytes = 0;
+    }
+    const Adesk::UInt32 id = static_cast<Adesk::UInt32>(m_styles.size());
+    m_styles.emplace(style, id);
+    return id;
+}
+
+const std::shared_ptr<GlyphCache::StyleMetrics>& GlyphCache::metrics(Adesk::UInt32 style)
+{
+    if (style >= m_metrics.size())
+        m_metrics.resize(size_t(style) + 1);
+    if (!m_metrics[style])
+        m_metrics[style] = std::make_shared<StyleMetrics>();
+    return m_metrics[style];
+}
+
+const GlyphCache::CharacterMetrics* GlyphCache::measured(const StyleMetrics& metrics, ACHAR character) const
+{
+    const Adesk::UInt32 code = Adesk::UInt32(character);
+    const CharacterMetrics* pPage = code <= 0xFFFF ? metrics.pages[code >> 8].get() : nullptr;
+    if (pPage == nullptr || std::isnan(pPage[code & 0xFF].advance))
+        return nullptr;
+    return &pPage[code & 0xFF];
+}
+
+void GlyphCache::setMetrics(StyleMetrics& metrics, ACHAR character, const CharacterMetrics& value)
+{
+    const Adesk::UInt32 code = Adesk::UInt32(character);
+    if (code > 0xFFFF)
+        return;
+    std::unique_ptr<CharacterMetrics[]>& pPage = metrics.pages[code >> 8];
+    if (!pPage)
+    {
+        pPage.reset(new CharacterMetrics[256]);
+        for (size_t i = 0; i < 256; ++i)
+            pPage[i].advance = std::numeric_limits<double>::quiet_NaN();
+        m_stats.metricBytes += 256 * sizeof(CharacterMetrics);
+    }
+    if (std::isnan(pPage[code & 0xFF].advance))
+        pPage[code & 0xFF] = value;
+}
+
+const GlyphCache::Glyph* GlyphCache::find(Adesk::UInt64 key)
+{
+    const auto found = m_byKey.find(key);
+    if (found == m_byKey.end())
+        return nullptr;
+    if (found->second != m_glyphs.begin())
+        m_glyphs.splice(m_glyphs.begin(), m_glyphs, found->second);
+    return &*found->second;
+}
+
+/* Takes the contents of glyph.  The newest glyph is kept even if it alone
+is over the limit. */
+void GlyphCache::insert(Glyph& glyph)
+{
+    if (contains(glyph.key))
+        return;
+    glyph.bytes = sizeof(Glyph) + kNodeOverhead + glyph.counts.capacity() * sizeof(int) +
+                  glyph.coordinates.capacity() * sizeof(float);
+    m_glyphs.push_front(std::move(glyph));
+    m_byKey.emplace(m_glyphs.front().key, m_glyphs.begin());
+    m_stats.byteCount += m_glyphs.front().bytes;
+    ++m_stats.glyphCount;
+
+    while (m_stats.byteCount > m_settings.maximumBytes && m_glyphs.size() > 1)
+    {
+        const Glyph& oldest = m_glyphs.back();
+        m_stats.byteCount -= oldest.bytes;
+        --m_stats.glyphCount;
+        ++m_stats.evictions;
+        m_byKey.erase(oldest.key);
+        m_glyphs.pop_back();
+    }
+}
+
+/* CachingTextEngine --- */
+
+CachingTextEngine::CachingTextEngine(AcGiTextEngine* pEngine, const std::shared_ptr<GlyphCache>& pCache)
+    : m_pEngine(pEngine)
+    , m_pCache(pCache)
+{
+}
+
+AcGiTextEngine* CachingTextEngine::create(const std::shared_ptr<GlyphCache>& pCache)
+{
+    AcGiTextEngine* pEngine = AcGiTextEngine::create();
+    if (pEngine == nullptr)
+        return nullptr;
+    return new CachingTextEngine(pEngine, pCache);
+}
+
+void CachingTextEngine::getExtents(AcGiTextStyle& ts, ACHAR const* pStr, int nLength, bool bPenUp, bool bRaw,
+                                   AcGePoint2d& extents)
+{
+    getExtents(ts, &pStr, &nLength, 1, bPenUp, bRaw, &extents);
+}
+
+GlyphCache::CharacterMetrics CachingTextEngine::measure(AcGiTextStyle& ts, ACHAR character)
+{
+    AcGePoint2d penUp;
+    AcGePoint2d ink;
+    m_pEngine->getExtents(ts, &character, 1, true, true, penUp);
+    m_pEngine->getExtents(ts, &character, 1, false, true, ink);
+    GlyphCache::CharacterMetrics metrics = {penUp.x, penUp.y, ink.x, ink.y};
+    return metrics;
+}
+
+/* Lays out a few strings from the metrics of their characters, measuring
+those that are not in measured yet, and compares the result with what
+the wrapped engine makes of the strings. */
+bool CachingTextEngine::verifyMetrics(AcGiTextStyle& ts,
+                                      std::vector<std::pair<ACHAR, GlyphCache::CharacterMetrics>>& measured)
+{
+    static const ACHAR* const kProbes[] = {L"Ag", L"W.i", L"1:100", L" jT_ ", L"MMxx"};
+    for (const ACHAR* pProbe : kProbes)
+    {
+        const size_t length = std::wcslen(pProbe);
+        size_t entries[8];
+        for (size_t i = 0; i < length; ++i)
+        {
+            entries[i] = std::find_if(measured.begin(), measured.end(),
+                                      [&](const std::pair<ACHAR, GlyphCache::CharacterMetrics>& entry)
+                                      { return entry.first == pProbe[i]; }) - measured.begin();
+            if (entries[i] == measured.size())
+                measured.emplace_back(pProbe[i], measure(ts, pProbe[i]));
+        }
+        for (const bool penUp : {true, false})
+        {
+            AcGePoint2d expected;
+            m_pEngine->getExtents(ts, pProbe, static_cast<int>(length), penUp, true, expected);
+            const AcGePoint2d laidOut = layOut(
+                [&](size_t i) -> const GlyphCache::CharacterMetrics& { return measured[entries[i]].second; },
+                length, penUp);
+            if (!sameExtent(expected.x, laidOut.x) || !sameExtent(expected.y, laidOut.y))
+                return false;
+        }
+    }
+    return true;
+}
+
+void CachingTextEngine::getExtents(AcGiTextStyle& ts, ACHAR const* const* pStrings, const int* pLengths,
+                                   size_t count, bool bPenUp, bool bRaw, AcGePoint2d* pExtents)
+{
+    auto measureDirectly = [&](size_t i)
+    {
+        m_pEngine->getExtents(ts, pStrings[i], pLengths != nullptr ? pLengths[i] : -1, bPenUp, bRaw, pExtents[i]);
+    };
+    auto lengthOf = [&](size_t i) -> size_t
+    {
+        const int length = pLengths != nullptr ? pLengths[i] : -1;
+        return length == -1 ? std::wcslen(pStrings[i]) : size_t(length);
+    };
+    if (!m_pCache)
+    {
+        for (size_t i = 0; i < count; ++i)
+            measureDirectly(i);
+        return;
+    }
+
+    std::shared_ptr<GlyphCache::StyleMetrics> pMetrics;
+    try
+    {
+        /* Empty strings go to the engine too; what they measure is up to
+        it. */
+        size_t plainCount = 0;
+        m_plain.assign(count, 0);
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (pStrings[i] == nullptr || (pLengths != nullptr && pLengths[i] < -1))
+                continue;
+            const size_t length = lengthOf(i);
+            if (length != 0 && isPlain(pStrings[i], length, bRaw))
+            {
+                m_plain[i] = 1;
+                ++plainCount;
+            }
+        }
+
+        if (plainCount != 0 && describeStyle(ts, m_style))
+        {
+            /* Collect the characters that have not been measured, measure
+            them without holding the lock, and check the style's tables
+            against the engine the first time they are used. */
+            m_missing.clear();
+            m_seen.resize(65536 / 64);
+            bool verify = false;
+            {
+                std::lock_guard<std::mutex> lock(m_pCache->m_mutex);
+                pMetrics = m_pCache->metrics(m_pCache->styleId(m_style));
+                if (pMetrics->state == GlyphCache::StyleMetrics::kUnusable)
+                {
+                    pMetrics.reset();
+                }
+                else
+                {
+                    verify = pMetrics->state == GlyphCache::StyleMetrics::kUnverified;
+                    for (size_t i = 0; i < count; ++i)
+                    {
+                        if (!m_plain[i])
+                            continue;
+                        const ACHAR* pText = pStrings[i];
+                        const size_t length = lengthOf(i);
+                        for (size_t j = 0; j < length; ++j)
+                        {
+                            const Adesk::UInt32 code = Adesk::UInt32(pText[j]);
+                            Adesk::UInt64& seen = m_seen[code / 64];
+                            const Adesk::UInt64 bit = Adesk::UInt64(1) << (code % 64);
+                            if ((seen & bit) == 0 && m_pCache->measured(*pMetrics, pText[j]) == nullptr)
+                            {
+                                seen |= bit;
+                                m_missing.push_back(pText[j]);
+                            }
+                        }
+                    }
+                }
+            }
+            for (const ACHAR c : m_missing)
+                m_seen[Adesk::UInt32(c) / 64] = 0;
+
+            if (pMetrics)
+            {
+                m_measured.clear();
+                for (const ACHAR c : m_missing)
+                    m_measured.emplace_back(c, measure(ts, c));
+                const bool usable = !verify || verifyMetrics(ts, m_measured);
+
+                std::lock_guard<std::mutex> lock(m_pCache->m_mutex);
+                for (const std::pair<ACHAR, GlyphCache::CharacterMetrics>& entry : m_measured)
+                    m_pCache->setMetrics(*pMetrics, entry.first, entry.second);
+                if (verify)
+                    pMetrics->state = usable ? GlyphCache::StyleMetrics::kVerified : GlyphCache::StyleMetrics::kUnusable;
+                if (!usable)
+                    pMetrics.reset();
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_pCache->m_mutex);
+        m_pCache->m_stats.measuredStrings += pMetrics ? plainCount : 0;
+        m_pCache->m_stats.unmeasuredStrings += pMetrics ? count - plainCount : count;
+    }
+    catch (const std::bad_alloc&)
+    {
+        pMetrics.reset();
+    }
+
+    /* Every character of every plain string has been measured by now, and
+    a measured character is never written again, so the tables are read
+    without the lock. */
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!pMetrics || !m_plain[i])
+        {
+            measureDirectly(i);
+            continue;
+        }
+        const ACHAR* pText = pStrings[i];
+        const GlyphCache::StyleMetrics& metrics = *pMetrics;
+        pExtents[i] = layOut(
+            [&](size_t j) -> const GlyphCache::CharacterMetrics&
+            {
+                const Adesk::UInt32 code = Adesk::UInt32(pText[j]);
+                return metrics.pages[code >> 8][code & 0xFF];
+            },
+            lengthOf(i), bPenUp);
+    }
+}
+
+void CachingTextEngine::tessellate(AcGiTextStyle& ts, ACHAR const* pString, int nLength, bool bRaw, void* pVoid,
+                                   UnicodeCallback pUnicodeCallback, PolylineCallback pPolylineCallback)
+{
+    m_pEngine->tessellate(ts, pString, nLength, bRaw, pVoid, pUnicodeCallback, pPolylineCallback);
+}
+
+/* Everything that goes into drawing a glyph but the character and the
+deviation.  Tessellation is in unit coordinates, so the text size is not
+part of it. */
+bool CachingTextEngine::describeStyle(const AcGiTextStyle& ts, std::wstring& style) const
+{
+    if (ts.isVertical() || ts.isBackward() || ts.isUpsideDown() || ts.isUnderlined() || ts.isOverlined() ||
+        ts.isStrikethrough())
+        return false;
+
+    AcString typeface;
+    bool bold = false;
+    bool italic = false;
+    Charset charset = static_cast<Charset>(0);
+    Autodesk::AutoCAD::PAL::FontUtils::FontPitch pitch;
+    Autodesk::AutoCAD::PAL::FontUtils::FontFamily family;
+    if (ts.font(typeface, bold, italic, charset, pitch, family) != Acad::eOk)
+        typeface = L"";
+
+    style.clear();
+    style += ts.fileName() != nullptr ? ts.fileName() : L"";
+    style += L'\n';
+    style += ts.bigFontFileName() != nullptr ? ts.bigFontFileName() : L"";
+    style += L'\n';
+    style += typeface.kwszPtr();
+    style += L'\n';
+    style += static_cast<wchar_t>((bold ? 1 : 0) | (italic ? 2 : 0));
+    style += static_cast<wchar_t>(charset);
+    appendDouble(style, ts.xScale());
+    appendDouble(style, ts.obliquingAngle());
+    appendDouble(style, ts.trackingPercent());
+    return true;
+}
+
+bool CachingTextEngine::tessellateGlyph(AcGiTextStyle& ts, ACHAR character, double deviation, GlyphCache::Glyph& glyph)
+{
+    glyph.counts.clear();
+    glyph.coordinates.clear();
+    GlyphCapture capture = {&glyph.counts, &glyph.coordinates, true};
+    m_pEngine->tessellate(ts, &character, 1, true, deviation, &capture, captureGlyph);
+
+    AcGePoint2d extents;
+    m_pEngine->getExtents(ts, &character, 1, true, true, extents);
+    glyph.advance = extents.x;
+    glyph.counts.shrink_to_fit();
+    glyph.coordinates.shrink_to_fit();
+    return capture.flat;
+}
+
+void CachingTextEngine::tessellate(AcGiTextStyle& ts, ACHAR const* pStr, int nLength, bool bRaw, double deviation,
+                                   void* pVoid, PolylineCallback pPolylineCallback)
+{
+    auto passThrough = [&]()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_pCache->m_mutex);
+            ++m_pCache->m_stats.bypassedStrings;
+        }
+        m_pEngine->tessellate(ts, pStr, nLength, bRaw, deviation, pVoid, pPolylineCallback);
+    };
+
+    if (!m_pCache || pStr == nullptr || nLength < -1)
+    {
+        if (m_pCache)
+            passThrough();
+        else
+            m_pEngine->tessellate(ts, pStr, nLength, bRaw, deviation, pVoid, pPolylineCallback);
+        return;
+    }
+
+    const size_t length = nLength == -1 ? std::wcslen(pStr) : size_t(nLength);
+    if (!isPlain(pStr, length, true) || (!bRaw && hasEngineCodes(pStr, length)))
+    {
+        passThrough();
+        return;
+    }
+
+    /* pText is the string as drawn: pStr, or its expansion if it has %%
+    codes. */
+    const ACHAR* pText = pStr;
+    size_t textLength = length;
+    TextControlBuffer controls;
+    try
+    {
+        if (!describeStyle(ts, m_style))
+        {
+            passThrough();
+            return;
+        }
+        if (!bRaw && !isPlain(pStr, length, false))
+        {
+            const int stringLength = static_cast<int>(length);
+            m_expanded.resize(length + 1);
+            m_runs.resize(size_t(TextControlCodes::runCapacity(stringLength)));
+            m_segments.resize(size_t(std::max(TextControlCodes::segmentCapacity(stringLength), 1)));
+            controls.pText = m_expanded.data();
+            controls.pRuns = m_runs.data();
+            controls.runCapacity = static_cast<int>(m_runs.size());
+            controls.pSegments = m_segments.data();
+            controls.segmentCapacity = static_cast<int>(m_segments.size());
+            if (TextControlCodes::expand(pStr, stringLength, 0, controls) != Acad::eOk)
+            {
+                passThrough();
+                return;
+            }
+            pText = controls.pText;
+            textLength = size_t(controls.textLength);
+        }
+        double representative = deviation;
+        const int bucket = bucketOf(deviation, m_pCache->settings().bucketsPerOctave, representative);
+
+        /* Find the glyphs that are missing and tessellate them without
+        holding the lock, so that other threads drawing cached text are not
+        held up. */
+        Adesk::UInt32 style = 0;
+        m_missing.clear();
+        {
+            std::lock_guard<std::mutex> lock(m_pCache->m_mutex);
+            style = m_pCache->styleId(m_style);
+            for (size_t i = 0; i < textLength; ++i)
+            {
+                if (!m_pCache->contains(glyphKey(style, bucket, pText[i])) &&
+                    std::find(m_missing.begin(), m_missing.end(), pText[i]) == m_missing.end())
+                    m_missing.push_back(pText[i]);
+            }
+        }
+
+        m_made.resize(m_missing.size());
+        for (size_t i = 0; i < m_missing.size(); ++i)
+        {
+            if (!tessellateGlyph(ts, m_missing[i], representative, m_made[i]))
+            {
+                passThrough();
+                return;
+            }
+            m_made[i].key = glyphKey(style, bucket, m_missing[i]);
+        }
+
+        /* A glyph evicted in the meantime, by another thread or by this
+        string's own glyphs in a cache too small for them, sends the string
+        to the wrapped engine after all. */
+        m_counts.clear();
+        m_points.clear();
+        m_pens.clear();
+        bool complete = true;
+        {
+            std::lock_guard<std::mutex> lock(m_pCache->m_mutex);
+            for (GlyphCache::Glyph& glyph : m_made)
+                m_pCache->insert(glyph);
+            m_pCache->m_stats.misses += m_made.size();
+
+            double pen = 0.0;
+            for (size_t i = 0; i < textLength; ++i)
+            {
+                const GlyphCache::Glyph* pGlyph = m_pCache->find(glyphKey(style, bucket, pText[i]));
+                if (pGlyph == nullptr)
+                {
+                    complete = false;
+                    break;
+                }
+                m_counts.insert(m_counts.end(), pGlyph->counts.begin(), pGlyph->counts.end());
+                const std::vector<float>& coordinates = pGlyph->coordinates;
+                for (size_t j = 0; j + 1 < coordinates.size(); j += 2)
+                    m_points.emplace_back(pen + coordinates[j], double(coordinates[j + 1]), 0.0);
+                m_pens.push_back(pen);
+                pen += pGlyph->advance;
+            }
+            m_pens.push_back(pen);
+            if (complete)
+            {
+                m_pCache->m_stats.hits += textLength - m_made.size();
+                ++m_pCache->m_stats.cachedStrings;
+            }
+        }
+        if (!complete)
+        {
+            passThrough();
+            return;
+        }
+
+        /* Glyphs are tessellated at unit height, so the scores are drawn
+        for text of height 1, sheared like the glyphs. */
+        if (controls.segmentCount != 0)
+        {
+            TextParams params = {};
+            params.height = 1.0;
+            params.width_scale = ts.xScale();
+            params.oblique_angle = ts.obliquingAngle();
+            params.spacing = ts.trackingPercent();
+            const ScoreCapture capture = {&m_counts, &m_points};
+            TextControlCodes::drawScores(controls, m_pens.data(), params, captureScores, &capture);
+        }
+    }
+    catch (const std::bad_alloc&)
+    {
+        passThrough();
+        return;
+    }
+
+    if (!m_counts.empty())
+        pPolylineCallback(static_cast<int>(m_counts.size()), m_counts.data(), m_points.data(), pVoid);
+}
+
+} // namespace acad_sheetset_to_pdf
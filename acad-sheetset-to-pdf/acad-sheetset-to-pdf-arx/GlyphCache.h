@@ -0,0 +1,214 @@
+#pragma once
+
+#include "TextControlCodes.h"
+#include "textengine.h"
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace acad_sheetset_to_pdf {
+
+struct GlyphCacheSettings
+{
+    /// <summary>
+    /// Bytes of tessellated glyphs to keep; past that the least recently
+    /// used glyphs are evicted.
+    /// </summary>
+    size_t maximumBytes = 16 * 1024 * 1024;
+
+    /// <summary>
+    /// Deviations within the same fraction of an octave share their
+    /// glyphs, which are tessellated at the finest deviation of the
+    /// fraction so that none comes out coarser than asked for.
+    /// </summary>
+    unsigned bucketsPerOctave = 4;
+};
+
+struct GlyphCacheStats
+{
+    Adesk::UInt64 hits = 0;             // characters drawn from a cached glyph
+    Adesk::UInt64 misses = 0;           // glyphs tessellated and added
+    Adesk::UInt64 evictions = 0;
+    Adesk::UInt64 cachedStrings = 0;    // assembled from cached glyphs
+    Adesk::UInt64 bypassedStrings = 0;  // handed to the text engine as they were
+    Adesk::UInt64 measuredStrings = 0;  // extents from the metric tables
+    Adesk::UInt64 unmeasuredStrings = 0;  // extents from the text engine
+    size_t        glyphCount = 0;
+    size_t        byteCount = 0;
+    size_t        metricBytes = 0;      // metric tables, which are not evicted
+
+    double hitRate() const { return hits + misses != 0 ? double(hits) / double(hits + misses) : 0.0; }
+};
+
+/// <summary>
+/// Tessellated shape-font glyphs, keyed by text style, character and
+/// deviation, and per-style character metrics, for CachingTextEngine.
+///
+/// A glyph is kept as its polyline vertex counts and its vertices as
+/// pairs of floats, in unit coordinates with the pen at the origin, along
+/// with how far it moves the pen.  Glyphs are evicted least recently used
+/// first once settings.maximumBytes is reached.  Metrics are kept per
+/// style in tables of 256 characters, filled in as characters are first
+/// measured.  Any number of engines, on any number of threads, may share a
+/// cache.
+/// </summary>
+class GlyphCache
+{
+public:
+    explicit GlyphCache(const GlyphCacheSettings& settings = GlyphCacheSettings());
+
+    GlyphCache(const GlyphCache&) = delete;
+    GlyphCache& operator=(const GlyphCache&) = delete;
+
+    const GlyphCacheSettings& settings() const { return m_settings; }
+    GlyphCacheStats stats() const;
+
+    /// <summary>
+    /// Drops every glyph and metric table; the counters are kept.
+    /// </summary>
+    void clear();
+
+private:
+    friend class CachingTextEngine;
+
+    struct Glyph
+    {
+        Adesk::UInt64       key;
+        double              advance;
+        std::vector<int>    counts;         // vertices of each polyline
+        std::vector<float>  coordinates;    // x, y of each vertex
+        size_t              bytes;
+    };
+    typedef std::list<Glyph> GlyphList;
+
+    /* What getExtents of one raw character returns, with and without pen
+    ups.  advance is NaN until the character has been measured. */
+    struct CharacterMetrics
+    {
+        double advance;
+        double penUpTop;
+        double right;
+        double top;
+    };
+
+    /* Pages are allocated, under m_mutex, but never freed or moved while
+    the table is alive, and a measured character is never written again,
+    so a table may be read without the lock once the characters read are
+    known to have been measured. */
+    struct StyleMetrics
+    {
+        enum State
+        {
+            kUnverified,
+            kVerified,      // the tables reproduce the text engine's extents
+            kUnusable       // they do not; every string goes to the engine
+        };
+
+        State                               state = kUnverified;
+        std::unique_ptr<CharacterMetrics[]> pages[256];
+    };
+
+    /* The callers hold m_mutex. */
+    Adesk::UInt32 styleId(const std::wstring& style);
+    const std::shared_ptr<StyleMetrics>& metrics(Adesk::UInt32 style);
+    const CharacterMetrics* measured(const StyleMetrics& metrics, ACHAR character) const;
+    void setMetrics(StyleMetrics& metrics, ACHAR character, const CharacterMetrics& value);
+    const Glyph* find(Adesk::UInt64 key);
+    bool contains(Adesk::UInt64 key) const { return m_byKey.find(key) != m_byKey.end(); }
+    void insert(Glyph& glyph);
+
+    GlyphCacheSettings                                      m_settings;
+    mutable std::mutex                                      m_mutex;
+    std::unordered_map<std::wstring, Adesk::UInt32>         m_styles;
+    GlyphList                                               m_glyphs;   // most recently used first
+    std::unordered_map<Adesk::UInt64, GlyphList::iterator>  m_byKey;
+    std::vector<std::shared_ptr<StyleMetrics>>              m_metrics;  // by style id
+    GlyphCacheStats                                         m_stats;
+};
+
+/// <summary>
+/// An AcGiTextEngine that puts a GlyphCache in front of another.
+///
+/// Title blocks, notes and tables draw the same few glyphs over and over.
+/// tessellate() with a deviation looks each character of the string up in
+/// the cache, has the engine it wraps tessellate only the glyphs that are
+/// missing, one character at a time, and then sends the whole string to
+/// the callback in one call, each glyph moved along by the advances of the
+/// ones before it, as the wrapped engine would.
+///
+/// That holds for shape fonts, where each character is drawn on its own
+/// and moves the pen by its pen-up extents.  Unless the string is raw, its
+/// %% control codes are expanded first with TextControlCodes, and the
+/// overlines, underlines and strikethroughs they turn on are drawn from the
+/// pen positions of the cached glyphs.  Strings whose layout depends on
+/// more than that go to the wrapped engine as they are: backslash control
+/// codes, %%c (which symbol it stands for depends on the font), vertical,
+/// backward and upside-down text, scored styles and surrogate pairs.  The
+/// other calls are passed straight through.
+///
+/// getExtents() takes the extents of plain strings from the cache's metric
+/// tables: the advance, right edge and top of each character, as the
+/// wrapped engine measures them on its own, laid end to end.  Before a
+/// style's tables are used they are checked against the wrapped engine on
+/// a few probe strings, and a style whose text is not laid out that way
+/// keeps going to the wrapped engine.  The batch overload measures many
+/// strings of one style with one lock and one style lookup.
+///
+/// An engine is used by one thread at a time, like the engine it wraps.
+/// </summary>
+class CachingTextEngine : public AcGiTextEngine
+{
+public:
+    /// <summary>
+    /// Wraps pEngine, which the caching engine takes ownership of.
+    /// </summary>
+    CachingTextEngine(AcGiTextEngine* pEngine, const std::shared_ptr<GlyphCache>& pCache);
+
+    /// <summary>
+    /// Wraps AcGiTextEngine::create().  Returns null if that does.
+    /// </summary>
+    static AcGiTextEngine* create(const std::shared_ptr<GlyphCache>& pCache);
+
+    void getExtents(AcGiTextStyle& ts, ACHAR const* pStr, int nLength, bool bPenUp, bool bRaw,
+                    AcGePoint2d& extents) override;
+
+    /// <summary>
+    /// getExtents for count strings of one style: pExtents[i] is what
+    /// getExtents(ts, pStrings[i], pLengths[i], bPenUp, bRaw, ...) returns.
+    /// pLengths may be null if every string is NUL terminated.
+    /// </summary>
+    void getExtents(AcGiTextStyle& ts, ACHAR const* const* pStrings, const int* pLengths, size_t count, bool bPenUp,
+                    bool bRaw, AcGePoint2d* pExtents);
+
+    void tessellate(AcGiTextStyle& ts, ACHAR const* pStr, int nLength, bool bRaw, double deviation,
+                    void* pVoid, PolylineCallback pPolylineCallback) override;
+
+    void tessellate(AcGiTextStyle& ts, ACHAR const* pString, int nLength, bool bRaw, void* pVoid,
+                    UnicodeCallback pUnicodeCallback, PolylineCallback pPolylineCallback) override;
+
+    const std::shared_ptr<GlyphCache>& cache() const { return m_pCache; }
+
+private:
+    bool describeStyle(const AcGiTextStyle& ts, std::wstring& style) const;
+    bool tessellateGlyph(AcGiTextStyle& ts, ACHAR character, double deviation, GlyphCache::Glyph& glyph);
+    GlyphCache::CharacterMetrics measure(AcGiTextStyle& ts, ACHAR character);
+    bool verifyMetrics(AcGiTextStyle& ts, std::vector<std::pair<ACHAR, GlyphCache::CharacterMetrics>>& measured);
+
+    std::unique_ptr<AcGiTextEngine>     m_pEngine;
+    std::shared_ptr<GlyphCache>         m_pCache;
+    std::wstring                        m_style;        // the rest are kept from one call to the next
+    std::vector<ACHAR>                  m_missing;
+    std::vector<GlyphCache::Glyph>      m_made;
+    std::vector<int>                    m_counts;
+    std::vector<AcGePoint3d>            m_points;
+    std::vector<unsigned char>          m_plain;        // of each string getExtents measures
+    std::vector<Adesk::UInt64>          m_seen;         // characters in m_missing, one bit each
+    std::vector<wchar_t>                m_expanded;     // of the string tessellate() draws
+    std::vector<TextRun>                m_runs;
+    std::vector<ScoreSegment>           m_segments;
+    std::vector<double>                 m_pens;
+    std::vector<std::pair<ACHAR, GlyphCache::CharacterMetrics>> m_measured;
+};
+
+} // namespace acad_sheetset_to_pdf
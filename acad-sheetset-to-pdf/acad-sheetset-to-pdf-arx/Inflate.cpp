@@ -0,0 +1,355 @@
+#include "stdafx.h"
+#include "Inflate.h"
+#include "Checksum.h"
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+/* Deflate data is a run of blocks, each starting with a bit that marks the
+last one and two bits of type: stored, fixed Huffman or dynamic Huffman.
+Huffman blocks are literals and (length, distance) pairs back into the
+output, with a literal/length code and a distance code that dynamic blocks
+describe up front, themselves Huffman coded.  Bits are packed from the least
+significant end of each byte; Huffman codes are sent most significant bit
+first, everything else least significant first.  This follows zlib's puff,
+the reference decoder written to be read. */
+const int kMaxBits = 15;
+const int kMaxCodes = 288;
+const int kEndOfBlock = 256;
+
+const Adesk::UInt16 kLengthBase[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                       31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const Adesk::UInt8 kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                       2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const Adesk::UInt16 kDistanceBase[30] = {1,   2,   3,   4,   5,   7,    9,    13,   17,   25,
+                                         33,  49,  65,  97,  129, 193,  257,  385,  513,  769,
+                                         1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const Adesk::UInt8 kDistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                         6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+const Adesk::UInt8 kCodeLengthOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+class BitReader
+{
+public:
+    BitReader(const Adesk::UInt8* pData, size_t size)
+        : m_pData(pData), m_size(size), m_position(0), m_buffer(0), m_bitCount(0)
+    {
+    }
+
+    /* Fewer than 8 bits are ever left over between calls, so the buffer
+    never holds more than 20. */
+    bool read(int count, unsigned& value)
+    {
+        while (m_bitCount < count)
+        {
+            if (m_position == m_size)
+                return false;
+            m_buffer |= Adesk::UInt32(m_pData[m_position++]) << m_bitCount;
+            m_bitCount += 8;
+        }
+        value = m_buffer & ((Adesk::UInt32(1) << count) - 1);
+        m_buffer >>= count;
+        m_bitCount -= count;
+        return true;
+    }
+
+    void skipToByte()
+    {
+        m_buffer = 0;
+        m_bitCount = 0;
+    }
+
+    /* size whole bytes, once skipToByte() has dropped the partial one. */
+    const Adesk::UInt8* take(size_t size)
+    {
+        if (m_size - m_position < size)
+            return nullptr;
+        const Adesk::UInt8* p = m_pData + m_position;
+        m_position += size;
+        return p;
+    }
+
+    size_t consumed() const { return m_position; }
+
+private:
+    const Adesk::UInt8* m_pData;
+    size_t              m_size;
+    size_t              m_position;
+    Adesk::UInt32       m_buffer;
+    int                 m_bitCount;
+};
+
+/* A canonical Huffman code: how many codes there are of each length, and
+the symbols in the order of their codes. */
+struct Huffman
+{
+    Adesk::UInt16 count[kMaxBits + 1];
+    Adesk::UInt16 symbol[kMaxCodes];
+};
+
+/* Builds the code for symbols with the given code lengths, 0 for unused.
+Returns 0 for a complete code, a negative number for one with more codes
+than lengths allow and a positive one for an incomplete code, which deflate
+only permits when a single code is used. */
+int buildHuffman(Huffman& code, const Adesk::UInt16* pLengths, int symbolCount)
+{
+    for (int length = 0; length <= kMaxBits; ++length)
+        code.count[length] = 0;
+    for (int symbol = 0; symbol < symbolCount; ++symbol)
+        ++code.count[pLengths[symbol]];
+    if (code.count[0] == symbolCount)
+        return 0;
+
+    int left = 1;
+    for (int length = 1; length <= kMaxBits; ++length)
+    {
+        left <<= 1;
+        left -= code.count[length];
+        if (left < 0)
+            return left;
+    }
+
+    Adesk::UInt16 offsets[kMaxBits + 1];
+    offsets[1] = 0;
+    for (int length = 1; length < kMaxBits; ++length)
+        offsets[length + 1] = Adesk::UInt16(offsets[length] + code.count[length]);
+    for (int symbol = 0; symbol < symbolCount; ++symbol)
+    {
+        if (pLengths[symbol] != 0)
+            code.symbol[offsets[pLengths[symbol]]++] = Adesk::UInt16(symbol);
+    }
+    return left;
+}
+
+/* The next symbol, or -1 at the end of the data or for a code that is not
+in the table. */
+int decode(BitReader& reader, const Huffman& code)
+{
+    int bits = 0;
+    int first = 0;
+    int index = 0;
+    for (int length = 1; length <= kMaxBits; ++length)
+    {
+        unsigned bit;
+        if (!reader.read(1, bit))
+            return -1;
+        bits |= int(bit);
+        const int count = code.count[length];
+        if (bits - count < first)
+            return code.symbol[index + (bits - first)];
+        index += count;
+        first += count;
+        first <<= 1;
+        bits <<= 1;
+    }
+    return -1;
+}
+
+struct FixedCodes
+{
+    FixedCodes()
+    {
+        Adesk::UInt16 lengths[kMaxCodes];
+        int symbol = 0;
+        for (; symbol < 144; ++symbol)
+            lengths[symbol] = 8;
+        for (; symbol < 256; ++symbol)
+            lengths[symbol] = 9;
+        for (; symbol < 280; ++symbol)
+            lengths[symbol] = 7;
+        for (; symbol < kMaxCodes; ++symbol)
+            lengths[symbol] = 8;
+        buildHuffman(literals, lengths, kMaxCodes);
+        for (symbol = 0; symbol < 30; ++symbol)
+            lengths[symbol] = 5;
+        buildHuffman(distances, lengths, 30);
+    }
+
+    Huffman literals;
+    Huffman distances;
+};
+
+/* Decodes the literals and matches of a Huffman block into output, whose
+first start bytes came before this stream and are out of reach of its
+matches. */
+Acad::ErrorStatus inflateCodes(BitReader& reader, const Huffman& literals, const Huffman& distances,
+                               std::vector<Adesk::UInt8>& output, size_t start, size_t maxSize)
+{
+    for (;;)
+    {
+        int symbol = decode(reader, literals);
+        if (symbol < 0)
+            return Acad::eInvalidInput;
+        if (symbol < kEndOfBlock)
+        {
+            if (output.size() >= maxSize)
+                return Acad::eDataTooLarge;
+            output.push_back(Adesk::UInt8(symbol));
+            continue;
+        }
+        if (symbol == kEndOfBlock)
+            return Acad::eOk;
+
+        symbol -= kEndOfBlock + 1;
+        unsigned extra;
+        if (symbol >= 29 || !reader.read(kLengthExtra[symbol], extra))
+            return Acad::eInvalidInput;
+        const size_t length = kLengthBase[symbol] + extra;
+        symbol = decode(reader, distances);
+        if (symbol < 0 || symbol >= 30 || !reader.read(kDistanceExtra[symbol], extra))
+            return Acad::eInvalidInput;
+        const size_t distance = kDistanceBase[symbol] + extra;
+        if (distance > output.size() - start)
+            return Acad::eInvalidInput;
+        if (length > maxSize - std::min(maxSize, output.size()))
+            return Acad::eDataTooLarge;
+        for (size_t i = 0; i < length; ++i)
+        {
+            const Adesk::UInt8 value = output[output.size() - distance];
+            output.push_back(value);
+        }
+    }
+}
+
+Acad::ErrorStatus inflateStored(BitReader& reader, std::vector<Adesk::UInt8>& output, size_t maxSize)
+{
+    reader.skipToByte();
+    unsigned length, complement;
+    if (!reader.read(16, length) || !reader.read(16, complement) || length != (~complement & 0xFFFF))
+        return Acad::eInvalidInput;
+    const Adesk::UInt8* pData = reader.take(length);
+    if (pData == nullptr)
+        return Acad::eInvalidInput;
+    if (length > maxSize - std::min(maxSize, output.size()))
+        return Acad::eDataTooLarge;
+    output.insert(output.end(), pData, pData + length);
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus inflateDynamic(BitReader& reader, std::vector<Adesk::UInt8>& output, size_t start,
+                                 size_t maxSize)
+{
+    unsigned literalCount, distanceCount, codeLengthCount;
+    if (!reader.read(5, literalCount) || !reader.read(5, distanceCount) || !reader.read(4, codeLengthCount))
+        return Acad::eInvalidInput;
+    literalCount += 257;
+    distanceCount += 1;
+    codeLengthCount += 4;
+    if (literalCount > 286 || distanceCount > 30)
+        return Acad::eInvalidInput;
+
+    Adesk::UInt16 lengths[kMaxCodes + 32] = {};
+    for (unsigned i = 0; i < codeLengthCount; ++i)
+    {
+        unsigned length;
+        if (!reader.read(3, length))
+            return Acad::eInvalidInput;
+        lengths[kCodeLengthOrder[i]] = Adesk::UInt16(length);
+    }
+    Huffman codeLengths;
+    if (buildHuffman(codeLengths, lengths, 19) != 0)
+        return Acad::eInvalidInput;
+
+    /* The lengths of both codes in one run, which repeats may cross. */
+    unsigned index = 0;
+    while (index < literalCount + distanceCount)
+    {
+        const int symbol = decode(reader, codeLengths);
+        if (symbol < 0)
+            return Acad::eInvalidInput;
+        if (symbol < 16)
+        {
+            lengths[index++] = Adesk::UInt16(symbol);
+            continue;
+        }
+        Adesk::UInt16 repeated = 0;
+        unsigned repeat;
+        if (symbol == 16)
+        {
+            if (index == 0 || !reader.read(2, repeat))
+                return Acad::eInvalidInput;
+            repeated = lengths[index - 1];
+            repeat += 3;
+        }
+        else if (symbol == 17)
+        {
+            if (!reader.read(3, repeat))
+                return Acad::eInvalidInput;
+            repeat += 3;
+        }
+        else
+        {
+            if (!reader.read(7, repeat))
+                return Acad::eInvalidInput;
+            repeat += 11;
+        }
+        if (index + repeat > literalCount + distanceCount)
+            return Acad::eInvalidInput;
+        while (repeat-- != 0)
+            lengths[index++] = repeated;
+    }
+    if (lengths[kEndOfBlock] == 0)
+        return Acad::eInvalidInput;
+
+    Huffman literals, distances;
+    int left = buildHuffman(literals, lengths, int(literalCount));
+    if (left < 0 || (left > 0 && literalCount - literals.count[0] != 1))
+        return Acad::eInvalidInput;
+    left = buildHuffman(distances, lengths + literalCount, int(distanceCount));
+    if (left < 0 || (left > 0 && distanceCount - distances.count[0] != 1))
+        return Acad::eInvalidInput;
+    return inflateCodes(reader, literals, distances, output, start, maxSize);
+}
+
+} // namespace
+
+Acad::ErrorStatus inflateRaw(const void* pSource, size_t size, std::vector<Adesk::UInt8>& output, size_t maxSize,
+                             size_t& consumed)
+{
+    static const FixedCodes s_fixed;
+    BitReader reader(static_cast<const Adesk::UInt8*>(pSource), size);
+    const size_t start = output.size();
+    Acad::ErrorStatus es = Acad::eOk;
+    unsigned last = 0;
+    while (es == Acad::eOk && last == 0)
+    {
+        unsigned type;
+        if (!reader.read(1, last) || !reader.read(2, type))
+            es = Acad::eInvalidInput;
+        else if (type == 0)
+            es = inflateStored(reader, output, maxSize);
+        else if (type == 1)
+            es = inflateCodes(reader, s_fixed.literals, s_fixed.distances, output, start, maxSize);
+        else if (type == 2)
+            es = inflateDynamic(reader, output, start, maxSize);
+        else
+            es = Acad::eInvalidInput;
+    }
+    consumed = reader.consumed();
+    return es;
+}
+
+Acad::ErrorStatus zlibDecompress(const void* pSource, size_t size, std::vector<Adesk::UInt8>& output,
+                                 size_t maxSize)
+{
+    output.clear();
+    const Adesk::UInt8* p = static_cast<const Adesk::UInt8*>(pSource);
+
+    /* Deflate with a window of at most 32 KB and no preset dictionary. */
+    if (size < 6 || (p[0] & 0x0F) != 8 || (p[0] >> 4) > 7 || (p[0] * 256u + p[1]) % 31 != 0 || (p[1] & 0x20) != 0)
+        return Acad::eInvalidInput;
+
+    size_t consumed = 0;
+    const Acad::ErrorStatus es = inflateRaw(p + 2, size - 2, output, maxSize, consumed);
+    if (es != Acad::eOk)
+        return es;
+    const Adesk::UInt8* pCheck = p + 2 + consumed;
+    if (size - 2 - consumed < 4)
+        return Acad::eInvalidInput;
+    const Adesk::UInt32 expected = (Adesk::UInt32(pCheck[0]) << 24) | (Adesk::UInt32(pCheck[1]) << 16) |
+                                   (Adesk::UInt32(pCheck[2]) << 8) | pCheck[3];
+    return adler32(output.data(), output.size()) == expected ? Acad::eOk : Acad::eInvalidInput;
+}
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,26 @@
+#pragma once
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// Decompresses raw deflate data (RFC 1951) of size bytes and appends it to
+/// output, setting consumed to the bytes the data took up.  Stored, fixed
+/// and dynamic Huffman blocks are all read, one code bit at a time, which is
+/// plenty for the cross-reference and object streams of a PDF but not meant
+/// for bulk data.  Damaged data returns Acad::eInvalidInput, and data that
+/// would grow output past maxSize bytes Acad::eDataTooLarge, both with
+/// whatever was decompressed up to then left in output.
+/// </summary>
+Acad::ErrorStatus inflateRaw(const void* pSource, size_t size, std::vector<Adesk::UInt8>& output, size_t maxSize,
+                             size_t& consumed);
+
+/// <summary>
+/// Decompresses a zlib stream (RFC 1950), deflate data between a two-byte
+/// header and an Adler-32 of the result, as PDF's FlateDecode filter holds
+/// it.  Replaces output.  Errors as for inflateRaw; an Adler-32 that does not
+/// match is Acad::eInvalidInput too.
+/// </summary>
+Acad::ErrorStatus zlibDecompress(const void* pSource, size_t size, std::vector<Adesk::UInt8>& output,
+                                 size_t maxSize);
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,383 @@
+#include "stdafx.h"
+#include "LinetypeComparison.h"
+
+#include "LinetypePatternCache.h"
+
+#include <cmath>
+#include <new>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+/* One dash as drawn: its ends and its length along the polyline. */
+struct DrawnDash
+{
+    AcGePoint3d start;
+    AcGePoint3d end;
+    double      length;
+};
+
+class RecordingTraits : public AcGiSubEntityTraits
+{
+public:
+    void setColor(const Adesk::UInt16 color) override { m_color = color; }
+    void setTrueColor(const AcCmEntityColor& color) override { m_trueColor = color; }
+    void setLayer(const AcDbObjectId layerId) override { m_layer = layerId; }
+    void setLineType(const AcDbObjectId linetypeId) override { m_linetype = linetypeId; }
+    void setSelectionMarker(const Adesk::LongPtr) override {}
+    void setFillType(const AcGiFillType fillType) override { m_fillType = fillType; }
+    void setLineWeight(const AcDb::LineWeight lineWeight) override { m_lineWeight = lineWeight; }
+    void setLineTypeScale(double scale) override { m_linetypeScale = scale; }
+    void setThickness(double thickness) override { m_thickness = thickness; }
+
+    Adesk::UInt16 color() const override { return m_color; }
+    AcCmEntityColor trueColor() const override { return m_trueColor; }
+    AcDbObjectId layerId() const override { return m_layer; }
+    AcDbObjectId lineTypeId() const override { return m_linetype; }
+    AcGiFillType fillType() const override { return m_fillType; }
+    AcDb::LineWeight lineWeight() const override { return m_lineWeight; }
+    double lineTypeScale() const override { return m_linetypeScale; }
+    double thickness() const override { return m_thickness; }
+
+private:
+    Adesk::UInt16       m_color = 256;
+    AcCmEntityColor     m_trueColor;
+    AcDbObjectId        m_layer;
+    AcDbObjectId        m_linetype;
+    AcGiFillType        m_fillType = kAcGiFillNever;
+    AcDb::LineWeight    m_lineWeight = AcDb::kLnWtByLayer;
+    double              m_linetypeScale = 1.0;
+    double              m_thickness = 0.0;
+};
+
+class RecordingContext : public AcGiContext
+{
+public:
+    explicit RecordingContext(AcDbDatabase* pDb) : m_pDb(pDb) {}
+
+    Adesk::Boolean isPsOut() const override { return Adesk::kFalse; }
+    Adesk::Boolean isPlotGeneration() const override { return Adesk::kFalse; }
+    AcDbDatabase* database() const override { return m_pDb; }
+    bool isBoundaryClipping() const override { return false; }
+
+private:
+    AcDbDatabase* m_pDb;
+};
+
+/* Keeps every polyline drawn as a dash and counts anything else, which a
+linetype engine drawing dashes, gaps and dots should not draw. */
+class RecordingGeometry : public AcGiWorldGeometry
+{
+public:
+    void clear()
+    {
+        m_dashes.clear();
+        m_otherCount = 0;
+    }
+
+    const std::vector<DrawnDash>& dashes() const { return m_dashes; }
+    size_t otherCount() const { return m_otherCount; }
+
+    void setExtents(AcGePoint3d*) const override {}
+
+    void getModelToWorldTransform(AcGeMatrix3d& matrix) const override { matrix.setToIdentity(); }
+    void getWorldToModelTransform(AcGeMatrix3d& matrix) const override { matrix.setToIdentity(); }
+    Adesk::Boolean pushModelTransform(const AcGeVector3d&) override { return Adesk::kTrue; }
+    Adesk::Boolean pushModelTransform(const AcGeMatrix3d&) override { return Adesk::kTrue; }
+    Adesk::Boolean popModelTransform() override { return Adesk::kTrue; }
+    AcGeMatrix3d pushPositionTransform(AcGiPositionTransformBehavior, const AcGePoint3d&) override { return AcGeMatrix3d::kIdentity; }
+    AcGeMatrix3d pushPositionTransform(AcGiPositionTransformBehavior, const AcGePoint2d&) override { return AcGeMatrix3d::kIdentity; }
+    AcGeMatrix3d pushScaleTransform(AcGiScaleTransformBehavior, const AcGePoint3d&) override { return AcGeMatrix3d::kIdentity; }
+    AcGeMatrix3d pushScaleTransform(AcGiScaleTransformBehavior, const AcGePoint2d&) override { return AcGeMatrix3d::kIdentity; }
+    AcGeMatrix3d pushOrientationTransform(AcGiOrientationTransformBehavior) override { return AcGeMatrix3d::kIdentity; }
+
+    Adesk::Boolean polyline(const Adesk::UInt32 nbPoints, const AcGePoint3d* pVertexList,
+                            const AcGeVector3d* = nullptr, Adesk::LongPtr = -1) const override
+    {
+        record(nbPoints, pVertexList);
+        return Adesk::kFalse;
+    }
+    Adesk::Boolean polyline(const AcGiPolyline& polylineObj) const override
+    {
+        record(polylineObj.points(), polylineObj.vertexList());
+        return Adesk::kFalse;
+    }
+    Adesk::Boolean polyPolyline(Adesk::UInt32 nbPolylines, const AcGiPolyline* pPolylines) const override
+    {
+        for (Adesk::UInt32 i = 0; i < nbPolylines; ++i)
+            record(pPolylines[i].points(), pPolylines[i].vertexList());
+        return Adesk::kFalse;
+    }
+    Adesk::Boolean rowOfDots(int count, const AcGePoint3d& start, const AcGeVector3d& step) const override
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            const AcGePoint3d dot = start + step * double(i);
+            record(1, &dot);
+        }
+        return Adesk::kFalse;
+    }
+
+    Adesk::Boolean circle(const AcGePoint3d&, const double, const AcGeVector3d&) const override { return other(); }
+    Adesk::Boolean circle(const AcGePoint3d&, const AcGePoint3d&, const AcGePoint3d&) const override { return other(); }
+    Adesk::Boolean circularArc(const AcGePoint3d&, const double, const AcGeVector3d&, const AcGeVector3d&,
+                               const double, const AcGiArcType = kAcGiArcSimple) const override { return other(); }
+    Adesk::Boolean circularArc(const AcGePoint3d&, const AcGePoint3d&, const AcGePoint3d&,
+                               const AcGiArcType = kAcGiArcSimple) const override { return other(); }
+    Adesk::Boolean polygon(const Adesk::UInt32, const AcGePoint3d*) const override { return other(); }
+    Adesk::Boolean polyPolygon(const Adesk::UInt32, const Adesk::UInt32*, const AcGePoint3d*, const Adesk::UInt32*,
+                               const AcGePoint3d*, const AcCmEntityColor* = nullptr, const AcGiLineType* = nullptr,
+                               const AcCmEntityColor* = nullptr, const AcCmTransparency* = nullptr) const override
+    {
+        return other();
+    }
+    Adesk::Boolean mesh(const Adesk::UInt32, const Adesk::UInt32, const AcGePoint3d*, const AcGiEdgeData* = nullptr,
+                        const AcGiFaceData* = nullptr, const AcGiVertexData* = nullptr,
+                        const bool = true) const override
+    {
+        return other();
+    }
+    Adesk::Boolean shell(const Adesk::UInt32, const AcGePoint3d*, const Adesk::UInt32, const Adesk::Int32*,
+                         const AcGiEdgeData* = nullptr, const AcGiFaceData* = nullptr,
+                         const AcGiVertexData* = nullptr, const struct resbuf* = nullptr,
+                         const bool = true) const override
+    {
+        return other();
+    }
+    Adesk::Boolean text(const AcGePoint3d&, const AcGeVector3d&, const AcGeVector3d&, const double, const double,
+                        const double, const ACHAR*) const override { return other(); }
+    Adesk::Boolean text(const AcGePoint3d&, const AcGeVector3d&, const AcGeVector3d&, const ACHAR*,
+                        const Adesk::Int32, const Adesk::Boolean, const AcGiTextStyle&) const override { return other(); }
+    Adesk::Boolean xline(const AcGePoint3d&, const AcGePoint3d&) const override { return other(); }
+    Adesk::Boolean ray(const AcGePoint3d&, const AcGePoint3d&) const override { return other(); }
+    Adesk::Boolean pline(const AcDbPolyline&, Adesk::UInt32 = 0, Adesk::UInt32 = 0) const override { return other(); }
+    Adesk::Boolean draw(AcGiDrawable*) const override { return other(); }
+    Adesk::Boolean image(const AcGiImageBGRA32&, const AcGePoint3d&, const AcGeVector3d&, const AcGeVector3d&,
+                         TransparencyMode = kTransparency8Bit) const override { return other(); }
+    Adesk::Boolean ellipticalArc(const AcGePoint3d&, const AcGeVector3d&, double, double, double, double, double,
+                                 AcGiArcType = kAcGiArcSimple) const override { return other(); }
+    Adesk::Boolean pushClipBoundary(AcGiClipBoundary*) override { return Adesk::kTrue; }
+    void popClipBoundary() override {}
+    Adesk::Boolean edge(const AcArray<AcGeCurve2d*>&) const override { return other(); }
+
+private:
+    void record(Adesk::UInt32 count, const AcGePoint3d* pPoints) const
+    {
+        if (count == 0 || pPoints == nullptr)
+            return;
+        DrawnDash dash;
+        dash.start = pPoints[0];
+        dash.end = pPoints[count - 1];
+        dash.length = 0.0;
+        for (Adesk::UInt32 i = 1; i < count; ++i)
+            dash.length += pPoints[i - 1].distanceTo(pPoints[i]);
+        m_dashes.push_back(dash);
+    }
+
+    Adesk::Boolean other() const
+    {
+        ++m_otherCount;
+        return Adesk::kFalse;
+    }
+
+    mutable std::vector<DrawnDash>  m_dashes;
+    mutable size_t                  m_otherCount = 0;
+};
+
+class RecordingWorldDraw : public AcGiWorldDraw
+{
+public:
+    explicit RecordingWorldDraw(AcDbDatabase* pDb) : m_context(pDb) {}
+
+    RecordingGeometry& recording() { return m_geometry; }
+
+    AcGiWorldGeometry& geometry() const override { return m_geometry; }
+    AcGiRegenType regenType() const override { return kAcGiStandardDisplay; }
+    Adesk::Boolean regenAbort() const override { return Adesk::kFalse; }
+    AcGiSubEntityTraits& subEntityTraits() const override { return m_traits; }
+    AcGiGeometry* rawGeometry() const override { return &m_geometry; }
+    Adesk::Boolean isDragging() const override { return Adesk::kFalse; }
+    double deviation(const AcGiDeviationType, const AcGePoint3d&) const override { return 0.0; }
+    Adesk::UInt32 numberOfIsolines() const override { return 4; }
+    AcGiContext* context() override { return &m_context; }
+
+private:
+    mutable RecordingGeometry   m_geometry;
+    mutable RecordingTraits     m_traits;
+    RecordingContext            m_context;
+};
+
+/* A polyline to draw, with its vertices in units of the pattern length. */
+struct ComparisonCase
+{
+    const ACHAR*    name;
+    bool            plineGen;
+    int             count;
+    double          vertices[5][2];
+};
+
+const ComparisonCase kComparisonCases[] =
+{
+    { ACRX_T("line of 0.6 patterns"),       false, 2, { { 0, 0 }, { 0.6, 0 } } },
+    { ACRX_T("line of 1 pattern"),          false, 2, { { 0, 0 }, { 1, 0 } } },
+    { ACRX_T("line of 1.5 patterns"),       false, 2, { { 0, 0 }, { 1.5, 0 } } },
+    { ACRX_T("line of 3.3 patterns"),       false, 2, { { 0, 0 }, { 2.64, 1.98 } } },
+    { ACRX_T("line of 12.7 patterns"),      false, 2, { { 0, 0 }, { 0, 12.7 } } },
+    { ACRX_T("polyline, per segment"),      false, 4, { { 0, 0 }, { 2.3, 0 }, { 2.3, 1.6 }, { 0.4, 3.1 } } },
+    { ACRX_T("polyline, end to end"),       true,  4, { { 0, 0 }, { 2.3, 0 }, { 2.3, 1.6 }, { 0.4, 3.1 } } },
+    { ACRX_T("closed polyline, end to end"), true, 5, { { 0, 0 }, { 1.9, 0 }, { 1.9, 1.9 }, { 0, 1.9 }, { 0, 0 } } },
+};
+
+const double kComparisonScales[] = { 1.0, 0.37 };
+
+/* Whether two dashes are the same, ends within tolerance of each other. */
+bool sameDash(const DrawnDash& a, const DrawnDash& b, double tolerance)
+{
+    return a.start.distanceTo(b.start) <= tolerance && a.end.distanceTo(b.end) <= tolerance &&
+           std::fabs(a.length - b.length) <= tolerance;
+}
+
+void describe(const AcString& linetype, double scale, const ComparisonCase& comparisonCase,
+              const RecordingGeometry& reference, const RecordingGeometry& cached, double tolerance,
+              AcString& mismatches)
+{
+    const std::vector<DrawnDash>& expected = reference.dashes();
+    const std::vector<DrawnDash>& actual = cached.dashes();
+    AcString line;
+    if (reference.otherCount() != 0 || cached.otherCount() != 0)
+    {
+        line.format(ACRX_T("%s at scale %g, %s: %u shapes other than dashes, AutoCAD draws %u\n"),
+                    linetype.kwszPtr(), scale, comparisonCase.name, unsigned(cached.otherCount()),
+                    unsigned(reference.otherCount()));
+    }
+    else if (expected.size() != actual.size())
+    {
+        line.format(ACRX_T("%s at scale %g, %s: %u dashes, AutoCAD draws %u\n"), linetype.kwszPtr(), scale,
+                    comparisonCase.name, unsigned(actual.size()), unsigned(expected.size()));
+    }
+    else
+    {
+        size_t i = 0;
+        while (i + 1 < actual.size() && sameDash(expected[i], actual[i], tolerance))
+            ++i;
+        line.format(ACRX_T("%s at scale %g, %s: dash %u runs (%g,%g)-(%g,%g), AutoCAD's (%g,%g)-(%g,%g)\n"),
+                    linetype.kwszPtr(), scale, comparisonCase.name, unsigned(i + 1),
+                    actual[i].start.x, actual[i].start.y, actual[i].end.x, actual[i].end.y,
+                    expected[i].start.x, expected[i].start.y, expected[i].end.x, expected[i].end.y);
+    }
+    mismatches += line;
+}
+
+} // namespace
+
+Acad::ErrorStatus compareLinetypeEngines(AcDbDatabase* pDb, double tolerance, LinetypeComparison& result)
+{
+    result = LinetypeComparison();
+    if (pDb == nullptr)
+        return Acad::eNullObjectPointer;
+
+    std::vector<AcDbObjectId> linetypes;
+    {
+        AcDbLinetypeTablePointer pTable(pDb->linetypeTableId(), AcDb::kForRead);
+        if (pTable.openStatus() != Acad::eOk)
+            return pTable.openStatus();
+        AcDbLinetypeTableIterator* pIterator = nullptr;
+        const Acad::ErrorStatus es = pTable->newIterator(pIterator);
+        if (es != Acad::eOk)
+            return es;
+        std::unique_ptr<AcDbLinetypeTableIterator> iterator(pIterator);
+        for (; !iterator->done(); iterator->step())
+        {
+            AcDbObjectId id;
+            if (iterator->getRecordId(id) == Acad::eOk)
+                linetypes.push_back(id);
+        }
+    }
+
+    const std::shared_ptr<LinetypePatternCache> pCache = std::make_shared<LinetypePatternCache>();
+    CachingLinetypeEngine cachedEngine(pCache);
+    AcGiLinetypeEngine referenceEngine;
+    RecordingWorldDraw reference(pDb);
+    RecordingWorldDraw cached(pDb);
+    const AcGeVector3d normal = AcGeVector3d::kZAxis;
+
+    try
+    {
+        for (const AcDbObjectId& linetype : linetypes)
+        {
+            AcString name;
+            {
+                AcDbObjectPointer<AcDbLinetypeTableRecord> pRecord(linetype, AcDb::kForRead);
+                if (pRecord.openStatus() != Acad::eOk)
+                    continue;
+                pRecord->getName(name);
+            }
+            bool counted = false;
+            for (const double scale : kComparisonScales)
+            {
+                const std::shared_ptr<const LinetypePattern> pPattern = pCache->find(linetype, scale);
+                if (pPattern == nullptr)
+                    continue;
+                if (!counted)
+                {
+                    ++result.linetypeCount;
+                    counted = true;
+                }
+                const double unit = pPattern->length();
+                for (const ComparisonCase& comparisonCase : kComparisonCases)
+                {
+                    AcGePoint3d points[5];
+                    for (int i = 0; i < comparisonCase.count; ++i)
+                        points[i].set(comparisonCase.vertices[i][0] * unit, comparisonCase.vertices[i][1] * unit, 0.0);
+
+                    reference.recording().clear();
+                    cached.recording().clear();
+                    reference.subEntityTraits().setLineType(linetype);
+                    cached.subEntityTraits().setLineType(linetype);
+                    referenceEngine.tessellate(false, false, Adesk::UInt32(comparisonCase.count), points, &reference,
+                                               linetype, scale, &normal, comparisonCase.plineGen);
+                    cachedEngine.tessellate(false, false, Adesk::UInt32(comparisonCase.count), points, &cached,
+                                            linetype, scale, &normal, comparisonCase.plineGen);
+                    ++result.caseCount;
+
+                    const std::vector<DrawnDash>& expected = reference.recording().dashes();
+                    const std::vector<DrawnDash>& actual = cached.recording().dashes();
+                    bool same = expected.size() == actual.size() && reference.recording().otherCount() == 0 &&
+                                cached.recording().otherCount() == 0;
+                    for (size_t i = 0; same && i < actual.size(); ++i)
+                        same = sameDash(expected[i], actual[i], tolerance * unit);
+                    if (same)
+                        continue;
+                    if (result.mismatchCount < 10)
+                        describe(name, scale, comparisonCase, reference.recording(), cached.recording(),
+                                 tolerance * unit, result.mismatches);
+                    ++result.mismatchCount;
+                }
+            }
+        }
+    }
+    catch (const std::bad_alloc&)
+    {
+        return Acad::eOutOfMemory;
+    }
+    return Acad::eOk;
+}
+
+void checkLinetypesCommand()
+{
+    LinetypeComparison result;
+    const Acad::ErrorStatus es =
+        compareLinetypeEngines(acdbHostApplicationServices()->workingDatabase(), 1e-6, result);
+    if (es != Acad::eOk)
+    {
+        acutPrintf(ACRX_T("\nCould not compare linetypes: %s\n"), acadErrorStatusText(es));
+        return;
+    }
+    acutPrintf(ACRX_T("\n%u linetypes, %u polylines: %u drawn differently from AutoCAD.\n"),
+               unsigned(result.linetypeCount), unsigned(result.caseCount), unsigned(result.mismatchCount));
+    if (!result.mismatches.isEmpty())
+        acutPrintf(ACRX_T("%s"), result.mismatches.kwszPtr());
+}
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,33 @@
+#pragma once
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// What compareLinetypeEngines found.
+/// </summary>
+struct LinetypeComparison
+{
+    size_t      linetypeCount = 0;      // linetypes that CachingLinetypeEngine draws itself
+    size_t      caseCount = 0;          // polylines drawn with both engines
+    size_t      mismatchCount = 0;
+    AcString    mismatches;             // a line for each of the first few, for the command line
+};
+
+/// <summary>
+/// Draws a fixed set of polylines in every simple linetype of pDb with both
+/// AutoCAD's AcGiLinetypeEngine and CachingLinetypeEngine, and compares the
+/// dashes they put out.  Two dashes match when their ends are within
+/// tolerance times the length of the pattern of each other.
+///
+/// Only AutoCAD has the reference engine, so this runs inside AutoCAD, as
+/// the SHEETSETTOPDFCHECKLINETYPES command.
+/// </summary>
+Acad::ErrorStatus compareLinetypeEngines(AcDbDatabase* pDb, double tolerance, LinetypeComparison& result);
+
+/// <summary>
+/// The SHEETSETTOPDFCHECKLINETYPES command: compareLinetypeEngines on the
+/// current drawing, reported on the command line.
+/// </summary>
+void checkLinetypesCommand();
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,339 @@
+#include "stdafx.h"
+#include "LinetypePatternCache.h"
+
+#include <cmath>
+#include <cstring>
+#include <new>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+AcGePoint3d along(const AcGePoint3d& from, const AcGePoint3d& to, double fraction)
+{
+    return AcGePoint3d(from.x + (to.x - from.x) * fraction,
+                       from.y + (to.y - from.y) * fraction,
+                       from.z + (to.z - from.z) * fraction);
+}
+
+} // namespace
+
+/* LinetypePattern --------------------------------------------------------- */
+
+LinetypePattern::LinetypePattern()
+    : m_length(0.0)
+{
+}
+
+Acad::ErrorStatus LinetypePattern::compile(const AcDbLinetypeTableRecord& record, double scale,
+                                           LinetypePattern& pattern)
+{
+    const int count = record.numDashes();
+    if (count <= 0 || record.isScaledToFit())
+        return Acad::eNotApplicable;
+
+    std::vector<double> lengths(count);
+    for (int i = 0; i < count; ++i)
+    {
+        AcString text;
+        if (!record.shapeStyleAt(i).isNull() || record.shapeNumberAt(i) != 0 ||
+            (record.textAt(i, text) == Acad::eOk && !text.isEmpty()))
+            return Acad::eNotApplicable;
+        lengths[i] = record.dashLengthAt(i);
+    }
+    const Acad::ErrorStatus es = pattern.setDashes(lengths.data(), count, scale);
+    if (es != Acad::eOk)
+        return es;
+    pattern.m_continuous = acdbSymUtil()->linetypeContinuousId(record.database());
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus LinetypePattern::setDashes(const double* pLengths, int count, double scale)
+{
+    if (pLengths == nullptr || count <= 0 || !(scale > 0.0) || !std::isfinite(scale))
+        return Acad::eInvalidInput;
+
+    bool hasGap = false;
+    double length = 0.0;
+    for (int i = 0; i < count; ++i)
+    {
+        if (!std::isfinite(pLengths[i]))
+            return Acad::eInvalidInput;
+        hasGap = hasGap || pLengths[i] < 0.0;
+        length += std::fabs(pLengths[i]) * scale;
+    }
+    if (!(length > 0.0) || !std::isfinite(length))
+        return Acad::eInvalidInput;
+    if (!hasGap)
+        return Acad::eNotApplicable;
+
+    m_lengths.resize(count);
+    m_drawn.resize(count);
+    for (int i = 0; i < count; ++i)
+    {
+        m_lengths[i] = std::fabs(pLengths[i]) * scale;
+        m_drawn[i] = pLengths[i] >= 0.0;
+    }
+    m_length = length;
+    return Acad::eOk;
+}
+
+void LinetypePattern::dash(const AcGePoint3d* pPoints, size_t count, bool closed, bool endToEnd,
+                           DashedPolylines& dashes) const
+{
+    if (pPoints == nullptr || count < 2 || m_lengths.empty())
+        return;
+    if (endToEnd)
+    {
+        dashRun(pPoints, count, closed ? &pPoints[0] : nullptr, dashes);
+        return;
+    }
+    for (size_t i = 0; i + 1 < count; ++i)
+        dashRun(&pPoints[i], 2, nullptr, dashes);
+    if (closed)
+        dashRun(&pPoints[count - 1], 1, &pPoints[0], dashes);
+}
+
+/* Lays the pattern out the way AutoCAD's A alignment does: the run starts
+and ends with a dash, the two of equal length, and whole patterns in
+between.  With k = floor(runLength / length()) and d the first dash, each end
+dash is (runLength - k * length() + d) / 2, so between half the first dash
+and that plus half a pattern.  A pattern that starts with a gap cannot be
+aligned and simply starts at the start of the run.
+
+Every element's place is worked out from the start of the run rather than
+added up from the one before, so the end dash meets the end of the run
+however long the run is.  The points are then walked one segment at a time,
+and a dash that is still going at a vertex takes the vertex, so that it bends
+round the corner as one polyline. */
+void LinetypePattern::dashRun(const AcGePoint3d* pPoints, size_t count, const AcGePoint3d* pClosingPoint,
+                              DashedPolylines& dashes) const
+{
+    const size_t segmentCount = pClosingPoint != nullptr ? count : count - 1;
+    auto segmentEnd = [&](size_t segment) -> const AcGePoint3d&
+    {
+        return segment + 1 < count ? pPoints[segment + 1] : *pClosingPoint;
+    };
+
+    double runLength = 0.0;
+    for (size_t i = 0; i < segmentCount; ++i)
+        runLength += pPoints[i].distanceTo(segmentEnd(i));
+
+    /* Too short for the pattern: one solid polyline instead. */
+    if (runLength < m_length)
+    {
+        if (runLength == 0.0)
+            return;
+        const size_t firstPoint = dashes.points.size();
+        dashes.points.insert(dashes.points.end(), pPoints, pPoints + count);
+        if (pClosingPoint != nullptr)
+            dashes.points.push_back(*pClosingPoint);
+        dashes.counts.push_back(static_cast<Adesk::UInt32>(dashes.points.size() - firstPoint));
+        return;
+    }
+
+    const size_t elementCount = m_lengths.size();
+    const bool aligned = m_drawn[0] != 0;
+    const double repeats = std::floor(runLength / m_length);
+    const double endDash = aligned ? (runLength - repeats * m_length + m_lengths[0]) / 2.0 : m_lengths[0];
+    const double origin = endDash - m_lengths[0];      // where the first pattern would start
+
+    /* The walk along the points: the segment it is on and how far along the
+    run that segment starts. */
+    size_t segment = 0;
+    double segmentStart = 0.0;
+    double segmentLength = segmentCount > 0 ? pPoints[0].distanceTo(segmentEnd(0)) : 0.0;
+    auto advance = [&]()
+    {
+        segmentStart += segmentLength;
+        ++segment;
+        segmentLength = pPoints[segment].distanceTo(segmentEnd(segment));
+    };
+    auto pointAt = [&](double position)
+    {
+        while (segment + 1 < segmentCount && position > segmentStart + segmentLength)
+            advance();
+        const double fraction = segmentLength > 0.0 ? (position - segmentStart) / segmentLength : 0.0;
+        return along(pPoints[segment], segmentEnd(segment), std::min(std::max(fraction, 0.0), 1.0));
+    };
+    auto addDash = [&](double start, double end)
+    {
+        const size_t dashStart = dashes.points.size();
+        dashes.points.push_back(pointAt(start));
+        while (segment + 1 < segmentCount && end > segmentStart + segmentLength)
+        {
+            if (segmentLength > 0.0 && segmentStart + segmentLength > start)
+                dashes.points.push_back(segmentEnd(segment));
+            advance();
+        }
+        dashes.points.push_back(pointAt(end));
+        dashes.counts.push_back(static_cast<Adesk::UInt32>(dashes.points.size() - dashStart));
+    };
+
+    if (aligned)
+        addDash(0.0, endDash);
+    const double lastStart = runLength - endDash;
+    for (double pattern = 0.0;; pattern += 1.0)
+    {
+        const double patternStart = origin + pattern * m_length;
+        double offset = 0.0;
+        for (size_t element = 0; element < elementCount; ++element)
+        {
+            const double start = patternStart + offset;
+            offset += m_lengths[element];
+            if (element == 0 && aligned)
+            {
+                if (pattern == 0.0)
+                    continue;
+                if (pattern == repeats)
+                {
+                    addDash(lastStart, runLength);
+                    return;
+                }
+            }
+            if (start >= runLength)
+                return;
+            if (m_drawn[element])
+                addDash(start, std::min(patternStart + offset, runLength));
+        }
+    }
+}
+
+/* LinetypePatternCache ---------------------------------------------------- */
+
+size_t LinetypePatternCache::KeyHash::operator()(const Key& key) const
+{
+    Adesk::UInt64 h = static_cast<Adesk::UInt64>(key.linetype) * 0x9E3779B97F4A7C15ull;
+    h ^= key.scale + 0x632BE59BD9B4E019ull + (h << 6) + (h >> 2);
+    return static_cast<size_t>(h ^ (h >> 32));
+}
+
+LinetypePatternCache::LinetypePatternCache()
+{
+}
+
+std::shared_ptr<const LinetypePattern> LinetypePatternCache::find(AcDbObjectId linetype, double scale)
+{
+    if (linetype.isNull())
+        return nullptr;
+    Key key;
+    key.linetype = linetype.asOldId();
+    std::memcpy(&key.scale, &scale, sizeof(scale));
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto found = m_patterns.find(key);
+        if (found != m_patterns.end())
+            return found->second;
+    }
+
+    /* Compiled without the lock; should another thread get there first,
+    its pattern is the one kept. */
+    std::shared_ptr<LinetypePattern> pPattern;
+    {
+        AcDbObjectPointer<AcDbLinetypeTableRecord> pRecord(linetype, AcDb::kForRead);
+        if (pRecord.openStatus() != Acad::eOk)
+            return nullptr;
+        pPattern = std::make_shared<LinetypePattern>();
+        if (LinetypePattern::compile(*pRecord.object(), scale, *pPattern) != Acad::eOk)
+            pPattern.reset();
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_patterns.emplace(key, std::move(pPattern)).first->second;
+}
+
+void LinetypePatternCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_patterns.clear();
+}
+
+size_t LinetypePatternCache::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_patterns.size();
+}
+
+/* CachingLinetypeEngine --------------------------------------------------- */
+
+CachingLinetypeEngine::CachingLinetypeEngine(const std::shared_ptr<LinetypePatternCache>& pCache)
+    : m_pCache(pCache),
+      m_polylineCapacity(0)
+{
+}
+
+CachingLinetypeEngine::~CachingLinetypeEngine()
+{
+}
+
+Acad::ErrorStatus CachingLinetypeEngine::tessellate(bool bIsArc, bool bIsCircle, const Adesk::UInt32 nPoints,
+                                                    const AcGePoint3d* pVertexList, AcGiWorldDraw* pWorldDraw,
+                                                    const AcDbObjectId linetypeId, double linetypeScale,
+                                                    const AcGeVector3d* pNormal, bool plineGen)
+{
+    if (pWorldDraw != nullptr &&
+        drawDashed(bIsArc, bIsCircle, nPoints, pVertexList, pWorldDraw->subEntityTraits(), pWorldDraw->geometry(),
+                   linetypeId, linetypeScale, pNormal, plineGen))
+        return Acad::eOk;
+    return AcGiLinetypeEngine::tessellate(bIsArc, bIsCircle, nPoints, pVertexList, pWorldDraw, linetypeId,
+                                          linetypeScale, pNormal, plineGen);
+}
+
+Acad::ErrorStatus CachingLinetypeEngine::tessellate(bool bIsArc, bool bIsCircle, const Adesk::UInt32 nPoints,
+                                                    const AcGePoint3d* pVertexList, AcGiViewportDraw* pViewportDraw,
+                                                    const AcDbObjectId linetypeId, double linetypeScale,
+                                                    const AcGeVector3d* pNormal, bool plineGen)
+{
+    if (pViewportDraw != nullptr &&
+        drawDashed(bIsArc, bIsCircle, nPoints, pVertexList, pViewportDraw->subEntityTraits(),
+                   pViewportDraw->geometry(), linetypeId, linetypeScale, pNormal, plineGen))
+        return Acad::eOk;
+    return AcGiLinetypeEngine::tessellate(bIsArc, bIsCircle, nPoints, pVertexList, pViewportDraw, linetypeId,
+                                          linetypeScale, pNormal, plineGen);
+}
+
+bool CachingLinetypeEngine::drawDashed(bool bIsArc, bool bIsCircle, Adesk::UInt32 nPoints,
+                                       const AcGePoint3d* pVertexList, AcGiSubEntityTraits& traits,
+                                       const AcGiGeometry& geometry, AcDbObjectId linetypeId, double linetypeScale,
+                                       const AcGeVector3d* pNormal, bool plineGen)
+{
+    if (!m_pCache || pVertexList == nullptr || nPoints < 2)
+        return false;
+    const std::shared_ptr<const LinetypePattern> pPattern = m_pCache->find(linetypeId, linetypeScale);
+    if (!pPattern || pPattern->continuousLinetype().isNull())
+        return false;
+
+    try
+    {
+        /* A circle may come with its first point repeated at the end or
+        not; either way it is drawn closed. */
+        m_dashes.clear();
+        const bool closed = bIsCircle && !pVertexList[0].isEqualTo(pVertexList[nPoints - 1]);
+        pPattern->dash(pVertexList, nPoints, closed, plineGen || bIsArc || bIsCircle, m_dashes);
+        if (m_dashes.size() > m_polylineCapacity)
+        {
+            m_pPolylines.reset(new AcGiPolyline[m_dashes.size()]);
+            m_polylineCapacity = m_dashes.size();
+        }
+    }
+    catch (const std::bad_alloc&)
+    {
+        return false;
+    }
+    if (m_dashes.size() == 0)
+        return true;
+
+    size_t offset = 0;
+    for (size_t i = 0; i < m_dashes.size(); ++i)
+    {
+        m_pPolylines[i].setVertexList(m_dashes.counts[i], &m_dashes.points[offset]);
+        m_pPolylines[i].setNormal(pNormal);
+        offset += m_dashes.counts[i];
+    }
+    const AcDbObjectId linetype = traits.lineTypeId();
+    traits.setLineType(pPattern->continuousLinetype());
+    geometry.polyPolyline(static_cast<Adesk::UInt32>(m_dashes.size()), m_pPolylines.get());
+    traits.setLineType(linetype);
+    return true;
+}
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "linetypeengine.h"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// Dashes cut from a polyline: polyline i is counts[i] points of points,
+/// after those of the polylines before it.  A dot is two equal points.
+/// </summary>
+struct DashedPolylines
+{
+    std::vector<AcGePoint3d>    points;
+    std::vector<Adesk::UInt32>  counts;
+
+    void clear() { points.clear(); counts.clear(); }
+    size_t size() const { return counts.size(); }
+};
+
+/// <summary>
+/// A simple linetype at one scale, compiled for cutting polylines into
+/// dashes: the length of each dash and gap, scale applied.
+///
+/// Only linetypes made of dashes, gaps and dots compile; those with shapes
+/// or text, and continuous ones, are drawn by AcGiLinetypeEngine.
+/// </summary>
+class LinetypePattern
+{
+public:
+    LinetypePattern();
+
+    /// <summary>
+    /// Compiles record at scale.  Returns Acad::eNotApplicable if the
+    /// linetype has shapes or text, is scaled to fit or has no gaps, and
+    /// Acad::eInvalidInput for a pattern or scale that is not positive.
+    /// </summary>
+    static Acad::ErrorStatus compile(const AcDbLinetypeTableRecord& record, double scale, LinetypePattern& pattern);
+
+    /// <summary>
+    /// Compiles count dash lengths, as AcDbLinetypeTableRecord::dashLengthAt
+    /// has them: positive for a dash, negative for a gap and zero for a
+    /// dot.
+    /// </summary>
+    Acad::ErrorStatus setDashes(const double* pLengths, int count, double scale);
+
+    double length() const { return m_length; }
+
+    /// <summary>
+    /// The continuous linetype of the linetype's database, which the
+    /// dashes are drawn with so that they are not dashed again.
+    /// </summary>
+    AcDbObjectId continuousLinetype() const { return m_continuous; }
+
+    /// <summary>
+    /// Appends the dashes of the polyline through count points to dashes.
+    /// The pattern is aligned as AutoCAD aligns it, so that each run starts
+    /// and ends with a dash.  endToEnd makes the whole polyline one run, with
+    /// dashes bending round the vertices in between, as for PLINEGEN;
+    /// otherwise every segment is a run of its own.  closed draws the
+    /// segment from the last point back to the first.  A run shorter than
+    /// one pattern is drawn solid, as AutoCAD draws it.
+    /// </summary>
+    void dash(const AcGePoint3d* pPoints, size_t count, bool closed, bool endToEnd, DashedPolylines& dashes) const;
+
+private:
+    void dashRun(const AcGePoint3d* pPoints, size_t count, const AcGePoint3d* pClosingPoint,
+                 DashedPolylines& dashes) const;
+
+    std::vector<double>         m_lengths;  // of each dash, gap and dot, scaled
+    std::vector<unsigned char>  m_drawn;    // whether each is a dash or a dot
+    double                      m_length;
+    AcDbObjectId                m_continuous;
+};
+
+/// <summary>
+/// Compiled linetype patterns by linetype and scale, for any number of
+/// CachingLinetypeEngine on any number of threads.
+///
+/// Patterns are compiled the first time a linetype is drawn at a scale,
+/// and so are the linetypes that do not compile, so that they are not
+/// opened again.  Linetypes are told apart by object id, which is only
+/// unique while their database is open: clear() the cache when drawings
+/// are closed, or when linetype definitions change.
+/// </summary>
+class LinetypePatternCache
+{
+public:
+    LinetypePatternCache();
+
+    LinetypePatternCache(const LinetypePatternCache&) = delete;
+    LinetypePatternCache& operator=(const LinetypePatternCache&) = delete;
+
+    /// <summary>
+    /// The pattern of linetype at scale, or null if it does not compile or
+    /// cannot be opened.
+    /// </summary>
+    std::shared_ptr<const LinetypePattern> find(AcDbObjectId linetype, double scale);
+
+    void clear();
+    size_t size() const;
+
+private:
+    struct Key
+    {
+        Adesk::IntPtr   linetype;
+        Adesk::UInt64   scale;      // bits of the double
+
+        bool operator==(const Key& other) const { return linetype == other.linetype && scale == other.scale; }
+    };
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const;
+    };
+
+    mutable std::mutex                                                      m_mutex;
+    std::unordered_map<Key, std::shared_ptr<const LinetypePattern>, KeyHash> m_patterns;
+};
+
+/// <summary>
+/// An AcGiLinetypeEngine that draws polylines in simple linetypes itself,
+/// from a LinetypePatternCache.
+///
+/// The vertex-list tessellate() overloads look the pattern up once, cut
+/// the whole polyline into dashes in one pass and draw them with a single
+/// polyPolyline in the continuous linetype, instead of regenerating the
+/// pattern for each call.  Circles and arcs, which arrive as vertices
+/// along them, always run the pattern end to end.  Linetypes with shapes
+/// or text, and the arc and line segment overloads, are left to
+/// AcGiLinetypeEngine.
+///
+/// An engine is used by one thread at a time; give each its own.
+/// </summary>
+class CachingLinetypeEngine : public AcGiLinetypeEngine
+{
+public:
+    explicit CachingLinetypeEngine(const std::shared_ptr<LinetypePatternCache>& pCache);
+    ~CachingLinetypeEngine();
+
+    Acad::ErrorStatus tessellate(bool bIsArc, bool bIsCircle, const Adesk::UInt32 nPoints,
+                                 const AcGePoint3d* pVertexList, AcGiWorldDraw* pWorldDraw,
+                                 const AcDbObjectId linetypeId, double linetypeScale, const AcGeVector3d* pNormal,
+                                 bool plineGen = false) override;
+
+    Acad::ErrorStatus tessellate(bool bIsArc, bool bIsCircle, const Adesk::UInt32 nPoints,
+                                 const AcGePoint3d* pVertexList, AcGiViewportDraw* pViewportDraw,
+                                 const AcDbObjectId linetypeId, double linetypeScale, const AcGeVector3d* pNormal,
+                                 bool plineGen = false) override;
+
+    using AcGiLinetypeEngine::tessellate;
+
+    const std::shared_ptr<LinetypePatternCache>& cache() const { return m_pCache; }
+
+private:
+    bool drawDashed(bool bIsArc, bool bIsCircle, Adesk::UInt32 nPoints, const AcGePoint3d* pVertexList,
+                    AcGiSubEntityTraits& traits, const AcGiGeometry& geometry, AcDbObjectId linetypeId,
+                    double linetypeScale, const AcGeVector3d* pNormal, bool plineGen);
+
+    std::shared_ptr<LinetypePatternCache>   m_pCache;
+    DashedPolylines                         m_dashes;       // kept from one call to the next
+    std::unique_ptr<AcGiPolyline[]>         m_pPolylines;
+    size_t                                  m_polylineCapacity;
+};
+
+} // namespace acad_sheetset_to_pdf
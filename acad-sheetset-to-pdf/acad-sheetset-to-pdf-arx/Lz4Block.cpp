@@ -0,0 +1,233 @@
+#include "stdafx.h"
+#include "Lz4Block.h"
+
+#include <cstring>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+/* A block is a run of sequences.  A sequence is a token, whose high nibble
+is the literal length and low nibble the match length less 4, either of
+which continues in the bytes after it when it is 15: bytes of 255 and a last
+one below that, all added up.  Then come the literals, the match offset back
+into the output as two little-endian bytes, and the continuation of the
+match length.  The last sequence has literals only.  Decoders that copy in
+whole words rely on the last 5 bytes being literals and on no match starting
+in the last 12, so the encoder keeps to both. */
+const size_t kMinMatch = 4;
+const size_t kLastLiterals = 5;
+const size_t kMatchStartLimit = 12;
+const size_t kMaxOffset = 65535;
+const int kHashBits = 12;
+
+Adesk::UInt32 read32(const Adesk::UInt8* p)
+{
+    Adesk::UInt32 value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+Adesk::UInt64 read64(const Adesk::UInt8* p)
+{
+    Adesk::UInt64 value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+Adesk::UInt32 hashOf(Adesk::UInt32 sequence)
+{
+    return (sequence * 2654435761u) >> (32 - kHashBits);
+}
+
+size_t lengthBytes(size_t length)
+{
+    return length >= 15 ? (length - 15) / 255 + 1 : 0;
+}
+
+Adesk::UInt8* putLength(Adesk::UInt8* p, size_t length)
+{
+    for (; length >= 255; length -= 255)
+        *p++ = 255;
+    *p++ = static_cast<Adesk::UInt8>(length);
+    return p;
+}
+
+} // namespace
+
+size_t lz4CompressBound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+size_t lz4Compress(const void* pSource, size_t size, void* pDestination, size_t capacity)
+{
+    if ((pSource == nullptr && size != 0) || pDestination == nullptr)
+        return 0;
+
+    const Adesk::UInt8* const pBase = static_cast<const Adesk::UInt8*>(pSource);
+    const Adesk::UInt8* const pEnd = pBase + size;
+    Adesk::UInt8* const pOutBegin = static_cast<Adesk::UInt8*>(pDestination);
+    Adesk::UInt8* const pOutEnd = pOutBegin + capacity;
+    Adesk::UInt8* pOut = pOutBegin;
+    const Adesk::UInt8* pAnchor = pBase;
+
+    /* Writes the literals from pAnchor up to pLiteralEnd and, unless
+    matchLength is 0, the match after them. */
+    const auto emit = [&](const Adesk::UInt8* pLiteralEnd, size_t offset, size_t matchLength)
+    {
+        const size_t literals = static_cast<size_t>(pLiteralEnd - pAnchor);
+        const size_t code = matchLength != 0 ? matchLength - kMinMatch : 0;
+        const size_t needed = 1 + lengthBytes(literals) + literals + (matchLength != 0 ? 2 + lengthBytes(code) : 0);
+        if (static_cast<size_t>(pOutEnd - pOut) < needed)
+            return false;
+
+        Adesk::UInt8* const pToken = pOut++;
+        *pToken = static_cast<Adesk::UInt8>((literals >= 15 ? 15 : literals) << 4);
+        if (literals >= 15)
+            pOut = putLength(pOut, literals - 15);
+        if (literals != 0)
+            std::memcpy(pOut, pAnchor, literals);
+        pOut += literals;
+        if (matchLength == 0)
+            return true;
+
+        *pOut++ = static_cast<Adesk::UInt8>(offset);
+        *pOut++ = static_cast<Adesk::UInt8>(offset >> 8);
+        *pToken |= static_cast<Adesk::UInt8>(code >= 15 ? 15 : code);
+        if (code >= 15)
+            pOut = putLength(pOut, code - 15);
+        return true;
+    };
+
+    /* Positions are kept as 32-bit offsets from pBase; anything larger than
+    that, like anything too short to hold a match, is stored as literals. */
+    if (size > kMatchStartLimit && size <= 0xFFFFFFFFull)
+    {
+        Adesk::UInt32 table[1 << kHashBits] = {};
+        const Adesk::UInt8* const pLastMatchStart = pEnd - kMatchStartLimit;
+        const Adesk::UInt8* const pMatchEndLimit = pEnd - kLastLiterals;
+        const Adesk::UInt8* p = pBase + 1;
+        while (p <= pLastMatchStart)
+        {
+            const Adesk::UInt32 sequence = read32(p);
+            const Adesk::UInt32 hash = hashOf(sequence);
+            const Adesk::UInt8* pMatch = pBase + table[hash];
+            table[hash] = static_cast<Adesk::UInt32>(p - pBase);
+            if (pMatch >= p || static_cast<size_t>(p - pMatch) > kMaxOffset || read32(pMatch) != sequence)
+            {
+                /* The longer nothing has matched, the bigger the steps, so
+                that data that does not compress goes by quickly. */
+                p += 1 + ((p - pAnchor) >> 6);
+                continue;
+            }
+
+            while (p > pAnchor && pMatch > pBase && p[-1] == pMatch[-1])
+            {
+                --p;
+                --pMatch;
+            }
+            size_t length = kMinMatch;
+            while (p + length + sizeof(Adesk::UInt64) <= pMatchEndLimit && read64(p + length) == read64(pMatch + length))
+                length += sizeof(Adesk::UInt64);
+            while (p + length < pMatchEndLimit && p[length] == pMatch[length])
+                ++length;
+
+            if (!emit(p, static_cast<size_t>(p - pMatch), length))
+                return 0;
+            p += length;
+            pAnchor = p;
+            if (p <= pLastMatchStart)
+                table[hashOf(read32(p - 2))] = static_cast<Adesk::UInt32>(p - 2 - pBase);
+        }
+    }
+    if (!emit(pEnd, 0, 0))
+        return 0;
+    return static_cast<size_t>(pOut - pOutBegin);
+}
+
+Acad::ErrorStatus lz4Decompress(const void* pSource, size_t size, void* pDestination, size_t decompressedSize)
+{
+    size_t produced = 0;
+    const Acad::ErrorStatus es = lz4Decompress(pSource, size, pDestination, decompressedSize, produced);
+    if (es != Acad::eOk)
+        return es;
+    return produced == decompressedSize ? Acad::eOk : Acad::eInvalidInput;
+}
+
+Acad::ErrorStatus lz4Decompress(const void* pSource, size_t size, void* pDestination, size_t capacity,
+                                size_t& decompressedSize, size_t historySize)
+{
+    decompressedSize = 0;
+    if (pSource == nullptr || (pDestination == nullptr && capacity != 0))
+        return Acad::eInvalidInput;
+
+    const Adesk::UInt8* p = static_cast<const Adesk::UInt8*>(pSource);
+    const Adesk::UInt8* const pEnd = p + size;
+    Adesk::UInt8* const pOutBegin = static_cast<Adesk::UInt8*>(pDestination);
+    Adesk::UInt8* const pOutEnd = pOutBegin + capacity;
+    Adesk::UInt8* pOut = pOutBegin;
+
+    const auto readLength = [&](size_t& length)
+    {
+        Adesk::UInt8 byte;
+        do
+        {
+            if (p == pEnd)
+                return false;
+            byte = *p++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    };
+
+    for (;;)
+    {
+        if (p == pEnd)
+            return Acad::eInvalidInput;
+        const unsigned token = *p++;
+
+        size_t literals = token >> 4;
+        if (literals == 15 && !readLength(literals))
+            return Acad::eInvalidInput;
+        if (literals > static_cast<size_t>(pEnd - p) || literals > static_cast<size_t>(pOutEnd - pOut))
+            return Acad::eInvalidInput;
+        if (literals != 0)
+            std::memcpy(pOut, p, literals);
+        pOut += literals;
+        p += literals;
+        if (p == pEnd)
+            break;
+
+        if (pEnd - p < 2)
+            return Acad::eInvalidInput;
+        const size_t offset = p[0] | (static_cast<size_t>(p[1]) << 8);
+        p += 2;
+        if (offset == 0 || offset > static_cast<size_t>(pOut - pOutBegin) + historySize)
+            return Acad::eInvalidInput;
+        size_t length = token & 15;
+        if (length == 15 && !readLength(length))
+            return Acad::eInvalidInput;
+        length += kMinMatch;
+        if (length > static_cast<size_t>(pOutEnd - pOut))
+            return Acad::eInvalidInput;
+
+        /* A match closer than its length repeats the bytes it is still
+        writing, so it cannot be copied in one go. */
+        const Adesk::UInt8* const pMatch = pOut - offset;
+        if (offset >= length)
+        {
+            std::memcpy(pOut, pMatch, length);
+        }
+        else
+        {
+            for (size_t i = 0; i < length; ++i)
+                pOut[i] = pMatch[i];
+        }
+        pOut += length;
+    }
+    decompressedSize = static_cast<size_t>(pOut - pOutBegin);
+    return Acad::eOk;
+}
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,35 @@
+#pragma once
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// The most lz4Compress can write for size bytes, which is what the
+/// destination should hold for it never to fail.
+/// </summary>
+size_t lz4CompressBound(size_t size);
+
+/// <summary>
+/// Compresses size bytes into an LZ4 block, as the reference lz4 library
+/// writes blocks, with a single greedy pass over a 4096-entry hash table.
+/// Returns the size of the block, or 0 if it did not fit in capacity bytes.
+/// </summary>
+size_t lz4Compress(const void* pSource, size_t size, void* pDestination, size_t capacity);
+
+/// <summary>
+/// Decompresses an LZ4 block of size bytes into exactly decompressedSize
+/// bytes.  Every length and offset is checked against both buffers, so a
+/// damaged block returns Acad::eInvalidInput rather than reading or writing
+/// out of bounds.
+/// </summary>
+Acad::ErrorStatus lz4Decompress(const void* pSource, size_t size, void* pDestination, size_t decompressedSize);
+
+/// <summary>
+/// Decompresses an LZ4 block whose size is only known to be at most
+/// capacity, as in LZ4 frames, setting decompressedSize.  Matches may reach
+/// back historySize bytes before pDestination, into the output of earlier
+/// blocks, for frames whose blocks depend on one another.
+/// </summary>
+Acad::ErrorStatus lz4Decompress(const void* pSource, size_t size, void* pDestination, size_t capacity,
+                                size_t& decompressedSize, size_t historySize = 0);
+
+} // namespace acad_sheetset_to_pdf
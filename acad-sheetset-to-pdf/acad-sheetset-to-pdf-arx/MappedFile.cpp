@@ -0,0 +1,200 @@
+#include "stdafx.h"
+#include "MappedFile.h"
+#include "IAcReadWriteStream.h"
+
+namespace acad_sheetset_to_pdf {
+
+MappedFile::MappedFile()
+    : m_hFile(INVALID_HANDLE_VALUE)
+    , m_hMapping(nullptr)
+    , m_pView(nullptr)
+    , m_size(0)
+    , m_access(kReadOnly)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : m_hFile(other.m_hFile)
+    , m_hMapping(other.m_hMapping)
+    , m_pView(other.m_pView)
+    , m_size(other.m_size)
+    , m_access(other.m_access)
+{
+    other.m_hFile = INVALID_HANDLE_VALUE;
+    other.m_hMapping = nullptr;
+    other.m_pView = nullptr;
+    other.m_size = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        close();
+        m_hFile = other.m_hFile;
+        m_hMapping = other.m_hMapping;
+        m_pView = other.m_pView;
+        m_size = other.m_size;
+        m_access = other.m_access;
+        other.m_hFile = INVALID_HANDLE_VALUE;
+        other.m_hMapping = nullptr;
+        other.m_pView = nullptr;
+        other.m_size = 0;
+    }
+    return *this;
+}
+
+Acad::ErrorStatus MappedFile::statusFromWin32(DWORD error)
+{
+    switch (error)
+    {
+    case ERROR_SUCCESS:
+        return Acad::eOk;
+    case ERROR_FILE_NOT_FOUND:
+    case ERROR_PATH_NOT_FOUND:
+        return Acad::eFileNotFound;
+    case ERROR_SHARING_VIOLATION:
+    case ERROR_LOCK_VIOLATION:
+        return Acad::eFileSharingViolation;
+    case ERROR_ACCESS_DENIED:
+    case ERROR_WRITE_PROTECT:
+        return Acad::eFileAccessErr;
+    case ERROR_NOT_ENOUGH_MEMORY:
+    case ERROR_OUTOFMEMORY:
+    case ERROR_COMMITMENT_LIMIT:
+        return Acad::eOutOfMemory;
+    case ERROR_HANDLE_EOF:
+        return Acad::eEndOfFile;
+    default:
+        return Acad::eFileSystemErr;
+    }
+}
+
+int MappedFile::streamStatusFromWin32(DWORD error)
+{
+    return error == ERROR_DISK_FULL || error == ERROR_HANDLE_DISK_FULL ? IAcReadStream::eDiskFull
+                                                                       : IAcReadStream::eJustAnError;
+}
+
+Acad::ErrorStatus MappedFile::open(const ACHAR* path, Access access)
+{
+    close();
+    if (path == nullptr)
+        return Acad::eNullPtr;
+
+    const DWORD desiredAccess = access == kReadWrite ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ;
+    const DWORD shareMode = access == kReadWrite ? FILE_SHARE_READ : (FILE_SHARE_READ | FILE_SHARE_DELETE);
+    m_hFile = ::CreateFileW(path, desiredAccess, shareMode, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (m_hFile == INVALID_HANDLE_VALUE)
+        return statusFromWin32(::GetLastError());
+
+    LARGE_INTEGER fileSize;
+    if (!::GetFileSizeEx(m_hFile, &fileSize))
+    {
+        const DWORD error = ::GetLastError();
+        close();
+        return statusFromWin32(error);
+    }
+    m_size = static_cast<Adesk::UInt64>(fileSize.QuadPart);
+    m_access = access;
+    return mapView();
+}
+
+Acad::ErrorStatus MappedFile::create(const ACHAR* path, Adesk::UInt64 size)
+{
+    close();
+    if (path == nullptr)
+        return Acad::eNullPtr;
+
+    m_hFile = ::CreateFileW(path, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_hFile == INVALID_HANDLE_VALUE)
+        return statusFromWin32(::GetLastError());
+
+    LARGE_INTEGER fileSize;
+    fileSize.QuadPart = static_cast<LONGLONG>(size);
+    if (!::SetFilePointerEx(m_hFile, fileSize, nullptr, FILE_BEGIN) || !::SetEndOfFile(m_hFile))
+    {
+        const DWORD error = ::GetLastError();
+        close();
+        return statusFromWin32(error);
+    }
+    m_size = size;
+    m_access = kReadWrite;
+    return mapView();
+}
+
+Acad::ErrorStatus MappedFile::mapView()
+{
+    // CreateFileMapping refuses empty files; an empty file simply has no view.
+    if (m_size == 0)
+        return Acad::eOk;
+
+    const DWORD protect = m_access == kReadWrite ? PAGE_READWRITE : PAGE_READONLY;
+    m_hMapping = ::CreateFileMappingW(m_hFile, nullptr, protect, 0, 0, nullptr);
+    if (m_hMapping == nullptr)
+    {
+        const DWORD error = ::GetLastError();
+        close();
+        return statusFromWin32(error);
+    }
+
+    const DWORD viewAccess = m_access == kReadWrite ? FILE_MAP_WRITE : FILE_MAP_READ;
+    m_pView = static_cast<Adesk::UInt8*>(::MapViewOfFile(m_hMapping, viewAccess, 0, 0, 0));
+    if (m_pView == nullptr)
+    {
+        const DWORD error = ::GetLastError();
+        close();
+        return statusFromWin32(error);
+    }
+    return Acad::eOk;
+}
+
+void MappedFile::close()
+{
+    if (m_pView != nullptr)
+    {
+        ::UnmapViewOfFile(m_pView);
+        m_pView = nullptr;
+    }
+    if (m_hMapping != nullptr)
+    {
+        ::CloseHandle(m_hMapping);
+        m_hMapping = nullptr;
+    }
+    if (m_hFile != INVALID_HANDLE_VALUE)
+    {
+        ::CloseHandle(m_hFile);
+        m_hFile = INVALID_HANDLE_VALUE;
+    }
+    m_size = 0;
+}
+
+Acad::ErrorStatus MappedFile::flush()
+{
+    if (m_access != kReadWrite || m_pView == nullptr)
+        return Acad::eOk;
+    if (!::FlushViewOfFile(m_pView, 0) || !::FlushFileBuffers(m_hFile))
+        return statusFromWin32(::GetLastError());
+    return Acad::eOk;
+}
+
+void MappedFile::prefetch(Adesk::UInt64 offset, Adesk::UInt64 length) const
+{
+    if (m_pView == nullptr || offset >= m_size)
+        return;
+    length = std::min(length, m_size - offset);
+
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = m_pView + offset;
+    range.NumberOfBytes = static_cast<SIZE_T>(length);
+    ::PrefetchVirtualMemory(::GetCurrentProcess(), 1, &range, 0);
+}
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,86 @@
+#pragma once
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// A whole file mapped into the address space of the process.
+/// Pages are faulted in by the operating system on first touch, so mapping a
+/// multi-gigabyte file costs nothing until the data is actually read, and
+/// clean pages can be dropped again under memory pressure.
+/// </summary>
+class MappedFile
+{
+public:
+    enum Access
+    {
+        kReadOnly,
+        kReadWrite
+    };
+
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    /// <summary>
+    /// Maps an existing file.  Any mapping previously held is closed first.
+    /// </summary>
+    Acad::ErrorStatus open(const ACHAR* path, Access access = kReadOnly);
+
+    /// <summary>
+    /// Creates (or truncates) a file of exactly the given size and maps it
+    /// for writing.
+    /// </summary>
+    Acad::ErrorStatus create(const ACHAR* path, Adesk::UInt64 size);
+
+    /// <summary>
+    /// Unmaps the view and closes the file.  Safe to call more than once.
+    /// </summary>
+    void close();
+
+    /// <summary>
+    /// Writes dirty pages back and waits until they reach the disk.
+    /// </summary>
+    Acad::ErrorStatus flush();
+
+    /// <summary>
+    /// Asks the operating system to start paging in the given byte range
+    /// asynchronously.  This is only a hint; the range is clamped to the file.
+    /// </summary>
+    void prefetch(Adesk::UInt64 offset, Adesk::UInt64 length) const;
+
+    bool isOpen() const { return m_hFile != INVALID_HANDLE_VALUE; }
+    Access access() const { return m_access; }
+    Adesk::UInt64 size() const { return m_size; }
+    const Adesk::UInt8* data() const { return m_pView; }
+
+    /// <summary>
+    /// The view for writing, or null if the file was mapped read-only.
+    /// </summary>
+    Adesk::UInt8* writableData() { return m_access == kReadWrite ? m_pView : nullptr; }
+
+    /// <summary>
+    /// Translates a Win32 error code into the closest Acad::ErrorStatus.
+    /// </summary>
+    static Acad::ErrorStatus statusFromWin32(DWORD error);
+
+    /// <summary>
+    /// Translates a Win32 error code into the closest IAcReadStream status,
+    /// for the streams that write files.
+    /// </summary>
+    static int streamStatusFromWin32(DWORD error);
+
+private:
+    Acad::ErrorStatus mapView();
+
+    HANDLE         m_hFile;
+    HANDLE         m_hMapping;
+    Adesk::UInt8*  m_pView;
+    Adesk::UInt64  m_size;
+    Access         m_access;
+};
+
+} // namespace acad_sheetset_to_pdf
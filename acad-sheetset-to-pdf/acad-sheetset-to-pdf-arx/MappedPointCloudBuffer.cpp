@@ -0,0 +1,196 @@
+#include "stdafx.h"
+#include "MappedPointCloudBuffer.h"
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+const IAcDbPointCloudDataBuffer::DataType kColumnDataType[kPointCloudColumnCount] = {
+    IAcDbPointCloudDataBuffer::DataType(0),     // points are always present
+    IAcDbPointCloudDataBuffer::kNormal,
+    IAcDbPointCloudDataBuffer::kColor,
+    IAcDbPointCloudDataBuffer::kIntensity,
+    IAcDbPointCloudDataBuffer::kClassification,
+};
+
+Adesk::UInt64 alignUp(Adesk::UInt64 value)
+{
+    return (value + kPointCloudSectionAlignment - 1) & ~(kPointCloudSectionAlignment - 1);
+}
+
+bool columnPresent(Adesk::UInt32 dataTypes, int column)
+{
+    return column == kPointColumn || (dataTypes & kColumnDataType[column]) != 0;
+}
+
+} // namespace
+
+size_t pointCloudColumnElementSize(PointCloudColumn column)
+{
+    switch (column)
+    {
+    case kPointColumn:          return sizeof(AcGePoint3d);
+    case kNormalColumn:         return sizeof(AcGeVector3d);
+    case kColorColumn:          return sizeof(IAcDbPointCloudDataBuffer::RGBA);
+    case kIntensityColumn:      return sizeof(Adesk::UInt8);
+    case kClassificationColumn: return sizeof(Adesk::UInt8);
+    default:                    return 0;
+    }
+}
+
+Adesk::UInt64 layoutPointCloudColumns(PointCloudColumnHeader& header)
+{
+    Adesk::UInt64 offset = alignUp(sizeof(PointCloudColumnHeader));
+    for (int column = 0; column < kPointCloudColumnCount; ++column)
+    {
+        PointCloudColumnSection& section = header.sections[column];
+        if (!columnPresent(header.dataTypes, column))
+        {
+            section.offset = 0;
+            section.size = 0;
+            continue;
+        }
+        section.offset = offset;
+        section.size = header.numPoints * pointCloudColumnElementSize(PointCloudColumn(column));
+        offset = alignUp(offset + section.size);
+    }
+    return offset;
+}
+
+MappedPointCloudBuffer::MappedPointCloudBuffer()
+    : m_pHeader(nullptr)
+{
+}
+
+MappedPointCloudBuffer::~MappedPointCloudBuffer()
+{
+}
+
+Acad::ErrorStatus MappedPointCloudBuffer::open(const ACHAR* path, MappedPointCloudBuffer*& pBuffer)
+{
+    pBuffer = nullptr;
+
+    std::unique_ptr<MappedPointCloudBuffer> pNew(new MappedPointCloudBuffer());
+    Acad::ErrorStatus es = pNew->m_file.open(path, MappedFile::kReadOnly);
+    if (es != Acad::eOk)
+        return es;
+
+    const Adesk::UInt64 fileSize = pNew->m_file.size();
+    if (fileSize < sizeof(PointCloudColumnHeader))
+        return Acad::eUnsupportedFileFormat;
+
+    const PointCloudColumnHeader* pHeader =
+        reinterpret_cast<const PointCloudColumnHeader*>(pNew->m_file.data());
+    if (memcmp(pHeader->magic, kPointCloudColumnFileMagic, sizeof(pHeader->magic)) != 0)
+        return Acad::eUnsupportedFileFormat;
+    if (pHeader->version != kPointCloudColumnFileVersion)
+        return Acad::eInvalidDwgVersion;
+
+    // Re-derive the layout from the point count and compare, rather than
+    // trusting offsets from the file; a truncated or hand-edited file must not
+    // make points() hand out pointers past the end of the view.
+    PointCloudColumnHeader expected = *pHeader;
+    if (pHeader->numPoints > fileSize / sizeof(AcGePoint3d))
+        return Acad::eInvalidInput;
+    if (layoutPointCloudColumns(expected) > fileSize)
+        return Acad::eInvalidInput;
+    for (int column = 0; column < kPointCloudColumnCount; ++column)
+    {
+        if (expected.sections[column].offset != pHeader->sections[column].offset ||
+            expected.sections[column].size != pHeader->sections[column].size)
+        {
+            return Acad::eInvalidInput;
+        }
+    }
+
+    pNew->m_pHeader = pHeader;
+    for (int row = 0; row < 4; ++row)
+        for (int col = 0; col < 4; ++col)
+            pNew->m_transform.entry[row][col] = pHeader->transform[row][col];
+
+    pBuffer = pNew.release();
+    return Acad::eOk;
+}
+
+const void* MappedPointCloudBuffer::column(PointCloudColumn column) const
+{
+    const PointCloudColumnSection& section = m_pHeader->sections[column];
+    if (section.offset == 0 || m_pHeader->numPoints == 0)
+        return nullptr;
+    return m_file.data() + section.offset;
+}
+
+Adesk::UInt64 MappedPointCloudBuffer::numPoints() const
+{
+    return m_pHeader->numPoints;
+}
+
+const AcGePoint3d* MappedPointCloudBuffer::points() const
+{
+    return static_cast<const AcGePoint3d*>(column(kPointColumn));
+}
+
+const AcGeVector3d* MappedPointCloudBuffer::normals() const
+{
+    return static_cast<const AcGeVector3d*>(column(kNormalColumn));
+}
+
+const IAcDbPointCloudDataBuffer::RGBA* MappedPointCloudBuffer::colors() const
+{
+    return static_cast<const RGBA*>(column(kColorColumn));
+}
+
+const Adesk::UInt8* MappedPointCloudBuffer::intensity() const
+{
+    return static_cast<const Adesk::UInt8*>(column(kIntensityColumn));
+}
+
+const Adesk::UInt8* MappedPointCloudBuffer::classifications() const
+{
+    return static_cast<const Adesk::UInt8*>(column(kClassificationColumn));
+}
+
+const AcGeMatrix3d& MappedPointCloudBuffer::transform() const
+{
+    return m_transform;
+}
+
+void MappedPointCloudBuffer::freeObject()
+{
+    delete this;
+}
+
+void* MappedPointCloudBuffer::getBuffer() const
+{
+    // Reserved for AutoCAD's own buffers; ours has no internal representation
+    // beyond the mapped file.
+    return nullptr;
+}
+
+bool MappedPointCloudBuffer::hasData(DataType type) const
+{
+    return (m_pHeader->dataTypes & type) != 0;
+}
+
+void MappedPointCloudBuffer::extents(AcGePoint3d& minPoint, AcGePoint3d& maxPoint) const
+{
+    minPoint.set(m_pHeader->minPoint[0], m_pHeader->minPoint[1], m_pHeader->minPoint[2]);
+    maxPoint.set(m_pHeader->maxPoint[0], m_pHeader->maxPoint[1], m_pHeader->maxPoint[2]);
+}
+
+void MappedPointCloudBuffer::prefetch(Adesk::UInt64 first, Adesk::UInt64 count, Adesk::UInt32 dataTypes) const
+{
+    if (first >= m_pHeader->numPoints)
+        return;
+    count = std::min(count, m_pHeader->numPoints - first);
+    for (int column = 0; column < kPointCloudColumnCount; ++column)
+    {
+        const PointCloudColumnSection& section = m_pHeader->sections[column];
+        if (section.offset == 0 || !columnPresent(dataTypes, column))
+            continue;
+        const size_t elementSize = pointCloudColumnElementSize(PointCloudColumn(column));
+        m_file.prefetch(section.offset + first * elementSize, count * elementSize);
+    }
+}
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "AcDbPointCloudApi.h"
+#include "MappedFile.h"
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// On-disk layout of a columnar point cloud file (*.pcc).
+///
+/// The file starts with a PointCloudColumnHeader, padded to
+/// kPointCloudSectionAlignment bytes.  Every attribute follows as its own
+/// section, each starting on a kPointCloudSectionAlignment boundary, in
+/// exactly the in-memory representation IAcDbPointCloudDataBuffer hands out
+/// (AcGePoint3d, AcGeVector3d, RGBA, UInt8).  A reader therefore only has to
+/// map the file and point into it; nothing is parsed or copied, and a scan
+/// that only looks at points never touches the pages of the other columns.
+/// </summary>
+enum PointCloudColumn
+{
+    kPointColumn = 0,
+    kNormalColumn,
+    kColorColumn,
+    kIntensityColumn,
+    kClassificationColumn,
+    kPointCloudColumnCount
+};
+
+const Adesk::UInt64 kPointCloudSectionAlignment = 64 * 1024;
+const Adesk::UInt32 kPointCloudColumnFileVersion = 1;
+const char kPointCloudColumnFileMagic[8] = { 'A', 'C', 'P', 'C', 'C', 'O', 'L', '\0' };
+
+struct PointCloudColumnSection
+{
+    Adesk::UInt64 offset;   // from the start of the file, 0 if the column is absent
+    Adesk::UInt64 size;     // in bytes
+};
+
+struct PointCloudColumnHeader
+{
+    char                    magic[8];
+    Adesk::UInt32           version;
+    Adesk::UInt32           dataTypes;      // IAcDbPointCloudDataBuffer::DataType bits
+    Adesk::UInt64           numPoints;
+    double                  transform[4][4];
+    double                  minPoint[3];
+    double                  maxPoint[3];
+    PointCloudColumnSection sections[kPointCloudColumnCount];
+};
+
+/// <summary>
+/// Size in bytes of one element of the given column.
+/// </summary>
+size_t pointCloudColumnElementSize(PointCloudColumn column);
+
+/// <summary>
+/// Fills in the section table of header for header.numPoints points and the
+/// columns selected by header.dataTypes, and returns the resulting file size.
+/// </summary>
+Adesk::UInt64 layoutPointCloudColumns(PointCloudColumnHeader& header);
+
+/// <summary>
+/// An IAcDbPointCloudDataBuffer that serves its arrays straight out of a
+/// memory-mapped columnar point cloud file.
+/// </summary>
+class MappedPointCloudBuffer : public IAcDbPointCloudDataBuffer
+{
+public:
+    /// <summary>
+    /// Maps the file at path and validates its header and section table.
+    /// On success pBuffer receives a new buffer that the caller releases with
+    /// freeObject().
+    /// </summary>
+    static Acad::ErrorStatus open(const ACHAR* path, MappedPointCloudBuffer*& pBuffer);
+
+    virtual ~MappedPointCloudBuffer();
+
+    virtual Adesk::UInt64 numPoints() const override;
+    virtual const AcGePoint3d* points() const override;
+    virtual const AcGeVector3d* normals() const override;
+    virtual const RGBA* colors() const override;
+    virtual const Adesk::UInt8* intensity() const override;
+    virtual const Adesk::UInt8* classifications() const override;
+    virtual const AcGeMatrix3d& transform() const override;
+    virtual void freeObject() override;
+    virtual void* getBuffer() const override;
+
+    /// <summary>
+    /// Returns true if the file carries the given attribute column.
+    /// </summary>
+    bool hasData(DataType type) const;
+
+    /// <summary>
+    /// Returns the bounding box of the points, in the buffer's local coordinates.
+    /// </summary>
+    void extents(AcGePoint3d& minPoint, AcGePoint3d& maxPoint) const;
+
+    /// <summary>
+    /// Starts paging in points [first, first + count) of the requested
+    /// columns in the background.  The point column is always included;
+    /// dataTypes selects the optional ones.
+    /// </summary>
+    void prefetch(Adesk::UInt64 first, Adesk::UInt64 count, Adesk::UInt32 dataTypes = 0) const;
+
+private:
+    MappedPointCloudBuffer();
+
+    const void* column(PointCloudColumn column) const;
+
+    MappedFile                    m_file;
+    const PointCloudColumnHeader* m_pHeader;
+    AcGeMatrix3d                  m_transform;
+};
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,150 @@
+#include "stdafx.h"
+#include "PagePropertyReactor.h"
+#include "PublishMetadataReactor.h"
+
+#include <new>
+#include <unordered_set>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+/* Adds a definition in category for every property of values that has a
+name and has none yet, with its value if withValues is set. */
+void addDefinitions(const AcNameValuePairVec& values, const ACHAR* category, bool withValues,
+                    std::vector<PagePropertyDefinition>& properties, std::unordered_set<std::wstring>& names)
+{
+    for (int i = 0; i < values.length(); ++i)
+    {
+        const ACHAR* name = values[i].name();
+        if (name == nullptr || *name == 0 || !names.insert(name).second)
+            continue;
+        PagePropertyDefinition definition;
+        definition.name = name;
+        if (withValues && values[i].value() != nullptr)
+            definition.value = values[i].value();
+        definition.category = category;
+        properties.push_back(std::move(definition));
+    }
+}
+
+} // namespace
+
+const ACHAR* const PagePropertyReactor::kJobCategory = ACRX_T("Sheet Set");
+const ACHAR* const PagePropertyReactor::kSheetCategory = ACRX_T("Sheet");
+
+PagePropertyReactor::PagePropertyReactor(ACGLOBADDDMMREACTOR addDmmReactor, ACGLOBREMOVEDMMREACTOR removeDmmReactor)
+    : m_addDmmReactor(addDmmReactor)
+    , m_removeDmmReactor(removeDmmReactor)
+    , m_sheetReactor(*this)
+    , m_sheetReactorAdded(false)
+    , m_currentSheet(-1)
+    , m_emittedPages(0)
+{
+}
+
+PagePropertyReactor::~PagePropertyReactor()
+{
+    endJob();
+}
+
+void PagePropertyReactor::OnAboutToBeginPublishing(AcPublishBeginJobInfo* pInfo)
+{
+    endJob();
+    m_emittedPages = 0;
+    if (pInfo == nullptr || pInfo->GetDSDData() == nullptr || m_addDmmReactor == nullptr ||
+        m_removeDmmReactor == nullptr)
+        return;
+
+    try
+    {
+        pInfo->GetDSDData()->getDSDEntries(m_entries);
+        const size_t count = size_t(m_entries.length());
+        std::vector<PagePropertyDefinition> properties;
+        std::unordered_set<std::wstring> names;
+        addDefinitions(pInfo->GetPrivateData(PublishMetadataReactor::kJobSection), kJobCategory, true, properties,
+                       names);
+        std::vector<AcNameValuePairVec> sheetValues(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            sheetValues[i] = pInfo->GetPrivateData(PublishMetadataReactor::sheetSection(int(i)).kwszPtr());
+            addDefinitions(sheetValues[i], kSheetCategory, false, properties, names);
+        }
+
+        std::shared_ptr<const PagePropertyTemplate> pTemplate;
+        if (properties.empty() || PagePropertyTemplate::create(properties, {}, pTemplate) != Acad::eOk)
+        {
+            endJob();
+            return;
+        }
+        m_sheets.assign(count, PagePropertySet(pTemplate));
+        for (size_t i = 0; i < count; ++i)
+            m_sheets[i].setValues(sheetValues[i]);
+        m_begun.assign(count, 0);
+    }
+    catch (const std::bad_alloc&)
+    {
+        /* Publish without page properties. */
+        endJob();
+        return;
+    }
+
+    m_addDmmReactor(&m_sheetReactor);
+    m_sheetReactorAdded = true;
+}
+
+void PagePropertyReactor::OnBeginPublishingSheet(AcPublishSheetInfo* pInfo)
+{
+    m_currentSheet = -1;
+    const AcPlDSDEntry* pEntry = pInfo != nullptr ? pInfo->GetDSDEntry() : nullptr;
+    if (!m_sheetReactorAdded || pEntry == nullptr)
+        return;
+
+    /* The first entry of this layout not yet published, so that a layout
+    listed twice gets each entry's properties in turn. */
+    for (int i = 0; i < m_entries.length(); ++i)
+    {
+        if (!m_begun[size_t(i)] && _wcsicmp(m_entries[i].dwgName(), pEntry->dwgName()) == 0 &&
+            _wcsicmp(m_entries[i].layout(), pEntry->layout()) == 0)
+        {
+            m_begun[size_t(i)] = 1;
+            m_currentSheet = i;
+            return;
+        }
+    }
+}
+
+void PagePropertyReactor::OnEndPublish(AcPublishReactorInfo*)
+{
+    endJob();
+}
+
+void PagePropertyReactor::OnCancelledOrFailedPublishing(AcPublishReactorInfo*)
+{
+    endJob();
+}
+
+void PagePropertyReactor::endJob()
+{
+    if (m_sheetReactorAdded)
+    {
+        m_removeDmmReactor(&m_sheetReactor);
+        m_sheetReactorAdded = false;
+    }
+    m_entries.removeAll();
+    m_sheets.clear();
+    m_begun.clear();
+    m_currentSheet = -1;
+    m_emitter.clear();
+}
+
+void PagePropertyReactor::SheetReactor::OnEndSheet(AcDMMSheetReactorInfo* pInfo)
+{
+    if (pInfo == nullptr || m_owner.m_currentSheet < 0)
+        return;
+    m_owner.m_emitter.emit(m_owner.m_sheets[size_t(m_owner.m_currentSheet)], *pInfo);
+    ++m_owner.m_emittedPages;
+    m_owner.m_currentSheet = -1;
+}
+
+} // namespace acad_sheetset_to_pdf
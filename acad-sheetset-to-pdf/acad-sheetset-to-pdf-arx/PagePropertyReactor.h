@@ -0,0 +1,82 @@
+#pragma once
+
+#include "PagePropertySet.h"
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// A publish reactor that puts the metadata PublishMetadataReactor wrote to
+/// a job's DSD on the pages the job publishes, as their page properties.
+///
+/// OnAboutToBeginPublishing reads the job's section and each sheet's back
+/// with GetPrivateData, so the reactor has to be registered after the
+/// PublishMetadataReactor that writes them.  The job's properties, with
+/// their values, and the names of all sheets' properties, without, make one
+/// PagePropertyTemplate; every sheet gets a PagePropertySet of it with its
+/// own values.  If there is anything to publish, the reactor then adds an
+/// AcDMMReactor, as acdmmapi.h recommends, and removes it when the job ends.
+/// OnBeginPublishingSheet notes which DSD entry is being published, and the
+/// DMM reactor's OnEndSheet hands that entry's set to a PagePropertyEmitter.
+///
+/// Notifications are for the publishing thread.  Register it with
+/// AcGlobAddPublishReactor, after the PublishMetadataReactor, and remove it
+/// with AcGlobRemovePublishReactor before destroying it.
+/// </summary>
+class PagePropertyReactor : public AcPublishReactor
+{
+public:
+    static const ACHAR* const kJobCategory;     // "Sheet Set"
+    static const ACHAR* const kSheetCategory;   // "Sheet"
+
+    /// <summary>
+    /// addDmmReactor and removeDmmReactor are AcGlobAddDMMReactor and
+    /// AcGlobRemoveDMMReactor; without them nothing is published.
+    /// </summary>
+    PagePropertyReactor(ACGLOBADDDMMREACTOR addDmmReactor, ACGLOBREMOVEDMMREACTOR removeDmmReactor);
+
+    /// <summary>
+    /// Removes the DMM reactor if a job is still being published.
+    /// </summary>
+    ~PagePropertyReactor();
+
+    PagePropertyReactor(const PagePropertyReactor&) = delete;
+    PagePropertyReactor& operator=(const PagePropertyReactor&) = delete;
+
+    void OnAboutToBeginPublishing(AcPublishBeginJobInfo* pInfo) override;
+    void OnBeginPublishingSheet(AcPublishSheetInfo* pInfo) override;
+    void OnEndPublish(AcPublishReactorInfo* pInfo) override;
+    void OnCancelledOrFailedPublishing(AcPublishReactorInfo* pInfo) override;
+
+    /// <summary>
+    /// Pages of the last job that were given properties.
+    /// </summary>
+    size_t emittedPageCount() const { return m_emittedPages; }
+
+    const PagePropertyEmitter& emitter() const { return m_emitter; }
+
+private:
+    class SheetReactor : public AcDMMReactor
+    {
+    public:
+        explicit SheetReactor(PagePropertyReactor& owner) : m_owner(owner) {}
+        void OnEndSheet(AcDMMSheetReactorInfo* pInfo) override;
+
+    private:
+        PagePropertyReactor& m_owner;
+    };
+
+    void endJob();
+
+    ACGLOBADDDMMREACTOR             m_addDmmReactor;
+    ACGLOBREMOVEDMMREACTOR          m_removeDmmReactor;
+    SheetReactor                    m_sheetReactor;
+    bool                            m_sheetReactorAdded;
+    AcPlDSDEntries                  m_entries;
+    std::vector<PagePropertySet>    m_sheets;       // by DSD entry
+    std::vector<unsigned char>      m_begun;        // by DSD entry, so that repeated entries are told apart
+    int                             m_currentSheet; // being published, or -1
+    PagePropertyEmitter             m_emitter;
+    size_t                          m_emittedPages;
+};
+
+} // namespace acad_sheetset_to_pdf
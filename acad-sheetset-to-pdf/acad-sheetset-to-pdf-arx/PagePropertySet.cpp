@@ -0,0 +1,268 @@
+#include "stdafx.h"
+#include "PagePropertySet.h"
+
+namespace acad_sheetset_to_pdf {
+
+/* PagePropertyTemplate ---------------------------------------------------- */
+
+Acad::ErrorStatus PagePropertyTemplate::create(const std::vector<PagePropertyDefinition>& properties,
+                                               const std::vector<PageResourceDefinition>& resources,
+                                               std::shared_ptr<const PagePropertyTemplate>& pTemplate)
+{
+    pTemplate.reset();
+    std::shared_ptr<PagePropertyTemplate> pNew(new PagePropertyTemplate());
+    pNew->m_properties = properties;
+    pNew->m_resources = resources;
+    pNew->m_byName.reserve(properties.size());
+    for (size_t i = 0; i < properties.size(); ++i)
+    {
+        if (properties[i].name.empty())
+            return Acad::eInvalidInput;
+        if (!pNew->m_byName.emplace(properties[i].name, static_cast<int>(i)).second)
+            return Acad::eDuplicateKey;
+    }
+    pTemplate = std::move(pNew);
+    return Acad::eOk;
+}
+
+int PagePropertyTemplate::find(const ACHAR* name) const
+{
+    if (name == nullptr)
+        return kNotFound;
+    const auto it = m_byName.find(name);
+    return it != m_byName.end() ? it->second : kNotFound;
+}
+
+/* PagePropertySet --------------------------------------------------------- */
+
+namespace {
+
+struct OverrideIndexLess
+{
+    template <class T>
+    bool operator()(const T& override, int index) const { return override.index < index; }
+};
+
+} // namespace
+
+PagePropertySet::PagePropertySet()
+{
+}
+
+PagePropertySet::PagePropertySet(const std::shared_ptr<const PagePropertyTemplate>& pTemplate)
+    : m_pTemplate(pTemplate)
+{
+}
+
+PagePropertySet::Overrides& PagePropertySet::writableOverrides()
+{
+    if (!m_pOverrides)
+        m_pOverrides = std::make_shared<Overrides>();
+    else if (m_pOverrides.use_count() > 1)
+        m_pOverrides = std::make_shared<Overrides>(*m_pOverrides);
+    return *m_pOverrides;
+}
+
+const ACHAR* PagePropertySet::value(int index) const
+{
+    if (!m_pTemplate || index < 0 || index >= m_pTemplate->size())
+        return nullptr;
+    if (m_pOverrides)
+    {
+        const auto it = std::lower_bound(m_pOverrides->begin(), m_pOverrides->end(), index, OverrideIndexLess());
+        if (it != m_pOverrides->end() && it->index == index)
+            return it->value.c_str();
+    }
+    return m_pTemplate->property(index).value.c_str();
+}
+
+Acad::ErrorStatus PagePropertySet::setValue(int index, const ACHAR* value)
+{
+    if (!m_pTemplate)
+        return Acad::eNotInitializedYet;
+    if (index < 0 || index >= m_pTemplate->size())
+        return Acad::eInvalidIndex;
+    if (value == nullptr)
+        value = L"";
+
+    /* Look before writing, so that setting the value a copy already has
+    does not unshare the overrides. */
+    const ACHAR* pCurrent = this->value(index);
+    if (std::wcscmp(pCurrent, value) == 0)
+        return Acad::eOk;
+    if (m_pTemplate->property(index).value == value)
+    {
+        resetValue(index);
+        return Acad::eOk;
+    }
+
+    Overrides& overrides = writableOverrides();
+    const auto it = std::lower_bound(overrides.begin(), overrides.end(), index, OverrideIndexLess());
+    if (it != overrides.end() && it->index == index)
+        it->value = value;
+    else
+        overrides.insert(it, Override{index, value});
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus PagePropertySet::setValue(const ACHAR* name, const ACHAR* value)
+{
+    if (!m_pTemplate)
+        return Acad::eNotInitializedYet;
+    const int index = m_pTemplate->find(name);
+    return index != PagePropertyTemplate::kNotFound ? setValue(index, value) : Acad::eKeyNotFound;
+}
+
+int PagePropertySet::setValues(const AcNameValuePairVec& values)
+{
+    int missing = 0;
+    for (int i = 0; i < values.length(); ++i)
+    {
+        if (setValue(values[i].name(), values[i].value()) != Acad::eOk)
+            ++missing;
+    }
+    return missing;
+}
+
+void PagePropertySet::resetValue(int index)
+{
+    if (!m_pOverrides)
+        return;
+    const auto it = std::lower_bound(m_pOverrides->begin(), m_pOverrides->end(), index, OverrideIndexLess());
+    if (it == m_pOverrides->end() || it->index != index)
+        return;
+    const ptrdiff_t position = it - m_pOverrides->begin();
+    Overrides& overrides = writableOverrides();
+    overrides.erase(overrides.begin() + position);
+}
+
+void PagePropertySet::resetAll()
+{
+    m_pOverrides.reset();
+}
+
+/* PagePropertyEmitter ----------------------------------------------------- */
+
+namespace {
+
+void assignValue(AcDMMEPlotProperty& property, const std::wstring& value, Adesk::UInt64& updates)
+{
+    const wchar_t* pCurrent = property.GetValue();
+    if (std::wcscmp(pCurrent != nullptr ? pCurrent : L"", value.c_str()) == 0)
+        return;
+    property.SetValue(value.c_str());
+    ++updates;
+}
+
+} // namespace
+
+PagePropertyEmitter::PagePropertyEmitter(size_t maxTemplates)
+    : m_maxTemplates(std::max<size_t>(maxTemplates, 1))
+    , m_uses(0)
+    , m_builds(0)
+    , m_valueUpdates(0)
+{
+}
+
+void PagePropertyEmitter::clear()
+{
+    m_slots.clear();
+}
+
+PagePropertyEmitter::Slot& PagePropertyEmitter::slot(const std::shared_ptr<const PagePropertyTemplate>& pTemplate)
+{
+    ++m_uses;
+    for (const std::unique_ptr<Slot>& pSlot : m_slots)
+    {
+        if (pSlot->pTemplate == pTemplate)
+        {
+            pSlot->lastUse = m_uses;
+            return *pSlot;
+        }
+    }
+
+    std::unique_ptr<Slot> pSlot(new Slot());
+    pSlot->pTemplate = pTemplate;
+    pSlot->lastUse = m_uses;
+    const PagePropertyTemplate& propertyTemplate = *pTemplate;
+    pSlot->properties.setPhysicalLength(propertyTemplate.size());
+    for (int i = 0; i < propertyTemplate.size(); ++i)
+    {
+        const PagePropertyDefinition& definition = propertyTemplate.property(i);
+        AcDMMEPlotProperty property(definition.name.c_str(), definition.value.c_str());
+        if (!definition.category.empty())
+            property.SetCategory(definition.category.c_str());
+        if (!definition.type.empty())
+            property.SetType(definition.type.c_str());
+        if (!definition.units.empty())
+            property.SetUnits(definition.units.c_str());
+        pSlot->properties.append(property);
+    }
+    for (const PageResourceDefinition& resource : propertyTemplate.resources())
+        pSlot->resources.append(AcDMMResourceInfo(resource.role.c_str(), resource.mime.c_str(), resource.path.c_str()));
+    ++m_builds;
+
+    if (m_slots.size() < m_maxTemplates)
+    {
+        m_slots.push_back(std::move(pSlot));
+        return *m_slots.back();
+    }
+    auto oldest = std::min_element(m_slots.begin(), m_slots.end(),
+                                   [](const std::unique_ptr<Slot>& a, const std::unique_ptr<Slot>& b)
+                                   { return a->lastUse < b->lastUse; });
+    *oldest = std::move(pSlot);
+    return **oldest;
+}
+
+const AcDMMEPlotPropertyVec& PagePropertyEmitter::properties(const PagePropertySet& set)
+{
+    if (!set.m_pTemplate)
+        return m_empty;
+    Slot& current = slot(set.m_pTemplate);
+    const PagePropertyTemplate& propertyTemplate = *current.pTemplate;
+
+    /* Walk the indices the vector holds a sheet's value at and the indices
+    the set overrides side by side, both being sorted: the first get their
+    default back unless the set overrides them too, the second get the set's
+    value. */
+    static const PagePropertySet::Overrides kNoOverrides;
+    const PagePropertySet::Overrides& overrides = set.m_pOverrides ? *set.m_pOverrides : kNoOverrides;
+    const std::vector<int>& overridden = current.overridden;
+    std::vector<int>& merged = m_merged;
+    merged.clear();
+    size_t previous = 0;
+    size_t next = 0;
+    while (previous < overridden.size() || next < overrides.size())
+    {
+        if (next == overrides.size() || (previous < overridden.size() && overridden[previous] < overrides[next].index))
+        {
+            const int index = overridden[previous++];
+            assignValue(current.properties[index], propertyTemplate.property(index).value, m_valueUpdates);
+            continue;
+        }
+        if (previous < overridden.size() && overridden[previous] == overrides[next].index)
+            ++previous;
+        const PagePropertySet::Override& override = overrides[next++];
+        assignValue(current.properties[override.index], override.value, m_valueUpdates);
+        merged.push_back(override.index);
+    }
+
+    /* The two lists trade places, so neither is allocated again once both
+    have grown to the largest number of overrides. */
+    current.overridden.swap(merged);
+    return current.properties;
+}
+
+void PagePropertyEmitter::emit(const PagePropertySet& set, AcDMMSheetReactorInfo& info)
+{
+    if (!set.m_pTemplate)
+        return;
+    const AcDMMEPlotPropertyVec& properties = this->properties(set);
+    if (!properties.isEmpty())
+        info.AddPageProperties(properties);
+    const Slot& current = slot(set.m_pTemplate);
+    if (!current.resources.isEmpty())
+        info.AddPageResources(current.resources);
+}
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <unordered_map>
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// A page property as AcDMMEPlotProperty describes it, with the value it
+/// has unless a sheet overrides it.  Empty category, type and units are left
+/// unset.
+/// </summary>
+struct PagePropertyDefinition
+{
+    std::wstring name;
+    std::wstring value;
+    std::wstring category;
+    std::wstring type;
+    std::wstring units;
+};
+
+/// <summary>
+/// A file added to every page, as AcDMMResourceInfo describes it.
+/// </summary>
+struct PageResourceDefinition
+{
+    std::wstring role;
+    std::wstring mime;
+    std::wstring path;
+};
+
+/// <summary>
+/// The page properties and resources that the sheets of a job have in
+/// common, such as the title block fields and the sheet set's properties,
+/// in the order they are emitted.
+///
+/// A template never changes once created and is shared, through
+/// std::shared_ptr, by every PagePropertySet made from it, so any number of
+/// threads may read it.
+/// </summary>
+class PagePropertyTemplate
+{
+public:
+    enum { kNotFound = -1 };
+
+    /// <summary>
+    /// Creates a template.  Returns Acad::eDuplicateKey if two properties
+    /// have the same name and Acad::eInvalidInput if one has none.
+    /// </summary>
+    static Acad::ErrorStatus create(const std::vector<PagePropertyDefinition>& properties,
+                                    const std::vector<PageResourceDefinition>& resources,
+                                    std::shared_ptr<const PagePropertyTemplate>& pTemplate);
+
+    PagePropertyTemplate(const PagePropertyTemplate&) = delete;
+    PagePropertyTemplate& operator=(const PagePropertyTemplate&) = delete;
+
+    int size() const { return static_cast<int>(m_properties.size()); }
+    const PagePropertyDefinition& property(int index) const { return m_properties[size_t(index)]; }
+    const std::vector<PageResourceDefinition>& resources() const { return m_resources; }
+
+    /// <summary>
+    /// Index of the property called name, or kNotFound.  Names are case
+    /// sensitive, as in the DWF page descriptor.
+    /// </summary>
+    int find(const ACHAR* name) const;
+
+private:
+    PagePropertyTemplate() {}
+
+    std::vector<PagePropertyDefinition>     m_properties;
+    std::vector<PageResourceDefinition>     m_resources;
+    std::unordered_map<std::wstring, int>   m_byName;
+};
+
+/// <summary>
+/// The page properties of one sheet: a template and the values in which the
+/// sheet differs from it.
+///
+/// Only the overridden values are stored, sorted by property index.  Copies
+/// of a set share them until one of the copies is changed, so a set built
+/// for a group of sheets can be copied for each sheet and adjusted for
+/// little more than the values that actually differ.  Setting a value back
+/// to the template's drops the override.
+/// </summary>
+class PagePropertySet
+{
+public:
+    PagePropertySet();
+    explicit PagePropertySet(const std::shared_ptr<const PagePropertyTemplate>& pTemplate);
+
+    const std::shared_ptr<const PagePropertyTemplate>& propertyTemplate() const { return m_pTemplate; }
+
+    /// <summary>
+    /// Value of the property at index, the sheet's own or the template's.
+    /// </summary>
+    const ACHAR* value(int index) const;
+
+    Acad::ErrorStatus setValue(int index, const ACHAR* value);
+
+    /// <summary>
+    /// Returns Acad::eKeyNotFound if the template has no property called
+    /// name.
+    /// </summary>
+    Acad::ErrorStatus setValue(const ACHAR* name, const ACHAR* value);
+
+    /// <summary>
+    /// Sets every property of the template that values names, such as the
+    /// metadata PublishMetadataReactor wrote for the sheet, and returns how
+    /// many of values the template does not have.
+    /// </summary>
+    int setValues(const AcNameValuePairVec& values);
+
+    void resetValue(int index);
+    void resetAll();
+
+    int overrideCount() const { return m_pOverrides ? static_cast<int>(m_pOverrides->size()) : 0; }
+
+private:
+    friend class PagePropertyEmitter;
+
+    struct Override
+    {
+        int          index;
+        std::wstring value;
+    };
+    typedef std::vector<Override> Overrides;
+
+    Overrides& writableOverrides();
+
+    std::shared_ptr<const PagePropertyTemplate> m_pTemplate;
+    std::shared_ptr<Overrides>                  m_pOverrides;   // shared by copies until written to
+};
+
+/// <summary>
+/// Hands PagePropertySets to AcDMMSheetReactorInfo::AddPageProperties and
+/// AddPageResources without building the property vectors again for every
+/// sheet.
+///
+/// The emitter keeps one AcDMMEPlotPropertyVec per template, built the
+/// first time the template is emitted, and the indices of the properties it
+/// last set to a sheet's own value.  Emitting the next sheet compares the
+/// two sparse override lists and calls SetValue only where the value
+/// actually changes, so a sheet costs a few string copies instead of a
+/// vector of properties with five strings each.  The resources of a
+/// template are built once as well.
+///
+/// AddPageProperties takes its vector by value, so AutoCAD still copies
+/// the vector on every call; that copy is AutoCAD's and is the same either
+/// way.  An emitter is meant for one publishing thread.
+/// </summary>
+class PagePropertyEmitter
+{
+public:
+    /// <summary>
+    /// Templates whose vectors are kept.  Emitting one more drops the one
+    /// emitted longest ago.
+    /// </summary>
+    explicit PagePropertyEmitter(size_t maxTemplates = 8);
+
+    PagePropertyEmitter(const PagePropertyEmitter&) = delete;
+    PagePropertyEmitter& operator=(const PagePropertyEmitter&) = delete;
+
+    /// <summary>
+    /// Adds the properties of set, and the resources of its template, to
+    /// the page info is about.
+    /// </summary>
+    void emit(const PagePropertySet& set, AcDMMSheetReactorInfo& info);
+
+    /// <summary>
+    /// The property vector of set, valid until the next call.  Returns an
+    /// empty vector for a set without a template.
+    /// </summary>
+    const AcDMMEPlotPropertyVec& properties(const PagePropertySet& set);
+
+    void clear();
+
+    Adesk::UInt64 buildCount() const { return m_builds; }           // property vectors built
+    Adesk::UInt64 valueUpdateCount() const { return m_valueUpdates; }   // SetValue calls made by diffs
+
+private:
+    struct Slot
+    {
+        std::shared_ptr<const PagePropertyTemplate> pTemplate;
+        AcDMMEPlotPropertyVec                       properties;
+        AcDMMResourceVec                            resources;
+        std::vector<int>                            overridden;     // indices holding a sheet's own value
+        Adesk::UInt64                               lastUse = 0;
+    };
+
+    Slot& slot(const std::shared_ptr<const PagePropertyTemplate>& pTemplate);
+
+    size_t                              m_maxTemplates;
+    std::vector<std::unique_ptr<Slot>>  m_slots;
+    AcDMMEPlotPropertyVec               m_empty;
+    std::vector<int>                    m_merged;       // scratch for properties()
+    Adesk::UInt64                       m_uses;
+    Adesk::UInt64                       m_builds;
+    Adesk::UInt64                       m_valueUpdates;
+};
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,245 @@
+#include "stdafx.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace acad_sheetset_to_pdf {
+
+unsigned defaultThreadCount()
+{
+    const unsigned hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads > 0 ? hardwareThreads : 1;
+}
+
+namespace {
+
+/* One parallelFor call.  It lives on the caller's stack, which waits until
+every worker it handed to the pool has left it. */
+struct Loop
+{
+    Loop(size_t itemCount, unsigned workerCount,
+         const std::function<void(size_t index, unsigned worker)>& loopBody)
+        : count(itemCount)
+        , body(loopBody)
+        , nextIndex(0)
+        , stopped(false)
+        , completedCount(0)
+        , runningWorkers(workerCount)
+    {
+    }
+
+    void work(unsigned workerIndex);
+
+    const size_t                                            count;
+    const std::function<void(size_t index, unsigned worker)>& body;
+    std::atomic<size_t>                                     nextIndex;
+    std::atomic<bool>                                       stopped;
+    std::mutex                                              mutex;
+    std::condition_variable                                 completion;
+    size_t                                                  completedCount;
+    unsigned                                                runningWorkers;
+    std::exception_ptr                                      pFirstException;
+};
+
+void Loop::work(unsigned workerIndex)
+{
+    for (;;)
+    {
+        if (stopped.load(std::memory_order_relaxed))
+            break;
+        const size_t index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+        if (index >= count)
+            break;
+        try
+        {
+            body(index, workerIndex);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!pFirstException)
+                pFirstException = std::current_exception();
+            stopped = true;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++completedCount;
+        }
+        completion.notify_one();
+    }
+
+    /* The caller may return, and the loop go away, as soon as the lock is
+    released, so notify while holding it. */
+    std::lock_guard<std::mutex> lock(mutex);
+    --runningWorkers;
+    completion.notify_one();
+}
+
+/* The threads parallelFor runs loops on.  A loop hands the pool one ticket
+per worker it wants; an idle thread takes a ticket and works on the loop
+until it runs out of items.  There are always at least as many idle threads
+as waiting tickets, starting threads if need be, so a ticket is never left
+waiting for a thread that is busy with another loop. */
+class WorkerPool
+{
+public:
+    static WorkerPool& instance()
+    {
+        static WorkerPool pool;
+        return pool;
+    }
+
+    ~WorkerPool()
+    {
+        stop();
+    }
+
+    void submit(Loop& loop, unsigned workerCount)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            try
+            {
+                for (unsigned i = 0; i < workerCount; ++i)
+                    m_tickets.push_back(Ticket{ &loop, i });
+
+                /* A thread counts as idle from the moment it is started. */
+                while (m_idleThreads < m_tickets.size())
+                {
+                    m_threads.reserve(m_threads.size() + 1);
+                    m_threads.emplace_back([this] { threadLoop(); });
+                    ++m_idleThreads;
+                }
+            }
+            catch (...)
+            {
+                /* No thread can have taken a ticket yet: that needs the lock. */
+                m_tickets.erase(std::remove_if(m_tickets.begin(), m_tickets.end(),
+                                               [&](const Ticket& ticket) { return ticket.pLoop == &loop; }),
+                                m_tickets.end());
+                throw;
+            }
+        }
+        if (workerCount == 1)
+            m_ticketQueued.notify_one();
+        else
+            m_ticketQueued.notify_all();
+    }
+
+    void stop()
+    {
+        std::vector<std::thread> threads;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+            threads.swap(m_threads);
+        }
+        m_ticketQueued.notify_all();
+        for (std::thread& thread : threads)
+            thread.join();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = false;
+        m_idleThreads = 0;
+    }
+
+private:
+    struct Ticket
+    {
+        Loop*    pLoop;
+        unsigned worker;
+    };
+
+    WorkerPool()
+        : m_idleThreads(0)
+        , m_stopping(false)
+    {
+    }
+
+    void threadLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_ticketQueued.wait(lock, [&] { return !m_tickets.empty() || m_stopping; });
+            if (m_tickets.empty())
+                return;
+            const Ticket ticket = m_tickets.front();
+            m_tickets.pop_front();
+            --m_idleThreads;
+            lock.unlock();
+            ticket.pLoop->work(ticket.worker);
+            lock.lock();
+            ++m_idleThreads;
+        }
+    }
+
+    std::mutex               m_mutex;
+    std::condition_variable  m_ticketQueued;
+    std::deque<Ticket>       m_tickets;
+    std::vector<std::thread> m_threads;
+    size_t                   m_idleThreads;
+    bool                     m_stopping;
+};
+
+} // namespace
+
+bool parallelFor(size_t count,
+                 unsigned threadCount,
+                 const std::function<void(size_t index, unsigned worker)>& body,
+                 const std::function<bool(size_t completedCount)>& onCompleted)
+{
+    if (count == 0)
+        return true;
+    if (threadCount == 0)
+        threadCount = defaultThreadCount();
+    threadCount = static_cast<unsigned>(std::min<size_t>(threadCount, count));
+
+    Loop loop(count, threadCount, body);
+    WorkerPool::instance().submit(loop, threadCount);
+
+    bool cancelled = false;
+    size_t reportedCount = 0;
+    {
+        std::unique_lock<std::mutex> lock(loop.mutex);
+        for (;;)
+        {
+            loop.completion.wait(lock, [&]
+            {
+                return loop.completedCount != reportedCount || loop.runningWorkers == 0;
+            });
+            const size_t snapshot = loop.completedCount;
+            const bool finished = loop.runningWorkers == 0;
+            if (snapshot != reportedCount && onCompleted && !cancelled)
+            {
+                // Never call back into the caller's code with our lock held.
+                lock.unlock();
+                if (!onCompleted(snapshot))
+                {
+                    cancelled = true;
+                    loop.stopped = true;
+                }
+                lock.lock();
+            }
+            reportedCount = snapshot;
+            if (finished && loop.completedCount == reportedCount)
+                break;
+        }
+    }
+
+    if (loop.pFirstException)
+        std::rethrow_exception(loop.pFirstException);
+    return !cancelled;
+}
+
+void stopWorkerThreads()
+{
+    WorkerPool::instance().stop();
+}
+
+} // namespace acad_sheetset_to_pdf
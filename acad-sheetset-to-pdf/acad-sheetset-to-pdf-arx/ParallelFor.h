@@ -0,0 +1,47 @@
+#pragma once
+
+#include <functional>
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// Number of worker threads to use when the caller asked for 0 ("as many as
+/// the machine has").
+/// </summary>
+unsigned defaultThreadCount();
+
+/// <summary>
+/// Runs body(index, worker) for every index in [0, count) on threadCount
+/// worker threads, handing out indices one at a time so uneven work items
+/// balance themselves.  worker is in [0, threadCount) and identifies the
+/// thread, for indexing per-thread scratch space.
+///
+/// The threads come from a pool shared by every call and are kept between
+/// calls, so a loop costs a wakeup per thread rather than a thread start.
+/// The pool grows to the most threads ever busy at once, so calls from
+/// several threads, and calls from inside a body, never wait for each
+/// other's threads.
+///
+/// The calling thread does not run items itself.  It waits for completions
+/// and calls onCompleted(completedCount) after each one (several completions
+/// may be folded into one call), which makes it the right place to drive
+/// progress UI that must stay on the calling thread.  If onCompleted returns
+/// false no further items are started, the items already running are allowed
+/// to finish, and parallelFor returns false.
+///
+/// An exception thrown by body stops the loop the same way and is rethrown
+/// on the calling thread once all workers have exited.
+/// </summary>
+bool parallelFor(size_t count,
+                 unsigned threadCount,
+                 const std::function<void(size_t index, unsigned worker)>& body,
+                 const std::function<bool(size_t completedCount)>& onCompleted = nullptr);
+
+/// <summary>
+/// Stops the pool threads parallelFor keeps between calls and waits for them
+/// to exit.  Called when the module unloads, with no parallelFor running;
+/// a later parallelFor starts threads again.
+/// </summary>
+void stopWorkerThreads();
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,1257 @@
+#include "stdafx.h"
+#include "PdfFragmentAssembler.h"
+#include "AtomicFile.h"
+#include "Inflate.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <unordered_map>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+/* Most that one object or cross-reference stream may decompress to, most
+objects a fragment may number, and deepest that arrays and dictionaries may
+nest, so that a damaged file cannot run away with memory or the stack. */
+const size_t kMaxDecodedSize = 256 * 1024 * 1024;
+const size_t kMaxObjectNumber = 8 * 1024 * 1024;
+const int kMaxNesting = 64;
+const int kMaxLookupDepth = 8;
+const size_t kWriteBufferSize = 1024 * 1024;
+const Adesk::UInt32 kPending = ~Adesk::UInt32(0);
+
+bool isWhite(Adesk::UInt8 c)
+{
+    return c == 0 || c == '\t' || c == '\n' || c == '\f' || c == '\r' || c == ' ';
+}
+
+bool isDelimiter(Adesk::UInt8 c)
+{
+    switch (c)
+    {
+    case '(': case ')': case '<': case '>': case '[': case ']': case '{': case '}': case '/': case '%':
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool isRegular(Adesk::UInt8 c)
+{
+    return !isWhite(c) && !isDelimiter(c);
+}
+
+/* Where text first occurs in pData from position on, or size. */
+size_t find(const Adesk::UInt8* pData, size_t size, size_t position, const char* text)
+{
+    const size_t length = std::strlen(text);
+    for (; position + length <= size; ++position)
+    {
+        const void* pFirst = std::memchr(pData + position, text[0], size - length + 1 - position);
+        if (pFirst == nullptr)
+            break;
+        position = size_t(static_cast<const Adesk::UInt8*>(pFirst) - pData);
+        if (std::memcmp(pData + position, text, length) == 0)
+            return position;
+    }
+    return size;
+}
+
+/// <summary>
+/// A PDF object as read from a file.  Strings keep their delimiters and
+/// escapes, and numbers their text, since they are only ever copied.
+/// </summary>
+struct PdfValue
+{
+    enum Kind
+    {
+        kNull,
+        kBoolean,
+        kNumber,
+        kString,
+        kName,
+        kArray,
+        kDictionary,
+        kReference
+    };
+
+    Kind                  kind = kNull;
+    std::string           text;         // of a boolean, number or string, or a name without its slash
+    Adesk::UInt32         number = 0;   // of a reference
+    std::vector<PdfValue> items;        // of an array, or a dictionary's keys and values in turn
+
+    const PdfValue* find(const char* key) const
+    {
+        if (kind != kDictionary)
+            return nullptr;
+        for (size_t i = 0; i + 1 < items.size(); i += 2)
+        {
+            if (items[i].text == key)
+                return &items[i + 1];
+        }
+        return nullptr;
+    }
+
+    void set(const char* key, PdfValue value)
+    {
+        for (size_t i = 0; i + 1 < items.size(); i += 2)
+        {
+            if (items[i].text == key)
+            {
+                items[i + 1] = std::move(value);
+                return;
+            }
+        }
+        items.push_back(name(key));
+        items.push_back(std::move(value));
+    }
+
+    bool isName(const char* value) const { return kind == kName && text == value; }
+
+    /* A whole number, without a sign or a fraction. */
+    bool unsignedInteger(Adesk::UInt64& value) const
+    {
+        if (kind != kNumber || text.empty() || text.size() > 19)
+            return false;
+        value = 0;
+        for (const char c : text)
+        {
+            if (c < '0' || c > '9')
+                return false;
+            value = value * 10 + Adesk::UInt64(c - '0');
+        }
+        return true;
+    }
+
+    static PdfValue name(const char* value)
+    {
+        PdfValue result;
+        result.kind = kName;
+        result.text = value;
+        return result;
+    }
+
+    static PdfValue integer(Adesk::UInt64 value)
+    {
+        PdfValue result;
+        result.kind = kNumber;
+        result.text = std::to_string(value);
+        return result;
+    }
+
+    static PdfValue reference(Adesk::UInt32 number)
+    {
+        PdfValue result;
+        result.kind = kReference;
+        result.number = number;
+        return result;
+    }
+};
+
+/// <summary>
+/// Reads tokens and objects from PDF data.
+/// </summary>
+class PdfParser
+{
+public:
+    PdfParser(const Adesk::UInt8* pData, size_t size) : m_pData(pData), m_size(size), m_position(0) {}
+
+    size_t position() const { return m_position; }
+    void seek(size_t position) { m_position = std::min(position, m_size); }
+
+    void skipSpace()
+    {
+        while (m_position < m_size)
+        {
+            if (m_pData[m_position] == '%')
+            {
+                while (m_position < m_size && m_pData[m_position] != '\r' && m_pData[m_position] != '\n')
+                    ++m_position;
+            }
+            else if (isWhite(m_pData[m_position]))
+                ++m_position;
+            else
+                break;
+        }
+    }
+
+    /* Consumes word if it is the next token. */
+    bool keyword(const char* word)
+    {
+        skipSpace();
+        const size_t length = std::strlen(word);
+        if (m_size - m_position < length || std::memcmp(m_pData + m_position, word, length) != 0 ||
+            (m_position + length < m_size && isRegular(m_pData[m_position + length])))
+            return false;
+        m_position += length;
+        return true;
+    }
+
+    /* Consumes a whole number without a sign if it is the next token. */
+    bool unsignedInteger(Adesk::UInt64& value)
+    {
+        skipSpace();
+        size_t end = m_position;
+        value = 0;
+        while (end < m_size && end - m_position < 19 && m_pData[end] >= '0' && m_pData[end] <= '9')
+            value = value * 10 + Adesk::UInt64(m_pData[end++] - '0');
+        if (end == m_position || (end < m_size && isRegular(m_pData[end])))
+            return false;
+        m_position = end;
+        return true;
+    }
+
+    Acad::ErrorStatus value(PdfValue& value, int depth = 0)
+    {
+        value = PdfValue();
+        skipSpace();
+        if (m_position == m_size || depth > kMaxNesting)
+            return Acad::eInvalidInput;
+
+        const Adesk::UInt8 c = m_pData[m_position];
+        if (c == '/')
+        {
+            ++m_position;
+            value.kind = PdfValue::kName;
+            value.text = token();
+            return Acad::eOk;
+        }
+        if (c == '(')
+            return literalString(value);
+        if (c == '<' && m_position + 1 < m_size && m_pData[m_position + 1] == '<')
+            return dictionary(value, depth);
+        if (c == '<')
+        {
+            const size_t start = m_position;
+            while (m_position < m_size && m_pData[m_position] != '>')
+                ++m_position;
+            if (m_position == m_size)
+                return Acad::eInvalidInput;
+            ++m_position;
+            value.kind = PdfValue::kString;
+            value.text.assign(reinterpret_cast<const char*>(m_pData + start), m_position - start);
+            return Acad::eOk;
+        }
+        if (c == '[')
+            return array(value, depth);
+        if (isDelimiter(c))
+            return Acad::eInvalidInput;
+
+        value.text = token();
+        if (value.text == "true" || value.text == "false")
+        {
+            value.kind = PdfValue::kBoolean;
+            return Acad::eOk;
+        }
+        if (value.text == "null")
+        {
+            value.text.clear();
+            return Acad::eOk;
+        }
+        if (value.text.find_first_not_of("+-.0123456789") != std::string::npos ||
+            value.text.find_first_of("0123456789") == std::string::npos)
+            return Acad::eInvalidInput;
+        value.kind = PdfValue::kNumber;
+
+        /* "n g R" is a reference, which only shows after its first number. */
+        Adesk::UInt64 number, generation;
+        if (value.unsignedInteger(number) && number <= 0xFFFFFFFF)
+        {
+            const size_t after = m_position;
+            if (unsignedInteger(generation) && keyword("R"))
+                value = PdfValue::reference(Adesk::UInt32(number));
+            else
+                m_position = after;
+        }
+        return Acad::eOk;
+    }
+
+private:
+    std::string token()
+    {
+        const size_t start = m_position;
+        while (m_position < m_size && isRegular(m_pData[m_position]))
+            ++m_position;
+        return std::string(reinterpret_cast<const char*>(m_pData + start), m_position - start);
+    }
+
+    Acad::ErrorStatus literalString(PdfValue& value)
+    {
+        const size_t start = m_position++;
+        int nesting = 1;
+        while (m_position < m_size && nesting > 0)
+        {
+            const Adesk::UInt8 c = m_pData[m_position++];
+            if (c == '\\')
+                m_position = std::min(m_position + 1, m_size);
+            else if (c == '(')
+                ++nesting;
+            else if (c == ')')
+                --nesting;
+        }
+        if (nesting != 0)
+            return Acad::eInvalidInput;
+        value.kind = PdfValue::kString;
+        value.text.assign(reinterpret_cast<const char*>(m_pData + start), m_position - start);
+        return Acad::eOk;
+    }
+
+    Acad::ErrorStatus dictionary(PdfValue& value, int depth)
+    {
+        m_position += 2;
+        value.kind = PdfValue::kDictionary;
+        for (;;)
+        {
+            skipSpace();
+            if (m_size - m_position >= 2 && m_pData[m_position] == '>' && m_pData[m_position + 1] == '>')
+            {
+                m_position += 2;
+                return Acad::eOk;
+            }
+            PdfValue key, item;
+            Acad::ErrorStatus es = this->value(key, depth + 1);
+            if (es == Acad::eOk && key.kind != PdfValue::kName)
+                es = Acad::eInvalidInput;
+            if (es == Acad::eOk)
+                es = this->value(item, depth + 1);
+            if (es != Acad::eOk)
+                return es;
+            value.items.push_back(std::move(key));
+            value.items.push_back(std::move(item));
+        }
+    }
+
+    Acad::ErrorStatus array(PdfValue& value, int depth)
+    {
+        ++m_position;
+        value.kind = PdfValue::kArray;
+        for (;;)
+        {
+            skipSpace();
+            if (m_position < m_size && m_pData[m_position] == ']')
+            {
+                ++m_position;
+                return Acad::eOk;
+            }
+            PdfValue item;
+            const Acad::ErrorStatus es = this->value(item, depth + 1);
+            if (es != Acad::eOk)
+                return es;
+            value.items.push_back(std::move(item));
+        }
+    }
+
+    const Adesk::UInt8* m_pData;
+    size_t              m_size;
+    size_t              m_position;
+};
+
+/* Undoes the PNG predictors that cross-reference streams are usually
+written with: every row starts with a byte naming how it was predicted from
+the bytes to its left and above. */
+Acad::ErrorStatus unpredictPng(std::vector<Adesk::UInt8>& data, Adesk::UInt64 columns, Adesk::UInt64 colors,
+                               Adesk::UInt64 bitsPerComponent)
+{
+    if (columns == 0 || colors == 0 || bitsPerComponent == 0 || columns * colors * bitsPerComponent > 1 << 24)
+        return Acad::eInvalidInput;
+    const size_t pixelSize = std::max<size_t>(1, size_t(colors * bitsPerComponent + 7) / 8);
+    const size_t rowSize = size_t(columns * colors * bitsPerComponent + 7) / 8;
+
+    std::vector<Adesk::UInt8> result;
+    result.reserve(data.size());
+    std::vector<Adesk::UInt8> previous(rowSize, 0);
+    std::vector<Adesk::UInt8> row(rowSize);
+    for (size_t position = 0; position + 1 + rowSize <= data.size(); position += 1 + rowSize)
+    {
+        const Adesk::UInt8 predictor = data[position];
+        const Adesk::UInt8* pRaw = &data[position + 1];
+        for (size_t i = 0; i < rowSize; ++i)
+        {
+            const int left = i >= pixelSize ? row[i - pixelSize] : 0;
+            const int up = previous[i];
+            const int upLeft = i >= pixelSize ? previous[i - pixelSize] : 0;
+            int predicted = 0;
+            switch (predictor)
+            {
+            case 0:
+                break;
+            case 1:
+                predicted = left;
+                break;
+            case 2:
+                predicted = up;
+                break;
+            case 3:
+                predicted = (left + up) / 2;
+                break;
+            case 4:
+            {
+                const int estimate = left + up - upLeft;
+                const int toLeft = std::abs(estimate - left);
+                const int toUp = std::abs(estimate - up);
+                const int toUpLeft = std::abs(estimate - upLeft);
+                predicted = toLeft <= toUp && toLeft <= toUpLeft ? left : toUp <= toUpLeft ? up : upLeft;
+                break;
+            }
+            default:
+                return Acad::eInvalidInput;
+            }
+            row[i] = Adesk::UInt8(pRaw[i] + predicted);
+        }
+        result.insert(result.end(), row.begin(), row.end());
+        previous.swap(row);
+    }
+    data.swap(result);
+    return Acad::eOk;
+}
+
+/// <summary>
+/// An object of a fragment: its value and, if it is a stream, where the
+/// stream's data lies in the file.
+/// </summary>
+struct PdfObject
+{
+    PdfValue            value;
+    const Adesk::UInt8* pStream = nullptr;
+    size_t              streamSize = 0;
+};
+
+/// <summary>
+/// A PDF file, mapped, with its objects read on demand through the
+/// cross-reference sections of all its revisions.
+/// </summary>
+class PdfFragment
+{
+public:
+    PdfFragment() : m_pData(nullptr), m_size(0), m_lookupDepth(0) {}
+
+    Acad::ErrorStatus open(const ACHAR* path);
+
+    const PdfValue& trailer() const { return m_trailer; }
+
+    /* "1.7" from "%PDF-1.7". */
+    std::string version() const
+    {
+        size_t end = 5;
+        while (end < m_size && end < 13 && (std::isdigit(m_pData[end]) || m_pData[end] == '.'))
+            ++end;
+        return std::string(reinterpret_cast<const char*>(m_pData + 5), end - 5);
+    }
+
+    /* The object numbered number, or null if it is free or was never
+    written.  The object stays valid as long as the fragment. */
+    Acad::ErrorStatus object(Adesk::UInt32 number, const PdfObject*& pObject);
+
+    /* value itself, or the object it refers to. */
+    Acad::ErrorStatus resolve(const PdfValue* pValue, const PdfValue*& pResolved)
+    {
+        pResolved = pValue;
+        if (pValue == nullptr || pValue->kind != PdfValue::kReference)
+            return Acad::eOk;
+        const PdfObject* pObject = nullptr;
+        const Acad::ErrorStatus es = object(pValue->number, pObject);
+        pResolved = pObject != nullptr ? &pObject->value : nullptr;
+        return es;
+    }
+
+private:
+    /* type 0 is a free object, 1 one at offset in the file and 2 the index-th
+    of the object stream numbered offset. */
+    struct XrefEntry
+    {
+        Adesk::UInt8  type = kUnset;
+        Adesk::UInt64 offset = 0;
+        Adesk::UInt32 index = 0;
+    };
+    static const Adesk::UInt8 kUnset = 0xFF;
+
+    struct ObjectStream
+    {
+        std::vector<Adesk::UInt8>                           data;
+        std::vector<std::pair<Adesk::UInt64, Adesk::UInt64>> offsets;   // object number, offset after first
+        size_t                                              first = 0;
+    };
+
+    /* Sections are read newest first, so an entry already set stays. */
+    void setEntry(Adesk::UInt64 number, const XrefEntry& entry)
+    {
+        if (number >= kMaxObjectNumber)
+            return;
+        if (number >= m_xref.size())
+            m_xref.resize(size_t(number) + 1);
+        if (m_xref[size_t(number)].type == kUnset)
+            m_xref[size_t(number)] = entry;
+    }
+
+    Acad::ErrorStatus readXrefTable(PdfParser& parser, PdfValue& trailer);
+    Acad::ErrorStatus readXrefStream(size_t offset, PdfValue& trailer);
+    Acad::ErrorStatus readObjectAt(size_t offset, PdfObject& object);
+    Acad::ErrorStatus readObjectFromStream(Adesk::UInt32 streamNumber, Adesk::UInt32 index, Adesk::UInt32 number,
+                                           PdfObject& object);
+    Acad::ErrorStatus decodeStream(const PdfObject& object, std::vector<Adesk::UInt8>& data);
+
+    MappedFile                                         m_file;
+    const Adesk::UInt8*                                m_pData;
+    size_t                                             m_size;
+    PdfValue                                           m_trailer;
+    std::vector<XrefEntry>                             m_xref;
+    std::unordered_map<Adesk::UInt32, PdfObject>       m_objects;
+    std::unordered_map<Adesk::UInt32, ObjectStream>    m_objectStreams;
+    int                                                m_lookupDepth;
+};
+
+Acad::ErrorStatus PdfFragment::open(const ACHAR* path)
+{
+    Acad::ErrorStatus es = m_file.open(path);
+    if (es != Acad::eOk)
+        return es;
+    m_pData = m_file.data();
+    m_size = static_cast<size_t>(m_file.size());
+    if (m_size < 8 || std::memcmp(m_pData, "%PDF-", 5) != 0)
+        return Acad::eUnsupportedFileFormat;
+
+    /* startxref, near the end, points at the newest cross-reference section;
+    each section's /Prev at the one before. */
+    const size_t tail = m_size > 1024 ? m_size - 1024 : 0;
+    size_t startxref = m_size;
+    for (size_t at = find(m_pData, m_size, tail, "startxref"); at != m_size;
+         at = find(m_pData, m_size, at + 1, "startxref"))
+        startxref = at;
+    PdfParser parser(m_pData, m_size);
+    parser.seek(startxref + 9);
+    Adesk::UInt64 offset = 0;
+    if (startxref == m_size || !parser.unsignedInteger(offset))
+        return Acad::eInvalidInput;
+
+    std::vector<Adesk::UInt64> visited;
+    for (;;)
+    {
+        if (offset >= m_size || std::find(visited.begin(), visited.end(), offset) != visited.end())
+            return Acad::eInvalidInput;
+        visited.push_back(offset);
+
+        PdfValue trailer;
+        parser.seek(size_t(offset));
+        es = parser.keyword("xref") ? readXrefTable(parser, trailer) : readXrefStream(size_t(offset), trailer);
+        if (es != Acad::eOk)
+            return es;
+        if (visited.size() == 1)
+            m_trailer = trailer;
+        const PdfValue* pPrevious = trailer.find("Prev");
+        if (pPrevious == nullptr)
+            break;
+        if (!pPrevious->unsignedInteger(offset))
+            return Acad::eInvalidInput;
+    }
+
+    if (m_trailer.find("Encrypt") != nullptr)
+        return Acad::eUnsupportedFileFormat;
+    const PdfValue* pRoot = m_trailer.find("Root");
+    return pRoot != nullptr && pRoot->kind == PdfValue::kReference ? Acad::eOk : Acad::eInvalidInput;
+}
+
+Acad::ErrorStatus PdfFragment::readXrefTable(PdfParser& parser, PdfValue& trailer)
+{
+    std::vector<std::pair<Adesk::UInt64, XrefEntry>> entries;
+    while (!parser.keyword("trailer"))
+    {
+        Adesk::UInt64 first, count;
+        if (!parser.unsignedInteger(first) || !parser.unsignedInteger(count) || count > kMaxObjectNumber)
+            return Acad::eInvalidInput;
+        for (Adesk::UInt64 i = 0; i < count; ++i)
+        {
+            XrefEntry entry;
+            Adesk::UInt64 generation;
+            if (!parser.unsignedInteger(entry.offset) || !parser.unsignedInteger(generation))
+                return Acad::eInvalidInput;
+            if (parser.keyword("n"))
+                entry.type = 1;
+            else if (parser.keyword("f"))
+                entry.type = 0;
+            else
+                return Acad::eInvalidInput;
+            entries.push_back(std::make_pair(first + i, entry));
+        }
+    }
+    Acad::ErrorStatus es = parser.value(trailer);
+    if (es == Acad::eOk && trailer.kind != PdfValue::kDictionary)
+        es = Acad::eInvalidInput;
+    if (es != Acad::eOk)
+        return es;
+
+    /* A file that also has a cross-reference stream for readers that know
+    them lists its compressed objects only there, and as free in the table. */
+    Adesk::UInt64 streamOffset;
+    const PdfValue* pStream = trailer.find("XRefStm");
+    if (pStream != nullptr && pStream->unsignedInteger(streamOffset) && streamOffset < m_size)
+    {
+        PdfValue ignored;
+        es = readXrefStream(size_t(streamOffset), ignored);
+        if (es != Acad::eOk)
+            return es;
+    }
+    for (const std::pair<Adesk::UInt64, XrefEntry>& entry : entries)
+        setEntry(entry.first, entry.second);
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus PdfFragment::readXrefStream(size_t offset, PdfValue& trailer)
+{
+    PdfObject object;
+    Acad::ErrorStatus es = readObjectAt(offset, object);
+    if (es != Acad::eOk)
+        return es;
+    const PdfValue* pType = object.value.find("Type");
+    const PdfValue* pWidths = object.value.find("W");
+    if (object.pStream == nullptr || pType == nullptr || !pType->isName("XRef") || pWidths == nullptr ||
+        pWidths->kind != PdfValue::kArray || pWidths->items.size() != 3)
+        return Acad::eInvalidInput;
+    Adesk::UInt64 widths[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        if (!pWidths->items[i].unsignedInteger(widths[i]) || widths[i] > 8)
+            return Acad::eInvalidInput;
+    }
+
+    std::vector<Adesk::UInt8> data;
+    es = decodeStream(object, data);
+    if (es != Acad::eOk)
+        return es;
+
+    /* /Index lists the numbers the entries are for as first and count
+    pairs, all of them from 0 by default. */
+    std::vector<Adesk::UInt64> ranges;
+    const PdfValue* pIndex = object.value.find("Index");
+    if (pIndex != nullptr && pIndex->kind == PdfValue::kArray)
+    {
+        for (const PdfValue& item : pIndex->items)
+        {
+            Adesk::UInt64 value;
+            if (!item.unsignedInteger(value))
+                return Acad::eInvalidInput;
+            ranges.push_back(value);
+        }
+    }
+    else
+    {
+        Adesk::UInt64 size;
+        const PdfValue* pSize = object.value.find("Size");
+        if (pSize == nullptr || !pSize->unsignedInteger(size))
+            return Acad::eInvalidInput;
+        ranges = {0, size};
+    }
+    if (ranges.size() % 2 != 0)
+        return Acad::eInvalidInput;
+
+    const size_t entrySize = size_t(widths[0] + widths[1] + widths[2]);
+    size_t position = 0;
+    for (size_t range = 0; range < ranges.size(); range += 2)
+    {
+        if (ranges[range + 1] > kMaxObjectNumber)
+            return Acad::eInvalidInput;
+        for (Adesk::UInt64 i = 0; i < ranges[range + 1]; ++i, position += entrySize)
+        {
+            if (data.size() - std::min(data.size(), position) < entrySize)
+                return Acad::eInvalidInput;
+            Adesk::UInt64 fields[3] = {1, 0, 0};
+            const Adesk::UInt8* p = &data[position];
+            for (int field = 0; field < 3; ++field)
+            {
+                if (widths[field] == 0)
+                    continue;
+                fields[field] = 0;
+                for (Adesk::UInt64 byte = 0; byte < widths[field]; ++byte)
+                    fields[field] = (fields[field] << 8) | *p++;
+            }
+            if (fields[0] > 2 || fields[2] > 0xFFFFFFFF)
+                continue;
+            XrefEntry entry;
+            entry.type = Adesk::UInt8(fields[0]);
+            entry.offset = fields[1];
+            entry.index = Adesk::UInt32(fields[2]);
+            setEntry(ranges[range] + i, entry);
+        }
+    }
+    trailer = std::move(object.value);
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus PdfFragment::readObjectAt(size_t offset, PdfObject& object)
+{
+    PdfParser parser(m_pData, m_size);
+    parser.seek(offset);
+    Adesk::UInt64 number, generation;
+    if (!parser.unsignedInteger(number) || !parser.unsignedInteger(generation) || !parser.keyword("obj"))
+        return Acad::eInvalidInput;
+    Acad::ErrorStatus es = parser.value(object.value);
+    if (es != Acad::eOk || !parser.keyword("stream"))
+        return es;
+
+    /* The data starts after the end of the line, which should be CR LF or
+    LF; a lone CR is taken too. */
+    size_t start = parser.position();
+    if (start < m_size && m_pData[start] == '\r')
+        ++start;
+    if (start < m_size && m_pData[start] == '\n')
+        ++start;
+
+    size_t length = m_size;
+    const PdfValue* pLength = nullptr;
+    Adesk::UInt64 value;
+    if (resolve(object.value.find("Length"), pLength) == Acad::eOk && pLength != nullptr &&
+        pLength->unsignedInteger(value) && value <= m_size - start)
+        length = size_t(value);
+
+    /* Readers find endstream themselves when the length is wrong, so
+    writers get away with it. */
+    PdfParser end(m_pData, m_size);
+    end.seek(start + length);
+    if (length == m_size || !end.keyword("endstream"))
+    {
+        const size_t keyword = find(m_pData, m_size, start, "endstream");
+        if (keyword == m_size)
+            return Acad::eInvalidInput;
+        length = keyword - start;
+        if (length != 0 && m_pData[start + length - 1] == '\n')
+            --length;
+        if (length != 0 && m_pData[start + length - 1] == '\r')
+            --length;
+    }
+    object.pStream = m_pData + start;
+    object.streamSize = length;
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus PdfFragment::object(Adesk::UInt32 number, const PdfObject*& pObject)
+{
+    pObject = nullptr;
+    const auto found = m_objects.find(number);
+    if (found != m_objects.end())
+    {
+        pObject = &found->second;
+        return Acad::eOk;
+    }
+    if (number >= m_xref.size() || (m_xref[number].type != 1 && m_xref[number].type != 2))
+        return Acad::eOk;
+
+    /* A stream's length can be an object of its own, which can be in an
+    object stream, whose length... */
+    if (m_lookupDepth >= kMaxLookupDepth)
+        return Acad::eInvalidInput;
+    ++m_lookupDepth;
+    const XrefEntry entry = m_xref[number];
+    PdfObject object;
+    Acad::ErrorStatus es = Acad::eInvalidInput;
+    if (entry.type == 1 && entry.offset < m_size)
+        es = readObjectAt(size_t(entry.offset), object);
+    else if (entry.type == 2 && entry.offset < kMaxObjectNumber)
+        es = readObjectFromStream(Adesk::UInt32(entry.offset), entry.index, number, object);
+    --m_lookupDepth;
+    if (es != Acad::eOk)
+        return es;
+    pObject = &(m_objects[number] = std::move(object));
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus PdfFragment::readObjectFromStream(Adesk::UInt32 streamNumber, Adesk::UInt32 index,
+                                                    Adesk::UInt32 number, PdfObject& object)
+{
+    auto found = m_objectStreams.find(streamNumber);
+    if (found == m_objectStreams.end())
+    {
+        const PdfObject* pContainer = nullptr;
+        Acad::ErrorStatus es = this->object(streamNumber, pContainer);
+        if (es != Acad::eOk)
+            return es;
+        const PdfValue* pType = pContainer != nullptr ? pContainer->value.find("Type") : nullptr;
+        if (pType == nullptr || !pType->isName("ObjStm") || pContainer->pStream == nullptr)
+            return Acad::eInvalidInput;
+
+        /* The stream starts with an object number and offset for each object
+        it holds, and the objects follow from /First on. */
+        ObjectStream stream;
+        es = decodeStream(*pContainer, stream.data);
+        if (es != Acad::eOk)
+            return es;
+        Adesk::UInt64 count, first;
+        const PdfValue* pCount = pContainer->value.find("N");
+        const PdfValue* pFirst = pContainer->value.find("First");
+        if (pCount == nullptr || !pCount->unsignedInteger(count) || pFirst == nullptr ||
+            !pFirst->unsignedInteger(first) || first > stream.data.size() || count > stream.data.size())
+            return Acad::eInvalidInput;
+        PdfParser parser(stream.data.data(), stream.data.size());
+        for (Adesk::UInt64 i = 0; i < count; ++i)
+        {
+            std::pair<Adesk::UInt64, Adesk::UInt64> entry;
+            if (!parser.unsignedInteger(entry.first) || !parser.unsignedInteger(entry.second))
+                return Acad::eInvalidInput;
+            stream.offsets.push_back(entry);
+        }
+        stream.first = size_t(first);
+        found = m_objectStreams.emplace(streamNumber, std::move(stream)).first;
+    }
+
+    const ObjectStream& stream = found->second;
+    size_t at = index;
+    if (at >= stream.offsets.size() || stream.offsets[at].first != number)
+    {
+        for (at = 0; at < stream.offsets.size() && stream.offsets[at].first != number; ++at)
+        {
+        }
+    }
+    if (at == stream.offsets.size() || stream.offsets[at].second > stream.data.size() - stream.first)
+        return Acad::eInvalidInput;
+    PdfParser parser(stream.data.data(), stream.data.size());
+    parser.seek(stream.first + size_t(stream.offsets[at].second));
+    return parser.value(object.value);
+}
+
+Acad::ErrorStatus PdfFragment::decodeStream(const PdfObject& object, std::vector<Adesk::UInt8>& data)
+{
+    const PdfValue* pFilter = object.value.find("Filter");
+    const PdfValue* pParameters = object.value.find("DecodeParms");
+    if (pFilter != nullptr && pFilter->kind == PdfValue::kArray)
+    {
+        if (pFilter->items.size() > 1)
+            return Acad::eUnsupportedFileFormat;
+        pFilter = pFilter->items.empty() ? nullptr : &pFilter->items[0];
+        if (pParameters != nullptr && pParameters->kind == PdfValue::kArray)
+            pParameters = pParameters->items.empty() ? nullptr : &pParameters->items[0];
+    }
+    if (pFilter == nullptr)
+    {
+        data.assign(object.pStream, object.pStream + object.streamSize);
+        return Acad::eOk;
+    }
+    if (!pFilter->isName("FlateDecode"))
+        return Acad::eUnsupportedFileFormat;
+    Acad::ErrorStatus es = zlibDecompress(object.pStream, object.streamSize, data, kMaxDecodedSize);
+    if (es != Acad::eOk || pParameters == nullptr || pParameters->kind != PdfValue::kDictionary)
+        return es == Acad::eDataTooLarge ? Acad::eInvalidInput : es;
+
+    Adesk::UInt64 predictor = 1, columns = 1, colors = 1, bitsPerComponent = 8;
+    if (const PdfValue* pValue = pParameters->find("Predictor"))
+        pValue->unsignedInteger(predictor);
+    if (const PdfValue* pValue = pParameters->find("Columns"))
+        pValue->unsignedInteger(columns);
+    if (const PdfValue* pValue = pParameters->find("Colors"))
+        pValue->unsignedInteger(colors);
+    if (const PdfValue* pValue = pParameters->find("BitsPerComponent"))
+        pValue->unsignedInteger(bitsPerComponent);
+    if (predictor == 1)
+        return Acad::eOk;
+    if (predictor < 10)
+        return Acad::eUnsupportedFileFormat;
+    return unpredictPng(data, columns, colors, bitsPerComponent);
+}
+
+/* value with the references it holds renumbered, and those to objects that
+are not copied made null. */
+PdfValue renumbered(const PdfValue& value, const std::unordered_map<Adesk::UInt32, Adesk::UInt32>& numbers)
+{
+    if (value.kind == PdfValue::kReference)
+    {
+        const auto found = numbers.find(value.number);
+        return found != numbers.end() && found->second != 0 && found->second != kPending
+                   ? PdfValue::reference(found->second)
+                   : PdfValue();
+    }
+    PdfValue result;
+    result.kind = value.kind;
+    result.text = value.text;
+    result.items.reserve(value.items.size());
+    for (const PdfValue& item : value.items)
+        result.items.push_back(renumbered(item, numbers));
+    return result;
+}
+
+template <typename Visit>
+void forEachReference(const PdfValue& value, Visit&& visit)
+{
+    if (value.kind == PdfValue::kReference)
+        visit(value.number);
+    for (const PdfValue& item : value.items)
+        forEachReference(item, visit);
+}
+
+void serialize(const PdfValue& value, std::string& out)
+{
+    switch (value.kind)
+    {
+    case PdfValue::kNull:
+        out += "null";
+        break;
+    case PdfValue::kName:
+        out += '/';
+        out += value.text;
+        break;
+    case PdfValue::kReference:
+        out += std::to_string(value.number);
+        out += " 0 R";
+        break;
+    case PdfValue::kArray:
+        out += '[';
+        for (size_t i = 0; i < value.items.size(); ++i)
+        {
+            if (i != 0)
+                out += ' ';
+            serialize(value.items[i], out);
+        }
+        out += ']';
+        break;
+    case PdfValue::kDictionary:
+        out += "<<";
+        for (size_t i = 0; i < value.items.size(); ++i)
+        {
+            if (i != 0)
+                out += ' ';
+            serialize(value.items[i], out);
+        }
+        out += ">>";
+        break;
+    default:
+        out += value.text;
+        break;
+    }
+}
+
+/// <summary>
+/// Writes the output through a buffer, keeping count of where it is, and
+/// keeps the first error.
+/// </summary>
+class PdfWriter
+{
+public:
+    explicit PdfWriter(HANDLE hFile) : m_hFile(hFile), m_offset(0), m_status(Acad::eOk)
+    {
+        m_buffer.reserve(kWriteBufferSize);
+    }
+
+    Adesk::UInt64 offset() const { return m_offset; }
+
+    void write(const void* pData, size_t size)
+    {
+        m_offset += size;
+        if (m_buffer.size() + size > kWriteBufferSize)
+        {
+            flush();
+            if (size >= kWriteBufferSize)
+            {
+                writeThrough(pData, size);
+                return;
+            }
+        }
+        m_buffer.append(static_cast<const char*>(pData), size);
+    }
+
+    void write(const std::string& text) { write(text.data(), text.size()); }
+
+    Acad::ErrorStatus flush()
+    {
+        writeThrough(m_buffer.data(), m_buffer.size());
+        m_buffer.clear();
+        return m_status;
+    }
+
+private:
+    void writeThrough(const void* pData, size_t size)
+    {
+        if (m_status == Acad::eOk)
+            m_status = MappedFile::statusFromWin32(writeFileFully(m_hFile, pData, size));
+    }
+
+    HANDLE              m_hFile;
+    std::string         m_buffer;
+    Adesk::UInt64       m_offset;
+    Acad::ErrorStatus   m_status;
+};
+
+/// <summary>
+/// What the output has so far: where each object is, by number, and what
+/// its page tree and catalog will list.
+/// </summary>
+struct PdfAssembly
+{
+    explicit PdfAssembly(PdfWriter& writer) : writer(writer), offsets(3, 0), pageCount(0)
+    {
+        kids.kind = PdfValue::kArray;
+        groups.kind = PdfValue::kArray;
+        order.kind = PdfValue::kArray;
+        on.kind = PdfValue::kArray;
+        off.kind = PdfValue::kArray;
+    }
+
+    void writeObject(Adesk::UInt32 number, const PdfValue& value, const Adesk::UInt8* pStream = nullptr,
+                     size_t streamSize = 0)
+    {
+        offsets[number] = writer.offset();
+        std::string text = std::to_string(number) + " 0 obj\n";
+        serialize(value, text);
+        if (pStream != nullptr)
+        {
+            text += "\nstream\n";
+            writer.write(text);
+            writer.write(pStream, streamSize);
+            text = "\nendstream";
+        }
+        text += "\nendobj\n";
+        writer.write(text);
+    }
+
+    PdfWriter&                 writer;
+    std::vector<Adesk::UInt64> offsets;     // 1 is the catalog and 2 the page tree, written last
+    PdfValue                   kids;
+    Adesk::UInt64              pageCount;
+    PdfValue                   groups;      // optional content groups
+    PdfValue                   order;       // and how they are shown by default
+    PdfValue                   on;
+    PdfValue                   off;
+    std::string                version;
+};
+
+/* Appends the items of the array value, or the object it refers to. */
+Acad::ErrorStatus collectArray(PdfFragment& fragment, const PdfValue* pValue, std::vector<const PdfValue*>& items)
+{
+    const PdfValue* pArray = nullptr;
+    const Acad::ErrorStatus es = fragment.resolve(pValue, pArray);
+    if (es == Acad::eOk && pArray != nullptr && pArray->kind == PdfValue::kArray)
+    {
+        for (const PdfValue& item : pArray->items)
+            items.push_back(&item);
+    }
+    return es;
+}
+
+Acad::ErrorStatus copyFragment(const ACHAR* path, PdfAssembly& assembly)
+{
+    PdfFragment fragment;
+    Acad::ErrorStatus es = fragment.open(path);
+    if (es != Acad::eOk)
+        return es;
+    if (fragment.version() > assembly.version)
+        assembly.version = fragment.version();
+
+    const Adesk::UInt32 catalogNumber = fragment.trailer().find("Root")->number;
+    const PdfObject* pCatalog = nullptr;
+    es = fragment.object(catalogNumber, pCatalog);
+    if (es != Acad::eOk)
+        return es;
+    const PdfValue* pPages = pCatalog != nullptr ? pCatalog->value.find("Pages") : nullptr;
+    if (pPages == nullptr || pPages->kind != PdfValue::kReference || pPages->number == catalogNumber)
+        return Acad::eInvalidInput;
+    const Adesk::UInt32 pagesNumber = pPages->number;
+
+    /* The layers: the groups themselves, which the pages refer to by the
+    time they are marked as optional content, and which are shown. */
+    std::vector<const PdfValue*> groups, order, on, off;
+    const PdfValue* pProperties = nullptr;
+    const PdfValue* pDefaults = nullptr;
+    es = fragment.resolve(pCatalog->value.find("OCProperties"), pProperties);
+    if (es == Acad::eOk && pProperties != nullptr)
+        es = collectArray(fragment, pProperties->find("OCGs"), groups);
+    if (es == Acad::eOk && pProperties != nullptr)
+        es = fragment.resolve(pProperties->find("D"), pDefaults);
+    if (es == Acad::eOk && pDefaults != nullptr)
+        es = collectArray(fragment, pDefaults->find("Order"), order);
+    if (es == Acad::eOk && pDefaults != nullptr)
+        es = collectArray(fragment, pDefaults->find("ON"), on);
+    if (es == Acad::eOk && pDefaults != nullptr)
+        es = collectArray(fragment, pDefaults->find("OFF"), off);
+    if (es != Acad::eOk)
+        return es;
+
+    /* Numbers are handed out in the order objects are reached, breadth
+    first from the page tree.  The catalog is never copied; a reference to it,
+    from an action say, becomes null. */
+    std::unordered_map<Adesk::UInt32, Adesk::UInt32> numbers;
+    std::deque<Adesk::UInt32> queue;
+    std::vector<Adesk::UInt32> copied;
+    const auto visit = [&](Adesk::UInt32 number)
+    {
+        if (numbers.emplace(number, kPending).second)
+            queue.push_back(number);
+    };
+    numbers[catalogNumber] = 0;
+    visit(pagesNumber);
+    for (const std::vector<const PdfValue*>* pList : {&groups, &order, &on, &off})
+    {
+        for (const PdfValue* pItem : *pList)
+            forEachReference(*pItem, visit);
+    }
+    while (!queue.empty())
+    {
+        const Adesk::UInt32 number = queue.front();
+        queue.pop_front();
+        const PdfObject* pObject = nullptr;
+        es = fragment.object(number, pObject);
+        if (es != Acad::eOk)
+            return es;
+        if (pObject == nullptr)
+        {
+            numbers[number] = 0;
+            continue;
+        }
+        if (assembly.offsets.size() > 0x7FFFFFFF)
+            return Acad::eOutOfRange;
+        numbers[number] = Adesk::UInt32(assembly.offsets.size());
+        assembly.offsets.push_back(0);
+        copied.push_back(number);
+
+        /* A stream's length is written in place, so an object holding it is
+        not needed. */
+        const PdfValue& value = pObject->value;
+        for (size_t i = 0; i < value.items.size(); ++i)
+        {
+            if (pObject->pStream == nullptr || i % 2 != 0 || value.items[i].text != "Length")
+                forEachReference(value.items[i], visit);
+            else
+                ++i;
+        }
+    }
+    if (numbers[pagesNumber] == 0)
+        return Acad::eInvalidInput;
+
+    for (const Adesk::UInt32 number : copied)
+    {
+        const PdfObject* pObject = nullptr;
+        fragment.object(number, pObject);
+        PdfValue value = renumbered(pObject->value, numbers);
+        if (number == pagesNumber)
+            value.set("Parent", PdfValue::reference(2));
+        if (pObject->pStream != nullptr)
+            value.set("Length", PdfValue::integer(pObject->streamSize));
+        assembly.writeObject(numbers[number], value, pObject->pStream, pObject->streamSize);
+    }
+
+    const PdfObject* pPageTree = nullptr;
+    const PdfValue* pCount = nullptr;
+    Adesk::UInt64 count = 0;
+    fragment.object(pagesNumber, pPageTree);
+    if (fragment.resolve(pPageTree->value.find("Count"), pCount) == Acad::eOk && pCount != nullptr)
+        pCount->unsignedInteger(count);
+    assembly.pageCount += count;
+    assembly.kids.items.push_back(PdfValue::reference(numbers[pagesNumber]));
+    for (const PdfValue* pItem : groups)
+        assembly.groups.items.push_back(renumbered(*pItem, numbers));
+    for (const PdfValue* pItem : order)
+        assembly.order.items.push_back(renumbered(*pItem, numbers));
+    for (const PdfValue* pItem : on)
+        assembly.on.items.push_back(renumbered(*pItem, numbers));
+    for (const PdfValue* pItem : off)
+        assembly.off.items.push_back(renumbered(*pItem, numbers));
+    return assembly.writer.flush();
+}
+
+} // namespace
+
+PdfFragmentAssembler::PdfFragmentAssembler()
+    : m_pageCount(0)
+    , m_objectCount(0)
+{
+}
+
+Acad::ErrorStatus PdfFragmentAssembler::assemble(const std::vector<std::wstring>& fragments,
+                                                 const ACHAR* outputPath)
+{
+    if (outputPath == nullptr)
+        return Acad::eNullPtr;
+    m_pageCount = 0;
+    m_objectCount = 0;
+
+    std::wstring temporaryPath(outputPath);
+    temporaryPath += L".tmp";
+    HANDLE hFile = ::CreateFileW(temporaryPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                                 FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return MappedFile::statusFromWin32(::GetLastError());
+
+    /* The version goes first but is only known once every fragment has been
+    read, so the header leaves room for the longest there is. */
+    PdfWriter writer(hFile);
+    PdfAssembly assembly(writer);
+    writer.write(std::string("%PDF-1.7\n%\xE2\xE3\xCF\xD3\n"));
+    Acad::ErrorStatus es = Acad::eOk;
+    for (size_t i = 0; i < fragments.size() && es == Acad::eOk; ++i)
+        es = copyFragment(fragments[i].c_str(), assembly);
+
+    if (es == Acad::eOk)
+    {
+        PdfValue pages;
+        pages.kind = PdfValue::kDictionary;
+        pages.set("Type", PdfValue::name("Pages"));
+        pages.set("Kids", assembly.kids);
+        pages.set("Count", PdfValue::integer(assembly.pageCount));
+        assembly.writeObject(2, pages);
+
+        PdfValue catalog;
+        catalog.kind = PdfValue::kDictionary;
+        catalog.set("Type", PdfValue::name("Catalog"));
+        catalog.set("Pages", PdfValue::reference(2));
+        if (!assembly.groups.items.empty())
+        {
+            PdfValue defaults, properties;
+            defaults.kind = properties.kind = PdfValue::kDictionary;
+            defaults.set("Order", assembly.order);
+            defaults.set("ON", assembly.on);
+            defaults.set("OFF", assembly.off);
+            properties.set("OCGs", assembly.groups);
+            properties.set("D", defaults);
+            catalog.set("OCProperties", properties);
+        }
+        assembly.writeObject(1, catalog);
+
+        /* Every entry is exactly 20 bytes, its line ending included. */
+        const Adesk::UInt64 xrefOffset = writer.offset();
+        std::string xref = "xref\n0 " + std::to_string(assembly.offsets.size()) + "\n0000000000 65535 f\r\n";
+        for (size_t number = 1; number < assembly.offsets.size(); ++number)
+        {
+            char entry[21];
+            std::snprintf(entry, sizeof(entry), "%010llu 00000 n\r\n",
+                          static_cast<unsigned long long>(assembly.offsets[number]));
+            xref += entry;
+            if (xref.size() >= kWriteBufferSize)
+            {
+                writer.write(xref);
+                xref.clear();
+            }
+        }
+        xref += "trailer\n<</Size " + std::to_string(assembly.offsets.size()) + " /Root 1 0 R>>\nstartxref\n" +
+                std::to_string(xrefOffset) + "\n%%EOF\n";
+        writer.write(xref);
+        es = writer.flush();
+    }
+
+    /* The header, once the version is known. */
+    if (es == Acad::eOk && assembly.version.size() == 3 && assembly.version != "1.7")
+    {
+        LARGE_INTEGER start;
+        start.QuadPart = 5;
+        if (!::SetFilePointerEx(hFile, start, nullptr, FILE_BEGIN))
+            es = MappedFile::statusFromWin32(::GetLastError());
+        else
+            es = MappedFile::statusFromWin32(writeFileFully(hFile, assembly.version.data(), 3));
+    }
+    if (es == Acad::eOk && !::FlushFileBuffers(hFile))
+        es = MappedFile::statusFromWin32(::GetLastError());
+    ::CloseHandle(hFile);
+
+    if (es == Acad::eOk &&
+        !::MoveFileExW(temporaryPath.c_str(), outputPath, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+        es = MappedFile::statusFromWin32(::GetLastError());
+    if (es != Acad::eOk)
+    {
+        ::DeleteFileW(temporaryPath.c_str());
+        return es;
+    }
+    m_pageCount = size_t(assembly.pageCount);
+    m_objectCount = assembly.offsets.size() - 1;
+    return Acad::eOk;
+}
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "PublishJournal.h"
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// Assembles single-sheet PDF files, as publishing to "PDF, single-sheet"
+/// writes them, into one PDF holding the pages of each in turn.
+///
+/// A fragment is read through its cross-reference table or stream and those
+/// of its earlier revisions; objects packed into object streams are
+/// unpacked.  Every object its page tree reaches is copied under a new
+/// number, streams byte for byte, and the page tree itself becomes a child
+/// of the output's, so whatever its pages inherit from it still applies.
+/// The output gets a catalog of its own, which lists the optional content
+/// groups (layers) of all fragments, and a plain cross-reference table.
+///
+/// Whatever only a fragment's catalog refers to, such as outlines, named
+/// destinations and document metadata, is left behind; the driver publishes
+/// without bookmarks.  Encrypted fragments, and cross-reference or object
+/// streams with a filter other than FlateDecode, return
+/// Acad::eUnsupportedFileFormat, and damaged ones Acad::eInvalidInput.  The
+/// output is written beside outputPath and renamed over it, so that it is
+/// either the old file or the whole new one.
+/// </summary>
+class PdfFragmentAssembler : public PublishFragmentAssembler
+{
+public:
+    PdfFragmentAssembler();
+
+    Acad::ErrorStatus assemble(const std::vector<std::wstring>& fragments, const ACHAR* outputPath) override;
+
+    /// <summary>
+    /// Pages and objects of the last output assembled.
+    /// </summary>
+    size_t pageCount() const { return m_pageCount; }
+    size_t objectCount() const { return m_objectCount; }
+
+private:
+    size_t m_pageCount;
+    size_t m_objectCount;
+};
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,269 @@
+#include "stdafx.h"
+#include "PlotPreflight.h"
+
+#include <chrono>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+/* Appends values to a key so that two keys are equal only if every value
+is: numbers take a fixed number of characters and strings are preceded by
+their length. */
+class KeyWriter
+{
+public:
+    explicit KeyWriter(std::wstring& key) : m_key(key) { m_key.clear(); }
+
+    void number(Adesk::UInt64 value)
+    {
+        for (int shift = 0; shift < 64; shift += 16)
+            m_key += static_cast<wchar_t>((value >> shift) & 0xFFFF);
+    }
+
+    void real(double value)
+    {
+        Adesk::UInt64 bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        number(bits);
+    }
+
+    void text(const ACHAR* pText)
+    {
+        const size_t length = pText != nullptr ? std::wcslen(pText) : 0;
+        number(length);
+        m_key.append(pText != nullptr ? pText : L"", length);
+    }
+
+private:
+    std::wstring& m_key;
+};
+
+Adesk::UInt64 elapsedSince(std::chrono::steady_clock::time_point start)
+{
+    return static_cast<Adesk::UInt64>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+/* Everything in a plot settings object that the validator merges or checks
+against the device, whether or not the plot type uses it. */
+void writeSettings(KeyWriter& key, const AcDbPlotSettings& settings)
+{
+    const ACHAR* pText = nullptr;
+    double a = 0.0, b = 0.0, c = 0.0, d = 0.0;
+
+    key.number(settings.modelType());
+    pText = nullptr;
+    settings.getPlotCfgName(pText);
+    key.text(pText);
+    pText = nullptr;
+    settings.getCanonicalMediaName(pText);
+    key.text(pText);
+    pText = nullptr;
+    settings.getCurrentStyleSheet(pText);
+    key.text(pText);
+    pText = nullptr;
+    settings.getPlotViewName(pText);
+    key.text(pText);
+
+    settings.getPlotPaperMargins(a, b, c, d);
+    key.real(a); key.real(b); key.real(c); key.real(d);
+    settings.getPlotPaperSize(a, b);
+    key.real(a); key.real(b);
+    settings.getPlotOrigin(a, b);
+    key.real(a); key.real(b);
+    settings.getPlotWindowArea(a, b, c, d);
+    key.real(a); key.real(b); key.real(c); key.real(d);
+    settings.getCustomPrintScale(a, b);
+    key.real(a); key.real(b);
+    a = 0.0;
+    settings.getStdScale(a);
+    key.real(a);
+
+    key.number(settings.plotPaperUnits());
+    key.number(settings.plotRotation());
+    key.number(settings.plotType());
+    key.number(settings.stdScaleType());
+    key.number(settings.useStandardScale());
+    key.number(settings.plotCentered());
+    key.number(settings.plotHidden());
+    key.number(settings.shadePlot());
+    key.number(settings.shadePlotResLevel());
+    key.number(static_cast<Adesk::UInt16>(settings.shadePlotCustomDPI()));
+    const AcDbHandle shadePlot = settings.shadePlotId().handle();
+    key.number((Adesk::UInt64(shadePlot.high()) << 32) | shadePlot.low());
+    key.number(settings.plotViewportBorders());
+    key.number(settings.plotTransparency());
+    key.number(settings.plotPlotStyles());
+    key.number(settings.showPlotStyles());
+    key.number(settings.scaleLineweights());
+    key.number(settings.printLineweights());
+    key.number(settings.drawViewportsFirst());
+}
+
+} // namespace
+
+Adesk::UInt64 PlotPreflightReport::savedNanoseconds() const
+{
+    return validateCount != 0 ? validateNanoseconds / validateCount * cacheHitCount : 0;
+}
+
+PlotPreflight::PlotPreflight(AcPlPlotInfoValidator& validator)
+    : m_validator(validator)
+    , m_run(0)
+{
+}
+
+PlotPreflight::~PlotPreflight()
+{
+}
+
+void PlotPreflight::clear()
+{
+    m_groups.clear();
+}
+
+bool PlotPreflight::makeKey(AcPlPlotInfo& info, std::wstring& key, PlotPreflightSheet& sheet) const
+{
+    sheet.drawing = info.OrgFilePath();
+    AcDbObjectPointer<AcDbLayout> pLayout(info.layout(), AcDb::kForRead);
+    if (pLayout.openStatus() != Acad::eOk)
+        return false;
+
+    const ACHAR* pText = nullptr;
+    if (pLayout->getLayoutName(pText) == Acad::eOk && pText != nullptr)
+        sheet.layout = pText;
+    pText = nullptr;
+    if (sheet.drawing.isEmpty() && pLayout->database() != nullptr &&
+        pLayout->database()->getFilename(pText) == Acad::eOk && pText != nullptr)
+        sheet.drawing = pText;
+
+    KeyWriter writer(key);
+    writer.number(m_validator.matchingPolicy());
+    writer.number(m_validator.mediaMatchingThreshold());
+    writer.number(m_validator.mediaGroupWeight());
+    writer.number(m_validator.sheetMediaGroupWeight());
+    writer.number(m_validator.mediaBoundsWeight());
+    writer.number(m_validator.printableBoundsWeight());
+    writer.number(m_validator.dimensionalWeight());
+    writer.number(m_validator.sheetDimensionalWeight());
+
+    /* Plot style tables are also looked up next to the drawing. */
+    const std::wstring drawing(sheet.drawing.constPtr());
+    const size_t separator = drawing.find_last_of(L"\\/");
+    writer.text(separator != std::wstring::npos ? drawing.substr(0, separator).c_str() : L"");
+
+    const AcPlPlotConfig* pDevice = info.deviceOverride();
+    writer.number(pDevice != nullptr);
+    if (pDevice != nullptr)
+    {
+        writer.text(pDevice->deviceName());
+        writer.text(pDevice->fullPath());
+    }
+
+    writer.number(pLayout->modelType());
+    const AcDbPlotSettings* pOverrides = info.overrideSettings();
+    writer.number(pOverrides != nullptr);
+    writeSettings(writer, pOverrides != nullptr ? *pOverrides : *pLayout.object());
+    return true;
+}
+
+Acad::ErrorStatus PlotPreflight::validate(AcPlPlotInfo& info, PlotPreflightReport& report, Group& group)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    group.status = m_validator.validate(info);
+    report.validateNanoseconds += elapsedSince(start);
+    ++report.validateCount;
+
+    group.mergeStatus = info.mergeStatus();
+    group.pValidated.reset();
+    if (group.status == Acad::eOk)
+    {
+        /* The info belongs to the caller and may be gone by the next run, so
+        the group keeps a copy to hand the merged settings out from. */
+        std::unique_ptr<AcPlPlotInfo> pCopy(new AcPlPlotInfo());
+        if (pCopy->copyFrom(&info) == Acad::eOk)
+            group.pValidated = std::move(pCopy);
+    }
+    return group.status;
+}
+
+Acad::ErrorStatus PlotPreflight::run(const std::vector<AcPlPlotInfo*>& infos, PlotPreflightReport& report,
+                                     AcPlPlotLogger* pLogger)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    report = PlotPreflightReport();
+    report.sheets.resize(infos.size());
+    ++m_run;
+
+    Acad::ErrorStatus es = Acad::eOk;
+    std::wstring key;
+    for (size_t i = 0; i < infos.size(); ++i)
+    {
+        PlotPreflightSheet& sheet = report.sheets[i];
+        AcPlPlotInfo* pInfo = infos[i];
+        if (pInfo == nullptr)
+        {
+            sheet.status = Acad::eNullPtr;
+            sheet.group = report.groupCount++;
+            report.invalidSheets.push_back(i);
+            es = Acad::eNullPtr;
+            continue;
+        }
+
+        const std::chrono::steady_clock::time_point keyStart = std::chrono::steady_clock::now();
+        const bool keyed = makeKey(*pInfo, key, sheet);
+        report.keyNanoseconds += elapsedSince(keyStart);
+
+        Group unkeyed;
+        Group* pGroup = keyed ? &m_groups[key] : &unkeyed;
+
+        /* A group is validated by its first sheet ever, and only copied into
+        the infos of the sheets after that.  A valid group whose info could
+        not be copied has nothing to copy from and is validated again. */
+        const bool validated = pGroup->lastRun != 0 && (pGroup->status != Acad::eOk || pGroup->pValidated != nullptr);
+        if (pGroup->lastRun != m_run)
+        {
+            pGroup->cached = validated;
+            pGroup->lastRun = m_run;
+            pGroup->index = report.groupCount++;
+        }
+        sheet.group = pGroup->index;
+        sheet.cached = pGroup->cached;
+
+        if (!validated)
+        {
+            sheet.status = validate(*pInfo, report, *pGroup);
+        }
+        else
+        {
+            ++report.cacheHitCount;
+            sheet.status = pGroup->status;
+            if (sheet.status == Acad::eOk)
+            {
+                sheet.status = pInfo->setValidatedSettings(pGroup->pValidated->validatedSettings());
+                pInfo->setValidatedConfig(pGroup->pValidated->validatedConfig());
+            }
+        }
+        sheet.mergeStatus = pGroup->mergeStatus;
+
+        if (sheet.status != Acad::eOk)
+        {
+            report.invalidSheets.push_back(i);
+            if (es == Acad::eOk)
+                es = Acad::eInvalidPlotInfo;
+            if (pLogger != nullptr)
+            {
+                AcString message;
+                message.format(ACRX_T("Sheet %u (%s in %s) cannot be plotted: %s"), unsigned(i + 1),
+                               sheet.layout.constPtr(), sheet.drawing.constPtr(), acadErrorStatusText(sheet.status));
+                pLogger->logError(message.constPtr());
+            }
+        }
+    }
+
+    report.totalNanoseconds = elapsedSince(start);
+    return es;
+}
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <unordered_map>
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// What PlotPreflight found out about one sheet.
+/// </summary>
+struct PlotPreflightSheet
+{
+    Acad::ErrorStatus status = Acad::eOk;   // returned by AcPlPlotInfoValidator::validate
+    unsigned long     mergeStatus = 0;      // AcPlPlotInfo::MergeStatus bits of the validated info
+    size_t            group = 0;            // sheets with the same group were validated once
+    bool              cached = false;       // the group was validated by an earlier run
+    AcString          layout;
+    AcString          drawing;
+};
+
+/// <summary>
+/// Outcome of a PlotPreflight run.  Times are nanoseconds.
+/// </summary>
+struct PlotPreflightReport
+{
+    std::vector<PlotPreflightSheet> sheets;         // one per info, in order
+    std::vector<size_t>             invalidSheets;  // indices of sheets whose status is not eOk
+    size_t                          groupCount = 0;
+    size_t                          validateCount = 0;
+    size_t                          cacheHitCount = 0;
+    Adesk::UInt64                   keyNanoseconds = 0;         // reading the settings of every sheet
+    Adesk::UInt64                   validateNanoseconds = 0;    // inside AcPlPlotInfoValidator::validate
+    Adesk::UInt64                   totalNanoseconds = 0;
+
+    bool allValid() const { return invalidSheets.empty(); }
+
+    /// <summary>
+    /// Estimate of the validation time the run saved, taking every validate
+    /// call avoided to cost as much as the average call made.
+    /// </summary>
+    Adesk::UInt64 savedNanoseconds() const;
+};
+
+/// <summary>
+/// Validates the plot settings of every sheet of a publish job before the
+/// first one is plotted, once per distinct combination of settings.
+///
+/// Plotting used to validate each sheet's AcPlPlotInfo inside the plot loop,
+/// so a bad device or media on sheet 300 surfaced after 299 sheets had been
+/// plotted, and a set whose 400 sheets share three page setups paid for 400
+/// validations.  Here the effective settings of every sheet (the override
+/// settings when the info has some and the layout's own otherwise, the device
+/// override, the drawing's folder, in which plot styles are looked up, and the
+/// validator's matching policy) form a key; the first sheet with a key is
+/// validated and the result, including the merged settings and plot config,
+/// is copied into the infos of the others with setValidatedSettings and
+/// setValidatedConfig.  Results are kept across runs until clear(), so
+/// publishing the same set again validates nothing.
+///
+/// Sheets whose layout cannot be opened are validated on their own.  Must be
+/// used on AutoCAD's main thread, like the validator.
+/// </summary>
+class PlotPreflight
+{
+public:
+    explicit PlotPreflight(AcPlPlotInfoValidator& validator);
+    ~PlotPreflight();
+
+    PlotPreflight(const PlotPreflight&) = delete;
+    PlotPreflight& operator=(const PlotPreflight&) = delete;
+
+    /// <summary>
+    /// Validates infos and fills in report.  Every invalid sheet is also
+    /// logged as an error to pLogger, if it is not null.  Returns
+    /// Acad::eInvalidPlotInfo if any sheet is invalid, so that a caller can
+    /// refuse to start plotting, and Acad::eNullPtr for a null info.
+    /// </summary>
+    Acad::ErrorStatus run(const std::vector<AcPlPlotInfo*>& infos, PlotPreflightReport& report,
+                          AcPlPlotLogger* pLogger = nullptr);
+
+    /// <summary>
+    /// Forgets the results of earlier runs, for instance after a PC3 file or
+    /// plot style table changed on disk.
+    /// </summary>
+    void clear();
+
+    size_t cachedGroupCount() const { return m_groups.size(); }
+
+private:
+    struct Group
+    {
+        Acad::ErrorStatus             status = Acad::eOk;
+        unsigned long                 mergeStatus = 0;
+        std::unique_ptr<AcPlPlotInfo> pValidated;   // owned copy of the validated info
+        size_t                        lastRun = 0;  // run that last used the group
+        size_t                        index = 0;    // group number in that run
+        bool                          cached = false;  // validated before that run
+    };
+
+    bool makeKey(AcPlPlotInfo& info, std::wstring& key, PlotPreflightSheet& sheet) const;
+    Acad::ErrorStatus validate(AcPlPlotInfo& info, PlotPreflightReport& report, Group& group);
+
+    AcPlPlotInfoValidator&                  m_validator;
+    std::unordered_map<std::wstring, Group> m_groups;
+    size_t                                  m_run;
+};
+
+} // namespace acad_sheetset_to_pdf
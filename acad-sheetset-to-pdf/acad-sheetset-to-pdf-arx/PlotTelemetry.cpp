@@ -0,0 +1,546 @@
+#include "stdafx.h"
+#include "PlotTelemetry.h"
+#include "AtomicFile.h"
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+int highestBit(Adesk::UInt64 value)
+{
+    int bit = 0;
+    while (value >>= 1)
+        ++bit;
+    return bit;
+}
+
+/* Bucket boundaries of the Prometheus histograms, in seconds.  Publishing a
+sheet takes anything from a few milliseconds (an empty layout) to minutes (a
+large raster or point cloud), and the histogram keeps the full detail for the
+JSON export anyway. */
+const double kExportBounds[] = { 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0,
+                                 10.0, 25.0, 60.0, 120.0, 300.0, 600.0 };
+
+const char* sheetStatusName(AcPlPlotProgress::SheetCancelStatus status)
+{
+    switch (status)
+    {
+    case AcPlPlotProgress::kSheetContinue:
+        return "completed";
+    case AcPlPlotProgress::kSheetCanceledByCancelButton:
+        return "cancelled";
+    case AcPlPlotProgress::kSheetCanceledByCancelAllButton:
+        return "cancelled_all";
+    case AcPlPlotProgress::kSheetCanceledByCaller:
+        return "cancelled_by_caller";
+    default:
+        return "unknown";
+    }
+}
+
+double milliseconds(Adesk::UInt64 nanoseconds)
+{
+    return double(nanoseconds) / 1e6;
+}
+
+void appendFormat(std::string& out, const char* format, ...)
+{
+    char buffer[256];
+    va_list arguments;
+    va_start(arguments, format);
+    const int length = std::vsnprintf(buffer, sizeof(buffer), format, arguments);
+    va_end(arguments);
+    if (length > 0)
+        out.append(buffer, std::min<size_t>(size_t(length), sizeof(buffer) - 1));
+}
+
+/* Appends text as a JSON string literal, converted to UTF-8. */
+void appendJsonString(std::string& out, const ACHAR* text)
+{
+    std::string utf8;
+    if (text != nullptr && *text != 0)
+    {
+        const int length = ::WideCharToMultiByte(CP_UTF8, 0, text, -1, nullptr, 0, nullptr, nullptr);
+        if (length > 1)
+        {
+            utf8.resize(size_t(length));
+            ::WideCharToMultiByte(CP_UTF8, 0, text, -1, &utf8[0], length, nullptr, nullptr);
+            utf8.resize(size_t(length) - 1);
+        }
+    }
+
+    out += '"';
+    for (const char c : utf8)
+    {
+        switch (c)
+        {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+                appendFormat(out, "\\u%04x", unsigned(static_cast<unsigned char>(c)));
+            else
+                out += c;
+        }
+    }
+    out += '"';
+}
+
+/* Layout name and drawing of the sheet being plotted.  The drawing comes
+from OrgFilePath, which AutoCAD sets to the file the sheet was loaded from,
+and falls back to the layout's database. */
+void describeSheet(AcPlPlotInfo& plotInfo, PlotSheetTelemetry& sheet)
+{
+    sheet.drawing = plotInfo.OrgFilePath();
+    AcDbObjectPointer<AcDbLayout> pLayout(plotInfo.layout(), AcDb::kForRead);
+    if (pLayout.openStatus() != Acad::eOk)
+        return;
+
+    const ACHAR* pName = nullptr;
+    if (pLayout->getLayoutName(pName) == Acad::eOk && pName != nullptr)
+        sheet.layout = pName;
+    const ACHAR* pFileName = nullptr;
+    if (sheet.drawing.isEmpty() && pLayout->database() != nullptr &&
+        pLayout->database()->getFilename(pFileName) == Acad::eOk && pFileName != nullptr)
+        sheet.drawing = pFileName;
+}
+
+} // namespace
+
+/* LatencyHistogram -------------------------------------------------------- */
+
+LatencyHistogram::LatencyHistogram()
+    : m_counts(kBucketCount, 0)
+    , m_count(0)
+    , m_minimum(~Adesk::UInt64(0))
+    , m_maximum(0)
+    , m_total(0)
+{
+}
+
+/* Values below kSubBucketCount have a bucket each.  Above, a value whose
+highest bit is b is shifted right until it fits in kSubBucketBits bits, which
+leaves it in the upper half of the sub-buckets; the shift picks the group of
+kSubBucketHalf buckets. */
+size_t LatencyHistogram::bucketOf(Adesk::UInt64 value)
+{
+    if (value < kSubBucketCount)
+        return size_t(value);
+    const int shift = highestBit(value) - (kSubBucketBits - 1);
+    return size_t(shift) * kSubBucketHalf + size_t(value >> shift);
+}
+
+Adesk::UInt64 LatencyHistogram::highestValueIn(size_t bucket)
+{
+    if (bucket < kSubBucketCount)
+        return bucket;
+    const size_t shift = bucket / kSubBucketHalf - 1;
+    const Adesk::UInt64 subBucket = bucket - shift * kSubBucketHalf;
+    return ((subBucket + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(Adesk::UInt64 nanoseconds)
+{
+    ++m_counts[bucketOf(nanoseconds)];
+    ++m_count;
+    m_minimum = std::min(m_minimum, nanoseconds);
+    m_maximum = std::max(m_maximum, nanoseconds);
+    m_total += nanoseconds;
+}
+
+void LatencyHistogram::add(const LatencyHistogram& other)
+{
+    for (size_t i = 0; i < m_counts.size(); ++i)
+        m_counts[i] += other.m_counts[i];
+    m_count += other.m_count;
+    m_minimum = std::min(m_minimum, other.m_minimum);
+    m_maximum = std::max(m_maximum, other.m_maximum);
+    m_total += other.m_total;
+}
+
+void LatencyHistogram::clear()
+{
+    std::fill(m_counts.begin(), m_counts.end(), 0);
+    m_count = 0;
+    m_minimum = ~Adesk::UInt64(0);
+    m_maximum = 0;
+    m_total = 0;
+}
+
+double LatencyHistogram::mean() const
+{
+    return m_count != 0 ? double(m_total) / double(m_count) : 0.0;
+}
+
+Adesk::UInt64 LatencyHistogram::valueAtPercentile(double percentile) const
+{
+    if (m_count == 0)
+        return 0;
+    percentile = std::min(std::max(percentile, 0.0), 100.0);
+    Adesk::UInt64 rank = static_cast<Adesk::UInt64>(std::ceil(percentile / 100.0 * double(m_count)));
+    rank = std::max<Adesk::UInt64>(rank, 1);
+
+    Adesk::UInt64 seen = 0;
+    for (size_t i = 0; i < m_counts.size(); ++i)
+    {
+        seen += m_counts[i];
+        if (seen >= rank)
+            return std::min(highestValueIn(i), m_maximum);
+    }
+    return m_maximum;
+}
+
+Adesk::UInt64 LatencyHistogram::countAtOrBelow(Adesk::UInt64 nanoseconds) const
+{
+    Adesk::UInt64 result = 0;
+    for (size_t i = 0; i < m_counts.size() && highestValueIn(i) <= nanoseconds; ++i)
+        result += m_counts[i];
+    return result;
+}
+
+/* PlotTelemetry ----------------------------------------------------------- */
+
+PlotTelemetry::PlotTelemetry()
+    : m_lastExportStatus(Acad::eOk)
+{
+    reset();
+}
+
+void PlotTelemetry::reset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_epoch = std::chrono::steady_clock::now();
+    m_epochUnixMilliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    for (LatencyHistogram& histogram : m_histograms)
+        histogram.clear();
+    m_sheets.clear();
+    m_plotCount = 0;
+    m_cancelledPlotCount = 0;
+    std::fill(std::begin(m_sheetCounts), std::end(m_sheetCounts), 0);
+    m_inPage = false;
+    m_pageCancelled = false;
+    m_plotCancelled = false;
+    m_page = 0;
+    m_document.setEmpty();
+    m_plotStart = m_documentStart = m_lastBoundary = 0;
+}
+
+Adesk::UInt64 PlotTelemetry::now() const
+{
+    return static_cast<Adesk::UInt64>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_epoch).count());
+}
+
+const char* PlotTelemetry::phaseName(PlotPhase phase)
+{
+    switch (phase)
+    {
+    case kPlotPhaseWhole:
+        return "plot";
+    case kPlotPhaseDocument:
+        return "document";
+    case kPlotPhaseSheetSetup:
+        return "sheet_setup";
+    case kPlotPhaseSheet:
+        return "sheet";
+    case kPlotPhaseFinish:
+        return "finish";
+    default:
+        return "unknown";
+    }
+}
+
+void PlotTelemetry::beginPlot(AcPlPlotProgress* /*pPlotProgress*/, PlotType /*type*/)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_plotCount;
+    m_plotStart = m_lastBoundary = now();
+    m_plotCancelled = false;
+    m_inPage = false;
+}
+
+void PlotTelemetry::beginDocument(AcPlPlotInfo& /*plotInfo*/, const ACHAR* pDocname, Adesk::Int32 /*nCopies*/,
+                                  bool /*bPlotToFile*/, const ACHAR* /*pFilename*/)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_documentStart = m_lastBoundary = now();
+    m_document = pDocname != nullptr ? pDocname : ACRX_T("");
+    m_page = 0;
+}
+
+void PlotTelemetry::beginPage(AcPlPlotPageInfo& pageInfo, AcPlPlotInfo& plotInfo, bool /*bLastPage*/)
+{
+    /* Opening the layout is the slow part; do it before taking the lock. */
+    PlotSheetTelemetry sheet;
+    describeSheet(plotInfo, sheet);
+    sheet.entityCount = pageInfo.entityCount();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    sheet.plot = unsigned(m_plotCount);
+    sheet.page = ++m_page;
+    sheet.document = m_document;
+    if (sheet.layout.isEmpty())
+        sheet.layout.format(ACRX_T("Sheet %u"), sheet.page);
+    sheet.setupStart = m_lastBoundary;
+    sheet.pageStart = now();
+    m_current = sheet;
+    m_inPage = true;
+    m_pageCancelled = false;
+    m_histograms[kPlotPhaseSheetSetup].record(sheet.pageStart - sheet.setupStart);
+}
+
+void PlotTelemetry::endPage(AcPlPlotProgress::SheetCancelStatus status)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_inPage)
+        return;
+    /* A page cancelled from the dialog may still be reported as continuing. */
+    if (status == AcPlPlotProgress::kSheetContinue && m_pageCancelled)
+        status = AcPlPlotProgress::kSheetCanceledByCancelButton;
+    finishSheet(now(), status);
+}
+
+void PlotTelemetry::finishSheet(Adesk::UInt64 time, AcPlPlotProgress::SheetCancelStatus status)
+{
+    m_current.pageEnd = time;
+    m_current.status = status;
+    m_lastBoundary = time;
+    m_inPage = false;
+
+    m_histograms[kPlotPhaseSheet].record(m_current.pageEnd - m_current.pageStart);
+    if (status >= 0 && status < AcPlPlotProgress::kSheetCancelStatusCount)
+        ++m_sheetCounts[status];
+    m_sheets.push_back(m_current);
+    if (m_sheets.size() > kPlotTelemetrySheetHistory)
+        m_sheets.pop_front();
+}
+
+void PlotTelemetry::endDocument(AcPlPlotProgress::PlotCancelStatus /*status*/)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const Adesk::UInt64 time = now();
+    if (m_inPage)
+        finishSheet(time, AcPlPlotProgress::kSheetCanceledByCancelAllButton);
+    m_histograms[kPlotPhaseFinish].record(time - m_lastBoundary);
+    m_histograms[kPlotPhaseDocument].record(time - m_documentStart);
+    m_lastBoundary = time;
+}
+
+void PlotTelemetry::endPlot(AcPlPlotProgress::PlotCancelStatus status)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const Adesk::UInt64 time = now();
+    if (m_inPage)
+        finishSheet(time, AcPlPlotProgress::kSheetCanceledByCancelAllButton);
+    m_histograms[kPlotPhaseWhole].record(time - m_plotStart);
+    if (status != AcPlPlotProgress::kPlotContinue || m_plotCancelled)
+        ++m_cancelledPlotCount;
+
+    Acad::ErrorStatus es = Acad::eOk;
+    if (!m_jsonPath.empty())
+    {
+        const std::string document = jsonLocked();
+        es = writeFileAtomically(m_jsonPath.c_str(), document.data(), document.size());
+    }
+    if (!m_prometheusPath.empty())
+    {
+        const std::string document = prometheusLocked();
+        const Acad::ErrorStatus prometheusStatus =
+            writeFileAtomically(m_prometheusPath.c_str(), document.data(), document.size());
+        if (es == Acad::eOk)
+            es = prometheusStatus;
+    }
+    m_lastExportStatus = es;
+}
+
+void PlotTelemetry::plotCancelled()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_plotCancelled = true;
+}
+
+void PlotTelemetry::pageCancelled()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pageCancelled = true;
+}
+
+void PlotTelemetry::setExportPaths(const ACHAR* jsonPath, const ACHAR* prometheusPath)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_jsonPath = jsonPath != nullptr ? jsonPath : L"";
+    m_prometheusPath = prometheusPath != nullptr ? prometheusPath : L"";
+}
+
+Acad::ErrorStatus PlotTelemetry::lastExportStatus() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_lastExportStatus;
+}
+
+LatencyHistogram PlotTelemetry::histogram(PlotPhase phase) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return phase >= 0 && phase < kPlotPhaseCount ? m_histograms[phase] : LatencyHistogram();
+}
+
+std::vector<PlotSheetTelemetry> PlotTelemetry::sheets() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return std::vector<PlotSheetTelemetry>(m_sheets.begin(), m_sheets.end());
+}
+
+std::string PlotTelemetry::json() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return jsonLocked();
+}
+
+std::string PlotTelemetry::prometheus() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return prometheusLocked();
+}
+
+Acad::ErrorStatus PlotTelemetry::exportJson(const ACHAR* path) const
+{
+    const std::string document = json();
+    return writeFileAtomically(path, document.data(), document.size());
+}
+
+Acad::ErrorStatus PlotTelemetry::exportPrometheus(const ACHAR* path) const
+{
+    const std::string document = prometheus();
+    return writeFileAtomically(path, document.data(), document.size());
+}
+
+std::string PlotTelemetry::jsonLocked() const
+{
+    std::string out;
+    out.reserve(512 + m_sheets.size() * 320);
+    appendFormat(out, "{\n  \"epoch_unix_ms\": %lld,\n", static_cast<long long>(m_epochUnixMilliseconds));
+    appendFormat(out, "  \"plots\": { \"total\": %llu, \"cancelled\": %llu },\n",
+                 static_cast<unsigned long long>(m_plotCount),
+                 static_cast<unsigned long long>(m_cancelledPlotCount));
+
+    out += "  \"sheet_totals\": {";
+    for (int status = 0; status < AcPlPlotProgress::kSheetCancelStatusCount; ++status)
+    {
+        appendFormat(out, "%s \"%s\": %llu", status != 0 ? "," : "",
+                     sheetStatusName(AcPlPlotProgress::SheetCancelStatus(status)),
+                     static_cast<unsigned long long>(m_sheetCounts[status]));
+    }
+    out += " },\n  \"phases\": {\n";
+
+    for (int phase = 0; phase < kPlotPhaseCount; ++phase)
+    {
+        const LatencyHistogram& h = m_histograms[phase];
+        appendFormat(out, "    \"%s\": { \"count\": %llu, \"min_ms\": %.3f, \"mean_ms\": %.3f, ",
+                     phaseName(PlotPhase(phase)), static_cast<unsigned long long>(h.count()),
+                     milliseconds(h.minimum()), h.mean() / 1e6);
+        appendFormat(out, "\"p50_ms\": %.3f, \"p90_ms\": %.3f, \"p99_ms\": %.3f, \"p999_ms\": %.3f, ",
+                     milliseconds(h.valueAtPercentile(50.0)), milliseconds(h.valueAtPercentile(90.0)),
+                     milliseconds(h.valueAtPercentile(99.0)), milliseconds(h.valueAtPercentile(99.9)));
+        appendFormat(out, "\"max_ms\": %.3f }%s\n", milliseconds(h.maximum()),
+                     phase + 1 < kPlotPhaseCount ? "," : "");
+    }
+    out += "  },\n  \"sheets\": [";
+
+    bool first = true;
+    for (const PlotSheetTelemetry& sheet : m_sheets)
+    {
+        out += first ? "\n    { " : ",\n    { ";
+        first = false;
+        appendFormat(out, "\"plot\": %u, \"page\": %u, \"document\": ", sheet.plot, sheet.page);
+        appendJsonString(out, sheet.document.constPtr());
+        out += ", \"drawing\": ";
+        appendJsonString(out, sheet.drawing.constPtr());
+        out += ", \"layout\": ";
+        appendJsonString(out, sheet.layout.constPtr());
+        appendFormat(out, ", \"entities\": %d, \"status\": \"%s\", ", int(sheet.entityCount),
+                     sheetStatusName(sheet.status));
+        appendFormat(out, "\"setup_start_ms\": %.3f, \"start_ms\": %.3f, \"end_ms\": %.3f, ",
+                     milliseconds(sheet.setupStart), milliseconds(sheet.pageStart), milliseconds(sheet.pageEnd));
+        appendFormat(out, "\"setup_ms\": %.3f, \"duration_ms\": %.3f }",
+                     milliseconds(sheet.pageStart - sheet.setupStart),
+                     milliseconds(sheet.pageEnd - sheet.pageStart));
+    }
+    out += first ? "]\n}\n" : "\n  ]\n}\n";
+    return out;
+}
+
+std::string PlotTelemetry::prometheusLocked() const
+{
+    std::string out;
+    out += "# HELP acad_plot_phase_duration_seconds Time spent in each phase of a plot.\n"
+           "# TYPE acad_plot_phase_duration_seconds histogram\n";
+    for (int phase = 0; phase < kPlotPhaseCount; ++phase)
+    {
+        const LatencyHistogram& h = m_histograms[phase];
+        const char* name = phaseName(PlotPhase(phase));
+        for (const double bound : kExportBounds)
+        {
+            appendFormat(out, "acad_plot_phase_duration_seconds_bucket{phase=\"%s\",le=\"%g\"} %llu\n", name, bound,
+                         static_cast<unsigned long long>(h.countAtOrBelow(Adesk::UInt64(bound * 1e9))));
+        }
+        appendFormat(out, "acad_plot_phase_duration_seconds_bucket{phase=\"%s\",le=\"+Inf\"} %llu\n", name,
+                     static_cast<unsigned long long>(h.count()));
+        appendFormat(out, "acad_plot_phase_duration_seconds_sum{phase=\"%s\"} %.9f\n", name,
+                     double(h.total()) / 1e9);
+        appendFormat(out, "acad_plot_phase_duration_seconds_count{phase=\"%s\"} %llu\n", name,
+                     static_cast<unsigned long long>(h.count()));
+    }
+
+    out += "# HELP acad_plot_sheets_total Sheets plotted, by how they ended.\n"
+           "# TYPE acad_plot_sheets_total counter\n";
+    for (int status = 0; status < AcPlPlotProgress::kSheetCancelStatusCount; ++status)
+    {
+        appendFormat(out, "acad_plot_sheets_total{status=\"%s\"} %llu\n",
+                     sheetStatusName(AcPlPlotProgress::SheetCancelStatus(status)),
+                     static_cast<unsigned long long>(m_sheetCounts[status]));
+    }
+
+    out += "# HELP acad_plot_plots_total Plots started.\n"
+           "# TYPE acad_plot_plots_total counter\n";
+    appendFormat(out, "acad_plot_plots_total %llu\n", static_cast<unsigned long long>(m_plotCount));
+    out += "# HELP acad_plot_cancelled_plots_total Plots that ended cancelled.\n"
+           "# TYPE acad_plot_cancelled_plots_total counter\n";
+    appendFormat(out, "acad_plot_cancelled_plots_total %llu\n", static_cast<unsigned long long>(m_cancelledPlotCount));
+    return out;
+}
+
+void plotTelemetryCommand(PlotTelemetry& telemetry)
+{
+    AcString jsonPath, prometheusPath;
+    if (acedGetString(1, ACRX_T("\nJSON file to export plot telemetry to <none>: "), jsonPath) != RTNORM)
+        return;
+    if (acedGetString(1, ACRX_T("\nPrometheus file to export plot telemetry to <none>: "), prometheusPath) != RTNORM)
+        return;
+    telemetry.setExportPaths(jsonPath.isEmpty() ? nullptr : jsonPath.kwszPtr(),
+                             prometheusPath.isEmpty() ? nullptr : prometheusPath.kwszPtr());
+
+    const LatencyHistogram sheets = telemetry.histogram(kPlotPhaseSheet);
+    acutPrintf(ACRX_T("\n%llu sheets plotted so far, median %.1f ms, 99th percentile %.1f ms.\n"),
+               static_cast<unsigned long long>(sheets.count()), sheets.valueAtPercentile(50.0) / 1e6,
+               sheets.valueAtPercentile(99.0) / 1e6);
+}
+
+} // namespace acad_sheetset_to_pdf
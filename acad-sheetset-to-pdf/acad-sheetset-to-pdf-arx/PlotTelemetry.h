@@ -0,0 +1,201 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// A histogram of durations in nanoseconds with a bounded relative error, in
+/// the manner of HdrHistogram: every power of two is split into 64 equal
+/// buckets (128 below 128 ns), so any recorded value is known to within
+/// 1/64 of itself whatever its magnitude, and recording is an increment.
+/// </summary>
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void record(Adesk::UInt64 nanoseconds);
+    void add(const LatencyHistogram& other);
+    void clear();
+
+    Adesk::UInt64 count() const { return m_count; }
+    Adesk::UInt64 minimum() const { return m_count != 0 ? m_minimum : 0; }
+    Adesk::UInt64 maximum() const { return m_maximum; }
+    Adesk::UInt64 total() const { return m_total; }
+    double mean() const;
+
+    /// <summary>
+    /// Smallest value that at least percentile (0 to 100) percent of the
+    /// recorded values are equivalent to or below, reported as the top of
+    /// its bucket and capped at the maximum.  0 for an empty histogram.
+    /// </summary>
+    Adesk::UInt64 valueAtPercentile(double percentile) const;
+
+    /// <summary>
+    /// Number of recorded values whose bucket lies entirely at or below
+    /// nanoseconds, for exporting into coarser buckets.
+    /// </summary>
+    Adesk::UInt64 countAtOrBelow(Adesk::UInt64 nanoseconds) const;
+
+private:
+    enum
+    {
+        kSubBucketBits = 7,
+        kSubBucketCount = 1 << kSubBucketBits,
+        kSubBucketHalf = kSubBucketCount / 2,
+        kBucketCount = (64 - kSubBucketBits + 2) * kSubBucketHalf
+    };
+
+    static size_t bucketOf(Adesk::UInt64 value);
+    static Adesk::UInt64 highestValueIn(size_t bucket);
+
+    std::vector<Adesk::UInt64> m_counts;
+    Adesk::UInt64              m_count;
+    Adesk::UInt64              m_minimum;
+    Adesk::UInt64              m_maximum;
+    Adesk::UInt64              m_total;
+};
+
+/// <summary>
+/// The stretches of a plot that PlotTelemetry times.
+/// </summary>
+enum PlotPhase
+{
+    kPlotPhaseWhole,        // beginPlot to endPlot
+    kPlotPhaseDocument,     // beginDocument to endDocument
+    kPlotPhaseSheetSetup,   // beginDocument or the previous endPage to beginPage
+    kPlotPhaseSheet,        // beginPage to endPage
+    kPlotPhaseFinish,       // the last endPage to endDocument (writing the file)
+    kPlotPhaseCount
+};
+
+/// <summary>
+/// What PlotTelemetry knows about one sheet.  Times are nanoseconds on the
+/// steady clock since the telemetry was created or last reset, so they keep
+/// their order even if the wall clock is adjusted during a long publish.
+/// </summary>
+struct PlotSheetTelemetry
+{
+    unsigned      plot = 0;             // 1-based, counted since the last reset
+    unsigned      page = 0;             // 1-based, within the document
+    AcString      document;             // name passed to beginDocument
+    AcString      drawing;
+    AcString      layout;
+    Adesk::Int32  entityCount = 0;
+    Adesk::UInt64 setupStart = 0;
+    Adesk::UInt64 pageStart = 0;
+    Adesk::UInt64 pageEnd = 0;
+    AcPlPlotProgress::SheetCancelStatus status = AcPlPlotProgress::kSheetContinue;
+};
+
+/// <summary>
+/// A plot reactor that records when every phase of every sheet starts and
+/// ends, aggregates the durations into one LatencyHistogram per PlotPhase,
+/// and exports the lot as JSON and in the Prometheus text exposition format.
+///
+/// The console driver hands -PUBLISH a LogFilePath, but AutoCAD keeps the
+/// log file open and the driver's copy of it regularly fails, so the only
+/// record of a publish job used to be lost.  Registering this reactor with
+/// acplPlotReactorMgr->addReactor() and calling setExportPaths() makes every
+/// plot leave its own files behind: they are rewritten atomically at every
+/// endPlot, and the Prometheus file can be picked up as is by a node exporter
+/// textfile collector.
+///
+/// Sheets are named after their layout and drawing when plotInfo.layout()
+/// can be opened, and "Sheet n" otherwise.  The most recent
+/// kPlotTelemetrySheetHistory sheets are kept; the histograms cover every
+/// sheet since the last reset.  Notifications arrive on AutoCAD's main
+/// thread, while the accessors and exporters may be called from any thread.
+/// </summary>
+class PlotTelemetry : public AcPlPlotReactor
+{
+public:
+    enum { kPlotTelemetrySheetHistory = 4096 };
+
+    PlotTelemetry();
+
+    void beginPlot(AcPlPlotProgress* pPlotProgress, PlotType type) override;
+    void beginDocument(AcPlPlotInfo& plotInfo, const ACHAR* pDocname, Adesk::Int32 nCopies, bool bPlotToFile,
+                       const ACHAR* pFilename) override;
+    void beginPage(AcPlPlotPageInfo& pageInfo, AcPlPlotInfo& plotInfo, bool bLastPage) override;
+    void endPage(AcPlPlotProgress::SheetCancelStatus status) override;
+    void endDocument(AcPlPlotProgress::PlotCancelStatus status) override;
+    void endPlot(AcPlPlotProgress::PlotCancelStatus status) override;
+    void plotCancelled() override;
+    void pageCancelled() override;
+
+    /// <summary>
+    /// Files written at the end of every plot.  Either may be null to skip
+    /// that format.
+    /// </summary>
+    void setExportPaths(const ACHAR* jsonPath, const ACHAR* prometheusPath);
+
+    /// <summary>
+    /// Status of the last export made at the end of a plot, since a reactor
+    /// has nobody to return it to.
+    /// </summary>
+    Acad::ErrorStatus lastExportStatus() const;
+
+    Acad::ErrorStatus exportJson(const ACHAR* path) const;
+    Acad::ErrorStatus exportPrometheus(const ACHAR* path) const;
+
+    /// <summary>
+    /// The exported documents, UTF-8 encoded.
+    /// </summary>
+    std::string json() const;
+    std::string prometheus() const;
+
+    LatencyHistogram histogram(PlotPhase phase) const;
+    std::vector<PlotSheetTelemetry> sheets() const;
+
+    /// <summary>
+    /// Forgets all sheets and durations and restarts the clock.  Must not be
+    /// called while a plot is in progress.
+    /// </summary>
+    void reset();
+
+    static const char* phaseName(PlotPhase phase);
+
+private:
+    Adesk::UInt64 now() const;
+    void finishSheet(Adesk::UInt64 time, AcPlPlotProgress::SheetCancelStatus status);
+    std::string jsonLocked() const;
+    std::string prometheusLocked() const;
+
+    mutable std::mutex                    m_mutex;
+    std::chrono::steady_clock::time_point m_epoch;
+    Adesk::Int64                          m_epochUnixMilliseconds;
+
+    LatencyHistogram                      m_histograms[kPlotPhaseCount];
+    std::deque<PlotSheetTelemetry>        m_sheets;
+    Adesk::UInt64                         m_plotCount;
+    Adesk::UInt64                         m_cancelledPlotCount;
+    Adesk::UInt64                         m_sheetCounts[AcPlPlotProgress::kSheetCancelStatusCount];
+
+    // The plot in progress.
+    bool                                  m_inPage;
+    bool                                  m_pageCancelled;
+    bool                                  m_plotCancelled;
+    unsigned                              m_page;
+    AcString                              m_document;
+    Adesk::UInt64                         m_plotStart;
+    Adesk::UInt64                         m_documentStart;
+    Adesk::UInt64                         m_lastBoundary;
+    PlotSheetTelemetry                    m_current;
+
+    std::wstring                          m_jsonPath;
+    std::wstring                          m_prometheusPath;
+    Acad::ErrorStatus                     m_lastExportStatus;
+};
+
+/// <summary>
+/// The SHEETSETTOPDFTELEMETRY command: asks for the JSON and Prometheus
+/// files telemetry exports to after every plot, an empty answer skipping
+/// that format, and reports the sheets recorded so far.
+/// </summary>
+void plotTelemetryCommand(PlotTelemetry& telemetry);
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,891 @@
+#include "stdafx.h"
+#include "PointCloudCylinderDetector.h"
+#include "ParallelFor.h"
+#include "ProgressReporter.h"
+
+#include <cfloat>
+#include <cmath>
+#include <random>
+#include <unordered_map>
+
+#include <emmintrin.h>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+const double   kPi                   = 3.14159265358979323846;
+const int      kArcBins              = 72;
+const size_t   kLoadChunkPoints      = size_t(1) << 20;
+const size_t   kInlierChunkPoints    = size_t(1) << 18;
+const size_t   kScoringPoints        = 32768;
+const unsigned kHypothesisBatch      = 128;   // fixed, so that results do not depend on the thread count
+const int      kSecondPointAttempts  = 8;
+const int      kRefinementPasses     = 3;
+const int      kCircleFitIterations  = 8;
+const int      kMinNormalNeighbours  = 5;
+const int      kMaxNormalNeighbours  = 128;
+const int      kRoundsPerCylinder    = 4;
+const double   kMinNormalAngleSine   = 0.05;  // about 3 degrees between the two sample normals
+const float    kPaddingCoordinate    = 1.0e30f;
+
+const double kLoadShare    = 0.10;
+const double kNormalsShare = 0.20;
+
+/* The cloud as single-precision structure-of-arrays, relative to the centre
+of its bounding box.  The arrays are padded to a multiple of four with points
+so far away that they never support anything, so the SSE2 loops need no
+scalar tail. */
+struct CloudArrays
+{
+    std::vector<float>        x, y, z;
+    std::vector<float>        nx, ny, nz;
+    std::vector<Adesk::UInt8> used;
+    size_t                    count = 0;
+    AcGePoint3d               centre;
+
+    void resize(size_t pointCount)
+    {
+        count = pointCount;
+        const size_t padded = (pointCount + 3) & ~size_t(3);
+        x.assign(padded, kPaddingCoordinate);
+        y.assign(padded, kPaddingCoordinate);
+        z.assign(padded, kPaddingCoordinate);
+        nx.assign(padded, 0.0f);
+        ny.assign(padded, 0.0f);
+        nz.assign(padded, 0.0f);
+        used.assign(padded, 1);
+    }
+
+    size_t padded() const { return x.size(); }
+
+    bool hasNormal(size_t i) const { return nx[i] != 0.0f || ny[i] != 0.0f || nz[i] != 0.0f; }
+};
+
+/* A cylinder in cloud coordinates: a point on the axis, the unit axis and
+the radius. */
+struct Cylinder
+{
+    double cx, cy, cz;
+    double ax, ay, az;
+    double radius;
+};
+
+/* Calls visit(first, bits) for every group of four points starting at first
+(a multiple of four) in [first, last) where at least one point supports the
+cylinder; bit k of bits is set if point first + k does.  A point supports
+the cylinder if its distance from the surface is at most epsilon and its
+normal is within the angle whose cosine is cosNormal of the radial
+direction.  The used flags are not looked at. */
+template <typename Visit>
+void forEachSupportingQuad(const CloudArrays& cloud, const Cylinder& cylinder, float epsilon, float cosNormal,
+                           size_t first, size_t last, Visit visit)
+{
+    const __m128 cx = _mm_set1_ps(static_cast<float>(cylinder.cx));
+    const __m128 cy = _mm_set1_ps(static_cast<float>(cylinder.cy));
+    const __m128 cz = _mm_set1_ps(static_cast<float>(cylinder.cz));
+    const __m128 ax = _mm_set1_ps(static_cast<float>(cylinder.ax));
+    const __m128 ay = _mm_set1_ps(static_cast<float>(cylinder.ay));
+    const __m128 az = _mm_set1_ps(static_cast<float>(cylinder.az));
+    const __m128 radius = _mm_set1_ps(static_cast<float>(cylinder.radius));
+    const __m128 eps = _mm_set1_ps(epsilon);
+    const __m128 cosN = _mm_set1_ps(cosNormal);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+    for (size_t i = first; i < last; i += 4)
+    {
+        const __m128 vx = _mm_sub_ps(_mm_loadu_ps(&cloud.x[i]), cx);
+        const __m128 vy = _mm_sub_ps(_mm_loadu_ps(&cloud.y[i]), cy);
+        const __m128 vz = _mm_sub_ps(_mm_loadu_ps(&cloud.z[i]), cz);
+        const __m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, ax), _mm_mul_ps(vy, ay)), _mm_mul_ps(vz, az));
+        const __m128 dx = _mm_sub_ps(vx, _mm_mul_ps(t, ax));
+        const __m128 dy = _mm_sub_ps(vy, _mm_mul_ps(t, ay));
+        const __m128 dz = _mm_sub_ps(vz, _mm_mul_ps(t, az));
+        const __m128 distance = _mm_sqrt_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+        const __m128 residual = _mm_and_ps(_mm_sub_ps(distance, radius), absMask);
+
+        // |n . d| >= cos * |d|, without dividing by |d|.
+        const __m128 nDotD = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&cloud.nx[i]), dx),
+                                                   _mm_mul_ps(_mm_loadu_ps(&cloud.ny[i]), dy)),
+                                        _mm_mul_ps(_mm_loadu_ps(&cloud.nz[i]), dz));
+        const __m128 supported = _mm_and_ps(_mm_cmple_ps(residual, eps),
+                                            _mm_cmpge_ps(_mm_and_ps(nDotD, absMask), _mm_mul_ps(cosN, distance)));
+        const int bits = _mm_movemask_ps(supported);
+        if (bits != 0)
+            visit(i, bits);
+    }
+}
+
+/* Eigenvector of the smallest eigenvalue of a symmetric 3x3 matrix, by
+cyclic Jacobi rotations. */
+AcGeVector3d smallestEigenvector(double m[3][3])
+{
+    double v[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+    for (int sweep = 0; sweep < 32; ++sweep)
+    {
+        const double offDiagonal = m[0][1] * m[0][1] + m[0][2] * m[0][2] + m[1][2] * m[1][2];
+        if (offDiagonal < 1e-30)
+            break;
+        for (int p = 0; p < 2; ++p)
+        {
+            for (int q = p + 1; q < 3; ++q)
+            {
+                if (std::fabs(m[p][q]) < 1e-300)
+                    continue;
+                const double theta = (m[q][q] - m[p][p]) / (2.0 * m[p][q]);
+                const double t = (theta >= 0.0 ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+                const double c = 1.0 / std::sqrt(t * t + 1.0);
+                const double s = t * c;
+                for (int k = 0; k < 3; ++k)
+                {
+                    const double mkp = m[k][p];
+                    const double mkq = m[k][q];
+                    m[k][p] = c * mkp - s * mkq;
+                    m[k][q] = s * mkp + c * mkq;
+                }
+                for (int k = 0; k < 3; ++k)
+                {
+                    const double mpk = m[p][k];
+                    const double mqk = m[q][k];
+                    m[p][k] = c * mpk - s * mqk;
+                    m[q][k] = s * mpk + c * mqk;
+                }
+                for (int k = 0; k < 3; ++k)
+                {
+                    const double vkp = v[k][p];
+                    const double vkq = v[k][q];
+                    v[k][p] = c * vkp - s * vkq;
+                    v[k][q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+    int smallest = 0;
+    for (int k = 1; k < 3; ++k)
+    {
+        if (m[k][k] < m[smallest][smallest])
+            smallest = k;
+    }
+    return AcGeVector3d(v[0][smallest], v[1][smallest], v[2][smallest]);
+}
+
+/* Solves a 3x3 linear system by Gaussian elimination with partial pivoting.
+Returns false if the matrix is singular. */
+bool solve3(double a[3][3], double b[3], double x[3])
+{
+    for (int col = 0; col < 3; ++col)
+    {
+        int pivot = col;
+        for (int row = col + 1; row < 3; ++row)
+        {
+            if (std::fabs(a[row][col]) > std::fabs(a[pivot][col]))
+                pivot = row;
+        }
+        if (std::fabs(a[pivot][col]) < 1e-300)
+            return false;
+        if (pivot != col)
+        {
+            for (int k = 0; k < 3; ++k)
+                std::swap(a[col][k], a[pivot][k]);
+            std::swap(b[col], b[pivot]);
+        }
+        for (int row = col + 1; row < 3; ++row)
+        {
+            const double factor = a[row][col] / a[col][col];
+            for (int k = col; k < 3; ++k)
+                a[row][k] -= factor * a[col][k];
+            b[row] -= factor * b[col];
+        }
+    }
+    for (int row = 2; row >= 0; --row)
+    {
+        double sum = b[row];
+        for (int k = row + 1; k < 3; ++k)
+            sum -= a[row][k] * x[k];
+        x[row] = sum / a[row][row];
+    }
+    return true;
+}
+
+/* A uniform hash grid over the cloud.  Point indices are sorted by cell so
+that every cell is a contiguous range of order(). */
+class VoxelGrid
+{
+public:
+    void build(const CloudArrays& cloud, double cellSize)
+    {
+        m_cellSize = cellSize;
+        std::vector<std::pair<Adesk::UInt64, Adesk::UInt32>> keyed;
+        keyed.reserve(cloud.count);
+        for (size_t i = 0; i < cloud.count; ++i)
+            keyed.emplace_back(keyOf(cloud.x[i], cloud.y[i], cloud.z[i]), static_cast<Adesk::UInt32>(i));
+        std::sort(keyed.begin(), keyed.end());
+
+        m_order.resize(keyed.size());
+        m_cells.clear();
+        m_cells.reserve(keyed.size() / 8 + 1);
+        for (size_t i = 0; i < keyed.size(); ++i)
+        {
+            m_order[i] = keyed[i].second;
+            if (i == 0 || keyed[i].first != keyed[i - 1].first)
+                m_cells[keyed[i].first] = std::make_pair(Adesk::UInt32(i), Adesk::UInt32(i));
+            ++m_cells[keyed[i].first].second;
+        }
+    }
+
+    /* Calls visit(pBegin, pEnd) for the indices in the cell of (x, y, z)
+    and the 26 cells around it, or in only the cell offset by neighbour (0 to
+    26) if neighbour is not negative. */
+    template <typename Visit>
+    void forEachNeighbourCell(float x, float y, float z, int neighbour, Visit visit) const
+    {
+        const Adesk::Int64 cx = cellOf(x);
+        const Adesk::Int64 cy = cellOf(y);
+        const Adesk::Int64 cz = cellOf(z);
+        for (int n = neighbour < 0 ? 0 : neighbour; n < (neighbour < 0 ? 27 : neighbour + 1); ++n)
+        {
+            const auto it = m_cells.find(pack(cx + n % 3 - 1, cy + (n / 3) % 3 - 1, cz + n / 9 - 1));
+            if (it != m_cells.end())
+                visit(m_order.data() + it->second.first, m_order.data() + it->second.second);
+        }
+    }
+
+private:
+    Adesk::Int64 cellOf(float coordinate) const
+    {
+        return static_cast<Adesk::Int64>(std::floor(coordinate / m_cellSize));
+    }
+
+    // 21 bits per axis, offset so that negative cells stay distinct.
+    static Adesk::UInt64 pack(Adesk::Int64 x, Adesk::Int64 y, Adesk::Int64 z)
+    {
+        const Adesk::Int64 bias = Adesk::Int64(1) << 20;
+        const Adesk::UInt64 mask = (Adesk::UInt64(1) << 21) - 1;
+        return (Adesk::UInt64(x + bias) & mask) | ((Adesk::UInt64(y + bias) & mask) << 21) |
+               ((Adesk::UInt64(z + bias) & mask) << 42);
+    }
+
+    Adesk::UInt64 keyOf(float x, float y, float z) const
+    {
+        return pack(cellOf(x), cellOf(y), cellOf(z));
+    }
+
+    double                                                             m_cellSize = 1.0;
+    std::vector<Adesk::UInt32>                                         m_order;
+    std::unordered_map<Adesk::UInt64, std::pair<Adesk::UInt32, Adesk::UInt32>> m_cells;
+};
+
+/* Fills in the normals of a cloud that has none from the principal axes of
+every point's neighbourhood.  Points with too few neighbours keep a zero
+normal, which keeps them out of samples and makes them support nothing. */
+bool estimateNormals(CloudArrays& cloud, double radius, unsigned threadCount, ProgressReporter& reporter)
+{
+    VoxelGrid grid;
+    grid.build(cloud, radius);
+    const float radiusSquared = static_cast<float>(radius * radius);
+    const size_t chunkCount = (cloud.count + kLoadChunkPoints - 1) / kLoadChunkPoints;
+
+    return parallelFor(chunkCount, threadCount,
+        [&](size_t chunk, unsigned)
+        {
+            const size_t first = chunk * kLoadChunkPoints;
+            const size_t last = std::min(first + kLoadChunkPoints, cloud.count);
+            for (size_t i = first; i < last; ++i)
+            {
+                const float px = cloud.x[i], py = cloud.y[i], pz = cloud.z[i];
+                double sum[3] = { 0, 0, 0 };
+                double products[6] = { 0, 0, 0, 0, 0, 0 };
+                int neighbours = 0;
+                grid.forEachNeighbourCell(px, py, pz, -1,
+                    [&](const Adesk::UInt32* pBegin, const Adesk::UInt32* pEnd)
+                    {
+                        for (const Adesk::UInt32* p = pBegin; p != pEnd && neighbours < kMaxNormalNeighbours; ++p)
+                        {
+                            const double dx = cloud.x[*p] - px;
+                            const double dy = cloud.y[*p] - py;
+                            const double dz = cloud.z[*p] - pz;
+                            if (dx * dx + dy * dy + dz * dz > radiusSquared)
+                                continue;
+                            sum[0] += dx; sum[1] += dy; sum[2] += dz;
+                            products[0] += dx * dx; products[1] += dx * dy; products[2] += dx * dz;
+                            products[3] += dy * dy; products[4] += dy * dz; products[5] += dz * dz;
+                            ++neighbours;
+                        }
+                    });
+                if (neighbours < kMinNormalNeighbours)
+                    continue;
+
+                const double n = neighbours;
+                double covariance[3][3];
+                covariance[0][0] = products[0] - sum[0] * sum[0] / n;
+                covariance[0][1] = covariance[1][0] = products[1] - sum[0] * sum[1] / n;
+                covariance[0][2] = covariance[2][0] = products[2] - sum[0] * sum[2] / n;
+                covariance[1][1] = products[3] - sum[1] * sum[1] / n;
+                covariance[1][2] = covariance[2][1] = products[4] - sum[1] * sum[2] / n;
+                covariance[2][2] = products[5] - sum[2] * sum[2] / n;
+                const AcGeVector3d normal = smallestEigenvector(covariance).normal();
+                cloud.nx[i] = static_cast<float>(normal.x);
+                cloud.ny[i] = static_cast<float>(normal.y);
+                cloud.nz[i] = static_cast<float>(normal.z);
+            }
+        },
+        [&](size_t completed)
+        {
+            return reporter.update(kLoadShare + kNormalsShare * double(completed) / double(chunkCount));
+        });
+}
+
+/* Builds the cylinder through two oriented points: the axis is perpendicular
+to both normals, and the axis point is where the normal lines meet.  Fails
+for (nearly) parallel normals and for points that disagree on the radius by
+more than epsilon. */
+bool cylinderFromSample(const CloudArrays& cloud, size_t i, size_t j, double epsilon, Cylinder& cylinder)
+{
+    const AcGeVector3d n1(cloud.nx[i], cloud.ny[i], cloud.nz[i]);
+    const AcGeVector3d n2(cloud.nx[j], cloud.ny[j], cloud.nz[j]);
+    AcGeVector3d axis = n1.crossProduct(n2);
+    if (axis.length() < kMinNormalAngleSine)
+        return false;
+    axis.normalize();
+
+    // Closest points of the lines p1 + s n1 and p2 + t n2.  Both lines are
+    // perpendicular to the axis, so they only differ along it.
+    const AcGeVector3d w(double(cloud.x[i]) - cloud.x[j], double(cloud.y[i]) - cloud.y[j], double(cloud.z[i]) - cloud.z[j]);
+    const double b = n1.dotProduct(n2);
+    const double d = n1.dotProduct(w);
+    const double e = n2.dotProduct(w);
+    const double denominator = 1.0 - b * b;
+    const double s = (b * e - d) / denominator;
+    const double t = (e - b * d) / denominator;
+    if (std::fabs(std::fabs(s) - std::fabs(t)) > epsilon)
+        return false;
+
+    cylinder.cx = 0.5 * (cloud.x[i] + s * n1.x + cloud.x[j] + t * n2.x);
+    cylinder.cy = 0.5 * (cloud.y[i] + s * n1.y + cloud.y[j] + t * n2.y);
+    cylinder.cz = 0.5 * (cloud.z[i] + s * n1.z + cloud.z[j] + t * n2.z);
+    cylinder.ax = axis.x;
+    cylinder.ay = axis.y;
+    cylinder.az = axis.z;
+    cylinder.radius = 0.5 * (std::fabs(s) + std::fabs(t));
+    return true;
+}
+
+/* Least-squares refinement over the supporting points.  The axis is the
+direction the normals are most perpendicular to; the centre and radius come
+from a geometric circle fit in the plane across the axis, started from the
+algebraic (Kasa) fit. */
+bool refineCylinder(const CloudArrays& cloud, const std::vector<Adesk::UInt32>& inliers, Cylinder& cylinder)
+{
+    if (inliers.size() < 3)
+        return false;
+
+    double normals[3][3] = { { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } };
+    for (const Adesk::UInt32 i : inliers)
+    {
+        const double n[3] = { cloud.nx[i], cloud.ny[i], cloud.nz[i] };
+        for (int r = 0; r < 3; ++r)
+        {
+            for (int c = 0; c < 3; ++c)
+                normals[r][c] += n[r] * n[c];
+        }
+    }
+    AcGeVector3d axis = smallestEigenvector(normals).normal();
+    if (axis.dotProduct(AcGeVector3d(cylinder.ax, cylinder.ay, cylinder.az)) < 0.0)
+        axis.negate();
+
+    const AcGeVector3d e1 = axis.perpVector().normal();
+    const AcGeVector3d e2 = axis.crossProduct(e1);
+    const AcGePoint3d origin(cylinder.cx, cylinder.cy, cylinder.cz);
+    std::vector<double> u(inliers.size()), v(inliers.size());
+    for (size_t k = 0; k < inliers.size(); ++k)
+    {
+        const Adesk::UInt32 i = inliers[k];
+        const AcGeVector3d q = AcGePoint3d(cloud.x[i], cloud.y[i], cloud.z[i]) - origin;
+        u[k] = q.dotProduct(e1);
+        v[k] = q.dotProduct(e2);
+    }
+
+    // Kasa: minimize the sum of (u^2 + v^2 + D u + E v + F)^2.
+    double a[3][3] = { { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } };
+    double rhs[3] = { 0, 0, 0 };
+    for (size_t k = 0; k < u.size(); ++k)
+    {
+        const double row[3] = { u[k], v[k], 1.0 };
+        const double z = u[k] * u[k] + v[k] * v[k];
+        for (int r = 0; r < 3; ++r)
+        {
+            for (int c = 0; c < 3; ++c)
+                a[r][c] += row[r] * row[c];
+            rhs[r] -= row[r] * z;
+        }
+    }
+    double solution[3];
+    if (!solve3(a, rhs, solution))
+        return false;
+    double centreU = -0.5 * solution[0];
+    double centreV = -0.5 * solution[1];
+    const double radiusSquared = centreU * centreU + centreV * centreV - solution[2];
+    if (!(radiusSquared > 0.0))
+        return false;
+    double radius = std::sqrt(radiusSquared);
+
+    // Gauss-Newton on the sum of (|q - c| - r)^2.
+    for (int iteration = 0; iteration < kCircleFitIterations; ++iteration)
+    {
+        double jtj[3][3] = { { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } };
+        double jtr[3] = { 0, 0, 0 };
+        for (size_t k = 0; k < u.size(); ++k)
+        {
+            const double du = u[k] - centreU;
+            const double dv = v[k] - centreV;
+            const double distance = std::sqrt(du * du + dv * dv);
+            if (distance <= 0.0)
+                continue;
+            const double jacobian[3] = { -du / distance, -dv / distance, -1.0 };
+            const double residual = distance - radius;
+            for (int r = 0; r < 3; ++r)
+            {
+                for (int c = 0; c < 3; ++c)
+                    jtj[r][c] += jacobian[r] * jacobian[c];
+                jtr[r] -= jacobian[r] * residual;
+            }
+        }
+        double step[3];
+        if (!solve3(jtj, jtr, step))
+            break;
+        centreU += step[0];
+        centreV += step[1];
+        radius += step[2];
+        if (std::fabs(step[0]) + std::fabs(step[1]) + std::fabs(step[2]) < 1e-9 * (1.0 + radius))
+            break;
+    }
+    if (!(radius > 0.0) || !std::isfinite(centreU) || !std::isfinite(centreV))
+        return false;
+
+    const AcGePoint3d centre = origin + e1 * centreU + e2 * centreV;
+    cylinder.cx = centre.x;
+    cylinder.cy = centre.y;
+    cylinder.cz = centre.z;
+    cylinder.ax = axis.x;
+    cylinder.ay = axis.y;
+    cylinder.az = axis.z;
+    cylinder.radius = radius;
+    return true;
+}
+
+/* Copies the buffer into cloud, in world coordinates relative to the centre
+of the bounding box, keeping every stride-th point. */
+bool loadCloud(const IAcDbPointCloudDataBuffer& pointCloud, Adesk::UInt64 stride, CloudArrays& cloud,
+               unsigned threadCount, ProgressReporter& reporter)
+{
+    const AcGePoint3d* pPoints = pointCloud.points();
+    const AcGeVector3d* pNormals = pointCloud.normals();
+    const AcGeMatrix3d& toWorld = pointCloud.transform();
+    const Adesk::UInt64 numPoints = pointCloud.numPoints();
+    const size_t count = static_cast<size_t>((numPoints + stride - 1) / stride);
+    cloud.resize(count);
+
+    AcGePoint3d minPoint(DBL_MAX, DBL_MAX, DBL_MAX);
+    AcGePoint3d maxPoint(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+    for (Adesk::UInt64 i = 0; i < numPoints; i += stride)
+    {
+        const AcGePoint3d p = toWorld * pPoints[i];
+        for (unsigned k = 0; k < 3; ++k)
+        {
+            minPoint[k] = std::min(minPoint[k], p[k]);
+            maxPoint[k] = std::max(maxPoint[k], p[k]);
+        }
+    }
+    cloud.centre = minPoint + (maxPoint - minPoint) * 0.5;
+
+    const size_t chunkCount = (count + kLoadChunkPoints - 1) / kLoadChunkPoints;
+    return parallelFor(chunkCount, threadCount,
+        [&](size_t chunk, unsigned)
+        {
+            const size_t first = chunk * kLoadChunkPoints;
+            const size_t last = std::min(first + kLoadChunkPoints, count);
+            for (size_t i = first; i < last; ++i)
+            {
+                const Adesk::UInt64 source = Adesk::UInt64(i) * stride;
+                const AcGeVector3d p = toWorld * pPoints[source] - cloud.centre;
+                cloud.x[i] = static_cast<float>(p.x);
+                cloud.y[i] = static_cast<float>(p.y);
+                cloud.z[i] = static_cast<float>(p.z);
+                cloud.used[i] = 0;
+                if (pNormals != nullptr)
+                {
+                    AcGeVector3d n = toWorld * pNormals[source];
+                    if (!n.isZeroLength())
+                    {
+                        n.normalize();
+                        cloud.nx[i] = static_cast<float>(n.x);
+                        cloud.ny[i] = static_cast<float>(n.y);
+                        cloud.nz[i] = static_cast<float>(n.z);
+                    }
+                }
+            }
+        },
+        [&](size_t completed)
+        {
+            return reporter.update(kLoadShare * double(completed) / double(chunkCount));
+        });
+}
+
+/* All state of one detection run. */
+class CylinderSearch
+{
+public:
+    CylinderSearch(CloudArrays& cloud, const PointCloudCylinderDetectionSettings& settings,
+                   unsigned threadCount, ProgressReporter& reporter)
+        : m_cloud(cloud)
+        , m_settings(settings)
+        , m_threadCount(threadCount)
+        , m_reporter(reporter)
+        , m_epsilon(settings.distanceThreshold)
+        , m_cosNormal(static_cast<float>(std::cos(settings.normalThreshold)))
+        , m_maxAxialGap(settings.maxAxialGap > 0.0 ? settings.maxAxialGap : 10.0 * settings.distanceThreshold)
+    {
+        double samplingRadius = settings.samplingRadius;
+        if (samplingRadius <= 0.0)
+            samplingRadius = settings.maxRadius > 0.0 ? 2.0 * settings.maxRadius : 50.0 * settings.distanceThreshold;
+        m_samplingRadiusSquared = samplingRadius * samplingRadius;
+        m_grid.build(cloud, samplingRadius);
+    }
+
+    /* Finds the next cylinder and marks its points used.  Returns false when
+    no cylinder with enough support is left. */
+    bool findNext(unsigned round, AcPointCloudExtractedCylinder& result, bool& found)
+    {
+        found = false;
+        collectCandidates();
+        if (m_candidates.size() < m_settings.minInliers)
+            return false;
+        buildScoringSample();
+
+        // Stage 1: hypotheses in fixed-size batches until the best one has
+        // been hit with the requested confidence.  The first point of a
+        // sample is uniform, the second local to it, so a sample hits a
+        // cylinder about as often as its first point does.
+        Cylinder best = {};
+        size_t bestScore = 0;
+        unsigned tried = 0;
+        double required = double(m_settings.maxIterations);
+        std::vector<Cylinder> batch(kHypothesisBatch);
+        std::vector<size_t> scores(kHypothesisBatch);
+        while (tried < m_settings.maxIterations && tried < required)
+        {
+            const unsigned batchSize = std::min(kHypothesisBatch, m_settings.maxIterations - tried);
+            const bool completed = parallelFor(batchSize, m_threadCount,
+                [&](size_t slot, unsigned)
+                {
+                    scores[slot] = 0;
+                    if (makeHypothesis(round, tried + static_cast<unsigned>(slot), batch[slot]))
+                        scores[slot] = score(batch[slot]);
+                },
+                [&](size_t)
+                {
+                    return !m_reporter.cancelled();
+                });
+            if (!completed)
+                return false;
+            for (unsigned slot = 0; slot < batchSize; ++slot)
+            {
+                if (scores[slot] > bestScore)
+                {
+                    bestScore = scores[slot];
+                    best = batch[slot];
+                }
+            }
+            tried += batchSize;
+            if (bestScore > 0)
+            {
+                const double inlierRatio = std::min(double(bestScore) / double(m_scoring.count), 0.999999);
+                required = std::log(1.0 - m_settings.confidence) / std::log(1.0 - inlierRatio);
+            }
+        }
+        if (bestScore == 0)
+            return false;
+
+        // Stage 2: refine against all remaining points.  The support of the
+        // best hypothesis is only judged after that: with estimated normals
+        // a sample of a thin pipe is often off in radius by a tenth, which
+        // keeps most of the pipe off its surface until it is refined.
+        std::vector<Adesk::UInt32> inliers;
+        collectInliers(best, inliers);
+        for (int pass = 0; pass < kRefinementPasses; ++pass)
+        {
+            Cylinder refined = best;
+            if (!refineCylinder(m_cloud, inliers, refined) || !radiusAccepted(refined.radius))
+                break;
+            std::vector<Adesk::UInt32> refinedInliers;
+            collectInliers(refined, refinedInliers);
+            if (refinedInliers.size() < inliers.size())
+                break;
+            best = refined;
+            inliers.swap(refinedInliers);
+        }
+        if (inliers.size() < m_settings.minInliers)
+            return false;
+
+        // Stage 3: keep the longest run along the axis.  Whatever happens,
+        // the points of this hypothesis leave the pool, so that a rejected
+        // hypothesis cannot come back.
+        const AcGeVector3d axis(best.ax, best.ay, best.az);
+        const AcGePoint3d axisPoint(best.cx, best.cy, best.cz);
+        std::vector<std::pair<double, Adesk::UInt32>> along;
+        along.reserve(inliers.size());
+        for (const Adesk::UInt32 i : inliers)
+            along.emplace_back((AcGePoint3d(m_cloud.x[i], m_cloud.y[i], m_cloud.z[i]) - axisPoint).dotProduct(axis), i);
+        std::sort(along.begin(), along.end());
+
+        size_t runBegin = 0, bestBegin = 0, bestEnd = 0;
+        for (size_t k = 1; k <= along.size(); ++k)
+        {
+            if (k == along.size() || along[k].first - along[k - 1].first > m_maxAxialGap)
+            {
+                if (k - runBegin > bestEnd - bestBegin)
+                {
+                    bestBegin = runBegin;
+                    bestEnd = k;
+                }
+                runBegin = k;
+            }
+        }
+        if (bestEnd - bestBegin < m_settings.minInliers || !radiusAccepted(best.radius) ||
+            arcCovered(best, along.data() + bestBegin, along.data() + bestEnd) < m_settings.minArcAngle)
+        {
+            for (const Adesk::UInt32 i : inliers)
+                m_cloud.used[i] = 1;
+            return true;
+        }
+        for (size_t k = bestBegin; k < bestEnd; ++k)
+            m_cloud.used[along[k].second] = 1;
+
+        const AcGePoint3d bottom = m_cloud.centre + (axisPoint + axis * along[bestBegin].first).asVector();
+        result.setOrigin(bottom);
+        result.setAxis(axis);
+        result.setRadius(best.radius);
+        result.setHeight(along[bestEnd - 1].first - along[bestBegin].first);
+        found = true;
+        return true;
+    }
+
+    double assignedFraction() const
+    {
+        return m_cloud.count > 0 ? 1.0 - double(m_candidates.size()) / double(m_cloud.count) : 1.0;
+    }
+
+private:
+    bool radiusAccepted(double radius) const
+    {
+        return radius >= m_settings.minRadius && (m_settings.maxRadius <= 0.0 || radius <= m_settings.maxRadius);
+    }
+
+    /* The arc around the axis that the points cover, in kArcBins sectors.
+    A sector only counts if it holds at least half its share of a uniform
+    spread, so stray points cannot make a strip look like a pipe. */
+    double arcCovered(const Cylinder& cylinder, const std::pair<double, Adesk::UInt32>* pBegin,
+                      const std::pair<double, Adesk::UInt32>* pEnd) const
+    {
+        const AcGeVector3d axis(cylinder.ax, cylinder.ay, cylinder.az);
+        const AcGeVector3d e1 = axis.perpVector().normal();
+        const AcGeVector3d e2 = axis.crossProduct(e1);
+        const AcGePoint3d axisPoint(cylinder.cx, cylinder.cy, cylinder.cz);
+        size_t counts[kArcBins] = {};
+        for (const std::pair<double, Adesk::UInt32>* p = pBegin; p != pEnd; ++p)
+        {
+            const Adesk::UInt32 i = p->second;
+            const AcGeVector3d q = AcGePoint3d(m_cloud.x[i], m_cloud.y[i], m_cloud.z[i]) - axisPoint;
+            const double angle = std::atan2(q.dotProduct(e2), q.dotProduct(e1)) + kPi;
+            ++counts[std::min(static_cast<int>(angle / (2.0 * kPi) * kArcBins), kArcBins - 1)];
+        }
+        const size_t minCount = std::max<size_t>(1, size_t(pEnd - pBegin) / (2 * kArcBins));
+        int covered = 0;
+        for (int k = 0; k < kArcBins; ++k)
+        {
+            if (counts[k] >= minCount)
+                ++covered;
+        }
+        return 2.0 * kPi * covered / kArcBins;
+    }
+
+    void collectCandidates()
+    {
+        m_candidates.clear();
+        for (size_t i = 0; i < m_cloud.count; ++i)
+        {
+            if (!m_cloud.used[i] && m_cloud.hasNormal(i))
+                m_candidates.push_back(static_cast<Adesk::UInt32>(i));
+        }
+    }
+
+    /* A regular subsample of the candidates, at most kScoringPoints, copied
+    into arrays of its own so that scoring runs over contiguous memory. */
+    void buildScoringSample()
+    {
+        const size_t stride = (m_candidates.size() + kScoringPoints - 1) / kScoringPoints;
+        m_scoring.resize((m_candidates.size() + stride - 1) / stride);
+        for (size_t k = 0; k < m_scoring.count; ++k)
+        {
+            const Adesk::UInt32 i = m_candidates[k * stride];
+            m_scoring.x[k] = m_cloud.x[i];
+            m_scoring.y[k] = m_cloud.y[i];
+            m_scoring.z[k] = m_cloud.z[i];
+            m_scoring.nx[k] = m_cloud.nx[i];
+            m_scoring.ny[k] = m_cloud.ny[i];
+            m_scoring.nz[k] = m_cloud.nz[i];
+        }
+    }
+
+    bool makeHypothesis(unsigned round, unsigned hypothesis, Cylinder& cylinder) const
+    {
+        std::seed_seq seed{ m_settings.seed, round, hypothesis };
+        std::mt19937 random(seed);
+        const Adesk::UInt32 first = m_candidates[random() % m_candidates.size()];
+        const float px = m_cloud.x[first], py = m_cloud.y[first], pz = m_cloud.z[first];
+
+        for (int attempt = 0; attempt < kSecondPointAttempts; ++attempt)
+        {
+            Adesk::UInt32 second = first;
+            m_grid.forEachNeighbourCell(px, py, pz, static_cast<int>(random() % 27),
+                [&](const Adesk::UInt32* pBegin, const Adesk::UInt32* pEnd)
+                {
+                    second = pBegin[random() % (pEnd - pBegin)];
+                });
+            if (second == first || m_cloud.used[second] || !m_cloud.hasNormal(second))
+                continue;
+            const double dx = m_cloud.x[second] - px;
+            const double dy = m_cloud.y[second] - py;
+            const double dz = m_cloud.z[second] - pz;
+            if (dx * dx + dy * dy + dz * dz > m_samplingRadiusSquared)
+                continue;
+            if (cylinderFromSample(m_cloud, first, second, m_epsilon, cylinder))
+                return radiusAccepted(cylinder.radius);
+        }
+        return false;
+    }
+
+    size_t score(const Cylinder& cylinder) const
+    {
+        size_t supporting = 0;
+        forEachSupportingQuad(m_scoring, cylinder, static_cast<float>(m_epsilon), m_cosNormal, 0, m_scoring.padded(),
+            [&](size_t, int bits)
+            {
+                supporting += (bits & 1) + ((bits >> 1) & 1) + ((bits >> 2) & 1) + ((bits >> 3) & 1);
+            });
+        return supporting;
+    }
+
+    /* All unused points that support the cylinder, in index order. */
+    void collectInliers(const Cylinder& cylinder, std::vector<Adesk::UInt32>& inliers) const
+    {
+        const size_t chunkCount = (m_cloud.padded() + kInlierChunkPoints - 1) / kInlierChunkPoints;
+        std::vector<std::vector<Adesk::UInt32>> chunkInliers(chunkCount);
+        parallelFor(chunkCount, m_threadCount,
+            [&](size_t chunk, unsigned)
+            {
+                const size_t first = chunk * kInlierChunkPoints;
+                const size_t last = std::min(first + kInlierChunkPoints, m_cloud.padded());
+                std::vector<Adesk::UInt32>& out = chunkInliers[chunk];
+                forEachSupportingQuad(m_cloud, cylinder, static_cast<float>(m_epsilon), m_cosNormal, first, last,
+                    [&](size_t quad, int bits)
+                    {
+                        for (int k = 0; k < 4; ++k)
+                        {
+                            if ((bits >> k) & 1 && !m_cloud.used[quad + k])
+                                out.push_back(static_cast<Adesk::UInt32>(quad + k));
+                        }
+                    });
+            });
+        inliers.clear();
+        for (const std::vector<Adesk::UInt32>& chunk : chunkInliers)
+            inliers.insert(inliers.end(), chunk.begin(), chunk.end());
+    }
+
+    CloudArrays&                               m_cloud;
+    const PointCloudCylinderDetectionSettings& m_settings;
+    unsigned                                   m_threadCount;
+    ProgressReporter&                          m_reporter;
+    double                                     m_epsilon;
+    float                                      m_cosNormal;
+    double                                     m_maxAxialGap;
+    double                                     m_samplingRadiusSquared;
+    VoxelGrid                                  m_grid;
+    std::vector<Adesk::UInt32>                 m_candidates;
+    CloudArrays                                m_scoring;
+};
+
+} // namespace
+
+Acad::ErrorStatus PointCloudCylinderDetector::detect(const IAcDbPointCloudDataBuffer& pointCloud,
+                                                     const PointCloudCylinderDetectionSettings& settings,
+                                                     AcArray<AcPointCloudExtractedCylinder>& cylinders,
+                                                     IPointCloudExtracProgressCallback* progress)
+{
+    if (!(settings.distanceThreshold > 0.0) || !(settings.confidence > 0.0 && settings.confidence < 1.0))
+        return Acad::eInvalidInput;
+    if (pointCloud.points() == nullptr || pointCloud.numPoints() == 0)
+        return Acad::eOk;
+
+    const unsigned threadCount = settings.threadCount > 0 ? settings.threadCount : defaultThreadCount();
+    ProgressReporter reporter(progress);
+
+    // Indices are 32 bits wide; larger clouds are always thinned.
+    Adesk::UInt64 maxPoints = settings.maxPoints > 0 ? settings.maxPoints : pointCloud.numPoints();
+    maxPoints = std::min<Adesk::UInt64>(maxPoints, 0xFFFFFFF0u);
+    const Adesk::UInt64 stride = (pointCloud.numPoints() + maxPoints - 1) / maxPoints;
+
+    reporter.caption(ACRX_T("Loading points"));
+    CloudArrays cloud;
+    if (!loadCloud(pointCloud, stride, cloud, threadCount, reporter))
+    {
+        reporter.end();
+        return Acad::eUserBreak;
+    }
+    if (pointCloud.normals() == nullptr)
+    {
+        reporter.caption(ACRX_T("Estimating normals"));
+        const double radius = settings.normalRadius > 0.0 ? settings.normalRadius : 5.0 * settings.distanceThreshold;
+        if (!estimateNormals(cloud, radius, threadCount, reporter))
+        {
+            reporter.end();
+            return Acad::eUserBreak;
+        }
+    }
+
+    reporter.caption(ACRX_T("Fitting cylinders"));
+    CylinderSearch search(cloud, settings, threadCount, reporter);
+    const unsigned maxRounds = settings.maxCylinders * kRoundsPerCylinder;
+    unsigned found = 0;
+    for (unsigned round = 0; round < maxRounds && found < settings.maxCylinders; ++round)
+    {
+        AcPointCloudExtractedCylinder cylinder;
+        bool isCylinder = false;
+        const bool more = search.findNext(round, cylinder, isCylinder);
+        if (reporter.cancelled())
+        {
+            reporter.end();
+            return Acad::eUserBreak;
+        }
+        if (isCylinder)
+        {
+            cylinders.append(cylinder);
+            ++found;
+        }
+        if (!more)
+            break;
+        const double searched = std::max(search.assignedFraction(), double(round + 1) / double(maxRounds));
+        if (!reporter.update(kLoadShare + kNormalsShare + (1.0 - kLoadShare - kNormalsShare) * searched))
+        {
+            reporter.end();
+            return Acad::eUserBreak;
+        }
+    }
+
+    reporter.update(1.0);
+    reporter.end();
+    return Acad::eOk;
+}
+
+} // namespace acad_sheetset_to_pdf
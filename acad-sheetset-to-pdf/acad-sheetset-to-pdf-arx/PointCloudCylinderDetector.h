@@ -0,0 +1,138 @@
+#pragma once
+
+#include "AcDbPointCloudApi.h"
+#include "AcPointCloudExtractor.h"
+#include "AcPointCloudExtractedCylinder.h"
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// Parameters of PointCloudCylinderDetector.  Only distanceThreshold is
+/// required; zero means "derive a sensible value" everywhere else.
+/// </summary>
+struct PointCloudCylinderDetectionSettings
+{
+    /// <summary>
+    /// Largest distance from the cylinder surface at which a point still
+    /// supports a cylinder; roughly the noise level of the scan.
+    /// </summary>
+    double   distanceThreshold = 0.0;
+
+    /// <summary>
+    /// Largest angle, in radians, between a supporting point's normal and the
+    /// direction from the axis to the point.
+    /// </summary>
+    double   normalThreshold = 0.35;
+
+    /// <summary>
+    /// Range of acceptable radii.  maxRadius 0 means unbounded.
+    /// </summary>
+    double   minRadius = 0.0;
+    double   maxRadius = 0.0;
+
+    /// <summary>
+    /// Smallest arc, in radians, that the supporting points must cover
+    /// around the axis.  Rejects the thin strip along which a cylinder
+    /// touches a plane, whose normals agree with the cylinder's.
+    /// </summary>
+    double   minArcAngle = 0.8;
+
+    /// <summary>
+    /// Fewest supporting points for a cylinder to be reported.
+    /// </summary>
+    unsigned minInliers = 500;
+
+    /// <summary>
+    /// Largest gap between supporting points along the axis.  Supporting
+    /// points further apart are taken to be two collinear pipes, and only the
+    /// longest run is reported at a time.  Defaults to ten times
+    /// distanceThreshold.
+    /// </summary>
+    double   maxAxialGap = 0.0;
+
+    /// <summary>
+    /// The second point of every sample is drawn from within this distance of
+    /// the first, which makes it much more likely that both lie on the same
+    /// pipe.  Defaults to twice maxRadius, or fifty times distanceThreshold
+    /// if the radius is unbounded.
+    /// </summary>
+    double   samplingRadius = 0.0;
+
+    /// <summary>
+    /// Radius of the neighbourhood used to estimate normals when the buffer
+    /// carries none.  Defaults to five times distanceThreshold.
+    /// </summary>
+    double   normalRadius = 0.0;
+
+    /// <summary>
+    /// Probability of having drawn at least one all-inlier sample of the best
+    /// cylinder found so far, at which the search for that cylinder stops.
+    /// </summary>
+    double   confidence = 0.99;
+
+    /// <summary>
+    /// Upper bounds on the work done per cylinder and on the cylinders found.
+    /// </summary>
+    unsigned maxIterations = 20000;
+    unsigned maxCylinders = 64;
+
+    /// <summary>
+    /// At most this many points are used, picked at a regular stride.  0 uses
+    /// all of them.
+    /// </summary>
+    Adesk::UInt64 maxPoints = 0;
+
+    /// <summary>
+    /// Seed of the sampling.  The same seed gives the same cylinders whatever
+    /// the number of threads.
+    /// </summary>
+    unsigned seed = 0;
+
+    /// <summary>
+    /// Worker threads.  Defaults to the number of hardware threads.
+    /// </summary>
+    unsigned threadCount = 0;
+};
+
+/// <summary>
+/// Finds cylinders (pipe runs) in a point cloud without user interaction,
+/// and reports them as AcPointCloudExtractedCylinder values: origin on the
+/// bottom cap, unit axis pointing to the top cap, radius and height.
+///
+/// Cylinders are found one at a time, most supported first, by RANSAC over
+/// the points not yet assigned to a cylinder:
+///   1. hypotheses are built from two oriented points (the axis is the cross
+///      product of the normals, the centre the intersection of the normal
+///      lines) and scored on a fixed subsample, in parallel batches;
+///   2. the search stops as soon as enough samples were drawn to hit the best
+///      cylinder with the requested confidence;
+///   3. the best hypothesis is refined by least squares over all supporting
+///      points (axis from the normals, centre and radius from a circle fit),
+///      cut to its longest run along the axis, checked for the arc it covers,
+///      and its supporting points are removed from the pool.
+///
+/// Residuals are evaluated four points at a time with SSE2 over a
+/// structure-of-arrays copy of the cloud, centred on its bounding box to
+/// keep single precision accurate far from the origin.  Every hypothesis
+/// draws from its own generator, seeded from settings.seed and its index, and
+/// batches have a fixed size, so the result does not depend on the thread
+/// count.
+///
+/// Normals are taken from the buffer when it has them, and estimated from the
+/// neighbourhood of every point otherwise.
+/// </summary>
+class PointCloudCylinderDetector
+{
+public:
+    /// <summary>
+    /// Appends the cylinders found to cylinders.  Returns Acad::eInvalidInput
+    /// for a non-positive distanceThreshold and Acad::eUserBreak if progress
+    /// was cancelled, in which case the cylinders found so far are kept.
+    /// </summary>
+    static Acad::ErrorStatus detect(const IAcDbPointCloudDataBuffer& pointCloud,
+                                    const PointCloudCylinderDetectionSettings& settings,
+                                    AcArray<AcPointCloudExtractedCylinder>& cylinders,
+                                    IPointCloudExtracProgressCallback* progress = nullptr);
+};
+
+} // namespace acad_sheetset_to_pdf
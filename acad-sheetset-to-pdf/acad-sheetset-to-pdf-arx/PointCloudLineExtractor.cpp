@@ -0,0 +1,1107 @@
+#include "stdafx.h"
+#include "PointCloudLineExtractor.h"
+#include "ParallelFor.h"
+#include "ProgressReporter.h"
+
+#include <cfloat>
+#include <cmath>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+const size_t        kProjectionChunkPoints = size_t(1) << 20;
+const Adesk::UInt64 kMaxGridCells          = Adesk::UInt64(1) << 31;   // 256 MB of occupancy bits
+const unsigned      kMaxTileCells          = 32768;                    // a tile's square fits in kMaxGridCells
+const int           kHoughAngles           = 180;                      // 1 degree resolution
+const int           kHoughMinVotes         = 8;
+const int           kMinTileSegmentCells   = 4;
+const int           kWalkRefinements       = 3;
+
+struct PlanePoint
+{
+    double u;
+    double v;
+};
+
+struct PlaneSegment
+{
+    double u0, v0;
+    double u1, v1;
+
+    double length() const { return std::hypot(u1 - u0, v1 - v0); }
+};
+
+/* Position of a projected point inside its tile.  Tiles are at most 65536
+cells wide, so 16 bits per axis are enough and halve the size of the binned
+copy of the slab. */
+struct TileCell
+{
+    Adesk::UInt16 x;
+    Adesk::UInt16 y;
+};
+
+/* Progress is measured in points: the projection stage is worth one unit per
+input point, the tile stage one unit per projected point (plus one per tile,
+so that empty tiles still count), and the final flush of lines what is left. */
+const double kProjectionShare = 0.20;
+const double kTileShare       = 0.75;
+
+/* The occupancy raster of the whole slab, one bit per cell, padded to whole
+tiles.  It is filled while the points are binned, before any tile is fitted,
+so that the outline test, which looks across the whole slab from a line, can
+run on the line as soon as it is final.  Memory is therefore not bounded per
+tile: an extraction holds this raster, four bytes per slab point for the
+binned cells and, per worker, the scratch of one tile. */
+class OccupancyGrid
+{
+public:
+    void reset(Adesk::UInt32 width, Adesk::UInt32 height)
+    {
+        m_width = width;
+        m_height = height;
+        m_wordsPerRow = (width + 63) / 64;
+        m_words.assign(size_t(m_wordsPerRow) * height, 0);
+    }
+
+    void set(Adesk::UInt32 x, Adesk::UInt32 y)
+    {
+        m_words[size_t(y) * m_wordsPerRow + x / 64] |= Adesk::UInt64(1) << (x % 64);
+    }
+
+    bool test(Adesk::Int64 x, Adesk::Int64 y) const
+    {
+        if (x < 0 || y < 0 || x >= m_width || y >= m_height)
+            return false;
+        return (m_words[size_t(y) * m_wordsPerRow + size_t(x) / 64] >> (x % 64)) & 1;
+    }
+
+    Adesk::UInt32 width() const { return m_width; }
+    Adesk::UInt32 height() const { return m_height; }
+
+private:
+    Adesk::UInt32              m_width = 0;
+    Adesk::UInt32              m_height = 0;
+    Adesk::UInt32              m_wordsPerRow = 0;
+    std::vector<Adesk::UInt64> m_words;
+};
+
+/* Per-worker scratch space for the Hough transform, reused across tiles.
+Between tiles the mask is all kCellEmpty and the accumulator all zero. */
+struct TileScratch
+{
+    std::vector<Adesk::UInt8>  mask;
+    std::vector<Adesk::Int32>  accumulator;
+    std::vector<Adesk::UInt32> cells;
+};
+
+enum CellState : Adesk::UInt8
+{
+    kCellEmpty = 0,
+    kCellOccupied,
+    kCellVoted,
+};
+
+struct HoughTables
+{
+    double cosine[kHoughAngles];
+    double sine[kHoughAngles];
+
+    HoughTables()
+    {
+        for (int a = 0; a < kHoughAngles; ++a)
+        {
+            const double theta = a * kPi / kHoughAngles;
+            cosine[a] = std::cos(theta);
+            sine[a] = std::sin(theta);
+        }
+    }
+};
+
+const HoughTables& houghTables()
+{
+    static const HoughTables tables;
+    return tables;
+}
+
+/* Everything the tile stage needs to know about the raster. */
+struct GridLayout
+{
+    double        originU;
+    double        originV;
+    double        cellSize;
+    Adesk::UInt32 tileCells;
+    Adesk::UInt32 tilesX;
+    Adesk::UInt32 tilesY;
+    int           gapCells;
+};
+
+/* Progressive probabilistic Hough transform over the occupied cells of one
+tile (Matas, Galambos and Kittler).  Cells are visited in a pseudo-random
+order seeded by the tile index, so the result does not depend on which thread
+ran the tile.  A cell votes for every line through it; as soon as one line
+collects enough votes it is walked in both directions, bridging gaps of up to
+gapCells, and every cell it covers (plus the cells immediately beside it, to
+swallow wall thickness) is removed together with its votes. */
+void fitTileSegments(const GridLayout& grid,
+                     size_t tileIndex,
+                     const TileCell* pCells,
+                     size_t cellCount,
+                     TileScratch& scratch,
+                     std::vector<PlaneSegment>& segments)
+{
+    const int tileCells = static_cast<int>(grid.tileCells);
+    const int rhoCount = 2 * static_cast<int>(std::ceil(tileCells * 1.41421356237)) + 1;
+    const int rhoOffset = rhoCount / 2;
+    const HoughTables& tables = houghTables();
+
+    /* Filled once per worker; after that each tile clears only the cells
+and votes it used, which for a sparse tile is far less than the whole. */
+    const size_t maskSize = size_t(tileCells) * tileCells;
+    const size_t accumulatorSize = size_t(kHoughAngles) * rhoCount;
+    if (scratch.mask.size() != maskSize)
+        scratch.mask.assign(maskSize, kCellEmpty);
+    if (scratch.accumulator.size() != accumulatorSize)
+        scratch.accumulator.assign(accumulatorSize, 0);
+    scratch.cells.clear();
+
+    for (size_t i = 0; i < cellCount; ++i)
+    {
+        const Adesk::UInt32 offset = Adesk::UInt32(pCells[i].y) * tileCells + pCells[i].x;
+        if (scratch.mask[offset] == kCellEmpty)
+        {
+            scratch.mask[offset] = kCellOccupied;
+            scratch.cells.push_back(offset);
+        }
+    }
+    if (scratch.cells.size() < size_t(kHoughMinVotes))
+    {
+        for (const Adesk::UInt32 offset : scratch.cells)
+            scratch.mask[offset] = kCellEmpty;
+        return;
+    }
+
+    std::mt19937 random(static_cast<std::mt19937::result_type>(tileIndex * 2654435761u + 1));
+    for (size_t i = scratch.cells.size() - 1; i > 0; --i)
+    {
+        const size_t j = random() % (i + 1);
+        std::swap(scratch.cells[i], scratch.cells[j]);
+    }
+
+    auto state = [&](int x, int y) -> Adesk::UInt8
+    {
+        if (x < 0 || y < 0 || x >= tileCells || y >= tileCells)
+            return kCellEmpty;
+        return scratch.mask[size_t(y) * tileCells + x];
+    };
+    auto vote = [&](int x, int y, int delta)
+    {
+        for (int a = 0; a < kHoughAngles; ++a)
+        {
+            const int rho = static_cast<int>(std::lround(x * tables.cosine[a] + y * tables.sine[a])) + rhoOffset;
+            scratch.accumulator[size_t(a) * rhoCount + rho] += delta;
+        }
+    };
+
+    const double tileOriginU = grid.originU + (tileIndex % grid.tilesX) * double(tileCells) * grid.cellSize;
+    const double tileOriginV = grid.originV + (tileIndex / grid.tilesX) * double(tileCells) * grid.cellSize;
+
+    for (const Adesk::UInt32 seed : scratch.cells)
+    {
+        const int seedX = static_cast<int>(seed % tileCells);
+        const int seedY = static_cast<int>(seed / tileCells);
+        if (scratch.mask[seed] != kCellOccupied)
+            continue;
+
+        int bestAngle = 0;
+        int bestVotes = 0;
+        for (int a = 0; a < kHoughAngles; ++a)
+        {
+            const int rho = static_cast<int>(std::lround(seedX * tables.cosine[a] + seedY * tables.sine[a])) + rhoOffset;
+            const int votes = ++scratch.accumulator[size_t(a) * rhoCount + rho];
+            if (votes > bestVotes)
+            {
+                bestVotes = votes;
+                bestAngle = a;
+            }
+        }
+        scratch.mask[seed] = kCellVoted;
+        if (bestVotes < kHoughMinVotes)
+            continue;
+
+        // The line direction is perpendicular to the (cos, sin) normal.  Step
+        // one cell at a time along the major axis of that direction.
+        double dx = -tables.sine[bestAngle];
+        double dy = tables.cosine[bestAngle];
+        bool xMajor = std::fabs(dx) >= std::fabs(dy);
+
+        auto hit = [&](int x, int y)
+        {
+            if (state(x, y) != kCellEmpty)
+                return true;
+            return xMajor ? (state(x, y - 1) != kCellEmpty || state(x, y + 1) != kCellEmpty)
+                          : (state(x - 1, y) != kCellEmpty || state(x + 1, y) != kCellEmpty);
+        };
+
+        int endX[2] = { seedX, seedX };
+        int endY[2] = { seedY, seedY };
+        auto walk = [&](double startX, double startY)
+        {
+            xMajor = std::fabs(dx) >= std::fabs(dy);
+            const double scale = 1.0 / (xMajor ? std::fabs(dx) : std::fabs(dy));
+            const double stepX = dx * scale;
+            const double stepY = dy * scale;
+            for (int k = 0; k < 2; ++k)
+            {
+                const double sign = k == 0 ? 1.0 : -1.0;
+                double px = startX;
+                double py = startY;
+                int gap = 0;
+                endX[k] = static_cast<int>(std::floor(px));
+                endY[k] = static_cast<int>(std::floor(py));
+                for (;;)
+                {
+                    px += sign * stepX;
+                    py += sign * stepY;
+                    const int x = static_cast<int>(std::floor(px));
+                    const int y = static_cast<int>(std::floor(py));
+                    if (x < 0 || y < 0 || x >= tileCells || y >= tileCells)
+                        break;
+                    if (hit(x, y))
+                    {
+                        gap = 0;
+                        endX[k] = x;
+                        endY[k] = y;
+                    }
+                    else if (++gap > grid.gapCells)
+                    {
+                        break;
+                    }
+                }
+            }
+        };
+
+        // The first votes only fix the angle to within a few degrees, which
+        // walks off a long wall before its end.  The ends found give a far
+        // better direction; walk again along it, through their midpoint,
+        // while that still lengthens the segment.
+        walk(seedX + 0.5, seedY + 0.5);
+        for (int pass = 0; pass < kWalkRefinements; ++pass)
+        {
+            const int length = std::max(std::abs(endX[0] - endX[1]), std::abs(endY[0] - endY[1]));
+            if (length < kMinTileSegmentCells)
+                break;
+            const int previousEnds[4] = { endX[0], endY[0], endX[1], endY[1] };
+            const double midX = (endX[0] + endX[1]) * 0.5 + 0.5;
+            const double midY = (endY[0] + endY[1]) * 0.5 + 0.5;
+            const double previousDx = dx;
+            const double previousDy = dy;
+            dx = endX[0] - endX[1];
+            dy = endY[0] - endY[1];
+            walk(midX, midY);
+            if (std::max(std::abs(endX[0] - endX[1]), std::abs(endY[0] - endY[1])) <= length)
+            {
+                dx = previousDx;
+                dy = previousDy;
+                xMajor = std::fabs(dx) >= std::fabs(dy);
+                endX[0] = previousEnds[0];
+                endY[0] = previousEnds[1];
+                endX[1] = previousEnds[2];
+                endY[1] = previousEnds[3];
+                break;
+            }
+        }
+
+        // Too short to be a line: the seed keeps its votes and waits for more
+        // cells to join it.
+        const int steps = std::max(std::abs(endX[1] - endX[0]), std::abs(endY[1] - endY[0]));
+        if (steps < kMinTileSegmentCells)
+            continue;
+
+        // Walk the segment again and remove what it covers.
+        double px = endX[1] + 0.5;
+        double py = endY[1] + 0.5;
+        const double stepX = double(endX[0] - endX[1]) / steps;
+        const double stepY = double(endY[0] - endY[1]) / steps;
+        for (int s = 0; s <= steps; ++s, px += stepX, py += stepY)
+        {
+            const int x = static_cast<int>(std::floor(px));
+            const int y = static_cast<int>(std::floor(py));
+            for (int side = -1; side <= 1; ++side)
+            {
+                const int cx = xMajor ? x : x + side;
+                const int cy = xMajor ? y + side : y;
+                const Adesk::UInt8 cellState = state(cx, cy);
+                if (cellState == kCellEmpty)
+                    continue;
+                if (cellState == kCellVoted)
+                    vote(cx, cy, -1);
+                scratch.mask[size_t(cy) * tileCells + cx] = kCellEmpty;
+            }
+        }
+
+        PlaneSegment segment;
+        segment.u0 = tileOriginU + (endX[1] + 0.5) * grid.cellSize;
+        segment.v0 = tileOriginV + (endY[1] + 0.5) * grid.cellSize;
+        segment.u1 = tileOriginU + (endX[0] + 0.5) * grid.cellSize;
+        segment.v1 = tileOriginV + (endY[0] + 0.5) * grid.cellSize;
+        segments.push_back(segment);
+    }
+
+    /* Take back the votes of the cells no line claimed. */
+    for (const Adesk::UInt32 offset : scratch.cells)
+    {
+        if (scratch.mask[offset] == kCellVoted)
+            vote(static_cast<int>(offset % tileCells), static_cast<int>(offset / tileCells), -1);
+        scratch.mask[offset] = kCellEmpty;
+    }
+}
+
+
+/* Direction angle of a segment, folded into [0, pi). */
+double segmentAngle(const PlaneSegment& s)
+{
+    double angle = std::atan2(s.v1 - s.v0, s.u1 - s.u0);
+    if (angle < 0.0)
+        angle += kPi;
+    if (angle >= kPi)
+        angle -= kPi;
+    return angle;
+}
+
+/* A fitted piece of a line.  The key orders pieces deterministically: the
+tile in the high half, the position in the tile's fitting order in the low
+half. */
+struct LinePiece
+{
+    PlaneSegment  segment;
+    Adesk::UInt64 key;
+};
+
+/* The reference of a pair of pieces is the longer one, or the one with the
+smaller key if both are equally long, so that mergeable(a, b) and
+mergeable(b, a) always agree. */
+bool isReference(const LinePiece& a, const LinePiece& b)
+{
+    const double lengthA = a.segment.length();
+    const double lengthB = b.segment.length();
+    return lengthA != lengthB ? lengthA > lengthB : a.key < b.key;
+}
+
+/* Two pieces belong to the same line if the angle between them is at most
+maxAngle, give or take what rounding their ends to whole cells can tilt the
+shorter one by, both endpoints of the other piece lie within maxGap of the
+reference's line, and the gap between them along that line is at most
+maxGap.  Beyond the reference's ends its line is only as good as its angle,
+so an endpoint out there may stray further from it, by as much as maxAngle
+allows over its distance from the nearer end. */
+bool mergeable(const LinePiece& a, const LinePiece& b, double maxAngle, double maxGap, double cellSize)
+{
+    double angleDifference = std::fabs(segmentAngle(a.segment) - segmentAngle(b.segment));
+    angleDifference = std::min(angleDifference, kPi - angleDifference);
+    const double shorter = std::min(a.segment.length(), b.segment.length());
+    const double rounding = shorter > 2.0 * cellSize ? std::asin(2.0 * cellSize / shorter) : kPi;
+    if (angleDifference > maxAngle + rounding)
+        return false;
+
+    const bool aIsReference = isReference(a, b);
+    const PlaneSegment& reference = aIsReference ? a.segment : b.segment;
+    const PlaneSegment& other = aIsReference ? b.segment : a.segment;
+    const double length = reference.length();
+    if (length <= 0.0)
+        return false;
+    const double du = (reference.u1 - reference.u0) / length;
+    const double dv = (reference.v1 - reference.v0) / length;
+
+    auto along = [&](double u, double v) { return (u - reference.u0) * du + (v - reference.v0) * dv; };
+    auto across = [&](double u, double v) { return (u - reference.u0) * -dv + (v - reference.v0) * du; };
+
+    const double s0 = along(other.u0, other.v0);
+    const double s1 = along(other.u1, other.v1);
+    const double slope = std::tan(maxAngle);
+    auto allowedAcross = [&](double s) { return maxGap + std::max(0.0, std::max(-s, s - length)) * slope; };
+    if (std::fabs(across(other.u0, other.v0)) > allowedAcross(s0) ||
+        std::fabs(across(other.u1, other.v1)) > allowedAcross(s1))
+        return false;
+
+    return std::min(s0, s1) <= length + maxGap && std::max(s0, s1) >= -maxGap;
+}
+
+/* A line handed out by SegmentMerger, with the key of its first piece. */
+struct FinishedLine
+{
+    Adesk::UInt64 key;
+    PlaneSegment  segment;
+};
+
+/* Joins the pieces fitted in the tiles into lines while tiles are still
+being fitted, and hands out every line as soon as no tile that has yet to
+complete could add to it.
+
+Lines are the connected components of the mergeable() relation between
+pieces, tracked with a union-find.  The relation is symmetric, and the
+components of a graph do not depend on the order its edges are found in, so
+the lines do not depend on the order tiles complete in.  A piece can only be
+mergeable with pieces in tiles that come within reach of it, which is what
+makes a line final once all tiles within reach of its bounding box are done.
+
+A line's piece lists are dropped when it is handed out, so apart from a few
+dozen bytes per fitted piece the merger only holds the lines along the
+boundary between completed and pending tiles. */
+class SegmentMerger
+{
+public:
+    SegmentMerger(const GridLayout& layout, double maxAngle, double maxGap)
+        : m_layout(layout)
+        , m_maxAngle(maxAngle)
+        , m_maxGap(maxGap)
+        , m_tileSize(layout.tileCells * layout.cellSize)
+        , m_tilePieces(size_t(layout.tilesX) * layout.tilesY)
+        , m_tileDone(size_t(layout.tilesX) * layout.tilesY, false)
+    {
+    }
+
+    void addTile(size_t tile, const std::vector<PlaneSegment>& segments)
+    {
+        m_tileDone[tile] = true;
+        std::vector<size_t> added;
+        added.reserve(segments.size());
+        for (size_t i = 0; i < segments.size(); ++i)
+        {
+            const size_t id = m_pieces.size();
+            LinePiece piece;
+            piece.segment = segments[i];
+            piece.key = (Adesk::UInt64(tile) << 32) | i;
+            m_pieces.push_back(piece);
+            m_parent.push_back(id);
+
+            Line& line = m_lines[id];
+            line.minU = std::min(piece.segment.u0, piece.segment.u1);
+            line.minV = std::min(piece.segment.v0, piece.segment.v1);
+            line.maxU = std::max(piece.segment.u0, piece.segment.u1);
+            line.maxV = std::max(piece.segment.v0, piece.segment.v1);
+            line.key = piece.key;
+            line.pieces.push_back(id);
+            m_tilePieces[tile].push_back(id);
+            added.push_back(id);
+        }
+
+        for (const size_t id : added)
+        {
+            const PlaneSegment& s = m_pieces[id].segment;
+            Adesk::UInt32 x0, y0, x1, y1;
+            tilesInReach(std::min(s.u0, s.u1), std::min(s.v0, s.v1), std::max(s.u0, s.u1), std::max(s.v0, s.v1),
+                         x0, y0, x1, y1);
+            for (Adesk::UInt32 y = y0; y <= y1; ++y)
+            {
+                for (Adesk::UInt32 x = x0; x <= x1; ++x)
+                {
+                    const size_t other = size_t(y) * m_layout.tilesX + x;
+                    if (!m_tileDone[other])
+                        continue;
+                    for (const size_t candidate : m_tilePieces[other])
+                    {
+                        if (candidate != id && find(candidate) != find(id) &&
+                            mergeable(m_pieces[id], m_pieces[candidate], m_maxAngle, m_maxGap, m_layout.cellSize))
+                            unite(id, candidate);
+                    }
+                }
+            }
+        }
+    }
+
+    /* Appends every line that can no longer change, in key order. */
+    void takeFinished(std::vector<FinishedLine>& finished)
+    {
+        const size_t firstFinished = finished.size();
+        for (auto it = m_lines.begin(); it != m_lines.end();)
+        {
+            Line& line = it->second;
+            if (!isFinal(line))
+            {
+                ++it;
+                continue;
+            }
+            FinishedLine result;
+            result.key = line.key;
+            result.segment = collapse(line);
+            finished.push_back(result);
+            for (const size_t id : line.pieces)
+            {
+                std::vector<size_t>& tilePieces = m_tilePieces[size_t(m_pieces[id].key >> 32)];
+                tilePieces.erase(std::remove(tilePieces.begin(), tilePieces.end(), id), tilePieces.end());
+            }
+            it = m_lines.erase(it);
+        }
+        std::sort(finished.begin() + firstFinished, finished.end(),
+                  [](const FinishedLine& a, const FinishedLine& b) { return a.key < b.key; });
+    }
+
+private:
+    struct Line
+    {
+        double              minU, minV, maxU, maxV;
+        Adesk::UInt64       key;
+        std::vector<size_t> pieces;
+    };
+
+    size_t find(size_t id)
+    {
+        while (m_parent[id] != id)
+        {
+            m_parent[id] = m_parent[m_parent[id]];
+            id = m_parent[id];
+        }
+        return id;
+    }
+
+    void unite(size_t a, size_t b)
+    {
+        size_t rootA = find(a);
+        size_t rootB = find(b);
+        Line* pLineA = &m_lines[rootA];
+        Line* pLineB = &m_lines[rootB];
+        if (pLineA->pieces.size() < pLineB->pieces.size())
+        {
+            std::swap(rootA, rootB);
+            std::swap(pLineA, pLineB);
+        }
+        pLineA->minU = std::min(pLineA->minU, pLineB->minU);
+        pLineA->minV = std::min(pLineA->minV, pLineB->minV);
+        pLineA->maxU = std::max(pLineA->maxU, pLineB->maxU);
+        pLineA->maxV = std::max(pLineA->maxV, pLineB->maxV);
+        pLineA->key = std::min(pLineA->key, pLineB->key);
+        pLineA->pieces.insert(pLineA->pieces.end(), pLineB->pieces.begin(), pLineB->pieces.end());
+        m_parent[rootB] = rootA;
+        m_lines.erase(rootB);
+    }
+
+    /* Anything mergeable with a piece comes within 1.5 maxGap of it (maxGap
+    across the line and maxGap along it); round that up to whole tiles. */
+    void tilesInReach(double minU, double minV, double maxU, double maxV,
+                      Adesk::UInt32& x0, Adesk::UInt32& y0, Adesk::UInt32& x1, Adesk::UInt32& y1) const
+    {
+        const double reach = 2.0 * m_maxGap;
+        auto tileOf = [&](double coordinate, double origin, Adesk::UInt32 tiles)
+        {
+            const double t = std::floor((coordinate - origin) / m_tileSize);
+            return static_cast<Adesk::UInt32>(std::min(std::max(t, 0.0), double(tiles - 1)));
+        };
+        x0 = tileOf(minU - reach, m_layout.originU, m_layout.tilesX);
+        y0 = tileOf(minV - reach, m_layout.originV, m_layout.tilesY);
+        x1 = tileOf(maxU + reach, m_layout.originU, m_layout.tilesX);
+        y1 = tileOf(maxV + reach, m_layout.originV, m_layout.tilesY);
+    }
+
+    bool isFinal(const Line& line) const
+    {
+        Adesk::UInt32 x0, y0, x1, y1;
+        tilesInReach(line.minU, line.minV, line.maxU, line.maxV, x0, y0, x1, y1);
+        for (Adesk::UInt32 y = y0; y <= y1; ++y)
+        {
+            for (Adesk::UInt32 x = x0; x <= x1; ++x)
+            {
+                if (!m_tileDone[size_t(y) * m_layout.tilesX + x])
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    /* The line runs through the length-weighted centre of its pieces, along
+    the principal axis of their endpoints, and spans the projections of all
+    their endpoints.  Fitting the endpoints of the whole line evens out the
+    tilt that rounding to whole cells gives each short piece cut at a tile
+    border; averaging the pieces' directions would keep it.  Pieces are summed
+    in key order so that the result is bit-identical however the line grew. */
+    PlaneSegment collapse(Line& line) const
+    {
+        if (line.pieces.size() == 1)
+            return m_pieces[line.pieces.front()].segment;
+
+        std::sort(line.pieces.begin(), line.pieces.end(),
+                  [&](size_t a, size_t b) { return m_pieces[a].key < m_pieces[b].key; });
+        const LinePiece* pReference = &m_pieces[line.pieces.front()];
+        for (const size_t id : line.pieces)
+        {
+            if (isReference(m_pieces[id], *pReference))
+                pReference = &m_pieces[id];
+        }
+        const PlaneSegment& reference = pReference->segment;
+
+        double sumU = 0.0, sumV = 0.0, sumLength = 0.0;
+        for (const size_t id : line.pieces)
+        {
+            const PlaneSegment& s = m_pieces[id].segment;
+            const double length = s.length();
+            sumU += (s.u0 + s.u1) * 0.5 * length;
+            sumV += (s.v0 + s.v1) * 0.5 * length;
+            sumLength += length;
+        }
+        if (sumLength <= 0.0)
+            return reference;
+        const double centreU = sumU / sumLength;
+        const double centreV = sumV / sumLength;
+
+        double sumUU = 0.0, sumUV = 0.0, sumVV = 0.0;
+        auto addEnd = [&](double u, double v, double weight)
+        {
+            u -= centreU;
+            v -= centreV;
+            sumUU += weight * u * u;
+            sumUV += weight * u * v;
+            sumVV += weight * v * v;
+        };
+        for (const size_t id : line.pieces)
+        {
+            const PlaneSegment& s = m_pieces[id].segment;
+            const double weight = s.length() * 0.5;
+            addEnd(s.u0, s.v0, weight);
+            addEnd(s.u1, s.v1, weight);
+        }
+        const double axis = 0.5 * std::atan2(2.0 * sumUV, sumUU - sumVV);
+        double du = std::cos(axis);
+        double dv = std::sin(axis);
+        if ((reference.u1 - reference.u0) * du + (reference.v1 - reference.v0) * dv < 0.0)
+        {
+            du = -du;
+            dv = -dv;
+        }
+
+        double lo = DBL_MAX;
+        double hi = -DBL_MAX;
+        for (const size_t id : line.pieces)
+        {
+            const PlaneSegment& s = m_pieces[id].segment;
+            const double s0 = (s.u0 - centreU) * du + (s.v0 - centreV) * dv;
+            const double s1 = (s.u1 - centreU) * du + (s.v1 - centreV) * dv;
+            lo = std::min(lo, std::min(s0, s1));
+            hi = std::max(hi, std::max(s0, s1));
+        }
+
+        PlaneSegment result;
+        result.u0 = centreU + du * lo;
+        result.v0 = centreV + dv * lo;
+        result.u1 = centreU + du * hi;
+        result.v1 = centreV + dv * hi;
+        return result;
+    }
+
+    const GridLayout&                  m_layout;
+    double                             m_maxAngle;
+    double                             m_maxGap;
+    double                             m_tileSize;
+    std::vector<LinePiece>             m_pieces;
+    std::vector<size_t>                m_parent;
+    std::unordered_map<size_t, Line>   m_lines;        // keyed by union-find root
+    std::vector<std::vector<size_t>>   m_tilePieces;   // pieces of unfinished lines
+    std::vector<bool>                  m_tileDone;
+};
+
+/* A segment is part of the outline if, looking away from it along its normal
+on at least one side, there is nothing but empty cells up to the edge of the
+raster. */
+bool isOutlineSegment(const PlaneSegment& segment, const OccupancyGrid& grid, const GridLayout& layout)
+{
+    const double length = segment.length();
+    if (length <= 0.0)
+        return false;
+    const double nu = -(segment.v1 - segment.v0) / length;
+    const double nv = (segment.u1 - segment.u0) / length;
+    const double midU = (segment.u0 + segment.u1) * 0.5;
+    const double midV = (segment.v0 + segment.v1) * 0.5;
+    const double clearance = (layout.gapCells + 2) * layout.cellSize;
+
+    for (int side = -1; side <= 1; side += 2)
+    {
+        double u = midU + side * nu * clearance;
+        double v = midV + side * nv * clearance;
+        bool blocked = false;
+        for (;;)
+        {
+            const double cx = (u - layout.originU) / layout.cellSize;
+            const double cy = (v - layout.originV) / layout.cellSize;
+            if (cx < 0.0 || cy < 0.0 || cx >= grid.width() || cy >= grid.height())
+                break;
+            if (grid.test(static_cast<Adesk::Int64>(cx), static_cast<Adesk::Int64>(cy)))
+            {
+                blocked = true;
+                break;
+            }
+            u += side * nu * layout.cellSize;
+            v += side * nv * layout.cellSize;
+        }
+        if (!blocked)
+            return true;
+    }
+    return false;
+}
+
+/* Where the lines of one extraction go. */
+class LineSink
+{
+public:
+    virtual ~LineSink() {}
+    virtual void begin(const AcGeMatrix3d& transform, const AcGePlane& projectedPlane) = 0;
+    virtual void addLines(const std::vector<FinishedLine>& lines) = 0;
+};
+
+/* Forwards lines to the caller of extractStreaming as they come. */
+class StreamingSink : public LineSink
+{
+public:
+    explicit StreamingSink(IPointCloudProfileCurveCallback& curves)
+        : m_curves(curves)
+    {
+    }
+
+    void begin(const AcGeMatrix3d& transform, const AcGePlane& projectedPlane) override
+    {
+        m_curves.begin(transform, projectedPlane);
+    }
+
+    void addLines(const std::vector<FinishedLine>& lines) override
+    {
+        m_batch.setLogicalLength(0);
+        for (const FinishedLine& line : lines)
+        {
+            m_batch.append(ProfileCurve2d(AcGeLineSeg2d(AcGePoint2d(line.segment.u0, line.segment.v0),
+                                                        AcGePoint2d(line.segment.u1, line.segment.v1))));
+        }
+        m_curves.addCurves(m_batch);
+    }
+
+private:
+    IPointCloudProfileCurveCallback& m_curves;
+    AcArray<ProfileCurve2d>          m_batch;
+};
+
+/* Collects all lines for extract, which returns them in key order rather
+than in the order their tiles happened to complete. */
+class ResultSink : public LineSink
+{
+public:
+    explicit ResultSink(AcPointCloudExtractResult& result)
+        : m_result(result)
+    {
+    }
+
+    void begin(const AcGeMatrix3d& transform, const AcGePlane& projectedPlane) override
+    {
+        m_result.Curves.setLogicalLength(0);
+        m_result.transform = transform;
+        m_result.ProjectedPlane = projectedPlane;
+    }
+
+    void addLines(const std::vector<FinishedLine>& lines) override
+    {
+        m_lines.insert(m_lines.end(), lines.begin(), lines.end());
+    }
+
+    void finish()
+    {
+        std::sort(m_lines.begin(), m_lines.end(),
+                  [](const FinishedLine& a, const FinishedLine& b) { return a.key < b.key; });
+        for (const FinishedLine& line : m_lines)
+        {
+            m_result.Curves.append(ProfileCurve2d(AcGeLineSeg2d(AcGePoint2d(line.segment.u0, line.segment.v0),
+                                                                AcGePoint2d(line.segment.u1, line.segment.v1))));
+        }
+    }
+
+private:
+    AcPointCloudExtractResult& m_result;
+    std::vector<FinishedLine>  m_lines;
+};
+
+Acad::ErrorStatus runExtraction(const IAcDbPointCloudDataBuffer& pointCloud,
+                                const AcGeVector3d& planeZDirection,
+                                const AcGeVector3d& planeXDirection,
+                                const AcGePoint3d& pointPlane,
+                                const ExtractOption& extractOption,
+                                LineSink& sink,
+                                IPointCloudExtracProgressCallback* progress,
+                                const PointCloudLineExtractionSettings& settings)
+{
+    if (extractOption.m_fillGap <= 0.0 || extractOption.m_minSegLength <= 0.0)
+        return Acad::eInvalidInput;
+    if (planeZDirection.isZeroLength())
+        return Acad::eInvalidInput;
+
+    const AcGeVector3d zAxis = planeZDirection.normal();
+    AcGeVector3d xAxis = planeXDirection - zAxis * planeXDirection.dotProduct(zAxis);
+    if (xAxis.isZeroLength())
+        return Acad::eInvalidInput;
+    xAxis.normalize();
+    const AcGeVector3d yAxis = zAxis.crossProduct(xAxis);
+
+    AcGeMatrix3d transform;
+    transform.setCoordSystem(pointPlane, xAxis, yAxis, zAxis);
+    sink.begin(transform, AcGePlane(pointPlane, zAxis));
+
+    const unsigned threadCount = settings.threadCount > 0 ? settings.threadCount : defaultThreadCount();
+    const double halfSlab = (settings.slabThickness > 0.0 ? settings.slabThickness : 2.0 * extractOption.m_fillGap) * 0.5;
+    ProgressReporter reporter(progress);
+
+    // Stage 1: slab projection.  Fold the buffer's local-to-WCS transform and
+    // the plane's coordinate system into one affine map per output axis.
+    const AcGeMatrix3d& toWorld = pointCloud.transform();
+    double rows[3][4];
+    const AcGeVector3d* axes[3] = { &xAxis, &yAxis, &zAxis };
+    for (int r = 0; r < 3; ++r)
+    {
+        const AcGeVector3d& axis = *axes[r];
+        for (int c = 0; c < 3; ++c)
+            rows[r][c] = axis.x * toWorld.entry[0][c] + axis.y * toWorld.entry[1][c] + axis.z * toWorld.entry[2][c];
+        rows[r][3] = axis.x * (toWorld.entry[0][3] - pointPlane.x) +
+                     axis.y * (toWorld.entry[1][3] - pointPlane.y) +
+                     axis.z * (toWorld.entry[2][3] - pointPlane.z);
+    }
+
+    reporter.caption(ACRX_T("Projecting points"));
+    const AcGePoint3d* pPoints = pointCloud.points();
+    const Adesk::UInt64 numPoints = pPoints != nullptr ? pointCloud.numPoints() : 0;
+    const size_t chunkCount = static_cast<size_t>((numPoints + kProjectionChunkPoints - 1) / kProjectionChunkPoints);
+    std::vector<std::vector<PlanePoint>> chunkPoints(chunkCount);
+    std::atomic<Adesk::UInt64> projectedInput(0);
+
+    bool completed = parallelFor(chunkCount, threadCount,
+        [&](size_t chunk, unsigned)
+        {
+            const Adesk::UInt64 first = Adesk::UInt64(chunk) * kProjectionChunkPoints;
+            const Adesk::UInt64 last = std::min<Adesk::UInt64>(first + kProjectionChunkPoints, numPoints);
+            std::vector<PlanePoint>& out = chunkPoints[chunk];
+            for (Adesk::UInt64 i = first; i < last; ++i)
+            {
+                const AcGePoint3d& p = pPoints[i];
+                const double d = rows[2][0] * p.x + rows[2][1] * p.y + rows[2][2] * p.z + rows[2][3];
+                if (std::fabs(d) > halfSlab)
+                    continue;
+                PlanePoint q;
+                q.u = rows[0][0] * p.x + rows[0][1] * p.y + rows[0][2] * p.z + rows[0][3];
+                q.v = rows[1][0] * p.x + rows[1][1] * p.y + rows[1][2] * p.z + rows[1][3];
+                out.push_back(q);
+            }
+            projectedInput += last - first;
+        },
+        [&](size_t)
+        {
+            return reporter.update(kProjectionShare * double(projectedInput.load()) / double(numPoints));
+        });
+    if (!completed)
+    {
+        reporter.end();
+        return Acad::eUserBreak;
+    }
+
+    // Concatenate the chunks, keeping every stride-th point so that at most
+    // m_processPoints survive.  Striding by global index keeps the selection
+    // independent of the chunking.
+    size_t slabPointCount = 0;
+    for (const std::vector<PlanePoint>& chunk : chunkPoints)
+        slabPointCount += chunk.size();
+    const size_t stride = extractOption.m_processPoints > 0 && slabPointCount > extractOption.m_processPoints
+        ? (slabPointCount + extractOption.m_processPoints - 1) / extractOption.m_processPoints
+        : 1;
+
+    std::vector<PlanePoint> slab;
+    slab.reserve(slabPointCount / stride + 1);
+    double minU = DBL_MAX, minV = DBL_MAX, maxU = -DBL_MAX, maxV = -DBL_MAX;
+    size_t globalIndex = 0;
+    for (std::vector<PlanePoint>& chunk : chunkPoints)
+    {
+        for (const PlanePoint& p : chunk)
+        {
+            if (globalIndex++ % stride != 0)
+                continue;
+            slab.push_back(p);
+            minU = std::min(minU, p.u);
+            minV = std::min(minV, p.v);
+            maxU = std::max(maxU, p.u);
+            maxV = std::max(maxV, p.v);
+        }
+        std::vector<PlanePoint>().swap(chunk);
+    }
+    if (slab.empty())
+    {
+        reporter.update(1.0);
+        reporter.end();
+        return Acad::eOk;
+    }
+
+    // Stage 2: rasterize and fit, tile by tile.
+    GridLayout layout;
+    layout.cellSize = settings.cellSize > 0.0 ? settings.cellSize : extractOption.m_fillGap * 0.5;
+    const double spanU = maxU - minU;
+    const double spanV = maxV - minV;
+    const double cellArea = (spanU / layout.cellSize + 1.0) * (spanV / layout.cellSize + 1.0);
+    if (cellArea > double(kMaxGridCells))
+        layout.cellSize *= std::sqrt(cellArea / double(kMaxGridCells));
+    layout.originU = minU;
+    layout.originV = minV;
+    layout.tileCells = std::min<unsigned>(std::max<unsigned>((settings.tileCells + 63) / 64 * 64, 64), kMaxTileCells);
+
+    // The raster is padded to whole tiles, which on a thin slab can make it
+    // many times the cells the span needs; coarsen the cells until the padded
+    // raster is within the cap.  A single tile always is.
+    Adesk::UInt32 width = 0;
+    Adesk::UInt32 height = 0;
+    for (;;)
+    {
+        width = static_cast<Adesk::UInt32>(spanU / layout.cellSize) + 1;
+        height = static_cast<Adesk::UInt32>(spanV / layout.cellSize) + 1;
+        layout.tilesX = (width + layout.tileCells - 1) / layout.tileCells;
+        layout.tilesY = (height + layout.tileCells - 1) / layout.tileCells;
+        const double paddedCells = double(layout.tilesX) * layout.tileCells * double(layout.tilesY) * layout.tileCells;
+        if (paddedCells <= double(kMaxGridCells))
+            break;
+        layout.cellSize *= std::max(std::sqrt(paddedCells / double(kMaxGridCells)), 1.0625);
+    }
+    layout.gapCells = std::max(1, static_cast<int>(std::ceil(extractOption.m_fillGap / layout.cellSize)));
+
+    // Bin the points by tile with a counting sort, filling the occupancy
+    // raster on the way.
+    OccupancyGrid occupancy;
+    occupancy.reset(layout.tilesX * layout.tileCells, layout.tilesY * layout.tileCells);
+    const size_t tileCount = size_t(layout.tilesX) * layout.tilesY;
+    std::vector<size_t> tileStart(tileCount + 1, 0);
+    std::vector<Adesk::UInt32> pointTile(slab.size());
+    for (size_t i = 0; i < slab.size(); ++i)
+    {
+        const Adesk::UInt32 cx = std::min(static_cast<Adesk::UInt32>((slab[i].u - minU) / layout.cellSize), width - 1);
+        const Adesk::UInt32 cy = std::min(static_cast<Adesk::UInt32>((slab[i].v - minV) / layout.cellSize), height - 1);
+        pointTile[i] = (cy / layout.tileCells) * layout.tilesX + cx / layout.tileCells;
+        ++tileStart[pointTile[i] + 1];
+    }
+    for (size_t t = 0; t < tileCount; ++t)
+        tileStart[t + 1] += tileStart[t];
+
+    std::vector<TileCell> tileCells(slab.size());
+    {
+        std::vector<size_t> cursor(tileStart.begin(), tileStart.end() - 1);
+        for (size_t i = 0; i < slab.size(); ++i)
+        {
+            const Adesk::UInt32 cx = std::min(static_cast<Adesk::UInt32>((slab[i].u - minU) / layout.cellSize), width - 1);
+            const Adesk::UInt32 cy = std::min(static_cast<Adesk::UInt32>((slab[i].v - minV) / layout.cellSize), height - 1);
+            occupancy.set(cx, cy);
+            TileCell& cell = tileCells[cursor[pointTile[i]]++];
+            cell.x = static_cast<Adesk::UInt16>(cx % layout.tileCells);
+            cell.y = static_cast<Adesk::UInt16>(cy % layout.tileCells);
+        }
+    }
+    std::vector<PlanePoint>().swap(slab);
+    std::vector<Adesk::UInt32>().swap(pointTile);
+
+    // Stages 2 and 3: fit tiles on the workers; merge, filter and emit the
+    // lines that became final on this thread after every completion.
+    reporter.caption(ACRX_T("Extracting lines"));
+    const double snapAngle = std::max(double(extractOption.m_snapAngle), 180.0 / kHoughAngles) * kPi / 180.0;
+    // Fitting removes a band three cells wide along each line, the line's own
+    // cell and one on either side.  Where another line crosses it, that opens
+    // a gap of four cells between the centres of the cells either side.
+    SegmentMerger merger(layout, snapAngle, extractOption.m_fillGap + 4.0 * layout.cellSize);
+    std::vector<TileScratch> scratch(threadCount);
+    std::atomic<Adesk::UInt64> fittedWork(0);
+    const double tileWork = double(tileCells.size() + tileCount);
+
+    std::mutex completedMutex;
+    std::vector<std::pair<size_t, std::vector<PlaneSegment>>> completedTiles;
+    std::vector<std::pair<size_t, std::vector<PlaneSegment>>> mergingTiles;
+    std::vector<FinishedLine> finished;
+
+    auto mergeCompletedTiles = [&]()
+    {
+        {
+            std::lock_guard<std::mutex> lock(completedMutex);
+            mergingTiles.swap(completedTiles);
+        }
+        for (const std::pair<size_t, std::vector<PlaneSegment>>& tile : mergingTiles)
+            merger.addTile(tile.first, tile.second);
+        mergingTiles.clear();
+
+        finished.clear();
+        merger.takeFinished(finished);
+        finished.erase(std::remove_if(finished.begin(), finished.end(),
+            [&](const FinishedLine& line)
+            {
+                if (line.segment.length() < extractOption.m_minSegLength)
+                    return true;
+                return extractOption.m_extractionType == ExtractOption::kOutLine &&
+                       !isOutlineSegment(line.segment, occupancy, layout);
+            }), finished.end());
+        if (!finished.empty())
+            sink.addLines(finished);
+    };
+
+    completed = parallelFor(tileCount, threadCount,
+        [&](size_t tile, unsigned worker)
+        {
+            const TileCell* pCells = tileCells.data() + tileStart[tile];
+            const size_t cellCount = tileStart[tile + 1] - tileStart[tile];
+            std::vector<PlaneSegment> segments;
+            fitTileSegments(layout, tile, pCells, cellCount, scratch[worker], segments);
+            {
+                std::lock_guard<std::mutex> lock(completedMutex);
+                completedTiles.emplace_back(tile, std::move(segments));
+            }
+            fittedWork += cellCount + 1;
+        },
+        [&](size_t)
+        {
+            mergeCompletedTiles();
+            return reporter.update(kProjectionShare + kTileShare * double(fittedWork.load()) / tileWork);
+        });
+    if (!completed)
+    {
+        reporter.end();
+        return Acad::eUserBreak;
+    }
+
+    // Tiles that completed after the last report.  With every tile done,
+    // every line is final.
+    mergeCompletedTiles();
+
+    reporter.update(1.0);
+    reporter.end();
+    return Acad::eOk;
+}
+
+} // namespace
+
+Acad::ErrorStatus PointCloudLineExtractor::extract(const IAcDbPointCloudDataBuffer& pointCloud,
+                                                   const AcGeVector3d& planeZDirection,
+                                                   const AcGeVector3d& planeXDirection,
+                                                   const AcGePoint3d& pointPlane,
+                                                   const ExtractOption& extractOption,
+                                                   AcPointCloudExtractResult& outlineResult,
+                                                   IPointCloudExtracProgressCallback* progress,
+                                                   const PointCloudLineExtractionSettings& settings)
+{
+    ResultSink sink(outlineResult);
+    const Acad::ErrorStatus es = runExtraction(pointCloud, planeZDirection, planeXDirection, pointPlane,
+                                               extractOption, sink, progress, settings);
+    if (es == Acad::eOk)
+        sink.finish();
+    return es;
+}
+
+Acad::ErrorStatus PointCloudLineExtractor::extractStreaming(const IAcDbPointCloudDataBuffer& pointCloud,
+                                                            const AcGeVector3d& planeZDirection,
+                                                            const AcGeVector3d& planeXDirection,
+                                                            const AcGePoint3d& pointPlane,
+                                                            const ExtractOption& extractOption,
+                                                            IPointCloudProfileCurveCallback& curves,
+                                                            IPointCloudExtracProgressCallback* progress,
+                                                            const PointCloudLineExtractionSettings& settings)
+{
+    StreamingSink sink(curves);
+    return runExtraction(pointCloud, planeZDirection, planeXDirection, pointPlane,
+                         extractOption, sink, progress, settings);
+}
+
+} // namespace acad_sheetset_to_pdf
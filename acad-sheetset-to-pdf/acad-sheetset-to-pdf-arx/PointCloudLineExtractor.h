@@ -0,0 +1,127 @@
+#pragma once
+
+#include "AcDbPointCloudApi.h"
+#include "AcPointCloudExtractor.h"
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// Tuning knobs of PointCloudLineExtractor that ExtractOption has no room
+/// for.  Zero means "derive a sensible value from the ExtractOption".
+/// </summary>
+struct PointCloudLineExtractionSettings
+{
+    /// <summary>
+    /// Thickness of the slab around the extraction plane whose points are
+    /// projected onto it.  Defaults to twice ExtractOption::m_fillGap.
+    /// </summary>
+    double   slabThickness = 0.0;
+
+    /// <summary>
+    /// Edge length of one occupancy raster cell.  Defaults to half of
+    /// ExtractOption::m_fillGap, and is made coarser where the raster of the
+    /// slab, padded to whole tiles, would exceed 2^31 cells (256 MB).
+    /// </summary>
+    double   cellSize = 0.0;
+
+    /// <summary>
+    /// Edge length of one tile, in cells.  Rounded up to a multiple of 64,
+    /// at most 32768.
+    /// </summary>
+    unsigned tileCells = 256;
+
+    /// <summary>
+    /// Worker threads used for projection and for tiles.  Defaults to the
+    /// number of hardware threads.
+    /// </summary>
+    unsigned threadCount = 0;
+};
+
+/// <summary>
+/// Receives the curves of PointCloudLineExtractor::extractStreaming as soon
+/// as they are final.  All methods are called on the thread that called
+/// extractStreaming.
+/// </summary>
+class IPointCloudProfileCurveCallback
+{
+public:
+    IPointCloudProfileCurveCallback(void){}
+    virtual ~IPointCloudProfileCurveCallback(void){}
+
+    /// <summary>
+    /// Called once, before any curves, with the values that
+    /// AcPointCloudExtractResult::transform and ProjectedPlane would hold.
+    /// </summary>
+    virtual void begin(const AcGeMatrix3d& transform, const AcGePlane& projectedPlane) = 0;
+
+    /// <summary>
+    /// Called with every batch of curves that no later tile can change.  The
+    /// array is only valid for the duration of the call.
+    /// </summary>
+    virtual void addCurves(const AcArray<ProfileCurve2d>& curves) = 0;
+};
+
+/// <summary>
+/// An open implementation of the AcPointCloudExtractor::extract contract
+/// that works on any IAcDbPointCloudDataBuffer.
+///
+/// The extraction runs in three stages:
+///   1. slab projection: points within half the slab thickness of the plane
+///      are projected into the plane's 2d coordinate system, in parallel
+///      over chunks of the buffer;
+///   2. occupancy rasterization and segment fitting, in parallel over square
+///      tiles of the raster; each tile runs a progressive probabilistic Hough
+///      transform over its occupied cells and walks the detected lines,
+///      bridging gaps up to m_fillGap;
+///   3. merging of collinear pieces (within m_snapAngle degrees and m_fillGap
+///      of each other), mostly the pieces of one wall that were cut at tile
+///      borders, followed by the m_minSegLength filter and, for kOutLine,
+///      removal of segments that are enclosed on both sides.
+///
+/// Merging runs on the calling thread while tiles are still being fitted.
+/// A line is final as soon as every tile within reach of it has completed,
+/// and the lines that are made of pieces are the same whatever order the
+/// tiles complete in.  extractStreaming hands final lines to the caller at
+/// that point, so the first curves arrive long before the last tile is done
+/// and no result array has to hold the whole drawing; extract collects the
+/// same curves and returns them sorted.
+///
+/// Memory is bounded per extraction, not per tile.  The outline test looks
+/// across the whole slab from each line, so the occupancy raster of the
+/// whole slab, one bit per cell and at most 256 MB, is built before the
+/// first tile is fitted, and the slab's points stay binned by tile, four
+/// bytes each, until the last tile is done.  Each worker adds the scratch
+/// of one tile.
+///
+/// Progress and remaining time are derived from the number of points in the
+/// completed chunks and tiles, reported from the calling thread.
+/// cancelled() is polled after every completed chunk or tile; once it
+/// returns true no new work is started and extract returns Acad::eUserBreak.
+/// Curves that extractStreaming delivered before the cancellation are final
+/// and identical to those of an uncancelled run.
+///
+/// Only line segments are produced; m_useLineSegmentOnly is implied.
+/// </summary>
+class PointCloudLineExtractor
+{
+public:
+    static Acad::ErrorStatus extract(const IAcDbPointCloudDataBuffer& pointCloud,
+                                     const AcGeVector3d& planeZDirection,
+                                     const AcGeVector3d& planeXDirection,
+                                     const AcGePoint3d& pointPlane,
+                                     const ExtractOption& extractOption,
+                                     AcPointCloudExtractResult& outlineResult,
+                                     IPointCloudExtracProgressCallback* progress = nullptr,
+                                     const PointCloudLineExtractionSettings& settings = PointCloudLineExtractionSettings());
+
+    static Acad::ErrorStatus extractStreaming(const IAcDbPointCloudDataBuffer& pointCloud,
+                                              const AcGeVector3d& planeZDirection,
+                                              const AcGeVector3d& planeXDirection,
+                                              const AcGePoint3d& pointPlane,
+                                              const ExtractOption& extractOption,
+                                              IPointCloudProfileCurveCallback& curves,
+                                              IPointCloudExtracProgressCallback* progress = nullptr,
+                                              const PointCloudLineExtractionSettings& settings = PointCloudLineExtractionSettings());
+};
+
+} // namespace acad_sheetset_to_pdf
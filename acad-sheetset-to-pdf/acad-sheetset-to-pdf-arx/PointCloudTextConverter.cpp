@@ -0,0 +1,307 @@
+#include "stdafx.h"
+#include "PointCloudTextConverter.h"
+#include "MappedPointCloudBuffer.h"
+
+#include <cfloat>
+#include <charconv>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+const int kMaxFields = 9;
+
+/* Where the optional attributes sit on a line, by number of fields.  -1 means
+the attribute is not present. */
+struct FieldLayout
+{
+    int intensity = -1;
+    int color = -1;
+    int normal = -1;
+
+    Adesk::UInt32 dataTypes() const
+    {
+        Adesk::UInt32 types = 0;
+        if (intensity >= 0) types |= IAcDbPointCloudDataBuffer::kIntensity;
+        if (color >= 0)     types |= IAcDbPointCloudDataBuffer::kColor;
+        if (normal >= 0)    types |= IAcDbPointCloudDataBuffer::kNormal;
+        return types;
+    }
+};
+
+FieldLayout fieldLayout(PointCloudTextFormat format, int fieldCount)
+{
+    FieldLayout layout;
+    switch (fieldCount)
+    {
+    case 4:
+        layout.intensity = 3;
+        break;
+    case 6:
+        if (format == kPointCloudTextXyz)
+            layout.color = 3;
+        break;
+    case 7:
+        layout.intensity = 3;
+        layout.color = 4;
+        break;
+    case 9:
+        if (format == kPointCloudTextXyz)
+        {
+            layout.color = 3;
+            layout.normal = 6;
+        }
+        break;
+    default:
+        break;
+    }
+    return layout;
+}
+
+bool isSeparator(char c)
+{
+    return c == ' ' || c == '\t' || c == ',' || c == ';';
+}
+
+/* Walks a mapped text file one line at a time, parsing up to kMaxFields
+numbers per line without copying or null-terminating anything. */
+class LineReader
+{
+public:
+    LineReader(const char* pBegin, const char* pEnd) : m_p(pBegin), m_pEnd(pEnd) {}
+
+    /// Parses the next non-blank, non-comment line.  Returns false at end of
+    /// input.  fieldCount is set to -1 if the line holds something that is not
+    /// a number.
+    bool next(double* values, int& fieldCount)
+    {
+        while (m_p < m_pEnd)
+        {
+            const char* pLine = m_p;
+            const char* pEol = static_cast<const char*>(memchr(m_p, '\n', m_pEnd - m_p));
+            if (pEol == nullptr)
+                pEol = m_pEnd;
+            m_p = pEol < m_pEnd ? pEol + 1 : m_pEnd;
+
+            while (pLine < pEol && (isSeparator(*pLine) || *pLine == '\r'))
+                ++pLine;
+            if (pLine == pEol || *pLine == '#' || (pEol - pLine >= 2 && pLine[0] == '/' && pLine[1] == '/'))
+                continue;
+
+            fieldCount = 0;
+            const char* p = pLine;
+            while (p < pEol)
+            {
+                while (p < pEol && (isSeparator(*p) || *p == '\r'))
+                    ++p;
+                if (p == pEol)
+                    break;
+                double value = 0.0;
+                const std::from_chars_result result = std::from_chars(p, pEol, value);
+                if (result.ec != std::errc() || fieldCount == kMaxFields)
+                {
+                    fieldCount = -1;
+                    return true;
+                }
+                values[fieldCount++] = value;
+                p = result.ptr;
+                if (p < pEol && !isSeparator(*p) && *p != '\r')
+                {
+                    fieldCount = -1;
+                    return true;
+                }
+            }
+            return true;
+        }
+        return false;
+    }
+
+private:
+    const char* m_p;
+    const char* m_pEnd;
+};
+
+PointCloudTextFormat formatFromPath(const ACHAR* path)
+{
+    const ACHAR* pExtension = wcsrchr(path, L'.');
+    if (pExtension != nullptr && _wcsicmp(pExtension, L".pts") == 0)
+        return kPointCloudTextPts;
+    return kPointCloudTextXyz;
+}
+
+Adesk::UInt8 toByte(double value)
+{
+    if (value <= 0.0)
+        return 0;
+    if (value >= 255.0)
+        return 255;
+    return static_cast<Adesk::UInt8>(value + 0.5);
+}
+
+} // namespace
+
+Acad::ErrorStatus convertPointCloudText(const ACHAR* textPath,
+                                        const ACHAR* columnPath,
+                                        PointCloudTextFormat format)
+{
+    if (textPath == nullptr || columnPath == nullptr)
+        return Acad::eNullPtr;
+    if (format == kPointCloudTextAuto)
+        format = formatFromPath(textPath);
+
+    MappedFile input;
+    Acad::ErrorStatus es = input.open(textPath, MappedFile::kReadOnly);
+    if (es != Acad::eOk)
+        return es;
+    const char* pTextBegin = reinterpret_cast<const char*>(input.data());
+    const char* pTextEnd = pTextBegin + input.size();
+
+    // Pass 1: count the points and settle the line layout.
+    double values[kMaxFields];
+    int fieldCount = 0;
+    int pointFieldCount = 0;
+    Adesk::UInt64 numPoints = 0;
+    double minIntensity = DBL_MAX;
+    double maxIntensity = -DBL_MAX;
+    FieldLayout layout;
+
+    input.prefetch(0, input.size());
+    LineReader counter(pTextBegin, pTextEnd);
+    while (counter.next(values, fieldCount))
+    {
+        if (fieldCount < 0)
+            return Acad::eInvalidInput;
+        if (fieldCount < 3)
+        {
+            // A PTS block header; anything else this short is malformed.
+            if (format == kPointCloudTextPts && fieldCount == 1)
+                continue;
+            return Acad::eInvalidInput;
+        }
+        if (pointFieldCount == 0)
+        {
+            pointFieldCount = fieldCount;
+            layout = fieldLayout(format, fieldCount);
+        }
+        else if (fieldCount != pointFieldCount)
+        {
+            return Acad::eInvalidInput;
+        }
+        if (layout.intensity >= 0)
+        {
+            minIntensity = std::min(minIntensity, values[layout.intensity]);
+            maxIntensity = std::max(maxIntensity, values[layout.intensity]);
+        }
+        ++numPoints;
+    }
+
+    // PTS intensities are defined on [-2048, 2047]; for XYZ we can only go by
+    // what is in the file.
+    if (format == kPointCloudTextPts)
+    {
+        minIntensity = -2048.0;
+        maxIntensity = 2047.0;
+    }
+    const double intensityScale = maxIntensity > minIntensity ? 255.0 / (maxIntensity - minIntensity) : 0.0;
+
+    PointCloudColumnHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kPointCloudColumnFileMagic, sizeof(header.magic));
+    header.version = kPointCloudColumnFileVersion;
+    header.dataTypes = layout.dataTypes();
+    header.numPoints = numPoints;
+    for (int i = 0; i < 4; ++i)
+        header.transform[i][i] = 1.0;
+    const Adesk::UInt64 fileSize = layoutPointCloudColumns(header);
+
+    MappedFile output;
+    es = output.create(columnPath, fileSize);
+    if (es != Acad::eOk)
+        return es;
+
+    // Pass 2: fill the columns in place.
+    Adesk::UInt8* pBase = output.writableData();
+    AcGePoint3d* pPoints = reinterpret_cast<AcGePoint3d*>(pBase + header.sections[kPointColumn].offset);
+    AcGeVector3d* pNormals = reinterpret_cast<AcGeVector3d*>(pBase + header.sections[kNormalColumn].offset);
+    IAcDbPointCloudDataBuffer::RGBA* pColors =
+        reinterpret_cast<IAcDbPointCloudDataBuffer::RGBA*>(pBase + header.sections[kColorColumn].offset);
+    Adesk::UInt8* pIntensity = pBase + header.sections[kIntensityColumn].offset;
+
+    double minPoint[3] = { DBL_MAX, DBL_MAX, DBL_MAX };
+    double maxPoint[3] = { -DBL_MAX, -DBL_MAX, -DBL_MAX };
+    Adesk::UInt64 index = 0;
+    LineReader reader(pTextBegin, pTextEnd);
+    while (reader.next(values, fieldCount) && index < numPoints)
+    {
+        if (fieldCount < 3)
+            continue;
+
+        pPoints[index].set(values[0], values[1], values[2]);
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            minPoint[axis] = std::min(minPoint[axis], values[axis]);
+            maxPoint[axis] = std::max(maxPoint[axis], values[axis]);
+        }
+        if (layout.intensity >= 0)
+            pIntensity[index] = toByte((values[layout.intensity] - minIntensity) * intensityScale);
+        if (layout.color >= 0)
+        {
+            pColors[index][0] = toByte(values[layout.color]);
+            pColors[index][1] = toByte(values[layout.color + 1]);
+            pColors[index][2] = toByte(values[layout.color + 2]);
+            pColors[index][3] = 0;
+        }
+        if (layout.normal >= 0)
+            pNormals[index].set(values[layout.normal], values[layout.normal + 1], values[layout.normal + 2]);
+        ++index;
+    }
+
+    if (numPoints > 0)
+    {
+        memcpy(header.minPoint, minPoint, sizeof(minPoint));
+        memcpy(header.maxPoint, maxPoint, sizeof(maxPoint));
+    }
+
+    // Make the columns durable before the header that declares them valid.
+    es = output.flush();
+    if (es == Acad::eOk)
+    {
+        memcpy(pBase, &header, sizeof(header));
+        es = output.flush();
+    }
+    output.close();
+    if (es != Acad::eOk)
+        ::DeleteFileW(columnPath);
+    return es;
+}
+
+void convertPointCloudCommand()
+{
+    AcString textPath;
+    if (acedGetString(1, ACRX_T("\nText point cloud to convert: "), textPath) != RTNORM || textPath.isEmpty())
+        return;
+
+    AcString columnPath = textPath;
+    const int dot = columnPath.findRev(ACRX_T('.'));
+    if (dot > columnPath.findRev(ACRX_T('\\')))
+        columnPath = columnPath.substr(dot);
+    columnPath += ACRX_T(".pcc");
+
+    Acad::ErrorStatus es = convertPointCloudText(textPath.kwszPtr(), columnPath.kwszPtr());
+    MappedPointCloudBuffer* pBuffer = nullptr;
+    if (es == Acad::eOk)
+        es = MappedPointCloudBuffer::open(columnPath.kwszPtr(), pBuffer);
+    if (es != Acad::eOk)
+    {
+        acutPrintf(ACRX_T("\nCould not convert %s: %s\n"), textPath.kwszPtr(), acadErrorStatusText(es));
+        return;
+    }
+
+    AcGePoint3d minPoint, maxPoint;
+    pBuffer->extents(minPoint, maxPoint);
+    acutPrintf(ACRX_T("\n%s: %llu points from (%g, %g, %g) to (%g, %g, %g).\n"), columnPath.kwszPtr(),
+               pBuffer->numPoints(), minPoint.x, minPoint.y, minPoint.z, maxPoint.x, maxPoint.y, maxPoint.z);
+    pBuffer->freeObject();
+}
+
+} // namespace acad_sheetset_to_pdf
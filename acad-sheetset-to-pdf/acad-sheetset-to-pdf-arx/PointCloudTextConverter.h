@@ -0,0 +1,46 @@
+#pragma once
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// Text point cloud dialects understood by convertPointCloudText.
+///
+/// XYZ: one point per line, whitespace or comma separated:
+///     x y z
+///     x y z intensity
+///     x y z r g b
+///     x y z intensity r g b
+///     x y z r g b nx ny nz
+///
+/// PTS (Leica): like XYZ, but the file is made of blocks that each start with
+/// a line holding only the number of points in the block, and the four and
+/// seven column forms are the only ones in use.
+/// </summary>
+enum PointCloudTextFormat
+{
+    kPointCloudTextAuto,    // decided from the file extension, XYZ otherwise
+    kPointCloudTextXyz,
+    kPointCloudTextPts
+};
+
+/// <summary>
+/// Converts a text point cloud into the columnar file format read by
+/// MappedPointCloudBuffer.
+///
+/// Both files are memory-mapped and the input is read twice: once to count
+/// points and find the intensity range, once to fill the output columns in
+/// place.  Memory use does not depend on the size of the cloud.  The header
+/// is written last, so an interrupted conversion leaves a file that
+/// MappedPointCloudBuffer::open rejects.
+/// </summary>
+Acad::ErrorStatus convertPointCloudText(const ACHAR* textPath,
+                                        const ACHAR* columnPath,
+                                        PointCloudTextFormat format = kPointCloudTextAuto);
+
+/// <summary>
+/// The SHEETSETTOPDFPOINTCLOUD command: converts a text point cloud into a
+/// *.pcc file next to it and reports what MappedPointCloudBuffer reads back.
+/// </summary>
+void convertPointCloudCommand();
+
+} // namespace acad_sheetset_to_pdf
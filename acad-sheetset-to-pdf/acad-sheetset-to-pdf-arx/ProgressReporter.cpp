@@ -0,0 +1,50 @@
+#include "stdafx.h"
+#include "ProgressReporter.h"
+
+namespace acad_sheetset_to_pdf {
+
+ProgressReporter::ProgressReporter(IPointCloudExtracProgressCallback* pCallback)
+    : m_pCallback(pCallback)
+    , m_start(std::chrono::steady_clock::now())
+    , m_lastPercent(-1)
+{
+}
+
+void ProgressReporter::caption(const ACHAR* text)
+{
+    if (m_pCallback != nullptr)
+        m_pCallback->updateCaption(AcString(text));
+}
+
+bool ProgressReporter::update(double fraction)
+{
+    if (m_pCallback == nullptr)
+        return true;
+    fraction = std::min(std::max(fraction, 0.0), 1.0);
+    const int percent = static_cast<int>(fraction * 99.0);
+    if (percent != m_lastPercent)
+    {
+        m_pCallback->updateProgress(percent);
+        m_lastPercent = percent;
+    }
+    if (fraction > 0.0)
+    {
+        const double elapsed =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+        m_pCallback->updateRemainTime(elapsed * (1.0 - fraction) / fraction);
+    }
+    return !m_pCallback->cancelled();
+}
+
+bool ProgressReporter::cancelled() const
+{
+    return m_pCallback != nullptr && m_pCallback->cancelled();
+}
+
+void ProgressReporter::end()
+{
+    if (m_pCallback != nullptr)
+        m_pCallback->end();
+}
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "AcPointCloudExtractor.h"
+
+#include <chrono>
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// Drives an optional IPointCloudExtracProgressCallback from a completed
+/// fraction of the work: converts it to the 0 ~ 99 range the callback
+/// expects, skips repeated percentages and estimates the remaining time from
+/// the elapsed time.  Must be used from the thread that owns the callback.
+/// </summary>
+class ProgressReporter
+{
+public:
+    explicit ProgressReporter(IPointCloudExtracProgressCallback* pCallback);
+
+    void caption(const ACHAR* text);
+
+    /// <summary>
+    /// Reports fraction (0 to 1) of the work as done.  Returns false once
+    /// the user has cancelled.
+    /// </summary>
+    bool update(double fraction);
+
+    bool cancelled() const;
+    void end();
+
+private:
+    IPointCloudExtracProgressCallback*    m_pCallback;
+    std::chrono::steady_clock::time_point m_start;
+    int                                   m_lastPercent;
+};
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,246 @@
+#include "stdafx.h"
+#include "PropertyExtractionEngine.h"
+#include "ParallelFor.h"
+
+#include <chrono>
+#include <new>
+#include <system_error>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+Adesk::UInt64 elapsedSince(std::chrono::steady_clock::time_point start)
+{
+    return static_cast<Adesk::UInt64>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+} // namespace
+
+PropertyExtractionEngine::PropertyExtractionEngine(PropertyExtractionSource& source,
+                                                   const PropertyExtractionSettings& settings)
+    : m_source(source)
+    , m_settings(settings)
+    , m_extracting(false)
+{
+    if (m_settings.blockSize == 0)
+        m_settings.blockSize = 1;
+}
+
+PropertyExtractionEngine::~PropertyExtractionEngine()
+{
+    if (m_worker.joinable())
+        m_worker.join();
+}
+
+Acad::ErrorStatus PropertyExtractionEngine::run(const std::vector<PropertyExtractionObject>& objects,
+                                                const std::vector<Adesk::UInt64>& handles,
+                                                std::shared_ptr<const PropertyStore>& pStore,
+                                                PropertyExtractionStats& stats) const
+{
+    pStore.reset();
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const size_t count = objects.size();
+    const size_t blockSize = m_settings.blockSize;
+    const size_t blockCount = (count + blockSize - 1) / blockSize;
+    const unsigned threadCount = m_settings.threadCount != 0 ? m_settings.threadCount : defaultThreadCount();
+    const unsigned writerCount = static_cast<unsigned>(std::max<size_t>(std::min<size_t>(threadCount, blockCount), 1));
+    stats.objectCount = count;
+    stats.threadCount = writerCount;
+
+    /* Each worker writes to a writer of its own, and remembers the first
+    object, by position, that failed, so that the status reported does not
+    depend on which worker got there first. */
+    std::vector<std::unique_ptr<PropertyWriter>> writers;
+    std::vector<size_t> failedObjects(writerCount, count);
+    std::vector<Acad::ErrorStatus> failures(writerCount, Acad::eOk);
+    try
+    {
+        writers.reserve(writerCount);
+        for (unsigned i = 0; i < writerCount; ++i)
+            writers.emplace_back(new PropertyWriter());
+
+        parallelFor(blockCount, writerCount,
+                    [&](size_t block, unsigned worker)
+                    {
+                        PropertyWriter& writer = *writers[worker];
+                        const size_t end = std::min(count, (block + 1) * blockSize);
+                        for (size_t i = block * blockSize; i < end; ++i)
+                        {
+                            writer.beginEntity(i, handles[i], objects[i].viewableId.c_str());
+                            const Acad::ErrorStatus es = m_source.extract(objects[i], writer);
+                            if (es != Acad::eOk && es != Acad::eKeyNotFound && i < failedObjects[worker])
+                            {
+                                failedObjects[worker] = i;
+                                failures[worker] = es;
+                            }
+                        }
+                    });
+    }
+    catch (const std::bad_alloc&)
+    {
+        stats.status = Acad::eOutOfMemory;
+    }
+    catch (...)
+    {
+        stats.status = Acad::eNotHandled;
+    }
+    stats.extractNanoseconds = elapsedSince(start);
+    if (stats.status != Acad::eOk)
+        return stats.status;
+
+    size_t firstFailure = count;
+    for (unsigned i = 0; i < writerCount; ++i)
+    {
+        if (failedObjects[i] < firstFailure)
+        {
+            firstFailure = failedObjects[i];
+            stats.status = failures[i];
+        }
+    }
+
+    const std::chrono::steady_clock::time_point mergeStart = std::chrono::steady_clock::now();
+    std::vector<const PropertyWriter*> merged;
+    for (const std::unique_ptr<PropertyWriter>& pWriter : writers)
+        merged.push_back(pWriter.get());
+    const Acad::ErrorStatus es = PropertyStore::merge(merged, count, writerCount, pStore);
+    stats.mergeNanoseconds = elapsedSince(mergeStart);
+    if (es != Acad::eOk)
+        stats.status = es;
+    if (pStore)
+    {
+        stats.propertyCount = pStore->propertyCount();
+        stats.stringCount = pStore->stringCount();
+        stats.storeBytes = pStore->byteCount();
+    }
+    return stats.status;
+}
+
+Acad::ErrorStatus PropertyExtractionEngine::extract(const std::vector<PropertyExtractionObject>& objects,
+                                                    std::shared_ptr<const PropertyStore>& pStore,
+                                                    PropertyExtractionStats* pStats)
+{
+    std::vector<Adesk::UInt64> handles;
+    handles.reserve(objects.size());
+    for (const PropertyExtractionObject& object : objects)
+        handles.push_back(static_cast<Adesk::UInt64>(object.id.handle()));
+
+    PropertyExtractionStats stats;
+    const Acad::ErrorStatus es = run(objects, handles, pStore, stats);
+    if (pStats != nullptr)
+        *pStats = stats;
+    return es;
+}
+
+void PropertyExtractionEngine::beginExtraction(AcDwgExtractor::BeginExtractionEventArgs& args)
+{
+    /* An extraction that never ended is abandoned. */
+    if (m_worker.joinable())
+        m_worker.join();
+    m_objects.clear();
+    m_handles.clear();
+    m_pPending.reset();
+    m_pendingStats = PropertyExtractionStats();
+    m_extracting = true;
+
+    try
+    {
+        m_pendingStats.status = m_source.prepare(m_objects);
+        if (m_pendingStats.status != Acad::eOk)
+            return;
+
+        /* Handles are read here, on the main thread, with the objects
+        being queued anyway; the workers never look at an object id. */
+        m_handles.reserve(m_objects.size());
+        for (const PropertyExtractionObject& object : m_objects)
+        {
+            args.queueForExtraction(object.id, AcString(object.viewableId.c_str()));
+            m_handles.push_back(static_cast<Adesk::UInt64>(object.id.handle()));
+        }
+    }
+    catch (const std::bad_alloc&)
+    {
+        m_pendingStats.status = Acad::eOutOfMemory;
+        return;
+    }
+
+    try
+    {
+        m_worker = std::thread([this] { run(m_objects, m_handles, m_pPending, m_pendingStats); });
+    }
+    catch (const std::system_error&)
+    {
+        run(m_objects, m_handles, m_pPending, m_pendingStats);
+    }
+}
+
+void PropertyExtractionEngine::endExtraction(AcDwgExtractor::EndExtractionEventArgs& args)
+{
+    if (!m_extracting)
+        return;
+    m_extracting = false;
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (m_worker.joinable())
+        m_worker.join();
+    PropertyExtractionStats stats = m_pendingStats;
+    stats.waitNanoseconds = elapsedSince(start);
+
+    if (m_pPending && m_settings.forwardProperties)
+        forward(*m_pPending, args, stats);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pLastStore = std::move(m_pPending);
+        m_lastStats = stats;
+    }
+    m_pPending.reset();
+    m_objects.clear();
+    m_handles.clear();
+}
+
+void PropertyExtractionEngine::forward(const PropertyStore& store, AcDwgExtractor::EndExtractionEventArgs& args,
+                                       PropertyExtractionStats& stats) const
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    /* addProperty wants AcStrings.  Categories, names and units repeat from
+    one entity to the next, so each is made once. */
+    std::vector<AcString> strings(store.stringCount());
+    std::vector<bool> made(store.stringCount(), false);
+    auto text = [&](Adesk::UInt32 id) -> const AcString&
+    {
+        if (!made[id])
+        {
+            strings[id] = store.string(id);
+            made[id] = true;
+        }
+        return strings[id];
+    };
+
+    for (size_t entity = 0; entity < store.entityCount() && entity < m_objects.size(); ++entity)
+    {
+        const AcDbObjectId& id = m_objects[entity].id;
+        for (size_t property = store.firstProperty(entity); property < store.endProperty(entity); ++property)
+        {
+            args.addProperty(id, text(store.categoryId(property)), text(store.nameId(property)),
+                             store.value(property), text(store.unitsId(property)), store.isHidden(property));
+        }
+    }
+    stats.forwardNanoseconds = elapsedSince(start);
+}
+
+std::shared_ptr<const PropertyStore> PropertyExtractionEngine::lastStore() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pLastStore;
+}
+
+PropertyExtractionStats PropertyExtractionEngine::lastStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_lastStats;
+}
+
+} // namespace acad_sheetset_to_pdf
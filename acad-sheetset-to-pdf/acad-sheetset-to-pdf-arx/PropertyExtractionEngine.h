@@ -0,0 +1,154 @@
+#pragma once
+
+#include "PropertyStore.h"
+
+#include <mutex>
+#include <thread>
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// An object to extract properties from, as it is queued with
+/// AcDwgExtractor::BeginExtractionEventArgs::queueForExtraction.
+/// </summary>
+struct PropertyExtractionObject
+{
+    AcDbObjectId id;
+    std::wstring viewableId;
+};
+
+/// <summary>
+/// Supplies the objects PropertyExtractionEngine extracts properties from
+/// and the properties themselves.
+///
+/// prepare() runs once per extraction on the thread that started it, which
+/// is AutoCAD's main thread when the engine is registered as a reactor, and
+/// may open objects to take whatever extract() will need.  extract() then
+/// runs for every queued object, on several worker threads at the same
+/// time, and must not touch a drawing database or the editor.
+/// </summary>
+class PropertyExtractionSource
+{
+public:
+    virtual ~PropertyExtractionSource() {}
+
+    /// <summary>
+    /// Appends the objects to extract properties from to objects.
+    /// </summary>
+    virtual Acad::ErrorStatus prepare(std::vector<PropertyExtractionObject>& objects) = 0;
+
+    /// <summary>
+    /// Adds the properties of object to writer.
+    /// </summary>
+    virtual Acad::ErrorStatus extract(const PropertyExtractionObject& object, PropertyWriter& writer) const = 0;
+};
+
+struct PropertyExtractionSettings
+{
+    /// <summary>
+    /// Threads extract() is called on, 0 for one per processor.
+    /// </summary>
+    unsigned threadCount = 0;
+
+    /// <summary>
+    /// Objects a worker takes at a time.  Larger blocks cost less to hand
+    /// out, smaller ones balance uneven objects better.
+    /// </summary>
+    size_t blockSize = 256;
+
+    /// <summary>
+    /// Whether endExtraction hands the properties on to AutoCAD's property
+    /// database with addProperty, or only keeps them in the store.
+    /// </summary>
+    bool forwardProperties = true;
+};
+
+/// <summary>
+/// How an extraction went.  Times are nanoseconds.
+/// </summary>
+struct PropertyExtractionStats
+{
+    Acad::ErrorStatus status = Acad::eOk;   // from prepare(), the merge, or the first extract() that failed
+    unsigned      threadCount = 0;
+    size_t        objectCount = 0;
+    size_t        propertyCount = 0;
+    size_t        stringCount = 0;          // distinct strings in the store
+    size_t        storeBytes = 0;
+    Adesk::UInt64 extractNanoseconds = 0;   // from the first call to extract() to the last return
+    Adesk::UInt64 mergeNanoseconds = 0;
+    Adesk::UInt64 waitNanoseconds = 0;      // endExtraction spent waiting for the workers
+    Adesk::UInt64 forwardNanoseconds = 0;   // spent in addProperty
+};
+
+/// <summary>
+/// Extracts properties on several threads for AutoCAD's property
+/// extraction (AcDwgExtractor), and keeps them in a PropertyStore that can
+/// be queried afterwards.
+///
+/// AcDwgExtractor has a reactor queue objects in beginExtraction and add
+/// their properties, one addProperty call at a time, in endExtraction.
+/// Registered with AcDwgExtractor::Extractor::theOne().addReactor, the
+/// engine queues the objects the source prepares and, while AutoCAD goes on
+/// with its own extraction, has settings.threadCount workers take them in
+/// blocks and write their properties into a PropertyWriter each.  The
+/// writers are merged into one store, which endExtraction waits for and,
+/// unless settings.forwardProperties is off, hands on to addProperty.
+/// extract() does the same work without AcDwgExtractor.
+///
+/// Remove the engine from the extractor before destroying it.
+/// </summary>
+class PropertyExtractionEngine : public AcDwgExtractor::ExtractorReactor
+{
+public:
+    explicit PropertyExtractionEngine(PropertyExtractionSource& source,
+                                      const PropertyExtractionSettings& settings = PropertyExtractionSettings());
+
+    /// <summary>
+    /// Waits for an extraction still running in the background.
+    /// </summary>
+    ~PropertyExtractionEngine();
+
+    PropertyExtractionEngine(const PropertyExtractionEngine&) = delete;
+    PropertyExtractionEngine& operator=(const PropertyExtractionEngine&) = delete;
+
+    void beginExtraction(AcDwgExtractor::BeginExtractionEventArgs& args) override;
+    void endExtraction(AcDwgExtractor::EndExtractionEventArgs& args) override;
+
+    /// <summary>
+    /// Extracts the properties of objects with the source and merges them
+    /// into pStore, waiting for the workers to finish.
+    /// </summary>
+    Acad::ErrorStatus extract(const std::vector<PropertyExtractionObject>& objects,
+                              std::shared_ptr<const PropertyStore>& pStore,
+                              PropertyExtractionStats* pStats = nullptr);
+
+    /// <summary>
+    /// The store and statistics of the last extraction endExtraction
+    /// completed.  The store is null if prepare() failed or the store
+    /// could not be merged.
+    /// </summary>
+    std::shared_ptr<const PropertyStore> lastStore() const;
+    PropertyExtractionStats lastStats() const;
+
+private:
+    Acad::ErrorStatus run(const std::vector<PropertyExtractionObject>& objects,
+                          const std::vector<Adesk::UInt64>& handles,
+                          std::shared_ptr<const PropertyStore>& pStore,
+                          PropertyExtractionStats& stats) const;
+    void forward(const PropertyStore& store, AcDwgExtractor::EndExtractionEventArgs& args,
+                 PropertyExtractionStats& stats) const;
+
+    PropertyExtractionSource&               m_source;
+    PropertyExtractionSettings              m_settings;
+    std::vector<PropertyExtractionObject>   m_objects;      // queued by beginExtraction
+    std::vector<Adesk::UInt64>              m_handles;      // of m_objects, taken on the main thread
+    bool                                    m_extracting;   // between beginExtraction and endExtraction
+    std::thread                             m_worker;       // extracting m_objects
+    std::shared_ptr<const PropertyStore>    m_pPending;     // written by m_worker, read once it is joined
+    PropertyExtractionStats                 m_pendingStats;
+    mutable std::mutex                      m_mutex;        // guards the two below
+    std::shared_ptr<const PropertyStore>    m_pLastStore;
+    PropertyExtractionStats                 m_lastStats;
+};
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,708 @@
+#include "stdafx.h"
+#include "PropertyStore.h"
+#include "AtomicFile.h"
+#include "ParallelFor.h"
+
+#include <new>
+#include <numeric>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+Adesk::UInt64 doubleBits(double value)
+{
+    Adesk::UInt64 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+Adesk::UInt64 alignUp(Adesk::UInt64 value)
+{
+    return (value + kPropertyStoreSectionAlignment - 1) & ~(kPropertyStoreSectionAlignment - 1);
+}
+
+size_t elementSize(int column)
+{
+    switch (column)
+    {
+    case kPropertyHandleColumn:     return sizeof(Adesk::UInt64);
+    case kPropertyFlagsColumn:      return sizeof(Adesk::UInt8);
+    case kPropertyValueColumn:      return sizeof(Adesk::UInt64);
+    case kPropertyPointColumn:      return 3 * sizeof(double);
+    case kPropertyCharColumn:       return sizeof(ACHAR);
+    default:                        return sizeof(Adesk::UInt32);
+    }
+}
+
+Adesk::UInt64 elementCount(const PropertyStoreHeader& header, int column)
+{
+    switch (column)
+    {
+    case kPropertyHandleColumn:
+    case kPropertyViewableColumn:
+    case kPropertyHandleOrderColumn:    return header.entityCount;
+    case kPropertyOffsetColumn:         return header.entityCount + 1;
+    case kPropertyPointColumn:          return header.pointCount;
+    case kPropertyStringOffsetColumn:   return header.stringCount + 1;
+    case kPropertyCharColumn:           return header.charCount;
+    default:                            return header.propertyCount;
+    }
+}
+
+template <class T>
+T* column(Adesk::UInt8* pBase, const PropertyStoreHeader& header, PropertyStoreColumn column)
+{
+    return reinterpret_cast<T*>(pBase + header.sections[column].offset);
+}
+
+/* How PropertyWriter::add stores value: the type, and the 8-byte value for
+all types but strings, which come back in pText, and points.  pText points
+into value or into text. */
+PropertyValueType classify(const AcRxValue& value, Adesk::UInt64& bits, AcGePoint3d& point,
+                           const ACHAR*& pText, std::vector<ACHAR>& text)
+{
+    /* The most common types first: every miss is a comparison of type
+    descriptors. */
+    bits = 0;
+    if (const ACHAR* const* pString = rxvalue_cast<const ACHAR*>(&value))
+    {
+        pText = *pString != nullptr ? *pString : L"";
+        return kPropertyString;
+    }
+    if (const double* pDouble = rxvalue_cast<double>(&value))
+    {
+        bits = doubleBits(*pDouble);
+        return kPropertyDouble;
+    }
+    if (const Adesk::Int32* pInt32 = rxvalue_cast<Adesk::Int32>(&value))
+    {
+        bits = static_cast<Adesk::UInt64>(Adesk::Int64(*pInt32));
+        return kPropertyInt32;
+    }
+    if (const bool* pBool = rxvalue_cast<bool>(&value))
+    {
+        bits = *pBool ? 1 : 0;
+        return kPropertyBool;
+    }
+    if (const AcGePoint3d* pPoint = rxvalue_cast<AcGePoint3d>(&value))
+    {
+        point = *pPoint;
+        return kPropertyPoint;
+    }
+    if (const AcDbObjectId* pId = rxvalue_cast<AcDbObjectId>(&value))
+    {
+        bits = static_cast<Adesk::UInt64>(pId->handle());
+        return kPropertyHandle;
+    }
+    if (const Adesk::Int64* pInt64 = rxvalue_cast<Adesk::Int64>(&value))
+    {
+        bits = static_cast<Adesk::UInt64>(*pInt64);
+        return kPropertyInt64;
+    }
+    if (const Adesk::Int16* pInt16 = rxvalue_cast<Adesk::Int16>(&value))
+    {
+        bits = static_cast<Adesk::UInt64>(Adesk::Int64(*pInt16));
+        return kPropertyInt32;
+    }
+    if (const Adesk::UInt16* pUInt16 = rxvalue_cast<Adesk::UInt16>(&value))
+    {
+        bits = *pUInt16;
+        return kPropertyInt32;
+    }
+    if (const Adesk::UInt32* pUInt32 = rxvalue_cast<Adesk::UInt32>(&value))
+    {
+        bits = *pUInt32;
+        return kPropertyInt64;
+    }
+    if (const Adesk::UInt64* pUInt64 = rxvalue_cast<Adesk::UInt64>(&value))
+    {
+        bits = *pUInt64;
+        return kPropertyInt64;
+    }
+    if (const float* pFloat = rxvalue_cast<float>(&value))
+    {
+        bits = doubleBits(*pFloat);
+        return kPropertyDouble;
+    }
+    if (const AcGePoint2d* pPoint2d = rxvalue_cast<AcGePoint2d>(&value))
+    {
+        point.set(pPoint2d->x, pPoint2d->y, 0.0);
+        return kPropertyPoint;
+    }
+    if (value.isEmpty())
+        return kPropertyEmpty;
+
+    ACHAR buffer[256];
+    const int length = value.toString(buffer, sizeof(buffer) / sizeof(buffer[0]));
+    if (length >= 0 && size_t(length) >= sizeof(buffer) / sizeof(buffer[0]))
+    {
+        text.resize(size_t(length) + 1);
+        value.toString(text.data(), text.size());
+    }
+    else
+        text.assign(buffer, buffer + (length > 0 ? length : 0));
+    text.push_back(L'\0');
+    pText = text.data();
+    return kPropertyString;
+}
+
+} // namespace
+
+/* PropertyWriter ---------------------------------------------------------- */
+
+PropertyWriter::PropertyWriter()
+    : m_entity(0)
+{
+}
+
+void PropertyWriter::clear()
+{
+    m_strings.clear();
+    m_entities.clear();
+    m_rowEntities.clear();
+    m_categories.clear();
+    m_names.clear();
+    m_units.clear();
+    m_flags.clear();
+    m_values.clear();
+    m_points.clear();
+    m_entity = 0;
+}
+
+void PropertyWriter::beginEntity(size_t index, Adesk::UInt64 handle, const ACHAR* viewableId)
+{
+    m_entity = static_cast<Adesk::UInt32>(index);
+    m_entities.push_back(Entity{m_entity, m_strings.intern(viewableId), handle});
+}
+
+void PropertyWriter::append(const ACHAR* category, const ACHAR* name, const ACHAR* units, bool hidden,
+                            PropertyValueType type, Adesk::UInt64 value)
+{
+    m_rowEntities.push_back(m_entity);
+    m_categories.push_back(m_strings.intern(category));
+    m_names.push_back(m_strings.intern(name));
+    m_units.push_back(m_strings.intern(units));
+    m_flags.push_back(static_cast<Adesk::UInt8>(type | (hidden ? PropertyStore::kHidden : 0)));
+    m_values.push_back(value);
+}
+
+void PropertyWriter::addBool(const ACHAR* category, const ACHAR* name, bool value, const ACHAR* units, bool hidden)
+{
+    append(category, name, units, hidden, kPropertyBool, value ? 1 : 0);
+}
+
+void PropertyWriter::addInt32(const ACHAR* category, const ACHAR* name, Adesk::Int32 value, const ACHAR* units, bool hidden)
+{
+    append(category, name, units, hidden, kPropertyInt32, static_cast<Adesk::UInt64>(Adesk::Int64(value)));
+}
+
+void PropertyWriter::addInt64(const ACHAR* category, const ACHAR* name, Adesk::Int64 value, const ACHAR* units, bool hidden)
+{
+    append(category, name, units, hidden, kPropertyInt64, static_cast<Adesk::UInt64>(value));
+}
+
+void PropertyWriter::addDouble(const ACHAR* category, const ACHAR* name, double value, const ACHAR* units, bool hidden)
+{
+    append(category, name, units, hidden, kPropertyDouble, doubleBits(value));
+}
+
+void PropertyWriter::addString(const ACHAR* category, const ACHAR* name, const ACHAR* value, const ACHAR* units, bool hidden)
+{
+    append(category, name, units, hidden, kPropertyString, m_strings.intern(value));
+}
+
+void PropertyWriter::addPoint(const ACHAR* category, const ACHAR* name, const AcGePoint3d& value, const ACHAR* units, bool hidden)
+{
+    append(category, name, units, hidden, kPropertyPoint, m_points.size() / 3);
+    m_points.push_back(value.x);
+    m_points.push_back(value.y);
+    m_points.push_back(value.z);
+}
+
+void PropertyWriter::add(const ACHAR* category, const ACHAR* name, const AcRxValue& value, const ACHAR* units, bool hidden)
+{
+    Adesk::UInt64 bits;
+    AcGePoint3d point;
+    const ACHAR* pText = nullptr;
+    std::vector<ACHAR> text;
+    const PropertyValueType type = classify(value, bits, point, pText, text);
+    if (type == kPropertyString)
+        addString(category, name, pText, units, hidden);
+    else if (type == kPropertyPoint)
+        addPoint(category, name, point, units, hidden);
+    else
+        append(category, name, units, hidden, type, bits);
+}
+
+/* PropertyStore ----------------------------------------------------------- */
+
+Adesk::UInt64 layoutPropertyStore(PropertyStoreHeader& header)
+{
+    Adesk::UInt64 offset = alignUp(sizeof(PropertyStoreHeader));
+    for (int column = 0; column < kPropertyStoreColumnCount; ++column)
+    {
+        PropertyStoreSection& section = header.sections[column];
+        section.offset = offset;
+        section.size = elementCount(header, column) * elementSize(column);
+        offset = alignUp(offset + section.size);
+    }
+    return offset;
+}
+
+PropertyStore::PropertyStore()
+    : m_size(0)
+    , m_pHeader(nullptr)
+    , m_pHandles(nullptr)
+    , m_pViewableIds(nullptr)
+    , m_pOffsets(nullptr)
+    , m_pHandleOrder(nullptr)
+    , m_pCategories(nullptr)
+    , m_pNames(nullptr)
+    , m_pUnits(nullptr)
+    , m_pFlags(nullptr)
+    , m_pValues(nullptr)
+    , m_pPoints(nullptr)
+    , m_pStringOffsets(nullptr)
+    , m_pChars(nullptr)
+{
+}
+
+void PropertyStore::attach(const Adesk::UInt8* pBase, size_t size)
+{
+    m_size = size;
+    m_pHeader = reinterpret_cast<const PropertyStoreHeader*>(pBase);
+    Adesk::UInt8* pColumns = const_cast<Adesk::UInt8*>(pBase);
+    const PropertyStoreHeader& header = *m_pHeader;
+    m_pHandles = column<const Adesk::UInt64>(pColumns, header, kPropertyHandleColumn);
+    m_pViewableIds = column<const Adesk::UInt32>(pColumns, header, kPropertyViewableColumn);
+    m_pOffsets = column<const Adesk::UInt32>(pColumns, header, kPropertyOffsetColumn);
+    m_pHandleOrder = column<const Adesk::UInt32>(pColumns, header, kPropertyHandleOrderColumn);
+    m_pCategories = column<const Adesk::UInt32>(pColumns, header, kPropertyCategoryColumn);
+    m_pNames = column<const Adesk::UInt32>(pColumns, header, kPropertyNameColumn);
+    m_pUnits = column<const Adesk::UInt32>(pColumns, header, kPropertyUnitsColumn);
+    m_pFlags = column<const Adesk::UInt8>(pColumns, header, kPropertyFlagsColumn);
+    m_pValues = column<const Adesk::UInt64>(pColumns, header, kPropertyValueColumn);
+    m_pPoints = column<const double>(pColumns, header, kPropertyPointColumn);
+    m_pStringOffsets = column<const Adesk::UInt32>(pColumns, header, kPropertyStringOffsetColumn);
+    m_pChars = column<const ACHAR>(pColumns, header, kPropertyCharColumn);
+}
+
+Acad::ErrorStatus PropertyStore::merge(const std::vector<const PropertyWriter*>& writers,
+                                       size_t entityCount,
+                                       unsigned threadCount,
+                                       std::shared_ptr<const PropertyStore>& pStore)
+{
+    pStore.reset();
+    size_t propertyCount = 0;
+    for (const PropertyWriter* pWriter : writers)
+        propertyCount += pWriter->propertyCount();
+    if (entityCount >= 0xFFFFFFFFu || propertyCount >= 0xFFFFFFFFu)
+        return Acad::eOutOfRange;
+
+    try
+    {
+        /* One dictionary for all the writers' strings, sorted, and for every
+        writer a table from its ids to the sorted ones.  Sorting, rather than
+        numbering strings as they turn up, is what makes the ids independent
+        of how the entities were spread over the writers. */
+        StringPool strings;
+        const Adesk::UInt32 emptyId = strings.intern(L"", 0);
+        std::vector<std::vector<Adesk::UInt32>> remaps(writers.size());
+        for (size_t w = 0; w < writers.size(); ++w)
+        {
+            const StringPool& local = writers[w]->m_strings;
+            remaps[w].resize(local.size());
+            for (Adesk::UInt32 id = 0; id < local.size(); ++id)
+                remaps[w][id] = strings.intern(local.string(id), local.length(id));
+        }
+        if (strings.characterCount() >= 0xFFFFFFFFu)
+            return Acad::eOutOfRange;
+        std::vector<Adesk::UInt32> order(strings.size());
+        std::iota(order.begin(), order.end(), 0u);
+        std::sort(order.begin(), order.end(), [&strings](Adesk::UInt32 a, Adesk::UInt32 b)
+                  { return std::wcscmp(strings.string(a), strings.string(b)) < 0; });
+        std::vector<Adesk::UInt32> ranks(order.size());
+        for (Adesk::UInt32 rank = 0; rank < order.size(); ++rank)
+            ranks[order[rank]] = rank;
+        for (std::vector<Adesk::UInt32>& remap : remaps)
+        {
+            for (Adesk::UInt32& id : remap)
+                id = ranks[id];
+        }
+
+        /* Count the properties and points of each entity.  An entity belongs
+        to one writer, so the writers touch disjoint counters and can run in
+        parallel here and below. */
+        std::vector<Adesk::UInt32> propertyCounts(entityCount, 0);
+        std::vector<Adesk::UInt32> pointCounts(entityCount, 0);
+        parallelFor(writers.size(), threadCount, [&](size_t w, unsigned)
+        {
+            const PropertyWriter& writer = *writers[w];
+            for (size_t row = 0; row < writer.m_values.size(); ++row)
+            {
+                const Adesk::UInt32 entity = writer.m_rowEntities[row];
+                if (entity >= entityCount)
+                    continue;
+                ++propertyCounts[entity];
+                if ((writer.m_flags[row] & kTypeMask) == kPropertyPoint)
+                    ++pointCounts[entity];
+            }
+        });
+
+        /* Lay the store out and build it in place. */
+        PropertyStoreHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, kPropertyStoreFileMagic, sizeof(header.magic));
+        header.version = kPropertyStoreFileVersion;
+        header.charSize = sizeof(ACHAR);
+        header.entityCount = entityCount;
+        header.stringCount = strings.size();
+        header.charCount = strings.characterCount();
+        for (size_t entity = 0; entity < entityCount; ++entity)
+        {
+            header.propertyCount += propertyCounts[entity];
+            header.pointCount += pointCounts[entity];
+        }
+        const Adesk::UInt64 size = layoutPropertyStore(header);
+
+        std::shared_ptr<PropertyStore> pNew(new PropertyStore());
+        pNew->m_pImage.reset(new Adesk::UInt8[size_t(size)]);
+        Adesk::UInt8* pBase = pNew->m_pImage.get();
+
+        /* Zero what lies between the sections, so that saving the same
+        store twice writes the same bytes. */
+        std::memcpy(pBase, &header, sizeof(header));
+        Adesk::UInt64 gap = sizeof(header);
+        for (int c = 0; c <= kPropertyStoreColumnCount; ++c)
+        {
+            const Adesk::UInt64 next = c < kPropertyStoreColumnCount ? header.sections[c].offset : size;
+            std::memset(pBase + gap, 0, size_t(next - gap));
+            if (c < kPropertyStoreColumnCount)
+                gap = header.sections[c].offset + header.sections[c].size;
+        }
+
+        Adesk::UInt32* pStringOffsets = column<Adesk::UInt32>(pBase, header, kPropertyStringOffsetColumn);
+        ACHAR* pChars = column<ACHAR>(pBase, header, kPropertyCharColumn);
+        Adesk::UInt32 charOffset = 0;
+        for (Adesk::UInt32 rank = 0; rank < order.size(); ++rank)
+        {
+            pStringOffsets[rank] = charOffset;
+            const size_t length = strings.length(order[rank]) + 1;
+            std::memcpy(pChars + charOffset, strings.string(order[rank]), length * sizeof(ACHAR));
+            charOffset += static_cast<Adesk::UInt32>(length);
+        }
+        pStringOffsets[order.size()] = charOffset;
+
+        /* Turn the counts into the first row, and first point, of each entity
+        and then into the cursors the writers scatter their rows through. */
+        Adesk::UInt32* pOffsets = column<Adesk::UInt32>(pBase, header, kPropertyOffsetColumn);
+        pOffsets[0] = 0;
+        Adesk::UInt32 pointCount = 0;
+        for (size_t entity = 0; entity < entityCount; ++entity)
+        {
+            pOffsets[entity + 1] = pOffsets[entity] + propertyCounts[entity];
+            propertyCounts[entity] = pOffsets[entity];
+            const Adesk::UInt32 points = pointCounts[entity];
+            pointCounts[entity] = pointCount;
+            pointCount += points;
+        }
+
+        Adesk::UInt64* pHandles = column<Adesk::UInt64>(pBase, header, kPropertyHandleColumn);
+        Adesk::UInt32* pViewableIds = column<Adesk::UInt32>(pBase, header, kPropertyViewableColumn);
+        std::fill(pHandles, pHandles + entityCount, 0);
+        std::fill(pViewableIds, pViewableIds + entityCount, ranks[emptyId]);
+        Adesk::UInt32* pCategories = column<Adesk::UInt32>(pBase, header, kPropertyCategoryColumn);
+        Adesk::UInt32* pNames = column<Adesk::UInt32>(pBase, header, kPropertyNameColumn);
+        Adesk::UInt32* pUnits = column<Adesk::UInt32>(pBase, header, kPropertyUnitsColumn);
+        Adesk::UInt8* pFlags = column<Adesk::UInt8>(pBase, header, kPropertyFlagsColumn);
+        Adesk::UInt64* pValues = column<Adesk::UInt64>(pBase, header, kPropertyValueColumn);
+        double* pPoints = column<double>(pBase, header, kPropertyPointColumn);
+
+        parallelFor(writers.size(), threadCount, [&](size_t w, unsigned)
+        {
+            const PropertyWriter& writer = *writers[w];
+            const std::vector<Adesk::UInt32>& remap = remaps[w];
+            for (const PropertyWriter::Entity& entity : writer.m_entities)
+            {
+                if (entity.index >= entityCount)
+                    continue;
+                pHandles[entity.index] = entity.handle;
+                pViewableIds[entity.index] = remap[entity.viewableId];
+            }
+            for (size_t row = 0; row < writer.m_values.size(); ++row)
+            {
+                const Adesk::UInt32 entity = writer.m_rowEntities[row];
+                if (entity >= entityCount)
+                    continue;
+                const Adesk::UInt32 target = propertyCounts[entity]++;
+                pCategories[target] = remap[writer.m_categories[row]];
+                pNames[target] = remap[writer.m_names[row]];
+                pUnits[target] = remap[writer.m_units[row]];
+                const Adesk::UInt8 flags = writer.m_flags[row];
+                pFlags[target] = flags;
+                Adesk::UInt64 value = writer.m_values[row];
+                if ((flags & kTypeMask) == kPropertyString)
+                    value = remap[size_t(value)];
+                else if ((flags & kTypeMask) == kPropertyPoint)
+                {
+                    const Adesk::UInt32 point = pointCounts[entity]++;
+                    std::memcpy(pPoints + size_t(point) * 3, &writer.m_points[size_t(value) * 3], 3 * sizeof(double));
+                    value = point;
+                }
+                pValues[target] = value;
+            }
+        });
+
+        /* Entities in order of handle, for findEntity.  Ties keep queue
+        order, so the first of several entities with a handle is found. */
+        Adesk::UInt32* pHandleOrder = column<Adesk::UInt32>(pBase, header, kPropertyHandleOrderColumn);
+        std::iota(pHandleOrder, pHandleOrder + entityCount, 0u);
+        std::stable_sort(pHandleOrder, pHandleOrder + entityCount, [pHandles](Adesk::UInt32 a, Adesk::UInt32 b)
+                         { return pHandles[a] < pHandles[b]; });
+
+        pNew->attach(pBase, size_t(size));
+        pStore = std::move(pNew);
+        return Acad::eOk;
+    }
+    catch (const std::bad_alloc&)
+    {
+        return Acad::eOutOfMemory;
+    }
+}
+
+Acad::ErrorStatus PropertyStore::open(const ACHAR* path, std::shared_ptr<const PropertyStore>& pStore)
+{
+    pStore.reset();
+
+    std::shared_ptr<PropertyStore> pNew(new PropertyStore());
+    Acad::ErrorStatus es = pNew->m_file.open(path, MappedFile::kReadOnly);
+    if (es != Acad::eOk)
+        return es;
+
+    const Adesk::UInt64 fileSize = pNew->m_file.size();
+    if (fileSize < sizeof(PropertyStoreHeader))
+        return Acad::eUnsupportedFileFormat;
+
+    const PropertyStoreHeader* pHeader = reinterpret_cast<const PropertyStoreHeader*>(pNew->m_file.data());
+    if (std::memcmp(pHeader->magic, kPropertyStoreFileMagic, sizeof(pHeader->magic)) != 0)
+        return Acad::eUnsupportedFileFormat;
+    if (pHeader->version != kPropertyStoreFileVersion || pHeader->charSize != sizeof(ACHAR))
+        return Acad::eInvalidDwgVersion;
+
+    /* Re-derive the layout from the counts and compare, rather than trust
+    offsets from the file, so that no column reaches past the end of the
+    view.  Counts are bounded first so the layout cannot overflow. */
+    if (pHeader->entityCount >= 0xFFFFFFFFu || pHeader->propertyCount >= 0xFFFFFFFFu
+        || pHeader->pointCount > pHeader->propertyCount || pHeader->stringCount >= 0xFFFFFFFFu
+        || pHeader->charCount >= 0xFFFFFFFFu || pHeader->stringCount == 0)
+        return Acad::eInvalidInput;
+    PropertyStoreHeader expected = *pHeader;
+    if (layoutPropertyStore(expected) > fileSize)
+        return Acad::eInvalidInput;
+    for (int c = 0; c < kPropertyStoreColumnCount; ++c)
+    {
+        if (expected.sections[c].offset != pHeader->sections[c].offset
+            || expected.sections[c].size != pHeader->sections[c].size)
+            return Acad::eInvalidInput;
+    }
+
+    pNew->attach(pNew->m_file.data(), size_t(fileSize));
+    pStore = std::move(pNew);
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus PropertyStore::save(const ACHAR* path) const
+{
+    return writeFileAtomically(path, m_pHeader, m_size);
+}
+
+Acad::ErrorStatus PropertyStore::verify() const
+{
+    const PropertyStoreHeader& header = *m_pHeader;
+    const Adesk::UInt64 stringCount = header.stringCount;
+    const Adesk::UInt64 charCount = header.charCount;
+
+    if (m_pStringOffsets[0] != 0 || m_pStringOffsets[stringCount] != charCount)
+        return Acad::eInvalidInput;
+    for (Adesk::UInt64 id = 0; id < stringCount; ++id)
+    {
+        const Adesk::UInt32 end = m_pStringOffsets[id + 1];
+        if (end <= m_pStringOffsets[id] || end > charCount || m_pChars[end - 1] != L'\0')
+            return Acad::eInvalidInput;
+        if (id > 0 && std::wcscmp(string(Adesk::UInt32(id - 1)), string(Adesk::UInt32(id))) >= 0)
+            return Acad::eInvalidInput;
+    }
+
+    if (m_pOffsets[0] != 0 || m_pOffsets[header.entityCount] != header.propertyCount)
+        return Acad::eInvalidInput;
+    for (Adesk::UInt64 entity = 0; entity < header.entityCount; ++entity)
+    {
+        if (m_pOffsets[entity + 1] < m_pOffsets[entity] || m_pViewableIds[entity] >= stringCount
+            || m_pHandleOrder[entity] >= header.entityCount)
+            return Acad::eInvalidInput;
+        if (entity > 0 && m_pHandles[m_pHandleOrder[entity - 1]] > m_pHandles[m_pHandleOrder[entity]])
+            return Acad::eInvalidInput;
+    }
+
+    for (Adesk::UInt64 property = 0; property < header.propertyCount; ++property)
+    {
+        if (m_pCategories[property] >= stringCount || m_pNames[property] >= stringCount
+            || m_pUnits[property] >= stringCount || (m_pFlags[property] & kTypeMask) > kPropertyHandle)
+            return Acad::eInvalidInput;
+        const PropertyValueType valueType = type(size_t(property));
+        if ((valueType == kPropertyString && m_pValues[property] >= stringCount)
+            || (valueType == kPropertyPoint && m_pValues[property] >= header.pointCount))
+            return Acad::eInvalidInput;
+    }
+    return Acad::eOk;
+}
+
+double PropertyStore::doubleValue(size_t property) const
+{
+    double value;
+    std::memcpy(&value, &m_pValues[property], sizeof(value));
+    return value;
+}
+
+AcGePoint3d PropertyStore::pointValue(size_t property) const
+{
+    const double* pPoint = &m_pPoints[size_t(m_pValues[property]) * 3];
+    return AcGePoint3d(pPoint[0], pPoint[1], pPoint[2]);
+}
+
+AcRxValue PropertyStore::value(size_t property) const
+{
+    switch (type(property))
+    {
+    case kPropertyBool:
+        return AcRxValue(boolValue(property));
+    case kPropertyInt32:
+        return AcRxValue(static_cast<Adesk::Int32>(intValue(property)));
+    case kPropertyInt64:
+        return AcRxValue(intValue(property));
+    case kPropertyDouble:
+        return AcRxValue(doubleValue(property));
+    case kPropertyString:
+    {
+        const ACHAR* pText = stringValue(property);
+        return AcRxValue(pText);
+    }
+    case kPropertyPoint:
+        return AcRxValue(pointValue(property));
+    case kPropertyHandle:
+    {
+        AcString text;
+        text.format(L"%llX", static_cast<unsigned long long>(handleValue(property)));
+        return AcRxValue(text);
+    }
+    default:
+        return AcRxValue();
+    }
+}
+
+Adesk::UInt32 PropertyStore::findString(const ACHAR* text) const
+{
+    if (text == nullptr)
+        text = L"";
+    size_t low = 0;
+    size_t high = stringCount();
+    while (low < high)
+    {
+        const size_t middle = (low + high) / 2;
+        const int order = std::wcscmp(string(static_cast<Adesk::UInt32>(middle)), text);
+        if (order == 0)
+            return static_cast<Adesk::UInt32>(middle);
+        if (order < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return StringPool::kNotFound;
+}
+
+size_t PropertyStore::findEntity(Adesk::UInt64 handle) const
+{
+    const Adesk::UInt32* pEnd = m_pHandleOrder + entityCount();
+    const Adesk::UInt32* pFound = std::lower_bound(m_pHandleOrder, pEnd, handle,
+                                                   [this](Adesk::UInt32 entity, Adesk::UInt64 value)
+                                                   { return m_pHandles[entity] < value; });
+    return pFound != pEnd && m_pHandles[*pFound] == handle ? *pFound : kNotFound;
+}
+
+size_t PropertyStore::findProperty(size_t entity, const ACHAR* category, const ACHAR* name) const
+{
+    const Adesk::UInt32 categoryId = findString(category);
+    const Adesk::UInt32 nameId = findString(name);
+    if (categoryId == StringPool::kNotFound || nameId == StringPool::kNotFound)
+        return kNotFound;
+    for (size_t property = firstProperty(entity); property < endProperty(entity); ++property)
+    {
+        if (m_pNames[property] == nameId && m_pCategories[property] == categoryId)
+            return property;
+    }
+    return kNotFound;
+}
+
+size_t PropertyStore::findEntities(const ACHAR* category, const ACHAR* name, const AcRxValue& value,
+                                   std::vector<Adesk::UInt32>& entities) const
+{
+    /* Every string involved is looked up once, so that the scan compares
+    ids only; a string the dictionary lacks matches nothing. */
+    const Adesk::UInt32 nameId = findString(name);
+    const Adesk::UInt32 categoryId = category != nullptr ? findString(category) : StringPool::kNotFound;
+    if (nameId == StringPool::kNotFound || (category != nullptr && categoryId == StringPool::kNotFound))
+        return 0;
+
+    Adesk::UInt64 bits;
+    AcGePoint3d point;
+    const ACHAR* pText = nullptr;
+    std::vector<ACHAR> text;
+    PropertyValueType valueType = classify(value, bits, point, pText, text);
+    if (valueType == kPropertyString)
+    {
+        const Adesk::UInt32 id = findString(pText);
+        if (id == StringPool::kNotFound)
+            return 0;
+        bits = id;
+    }
+    const bool integer = valueType == kPropertyInt32 || valueType == kPropertyInt64;
+    double number;
+    std::memcpy(&number, &bits, sizeof(number));
+
+    const size_t count = entities.size();
+    const size_t propertyEnd = propertyCount();
+    size_t entity = 0;
+    for (size_t property = 0; property < propertyEnd; ++property)
+    {
+        if (m_pNames[property] != nameId || (category != nullptr && m_pCategories[property] != categoryId))
+            continue;
+        const PropertyValueType storedType = type(property);
+        bool equal;
+        if (integer)
+            equal = (storedType == kPropertyInt32 || storedType == kPropertyInt64) && m_pValues[property] == bits;
+        else if (storedType != valueType)
+            equal = false;
+        else if (valueType == kPropertyDouble)
+            equal = doubleValue(property) == number;
+        else if (valueType == kPropertyPoint)
+        {
+            const double* pPoint = &m_pPoints[size_t(m_pValues[property]) * 3];
+            equal = pPoint[0] == point.x && pPoint[1] == point.y && pPoint[2] == point.z;
+        }
+        else
+            equal = m_pValues[property] == bits;
+        if (!equal)
+            continue;
+
+        /* Rows are in entity order, so the entity of a match is found by
+        walking the offsets forward, never back. */
+        while (m_pOffsets[entity + 1] <= property)
+            ++entity;
+        if (entities.size() == count || entities.back() != entity)
+            entities.push_back(static_cast<Adesk::UInt32>(entity));
+    }
+    return entities.size() - count;
+}
+
+} // namespace acad_sheetset_to_pdf
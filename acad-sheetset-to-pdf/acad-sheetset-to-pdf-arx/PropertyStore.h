@@ -0,0 +1,312 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "StringPool.h"
+
+#include "acdwgextractor.h"
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// The kinds of value a PropertyStore holds, one per AcRxValue type it
+/// keeps as such.  16-bit and smaller integers are kept as kInt32, float as
+/// kDouble, unsigned 32 and 64-bit integers as kInt64 (the latter by their
+/// bit pattern), AcGePoint2d as kPoint with a z of 0 and AcDbObjectId as
+/// the kHandle of the object.  Any other type is kept as the kString that
+/// AcRxValue::toString makes of it.
+/// </summary>
+enum PropertyValueType
+{
+    kPropertyEmpty = 0,
+    kPropertyBool,
+    kPropertyInt32,
+    kPropertyInt64,
+    kPropertyDouble,
+    kPropertyString,
+    kPropertyPoint,
+    kPropertyHandle
+};
+
+/// <summary>
+/// Collects the properties of entities in the column layout of a
+/// PropertyStore: a row per property, with the category, name and units
+/// interned in a StringPool of the writer's own and the value in an 8-byte
+/// column read according to a type column.
+///
+/// Each extraction thread writes to a writer of its own, which
+/// PropertyStore::merge then combines; nothing is shared, so adding a
+/// property takes no lock and, once the strings involved have been seen,
+/// allocates only when a column grows.
+/// </summary>
+class PropertyWriter
+{
+public:
+    PropertyWriter();
+
+    PropertyWriter(const PropertyWriter&) = delete;
+    PropertyWriter& operator=(const PropertyWriter&) = delete;
+
+    /// <summary>
+    /// Adds a property of the current entity, as
+    /// AcDwgExtractor::EndExtractionEventArgs::addProperty would.
+    /// </summary>
+    void add(const ACHAR* category, const ACHAR* name, const AcRxValue& value,
+             const ACHAR* units = L"", bool hidden = false);
+
+    /* The same for values whose type is known, without an AcRxValue. */
+    void addBool(const ACHAR* category, const ACHAR* name, bool value, const ACHAR* units = L"", bool hidden = false);
+    void addInt32(const ACHAR* category, const ACHAR* name, Adesk::Int32 value, const ACHAR* units = L"", bool hidden = false);
+    void addInt64(const ACHAR* category, const ACHAR* name, Adesk::Int64 value, const ACHAR* units = L"", bool hidden = false);
+    void addDouble(const ACHAR* category, const ACHAR* name, double value, const ACHAR* units = L"", bool hidden = false);
+    void addString(const ACHAR* category, const ACHAR* name, const ACHAR* value, const ACHAR* units = L"", bool hidden = false);
+    void addPoint(const ACHAR* category, const ACHAR* name, const AcGePoint3d& value, const ACHAR* units = L"", bool hidden = false);
+
+    /// <summary>
+    /// Starts the properties of the entity at index: whatever is added from
+    /// now on belongs to it.  An entity must be begun by one writer only,
+    /// and only once.
+    /// </summary>
+    void beginEntity(size_t index, Adesk::UInt64 handle, const ACHAR* viewableId);
+
+    size_t entityCount() const { return m_entities.size(); }
+    size_t propertyCount() const { return m_values.size(); }
+
+    void clear();
+
+private:
+    friend class PropertyStore;
+
+    struct Entity
+    {
+        Adesk::UInt32 index;
+        Adesk::UInt32 viewableId;
+        Adesk::UInt64 handle;
+    };
+
+    void append(const ACHAR* category, const ACHAR* name, const ACHAR* units, bool hidden,
+                PropertyValueType type, Adesk::UInt64 value);
+
+    StringPool                  m_strings;
+    std::vector<Entity>         m_entities;
+    std::vector<Adesk::UInt32>  m_rowEntities;  // entity index of each row
+    std::vector<Adesk::UInt32>  m_categories;
+    std::vector<Adesk::UInt32>  m_names;
+    std::vector<Adesk::UInt32>  m_units;
+    std::vector<Adesk::UInt8>   m_flags;
+    std::vector<Adesk::UInt64>  m_values;
+    std::vector<double>         m_points;       // x, y, z of each kPropertyPoint row
+    Adesk::UInt32               m_entity;
+};
+
+/// <summary>
+/// Layout of a PropertyStore, in memory and on disk (*.acprops).
+///
+/// A PropertyStoreHeader comes first, then every column as a section of its
+/// own, each starting on a kPropertyStoreSectionAlignment boundary.  A store
+/// merged in memory is built in exactly this layout, so saving it is a
+/// single write and opening a saved one maps the file and points into it:
+/// nothing is parsed or copied, and a query that only looks at names never
+/// touches the pages of the other columns.
+/// </summary>
+enum PropertyStoreColumn
+{
+    kPropertyHandleColumn = 0,      // UInt64 per entity
+    kPropertyViewableColumn,        // UInt32 string id per entity
+    kPropertyOffsetColumn,          // UInt32 first property per entity, plus the end
+    kPropertyHandleOrderColumn,     // UInt32 entities in order of handle
+    kPropertyCategoryColumn,        // UInt32 string id per property
+    kPropertyNameColumn,            // UInt32 string id per property
+    kPropertyUnitsColumn,           // UInt32 string id per property
+    kPropertyFlagsColumn,           // UInt8 type, and hidden, per property
+    kPropertyValueColumn,           // UInt64 per property
+    kPropertyPointColumn,           // 3 doubles per point
+    kPropertyStringOffsetColumn,    // UInt32 start of each string, plus the end
+    kPropertyCharColumn,            // ACHAR, the strings in order, NUL terminated
+    kPropertyStoreColumnCount
+};
+
+const Adesk::UInt64 kPropertyStoreSectionAlignment = 64;
+const Adesk::UInt32 kPropertyStoreFileVersion = 1;
+const char kPropertyStoreFileMagic[8] = { 'A', 'C', 'P', 'R', 'O', 'P', 'S', '\0' };
+
+struct PropertyStoreSection
+{
+    Adesk::UInt64 offset;   // from the start of the store
+    Adesk::UInt64 size;     // in bytes
+};
+
+struct PropertyStoreHeader
+{
+    char                 magic[8];
+    Adesk::UInt32        version;
+    Adesk::UInt32        charSize;      // sizeof(ACHAR) of the writer
+    Adesk::UInt64        entityCount;
+    Adesk::UInt64        propertyCount;
+    Adesk::UInt64        pointCount;
+    Adesk::UInt64        stringCount;
+    Adesk::UInt64        charCount;
+    PropertyStoreSection sections[kPropertyStoreColumnCount];
+};
+
+/// <summary>
+/// Fills in the section table of header for its counts and returns the
+/// size of the store.
+/// </summary>
+Adesk::UInt64 layoutPropertyStore(PropertyStoreHeader& header);
+
+/// <summary>
+/// The extracted properties of a set of entities, kept column by column.
+///
+/// Entities are numbered in the order they were queued.  The properties of
+/// an entity are contiguous and in the order they were added, and
+/// firstProperty/endProperty delimit them.  Category, name, units and
+/// string values are ids into one dictionary, sorted so that a string can
+/// be looked up without a hash table.  Values are 8 bytes each, read
+/// according to type(); points live in a column of their own.  A store
+/// never changes once merged or opened, so any number of threads may read
+/// it.
+/// </summary>
+class PropertyStore
+{
+public:
+    static const size_t kNotFound = size_t(-1);
+
+    /// <summary>
+    /// Combines writers into a store of entityCount entities, on up to
+    /// threadCount threads (0 for one per processor).  Every entity is
+    /// expected to have been begun by one of the writers; one that was not
+    /// has no properties and a handle of 0.  The result does not depend on
+    /// which writer wrote which entity.
+    /// </summary>
+    static Acad::ErrorStatus merge(const std::vector<const PropertyWriter*>& writers,
+                                   size_t entityCount,
+                                   unsigned threadCount,
+                                   std::shared_ptr<const PropertyStore>& pStore);
+
+    /// <summary>
+    /// Maps a store saved with save().  Only the header and section table
+    /// are checked, which costs the same for any size of store; call
+    /// verify() before trusting a file that may have been damaged.
+    /// </summary>
+    static Acad::ErrorStatus open(const ACHAR* path, std::shared_ptr<const PropertyStore>& pStore);
+
+    /// <summary>
+    /// Writes the store to path, replacing the file atomically.
+    /// </summary>
+    Acad::ErrorStatus save(const ACHAR* path) const;
+
+    /// <summary>
+    /// Checks every id, offset and string of the store against the counts
+    /// in its header, reading all of it.  Returns Acad::eInvalidInput if
+    /// anything is out of range.
+    /// </summary>
+    Acad::ErrorStatus verify() const;
+
+    PropertyStore(const PropertyStore&) = delete;
+    PropertyStore& operator=(const PropertyStore&) = delete;
+
+    size_t entityCount() const { return size_t(m_pHeader->entityCount); }
+    size_t propertyCount() const { return size_t(m_pHeader->propertyCount); }
+
+    Adesk::UInt64 handle(size_t entity) const { return m_pHandles[entity]; }
+    const ACHAR* viewableId(size_t entity) const { return string(m_pViewableIds[entity]); }
+    size_t firstProperty(size_t entity) const { return m_pOffsets[entity]; }
+    size_t endProperty(size_t entity) const { return m_pOffsets[entity + 1]; }
+
+    /// <summary>
+    /// The entity whose handle is handle, or kNotFound.  If several have it,
+    /// the first.
+    /// </summary>
+    size_t findEntity(Adesk::UInt64 handle) const;
+
+    /// <summary>
+    /// Index of the property of entity with that category and name, or
+    /// kNotFound.
+    /// </summary>
+    size_t findProperty(size_t entity, const ACHAR* category, const ACHAR* name) const;
+
+    /// <summary>
+    /// Appends to entities, in order, every entity that has a property
+    /// called name, in category or in any category if that is null, whose
+    /// value equals value, and returns how many it appended.  value is
+    /// taken as PropertyWriter::add would store it; integers compare by
+    /// value whatever their width, doubles and points exactly.
+    /// </summary>
+    size_t findEntities(const ACHAR* category, const ACHAR* name, const AcRxValue& value,
+                        std::vector<Adesk::UInt32>& entities) const;
+
+    Adesk::UInt32 categoryId(size_t property) const { return m_pCategories[property]; }
+    Adesk::UInt32 nameId(size_t property) const { return m_pNames[property]; }
+    Adesk::UInt32 unitsId(size_t property) const { return m_pUnits[property]; }
+    const ACHAR* category(size_t property) const { return string(m_pCategories[property]); }
+    const ACHAR* name(size_t property) const { return string(m_pNames[property]); }
+    const ACHAR* units(size_t property) const { return string(m_pUnits[property]); }
+    PropertyValueType type(size_t property) const { return PropertyValueType(m_pFlags[property] & kTypeMask); }
+    bool isHidden(size_t property) const { return (m_pFlags[property] & kHidden) != 0; }
+
+    /* The value of a property, as stored; read the one type() calls for. */
+    bool boolValue(size_t property) const { return m_pValues[property] != 0; }
+    Adesk::Int64 intValue(size_t property) const { return static_cast<Adesk::Int64>(m_pValues[property]); }
+    double doubleValue(size_t property) const;
+    const ACHAR* stringValue(size_t property) const { return string(static_cast<Adesk::UInt32>(m_pValues[property])); }
+    AcGePoint3d pointValue(size_t property) const;
+    Adesk::UInt64 handleValue(size_t property) const { return m_pValues[property]; }
+
+    /// <summary>
+    /// The value of a property as an AcRxValue of the type it was added
+    /// with, except as PropertyValueType says.  A handle comes back as its
+    /// hexadecimal string, there being no database to find the object in.
+    /// A string value points into the store.
+    /// </summary>
+    AcRxValue value(size_t property) const;
+
+    size_t stringCount() const { return size_t(m_pHeader->stringCount); }
+    const ACHAR* string(Adesk::UInt32 id) const { return m_pChars + m_pStringOffsets[id]; }
+
+    /// <summary>
+    /// Id of text in the dictionary, or StringPool::kNotFound.
+    /// </summary>
+    Adesk::UInt32 findString(const ACHAR* text) const;
+
+    /// <summary>
+    /// Bytes taken by the store, the same in memory as on disk.
+    /// </summary>
+    size_t byteCount() const { return m_size; }
+
+    /// <summary>
+    /// Whether the store was opened from a file rather than merged.
+    /// </summary>
+    bool isMapped() const { return m_file.isOpen(); }
+
+private:
+    friend class PropertyWriter;
+
+    enum
+    {
+        kTypeMask = 0x0F,
+        kHidden = 0x10
+    };
+
+    PropertyStore();
+
+    void attach(const Adesk::UInt8* pBase, size_t size);
+
+    std::unique_ptr<Adesk::UInt8[]> m_pImage;       // a merged store
+    MappedFile                      m_file;         // an opened one
+    size_t                          m_size;
+    const PropertyStoreHeader*      m_pHeader;
+    const Adesk::UInt64*            m_pHandles;
+    const Adesk::UInt32*            m_pViewableIds;
+    const Adesk::UInt32*            m_pOffsets;
+    const Adesk::UInt32*            m_pHandleOrder;
+    const Adesk::UInt32*            m_pCategories;
+    const Adesk::UInt32*            m_pNames;
+    const Adesk::UInt32*            m_pUnits;
+    const Adesk::UInt8*             m_pFlags;
+    const Adesk::UInt64*            m_pValues;
+    const double*                   m_pPoints;
+    const Adesk::UInt32*            m_pStringOffsets;
+    const ACHAR*                    m_pChars;
+};
+
+} // namespace acad_sheetset_to_pdf
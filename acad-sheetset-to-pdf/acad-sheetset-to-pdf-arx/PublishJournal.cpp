@@ -0,0 +1,549 @@
+#include "stdafx.h"
+#include "PublishJournal.h"
+#include "AtomicFile.h"
+#include "Checksum.h"
+#include "MappedFile.h"
+#include "PdfFragmentAssembler.h"
+
+#include <climits>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+/* The journal is a 32 byte header followed by one record per journaled
+sheet, all little-endian:
+
+    header   UInt32 'PJNL', UInt32 version, UInt64 fingerprint,
+             UInt32 sheet count, 8 reserved bytes, UInt32 CRC of the above
+    record   UInt32 'SHT1', UInt32 payload length, payload, UInt32 CRC of
+             the payload
+    payload  UInt32 sheet, UInt32 fragment CRC, UInt64 fragment size,
+             UInt32 path length, path as UTF-16 without terminator
+
+A later record for a sheet replaces an earlier one. */
+const Adesk::UInt32 kJournalMagic = 0x4C4E4A50;     // "PJNL"
+const Adesk::UInt32 kJournalVersion = 1;
+const Adesk::UInt32 kRecordMagic = 0x31544853;      // "SHT1"
+const size_t kHeaderSize = 32;
+const size_t kRecordOverhead = 12;
+const size_t kPayloadFixedSize = 20;
+
+template <typename T>
+T load(const Adesk::UInt8* p)
+{
+    T value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+template <typename T>
+void store(std::vector<Adesk::UInt8>& buffer, T value)
+{
+    const Adesk::UInt8* p = reinterpret_cast<const Adesk::UInt8*>(&value);
+    buffer.insert(buffer.end(), p, p + sizeof(value));
+}
+
+Adesk::UInt64 fingerprintOf(const std::vector<AcString>& sheets, const ACHAR* target)
+{
+    const ACHAR separator = 0;
+    Adesk::UInt64 hash = fnv1a64(nullptr, 0);
+    for (const AcString& sheet : sheets)
+    {
+        hash = fnv1a64(sheet.constPtr(), sheet.length() * sizeof(ACHAR), hash);
+        hash = fnv1a64(&separator, sizeof(separator), hash);
+    }
+    return fnv1a64(target, std::wcslen(target) * sizeof(ACHAR), hash);
+}
+
+/* Size and CRC-32 of a whole file. */
+Acad::ErrorStatus checksumFile(const ACHAR* path, Adesk::UInt64& size, Adesk::UInt32& crc)
+{
+    MappedFile file;
+    const Acad::ErrorStatus es = file.open(path);
+    if (es != Acad::eOk)
+        return es;
+    size = file.size();
+    crc = crc32(file.data(), static_cast<size_t>(file.size()));
+    return Acad::eOk;
+}
+
+Adesk::UInt64 sizeOfFile(const ACHAR* path)
+{
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!::GetFileAttributesExW(path, GetFileExInfoStandard, &attributes))
+        return ~Adesk::UInt64(0);
+    return (Adesk::UInt64(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+}
+
+Acad::ErrorStatus writeAll(HANDLE hFile, const void* pData, size_t size)
+{
+    return MappedFile::statusFromWin32(writeFileFully(hFile, pData, size));
+}
+
+/* Whether a file starts like one of the document formats AutoCAD publishes
+to that are invalid when appended to one another: PDF, whose trailer and
+cross-reference table must come last; DWF 6, and DWFx and other ZIP
+packages, whose central directory must. */
+bool isSelfContainedDocument(const void* pData, Adesk::UInt64 size)
+{
+    static const char* const kSignatures[] = {"%PDF-", "(DWF V", "PK\x03\x04"};
+    for (const char* pSignature : kSignatures)
+    {
+        const size_t length = std::strlen(pSignature);
+        if (size >= length && std::memcmp(pData, pSignature, length) == 0)
+            return true;
+    }
+    return false;
+}
+
+} // namespace
+
+/* ConcatenatingFragmentAssembler ------------------------------------------ */
+
+Acad::ErrorStatus ConcatenatingFragmentAssembler::assemble(const std::vector<std::wstring>& fragments,
+                                                           const ACHAR* outputPath)
+{
+    if (outputPath == nullptr)
+        return Acad::eNullPtr;
+
+    /* Written beside the output and renamed over it, so that the output is
+    either the old file or the whole new one. */
+    std::wstring temporaryPath(outputPath);
+    temporaryPath += L".tmp";
+    HANDLE hFile = ::CreateFileW(temporaryPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                                 FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return MappedFile::statusFromWin32(::GetLastError());
+
+    Acad::ErrorStatus es = Acad::eOk;
+    for (size_t i = 0; i < fragments.size() && es == Acad::eOk; ++i)
+    {
+        MappedFile fragment;
+        es = fragment.open(fragments[i].c_str());
+        if (es == Acad::eOk && isSelfContainedDocument(fragment.data(), fragment.size()))
+            es = Acad::eUnsupportedFileFormat;
+        if (es == Acad::eOk)
+            es = writeAll(hFile, fragment.data(), static_cast<size_t>(fragment.size()));
+    }
+    if (es == Acad::eOk && !::FlushFileBuffers(hFile))
+        es = MappedFile::statusFromWin32(::GetLastError());
+    ::CloseHandle(hFile);
+
+    if (es == Acad::eOk &&
+        !::MoveFileExW(temporaryPath.c_str(), outputPath, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+        es = MappedFile::statusFromWin32(::GetLastError());
+    if (es != Acad::eOk)
+        ::DeleteFileW(temporaryPath.c_str());
+    return es;
+}
+
+/* PublishJournal ---------------------------------------------------------- */
+
+PublishJournal::PublishJournal()
+    : m_hFile(INVALID_HANDLE_VALUE)
+    , m_fingerprint(0)
+    , m_resumedCount(0)
+{
+}
+
+PublishJournal::~PublishJournal()
+{
+    close();
+}
+
+void PublishJournal::close()
+{
+    if (m_hFile != INVALID_HANDLE_VALUE)
+    {
+        ::CloseHandle(m_hFile);
+        m_hFile = INVALID_HANDLE_VALUE;
+    }
+    m_sheets.clear();
+    m_fingerprint = 0;
+    m_resumedCount = 0;
+}
+
+Acad::ErrorStatus PublishJournal::open(const ACHAR* path, const std::vector<AcString>& sheets, const ACHAR* target)
+{
+    close();
+    if (path == nullptr || target == nullptr)
+        return Acad::eNullPtr;
+    if (sheets.size() > 0xFFFFFFFFu)
+        return Acad::eInvalidInput;
+
+    m_sheets.resize(sheets.size());
+    m_fingerprint = fingerprintOf(sheets, target);
+
+    /* Replay whatever an earlier run of the same job left behind.  A journal
+    that cannot be read, or that belongs to another job, is started over. */
+    size_t validSize = 0;
+    {
+        MappedFile existing;
+        if (existing.open(path) == Acad::eOk && existing.size() >= kHeaderSize)
+        {
+            const Adesk::UInt8* pData = existing.data();
+            if (load<Adesk::UInt32>(pData) == kJournalMagic &&
+                load<Adesk::UInt32>(pData + 4) == kJournalVersion &&
+                load<Adesk::UInt64>(pData + 8) == m_fingerprint &&
+                load<Adesk::UInt32>(pData + 16) == sheets.size() &&
+                load<Adesk::UInt32>(pData + 28) == crc32(pData, 28))
+            {
+                replay(pData, static_cast<size_t>(existing.size()), validSize);
+            }
+        }
+    }
+    if (validSize == 0)
+    {
+        for (SheetState& sheet : m_sheets)
+            sheet = SheetState();
+        return startNew(path);
+    }
+
+    m_hFile = ::CreateFileW(path, GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_hFile == INVALID_HANDLE_VALUE)
+    {
+        const DWORD error = ::GetLastError();
+        close();
+        return MappedFile::statusFromWin32(error);
+    }
+
+    /* Cut off a record torn by the crash so that new records follow the last
+    good one. */
+    LARGE_INTEGER end;
+    end.QuadPart = static_cast<LONGLONG>(validSize);
+    if (!::SetFilePointerEx(m_hFile, end, nullptr, FILE_BEGIN) || !::SetEndOfFile(m_hFile))
+    {
+        const DWORD error = ::GetLastError();
+        close();
+        return MappedFile::statusFromWin32(error);
+    }
+
+    /* Only the size is checked here; reading every fragment back would cost
+    as much as a good share of the publish.  assemble() checks the CRCs. */
+    for (SheetState& sheet : m_sheets)
+    {
+        if (sheet.done && sizeOfFile(sheet.fragment.c_str()) != sheet.size)
+            sheet = SheetState();
+        if (sheet.done)
+            ++m_resumedCount;
+    }
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus PublishJournal::replay(const Adesk::UInt8* pData, size_t size, size_t& validSize)
+{
+    size_t offset = kHeaderSize;
+    validSize = offset;
+    while (size - offset >= kRecordOverhead)
+    {
+        const Adesk::UInt8* pRecord = pData + offset;
+        const Adesk::UInt32 payloadLength = load<Adesk::UInt32>(pRecord + 4);
+        if (load<Adesk::UInt32>(pRecord) != kRecordMagic || payloadLength < kPayloadFixedSize ||
+            payloadLength > size - offset - kRecordOverhead)
+            break;
+        const Adesk::UInt8* pPayload = pRecord + 8;
+        if (load<Adesk::UInt32>(pPayload + payloadLength) != crc32(pPayload, payloadLength))
+            break;
+
+        const Adesk::UInt32 sheet = load<Adesk::UInt32>(pPayload);
+        const Adesk::UInt32 pathLength = load<Adesk::UInt32>(pPayload + 16);
+        if (sheet >= m_sheets.size() || pathLength != (payloadLength - kPayloadFixedSize) / sizeof(wchar_t))
+            break;
+
+        SheetState& state = m_sheets[sheet];
+        state.done = true;
+        state.crc = load<Adesk::UInt32>(pPayload + 4);
+        state.size = load<Adesk::UInt64>(pPayload + 8);
+        state.fragment.resize(pathLength);
+        std::memcpy(&state.fragment[0], pPayload + kPayloadFixedSize, pathLength * sizeof(wchar_t));
+
+        offset += kRecordOverhead + payloadLength;
+        validSize = offset;
+    }
+    return validSize == size ? Acad::eOk : Acad::eEndOfFile;
+}
+
+Acad::ErrorStatus PublishJournal::startNew(const ACHAR* path)
+{
+    m_hFile = ::CreateFileW(path, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_hFile == INVALID_HANDLE_VALUE)
+    {
+        const DWORD error = ::GetLastError();
+        close();
+        return MappedFile::statusFromWin32(error);
+    }
+
+    std::vector<Adesk::UInt8> header;
+    header.reserve(kHeaderSize);
+    store(header, kJournalMagic);
+    store(header, kJournalVersion);
+    store(header, m_fingerprint);
+    store(header, static_cast<Adesk::UInt32>(m_sheets.size()));
+    store(header, Adesk::UInt32(0));
+    store(header, Adesk::UInt32(0));
+    store(header, crc32(header.data(), header.size()));
+    const Acad::ErrorStatus es = append(header.data(), header.size());
+    if (es != Acad::eOk)
+        close();
+    return es;
+}
+
+Acad::ErrorStatus PublishJournal::append(const void* pData, size_t size)
+{
+    Acad::ErrorStatus es = writeAll(m_hFile, pData, size);
+    if (es == Acad::eOk && !::FlushFileBuffers(m_hFile))
+        es = MappedFile::statusFromWin32(::GetLastError());
+    return es;
+}
+
+bool PublishJournal::isComplete() const
+{
+    if (!isOpen())
+        return false;
+    for (const SheetState& sheet : m_sheets)
+    {
+        if (!sheet.done)
+            return false;
+    }
+    return true;
+}
+
+std::vector<size_t> PublishJournal::pendingSheets() const
+{
+    std::vector<size_t> pending;
+    for (size_t i = 0; i < m_sheets.size(); ++i)
+    {
+        if (!m_sheets[i].done)
+            pending.push_back(i);
+    }
+    return pending;
+}
+
+Acad::ErrorStatus PublishJournal::recordSheet(size_t sheet, const ACHAR* fragmentPath)
+{
+    if (!isOpen())
+        return Acad::eNotOpenForWrite;
+    if (fragmentPath == nullptr)
+        return Acad::eNullPtr;
+    if (sheet >= m_sheets.size())
+        return Acad::eInvalidIndex;
+
+    SheetState state;
+    Acad::ErrorStatus es = checksumFile(fragmentPath, state.size, state.crc);
+    if (es != Acad::eOk)
+        return es;
+    state.done = true;
+    state.fragment = fragmentPath;
+
+    const size_t pathBytes = state.fragment.size() * sizeof(wchar_t);
+    std::vector<Adesk::UInt8> payload;
+    payload.reserve(kPayloadFixedSize + pathBytes);
+    store(payload, static_cast<Adesk::UInt32>(sheet));
+    store(payload, state.crc);
+    store(payload, state.size);
+    store(payload, static_cast<Adesk::UInt32>(state.fragment.size()));
+    const Adesk::UInt8* pPath = reinterpret_cast<const Adesk::UInt8*>(state.fragment.data());
+    payload.insert(payload.end(), pPath, pPath + pathBytes);
+
+    std::vector<Adesk::UInt8> record;
+    record.reserve(kRecordOverhead + payload.size());
+    store(record, kRecordMagic);
+    store(record, static_cast<Adesk::UInt32>(payload.size()));
+    record.insert(record.end(), payload.begin(), payload.end());
+    store(record, crc32(payload.data(), payload.size()));
+
+    /* The record must be on disk before the sheet counts as done, or a crash
+    right after would lose a sheet the caller believes is safe. */
+    es = append(record.data(), record.size());
+    if (es == Acad::eOk)
+        m_sheets[sheet] = std::move(state);
+    return es;
+}
+
+Acad::ErrorStatus PublishJournal::assemble(const ACHAR* outputPath, PublishFragmentAssembler& assembler)
+{
+    if (!isOpen())
+        return Acad::eNotOpenForRead;
+    if (!isComplete())
+        return Acad::eNotApplicable;
+
+    Acad::ErrorStatus es = Acad::eOk;
+    std::vector<std::wstring> fragments;
+    fragments.reserve(m_sheets.size());
+    for (SheetState& sheet : m_sheets)
+    {
+        Adesk::UInt64 size = 0;
+        Adesk::UInt32 crc = 0;
+        const Acad::ErrorStatus check = checksumFile(sheet.fragment.c_str(), size, crc);
+        if (check != Acad::eOk || size != sheet.size || crc != sheet.crc)
+        {
+            sheet = SheetState();
+            es = Acad::eDwgCRCDoesNotMatch;
+            continue;
+        }
+        fragments.push_back(sheet.fragment);
+    }
+    if (es != Acad::eOk)
+        return es;
+    return assembler.assemble(fragments, outputPath);
+}
+
+const ACHAR* PublishJournal::fragmentPath(size_t sheet) const
+{
+    return isDone(sheet) ? m_sheets[sheet].fragment.c_str() : nullptr;
+}
+
+/* PublishCheckpointReactor ------------------------------------------------ */
+
+PublishCheckpointReactor::PublishCheckpointReactor(PublishJournal& journal)
+    : m_journal(journal)
+    , m_pending(journal.pendingSheets())
+    , m_nextPending(0)
+    , m_pageCancelled(false)
+    , m_status(Acad::eOk)
+{
+}
+
+void PublishCheckpointReactor::beginDocument(AcPlPlotInfo& /*plotInfo*/, const ACHAR* /*pDocname*/,
+                                             Adesk::Int32 /*nCopies*/, bool bPlotToFile, const ACHAR* pFilename)
+{
+    m_fileName = bPlotToFile && pFilename != nullptr ? pFilename : L"";
+    m_pageCancelled = false;
+}
+
+void PublishCheckpointReactor::endPage(AcPlPlotProgress::SheetCancelStatus status)
+{
+    if (status != AcPlPlotProgress::kSheetContinue)
+        m_pageCancelled = true;
+}
+
+void PublishCheckpointReactor::endDocument(AcPlPlotProgress::PlotCancelStatus status)
+{
+    /* Every document uses up a pending sheet, even a cancelled one, so that
+    the documents after it still line up with their sheets. */
+    if (m_nextPending >= m_pending.size())
+        return;
+    const size_t sheet = m_pending[m_nextPending++];
+    if (status != AcPlPlotProgress::kPlotContinue || m_pageCancelled || m_fileName.empty())
+        return;
+
+    const Acad::ErrorStatus es = m_journal.recordSheet(sheet, m_fileName.c_str());
+    if (es != Acad::eOk && m_status == Acad::eOk)
+        m_status = es;
+}
+
+/* Commands ---------------------------------------------------------------- */
+
+namespace {
+
+/* The lines of a UTF-8 text file that are not empty, without their line
+endings. */
+Acad::ErrorStatus readLines(const ACHAR* path, std::vector<AcString>& lines)
+{
+    MappedFile file;
+    const Acad::ErrorStatus es = file.open(path);
+    if (es != Acad::eOk)
+        return es;
+    const char* p = reinterpret_cast<const char*>(file.data());
+    const char* const end = p + static_cast<size_t>(file.size());
+    if (end - p >= 3 && std::memcmp(p, "\xEF\xBB\xBF", 3) == 0)
+        p += 3;
+    while (p < end)
+    {
+        const char* const lineEnd = std::find(p, end, '\n');
+        if (lineEnd - p > INT_MAX)
+            return Acad::eInvalidInput;
+        int length = static_cast<int>(lineEnd - p);
+        if (length > 0 && p[length - 1] == '\r')
+            --length;
+        if (length > 0)
+        {
+            const int wideLength = ::MultiByteToWideChar(CP_UTF8, 0, p, length, nullptr, 0);
+            if (wideLength <= 0)
+                return Acad::eInvalidInput;
+            std::wstring line(size_t(wideLength), L'\0');
+            ::MultiByteToWideChar(CP_UTF8, 0, p, length, &line[0], wideLength);
+            lines.push_back(AcString(line.c_str()));
+        }
+        p = lineEnd < end ? lineEnd + 1 : end;
+    }
+    return Acad::eOk;
+}
+
+} // namespace
+
+void publishJournalCommand(JournaledPublish& publish)
+{
+    AcString journalPath;
+    if (acedGetString(1, ACRX_T("\nPublish journal <close>: "), journalPath) != RTNORM)
+        return;
+    if (journalPath.isEmpty())
+    {
+        publish.pReactor.reset();
+        publish.journal.close();
+        publish.output.clear();
+        return;
+    }
+    AcString listPath, output;
+    if (acedGetString(1, ACRX_T("\nFile listing the sheets: "), listPath) != RTNORM ||
+        acedGetString(1, ACRX_T("\nOutput to assemble the sheets into: "), output) != RTNORM)
+        return;
+
+    /* The reactor lines documents up with the sheets pending when it is
+    made, so every journal opened gets a new one. */
+    publish.pReactor.reset();
+    publish.output.clear();
+    std::vector<AcString> sheets;
+    Acad::ErrorStatus es = readLines(listPath.kwszPtr(), sheets);
+    if (es == Acad::eOk)
+        es = publish.journal.open(journalPath.kwszPtr(), sheets, output.kwszPtr());
+    if (es != Acad::eOk)
+    {
+        publish.journal.close();
+        acutPrintf(ACRX_T("\nCould not open the publish journal %s: %s\n"), journalPath.kwszPtr(),
+                   acadErrorStatusText(es));
+        return;
+    }
+    publish.pReactor.reset(new PublishCheckpointReactor(publish.journal));
+    publish.output = output.kwszPtr();
+
+    const std::vector<size_t> pending = publish.journal.pendingSheets();
+    std::string text;
+    for (const size_t sheet : pending)
+        text += std::to_string(sheet) + "\r\n";
+    std::wstring pendingPath(journalPath.kwszPtr());
+    pendingPath += L".pending";
+    es = writeFileAtomically(pendingPath.c_str(), text.data(), text.size());
+    if (es != Acad::eOk)
+        acutPrintf(ACRX_T("\nCould not write %s: %s\n"), pendingPath.c_str(), acadErrorStatusText(es));
+    acutPrintf(ACRX_T("\n%llu of %llu sheets already published, %llu to publish.\n"),
+               static_cast<unsigned long long>(sheets.size() - pending.size()),
+               static_cast<unsigned long long>(sheets.size()), static_cast<unsigned long long>(pending.size()));
+}
+
+void assembleJournalCommand(JournaledPublish& publish)
+{
+    if (!publish.journal.isOpen())
+    {
+        acutPrintf(ACRX_T("\nNo publish journal is open.\n"));
+        return;
+    }
+    if (publish.pReactor != nullptr && publish.pReactor->status() != Acad::eOk)
+        acutPrintf(ACRX_T("\nCould not journal every sheet: %s\n"), acadErrorStatusText(publish.pReactor->status()));
+
+    PdfFragmentAssembler assembler;
+    const Acad::ErrorStatus es = publish.journal.assemble(publish.output.c_str(), assembler);
+    if (es == Acad::eNotApplicable)
+        acutPrintf(ACRX_T("\n%llu sheets are still to publish.\n"),
+                   static_cast<unsigned long long>(publish.journal.pendingSheets().size()));
+    else if (es != Acad::eOk)
+        acutPrintf(ACRX_T("\nCould not assemble %s: %s\n"), publish.output.c_str(), acadErrorStatusText(es));
+    else
+        acutPrintf(ACRX_T("\nAssembled %llu pages into %s.\n"), static_cast<unsigned long long>(assembler.pageCount()),
+                   publish.output.c_str());
+}
+
+} // namespace acad_sheetset_to_pdf
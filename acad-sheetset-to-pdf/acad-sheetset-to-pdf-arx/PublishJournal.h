@@ -0,0 +1,180 @@
+#pragma once
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// Joins the per-sheet output files of a publish job into the final output.
+/// </summary>
+class PublishFragmentAssembler
+{
+public:
+    virtual ~PublishFragmentAssembler() {}
+
+    /// <summary>
+    /// Writes outputPath from fragments, which are in sheet order.
+    /// </summary>
+    virtual Acad::ErrorStatus assemble(const std::vector<std::wstring>& fragments, const ACHAR* outputPath) = 0;
+};
+
+/// <summary>
+/// Assembles by concatenating the fragments byte for byte, for output
+/// formats whose files can simply be appended to one another, such as the
+/// plot files of a printer driver.
+///
+/// That does not include PDF, DWF or DWFx: each of those files ends in an
+/// index of the whole document, and the bytes of two of them joined are not
+/// a valid document.  PDF fragments are merged by PdfFragmentAssembler.
+/// assemble() recognizes them by their first bytes and returns
+/// Acad::eUnsupportedFileFormat, leaving the output as it was.
+/// </summary>
+class ConcatenatingFragmentAssembler : public PublishFragmentAssembler
+{
+public:
+    Acad::ErrorStatus assemble(const std::vector<std::wstring>& fragments, const ACHAR* outputPath) override;
+};
+
+/// <summary>
+/// A durable record of which sheets of a publish job are done, so that a job
+/// that dies at sheet 350 of 400 is rerun from sheet 350 instead of sheet 1.
+///
+/// The sheets are published one per output file (a fragment).  Whenever a
+/// fragment is complete, its path, size and CRC-32 are appended to the
+/// journal and flushed to disk before anything else happens, so that after a
+/// crash the journal lists exactly the fragments that were finished.  Every
+/// record carries its own CRC; a record torn by the crash is discarded, and
+/// so is a journal written for a different list of sheets or target.
+///
+/// Once every sheet has a fragment, assemble() checks each fragment against
+/// its recorded size and CRC and hands them, in sheet order, to a
+/// PublishFragmentAssembler.
+/// </summary>
+class PublishJournal
+{
+public:
+    PublishJournal();
+    ~PublishJournal();
+
+    PublishJournal(const PublishJournal&) = delete;
+    PublishJournal& operator=(const PublishJournal&) = delete;
+
+    /// <summary>
+    /// Opens the journal at path for a job publishing sheets (any strings
+    /// that identify them, in publishing order) to target.  An existing
+    /// journal for the same sheets and target is resumed, after dropping the
+    /// sheets whose fragment is missing or has changed size; anything else at
+    /// path is replaced by an empty journal.
+    /// </summary>
+    Acad::ErrorStatus open(const ACHAR* path, const std::vector<AcString>& sheets, const ACHAR* target);
+    void close();
+
+    bool isOpen() const { return m_hFile != INVALID_HANDLE_VALUE; }
+    size_t sheetCount() const { return m_sheets.size(); }
+    bool isDone(size_t sheet) const { return sheet < m_sheets.size() && m_sheets[sheet].done; }
+    bool isComplete() const;
+
+    /// <summary>
+    /// Sheets done when the journal was opened.
+    /// </summary>
+    size_t resumedCount() const { return m_resumedCount; }
+
+    /// <summary>
+    /// The sheets still to publish, in order.
+    /// </summary>
+    std::vector<size_t> pendingSheets() const;
+
+    /// <summary>
+    /// Checksums the finished fragment of sheet and journals it.  Returns
+    /// once the record is on disk.
+    /// </summary>
+    Acad::ErrorStatus recordSheet(size_t sheet, const ACHAR* fragmentPath);
+
+    /// <summary>
+    /// Verifies every fragment and assembles them into outputPath.  Returns
+    /// Acad::eNotApplicable while sheets are pending, and
+    /// Acad::eDwgCRCDoesNotMatch if a fragment changed since it was
+    /// journaled, in which case that sheet is pending again.
+    /// </summary>
+    Acad::ErrorStatus assemble(const ACHAR* outputPath, PublishFragmentAssembler& assembler);
+
+    /// <summary>
+    /// Fragment of a sheet that is done.
+    /// </summary>
+    const ACHAR* fragmentPath(size_t sheet) const;
+
+private:
+    struct SheetState
+    {
+        bool          done = false;
+        std::wstring  fragment;
+        Adesk::UInt64 size = 0;
+        Adesk::UInt32 crc = 0;
+    };
+
+    Acad::ErrorStatus replay(const Adesk::UInt8* pData, size_t size, size_t& validSize);
+    Acad::ErrorStatus startNew(const ACHAR* path);
+    Acad::ErrorStatus append(const void* pData, size_t size);
+
+    HANDLE                  m_hFile;
+    std::vector<SheetState> m_sheets;
+    Adesk::UInt64           m_fingerprint;
+    size_t                  m_resumedCount;
+};
+
+/// <summary>
+/// Journals every sheet of a publish job as the plot engine finishes it.
+/// The job must publish the journal's pending sheets, in order, one sheet
+/// per document, to files: the n-th document is the fragment of the n-th
+/// pending sheet.  A document that ends cancelled leaves its sheet pending.
+/// </summary>
+class PublishCheckpointReactor : public AcPlPlotReactor
+{
+public:
+    explicit PublishCheckpointReactor(PublishJournal& journal);
+
+    void beginDocument(AcPlPlotInfo& plotInfo, const ACHAR* pDocname, Adesk::Int32 nCopies, bool bPlotToFile,
+                       const ACHAR* pFilename) override;
+    void endPage(AcPlPlotProgress::SheetCancelStatus status) override;
+    void endDocument(AcPlPlotProgress::PlotCancelStatus status) override;
+
+    /// <summary>
+    /// First error met while journaling, since a reactor cannot return one.
+    /// </summary>
+    Acad::ErrorStatus status() const { return m_status; }
+
+private:
+    PublishJournal&     m_journal;
+    std::vector<size_t> m_pending;
+    size_t              m_nextPending;
+    std::wstring        m_fileName;
+    bool                m_pageCancelled;
+    Acad::ErrorStatus   m_status;
+};
+
+/// <summary>
+/// The publish job journaled through SHEETSETTOPDFJOURNAL: its journal, the
+/// reactor that journals its sheets, and the output they are assembled into.
+/// </summary>
+struct JournaledPublish
+{
+    PublishJournal                            journal;
+    std::unique_ptr<PublishCheckpointReactor> pReactor;
+    std::wstring                              output;
+};
+
+/// <summary>
+/// The SHEETSETTOPDFJOURNAL command: asks for the journal, a UTF-8 file
+/// listing the job's sheets one per line and the output to assemble them
+/// into, opens the journal with a new reactor, and writes the indices of the
+/// sheets still to publish, one per line, to the journal's path with
+/// ".pending" appended.  An empty journal closes it.  The caller registers
+/// and removes publish.pReactor.
+/// </summary>
+void publishJournalCommand(JournaledPublish& publish);
+
+/// <summary>
+/// The SHEETSETTOPDFASSEMBLE command: merges the journaled PDF fragments
+/// into the output once every sheet is done, and reports how it went.
+/// </summary>
+void assembleJournalCommand(JournaledPublish& publish);
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,424 @@
+#include "stdafx.h"
+#include "PublishMetadataReactor.h"
+#include "Checksum.h"
+#include "ParallelFor.h"
+
+#include <cwctype>
+#include <new>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+Adesk::UInt64 elapsedSince(std::chrono::steady_clock::time_point start)
+{
+    return static_cast<Adesk::UInt64>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+void statFile(const ACHAR* path, Adesk::UInt64& time, Adesk::UInt64& size)
+{
+    time = 0;
+    size = 0;
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!::GetFileAttributesExW(path, GetFileExInfoStandard, &attributes))
+        return;
+    time = (Adesk::UInt64(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+    size = (Adesk::UInt64(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+}
+
+/* Hashes text with its length, so that the fields of a key cannot run into
+one another. */
+Adesk::UInt64 hashText(Adesk::UInt64 hash, const ACHAR* pText)
+{
+    const Adesk::UInt64 length = pText != nullptr ? std::wcslen(pText) : 0;
+    hash = fnv1a64(&length, sizeof(length), hash);
+    return length != 0 ? fnv1a64(pText, size_t(length) * sizeof(ACHAR), hash) : hash;
+}
+
+/* What a queued job and the job that starts later have in common: the
+sheets, in order, and the sheet set they come from.  The DSD AutoCAD passes
+to OnAboutToBeginPublishing is a copy of the one the job was queued with, so
+its address tells nothing. */
+Adesk::UInt64 jobKey(const AcPlDSDData& dsd, const AcPlDSDEntries& entries)
+{
+    Adesk::UInt64 hash = hashText(fnv1a64(nullptr, 0), dsd.sheetSetName());
+    std::wstring sheetSet;
+    SheetSetMetadataSource::sheetSetPath(dsd, sheetSet);
+    hash = hashText(hash, sheetSet.c_str());
+    for (int i = 0; i < entries.length(); ++i)
+    {
+        hash = hashText(hash, entries[i].dwgName());
+        hash = hashText(hash, entries[i].layout());
+        hash = hashText(hash, entries[i].title());
+    }
+    return hash;
+}
+
+} // namespace
+
+/* SheetSetMetadataSource -------------------------------------------------- */
+
+SheetSetMetadataSource::SheetSetMetadataSource(const ACHAR* path)
+    : m_fixedPath(path != nullptr ? path : L"")
+    , m_fileTime(0)
+    , m_fileSize(0)
+    , m_loaded(false)
+    , m_active(false)
+{
+}
+
+bool SheetSetMetadataSource::sheetSetPath(const AcPlDSDData& dsd, std::wstring& path)
+{
+    path.clear();
+    AcStringArray sections, data;
+    dsd.getUnrecognizedData(sections, data);
+    for (int i = 0; i < sections.length() && i < data.length(); ++i)
+    {
+        if (_wcsicmp(sections[i].kwszPtr(), L"SheetSet Properties") != 0)
+            continue;
+
+        /* The section is kept as its lines of name=value. */
+        const std::wstring text(data[i].kwszPtr());
+        size_t start = 0;
+        while (start < text.size())
+        {
+            size_t stop = text.find_first_of(L"\r\n", start);
+            if (stop == std::wstring::npos)
+                stop = text.size();
+            const size_t equals = text.find(L'=', start);
+            if (equals < stop && _wcsicmp(text.substr(start, equals - start).c_str(), L"DSTPath") == 0)
+            {
+                path = text.substr(equals + 1, stop - equals - 1);
+                return !path.empty();
+            }
+            start = stop + 1;
+        }
+    }
+    return false;
+}
+
+Acad::ErrorStatus SheetSetMetadataSource::prepare(const AcPlDSDData& dsd, AcNameValuePairVec& properties)
+{
+    m_active = false;
+    std::wstring path(m_fixedPath);
+    if (path.empty() && !sheetSetPath(dsd, path))
+        return Acad::eOk;
+
+    Adesk::UInt64 time = 0, size = 0;
+    statFile(path.c_str(), time, size);
+    if (!m_loaded || _wcsicmp(path.c_str(), m_file.path().c_str()) != 0 || time != m_fileTime || size != m_fileSize)
+    {
+        m_loaded = false;
+        const Acad::ErrorStatus es = m_file.load(path.c_str());
+        if (es != Acad::eOk)
+            return es;
+        m_loaded = true;
+        m_fileTime = time;
+        m_fileSize = size;
+    }
+    m_active = true;
+
+    for (const SheetSetProperty& property : m_file.properties())
+    {
+        if ((property.flags & SheetSetProperty::kSheetSetProperty) != 0)
+            properties.append(AcNameValuePair(property.name.c_str(), property.value.c_str()));
+    }
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus SheetSetMetadataSource::collect(const AcPlDSDEntry& entry, AcNameValuePairVec& properties) const
+{
+    const SheetSetSheet* pSheet = m_active ? m_file.findSheet(entry.dwgName(), entry.layout()) : nullptr;
+    if (pSheet == nullptr)
+        return Acad::eKeyNotFound;
+    for (const SheetSetProperty& property : pSheet->properties)
+        properties.append(AcNameValuePair(property.name.c_str(), property.value.c_str()));
+    return Acad::eOk;
+}
+
+/* PublishMetadataReactor -------------------------------------------------- */
+
+struct PublishMetadataReactor::Job
+{
+    Adesk::UInt64                   key = 0;
+    AcPlDSDData                     dsd;
+    AcPlDSDEntries                  entries;
+    AcNameValuePairVec              properties;
+    std::vector<AcNameValuePairVec> sheets;
+    PublishMetadataStats            stats;
+    bool                            started = false;    // guarded by m_mutex
+    bool                            collected = false;  // guarded by m_mutex
+    std::atomic<bool>               cancelled{false};
+};
+
+const ACHAR* const PublishMetadataReactor::kJobSection = ACRX_T("SheetSetToPdf Metadata");
+
+AcString PublishMetadataReactor::sheetSection(int index)
+{
+    AcString section;
+    section.format(ACRX_T("%s:%d"), kJobSection, index);
+    return section;
+}
+
+PublishMetadataReactor::PublishMetadataReactor(PublishMetadataSource& source, const PublishMetadataSettings& settings)
+    : m_source(source)
+    , m_settings(settings)
+    , m_stopping(false)
+    , m_awaitingFirstSheet(false)
+{
+    m_collector = std::thread([this] { collectorLoop(); });
+}
+
+PublishMetadataReactor::~PublishMetadataReactor()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        for (const std::shared_ptr<Job>& pJob : m_jobs)
+            pJob->cancelled = true;
+        m_jobs.clear();
+        if (m_pStartingJob != nullptr)
+            m_pStartingJob->cancelled = true;
+        m_pStartingJob.reset();
+    }
+    m_queueChanged.notify_all();
+    m_jobCollected.notify_all();
+    m_collector.join();
+}
+
+void PublishMetadataReactor::collectorLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        std::shared_ptr<Job> pJob;
+        m_queueChanged.wait(lock, [&]
+        {
+            if (m_stopping)
+                return true;
+            if (m_pStartingJob != nullptr)
+            {
+                pJob.swap(m_pStartingJob);
+                return true;
+            }
+            for (const std::shared_ptr<Job>& pQueued : m_jobs)
+            {
+                if (!pQueued->started)
+                {
+                    pJob = pQueued;
+                    return true;
+                }
+            }
+            return false;
+        });
+        if (m_stopping)
+            return;
+
+        pJob->started = true;
+        lock.unlock();
+        collect(*pJob);
+        lock.lock();
+        pJob->collected = true;
+        m_jobCollected.notify_all();
+    }
+}
+
+void PublishMetadataReactor::collect(Job& job)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    PublishMetadataStats& stats = job.stats;
+    const size_t count = size_t(job.entries.length());
+    stats.sheetCount = count;
+    if (job.cancelled)
+        return;
+
+    stats.status = m_source.prepare(job.dsd, job.properties);
+    stats.propertyCount = size_t(job.properties.length());
+    std::atomic<Adesk::UInt64> workNanoseconds(elapsedSince(start));
+
+    if (stats.status == Acad::eOk)
+    {
+        job.sheets.resize(count);
+        std::vector<Acad::ErrorStatus> statuses(count, Acad::eOk);
+        try
+        {
+            parallelFor(count, m_settings.threadCount,
+                        [&](size_t index, unsigned)
+                        {
+                            const std::chrono::steady_clock::time_point sheetStart = std::chrono::steady_clock::now();
+                            statuses[index] = m_source.collect(job.entries[int(index)], job.sheets[index]);
+                            workNanoseconds += elapsedSince(sheetStart);
+                        },
+                        [&](size_t) { return !job.cancelled; });
+        }
+        catch (const std::bad_alloc&)
+        {
+            stats.status = Acad::eOutOfMemory;
+        }
+        catch (...)
+        {
+            stats.status = Acad::eNotHandled;
+        }
+
+        /* A sheet the source knows nothing about is not an error. */
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (stats.status == Acad::eOk && statuses[i] != Acad::eOk && statuses[i] != Acad::eKeyNotFound)
+                stats.status = statuses[i];
+            if (!job.sheets[i].isEmpty())
+            {
+                ++stats.enrichedSheetCount;
+                stats.propertyCount += size_t(job.sheets[i].length());
+            }
+        }
+    }
+
+    stats.workNanoseconds = workNanoseconds;
+    stats.collectNanoseconds = elapsedSince(start);
+}
+
+void PublishMetadataReactor::inject(Job& job, AcPublishBeginJobInfo& info)
+{
+    if (!job.properties.isEmpty())
+        info.WritePrivateSection(kJobSection, job.properties);
+    for (size_t i = 0; i < job.sheets.size(); ++i)
+    {
+        if (!job.sheets[i].isEmpty())
+            info.WritePrivateSection(sheetSection(int(i)).kwszPtr(), job.sheets[i]);
+    }
+}
+
+void PublishMetadataReactor::OnAboutToBeginBackgroundPublishing(AcPublishBeforeJobInfo* pInfo)
+{
+    if (pInfo == nullptr || !pInfo->JobWillPublishInBackground() || pInfo->GetDSDData() == nullptr)
+        return;
+
+    /* The DSD is only ours for the duration of the call. */
+    std::shared_ptr<Job> pJob(new Job());
+    pJob->dsd = *pInfo->GetDSDData();
+    pJob->dsd.getDSDEntries(pJob->entries);
+    pJob->key = jobKey(pJob->dsd, pJob->entries);
+    pJob->stats.background = true;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(pJob);
+        while (m_jobs.size() > std::max<size_t>(m_settings.maxQueuedJobs, 1))
+        {
+            m_jobs.front()->cancelled = true;
+            m_jobs.pop_front();
+        }
+    }
+    m_queueChanged.notify_one();
+}
+
+void PublishMetadataReactor::OnAboutToBeginPublishing(AcPublishBeginJobInfo* pInfo)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_awaitingFirstSheet = false;
+    }
+    if (pInfo == nullptr || pInfo->GetDSDData() == nullptr)
+        return;
+
+    std::shared_ptr<Job> pJob(new Job());
+    pJob->dsd = *pInfo->GetDSDData();
+    pJob->dsd.getDSDEntries(pJob->entries);
+    pJob->key = jobKey(pJob->dsd, pJob->entries);
+
+    /* Take the job off the queue.  If the collector has not got to it yet,
+    hand it over again ahead of the jobs queued before it, so that the source
+    is still only ever called on the collector's threads. */
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        bool started = false;
+        for (auto it = m_jobs.begin(); it != m_jobs.end(); ++it)
+        {
+            if ((*it)->key != pJob->key)
+                continue;
+            if ((*it)->started)
+            {
+                pJob = *it;
+                started = true;
+            }
+            else
+            {
+                (*it)->cancelled = true;
+            }
+            m_jobs.erase(it);
+            break;
+        }
+        if (!started)
+        {
+            m_pStartingJob = pJob;
+            m_queueChanged.notify_one();
+        }
+        m_jobCollected.wait(lock, [&] { return pJob->collected || m_stopping; });
+        if (!pJob->collected)
+            return;
+    }
+
+    inject(*pJob, *pInfo);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats = pJob->stats;
+    m_stats.waitNanoseconds = elapsedSince(start);
+    m_jobStart = start;
+    m_awaitingFirstSheet = true;
+}
+
+void PublishMetadataReactor::OnBeginPublishingSheet(AcPublishSheetInfo* pInfo)
+{
+    PublishMetadataStats stats;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_awaitingFirstSheet)
+            return;
+        m_awaitingFirstSheet = false;
+        m_stats.firstSheetNanoseconds = elapsedSince(m_jobStart);
+        stats = m_stats;
+    }
+
+    AcPlPlotLogger* pLogger = pInfo != nullptr ? pInfo->GetPlotLogger() : nullptr;
+    if (pLogger != nullptr)
+    {
+        AcString message;
+        message.format(ACRX_T("Sheet metadata: %u of %u sheets, %u properties, %.1f ms of work, %.1f ms waited, ")
+                       ACRX_T("first sheet after %.1f ms"),
+                       unsigned(stats.enrichedSheetCount), unsigned(stats.sheetCount), unsigned(stats.propertyCount),
+                       stats.workNanoseconds / 1e6, stats.waitNanoseconds / 1e6, stats.firstSheetNanoseconds / 1e6);
+        pLogger->logInformation(message.kwszPtr());
+        if (stats.status != Acad::eOk)
+        {
+            message.format(ACRX_T("Sheet metadata is incomplete: %s"), acadErrorStatusText(stats.status));
+            pLogger->logWarning(message.kwszPtr());
+        }
+    }
+}
+
+void PublishMetadataReactor::OnEndPublish(AcPublishReactorInfo*)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_awaitingFirstSheet = false;
+}
+
+void PublishMetadataReactor::OnCancelledOrFailedPublishing(AcPublishReactorInfo*)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_awaitingFirstSheet = false;
+}
+
+PublishMetadataStats PublishMetadataReactor::lastJobStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+size_t PublishMetadataReactor::queuedJobCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_jobs.size();
+}
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,196 @@
+#pragma once
+
+#include "SheetSetFile.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// Computes the metadata PublishMetadataReactor injects into a publish job.
+///
+/// prepare() is called once per job and collect() then once per sheet of
+/// it, from several worker threads at the same time.  The calls for one job
+/// are over before those for the next begin, so state set up by prepare()
+/// may be read by collect() without locking.  Neither runs on AutoCAD's main
+/// thread, so neither may touch a drawing database or the editor.
+/// </summary>
+class PublishMetadataSource
+{
+public:
+    virtual ~PublishMetadataSource() {}
+
+    /// <summary>
+    /// Sets up for the job described by dsd and returns the metadata of the
+    /// job as a whole in properties.
+    /// </summary>
+    virtual Acad::ErrorStatus prepare(const AcPlDSDData& dsd, AcNameValuePairVec& properties) = 0;
+
+    /// <summary>
+    /// Returns the metadata of the sheet entry in properties.
+    /// </summary>
+    virtual Acad::ErrorStatus collect(const AcPlDSDEntry& entry, AcNameValuePairVec& properties) const = 0;
+};
+
+/// <summary>
+/// The custom properties of a sheet set: the sheet set's own as the job's
+/// metadata and each sheet's as the sheet's.
+///
+/// The sheet set is the DST file the DSD names in its "SheetSet Properties"
+/// section, or the one given to the constructor.  It is read with
+/// SheetSetFile and kept until a job names another file or the file
+/// changes on disk, so republishing a set does not read it again.
+/// </summary>
+class SheetSetMetadataSource : public PublishMetadataSource
+{
+public:
+    /// <summary>
+    /// path, if not null, is read instead of the DST file the DSD names.
+    /// </summary>
+    explicit SheetSetMetadataSource(const ACHAR* path = nullptr);
+
+    Acad::ErrorStatus prepare(const AcPlDSDData& dsd, AcNameValuePairVec& properties) override;
+    Acad::ErrorStatus collect(const AcPlDSDEntry& entry, AcNameValuePairVec& properties) const override;
+
+    /// <summary>
+    /// Finds the DSTPath entry of the "SheetSet Properties" section of dsd.
+    /// Returns false if the DSD does not come from a sheet set.
+    /// </summary>
+    static bool sheetSetPath(const AcPlDSDData& dsd, std::wstring& path);
+
+private:
+    std::wstring  m_fixedPath;
+    SheetSetFile  m_file;
+    Adesk::UInt64 m_fileTime;
+    Adesk::UInt64 m_fileSize;
+    bool          m_loaded;
+    bool          m_active;     // the current job's DSD names a sheet set
+};
+
+struct PublishMetadataSettings
+{
+    /// <summary>
+    /// Threads collect() is called on, 0 for one per processor.
+    /// </summary>
+    unsigned threadCount = 0;
+
+    /// <summary>
+    /// Background jobs whose metadata is kept until they start.  When one
+    /// more is queued, the oldest is forgotten; it is collected again, ahead
+    /// of the queued jobs, should it start after all.
+    /// </summary>
+    size_t maxQueuedJobs = 8;
+};
+
+/// <summary>
+/// How the metadata of a job was collected.  Times are nanoseconds.
+/// </summary>
+struct PublishMetadataStats
+{
+    Acad::ErrorStatus status = Acad::eOk;   // from prepare(), or the first collect() that failed
+    bool          background = false;       // collected while the job was queued
+    size_t        sheetCount = 0;
+    size_t        enrichedSheetCount = 0;   // sheets that got a section
+    size_t        propertyCount = 0;
+    Adesk::UInt64 collectNanoseconds = 0;   // from the first call into the source to the last return
+    Adesk::UInt64 workNanoseconds = 0;      // spent inside the source, summed over all threads
+    Adesk::UInt64 waitNanoseconds = 0;      // OnAboutToBeginPublishing spent waiting for the metadata
+    Adesk::UInt64 firstSheetNanoseconds = 0;    // from OnAboutToBeginPublishing to the first sheet
+
+    /// <summary>
+    /// How much sooner the first sheet began than if the metadata had been
+    /// collected on the publishing thread, one sheet after another, before
+    /// the job started: the work done minus the wait for it.
+    /// </summary>
+    Adesk::UInt64 savedNanoseconds() const
+    {
+        return workNanoseconds > waitNanoseconds ? workNanoseconds - waitNanoseconds : 0;
+    }
+};
+
+/// <summary>
+/// A publish reactor that collects the metadata of each publish job while
+/// the job waits in the background publishing queue and hands it to the
+/// job in private sections of its DSD.
+///
+/// The metadata used to be collected by the driver, sheet by sheet, before
+/// it started the job, so the first sheet waited for all of it.  Here,
+/// OnAboutToBeginBackgroundPublishing copies the DSD and queues the job on
+/// a collector thread, which calls the source for all sheets at once on
+/// settings.threadCount threads.  When the job starts, OnAboutToBeginPublishing
+/// waits for whatever is still being collected (usually nothing) and writes
+/// the job's metadata to the section kJobSection and each sheet's to
+/// sheetSection(index), index being the sheet's position among the DSD's
+/// entries.  Other reactors read them back with GetPrivateData.  Jobs
+/// published in the foreground, which are never queued, and jobs that start
+/// before the collector got to them are handed to it when they start, ahead
+/// of the queued jobs, and OnAboutToBeginPublishing waits for them.
+///
+/// Queued jobs are matched to starting ones by their DSD's sheets and sheet
+/// set, so one reactor serves any number of jobs, queued in any order.
+/// Register it with AcGlobAddPublishReactor and remove it with
+/// AcGlobRemovePublishReactor before destroying it.
+/// </summary>
+class PublishMetadataReactor : public AcPublishReactor
+{
+public:
+    static const ACHAR* const kJobSection;
+
+    /// <summary>
+    /// Name of the section with the metadata of the sheet at index.
+    /// </summary>
+    static AcString sheetSection(int index);
+
+    explicit PublishMetadataReactor(PublishMetadataSource& source,
+                                    const PublishMetadataSettings& settings = PublishMetadataSettings());
+
+    /// <summary>
+    /// Forgets the queued jobs and waits for the collector thread to stop.
+    /// </summary>
+    ~PublishMetadataReactor();
+
+    PublishMetadataReactor(const PublishMetadataReactor&) = delete;
+    PublishMetadataReactor& operator=(const PublishMetadataReactor&) = delete;
+
+    void OnAboutToBeginBackgroundPublishing(AcPublishBeforeJobInfo* pInfo) override;
+    void OnAboutToBeginPublishing(AcPublishBeginJobInfo* pInfo) override;
+    void OnBeginPublishingSheet(AcPublishSheetInfo* pInfo) override;
+    void OnEndPublish(AcPublishReactorInfo* pInfo) override;
+    void OnCancelledOrFailedPublishing(AcPublishReactorInfo* pInfo) override;
+
+    /// <summary>
+    /// Statistics of the job that started last, complete once its first
+    /// sheet has begun.
+    /// </summary>
+    PublishMetadataStats lastJobStats() const;
+
+    size_t queuedJobCount() const;
+
+private:
+    struct Job;
+
+    void collectorLoop();
+    void collect(Job& job);
+    void inject(Job& job, AcPublishBeginJobInfo& info);
+
+    PublishMetadataSource&              m_source;
+    PublishMetadataSettings             m_settings;
+    mutable std::mutex                  m_mutex;
+    std::condition_variable             m_queueChanged;     // a job was queued, or the reactor is stopping
+    std::condition_variable             m_jobCollected;
+    std::deque<std::shared_ptr<Job>>    m_jobs;             // queued jobs, oldest first
+    std::shared_ptr<Job>                m_pStartingJob;     // started before it was collected; goes first
+    bool                                m_stopping;
+    std::thread                         m_collector;
+
+    /* The job being published.  Only touched from the publishing thread. */
+    PublishMetadataStats                m_stats;
+    std::chrono::steady_clock::time_point m_jobStart;
+    bool                                m_awaitingFirstSheet;
+};
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,731 @@
+#include "stdafx.h"
+#include "ReadWriteStreams.h"
+#include "AtomicFile.h"
+#include "Checksum.h"
+#include "Lz4Block.h"
+
+#include <cstring>
+#include <new>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+/* LZ4 frames, as the lz4 tool writes them:
+
+    UInt32      magic
+    UInt8       FLG: version 01, block independence, block checksum,
+                content size, content checksum, reserved, dictionary id
+    UInt8       BD: block maximum size code in bits 4 to 6
+    UInt64      content size, if flagged
+    UInt32      dictionary id, if flagged
+    UInt8       second byte of the xxHash of FLG up to here
+    blocks      UInt32 size, high bit set if stored as is; data; UInt32
+                xxHash of the data, if flagged
+    UInt32      0, ending the blocks
+    UInt32      xxHash of the content, if flagged
+
+all little-endian.  Skippable frames are a magic of 0x184D2A50 to
+0x184D2A5F and a UInt32 size, followed by that many bytes. */
+const Adesk::UInt32 kFrameMagic = 0x184D2204;
+const Adesk::UInt32 kSkippableMagic = 0x184D2A50;
+const Adesk::UInt32 kStoredBlock = 0x80000000;
+const Adesk::UInt8 kVersion = 0x40;
+const Adesk::UInt8 kBlockIndependence = 0x20;
+const Adesk::UInt8 kBlockChecksum = 0x10;
+const Adesk::UInt8 kContentSize = 0x08;
+const Adesk::UInt8 kContentChecksum = 0x04;
+const Adesk::UInt8 kDictionaryId = 0x01;
+const size_t kHistorySize = 64 * 1024;
+
+size_t blockCapacity(int code)
+{
+    return size_t(1) << (8 + 2 * code);
+}
+
+void put32(Adesk::UInt8* p, Adesk::UInt32 value)
+{
+    p[0] = static_cast<Adesk::UInt8>(value);
+    p[1] = static_cast<Adesk::UInt8>(value >> 8);
+    p[2] = static_cast<Adesk::UInt8>(value >> 16);
+    p[3] = static_cast<Adesk::UInt8>(value >> 24);
+}
+
+Adesk::UInt32 get32(const Adesk::UInt8* p)
+{
+    return Adesk::UInt32(p[0]) | (Adesk::UInt32(p[1]) << 8) | (Adesk::UInt32(p[2]) << 16) |
+           (Adesk::UInt32(p[3]) << 24);
+}
+
+/* Where a seek lands, or -1 if it is not between 0 and size. */
+Adesk::Int64 seekTarget(Adesk::Int64 distance, int mode, size_t position, size_t size)
+{
+    const Adesk::Int64 origin = mode == IAcReadStream::eFromStart ? 0
+                              : mode == IAcReadStream::eFromCurrent ? static_cast<Adesk::Int64>(position)
+                              : mode == IAcReadStream::eFromEnd ? static_cast<Adesk::Int64>(size) : -1;
+    if (origin < 0)
+        return -1;
+    const Adesk::Int64 target = origin + distance;
+    return target < 0 || target > static_cast<Adesk::Int64>(size) ? -1 : target;
+}
+
+} // namespace
+
+/* MemoryReadStream -------------------------------------------------------- */
+
+MemoryReadStream::MemoryReadStream()
+    : m_pData(nullptr),
+      m_size(0),
+      m_position(0)
+{
+}
+
+MemoryReadStream::MemoryReadStream(const void* pData, size_t size)
+    : m_pData(static_cast<const Adesk::UInt8*>(pData)),
+      m_size(pData != nullptr ? size : 0),
+      m_position(0)
+{
+}
+
+MemoryReadStream::~MemoryReadStream()
+{
+}
+
+void MemoryReadStream::reset(const void* pData, size_t size)
+{
+    m_pData = static_cast<const Adesk::UInt8*>(pData);
+    m_size = pData != nullptr ? size : 0;
+    m_position = 0;
+}
+
+int MemoryReadStream::read(void* pDestBuf, size_t nNumBytes, size_t* pNumRead)
+{
+    if (pNumRead != nullptr)
+        *pNumRead = 0;
+    if (pDestBuf == nullptr && nNumBytes != 0)
+        return eInvalidArg;
+    const size_t count = std::min(nNumBytes, m_size - m_position);
+    if (count != 0)
+    {
+        std::memcpy(pDestBuf, m_pData + m_position, count);
+        m_position += count;
+        moved();
+    }
+    if (pNumRead != nullptr)
+        *pNumRead = count;
+    return count < nNumBytes ? eEndOfFile : eOk;
+}
+
+int MemoryReadStream::seek(Adesk::Int64 nDistance, int nMode)
+{
+    const Adesk::Int64 target = seekTarget(nDistance, nMode, m_position, m_size);
+    if (target < 0)
+        return eInvalidArg;
+    m_position = static_cast<size_t>(target);
+    moved();
+    return eOk;
+}
+
+int MemoryReadStream::close()
+{
+    reset(nullptr, 0);
+    return eOk;
+}
+
+const Adesk::UInt8* MemoryReadStream::take(size_t size)
+{
+    if (size > m_size - m_position)
+        return nullptr;
+    const Adesk::UInt8* p = m_pData + m_position;
+    m_position += size;
+    moved();
+    return p;
+}
+
+/* MappedReadStream -------------------------------------------------------- */
+
+MappedReadStream::MappedReadStream(size_t readAhead)
+    : m_readAhead(readAhead),
+      m_prefetchedTo(0)
+{
+}
+
+MappedReadStream::~MappedReadStream()
+{
+}
+
+Acad::ErrorStatus MappedReadStream::open(const ACHAR* path)
+{
+    close();
+    const Acad::ErrorStatus es = m_file.open(path);
+    if (es != Acad::eOk)
+        return es;
+    reset(m_file.data(), static_cast<size_t>(m_file.size()));
+    moved();
+    return Acad::eOk;
+}
+
+int MappedReadStream::close()
+{
+    MemoryReadStream::close();
+    m_file.close();
+    m_prefetchedTo = 0;
+    return eOk;
+}
+
+void MappedReadStream::moved()
+{
+    if (m_readAhead == 0 || m_pData == nullptr)
+        return;
+
+    /* A seek back before the window starts it again from there; reading on
+    past the middle of it asks for the next one. */
+    if (m_position + m_readAhead < m_prefetchedTo)
+        m_prefetchedTo = m_position;
+    if (m_prefetchedTo >= m_size || m_position + m_readAhead / 2 < m_prefetchedTo)
+        return;
+    const size_t from = std::max(m_prefetchedTo, m_position);
+    const size_t length = std::min(m_readAhead, m_size - from);
+    m_file.prefetch(from, length);
+    m_prefetchedTo = from + length;
+}
+
+/* ArenaStream ------------------------------------------------------------- */
+
+ArenaStream::ArenaStream(size_t capacity)
+    : m_position(0)
+{
+    m_bytes.reserve(capacity);
+}
+
+ArenaStream::~ArenaStream()
+{
+}
+
+int ArenaStream::read(void* pDestBuf, size_t nNumBytes, size_t* pNumRead)
+{
+    if (pNumRead != nullptr)
+        *pNumRead = 0;
+    if (pDestBuf == nullptr && nNumBytes != 0)
+        return eInvalidArg;
+    const size_t count = std::min(nNumBytes, m_bytes.size() - m_position);
+    if (count != 0)
+        std::memcpy(pDestBuf, m_bytes.data() + m_position, count);
+    m_position += count;
+    if (pNumRead != nullptr)
+        *pNumRead = count;
+    return count < nNumBytes ? eEndOfFile : eOk;
+}
+
+int ArenaStream::write(const void* pSrcBuf, size_t nNumBytes, size_t* pNumWritten)
+{
+    if (pNumWritten != nullptr)
+        *pNumWritten = 0;
+    if (pSrcBuf == nullptr && nNumBytes != 0)
+        return eInvalidArg;
+
+    /* What lands on existing bytes overwrites them; the rest is appended. */
+    const Adesk::UInt8* pBytes = static_cast<const Adesk::UInt8*>(pSrcBuf);
+    const size_t overwritten = std::min(nNumBytes, m_bytes.size() - m_position);
+    try
+    {
+        m_bytes.insert(m_bytes.end(), pBytes + overwritten, pBytes + nNumBytes);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return eDiskFull;
+    }
+    if (overwritten != 0)
+        std::memcpy(m_bytes.data() + m_position, pBytes, overwritten);
+    m_position += nNumBytes;
+    if (pNumWritten != nullptr)
+        *pNumWritten = nNumBytes;
+    return eOk;
+}
+
+int ArenaStream::seek(Adesk::Int64 nDistance, int nMode)
+{
+    const Adesk::Int64 target = seekTarget(nDistance, nMode, m_position, m_bytes.size());
+    if (target < 0)
+        return eInvalidArg;
+    m_position = static_cast<size_t>(target);
+    return eOk;
+}
+
+int ArenaStream::setEndOfFile()
+{
+    truncate(m_position);
+    return eOk;
+}
+
+void ArenaStream::truncate(size_t size)
+{
+    if (size < m_bytes.size())
+        m_bytes.resize(size);
+    m_position = std::min(m_position, m_bytes.size());
+}
+
+/* BufferedFileWriteStream ------------------------------------------------- */
+
+BufferedFileWriteStream::BufferedFileWriteStream(size_t bufferSize)
+    : m_hFile(INVALID_HANDLE_VALUE),
+      m_bufferSize(std::max<size_t>(bufferSize, 4096)),
+      m_buffered(0),
+      m_filePosition(0),
+      m_error(eNotOpen)
+{
+}
+
+BufferedFileWriteStream::~BufferedFileWriteStream()
+{
+    close();
+}
+
+Acad::ErrorStatus BufferedFileWriteStream::create(const ACHAR* path)
+{
+    close();
+    if (path == nullptr)
+        return Acad::eNullPtr;
+    if (!m_pBuffer)
+    {
+        m_pBuffer.reset(new (std::nothrow) Adesk::UInt8[m_bufferSize]);
+        if (!m_pBuffer)
+            return Acad::eOutOfMemory;
+    }
+    m_hFile = ::CreateFileW(path, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_hFile == INVALID_HANDLE_VALUE)
+        return MappedFile::statusFromWin32(::GetLastError());
+    m_buffered = 0;
+    m_filePosition = 0;
+    m_error = eOk;
+    return Acad::eOk;
+}
+
+int BufferedFileWriteStream::read(void*, size_t, size_t* pNumRead)
+{
+    if (pNumRead != nullptr)
+        *pNumRead = 0;
+    return eNotSupported;
+}
+
+int BufferedFileWriteStream::write(const void* pSrcBuf, size_t nNumBytes, size_t* pNumWritten)
+{
+    if (pNumWritten != nullptr)
+        *pNumWritten = 0;
+    if (m_error != eOk)
+        return m_error;
+    if (pSrcBuf == nullptr && nNumBytes != 0)
+        return eInvalidArg;
+
+    const Adesk::UInt8* p = static_cast<const Adesk::UInt8*>(pSrcBuf);
+    size_t left = nNumBytes;
+    if (m_buffered != 0)
+    {
+        const size_t count = std::min(left, m_bufferSize - m_buffered);
+        std::memcpy(m_pBuffer.get() + m_buffered, p, count);
+        m_buffered += count;
+        p += count;
+        left -= count;
+        if (m_buffered == m_bufferSize && flushBuffers() != eOk)
+            return m_error;
+    }
+    if (left >= m_bufferSize)
+    {
+        if (writeOut(p, left) != eOk)
+            return m_error;
+        m_filePosition += left;
+    }
+    else if (left != 0)
+    {
+        std::memcpy(m_pBuffer.get(), p, left);
+        m_buffered = left;
+    }
+    if (pNumWritten != nullptr)
+        *pNumWritten = nNumBytes;
+    return eOk;
+}
+
+int BufferedFileWriteStream::seek(Adesk::Int64 nDistance, int nMode)
+{
+    if (m_error != eOk)
+        return m_error;
+    if (flushBuffers() != eOk)
+        return m_error;
+    const DWORD method = nMode == eFromStart ? FILE_BEGIN : nMode == eFromCurrent ? FILE_CURRENT
+                       : nMode == eFromEnd ? FILE_END : MAXDWORD;
+    if (method == MAXDWORD)
+        return eInvalidArg;
+    LARGE_INTEGER distance, position;
+    distance.QuadPart = nDistance;
+    if (!::SetFilePointerEx(m_hFile, distance, &position, method))
+        return eInvalidArg;
+    m_filePosition = static_cast<Adesk::UInt64>(position.QuadPart);
+    return eOk;
+}
+
+Adesk::Int64 BufferedFileWriteStream::tell()
+{
+    return isOpen() ? static_cast<Adesk::Int64>(m_filePosition + m_buffered) : -1;
+}
+
+int BufferedFileWriteStream::close()
+{
+    if (!isOpen())
+        return eNotOpen;
+    flushBuffers();
+    ::CloseHandle(m_hFile);
+    m_hFile = INVALID_HANDLE_VALUE;
+    const int status = m_error;
+    m_error = eNotOpen;
+    return status;
+}
+
+int BufferedFileWriteStream::flushBuffers()
+{
+    if (m_error != eOk)
+        return m_error;
+    if (m_buffered == 0)
+        return eOk;
+    if (writeOut(m_pBuffer.get(), m_buffered) != eOk)
+        return m_error;
+    m_filePosition += m_buffered;
+    m_buffered = 0;
+    return eOk;
+}
+
+int BufferedFileWriteStream::setEndOfFile()
+{
+    if (flushBuffers() != eOk)
+        return m_error;
+    return ::SetEndOfFile(m_hFile) ? eOk : fail(::GetLastError());
+}
+
+int BufferedFileWriteStream::writeOut(const void* pData, size_t size)
+{
+    const DWORD error = writeFileFully(m_hFile, pData, size);
+    return error == ERROR_SUCCESS ? eOk : fail(error);
+}
+
+int BufferedFileWriteStream::fail(DWORD error)
+{
+    m_error = MappedFile::streamStatusFromWin32(error);
+    return m_error;
+}
+
+/* Lz4WriteStream ---------------------------------------------------------- */
+
+Lz4WriteStream::Lz4WriteStream(IAcWriteStream* pOutput, BlockSize blockSize)
+    : m_pOutput(pOutput),
+      m_blockSize(blockSize),
+      m_blockCapacity(blockCapacity(blockSize)),
+      m_buffered(0),
+      m_total(0),
+      m_started(false),
+      m_finished(false),
+      m_error(pOutput != nullptr ? eOk : eNotOpen)
+{
+}
+
+Lz4WriteStream::~Lz4WriteStream()
+{
+    close();
+}
+
+int Lz4WriteStream::read(void*, size_t, size_t* pNumRead)
+{
+    if (pNumRead != nullptr)
+        *pNumRead = 0;
+    return eNotSupported;
+}
+
+int Lz4WriteStream::write(const void* pSrcBuf, size_t nNumBytes, size_t* pNumWritten)
+{
+    if (pNumWritten != nullptr)
+        *pNumWritten = 0;
+    if (m_error != eOk)
+        return m_error;
+    if (m_finished)
+        return eNotOpen;
+    if (pSrcBuf == nullptr && nNumBytes != 0)
+        return eInvalidArg;
+
+    if (!m_started)
+    {
+        m_pBlock.reset(new (std::nothrow) Adesk::UInt8[m_blockCapacity]);
+        m_pPacked.reset(new (std::nothrow) Adesk::UInt8[m_blockCapacity + 8]);
+        if (!m_pBlock || !m_pPacked)
+            return m_error = eJustAnError;
+
+        Adesk::UInt8 header[7];
+        put32(header, kFrameMagic);
+        header[4] = kVersion | kBlockIndependence | kBlockChecksum;
+        header[5] = static_cast<Adesk::UInt8>(m_blockSize << 4);
+        header[6] = static_cast<Adesk::UInt8>(xxh32(header + 4, 2) >> 8);
+        m_started = true;
+        if (writeOut(header, sizeof(header)) != eOk)
+            return m_error;
+    }
+
+    const Adesk::UInt8* p = static_cast<const Adesk::UInt8*>(pSrcBuf);
+    size_t left = nNumBytes;
+    while (left != 0)
+    {
+        const size_t count = std::min(left, m_blockCapacity - m_buffered);
+        std::memcpy(m_pBlock.get() + m_buffered, p, count);
+        m_buffered += count;
+        p += count;
+        left -= count;
+        if (m_buffered == m_blockCapacity && writeBlock() != eOk)
+            return m_error;
+    }
+    m_total += nNumBytes;
+    if (pNumWritten != nullptr)
+        *pNumWritten = nNumBytes;
+    return eOk;
+}
+
+int Lz4WriteStream::close()
+{
+    if (m_finished || m_pOutput == nullptr)
+        return m_error;
+    if (!m_started)
+    {
+        /* An empty frame still gets its header. */
+        size_t written;
+        if (write(nullptr, 0, &written) != eOk)
+            return m_error;
+    }
+    m_finished = true;
+    if (m_error != eOk || (m_buffered != 0 && writeBlock() != eOk))
+        return m_error;
+    Adesk::UInt8 endMark[4] = {0, 0, 0, 0};
+    if (writeOut(endMark, sizeof(endMark)) != eOk)
+        return m_error;
+    const int status = m_pOutput->flushBuffers();
+    if (status != eOk && status != eNotSupported)
+        m_error = status;
+    return m_error;
+}
+
+int Lz4WriteStream::flushBuffers()
+{
+    if (m_error != eOk)
+        return m_error;
+    if (m_buffered != 0 && writeBlock() != eOk)
+        return m_error;
+    const int status = m_pOutput->flushBuffers();
+    return status == eNotSupported ? eOk : status;
+}
+
+/* A block that would not shrink is stored as it is. */
+int Lz4WriteStream::writeBlock()
+{
+    const size_t size = m_buffered;
+    m_buffered = 0;
+    Adesk::UInt8* const pPacked = m_pPacked.get();
+    const size_t packedSize = lz4Compress(m_pBlock.get(), size, pPacked + 4, size - 1);
+    if (packedSize != 0)
+    {
+        put32(pPacked, static_cast<Adesk::UInt32>(packedSize));
+        put32(pPacked + 4 + packedSize, xxh32(pPacked + 4, packedSize));
+        return writeOut(pPacked, packedSize + 8);
+    }
+    Adesk::UInt8 prefix[4];
+    Adesk::UInt8 checksum[4];
+    put32(prefix, static_cast<Adesk::UInt32>(size) | kStoredBlock);
+    put32(checksum, xxh32(m_pBlock.get(), size));
+    if (writeOut(prefix, sizeof(prefix)) != eOk || writeOut(m_pBlock.get(), size) != eOk)
+        return m_error;
+    return writeOut(checksum, sizeof(checksum));
+}
+
+int Lz4WriteStream::writeOut(const void* pData, size_t size)
+{
+    size_t written = 0;
+    const int status = m_pOutput->write(pData, size, &written);
+    if (status != eOk || written != size)
+        m_error = status != eOk ? status : eJustAnError;
+    return m_error;
+}
+
+/* Lz4ReadStream ----------------------------------------------------------- */
+
+Lz4ReadStream::Lz4ReadStream(IAcReadStream* pInput)
+    : m_pInput(pInput),
+      m_blockMaxSize(0),
+      m_begin(0),
+      m_end(0),
+      m_total(0),
+      m_inFrame(false),
+      m_dependent(false),
+      m_blockChecksums(false),
+      m_contentChecksum(false),
+      m_status(pInput != nullptr ? eOk : eNotOpen)
+{
+}
+
+Lz4ReadStream::~Lz4ReadStream()
+{
+}
+
+int Lz4ReadStream::read(void* pDestBuf, size_t nNumBytes, size_t* pNumRead)
+{
+    if (pNumRead != nullptr)
+        *pNumRead = 0;
+    if (pDestBuf == nullptr && nNumBytes != 0)
+        return eInvalidArg;
+
+    Adesk::UInt8* p = static_cast<Adesk::UInt8*>(pDestBuf);
+    size_t count = 0;
+    while (count < nNumBytes)
+    {
+        if (m_begin == m_end)
+        {
+            if (m_status != eOk || readBlock() != eOk)
+                break;
+            continue;
+        }
+        const size_t chunk = std::min(nNumBytes - count, m_end - m_begin);
+        std::memcpy(p + count, m_window.data() + m_begin, chunk);
+        m_begin += chunk;
+        count += chunk;
+    }
+    m_total += count;
+    if (pNumRead != nullptr)
+        *pNumRead = count;
+    return count < nNumBytes ? m_status : eOk;
+}
+
+bool Lz4ReadStream::readInput(void* pData, size_t size)
+{
+    Adesk::UInt8* p = static_cast<Adesk::UInt8*>(pData);
+    while (size != 0)
+    {
+        size_t count = 0;
+        m_pInput->read(p, size, &count);
+        if (count == 0)
+            return false;
+        p += count;
+        size -= count;
+    }
+    return true;
+}
+
+/* Sets m_status to eEndOfFile if the input ends where a frame could start. */
+int Lz4ReadStream::readFrameHeader()
+{
+    Adesk::UInt8 header[19];
+    for (;;)
+    {
+        size_t count = 0;
+        m_pInput->read(header, 4, &count);
+        if (count == 0)
+            return m_status = eEndOfFile;
+        if (count < 4 && !readInput(header + count, 4 - count))
+            return m_status = eJustAnError;
+        const Adesk::UInt32 magic = get32(header);
+        if ((magic & 0xFFFFFFF0) != kSkippableMagic)
+        {
+            if (magic != kFrameMagic)
+                return m_status = eJustAnError;
+            break;
+        }
+        if (!readInput(header, 4))
+            return m_status = eJustAnError;
+        for (Adesk::UInt32 left = get32(header); left != 0;)
+        {
+            const Adesk::UInt32 chunk = std::min<Adesk::UInt32>(left, sizeof(header));
+            if (!readInput(header, chunk))
+                return m_status = eJustAnError;
+            left -= chunk;
+        }
+    }
+
+    if (!readInput(header, 2))
+        return m_status = eJustAnError;
+    const Adesk::UInt8 flags = header[0];
+    const Adesk::UInt8 blockCode = (header[1] >> 4) & 7;
+    if ((flags & 0xC0) != kVersion || (flags & 0x02) != 0 || (flags & kDictionaryId) != 0 ||
+        (header[1] & 0x8F) != 0 || blockCode < 4)
+        return m_status = eJustAnError;
+    const size_t descriptorSize = 2 + ((flags & kContentSize) != 0 ? 8 : 0);
+    if (!readInput(header + 2, descriptorSize - 2 + 1) ||
+        header[descriptorSize] != static_cast<Adesk::UInt8>(xxh32(header, descriptorSize) >> 8))
+        return m_status = eJustAnError;
+
+    m_dependent = (flags & kBlockIndependence) == 0;
+    m_blockChecksums = (flags & kBlockChecksum) != 0;
+    m_contentChecksum = (flags & kContentChecksum) != 0;
+    m_contentHash.reset();
+    m_blockMaxSize = blockCapacity(blockCode);
+    try
+    {
+        if (m_window.size() < kHistorySize + m_blockMaxSize)
+            m_window.resize(kHistorySize + m_blockMaxSize);
+        if (m_packed.size() < m_blockMaxSize)
+            m_packed.resize(m_blockMaxSize);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return m_status = eJustAnError;
+    }
+    m_begin = 0;
+    m_end = 0;
+    m_inFrame = true;
+    return eOk;
+}
+
+/* Reads frames until it has a block with something in it, or there is none
+left.  A block of a frame with dependent blocks goes after the last 64 KB
+of those before it, which its matches may reach back into. */
+int Lz4ReadStream::readBlock()
+{
+    for (;;)
+    {
+        if (!m_inFrame && readFrameHeader() != eOk)
+            return m_status;
+
+        Adesk::UInt8 prefix[4];
+        if (!readInput(prefix, sizeof(prefix)))
+            return m_status = eJustAnError;
+        const Adesk::UInt32 field = get32(prefix);
+        if (field == 0)
+        {
+            if (m_contentChecksum &&
+                (!readInput(prefix, sizeof(prefix)) || get32(prefix) != m_contentHash.digest()))
+                return m_status = eJustAnError;
+            m_inFrame = false;
+            continue;
+        }
+        const bool stored = (field & kStoredBlock) != 0;
+        const size_t size = field & ~kStoredBlock;
+        if (size > m_blockMaxSize)
+            return m_status = eJustAnError;
+
+        size_t history = 0;
+        if (m_dependent)
+        {
+            history = std::min(m_end, kHistorySize);
+            std::memmove(m_window.data(), m_window.data() + m_end - history, history);
+        }
+        Adesk::UInt8* const pOut = m_window.data() + history;
+        Adesk::UInt8* const pData = stored ? pOut : m_packed.data();
+        if (!readInput(pData, size))
+            return m_status = eJustAnError;
+        if (m_blockChecksums && (!readInput(prefix, sizeof(prefix)) || get32(prefix) != xxh32(pData, size)))
+            return m_status = eJustAnError;
+
+        size_t produced = size;
+        if (!stored && lz4Decompress(pData, size, pOut, m_blockMaxSize, produced, history) != Acad::eOk)
+            return m_status = eJustAnError;
+        if (m_contentChecksum)
+            m_contentHash.update(pOut, produced);
+        m_begin = history;
+        m_end = history + produced;
+        if (produced != 0)
+            return eOk;
+    }
+}
+
+} // namespace acad_sheetset_to_pdf
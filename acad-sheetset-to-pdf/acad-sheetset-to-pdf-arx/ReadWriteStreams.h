@@ -0,0 +1,274 @@
+#pragma once
+
+#include "Checksum.h"
+#include "IAcReadWriteStream.h"
+#include "MappedFile.h"
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// Reads bytes someone else owns, without copying them first.
+///
+/// read() copies out like any IAcReadStream; take() hands out a pointer to
+/// the next bytes where they lie instead, for readers that can use them in
+/// place.  Reading past the end returns the bytes that are left and
+/// eEndOfFile.  Seeking is allowed anywhere from the start to the end.
+/// </summary>
+class MemoryReadStream : public IAcReadStream
+{
+public:
+    MemoryReadStream();
+    MemoryReadStream(const void* pData, size_t size);
+    ~MemoryReadStream();
+
+    MemoryReadStream(const MemoryReadStream&) = delete;
+    MemoryReadStream& operator=(const MemoryReadStream&) = delete;
+
+    /// <summary>
+    /// Starts reading size bytes at pData from the beginning.
+    /// </summary>
+    void reset(const void* pData, size_t size);
+
+    int read(void* pDestBuf, size_t nNumBytes, size_t* pNumRead) override;
+    int seek(Adesk::Int64 nDistance, int nMode) override;
+    Adesk::Int64 tell() override { return static_cast<Adesk::Int64>(m_position); }
+    int close() override;
+
+    /// <summary>
+    /// The next size bytes and moves past them, or null, without moving,
+    /// if fewer are left.
+    /// </summary>
+    const Adesk::UInt8* take(size_t size);
+
+    const Adesk::UInt8* data() const { return m_pData; }
+    size_t size() const { return m_size; }
+    size_t remaining() const { return m_size - m_position; }
+
+protected:
+    /// <summary>
+    /// Called whenever reading or seeking has moved the position.
+    /// </summary>
+    virtual void moved() {}
+
+    const Adesk::UInt8* m_pData;
+    size_t              m_size;
+    size_t              m_position;
+};
+
+/// <summary>
+/// Reads a file through a MappedFile.
+///
+/// Pages are faulted in as they are first touched, so a stream read from
+/// front to back would wait on the disk at every page.  Instead, each time
+/// the position passes the middle of the window ahead of it that was last
+/// prefetched, the next window is asked for, and the pages arrive while the
+/// ones before them are read.  take() gives the mapped bytes themselves.
+/// </summary>
+class MappedReadStream : public MemoryReadStream
+{
+public:
+    /// <summary>
+    /// readAhead is how far ahead of the position pages are prefetched;
+    /// 0 leaves paging to the operating system.
+    /// </summary>
+    explicit MappedReadStream(size_t readAhead = 4 << 20);
+    ~MappedReadStream();
+
+    Acad::ErrorStatus open(const ACHAR* path);
+    int close() override;
+
+    bool isOpen() const { return m_file.isOpen(); }
+
+protected:
+    void moved() override;
+
+private:
+    MappedFile  m_file;
+    size_t      m_readAhead;
+    size_t      m_prefetchedTo;
+};
+
+/// <summary>
+/// A stream kept in memory that grows as it is written.
+///
+/// Writes at the position, overwriting and then extending what is there,
+/// and reads and seeks like a file.  The memory is kept when the stream is
+/// cleared or truncated, so a stream reused for one object after another,
+/// one per worker thread say, soon stops allocating.
+/// </summary>
+class ArenaStream : public IAcWriteStream
+{
+public:
+    explicit ArenaStream(size_t capacity = 0);
+    ~ArenaStream();
+
+    ArenaStream(const ArenaStream&) = delete;
+    ArenaStream& operator=(const ArenaStream&) = delete;
+
+    int read(void* pDestBuf, size_t nNumBytes, size_t* pNumRead) override;
+    int write(const void* pSrcBuf, size_t nNumBytes, size_t* pNumWritten) override;
+    int seek(Adesk::Int64 nDistance, int nMode) override;
+    Adesk::Int64 tell() override { return static_cast<Adesk::Int64>(m_position); }
+    int close() override { return eOk; }
+    int flushBuffers() override { return eOk; }
+    int setEndOfFile() override;
+
+    const Adesk::UInt8* data() const { return m_bytes.data(); }
+    Adesk::UInt8* data() { return m_bytes.data(); }
+    size_t size() const { return m_bytes.size(); }
+
+    /// <summary>
+    /// Cuts the stream to size bytes, if it is longer, moving the position
+    /// back to the new end if it was past it.
+    /// </summary>
+    void truncate(size_t size);
+
+    void clear() { truncate(0); }
+
+private:
+    std::vector<Adesk::UInt8>   m_bytes;
+    size_t                      m_position;
+};
+
+/// <summary>
+/// Writes a file through a large buffer, so that streams written a few
+/// bytes at a time cost one WriteFile call per buffer.  Writes at least as
+/// large as the buffer go to the file directly.
+///
+/// flushBuffers() hands the buffer to the operating system; close() does
+/// too and closes the file.  The first error sticks: every call after it
+/// returns it, and closing leaves the file as far as it got.
+/// </summary>
+class BufferedFileWriteStream : public IAcWriteStream
+{
+public:
+    explicit BufferedFileWriteStream(size_t bufferSize = 1 << 20);
+    ~BufferedFileWriteStream();
+
+    BufferedFileWriteStream(const BufferedFileWriteStream&) = delete;
+    BufferedFileWriteStream& operator=(const BufferedFileWriteStream&) = delete;
+
+    /// <summary>
+    /// Creates the file at path, or truncates it.  Any file previously open
+    /// is closed first.
+    /// </summary>
+    Acad::ErrorStatus create(const ACHAR* path);
+
+    int read(void* pDestBuf, size_t nNumBytes, size_t* pNumRead) override;
+    int write(const void* pSrcBuf, size_t nNumBytes, size_t* pNumWritten) override;
+    int seek(Adesk::Int64 nDistance, int nMode) override;
+    Adesk::Int64 tell() override;
+    int close() override;
+    int flushBuffers() override;
+    int setEndOfFile() override;
+
+    bool isOpen() const { return m_hFile != INVALID_HANDLE_VALUE; }
+
+private:
+    int writeOut(const void* pData, size_t size);
+    int fail(DWORD error);
+
+    HANDLE                          m_hFile;
+    std::unique_ptr<Adesk::UInt8[]> m_pBuffer;
+    size_t                          m_bufferSize;
+    size_t                          m_buffered;
+    Adesk::UInt64                   m_filePosition;     // of the start of the buffer
+    int                             m_error;
+};
+
+/// <summary>
+/// Compresses what is written to it into an LZ4 frame on another stream,
+/// as the lz4 tool reads and writes them: independent blocks, each with
+/// its xxHash checksum.
+///
+/// Data is gathered into blocks of the chosen size; each full block is
+/// compressed and written on, or written as it is if it would not shrink.
+/// flushBuffers() writes out the block so far as a short one and flushes
+/// the output.  close() ends the frame and flushes; it does not close the
+/// output, which is the caller's.  tell() counts uncompressed bytes.
+/// </summary>
+class Lz4WriteStream : public IAcWriteStream
+{
+public:
+    enum BlockSize
+    {
+        k64KB   = 4,
+        k256KB  = 5,
+        k1MB    = 6,
+        k4MB    = 7
+    };
+
+    explicit Lz4WriteStream(IAcWriteStream* pOutput, BlockSize blockSize = k1MB);
+    ~Lz4WriteStream();
+
+    Lz4WriteStream(const Lz4WriteStream&) = delete;
+    Lz4WriteStream& operator=(const Lz4WriteStream&) = delete;
+
+    int read(void* pDestBuf, size_t nNumBytes, size_t* pNumRead) override;
+    int write(const void* pSrcBuf, size_t nNumBytes, size_t* pNumWritten) override;
+    Adesk::Int64 tell() override { return static_cast<Adesk::Int64>(m_total); }
+    int close() override;
+    int flushBuffers() override;
+
+private:
+    int writeBlock();
+    int writeOut(const void* pData, size_t size);
+
+    IAcWriteStream*                 m_pOutput;
+    BlockSize                       m_blockSize;
+    std::unique_ptr<Adesk::UInt8[]> m_pBlock;
+    std::unique_ptr<Adesk::UInt8[]> m_pPacked;
+    size_t                          m_blockCapacity;
+    size_t                          m_buffered;
+    Adesk::UInt64                   m_total;
+    bool                            m_started;
+    bool                            m_finished;
+    int                             m_error;
+};
+
+/// <summary>
+/// Decompresses LZ4 frames read from another stream: those Lz4WriteStream
+/// writes and those of the lz4 tool, with dependent or independent blocks,
+/// one frame after another, skippable frames skipped.  Block and content
+/// checksums are checked when the frame has them; a content checksum that
+/// does not match fails the read that reaches the end of its frame, after
+/// the frame's data has been handed out.  Frames with a dictionary are not
+/// supported.
+///
+/// A damaged frame returns eJustAnError from then on.  tell() counts
+/// uncompressed bytes.  close() does not close the input.
+/// </summary>
+class Lz4ReadStream : public IAcReadStream
+{
+public:
+    explicit Lz4ReadStream(IAcReadStream* pInput);
+    ~Lz4ReadStream();
+
+    Lz4ReadStream(const Lz4ReadStream&) = delete;
+    Lz4ReadStream& operator=(const Lz4ReadStream&) = delete;
+
+    int read(void* pDestBuf, size_t nNumBytes, size_t* pNumRead) override;
+    Adesk::Int64 tell() override { return static_cast<Adesk::Int64>(m_total); }
+    int close() override { return eOk; }
+
+private:
+    int readFrameHeader();
+    int readBlock();
+    bool readInput(void* pData, size_t size);
+
+    IAcReadStream*                  m_pInput;
+    std::vector<Adesk::UInt8>       m_window;       // history, then the block being read out
+    std::vector<Adesk::UInt8>       m_packed;
+    size_t                          m_blockMaxSize;
+    size_t                          m_begin;        // of the unread bytes in m_window
+    size_t                          m_end;
+    Adesk::UInt64                   m_total;
+    bool                            m_inFrame;
+    bool                            m_dependent;
+    bool                            m_blockChecksums;
+    bool                            m_contentChecksum;
+    Xxh32Stream                     m_contentHash;  // of the frame so far
+    int                             m_status;       // eOk, eEndOfFile or the error
+};
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,655 @@
+#include "stdafx.h"
+#include "SheetSetFile.h"
+#include "MappedFile.h"
+
+#include <climits>
+#include <cwctype>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+/* The byte substitution of DST files; kDecode[stored byte] is the byte of the
+XML document.  Same table as AcSmDatabase.decode in the managed reader. */
+const Adesk::UInt8 kDecode[256] =
+{
+    0x8c, 0x8b, 0x8e, 0x8d, 0x88, 0x87, 0x8a, 0x89, 0x84, 0x83, 0x86, 0x85, 0x80, 0x7f, 0x82, 0x81,
+    0x7c, 0x7b, 0x7e, 0x7d, 0x78, 0x77, 0x7a, 0x79, 0x74, 0x73, 0x76, 0x75, 0x70, 0x6f, 0x72, 0x71,
+    0xac, 0xab, 0xae, 0xad, 0xa8, 0xa7, 0xaa, 0xa9, 0xa4, 0xa3, 0xa6, 0xa5, 0xa0, 0x9f, 0xa2, 0xa1,
+    0x9c, 0x9b, 0x9e, 0x9d, 0x98, 0x97, 0x9a, 0x99, 0x94, 0x93, 0x96, 0x95, 0x90, 0x8f, 0x92, 0x91,
+    0xcc, 0xcb, 0xce, 0xcd, 0xc8, 0xc7, 0xca, 0xc9, 0xc4, 0xc3, 0xc6, 0xc5, 0xc0, 0xbf, 0xc2, 0xc1,
+    0xbc, 0xbb, 0xbe, 0xbd, 0xb8, 0xb7, 0xba, 0xb9, 0xb4, 0xb3, 0xb6, 0xb5, 0xb0, 0xaf, 0xb2, 0xb1,
+    0xec, 0xeb, 0xee, 0xed, 0xe8, 0xe7, 0xea, 0xe9, 0xe4, 0xe3, 0xe6, 0xe5, 0xe0, 0xdf, 0xe2, 0xe1,
+    0xdc, 0xdb, 0xde, 0xdd, 0xd8, 0xd7, 0xda, 0xd9, 0xd4, 0xd3, 0xd6, 0xd5, 0xd0, 0xcf, 0xd2, 0xd1,
+    0x0c, 0x0b, 0x0e, 0x0d, 0x08, 0x07, 0x0a, 0x09, 0x04, 0x03, 0x06, 0x05, 0x00, 0x0f, 0x02, 0x01,
+    0xfc, 0xfb, 0xfe, 0xfd, 0xf8, 0xf7, 0xfa, 0xf9, 0xf4, 0xf3, 0xf6, 0xf5, 0xf0, 0xef, 0xf2, 0xf1,
+    0x2c, 0x2b, 0x2e, 0x2d, 0x28, 0x27, 0x2a, 0x29, 0x24, 0x23, 0x26, 0x25, 0x20, 0x1f, 0x22, 0x21,
+    0x1c, 0x1b, 0x1e, 0x1d, 0x18, 0x17, 0x1a, 0x19, 0x14, 0x13, 0x16, 0x15, 0x10, 0x0f, 0x12, 0x11,
+    0x4c, 0x4b, 0x4e, 0x4d, 0x48, 0x47, 0x4a, 0x49, 0x44, 0x43, 0x46, 0x45, 0x40, 0x3f, 0x42, 0x41,
+    0x3c, 0x3b, 0x3e, 0x3d, 0x38, 0x37, 0x3a, 0x39, 0x34, 0x33, 0x36, 0x35, 0x30, 0x2f, 0x32, 0x31,
+    0x6c, 0x6b, 0x6e, 0x6d, 0x68, 0x67, 0x6a, 0x69, 0x64, 0x63, 0x66, 0x65, 0x60, 0x5f, 0x62, 0x61,
+    0x5c, 0x5b, 0x5e, 0x5d, 0x58, 0x57, 0x5a, 0x59, 0x54, 0x53, 0x56, 0x55, 0x50, 0x4f, 0x52, 0x51
+};
+
+/* Undoes the substitution and decodes the document to UTF-16.  The Sheet Set
+Manager writes UTF-8; UTF-16 is recognized by its byte order mark. */
+bool decodeDocument(const Adesk::UInt8* pData, size_t size, std::wstring& text)
+{
+    std::vector<char> bytes(size);
+    for (size_t i = 0; i < size; ++i)
+        bytes[i] = static_cast<char>(kDecode[pData[i]]);
+
+    text.clear();
+    if (size >= 2 && Adesk::UInt8(bytes[0]) == 0xFF && Adesk::UInt8(bytes[1]) == 0xFE)
+    {
+        text.resize((size - 2) / 2);
+        for (size_t i = 0; i < text.size(); ++i)
+            text[i] = static_cast<wchar_t>(Adesk::UInt8(bytes[2 + 2 * i]) | (Adesk::UInt8(bytes[3 + 2 * i]) << 8));
+        return true;
+    }
+
+    size_t start = 0;
+    if (size >= 3 && Adesk::UInt8(bytes[0]) == 0xEF && Adesk::UInt8(bytes[1]) == 0xBB && Adesk::UInt8(bytes[2]) == 0xBF)
+        start = 3;
+    if (size - start > size_t(INT_MAX))
+        return false;
+    const int length = static_cast<int>(size - start);
+    if (length == 0)
+        return true;
+    const int wideLength = ::MultiByteToWideChar(CP_UTF8, 0, &bytes[start], length, nullptr, 0);
+    if (wideLength <= 0)
+        return false;
+    text.resize(size_t(wideLength));
+    ::MultiByteToWideChar(CP_UTF8, 0, &bytes[start], length, &text[0], wideLength);
+    return true;
+}
+
+/* Appends XML character data to out, replacing the predefined entities and
+character references.  Anything that is not one is kept as it is. */
+void appendText(const wchar_t* p, const wchar_t* end, std::wstring& out)
+{
+    while (p < end)
+    {
+        if (*p != L'&')
+        {
+            out += *p++;
+            continue;
+        }
+        const wchar_t* pSemicolon = std::find(p, end, L';');
+        const std::wstring entity(p + 1, pSemicolon);
+        unsigned long code = 0;
+        if (pSemicolon == end)
+            code = 0;
+        else if (entity == L"lt")
+            code = L'<';
+        else if (entity == L"gt")
+            code = L'>';
+        else if (entity == L"amp")
+            code = L'&';
+        else if (entity == L"quot")
+            code = L'"';
+        else if (entity == L"apos")
+            code = L'\'';
+        else if (entity.size() > 1 && entity[0] == L'#')
+            code = (entity[1] == L'x' || entity[1] == L'X') ? std::wcstoul(entity.c_str() + 2, nullptr, 16)
+                                                            : std::wcstoul(entity.c_str() + 1, nullptr, 10);
+        if (code == 0 || code > 0x10FFFF)
+        {
+            out += *p++;
+            continue;
+        }
+        if (code >= 0x10000)
+        {
+            code -= 0x10000;
+            out += static_cast<wchar_t>(0xD800 + (code >> 10));
+            out += static_cast<wchar_t>(0xDC00 + (code & 0x3FF));
+        }
+        else
+        {
+            out += static_cast<wchar_t>(code);
+        }
+        p = pSemicolon + 1;
+    }
+}
+
+/* File names are compared as Windows compares them. */
+std::wstring normalizePath(const std::wstring& path)
+{
+    std::wstring key(path);
+    for (wchar_t& c : key)
+        c = c == L'/' ? L'\\' : static_cast<wchar_t>(std::towlower(c));
+    return key;
+}
+
+std::wstring lowerCase(const ACHAR* pText)
+{
+    std::wstring key(pText != nullptr ? pText : L"");
+    for (wchar_t& c : key)
+        c = static_cast<wchar_t>(std::towlower(c));
+    return key;
+}
+
+bool sameName(const std::wstring& name, const ACHAR* pOther)
+{
+    size_t i = 0;
+    for (; i < name.size() && pOther[i] != L'\0'; ++i)
+    {
+        if (std::towlower(name[i]) != std::towlower(pOther[i]))
+            return false;
+    }
+    return i == name.size() && pOther[i] == L'\0';
+}
+
+template<class Property>
+Property* findProperty(std::vector<Property>& properties, const ACHAR* name)
+{
+    for (Property& property : properties)
+    {
+        if (sameName(property.name, name))
+            return &property;
+    }
+    return nullptr;
+}
+
+std::wstring fileNameOf(const std::wstring& normalizedPath)
+{
+    const size_t separator = normalizedPath.find_last_of(L'\\');
+    return separator != std::wstring::npos ? normalizedPath.substr(separator + 1) : normalizedPath;
+}
+
+bool fileExists(const std::wstring& path)
+{
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    return !path.empty() && ::GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &attributes) &&
+           (attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0;
+}
+
+/* Joins a path relative to the sheet set's folder onto that folder. */
+std::wstring resolveRelative(const std::wstring& folder, const std::wstring& relative)
+{
+    std::wstring path(folder);
+    size_t start = 0;
+    while (start <= relative.size())
+    {
+        size_t stop = relative.find_first_of(L"\\/", start);
+        if (stop == std::wstring::npos)
+            stop = relative.size();
+        const std::wstring part(relative, start, stop - start);
+        if (part == L"..")
+        {
+            const size_t separator = path.find_last_of(L"\\/");
+            path.erase(separator != std::wstring::npos ? separator : 0);
+        }
+        else if (!part.empty() && part != L".")
+        {
+            if (!path.empty())
+                path += L'\\';
+            path += part;
+        }
+        start = stop + 1;
+    }
+    return path;
+}
+
+/* Picks the parts of a sheet set document that SheetSetFile keeps out of
+the element tree, in one pass and without building the tree.
+
+Sheets may sit directly in the sheet set or in subsets nested to any depth;
+the property bags of subsets are skipped.  A sheet's layout is the
+AcSmAcDbLayoutReference whose propname is "Layout"; the view references and
+other objects a sheet holds have the same AcSmProp children and are told
+apart by that. */
+class SheetSetParser
+{
+public:
+    SheetSetParser(std::wstring& name, std::vector<SheetSetProperty>& properties, std::vector<SheetSetSheet>& sheets)
+        : m_name(name)
+        , m_properties(properties)
+        , m_sheets(sheets)
+        , m_sheetSetCount(0)
+        , m_sheet(-1)
+        , m_owner(kNoOwner)
+        , m_capture(false)
+    {
+    }
+
+    bool parse(const wchar_t* p, const wchar_t* end);
+
+    /* The FileName and Relative_FileName of every sheet's layout. */
+    std::vector<std::wstring> fileNames;
+    std::vector<std::wstring> relativeFileNames;
+
+private:
+    enum Kind
+    {
+        kOther,
+        kSheetSet,
+        kSheet,
+        kPropertyBag,
+        kPropertyValue,
+        kLayoutReference,
+        kProp
+    };
+
+    enum
+    {
+        kNoOwner = -2,
+        kSheetSetOwner = -1
+    };
+
+    struct Frame
+    {
+        Kind         kind;
+        std::wstring propname;
+    };
+
+    void startElement(const std::wstring& element, const std::wstring& propname);
+    void endElement();
+    const Frame* parent(size_t level) const
+    {
+        return level < m_stack.size() ? &m_stack[m_stack.size() - 1 - level] : nullptr;
+    }
+
+    std::wstring&                  m_name;
+    std::vector<SheetSetProperty>& m_properties;
+    std::vector<SheetSetSheet>&    m_sheets;
+    std::vector<Frame>             m_stack;
+    size_t                         m_sheetSetCount;
+    long                           m_sheet;        // index of the sheet being read, or -1
+    long                           m_owner;        // whose property m_property is
+    SheetSetProperty               m_property;
+    std::wstring                   m_text;
+    bool                           m_capture;      // inside an AcSmProp
+};
+
+void SheetSetParser::startElement(const std::wstring& element, const std::wstring& propname)
+{
+    Kind kind = kOther;
+    if (element == L"AcSmProp")
+        kind = kProp;
+    else if (element == L"AcSmSheet")
+        kind = kSheet;
+    else if (element == L"AcSmCustomPropertyBag")
+        kind = kPropertyBag;
+    else if (element == L"AcSmCustomPropertyValue")
+        kind = kPropertyValue;
+    else if (element == L"AcSmAcDbLayoutReference" && propname == L"Layout")
+        kind = kLayoutReference;
+    else if (element == L"AcSmSheetSet")
+        kind = kSheetSet;
+
+    const Frame* pParent = parent(0);
+    switch (kind)
+    {
+    case kSheetSet:
+        ++m_sheetSetCount;
+        break;
+    case kSheet:
+        if (m_sheetSetCount != 0 && m_sheet < 0)
+        {
+            m_sheet = static_cast<long>(m_sheets.size());
+            m_sheets.emplace_back();
+            fileNames.emplace_back();
+            relativeFileNames.emplace_back();
+        }
+        break;
+    case kPropertyValue:
+        m_owner = kNoOwner;
+        if (pParent != nullptr && pParent->kind == kPropertyBag)
+        {
+            const Frame* pBagOwner = parent(1);
+            if (pBagOwner != nullptr && pBagOwner->kind == kSheet && m_sheet >= 0)
+                m_owner = m_sheet;
+            else if (pBagOwner != nullptr && pBagOwner->kind == kSheetSet)
+                m_owner = kSheetSetOwner;
+        }
+        m_property = SheetSetProperty();
+        m_property.name = propname;
+        break;
+    case kProp:
+        m_capture = true;
+        m_text.clear();
+        break;
+    default:
+        break;
+    }
+    m_stack.push_back(Frame{kind, propname});
+}
+
+void SheetSetParser::endElement()
+{
+    if (m_stack.empty())
+        return;
+    const Frame frame = m_stack.back();
+    m_stack.pop_back();
+    const Frame* pParent = parent(0);
+
+    switch (frame.kind)
+    {
+    case kSheetSet:
+        --m_sheetSetCount;
+        break;
+    case kSheet:
+        m_sheet = -1;
+        break;
+    case kPropertyValue:
+        if (m_owner == kSheetSetOwner)
+            m_properties.push_back(m_property);
+        else if (m_owner >= 0)
+            m_sheets[size_t(m_owner)].properties.push_back(m_property);
+        m_owner = kNoOwner;
+        break;
+    case kProp:
+        m_capture = false;
+        if (pParent == nullptr)
+            break;
+        if (pParent->kind == kPropertyValue)
+        {
+            if (frame.propname == L"Value")
+                m_property.value = m_text;
+            else if (frame.propname == L"Flags")
+                m_property.flags = std::wcstoul(m_text.c_str(), nullptr, 10);
+        }
+        else if (pParent->kind == kLayoutReference && m_sheet >= 0 && parent(1) != nullptr && parent(1)->kind == kSheet)
+        {
+            if (frame.propname == L"Name")
+                m_sheets[size_t(m_sheet)].layout = m_text;
+            else if (frame.propname == L"FileName")
+                fileNames[size_t(m_sheet)] = m_text;
+            else if (frame.propname == L"Relative_FileName")
+                relativeFileNames[size_t(m_sheet)] = m_text;
+        }
+        else if (pParent->kind == kSheet && m_sheet >= 0)
+        {
+            if (frame.propname == L"Title")
+                m_sheets[size_t(m_sheet)].title = m_text;
+            else if (frame.propname == L"Number")
+                m_sheets[size_t(m_sheet)].number = m_text;
+        }
+        else if (pParent->kind == kSheetSet && m_sheetSetCount == 1 && frame.propname == L"Name")
+        {
+            m_name = m_text;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+bool SheetSetParser::parse(const wchar_t* p, const wchar_t* end)
+{
+    bool sawSheetSet = false;
+    std::wstring element, attribute, value, propname;
+    while (p < end)
+    {
+        if (*p != L'<')
+        {
+            const wchar_t* pStop = std::find(p, end, L'<');
+            if (m_capture)
+                appendText(p, pStop, m_text);
+            p = pStop;
+            continue;
+        }
+
+        const size_t remaining = size_t(end - p);
+        if (remaining >= 4 && std::wcsncmp(p, L"<!--", 4) == 0)
+        {
+            const wchar_t* pStop = std::search(p + 4, end, L"-->", L"-->" + 3);
+            p = pStop == end ? end : pStop + 3;
+            continue;
+        }
+        if (remaining >= 9 && std::wcsncmp(p, L"<![CDATA[", 9) == 0)
+        {
+            const wchar_t* pStop = std::search(p + 9, end, L"]]>", L"]]>" + 3);
+            if (m_capture)
+                m_text.append(p + 9, pStop);
+            p = pStop == end ? end : pStop + 3;
+            continue;
+        }
+        if (remaining >= 2 && (p[1] == L'?' || p[1] == L'!'))
+        {
+            p = std::find(p, end, L'>');
+            if (p < end)
+                ++p;
+            continue;
+        }
+
+        const bool closing = remaining >= 2 && p[1] == L'/';
+        p += closing ? 2 : 1;
+        const wchar_t* pName = p;
+        while (p < end && !std::iswspace(*p) && *p != L'>' && *p != L'/')
+            ++p;
+        element.assign(pName, p);
+        if (element.empty())
+            return false;
+
+        if (closing)
+        {
+            p = std::find(p, end, L'>');
+            if (p == end)
+                return false;
+            ++p;
+            endElement();
+            continue;
+        }
+
+        /* Attributes, of which only propname matters. */
+        propname.clear();
+        bool empty = false;
+        for (;;)
+        {
+            while (p < end && std::iswspace(*p))
+                ++p;
+            if (p == end)
+                return false;
+            if (*p == L'>')
+            {
+                ++p;
+                break;
+            }
+            if (*p == L'/')
+            {
+                empty = true;
+                p = std::find(p, end, L'>');
+                if (p == end)
+                    return false;
+                ++p;
+                break;
+            }
+            const wchar_t* pAttribute = p;
+            while (p < end && !std::iswspace(*p) && *p != L'=' && *p != L'>' && *p != L'/')
+                ++p;
+            attribute.assign(pAttribute, p);
+            while (p < end && std::iswspace(*p))
+                ++p;
+            if (p == end || *p != L'=')
+                return false;
+            ++p;
+            while (p < end && std::iswspace(*p))
+                ++p;
+            if (p == end || (*p != L'"' && *p != L'\''))
+                return false;
+            const wchar_t* pValue = p + 1;
+            p = std::find(pValue, end, *p);
+            if (p == end)
+                return false;
+            if (attribute == L"propname")
+            {
+                value.clear();
+                appendText(pValue, p, value);
+                propname = value;
+            }
+            ++p;
+        }
+
+        if (element == L"AcSmSheetSet")
+            sawSheetSet = true;
+        startElement(element, propname);
+        if (empty)
+            endElement();
+    }
+    return sawSheetSet && m_stack.empty();
+}
+
+} // namespace
+
+SheetSetFile::SheetSetFile()
+{
+}
+
+Acad::ErrorStatus SheetSetFile::load(const ACHAR* path)
+{
+    m_path.clear();
+    m_name.clear();
+    m_properties.clear();
+    m_sheets.clear();
+    m_drawingKeys.clear();
+    m_byLayout.clear();
+    m_index.reset(0);
+    if (path == nullptr)
+        return Acad::eNullPtr;
+
+    std::wstring text;
+    {
+        MappedFile file;
+        const Acad::ErrorStatus es = file.open(path);
+        if (es != Acad::eOk)
+            return es;
+        if (!decodeDocument(file.data(), size_t(file.size()), text))
+            return Acad::eUnsupportedFileFormat;
+    }
+
+    SheetSetParser parser(m_name, m_properties, m_sheets);
+    if (!parser.parse(text.data(), text.data() + text.size()))
+    {
+        m_name.clear();
+        m_properties.clear();
+        m_sheets.clear();
+        return Acad::eUnsupportedFileFormat;
+    }
+    m_path = path;
+
+    /* Like the Sheet Set Manager, take the drawing's absolute path if it is
+    still there and look next to the sheet set otherwise. */
+    const size_t separator = m_path.find_last_of(L"\\/");
+    const std::wstring folder(separator != std::wstring::npos ? m_path.substr(0, separator) : std::wstring());
+    m_drawingKeys.reserve(m_sheets.size());
+    m_byLayout.reserve(m_sheets.size());
+    m_index.reset(m_sheets.size());
+    for (size_t i = 0; i < m_sheets.size(); ++i)
+    {
+        SheetSetSheet& sheet = m_sheets[i];
+        const std::wstring& fileName = parser.fileNames[i];
+        const std::wstring& relative = parser.relativeFileNames[i];
+        if (relative.empty() || fileExists(fileName))
+            sheet.drawing = fileName;
+        else
+            sheet.drawing = resolveRelative(folder, relative);
+        m_drawingKeys.push_back(normalizePath(sheet.drawing));
+        m_byLayout.emplace(lowerCase(sheet.layout.c_str()), i);
+
+        for (const SheetSetProperty& property : sheet.properties)
+            m_index.add(i, property.name.c_str(), property.value.c_str());
+        for (const SheetSetProperty& property : m_properties)
+        {
+            if ((property.flags & SheetSetProperty::kSheetProperty) != 0 &&
+                findProperty(sheet.properties, property.name.c_str()) == nullptr)
+                m_index.add(i, property.name.c_str(), property.value.c_str());
+        }
+    }
+    return Acad::eOk;
+}
+
+const SheetSetSheet* SheetSetFile::findSheet(const ACHAR* drawing, const ACHAR* layout) const
+{
+    const std::wstring drawingKey(normalizePath(drawing != nullptr ? drawing : L""));
+    const auto range = m_byLayout.equal_range(lowerCase(layout));
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (m_drawingKeys[it->second] == drawingKey)
+            return &m_sheets[it->second];
+    }
+
+    const std::wstring fileName(fileNameOf(drawingKey));
+    const SheetSetSheet* pFound = nullptr;
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (fileNameOf(m_drawingKeys[it->second]) != fileName)
+            continue;
+        if (pFound != nullptr)
+            return nullptr;
+        pFound = &m_sheets[it->second];
+    }
+    return pFound;
+}
+
+Acad::ErrorStatus SheetSetFile::setSheetProperty(size_t sheet, const ACHAR* name, const ACHAR* value)
+{
+    if (name == nullptr || value == nullptr)
+        return Acad::eNullPtr;
+    if (sheet >= m_sheets.size())
+        return Acad::eInvalidIndex;
+
+    std::vector<SheetSetProperty>& properties = m_sheets[sheet].properties;
+    SheetSetProperty* pProperty = findProperty(properties, name);
+    if (pProperty != nullptr)
+    {
+        m_index.remove(sheet, name, pProperty->value.c_str());
+        pProperty->value = value;
+    }
+    else
+    {
+        const SheetSetProperty* pDefault = defaultOf(name);
+        if (pDefault != nullptr)
+            m_index.remove(sheet, name, pDefault->value.c_str());
+        SheetSetProperty property;
+        property.name = name;
+        property.value = value;
+        property.flags = SheetSetProperty::kSheetProperty;
+        properties.push_back(property);
+    }
+    m_index.add(sheet, name, value);
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus SheetSetFile::setProperty(const ACHAR* name, const ACHAR* value)
+{
+    if (name == nullptr || value == nullptr)
+        return Acad::eNullPtr;
+
+    SheetSetProperty* pProperty = findProperty(m_properties, name);
+    if (pProperty == nullptr)
+    {
+        SheetSetProperty property;
+        property.name = name;
+        property.value = value;
+        property.flags = SheetSetProperty::kSheetSetProperty;
+        m_properties.push_back(property);
+        return Acad::eOk;
+    }
+
+    if ((pProperty->flags & SheetSetProperty::kSheetProperty) != 0)
+    {
+        for (size_t i = 0; i < m_sheets.size(); ++i)
+        {
+            if (findProperty(m_sheets[i].properties, name) != nullptr)
+                continue;
+            m_index.remove(i, name, pProperty->value.c_str());
+            m_index.add(i, name, value);
+        }
+    }
+    pProperty->value = value;
+    return Acad::eOk;
+}
+
+const SheetSetProperty* SheetSetFile::defaultOf(const ACHAR* name) const
+{
+    for (const SheetSetProperty& property : m_properties)
+    {
+        if ((property.flags & SheetSetProperty::kSheetProperty) != 0 && sameName(property.name, name))
+            return &property;
+    }
+    return nullptr;
+}
+
+} // namespace acad_sheetset_to_pdf
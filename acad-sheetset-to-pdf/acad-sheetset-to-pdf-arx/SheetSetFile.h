@@ -0,0 +1,120 @@
+#pragma once
+
+#include "SheetSetPropertyIndex.h"
+
+#include <unordered_map>
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// A custom property of a sheet set or sheet, from an AcSmCustomPropertyBag.
+/// </summary>
+struct SheetSetProperty
+{
+    enum Flags
+    {
+        kSheetSetProperty = 1,      // belongs to the sheet set itself
+        kSheetProperty = 2          // every sheet has one; the sheet set's copy is the default
+    };
+
+    std::wstring  name;
+    std::wstring  value;
+    unsigned long flags = 0;
+};
+
+/// <summary>
+/// A sheet of a sheet set: its title and number, the layout it is drawn on
+/// and its custom properties, in the order the file lists them.
+/// </summary>
+struct SheetSetSheet
+{
+    std::wstring                  title;
+    std::wstring                  number;
+    std::wstring                  layout;
+    std::wstring                  drawing;    // the layout's drawing, resolved as the Sheet Set Manager does
+    std::vector<SheetSetProperty> properties;
+};
+
+/// <summary>
+/// Reads the sheets and custom properties of a sheet set data file (*.dst)
+/// without going through the Sheet Set Manager.
+///
+/// A DST file is an XML document whose bytes have been put through a fixed
+/// substitution table.  load() maps the file, undoes the substitution and
+/// picks the sheet set's name, its AcSmCustomPropertyBag and, for every
+/// AcSmSheet, the title, number, layout reference and property bag out of
+/// the XML in a single pass; everything else in the file is skipped.
+///
+/// The same pass indexes the sheets by their custom properties, a sheet
+/// that lacks a sheet property having the sheet set's default; see
+/// propertyIndex() and SheetSetFilter.  Any number of threads may read a
+/// loaded file as long as none of them sets a property.
+/// </summary>
+class SheetSetFile
+{
+public:
+    SheetSetFile();
+
+    SheetSetFile(const SheetSetFile&) = delete;
+    SheetSetFile& operator=(const SheetSetFile&) = delete;
+
+    /// <summary>
+    /// Reads the file at path, replacing whatever was loaded before.
+    /// Returns Acad::eUnsupportedFileFormat if it is not a sheet set.
+    /// </summary>
+    Acad::ErrorStatus load(const ACHAR* path);
+
+    const std::wstring& path() const { return m_path; }
+    const std::wstring& name() const { return m_name; }
+
+    /// <summary>
+    /// The sheet set's own property bag, holding both its properties and the
+    /// defaults of the sheet properties.
+    /// </summary>
+    const std::vector<SheetSetProperty>& properties() const { return m_properties; }
+
+    const std::vector<SheetSetSheet>& sheets() const { return m_sheets; }
+
+    /// <summary>
+    /// Finds the sheet drawn on layout of drawing, as a DSD entry names it.
+    /// Names are compared without regard to case or to the kind of slash.
+    /// If no sheet has that exact drawing path, the one sheet on that layout
+    /// whose drawing has the same file name is taken, which copes with a
+    /// sheet set that has been moved since the DSD was written.  Returns
+    /// null if there is no such sheet or more than one.
+    /// </summary>
+    const SheetSetSheet* findSheet(const ACHAR* drawing, const ACHAR* layout) const;
+
+    /// <summary>
+    /// Sets the property name of sheet to value, adding it to the sheet as
+    /// a sheet property if the sheet does not have it, and updates the
+    /// index.  Names are compared without regard to case.  The file on
+    /// disk is not changed.
+    /// </summary>
+    Acad::ErrorStatus setSheetProperty(size_t sheet, const ACHAR* name, const ACHAR* value);
+
+    /// <summary>
+    /// Sets the sheet set's own property name to value, adding it as a
+    /// sheet set property if it is new.  If it is a sheet property, the
+    /// sheets that go by the default are reindexed.
+    /// </summary>
+    Acad::ErrorStatus setProperty(const ACHAR* name, const ACHAR* value);
+
+    /// <summary>
+    /// The sheets by the values of their properties.
+    /// </summary>
+    const SheetSetPropertyIndex& propertyIndex() const { return m_index; }
+
+private:
+    const SheetSetProperty* defaultOf(const ACHAR* name) const;
+
+    std::wstring                                    m_path;
+    std::wstring                                    m_name;
+    std::vector<SheetSetProperty>                   m_properties;
+    std::vector<SheetSetSheet>                      m_sheets;
+    std::vector<std::wstring>                       m_drawingKeys;  // normalized drawing of each sheet
+    std::unordered_multimap<std::wstring, size_t>   m_byLayout;     // lower-case layout name to sheet
+    SheetSetPropertyIndex                           m_index;
+};
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,577 @@
+#include "stdafx.h"
+#include "SheetSetFilter.h"
+
+#include <cwchar>
+#include <cwctype>
+#include <new>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+/* Deeper nesting than this is taken for a mistake rather than recursed
+into. */
+const size_t kMaximumDepth = 256;
+
+enum TokenKind
+{
+    kEndToken,
+    kWordToken,
+    kQuotedToken,   // "...", '...' or [...]
+    kOpenToken,
+    kCloseToken,
+    kCommaToken,
+    kOperatorToken,
+    kBadToken
+};
+
+struct Token
+{
+    TokenKind    kind = kEndToken;
+    std::wstring text;
+    size_t       offset = 0;
+};
+
+bool isDelimiter(wchar_t c)
+{
+    return c == L'\0' || std::iswspace(c) || std::wcschr(L"()=<>!,\"'[]", c) != nullptr;
+}
+
+std::wstring foldCase(std::wstring text)
+{
+    for (wchar_t& c : text)
+        c = static_cast<wchar_t>(std::towlower(c));
+    return text;
+}
+
+bool sameWord(const std::wstring& word, const wchar_t* keyword)
+{
+    return foldCase(word) == keyword;
+}
+
+Token nextToken(const ACHAR* pText, size_t& position)
+{
+    while (pText[position] != L'\0' && std::iswspace(pText[position]))
+        ++position;
+
+    Token token;
+    token.offset = position;
+    const wchar_t c = pText[position];
+    if (c == L'\0')
+        return token;
+
+    if (c == L'(' || c == L')' || c == L',')
+    {
+        token.kind = c == L'(' ? kOpenToken : c == L')' ? kCloseToken : kCommaToken;
+        ++position;
+        return token;
+    }
+
+    if (c == L'=' || c == L'<' || c == L'>' || c == L'!')
+    {
+        token.kind = kOperatorToken;
+        token.text = c;
+        ++position;
+        const wchar_t next = pText[position];
+        if ((c != L'=' && next == L'=') || (c == L'<' && next == L'>') || (c == L'=' && next == L'='))
+            token.text += pText[position++];
+        if (token.text == L"!")
+            token.kind = kBadToken;
+        return token;
+    }
+
+    /* Quoted text doubles its quote to contain one. */
+    if (c == L'"' || c == L'\'' || c == L'[')
+    {
+        const wchar_t close = c == L'[' ? L']' : c;
+        token.kind = kQuotedToken;
+        ++position;
+        for (;;)
+        {
+            const wchar_t d = pText[position];
+            if (d == L'\0')
+            {
+                token.kind = kBadToken;
+                return token;
+            }
+            ++position;
+            if (d != close)
+            {
+                token.text += d;
+                continue;
+            }
+            if (pText[position] != close)
+                return token;
+            token.text += close;
+            ++position;
+        }
+    }
+
+    if (c == L']')
+    {
+        token.kind = kBadToken;
+        return token;
+    }
+
+    token.kind = kWordToken;
+    while (!isDelimiter(pText[position]))
+        token.text += pText[position++];
+    return token;
+}
+
+/* Matches * and ? against text, backtracking to the last * only. */
+bool wildcardMatch(const wchar_t* pPattern, const wchar_t* pText)
+{
+    const wchar_t* pStar = nullptr;
+    const wchar_t* pResume = nullptr;
+    while (*pText != L'\0')
+    {
+        if (*pPattern == L'*')
+        {
+            pStar = pPattern++;
+            pResume = pText;
+        }
+        else if (*pPattern == L'?' || *pPattern == *pText)
+        {
+            ++pPattern;
+            ++pText;
+        }
+        else if (pStar != nullptr)
+        {
+            pPattern = pStar + 1;
+            pText = ++pResume;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    while (*pPattern == L'*')
+        ++pPattern;
+    return *pPattern == L'\0';
+}
+
+bool parseNumber(const wchar_t* pText, double& number)
+{
+    if (*pText == L'\0' || std::iswspace(*pText))
+        return false;
+    wchar_t* pEnd = nullptr;
+    number = std::wcstod(pText, &pEnd);
+    return pEnd != pText && *pEnd == L'\0';
+}
+
+/* File names are compared as Windows compares them. */
+bool samePath(const wchar_t* pPath, const std::wstring& other)
+{
+    size_t i = 0;
+    for (; i < other.size() && pPath[i] != L'\0'; ++i)
+    {
+        wchar_t a = pPath[i] == L'/' ? L'\\' : pPath[i];
+        wchar_t b = other[i] == L'/' ? L'\\' : other[i];
+        if (std::towlower(a) != std::towlower(b))
+            return false;
+    }
+    return i == other.size() && pPath[i] == L'\0';
+}
+
+} // namespace
+
+/* Recursive descent over
+
+    expression := term { or term }
+    term       := factor { and factor }
+    factor     := not factor | ( expression ) | name comparison
+    comparison := operator value | [not] in ( value { , value } ) | [not] like value
+
+emitting the steps in postfix order. */
+class SheetSetFilterParser
+{
+public:
+    SheetSetFilterParser(const ACHAR* pText, std::vector<SheetSetFilter::Step>& steps)
+        : m_pText(pText)
+        , m_steps(steps)
+        , m_position(0)
+        , m_depth(0)
+        , m_errorOffset(0)
+    {
+        advance();
+    }
+
+    bool parse()
+    {
+        if (m_token.kind == kEndToken)
+            return true;
+        if (!expression())
+            return false;
+        return m_token.kind == kEndToken || fail();
+    }
+
+    size_t errorOffset() const { return m_errorOffset; }
+
+private:
+    void advance() { m_token = nextToken(m_pText, m_position); }
+    bool keyword(const wchar_t* pKeyword) const { return m_token.kind == kWordToken && sameWord(m_token.text, pKeyword); }
+    bool fail()
+    {
+        m_errorOffset = m_token.offset;
+        return false;
+    }
+
+    void emit(SheetSetFilter::Operation operation)
+    {
+        SheetSetFilter::Step step;
+        step.operation = operation;
+        step.negated = false;
+        step.numeric = false;
+        step.number = 0;
+        m_steps.push_back(step);
+    }
+
+    bool expression();
+    bool term();
+    bool factor();
+    bool comparison(const std::wstring& name);
+    bool value(std::wstring& text);
+
+    const ACHAR*                        m_pText;
+    std::vector<SheetSetFilter::Step>&  m_steps;
+    size_t                              m_position;
+    size_t                              m_depth;
+    size_t                              m_errorOffset;
+    Token                               m_token;
+};
+
+bool SheetSetFilterParser::expression()
+{
+    if (!term())
+        return false;
+    while (keyword(L"or"))
+    {
+        advance();
+        if (!term())
+            return false;
+        emit(SheetSetFilter::kOr);
+    }
+    return true;
+}
+
+bool SheetSetFilterParser::term()
+{
+    if (!factor())
+        return false;
+    while (keyword(L"and"))
+    {
+        advance();
+        if (!factor())
+            return false;
+        emit(SheetSetFilter::kAnd);
+    }
+    return true;
+}
+
+bool SheetSetFilterParser::factor()
+{
+    if (m_depth == kMaximumDepth)
+        return fail();
+    if (keyword(L"not"))
+    {
+        advance();
+        ++m_depth;
+        const bool parsed = factor();
+        --m_depth;
+        if (!parsed)
+            return false;
+        emit(SheetSetFilter::kNot);
+        return true;
+    }
+    if (m_token.kind == kOpenToken)
+    {
+        advance();
+        ++m_depth;
+        const bool parsed = expression();
+        --m_depth;
+        if (!parsed)
+            return false;
+        if (m_token.kind != kCloseToken)
+            return fail();
+        advance();
+        return true;
+    }
+
+    const bool isName = m_token.kind == kQuotedToken ||
+                        (m_token.kind == kWordToken && !keyword(L"and") && !keyword(L"or") && !keyword(L"in") && !keyword(L"like"));
+    if (!isName)
+        return fail();
+    const std::wstring name(m_token.text);
+    advance();
+    return comparison(name);
+}
+
+bool SheetSetFilterParser::comparison(const std::wstring& name)
+{
+    SheetSetFilter::Step step;
+    step.name = name;
+    step.negated = false;
+    step.numeric = false;
+    step.number = 0;
+
+    if (m_token.kind == kOperatorToken)
+    {
+        const std::wstring& text = m_token.text;
+        if (text == L"=" || text == L"==")
+            step.operation = SheetSetFilter::kEqual;
+        else if (text == L"<>" || text == L"!=")
+        {
+            step.operation = SheetSetFilter::kEqual;
+            step.negated = true;
+        }
+        else if (text == L"<")
+            step.operation = SheetSetFilter::kLess;
+        else if (text == L"<=")
+            step.operation = SheetSetFilter::kLessEqual;
+        else if (text == L">")
+            step.operation = SheetSetFilter::kGreater;
+        else
+            step.operation = SheetSetFilter::kGreaterEqual;
+        advance();
+        step.values.emplace_back();
+        if (!value(step.values.back()))
+            return false;
+        step.numeric = parseNumber(step.values.back().c_str(), step.number);
+        m_steps.push_back(step);
+        return true;
+    }
+
+    if (keyword(L"not"))
+    {
+        step.negated = true;
+        advance();
+        if (!keyword(L"in") && !keyword(L"like"))
+            return fail();
+    }
+    if (keyword(L"like"))
+    {
+        step.operation = SheetSetFilter::kLike;
+        advance();
+        step.values.emplace_back();
+        if (!value(step.values.back()))
+            return false;
+        m_steps.push_back(step);
+        return true;
+    }
+    if (!keyword(L"in"))
+        return fail();
+
+    step.operation = SheetSetFilter::kEqual;
+    advance();
+    if (m_token.kind != kOpenToken)
+        return fail();
+    advance();
+    for (;;)
+    {
+        step.values.emplace_back();
+        if (!value(step.values.back()))
+            return false;
+        if (m_token.kind == kCloseToken)
+            break;
+        if (m_token.kind != kCommaToken)
+            return fail();
+        advance();
+    }
+    advance();
+    m_steps.push_back(step);
+    return true;
+}
+
+bool SheetSetFilterParser::value(std::wstring& text)
+{
+    if (m_token.kind != kWordToken && m_token.kind != kQuotedToken)
+        return fail();
+    text = foldCase(m_token.text);
+    advance();
+    return true;
+}
+
+/* SheetSetFilter --- */
+
+SheetSetFilter::SheetSetFilter()
+{
+}
+
+Acad::ErrorStatus SheetSetFilter::parse(const ACHAR* expression, SheetSetFilter& filter, size_t* pErrorOffset)
+{
+    if (expression == nullptr)
+        return Acad::eNullPtr;
+    try
+    {
+        std::vector<Step> steps;
+        SheetSetFilterParser parser(expression, steps);
+        if (!parser.parse())
+        {
+            if (pErrorOffset != nullptr)
+                *pErrorOffset = parser.errorOffset();
+            return Acad::eInvalidInput;
+        }
+        filter.m_expression = expression;
+        filter.m_steps.swap(steps);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return Acad::eOutOfMemory;
+    }
+    return Acad::eOk;
+}
+
+bool SheetSetFilter::test(const Step& step, const ACHAR* value) const
+{
+    if (step.operation == kEqual)
+    {
+        for (const std::wstring& candidate : step.values)
+        {
+            if (candidate == value)
+                return true;
+        }
+        return false;
+    }
+    if (step.operation == kLike)
+        return wildcardMatch(step.values[0].c_str(), value);
+
+    int order = 0;
+    double number = 0;
+    if (step.numeric && parseNumber(value, number))
+        order = number < step.number ? -1 : number > step.number ? 1 : 0;
+    else
+        order = std::wcscmp(value, step.values[0].c_str());
+    switch (step.operation)
+    {
+    case kLess:
+        return order < 0;
+    case kLessEqual:
+        return order <= 0;
+    case kGreater:
+        return order > 0;
+    default:
+        return order >= 0;
+    }
+}
+
+void SheetSetFilter::select(const SheetSetFile& file, std::vector<size_t>& sheets) const
+{
+    sheets.clear();
+    const SheetSetPropertyIndex& index = file.propertyIndex();
+    const size_t sheetCount = std::min(index.sheetCount(), file.sheets().size());
+    if (m_steps.empty())
+    {
+        for (size_t i = 0; i < sheetCount; ++i)
+            sheets.push_back(i);
+        return;
+    }
+
+    /* Each step leaves a set of sheets on the stack, one bit per sheet. */
+    typedef std::vector<Adesk::UInt64> Bits;
+    const size_t wordCount = (sheetCount + 63) / 64;
+    const Adesk::UInt64 lastWordMask = sheetCount % 64 == 0 ? ~Adesk::UInt64(0) : (Adesk::UInt64(1) << (sheetCount % 64)) - 1;
+    std::vector<Bits> stack;
+    for (const Step& step : m_steps)
+    {
+        if (step.operation == kAnd || step.operation == kOr)
+        {
+            const Bits right = std::move(stack.back());
+            stack.pop_back();
+            Bits& left = stack.back();
+            for (size_t i = 0; i < wordCount; ++i)
+                left[i] = step.operation == kAnd ? left[i] & right[i] : left[i] | right[i];
+            continue;
+        }
+        if (step.operation == kNot)
+        {
+            Bits& bits = stack.back();
+            for (Adesk::UInt64& word : bits)
+                word = ~word;
+            if (wordCount != 0)
+                bits[wordCount - 1] &= lastWordMask;
+            continue;
+        }
+
+        stack.emplace_back(wordCount, 0);
+        Bits& bits = stack.back();
+        const Adesk::UInt32 name = index.findName(step.name.c_str());
+        if (name == SheetSetPropertyIndex::kNotFound)
+            continue;
+        auto mark = [&](Adesk::UInt32 value)
+        {
+            for (const Adesk::UInt32 sheet : index.sheets(name, value))
+            {
+                if (sheet < sheetCount)
+                    bits[sheet / 64] |= Adesk::UInt64(1) << (sheet % 64);
+            }
+        };
+        if (step.operation == kEqual && !step.negated)
+        {
+            for (const std::wstring& value : step.values)
+            {
+                const Adesk::UInt32 id = index.findValue(value.c_str());
+                if (id != SheetSetPropertyIndex::kNotFound)
+                    mark(id);
+            }
+            continue;
+        }
+        for (const Adesk::UInt32 value : index.values(name))
+        {
+            if (test(step, index.value(value)) != step.negated)
+                mark(value);
+        }
+    }
+
+    const Bits& bits = stack.back();
+    for (size_t word = 0; word < wordCount; ++word)
+    {
+        if (bits[word] == 0)
+            continue;
+        for (size_t bit = 0; bit < 64; ++bit)
+        {
+            if ((bits[word] >> bit) & 1)
+                sheets.push_back(word * 64 + bit);
+        }
+    }
+}
+
+Acad::ErrorStatus SheetSetFilter::appendDsdEntries(const SheetSetFile& file, const ACHAR* pageSetup,
+                                                   const ACHAR* pageSetupDrawing, AcPlDSDEntries& entries) const
+{
+    try
+    {
+        std::vector<size_t> selected;
+        select(file, selected);
+        for (const size_t index : selected)
+        {
+            const SheetSetSheet& sheet = file.sheets()[index];
+            if (sheet.layout.empty() || sheet.drawing.empty())
+                continue;
+
+            AcPlDSDEntry entry;
+            entry.setDwgName(sheet.drawing.c_str());
+            entry.setLayout(sheet.layout.c_str());
+            entry.setTitle(sheet.title.c_str());
+            if (pageSetup != nullptr && *pageSetup != L'\0')
+            {
+                const bool sameDrawing = pageSetupDrawing == nullptr || samePath(pageSetupDrawing, sheet.drawing);
+                entry.setNPS(pageSetup);
+                entry.setNPSSourceDWG(sameDrawing ? sheet.drawing.c_str() : pageSetupDrawing);
+                entry.setSetupType(sameDrawing ? AcPlDSDEntry::kNPSSameDWG : AcPlDSDEntry::kNPSOtherDWG);
+            }
+            else
+            {
+                entry.setSetupType(AcPlDSDEntry::kOriginalPS);
+            }
+            entries.append(entry);
+        }
+    }
+    catch (const std::bad_alloc&)
+    {
+        return Acad::eOutOfMemory;
+    }
+    return Acad::eOk;
+}
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "SheetSetFile.h"
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// Selects sheets of a sheet set by their custom properties, for
+/// publishing part of a set.
+///
+/// A filter is compiled from an expression such as
+///
+///     Discipline = A and (Revision >= 3 or Status in ("IFC", "For Tender"))
+///
+/// A comparison is a property name, one of =, <>, <, <=, >, >=,
+/// in (...) and like, and a value; "not in" and "not like" negate the last
+/// two.  Names and values with spaces or operator characters are quoted
+/// with " or ', or names bracketed as [Sheet Discipline].  like takes * and
+/// ? wildcards.  < and the like compare as numbers when both sides are
+/// numbers and as text otherwise.  Comparisons combine with and, or, not
+/// and parentheses; keywords and names are not case sensitive, and neither
+/// are values.  An empty expression selects every sheet.
+///
+/// A comparison only selects sheets that have the property, so
+/// "Revision <> 3" leaves out sheets with no revision while
+/// "not Revision = 3" takes them.
+///
+/// select() answers from the file's SheetSetPropertyIndex: equality and in
+/// look up the sheets of each value, the other comparisons test each
+/// distinct value of the property once, and the results combine as bit
+/// sets, so nothing is proportional to the number of properties in the set.
+/// </summary>
+class SheetSetFilter
+{
+public:
+    /// <summary>
+    /// A filter that selects every sheet.
+    /// </summary>
+    SheetSetFilter();
+
+    /// <summary>
+    /// Compiles expression into filter.  Returns Acad::eInvalidInput if it
+    /// does not parse, with the offset of the offending character in
+    /// pErrorOffset if that is not null.
+    /// </summary>
+    static Acad::ErrorStatus parse(const ACHAR* expression, SheetSetFilter& filter, size_t* pErrorOffset = nullptr);
+
+    const std::wstring& expression() const { return m_expression; }
+
+    /// <summary>
+    /// Replaces sheets with the indices into file.sheets() of the sheets
+    /// the filter selects, in sheet set order.
+    /// </summary>
+    void select(const SheetSetFile& file, std::vector<size_t>& sheets) const;
+
+    /// <summary>
+    /// Appends a DSD entry for every sheet the filter selects, in sheet set
+    /// order, for AcPlDSDData::setDSDEntries.  With a pageSetup, the sheets
+    /// are published with that named page setup from pageSetupDrawing, or
+    /// from their own drawing if it is null; without one, with the layout's
+    /// own.  Sheets without a layout reference are left out.
+    /// </summary>
+    Acad::ErrorStatus appendDsdEntries(const SheetSetFile& file, const ACHAR* pageSetup, const ACHAR* pageSetupDrawing,
+                                       AcPlDSDEntries& entries) const;
+
+private:
+    enum Operation
+    {
+        kSelectAll,
+        kEqual,         // also in (...)
+        kLess,
+        kLessEqual,
+        kGreater,
+        kGreaterEqual,
+        kLike,
+        kAnd,
+        kOr,
+        kNot
+    };
+
+    /* One step of the filter, which runs as a stack machine. */
+    struct Step
+    {
+        Operation                 operation;
+        bool                      negated;    // <>, not in, not like
+        std::wstring              name;
+        std::vector<std::wstring> values;     // lower-cased
+        bool                      numeric;    // values[0] is a number
+        double                    number;
+    };
+
+    bool test(const Step& step, const ACHAR* value) const;
+
+    friend class SheetSetFilterParser;
+
+    std::wstring      m_expression;
+    std::vector<Step> m_steps;  // postfix
+};
+
+} // namespace acad_sheetset_to_pdf
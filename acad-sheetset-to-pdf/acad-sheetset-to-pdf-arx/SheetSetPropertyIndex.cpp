@@ -0,0 +1,105 @@
+#include "stdafx.h"
+#include "SheetSetPropertyIndex.h"
+
+#include <cwctype>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+const std::vector<Adesk::UInt32> kNoSheets;
+
+std::wstring foldCase(const ACHAR* pText)
+{
+    std::wstring key(pText != nullptr ? pText : L"");
+    for (wchar_t& c : key)
+        c = static_cast<wchar_t>(std::towlower(c));
+    return key;
+}
+
+Adesk::UInt64 postingKey(Adesk::UInt32 name, Adesk::UInt32 value)
+{
+    return (Adesk::UInt64(name) << 32) | value;
+}
+
+} // namespace
+
+SheetSetPropertyIndex::SheetSetPropertyIndex()
+    : m_sheetCount(0)
+{
+}
+
+void SheetSetPropertyIndex::reset(size_t sheetCount)
+{
+    m_sheetCount = sheetCount;
+    m_names.clear();
+    m_values.clear();
+    m_valuesByName.clear();
+    m_sheets.clear();
+}
+
+void SheetSetPropertyIndex::add(size_t sheet, const ACHAR* name, const ACHAR* value)
+{
+    const std::wstring nameKey(foldCase(name));
+    const std::wstring valueKey(foldCase(value));
+    const Adesk::UInt32 nameId = m_names.intern(nameKey.c_str(), nameKey.size());
+    if (nameId == m_valuesByName.size())
+        m_valuesByName.emplace_back();
+    const Adesk::UInt32 valueId = m_values.intern(valueKey.c_str(), valueKey.size());
+
+    auto found = m_sheets.find(postingKey(nameId, valueId));
+    if (found == m_sheets.end())
+    {
+        found = m_sheets.emplace(postingKey(nameId, valueId), std::vector<Adesk::UInt32>()).first;
+        m_valuesByName[nameId].push_back(valueId);
+    }
+
+    /* Loading adds the sheets in order, so this is an append but for
+    properties set afterwards. */
+    std::vector<Adesk::UInt32>& sheets = found->second;
+    const Adesk::UInt32 entry = static_cast<Adesk::UInt32>(sheet);
+    if (sheets.empty() || sheets.back() < entry)
+    {
+        sheets.push_back(entry);
+        return;
+    }
+    const auto position = std::lower_bound(sheets.begin(), sheets.end(), entry);
+    if (*position != entry)
+        sheets.insert(position, entry);
+}
+
+void SheetSetPropertyIndex::remove(size_t sheet, const ACHAR* name, const ACHAR* value)
+{
+    const Adesk::UInt32 nameId = findName(name);
+    const Adesk::UInt32 valueId = findValue(value);
+    if (nameId == kNotFound || valueId == kNotFound)
+        return;
+    const auto found = m_sheets.find(postingKey(nameId, valueId));
+    if (found == m_sheets.end())
+        return;
+    std::vector<Adesk::UInt32>& sheets = found->second;
+    const Adesk::UInt32 entry = static_cast<Adesk::UInt32>(sheet);
+    const auto position = std::lower_bound(sheets.begin(), sheets.end(), entry);
+    if (position != sheets.end() && *position == entry)
+        sheets.erase(position);
+}
+
+Adesk::UInt32 SheetSetPropertyIndex::findName(const ACHAR* name) const
+{
+    const std::wstring key(foldCase(name));
+    return m_names.find(key.c_str(), key.size());
+}
+
+Adesk::UInt32 SheetSetPropertyIndex::findValue(const ACHAR* value) const
+{
+    const std::wstring key(foldCase(value));
+    return m_values.find(key.c_str(), key.size());
+}
+
+const std::vector<Adesk::UInt32>& SheetSetPropertyIndex::sheets(Adesk::UInt32 name, Adesk::UInt32 value) const
+{
+    const auto found = m_sheets.find(postingKey(name, value));
+    return found != m_sheets.end() ? found->second : kNoSheets;
+}
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "StringPool.h"
+
+#include <unordered_map>
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// An inverted index over the custom properties of the sheets of a sheet
+/// set: for every property name and value, the sheets that have it, in
+/// sheet order.
+///
+/// Names and values are compared without regard to case, and value()
+/// returns them lower-cased.  SheetSetFile builds the index while it loads
+/// a file and keeps it up to date as properties are set; SheetSetFilter
+/// answers its queries from it.  Values that no sheet has any more stay in
+/// values() with no sheets.
+/// </summary>
+class SheetSetPropertyIndex
+{
+public:
+    static const Adesk::UInt32 kNotFound = StringPool::kNotFound;
+
+    SheetSetPropertyIndex();
+
+    /// <summary>
+    /// Empties the index for a sheet set of sheetCount sheets.
+    /// </summary>
+    void reset(size_t sheetCount);
+
+    /// <summary>
+    /// Records that sheet has value for the property name, or that it no
+    /// longer has.
+    /// </summary>
+    void add(size_t sheet, const ACHAR* name, const ACHAR* value);
+    void remove(size_t sheet, const ACHAR* name, const ACHAR* value);
+
+    size_t sheetCount() const { return m_sheetCount; }
+
+    /// <summary>
+    /// Id of a property name or value, or kNotFound if no sheet has ever
+    /// had it.
+    /// </summary>
+    Adesk::UInt32 findName(const ACHAR* name) const;
+    Adesk::UInt32 findValue(const ACHAR* value) const;
+
+    /// <summary>
+    /// The values the property name has been seen with.
+    /// </summary>
+    const std::vector<Adesk::UInt32>& values(Adesk::UInt32 name) const { return m_valuesByName[name]; }
+    const ACHAR* value(Adesk::UInt32 value) const { return m_values.string(value); }
+
+    /// <summary>
+    /// The sheets whose property name has value, in ascending order.
+    /// </summary>
+    const std::vector<Adesk::UInt32>& sheets(Adesk::UInt32 name, Adesk::UInt32 value) const;
+
+private:
+    size_t                                                          m_sheetCount;
+    StringPool                                                      m_names;
+    StringPool                                                      m_values;
+    std::vector<std::vector<Adesk::UInt32>>                         m_valuesByName;
+    std::unordered_map<Adesk::UInt64, std::vector<Adesk::UInt32>>   m_sheets;   // name << 32 | value to sheets
+};
+
+} // namespace acad_sheetset_to_pdf
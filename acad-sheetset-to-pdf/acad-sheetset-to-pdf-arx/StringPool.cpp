@@ -0,0 +1,113 @@
+#include "stdafx.h"
+#include "StringPool.h"
+
+namespace acad_sheetset_to_pdf {
+
+StringPool::StringPool()
+{
+    clear();
+}
+
+void StringPool::clear()
+{
+    m_chars.clear();
+    m_offsets.assign(1, 0);
+    m_hashes.clear();
+    m_slots.clear();
+}
+
+/* fnv1a64 goes a byte at a time, which for the short strings a pool holds
+costs more than the rest of a lookup.  This takes eight bytes per multiply
+and folds the high half of the product back after each, so that every byte
+reaches the low bits the table is indexed with. */
+Adesk::UInt32 StringPool::hash(const ACHAR* text, size_t length)
+{
+    const Adesk::UInt8* pBytes = reinterpret_cast<const Adesk::UInt8*>(text);
+    const size_t size = length * sizeof(ACHAR);
+    Adesk::UInt64 hash = 14695981039346656037ull ^ size;
+    size_t offset = 0;
+    for (; offset + sizeof(Adesk::UInt64) <= size; offset += sizeof(Adesk::UInt64))
+    {
+        Adesk::UInt64 chunk;
+        std::memcpy(&chunk, pBytes + offset, sizeof(chunk));
+        hash = (hash ^ chunk) * 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 32;
+    }
+    if (offset < size)
+    {
+        Adesk::UInt64 chunk = 0;
+        std::memcpy(&chunk, pBytes + offset, size - offset);
+        hash = (hash ^ chunk) * 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 32;
+    }
+    return static_cast<Adesk::UInt32>(hash);
+}
+
+Adesk::UInt32 StringPool::find(const ACHAR* text, size_t length) const
+{
+    if (m_slots.empty())
+        return kNotFound;
+    if (text == nullptr)
+    {
+        text = L"";
+        length = 0;
+    }
+    const Adesk::UInt32 textHash = hash(text, length);
+    const size_t mask = m_slots.size() - 1;
+    for (size_t slot = textHash & mask; m_slots[slot] != 0; slot = (slot + 1) & mask)
+    {
+        const Adesk::UInt32 id = m_slots[slot] - 1;
+        if (m_hashes[id] == textHash && this->length(id) == length
+            && std::wmemcmp(string(id), text, length) == 0)
+            return id;
+    }
+    return kNotFound;
+}
+
+Adesk::UInt32 StringPool::intern(const ACHAR* text, size_t length)
+{
+    if (text == nullptr)
+    {
+        text = L"";
+        length = 0;
+    }
+
+    /* Keep the table at most half full, so that probe sequences stay short
+    for the misses that make up most of the lookups of a fresh pool. */
+    if ((size() + 1) * 2 > m_slots.size())
+        rehash(std::max<size_t>(m_slots.size() * 2, 64));
+
+    const Adesk::UInt32 textHash = hash(text, length);
+    const size_t mask = m_slots.size() - 1;
+    size_t slot = textHash & mask;
+    for (; m_slots[slot] != 0; slot = (slot + 1) & mask)
+    {
+        const Adesk::UInt32 id = m_slots[slot] - 1;
+        if (m_hashes[id] == textHash && this->length(id) == length
+            && std::wmemcmp(string(id), text, length) == 0)
+            return id;
+    }
+
+    const Adesk::UInt32 id = static_cast<Adesk::UInt32>(size());
+    m_chars.insert(m_chars.end(), text, text + length);
+    m_chars.push_back(L'\0');
+    m_offsets.push_back(static_cast<Adesk::UInt32>(m_chars.size()));
+    m_hashes.push_back(textHash);
+    m_slots[slot] = id + 1;
+    return id;
+}
+
+void StringPool::rehash(size_t slotCount)
+{
+    m_slots.assign(slotCount, 0);
+    const size_t mask = slotCount - 1;
+    for (Adesk::UInt32 id = 0; id < m_hashes.size(); ++id)
+    {
+        size_t slot = m_hashes[id] & mask;
+        while (m_slots[slot] != 0)
+            slot = (slot + 1) & mask;
+        m_slots[slot] = id + 1;
+    }
+}
+
+} // namespace acad_sheetset_to_pdf
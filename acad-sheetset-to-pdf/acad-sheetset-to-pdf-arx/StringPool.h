@@ -0,0 +1,55 @@
+#pragma once
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// Interns strings: hands out one id per distinct string, numbered in the
+/// order the strings are first seen, and keeps every string once, NUL
+/// terminated, in a single block of characters.
+///
+/// Interning a string the pool already has allocates nothing, which is what
+/// makes it worth putting in front of columns of repetitive text such as
+/// property categories and names.  Pointers returned by string() stay valid
+/// only until the next intern().  A pool is not thread safe; give each
+/// thread its own and combine them afterwards.
+/// </summary>
+class StringPool
+{
+public:
+    static const Adesk::UInt32 kNotFound = 0xFFFFFFFFu;
+
+    StringPool();
+
+    /// <summary>
+    /// Id of the length characters at text, adding them if they are new.
+    /// </summary>
+    Adesk::UInt32 intern(const ACHAR* text, size_t length);
+    Adesk::UInt32 intern(const ACHAR* text) { return intern(text, text != nullptr ? std::wcslen(text) : 0); }
+
+    /// <summary>
+    /// Id of the length characters at text, or kNotFound.
+    /// </summary>
+    Adesk::UInt32 find(const ACHAR* text, size_t length) const;
+
+    size_t size() const { return m_offsets.size() - 1; }
+    const ACHAR* string(Adesk::UInt32 id) const { return m_chars.data() + m_offsets[id]; }
+    size_t length(Adesk::UInt32 id) const { return m_offsets[id + 1] - m_offsets[id] - 1; }
+
+    /// <summary>
+    /// Characters held, terminators included.
+    /// </summary>
+    size_t characterCount() const { return m_chars.size(); }
+
+    void clear();
+
+private:
+    static Adesk::UInt32 hash(const ACHAR* text, size_t length);
+    void rehash(size_t slotCount);
+
+    std::vector<ACHAR>          m_chars;
+    std::vector<Adesk::UInt32>  m_offsets;  // start of each string in m_chars, plus the end
+    std::vector<Adesk::UInt32>  m_hashes;   // of each string
+    std::vector<Adesk::UInt32>  m_slots;    // open addressing, id + 1, 0 for empty
+};
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,182 @@
+#include "stdafx.h"
+#include "StubPlotBackend.h"
+#include "MappedFile.h"
+
+#include <chrono>
+#include <thread>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+/* The progress object handed to beginPlot.  It shows nothing and only
+remembers what it is told, so that reactors polling it see the cancel status
+of the sheet being played. */
+class StubPlotProgress : public AcPlPlotProgress
+{
+public:
+    bool isPlotCancelled() const override { return m_plotStatus != kPlotContinue; }
+    void setPlotCancelStatus(PlotCancelStatus status) override { m_plotStatus = status; }
+    PlotCancelStatus plotCancelStatus() const override { return m_plotStatus; }
+    void setPlotProgressRange(int nLower, int nUpper) override { m_plotLower = nLower; m_plotUpper = nUpper; }
+    void getPlotProgressRange(int& nLower, int& nUpper) const override { nLower = m_plotLower; nUpper = m_plotUpper; }
+    void setPlotProgressPos(int nPos) override { m_plotPos = nPos; }
+    int plotProgressPos() const override { return m_plotPos; }
+
+    bool isSheetCancelled() const override { return m_sheetStatus != kSheetContinue; }
+    void setSheetCancelStatus(SheetCancelStatus status) override { m_sheetStatus = status; }
+    SheetCancelStatus sheetCancelStatus() const override { return m_sheetStatus; }
+    void setSheetProgressRange(int nLower, int nUpper) override { m_sheetLower = nLower; m_sheetUpper = nUpper; }
+    void getSheetProgressRange(int& nLower, int& nUpper) const override { nLower = m_sheetLower; nUpper = m_sheetUpper; }
+    void setSheetProgressPos(int nPos) override { m_sheetPos = nPos; }
+    int sheetProgressPos() const override { return m_sheetPos; }
+
+    bool setIsVisible(bool /*bVisible*/) override { return false; }
+    bool isVisible() const override { return false; }
+    bool setStatusMsgString(const ACHAR* pMsg) override
+    {
+        m_status = pMsg != nullptr ? pMsg : ACRX_T("");
+        return true;
+    }
+    bool getStatusMsgString(AcString& sMsg) const override
+    {
+        sMsg = m_status;
+        return true;
+    }
+    void heartbeat() override {}
+
+private:
+    PlotCancelStatus  m_plotStatus = kPlotContinue;
+    SheetCancelStatus m_sheetStatus = kSheetContinue;
+    int               m_plotLower = 0, m_plotUpper = 100, m_plotPos = 0;
+    int               m_sheetLower = 0, m_sheetUpper = 100, m_sheetPos = 0;
+    AcString          m_status;
+};
+
+/* The output file of a stub plot, written as pages end. */
+class StubOutputFile
+{
+public:
+    StubOutputFile() : m_hFile(INVALID_HANDLE_VALUE) {}
+    ~StubOutputFile() { close(); }
+
+    Acad::ErrorStatus create(const ACHAR* path)
+    {
+        m_hFile = ::CreateFileW(path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        return m_hFile != INVALID_HANDLE_VALUE ? Acad::eOk : MappedFile::statusFromWin32(::GetLastError());
+    }
+
+    void write(const char* pData, size_t size)
+    {
+        DWORD written = 0;
+        if (m_hFile != INVALID_HANDLE_VALUE && size != 0)
+            ::WriteFile(m_hFile, pData, static_cast<DWORD>(size), &written, nullptr);
+    }
+
+    void close()
+    {
+        if (m_hFile != INVALID_HANDLE_VALUE)
+        {
+            ::CloseHandle(m_hFile);
+            m_hFile = INVALID_HANDLE_VALUE;
+        }
+    }
+
+private:
+    HANDLE m_hFile;
+};
+
+void pause(unsigned milliseconds)
+{
+    if (milliseconds != 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+}
+
+} // namespace
+
+StubPlotBackend::StubPlotBackend()
+    : m_pagesUntilFault(0)
+{
+}
+
+void StubPlotBackend::addReactor(AcPlPlotReactor* pReactor)
+{
+    if (pReactor != nullptr && std::find(m_reactors.begin(), m_reactors.end(), pReactor) == m_reactors.end())
+        m_reactors.push_back(pReactor);
+}
+
+void StubPlotBackend::removeReactor(AcPlPlotReactor* pReactor)
+{
+    m_reactors.erase(std::remove(m_reactors.begin(), m_reactors.end(), pReactor), m_reactors.end());
+}
+
+Acad::ErrorStatus StubPlotBackend::plot(const ACHAR* documentName, const std::vector<StubPlotSheet>& sheets,
+                                        const ACHAR* fileName, AcPlPlotReactor::PlotType type)
+{
+    StubPlotProgress progress;
+    progress.setPlotProgressRange(0, int(sheets.size()));
+    AcPlPlotInfo plotInfo;
+    StubOutputFile output;
+    if (fileName != nullptr)
+    {
+        const Acad::ErrorStatus es = output.create(fileName);
+        if (es != Acad::eOk)
+            return es;
+    }
+
+    for (AcPlPlotReactor* pReactor : m_reactors)
+        pReactor->beginPlot(&progress, type);
+    for (AcPlPlotReactor* pReactor : m_reactors)
+        pReactor->beginDocument(plotInfo, documentName, 1, fileName != nullptr, fileName);
+
+    for (size_t i = 0; i < sheets.size() && !progress.isPlotCancelled(); ++i)
+    {
+        const StubPlotSheet& sheet = sheets[i];
+        progress.setSheetCancelStatus(AcPlPlotProgress::kSheetContinue);
+        progress.setSheetProgressPos(0);
+        plotInfo.OrgFilePath() = sheet.drawing;
+        pause(sheet.setupMilliseconds);
+
+        AcPlPlotPageInfo pageInfo;
+        for (AcPlPlotReactor* pReactor : m_reactors)
+            pReactor->beginPage(pageInfo, plotInfo, i + 1 == sheets.size());
+        if (m_pagesUntilFault != 0 && --m_pagesUntilFault == 0)
+        {
+            output.write(sheet.content.data(), sheet.content.size() / 2);
+            return Acad::eInvalidEngineState;
+        }
+        pause(sheet.plotMilliseconds);
+
+        if (sheet.status != AcPlPlotProgress::kSheetContinue)
+        {
+            progress.setSheetCancelStatus(sheet.status);
+            for (AcPlPlotReactor* pReactor : m_reactors)
+                pReactor->pageCancelled();
+        }
+        else
+        {
+            output.write(sheet.content.data(), sheet.content.size());
+            progress.setSheetProgressPos(100);
+        }
+        for (AcPlPlotReactor* pReactor : m_reactors)
+            pReactor->endPage(sheet.status);
+        progress.setPlotProgressPos(int(i + 1));
+
+        if (sheet.status == AcPlPlotProgress::kSheetCanceledByCancelAllButton)
+        {
+            progress.setPlotCancelStatus(AcPlPlotProgress::kPlotCanceledByCancelAllButton);
+            for (AcPlPlotReactor* pReactor : m_reactors)
+                pReactor->plotCancelled();
+        }
+    }
+
+    output.close();
+    const AcPlPlotProgress::PlotCancelStatus status = progress.plotCancelStatus();
+    for (AcPlPlotReactor* pReactor : m_reactors)
+        pReactor->endDocument(status);
+    for (AcPlPlotReactor* pReactor : m_reactors)
+        pReactor->endPlot(status);
+    return status == AcPlPlotProgress::kPlotContinue ? Acad::eOk : Acad::eUserBreak;
+}
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,79 @@
+#pragma once
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// One sheet of a job run through StubPlotBackend.
+/// </summary>
+struct StubPlotSheet
+{
+    /// <summary>
+    /// Reported to reactors through AcPlPlotInfo::OrgFilePath, like the
+    /// drawing a published sheet comes from.
+    /// </summary>
+    AcString drawing;
+
+    /// <summary>
+    /// Time spent before beginPage (loading and regenerating the layout) and
+    /// between beginPage and endPage (generating the page).
+    /// </summary>
+    unsigned setupMilliseconds = 0;
+    unsigned plotMilliseconds = 0;
+
+    /// <summary>
+    /// How the sheet ends.  kSheetCanceledByCancelButton skips the sheet as
+    /// the Cancel Sheet button of the progress dialog would, and
+    /// kSheetCanceledByCancelAllButton also abandons the rest of the job.
+    /// </summary>
+    AcPlPlotProgress::SheetCancelStatus status = AcPlPlotProgress::kSheetContinue;
+
+    /// <summary>
+    /// Bytes the sheet adds to the output file when plotting to a file.
+    /// </summary>
+    std::string content;
+};
+
+/// <summary>
+/// Plays a plot job to AcPlPlotReactor objects without AutoCAD's plot
+/// engine: sends the notifications in the order and with the cancel statuses
+/// the engine uses for a multi-sheet document, sleeping for the configured
+/// times in between.  Lets reactors such as PlotTelemetry, and whatever reads
+/// their output, be exercised without plotting anything.
+///
+/// Reactors receive default AcPlPlotPageInfo objects and an AcPlPlotInfo
+/// without a layout, so anything they would read from the database is
+/// missing.
+///
+/// injectFault() makes the backend die part way through a job, the way a
+/// crashed or killed AutoCAD would, to exercise recovery.
+/// </summary>
+class StubPlotBackend
+{
+public:
+    StubPlotBackend();
+
+    void addReactor(AcPlPlotReactor* pReactor);
+    void removeReactor(AcPlPlotReactor* pReactor);
+
+    /// <summary>
+    /// Plots sheets as one document, writing their content to fileName if it
+    /// is not null.  Returns Acad::eUserBreak if a sheet cancelled the whole
+    /// job, and Acad::eInvalidEngineState if an injected fault killed it.
+    /// </summary>
+    Acad::ErrorStatus plot(const ACHAR* documentName, const std::vector<StubPlotSheet>& sheets,
+                           const ACHAR* fileName = nullptr,
+                           AcPlPlotReactor::PlotType type = AcPlPlotReactor::kPlot);
+
+    /// <summary>
+    /// Kills the job in progress when the pageCount-th page from now has
+    /// begun: the page never ends, reactors hear nothing more, and the
+    /// output file is left with half of that page's content.  0 disarms.
+    /// </summary>
+    void injectFault(unsigned pageCount) { m_pagesUntilFault = pageCount; }
+
+private:
+    std::vector<AcPlPlotReactor*> m_reactors;
+    unsigned                      m_pagesUntilFault;
+};
+
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,189 @@
+#include "stdafx.h"
+#include "TextControlCodes.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace acad_sheetset_to_pdf {
+
+namespace {
+
+/* Text generation flags of TextParams, as for AcDbText. */
+const short kBackward = 2;
+const short kUpsideDown = 4;
+
+const int kScoreCount = 3;
+const double kScoreHeights[kScoreCount] = {1.2, -0.2, 0.5};    // over, under, strikethrough
+const int kPointsPerCall = 64;
+
+bool isDigit(wchar_t c)
+{
+    return c >= L'0' && c <= L'9';
+}
+
+struct SingleSegments
+{
+    LineSegmentCallback pLineSegment;
+    const void*         pAction;
+};
+
+void drawEachSegment(const AcGePoint3d* pPoints, int segmentCount, const void* pAction)
+{
+    const SingleSegments& single = *static_cast<const SingleSegments*>(pAction);
+    for (int i = 0; i < segmentCount; ++i)
+        single.pLineSegment(pPoints[2 * i], pPoints[2 * i + 1], single.pAction);
+}
+
+} // namespace
+
+Acad::ErrorStatus TextControlCodes::expand(const wchar_t* pString, int length, unsigned flags, TextControlBuffer& buffer)
+{
+    buffer.textLength = 0;
+    buffer.runCount = 0;
+    buffer.segmentCount = 0;
+    if (pString == nullptr || buffer.pText == nullptr)
+        return Acad::eInvalidInput;
+    if (length < 0)
+        length = static_cast<int>(std::wcslen(pString));
+
+    /* Every code is at least as long as what it expands to, so the text
+    is never written ahead of where it is read and may be expanded in
+    place.  Runs and segments past the capacities are counted but not
+    written. */
+    wchar_t* const pText = buffer.pText;
+    int out = 0;
+    unsigned scores = 0;
+    int runBegin = 0;
+    int segmentBegin[kScoreCount] = {0, 0, 0};
+
+    auto endRun = [&]()
+    {
+        if (out == runBegin)
+            return;
+        if (buffer.runCount < buffer.runCapacity)
+            buffer.pRuns[buffer.runCount] = TextRun{runBegin, out, scores};
+        ++buffer.runCount;
+        runBegin = out;
+    };
+    auto endSegment = [&](int score)
+    {
+        if (out == segmentBegin[score])
+            return;
+        if (buffer.segmentCount < buffer.segmentCapacity)
+            buffer.pSegments[buffer.segmentCount] = ScoreSegment{1u << score, segmentBegin[score], out};
+        ++buffer.segmentCount;
+    };
+
+    int i = 0;
+    while (i < length)
+    {
+        const wchar_t c = pString[i];
+        if (c != L'%' || i + 2 >= length || pString[i + 1] != L'%')
+        {
+            pText[out++] = c;
+            ++i;
+            continue;
+        }
+
+        const wchar_t code = pString[i + 2];
+        int score = -1;
+        switch (code)
+        {
+        case L'o': case L'O': score = 0; break;
+        case L'u': case L'U': score = 1; break;
+        case L'k': case L'K': score = 2; break;
+        case L'd': case L'D': pText[out++] = UC_DEGREE_SYMBOL; break;
+        case L'p': case L'P': pText[out++] = UC_PLUSMINUS_SYMBOL; break;
+        case L'c': case L'C':
+            pText[out++] = (flags & kPhiForDiameter) != 0 ? UC_PHI_SYMBOL : UC_DIAMETER_SYMBOL;
+            break;
+        case L'%': pText[out++] = L'%'; break;
+        default:
+            if (i + 4 < length && isDigit(code) && isDigit(pString[i + 3]) && isDigit(pString[i + 4]))
+            {
+                pText[out++] = static_cast<wchar_t>((code - L'0') * 100 + (pString[i + 3] - L'0') * 10 + (pString[i + 4] - L'0'));
+                i += 5;
+            }
+            else
+            {
+                /* Not a code: the two percent signs stay, and whatever
+                follows is read as ordinary text. */
+                pText[out++] = L'%';
+                pText[out++] = L'%';
+                i += 2;
+            }
+            continue;
+        }
+        i += 3;
+
+        if (score >= 0)
+        {
+            endRun();
+            const unsigned bit = 1u << score;
+            if ((scores & bit) != 0)
+                endSegment(score);
+            else
+                segmentBegin[score] = out;
+            scores ^= bit;
+        }
+    }
+
+    endRun();
+    for (int score = 0; score < kScoreCount; ++score)
+    {
+        if ((scores & (1u << score)) != 0)
+            endSegment(score);
+    }
+    buffer.textLength = out;
+    return buffer.runCount <= buffer.runCapacity && buffer.segmentCount <= buffer.segmentCapacity
+        ? Acad::eOk : Acad::eBufferTooSmall;
+}
+
+void TextControlCodes::drawScores(const TextControlBuffer& buffer, const double* pPen, const TextParams& params,
+                                  LineSegmentsCallback pLineSegments, const void* pAction)
+{
+    if (!params.visible || pLineSegments == nullptr || buffer.segmentCount == 0)
+        return;
+
+    const double shear = std::tan(params.oblique_angle);
+    const double cosine = std::cos(params.rotation_angle);
+    const double sine = std::sin(params.rotation_angle);
+    const double xSign = (params.flags & kBackward) != 0 ? -1.0 : 1.0;
+    const double ySign = (params.flags & kUpsideDown) != 0 ? -1.0 : 1.0;
+    auto place = [&](double x, double y)
+    {
+        x = xSign * (x + y * shear);
+        y = ySign * y;
+        return AcGePoint3d(x * cosine - y * sine, x * sine + y * cosine, 0.0);
+    };
+
+    AcGePoint3d points[kPointsPerCall];
+    int pointCount = 0;
+    const int segmentCount = std::min(buffer.segmentCount, buffer.segmentCapacity);
+    for (int i = 0; i < segmentCount; ++i)
+    {
+        const ScoreSegment& segment = buffer.pSegments[i];
+        const int score = segment.score == kOverline ? 0 : segment.score == kUnderline ? 1 : 2;
+        const double y = kScoreHeights[score] * params.height;
+        points[pointCount++] = place(pPen[segment.begin], y);
+        points[pointCount++] = place(pPen[segment.end], y);
+        if (pointCount == kPointsPerCall)
+        {
+            pLineSegments(points, pointCount / 2, pAction);
+            pointCount = 0;
+        }
+    }
+    if (pointCount != 0)
+        pLineSegments(points, pointCount / 2, pAction);
+}
+
+void TextControlCodes::drawScores(const TextControlBuffer& buffer, const double* pPen, const TextParams& params,
+                                  LineSegmentCallback pLineSegment, const void* pAction)
+{
+    if (pLineSegment == nullptr)
+        return;
+    const SingleSegments single = {pLineSegment, pAction};
+    drawScores(buffer, pPen, params, drawEachSegment, &single);
+}
+
+} // namespace acad_sheetset_to_pdf
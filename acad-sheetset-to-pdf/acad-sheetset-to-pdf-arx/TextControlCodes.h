@@ -0,0 +1,115 @@
+#pragma once
+
+#include "truetypetext.h"
+
+namespace acad_sheetset_to_pdf {
+
+/// <summary>
+/// A run of expanded text, [begin, end), drawn with the same scores.
+/// </summary>
+struct TextRun
+{
+    int         begin;
+    int         end;
+    unsigned    scores;     // TextControlCodes::Score bits
+};
+
+/// <summary>
+/// Characters of expanded text, [begin, end), under one over, under or
+/// strikethrough score.
+/// </summary>
+struct ScoreSegment
+{
+    unsigned    score;      // one TextControlCodes::Score
+    int         begin;
+    int         end;
+};
+
+/// <summary>
+/// Where TextControlCodes::expand puts its results.  The caller owns every
+/// buffer, so expanding allocates nothing; the capacities that are always
+/// enough for a string of a given length come from TextControlCodes.
+/// </summary>
+struct TextControlBuffer
+{
+    wchar_t*        pText = nullptr;        // as long as the string, which it may be
+    TextRun*        pRuns = nullptr;
+    int             runCapacity = 0;
+    ScoreSegment*   pSegments = nullptr;
+    int             segmentCapacity = 0;
+
+    int             textLength = 0;         // set by expand
+    int             runCount = 0;
+    int             segmentCount = 0;
+};
+
+/// <summary>
+/// Called with segmentCount line segments, as pairs of points, from
+/// TextControlCodes::drawScores.
+/// </summary>
+typedef void (*LineSegmentsCallback)(const AcGePoint3d* pPoints, int segmentCount, const void* pAction);
+
+/// <summary>
+/// The %% control codes of single-line text, in one pass.
+///
+/// expand() replaces %%d, %%p and %%c with the degree, plus/minus and
+/// diameter symbols, %%% with a percent sign and %%nnn with the character
+/// of decimal code nnn, and removes %%o, %%u and %%k, which turn overline,
+/// underline and strikethrough on and off.  Codes are not case sensitive;
+/// anything else after %% is left as it is.  What the score codes mark is
+/// returned as runs of text with the same scores and as one segment per
+/// stretch of each score, so the text is read once for both, where
+/// process_uc_string and process_underoverline each read it again.  A score
+/// still on at the end of the string runs to the end.
+///
+/// drawScores() turns the segments into lines once the text has been laid
+/// out, from the pen position at each character.
+/// </summary>
+class TextControlCodes
+{
+public:
+    enum Score
+    {
+        kOverline       = 1,
+        kUnderline      = 2,
+        kStrikethrough  = 4
+    };
+
+    enum Flags
+    {
+        kPhiForDiameter = 1     // %%c as UC_PHI_SYMBOL, for fonts without UC_DIAMETER_SYMBOL
+    };
+
+    /// <summary>
+    /// Runs and segments that are always enough for length characters:
+    /// every one of them takes a score code of three characters.
+    /// </summary>
+    static int runCapacity(int length) { return length / 3 + 1; }
+    static int segmentCapacity(int length) { return length / 3; }
+
+    /// <summary>
+    /// Expands the length characters at pString, or up to its NUL if length
+    /// is -1, into buffer.  buffer.pText may be pString to expand it in
+    /// place.  Returns Acad::eBufferTooSmall if the runs or segments did not
+    /// fit, with the counts they needed, and Acad::eInvalidInput for a null
+    /// string or text buffer.
+    /// </summary>
+    static Acad::ErrorStatus expand(const wchar_t* pString, int length, unsigned flags, TextControlBuffer& buffer);
+
+    /// <summary>
+    /// Draws the segments of buffer for text laid out with pPen[i] the pen
+    /// position of character i along the baseline, and pPen[textLength] the
+    /// end of the text, as text of params would be drawn at the origin:
+    /// overlines 1.2, strikethroughs 0.5 and underlines -0.2 text heights
+    /// from the baseline, sheared by the obliquing angle, mirrored if the
+    /// text is backward or upside down and rotated by the rotation angle.
+    /// pLineSegments gets up to 32 segments a call; pLineSegment one.
+    /// Nothing is drawn for text that is not visible.
+    /// </summary>
+    static void drawScores(const TextControlBuffer& buffer, const double* pPen, const TextParams& params,
+                           LineSegmentsCallback pLineSegments, const void* pAction);
+    static void drawScores(const TextControlBuffer& buffer, const double* pPen, const TextParams& params,
+                           LineSegmentCallback pLineSegment, const void* pAction);
+};
+
+} // namespace acad_sheetset_to_pdf
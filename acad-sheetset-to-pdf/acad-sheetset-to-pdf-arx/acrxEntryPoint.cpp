@@ -0,0 +1,254 @@
+#include "stdafx.h"
+#include "AsyncPlotLogger.h"
+#include "BlockGraphicsCache.h"
+#include "LinetypeComparison.h"
+#include "PagePropertyReactor.h"
+#include "ParallelFor.h"
+#include "PlotTelemetry.h"
+#include "PointCloudTextConverter.h"
+#include "PublishJournal.h"
+#include "PublishMetadataReactor.h"
+
+using namespace acad_sheetset_to_pdf;
+
+namespace {
+
+/* The reactors the module registers.  Commands are plain functions, so the
+ones they configure have to be reachable without the application object. */
+std::unique_ptr<SheetSetMetadataSource> s_pMetadataSource;
+std::unique_ptr<PublishMetadataReactor> s_pMetadataReactor;
+std::unique_ptr<PagePropertyReactor>     s_pPagePropertyReactor;
+std::unique_ptr<PlotTelemetry>          s_pTelemetry;
+std::unique_ptr<InstalledPlotLog>       s_pPlotLog;
+std::unique_ptr<BlockGraphicsCache>     s_pBlockGraphics;
+bool                                    s_blockGraphicsRegistered = false;
+std::unique_ptr<JournaledPublish>       s_pJournaledPublish;
+
+/* AcGlobAddPublishReactor and AcGlobRemovePublishReactor live in
+AcPublish.crx, which AutoCAD loads on demand and which has no import library,
+so they are looked up the way acpublishreactors.h describes.  Null if the
+module cannot be loaded. */
+template<class Function>
+Function publishFunction(const char* name)
+{
+    if (!acrxServiceIsRegistered(ACRX_T("AdskPublish")))
+        acrxLoadModule(ACRX_T("AcPublish.crx"), false, false);
+    const HMODULE hPublish = ::GetModuleHandleW(ACRX_T("AcPublish.crx"));
+    return hPublish != NULL ? reinterpret_cast<Function>(::GetProcAddress(hPublish, name)) : nullptr;
+}
+
+/* AcGlobAddDMMReactor and AcGlobRemoveDMMReactor, likewise, from AcEPlotX.crx,
+where acdmmapi.h says the DMM reactor manager lives. */
+template<class Function>
+Function dmmFunction(const char* name)
+{
+    HMODULE hEPlot = ::GetModuleHandleW(ACRX_T("AcEPlotX.crx"));
+    if (hEPlot == NULL)
+    {
+        acrxLoadModule(ACRX_T("AcEPlotX.crx"), false, false);
+        hEPlot = ::GetModuleHandleW(ACRX_T("AcEPlotX.crx"));
+    }
+    return hEPlot != NULL ? reinterpret_cast<Function>(::GetProcAddress(hEPlot, name)) : nullptr;
+}
+
+} // namespace
+
+/* The console driver loads this module into AutoCAD over COM (LoadArx) before
+it starts the publish job, and unloads it with AutoCAD.  Nothing else links
+against it: whatever the module contributes has to be reachable from here,
+either as one of the commands below, which the driver or a user can run, or as
+a reactor registered while the module is loaded:
+
+  - PublishMetadataReactor, with a SheetSetMetadataSource, hands every
+    publish job the custom properties of its sheet set.
+  - PagePropertyReactor, registered after it, puts those properties on the
+    published pages through a DMM reactor.
+  - PlotTelemetry times every sheet plotted; SHEETSETTOPDFTELEMETRY tells it
+    where to export to.
+  - InstalledPlotLog logs plots without blocking them, once
+    SHEETSETTOPDFPLOTLOG has named the file.
+  - BlockGraphicsCache reads the graphics of blocks and xrefs back from the
+    folder SHEETSETTOPDFBLOCKCACHE names instead of generating them again.
+    It is off until that command names a folder, and is only registered
+    while one is named, so that plots are left alone otherwise.
+  - PublishCheckpointReactor journals every sheet the driver publishes to a
+    PDF of its own while SHEETSETTOPDFJOURNAL has a journal open, and
+    SHEETSETTOPDFASSEMBLE merges them into the output once all are done.
+
+Commands are declared with ACED_ARXCOMMAND_ENTRY_AUTO at the end of the file;
+AcRxArxApp registers them under the SHEETSETTOPDF group on load and removes the
+group on unload. */
+class CAcadSheetsetToPdfApp : public AcRxArxApp
+{
+public:
+    CAcadSheetsetToPdfApp() : AcRxArxApp() {}
+
+    virtual AcRx::AppRetCode On_kInitAppMsg(void* pkt) override
+    {
+        const AcRx::AppRetCode result = AcRxArxApp::On_kInitAppMsg(pkt);
+        try
+        {
+            if (const ACGLOBADDPUBLISHREACTOR pAdd = publishFunction<ACGLOBADDPUBLISHREACTOR>("AcGlobAddPublishReactor"))
+            {
+                s_pMetadataSource.reset(new SheetSetMetadataSource);
+                s_pMetadataReactor.reset(new PublishMetadataReactor(*s_pMetadataSource));
+                pAdd(s_pMetadataReactor.get());
+
+                const ACGLOBADDDMMREACTOR pAddDmm = dmmFunction<ACGLOBADDDMMREACTOR>("AcGlobAddDMMReactor");
+                const ACGLOBREMOVEDMMREACTOR pRemoveDmm =
+                    dmmFunction<ACGLOBREMOVEDMMREACTOR>("AcGlobRemoveDMMReactor");
+                if (pAddDmm != nullptr && pRemoveDmm != nullptr)
+                {
+                    s_pPagePropertyReactor.reset(new PagePropertyReactor(pAddDmm, pRemoveDmm));
+                    pAdd(s_pPagePropertyReactor.get());
+                }
+                else
+                {
+                    acutPrintf(ACRX_T("\nAcEPlotX.crx is not available; pages will not get sheet set properties.\n"));
+                }
+            }
+            else
+            {
+                acutPrintf(ACRX_T("\nAcPublish.crx is not available; sheet set metadata will not be published.\n"));
+            }
+        }
+        catch (const std::bad_alloc&)
+        {
+            /* Only the page properties can be missing; they need the metadata. */
+            if (s_pMetadataReactor == nullptr)
+                s_pMetadataSource.reset();
+        }
+
+        try
+        {
+            s_pTelemetry.reset(new PlotTelemetry);
+            acplPlotReactorMgr->addReactor(s_pTelemetry.get());
+            s_pPlotLog.reset(new InstalledPlotLog);
+            s_pBlockGraphics.reset(new BlockGraphicsCache);
+            s_pJournaledPublish.reset(new JournaledPublish);
+        }
+        catch (const std::bad_alloc&)
+        {
+            /* Run without whatever could not be created. */
+        }
+        return result;
+    }
+
+    virtual AcRx::AppRetCode On_kUnloadAppMsg(void* pkt) override
+    {
+        if (s_pMetadataReactor != nullptr)
+        {
+            if (const ACGLOBREMOVEPUBLISHREACTOR pRemove =
+                    publishFunction<ACGLOBREMOVEPUBLISHREACTOR>("AcGlobRemovePublishReactor"))
+            {
+                if (s_pPagePropertyReactor != nullptr)
+                    pRemove(s_pPagePropertyReactor.get());
+                pRemove(s_pMetadataReactor.get());
+            }
+            s_pPagePropertyReactor.reset();
+            s_pMetadataReactor.reset();
+            s_pMetadataSource.reset();
+        }
+        if (s_pTelemetry != nullptr)
+        {
+            acplPlotReactorMgr->removeReactor(s_pTelemetry.get());
+            s_pTelemetry.reset();
+        }
+        s_pPlotLog.reset();
+        if (s_blockGraphicsRegistered)
+        {
+            acplPlotReactorMgr->removeReactor(s_pBlockGraphics.get());
+            s_blockGraphicsRegistered = false;
+        }
+        s_pBlockGraphics.reset();
+        if (s_pJournaledPublish != nullptr && s_pJournaledPublish->pReactor != nullptr)
+            acplPlotReactorMgr->removeReactor(s_pJournaledPublish->pReactor.get());
+        s_pJournaledPublish.reset();
+
+        /* The pool threads run code in this module. */
+        stopWorkerThreads();
+        return AcRxArxApp::On_kUnloadAppMsg(pkt);
+    }
+
+    virtual void RegisterServerComponents() override {}
+
+    static void SHEETSETTOPDFSHEETSETTOPDFPOINTCLOUD()
+    {
+        convertPointCloudCommand();
+    }
+
+    static void SHEETSETTOPDFSHEETSETTOPDFCHECKLINETYPES()
+    {
+        checkLinetypesCommand();
+    }
+
+    static void SHEETSETTOPDFSHEETSETTOPDFTELEMETRY()
+    {
+        if (s_pTelemetry != nullptr)
+            plotTelemetryCommand(*s_pTelemetry);
+    }
+
+    static void SHEETSETTOPDFSHEETSETTOPDFPLOTLOG()
+    {
+        if (s_pPlotLog != nullptr)
+            plotLogCommand(*s_pPlotLog);
+    }
+
+    static void SHEETSETTOPDFSHEETSETTOPDFBLOCKCACHE()
+    {
+        if (s_pBlockGraphics == nullptr)
+            return;
+        blockGraphicsCacheCommand(*s_pBlockGraphics);
+        const bool caching = !s_pBlockGraphics->directory().isEmpty();
+        if (caching && !s_blockGraphicsRegistered)
+            acplPlotReactorMgr->addReactor(s_pBlockGraphics.get());
+        else if (!caching && s_blockGraphicsRegistered)
+            acplPlotReactorMgr->removeReactor(s_pBlockGraphics.get());
+        s_blockGraphicsRegistered = caching;
+    }
+
+    static void SHEETSETTOPDFSHEETSETTOPDFJOURNAL()
+    {
+        if (s_pJournaledPublish == nullptr)
+            return;
+        PublishCheckpointReactor* pPrevious = s_pJournaledPublish->pReactor.get();
+        if (pPrevious != nullptr)
+            acplPlotReactorMgr->removeReactor(pPrevious);
+        publishJournalCommand(*s_pJournaledPublish);
+        if (s_pJournaledPublish->pReactor != nullptr)
+            acplPlotReactorMgr->addReactor(s_pJournaledPublish->pReactor.get());
+    }
+
+    static void SHEETSETTOPDFSHEETSETTOPDFASSEMBLE()
+    {
+        if (s_pJournaledPublish != nullptr)
+            assembleJournalCommand(*s_pJournaledPublish);
+    }
+};
+
+IMPLEMENT_ARX_ENTRYPOINT(CAcadSheetsetToPdfApp)
+
+ACED_ARXCOMMAND_ENTRY_AUTO(CAcadSheetsetToPdfApp, SHEETSETTOPDF, SHEETSETTOPDFPOINTCLOUD, SHEETSETTOPDFPOINTCLOUD,
+                           ACRX_CMD_MODAL, NULL)
+ACED_ARXCOMMAND_ENTRY_AUTO(CAcadSheetsetToPdfApp, SHEETSETTOPDF, SHEETSETTOPDFCHECKLINETYPES,
+                           SHEETSETTOPDFCHECKLINETYPES, ACRX_CMD_MODAL, NULL)
+ACED_ARXCOMMAND_ENTRY_AUTO(CAcadSheetsetToPdfApp, SHEETSETTOPDF, SHEETSETTOPDFTELEMETRY, SHEETSETTOPDFTELEMETRY,
+                           ACRX_CMD_MODAL, NULL)
+ACED_ARXCOMMAND_ENTRY_AUTO(CAcadSheetsetToPdfApp, SHEETSETTOPDF, SHEETSETTOPDFPLOTLOG, SHEETSETTOPDFPLOTLOG,
+                           ACRX_CMD_MODAL, NULL)
+ACED_ARXCOMMAND_ENTRY_AUTO(CAcadSheetsetToPdfApp, SHEETSETTOPDF, SHEETSETTOPDFBLOCKCACHE, SHEETSETTOPDFBLOCKCACHE,
+                           ACRX_CMD_MODAL, NULL)
+ACED_ARXCOMMAND_ENTRY_AUTO(CAcadSheetsetToPdfApp, SHEETSETTOPDF, SHEETSETTOPDFJOURNAL, SHEETSETTOPDFJOURNAL,
+                           ACRX_CMD_MODAL, NULL)
+ACED_ARXCOMMAND_ENTRY_AUTO(CAcadSheetsetToPdfApp, SHEETSETTOPDF, SHEETSETTOPDFASSEMBLE, SHEETSETTOPDFASSEMBLE,
+                           ACRX_CMD_MODAL, NULL)
+
+BOOL APIENTRY DllMain(HINSTANCE hInstance, DWORD dwReason, LPVOID /*lpReserved*/)
+{
+    if (dwReason == DLL_PROCESS_ATTACH)
+    {
+        _hdllInstance = hInstance;
+        ::DisableThreadLibraryCalls(hInstance);
+    }
+    return TRUE;
+}
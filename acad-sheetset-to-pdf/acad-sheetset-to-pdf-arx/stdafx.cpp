@@ -0,0 +1,3 @@
+// stdafx.cpp : builds the precompiled header for the module.
+
+#include "stdafx.h"
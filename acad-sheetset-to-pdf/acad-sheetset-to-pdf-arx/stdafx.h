@@ -0,0 +1,32 @@
+/*
+ * Precompiled header for the acad-sheetset-to-pdf ObjectARX module.
+ *
+ * The console driver (acad-sheetset-to-pdf.exe) talks to AutoCAD over COM,
+ * which only reaches the parts of AutoCAD that are exposed as automation
+ * objects.  Everything that has to sit inside the AutoCAD process (plot and
+ * publish reactors, point cloud buffers, graphics and text engines, ...) lives
+ * in this module instead.  The SDK's property sheets (rxsdk_*.props) insist on
+ * a precompiled header called stdafx.h, so every translation unit in this
+ * project includes this file first.
+ */
+
+#pragma once
+
+#define STRICT
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0A00
+#endif
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+#include "arxHeaders.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
@@ -0,0 +1,173 @@
+#include "stdafx.h"
+#include "AcRxValueArray.h"
+
+#include <cwchar>
+
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+volatile double s_sink;
+
+/* Doubles appended one at a time, as AcRxValues and in bulk make one
+   column, which reads, edits and copies as one. */
+void testColumn()
+{
+    AcRxValueArray array;
+    CHECK(array.isEmpty() && !array.isColumnar() && array.type() == AcRxValueType::Desc<void>::value());
+    CHECK(array.append(1.5) == Acad::eOk);
+    CHECK(array.append(AcRxValue(2.5)) == Acad::eOk);
+    const double more[] = {3.5, 4.5};
+    CHECK(array.append(more, 2) == Acad::eOk);
+    CHECK(array.isColumnar() && array.length() == 4 && array.type() == AcRxValueType::Desc<double>::value());
+    CHECK(array.data<double>()[3] == 4.5 && array.data<float>() == nullptr);
+    CHECK(*array.cast<double>(1) == 2.5);
+    CHECK(array.cast<Adesk::Int32>(1) == nullptr && array.cast<const ACHAR*>(0) == nullptr);
+    const AcRxValue value = array.at(2);
+    CHECK(*rxvalue_cast<double>(&value) == 3.5);
+
+    array.data<double>()[0] = 9;
+    const AcRxValueArray copy(array);
+    CHECK(copy.isColumnar() && copy.length() == 4 && *copy.cast<double>(0) == 9);
+
+    AcRxValueArray ids;
+    AcDbObjectId id;
+    id.stubHandle = 12;
+    CHECK(ids.append(id) == Acad::eOk && ids.append(AcRxValue(id)) == Acad::eOk);
+    CHECK(ids.isColumnar() && ids.length() == 2 && ids.data<AcDbObjectId>()[1] == id);
+}
+
+/* The first value of another type turns the array into AcRxValues once,
+   keeping what it held; copies, assignments and moves keep their own. */
+void testSpill()
+{
+    AcRxValueArray array;
+    const double values[] = {9, 2.5, 3.5, 4.5};
+    array.append(values, 4);
+    const AcRxValueArray column(array);
+
+    CHECK(array.append(Adesk::Int32(7)) == Acad::eOk);
+    CHECK(!array.isColumnar() && array.length() == 5 && array.data<double>() == nullptr);
+    CHECK(*array.cast<double>(0) == 9 && *array.cast<Adesk::Int32>(4) == 7);
+    CHECK(array.append(AcRxValue(AcString(L"text"))) == Acad::eOk);
+    CHECK(std::wcscmp(*array.cast<const ACHAR*>(5), L"text") == 0);
+    CHECK(column.isColumnar() && column.length() == 4);
+
+    AcRxValueArray assigned(column);
+    assigned = array;
+    CHECK(!assigned.isColumnar() && assigned.length() == 6);
+    const AcRxValueArray moved(std::move(assigned));
+    CHECK(moved.length() == 6 && *moved.cast<Adesk::Int32>(4) == 7);
+    array.clear();
+    CHECK(array.isEmpty() && !array.isColumnar());
+
+    AcRxValueArray flags;
+    flags.append(AcRxValue(true));
+    CHECK(!flags.isColumnar() && *flags.cast<bool>(0));
+    AcRxValueArray empty;
+    CHECK(empty.reserve(10) == Acad::eOk && empty.append(AcRxValue()) == Acad::eOk);
+    CHECK(!empty.isColumnar() && empty.length() == 1);
+}
+
+/* Matrices, which AcRxValue boxes, are kept unboxed in their column
+   whether they come as AcRxValues or not, and still spill. */
+void testMatrices()
+{
+    AcGeMatrix3d matrix;
+    matrix.entry[0][3] = 5;
+    AcRxValueArray array;
+    CHECK(array.append(AcRxValue(matrix)) == Acad::eOk && array.isColumnar());
+    CHECK(array.data<AcGeMatrix3d>()[0].entry[0][3] == 5);
+    CHECK(array.append(matrix) == Acad::eOk && array.length() == 2);
+    const AcRxValue value = array.at(1);
+    CHECK(rxvalue_cast<AcGeMatrix3d>(&value)->entry[0][3] == 5);
+
+    CHECK(array.append(AcGePoint3d(1, 2, 3)) == Acad::eOk && !array.isColumnar());
+    CHECK(array.cast<AcGeMatrix3d>(0)->entry[0][3] == 5 && array.cast<AcGePoint3d>(2)->y == 2);
+}
+
+/* count values of T made by make, built, copied and read back through
+   a std::vector of AcRxValues and through an AcRxValueArray, and the
+   array also built from the AcRxValues. */
+template <class T, class Make, class Read>
+void benchmarkType(const char* name, size_t count, Make make, Read read)
+{
+    Stopwatch watch;
+    std::vector<AcRxValue> values;
+    values.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+        values.push_back(AcRxValue(make(i)));
+    const double building = watch.milliseconds();
+    watch.restart();
+    const std::vector<AcRxValue> valuesCopy(values);
+    const double copying = watch.milliseconds();
+    watch.restart();
+    double sum = 0;
+    for (const AcRxValue& value : valuesCopy)
+        sum += read(*rxvalue_cast<T>(&value));
+    const double casting = watch.milliseconds();
+    s_sink = sum;
+
+    watch.restart();
+    AcRxValueArray array;
+    array.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+        array.append(make(i));
+    const double arrayBuilding = watch.milliseconds();
+    watch.restart();
+    const AcRxValueArray arrayCopy(array);
+    const double arrayCopying = watch.milliseconds();
+    watch.restart();
+    double arraySum = 0;
+    for (size_t i = 0; i < count; ++i)
+        arraySum += read(*arrayCopy.cast<T>(i));
+    const double arrayCasting = watch.milliseconds();
+    s_sink = arraySum;
+
+    watch.restart();
+    AcRxValueArray fromValues;
+    fromValues.reserve(count);
+    for (const AcRxValue& value : values)
+        fromValues.append(value);
+    const double converting = watch.milliseconds();
+
+    CHECK(arrayCopy.isColumnar() && fromValues.isColumnar() && arraySum == sum);
+    std::printf("%zu %s: std::vector<AcRxValue> build %.2f, copy %.2f, cast %.2f ms; "
+                "AcRxValueArray build %.2f, copy %.2f, cast %.2f, from AcRxValues %.2f ms\n",
+                count, name, building, copying, casting, arrayBuilding, arrayCopying, arrayCasting, converting);
+}
+
+void benchmarkValues(unsigned long count)
+{
+    benchmarkType<double>(
+        "doubles", count, [](size_t i) { return double(i); }, [](const double& value) { return value; });
+    benchmarkType<AcGePoint3d>(
+        "points", count, [](size_t i) { return AcGePoint3d(double(i), 1, 2); },
+        [](const AcGePoint3d& point) { return point.x; });
+    benchmarkType<AcGeMatrix3d>(
+        "matrices", count,
+        [](size_t i)
+        {
+            AcGeMatrix3d matrix;
+            matrix.entry[0][3] = double(i);
+            return matrix;
+        },
+        [](const AcGeMatrix3d& matrix) { return matrix.entry[0][3]; });
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testColumn();
+    testSpill();
+    testMatrices();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkValues(sizeArgument(argc, argv, 0, 200000));
+
+    return finish();
+}
@@ -0,0 +1,589 @@
+#include "stdafx.h"
+#include "ArenaFilers.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <random>
+
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+AcDbObjectId idOf(Adesk::IntPtr oldId)
+{
+    AcDbObjectId id;
+    id.setFromOldId(oldId);
+    return id;
+}
+
+/// <summary>
+/// The fields of a custom object, filed as its dwgOutFields() and
+/// dwgInFields() would file them.
+/// </summary>
+struct CustomObject
+{
+    enum { kFieldCount = 10 };
+
+    Acad::ErrorStatus dwgOutFields(AcDbDwgFiler* pFiler) const
+    {
+        pFiler->writeInt16(version);
+        pFiler->writePoint3d(start);
+        pFiler->writePoint3d(end);
+        pFiler->writeDouble(radius);
+        pFiler->writeInt32(flags);
+        pFiler->writeBool(visible);
+        AcDbHardPointerId ownerId;
+        static_cast<AcDbObjectId&>(ownerId) = owner;
+        pFiler->writeHardPointerId(ownerId);
+        pFiler->writeVector3d(normal);
+        pFiler->writeUInt32(color);
+        pFiler->writeDouble(width);
+        return pFiler->filerStatus();
+    }
+
+    Acad::ErrorStatus dwgInFields(AcDbDwgFiler* pFiler)
+    {
+        pFiler->readInt16(&version);
+        pFiler->readPoint3d(&start);
+        pFiler->readPoint3d(&end);
+        pFiler->readDouble(&radius);
+        pFiler->readInt32(&flags);
+        pFiler->readBool(&visible);
+        AcDbHardPointerId ownerId;
+        pFiler->readHardPointerId(&ownerId);
+        owner = ownerId;
+        pFiler->readVector3d(&normal);
+        pFiler->readUInt32(&color);
+        pFiler->readDouble(&width);
+        return pFiler->filerStatus();
+    }
+
+    bool operator==(const CustomObject& other) const
+    {
+        return version == other.version && start == other.start && end == other.end && radius == other.radius &&
+               flags == other.flags && visible == other.visible && owner == other.owner &&
+               normal == other.normal && color == other.color && width == other.width;
+    }
+
+    Adesk::Int16    version = 3;
+    AcGePoint3d     start;
+    AcGePoint3d     end;
+    double          radius = 0;
+    Adesk::Int32    flags = 0;
+    bool            visible = true;
+    AcDbObjectId    owner;
+    AcGeVector3d    normal;
+    Adesk::UInt32   color = 0;
+    double          width = 0;
+};
+
+#define VECTOR_FILER_VALUE(Name, Type)                                          \
+    Acad::ErrorStatus read##Name(Type* pValue) override { return get(pValue); } \
+    Acad::ErrorStatus write##Name(Type value) override { return put(value); }
+#define VECTOR_FILER_REFERENCE(Name, Type)                                      \
+    Acad::ErrorStatus read##Name(Type* pValue) override { return get(pValue); } \
+    Acad::ErrorStatus write##Name(const Type& value) override { return put(value); }
+
+/// <summary>
+/// A DWG filer written the obvious way, each field appended to a vector at
+/// its full width, to measure the arena filer against.  It files no strings
+/// or bytes.
+/// </summary>
+class VectorFiler : public AcDbDwgFiler
+{
+public:
+    Acad::ErrorStatus filerStatus() const override { return m_status; }
+    AcDb::FilerType filerType() const override { return AcDb::kCopyFiler; }
+    void setFilerStatus(Acad::ErrorStatus es) override { m_status = es; }
+    void resetFilerStatus() override { m_status = Acad::eOk; }
+
+    VECTOR_FILER_REFERENCE(HardOwnershipId, AcDbHardOwnershipId)
+    VECTOR_FILER_REFERENCE(SoftOwnershipId, AcDbSoftOwnershipId)
+    VECTOR_FILER_REFERENCE(HardPointerId, AcDbHardPointerId)
+    VECTOR_FILER_REFERENCE(SoftPointerId, AcDbSoftPointerId)
+    VECTOR_FILER_VALUE(Int8, Adesk::Int8)
+    Acad::ErrorStatus readString(ACHAR**) override { return Acad::eNotImplemented; }
+    Acad::ErrorStatus writeString(const ACHAR*) override { return Acad::eNotImplemented; }
+    Acad::ErrorStatus readString(AcString&) override { return Acad::eNotImplemented; }
+    Acad::ErrorStatus writeString(const AcString&) override { return Acad::eNotImplemented; }
+    VECTOR_FILER_REFERENCE(BChunk, ads_binary)
+    VECTOR_FILER_REFERENCE(AcDbHandle, AcDbHandle)
+    VECTOR_FILER_VALUE(Int64, Adesk::Int64)
+    VECTOR_FILER_VALUE(Int32, Adesk::Int32)
+    VECTOR_FILER_VALUE(Int16, Adesk::Int16)
+    VECTOR_FILER_VALUE(UInt64, Adesk::UInt64)
+    VECTOR_FILER_VALUE(UInt32, Adesk::UInt32)
+    VECTOR_FILER_VALUE(UInt16, Adesk::UInt16)
+    VECTOR_FILER_VALUE(UInt8, Adesk::UInt8)
+    VECTOR_FILER_VALUE(Bool, bool)
+    VECTOR_FILER_VALUE(Double, double)
+    VECTOR_FILER_REFERENCE(Point2d, AcGePoint2d)
+    VECTOR_FILER_REFERENCE(Point3d, AcGePoint3d)
+    VECTOR_FILER_REFERENCE(Vector2d, AcGeVector2d)
+    VECTOR_FILER_REFERENCE(Vector3d, AcGeVector3d)
+    VECTOR_FILER_REFERENCE(Scale3d, AcGeScale3d)
+    Acad::ErrorStatus readBytes(void*, Adesk::UIntPtr) override { return Acad::eNotImplemented; }
+    Acad::ErrorStatus writeBytes(const void*, Adesk::UIntPtr) override { return Acad::eNotImplemented; }
+
+    Acad::ErrorStatus seek(Adesk::Int64 offset, int) override
+    {
+        m_position = static_cast<size_t>(offset);
+        return Acad::eOk;
+    }
+    Adesk::Int64 tell() const override { return static_cast<Adesk::Int64>(m_position); }
+
+    void clear()
+    {
+        m_bytes.clear();
+        m_position = 0;
+    }
+    size_t size() const { return m_bytes.size(); }
+
+private:
+    template <class T> Acad::ErrorStatus put(const T& value)
+    {
+        const Adesk::UInt8* const p = reinterpret_cast<const Adesk::UInt8*>(&value);
+        m_bytes.insert(m_bytes.end(), p, p + sizeof(T));
+        m_position = m_bytes.size();
+        return Acad::eOk;
+    }
+
+    template <class T> Acad::ErrorStatus get(T* pValue)
+    {
+        if (m_bytes.size() - m_position < sizeof(T))
+            return m_status = Acad::eEndOfFile;
+        std::memcpy(pValue, m_bytes.data() + m_position, sizeof(T));
+        m_position += sizeof(T);
+        return Acad::eOk;
+    }
+
+    std::vector<Adesk::UInt8>   m_bytes;
+    size_t                      m_position = 0;
+    Acad::ErrorStatus           m_status = Acad::eOk;
+};
+
+#undef VECTOR_FILER_VALUE
+#undef VECTOR_FILER_REFERENCE
+
+/* Varints take seven bits a byte, signed ones zigzagged, and read back;
+   one cut short does not. */
+void testVarInts()
+{
+    const Adesk::UInt64 unsignedValues[] = {0, 1, 127, 128, 16383, 16384, 0xFFFFFFFFull, ~0ull};
+    const Adesk::Int64 signedValues[] = {0, -1, 1, -64, 64, LLONG_MIN, LLONG_MAX};
+    FilerArena arena;
+    for (Adesk::UInt64 value : unsignedValues)
+        CHECK(arena.putVarUInt(value));
+    for (Adesk::Int64 value : signedValues)
+        CHECK(arena.putVarInt(value));
+    CHECK(arena.size() == 1 + 1 + 1 + 2 + 2 + 3 + 5 + 10 + 1 + 1 + 1 + 1 + 2 + 10 + 10);
+
+    CHECK(arena.setPosition(0) && !arena.setPosition(arena.size() + 1));
+    for (Adesk::UInt64 value : unsignedValues)
+    {
+        Adesk::UInt64 read = 7;
+        CHECK(arena.getVarUInt(read) && read == value);
+    }
+    for (Adesk::Int64 value : signedValues)
+    {
+        Adesk::Int64 read = 7;
+        CHECK(arena.getVarInt(read) && read == value);
+    }
+    Adesk::UInt64 read = 0;
+    CHECK(!arena.getVarUInt(read));
+
+    arena.clear();
+    arena.putVarUInt(~0ull);
+    FilerArena cut;
+    CHECK(cut.assign(arena.data(), arena.size() - 1) == Acad::eOk && !cut.getVarUInt(read));
+}
+
+/* Every field the DWG filer has, and the arrays it writes in one call,
+   read back as written. */
+void testDwgRoundTrip()
+{
+    ArenaDwgFiler filer(AcDb::kUndoFiler);
+    AcDbDwgFiler* pFiler = &filer;
+    CHECK(filer.filerType() == AcDb::kUndoFiler);
+
+    AcDbHardOwnershipId ownership;
+    ownership.setFromOldId(0x1234567890);
+    AcDbSoftPointerId pointer;
+    pointer.setFromOldId(42);
+    char chunk[5] = {1, 2, 0, 4, 5};
+    const ads_binary binary = {5, chunk};
+    AcGeScale3d scale;
+    scale.sx = 2;
+    scale.sy = 3;
+    scale.sz = -1;
+    int addressed = 0;
+    AcGePoint3dArray points;
+    for (int i = 0; i < 1000; ++i)
+        points.append(AcGePoint3d(i, -i, i * 0.5));
+    AcDbObjectIdArray ids;
+    for (int i = 0; i < 100; ++i)
+        ids.append(idOf(i * 977));
+    AcGeDoubleArray doubles;
+    doubles.append(1.5);
+    doubles.append(-2);
+
+    pFiler->writeHardOwnershipId(ownership);
+    pFiler->writeSoftPointerId(pointer);
+    pFiler->writeInt8(-5);
+    pFiler->writeString(L"h\x00e9llo");
+    pFiler->writeString(AcString(L"acstr"));
+    pFiler->writeString(static_cast<const ACHAR*>(nullptr));
+    pFiler->writeBChunk(binary);
+    pFiler->writeAcDbHandle(AcDbHandle(0xABCDEFull));
+    pFiler->writeInt64(LLONG_MIN);
+    pFiler->writeInt32(-123456);
+    pFiler->writeInt16(-300);
+    pFiler->writeUInt64(~0ull);
+    pFiler->writeUInt32(4000000000u);
+    pFiler->writeUInt16(65535);
+    pFiler->writeUInt8(200);
+    pFiler->writeBool(true);
+    pFiler->writeDouble(3.25);
+    pFiler->writePoint2d(AcGePoint2d(1, 2));
+    pFiler->writePoint3d(AcGePoint3d(1, 2, 3));
+    pFiler->writeVector2d(AcGeVector2d(-1, 0.5));
+    pFiler->writeVector3d(AcGeVector3d(0, 0, 1));
+    pFiler->writeScale3d(scale);
+    pFiler->writeBytes("raw!", 4);
+    pFiler->writeAddress(&addressed);
+    filer.writeArray(points);
+    filer.writeArray(ids);
+    filer.writeArray(doubles);
+    filer.writeVarInt(-9);
+    CHECK(filer.filerStatus() == Acad::eOk);
+
+    CHECK(filer.seek(0, AcDb::kSeekFromStart) == Acad::eOk && filer.tell() == 0);
+    AcDbHardOwnershipId ownershipRead;
+    pFiler->readHardOwnershipId(&ownershipRead);
+    CHECK(ownershipRead.asOldId() == 0x1234567890);
+    AcDbSoftPointerId pointerRead;
+    pFiler->readSoftPointerId(&pointerRead);
+    CHECK(pointerRead.asOldId() == 42);
+    Adesk::Int8 int8 = 0;
+    CHECK(pFiler->readInt8(&int8) == Acad::eOk && int8 == -5);
+    ACHAR* pString = nullptr;
+    CHECK(pFiler->readString(&pString) == Acad::eOk && std::wcscmp(pString, L"h\x00e9llo") == 0);
+    acutDelString(pString);
+    AcString string;
+    CHECK(pFiler->readString(string) == Acad::eOk && string == AcString(L"acstr"));
+    CHECK(pFiler->readString(string) == Acad::eOk && string.isEmpty());
+    ads_binary binaryRead = {0, nullptr};
+    CHECK(pFiler->readBChunk(&binaryRead) == Acad::eOk && binaryRead.clen == 5 &&
+          std::memcmp(binaryRead.buf, chunk, 5) == 0);
+    delete[] binaryRead.buf;
+    AcDbHandle handle;
+    CHECK(pFiler->readAcDbHandle(&handle) == Acad::eOk && Adesk::UInt64(handle) == 0xABCDEF);
+    Adesk::Int64 int64 = 0;
+    CHECK(pFiler->readInt64(&int64) == Acad::eOk && int64 == LLONG_MIN);
+    Adesk::Int32 int32 = 0;
+    CHECK(pFiler->readInt32(&int32) == Acad::eOk && int32 == -123456);
+    Adesk::Int16 int16 = 0;
+    CHECK(pFiler->readInt16(&int16) == Acad::eOk && int16 == -300);
+    Adesk::UInt64 uint64 = 0;
+    CHECK(pFiler->readUInt64(&uint64) == Acad::eOk && uint64 == ~0ull);
+    Adesk::UInt32 uint32 = 0;
+    CHECK(pFiler->readUInt32(&uint32) == Acad::eOk && uint32 == 4000000000u);
+    Adesk::UInt16 uint16 = 0;
+    CHECK(pFiler->readUInt16(&uint16) == Acad::eOk && uint16 == 65535);
+    Adesk::UInt8 uint8 = 0;
+    CHECK(pFiler->readUInt8(&uint8) == Acad::eOk && uint8 == 200);
+    bool boolean = false;
+    CHECK(pFiler->readBool(&boolean) == Acad::eOk && boolean);
+    double real = 0;
+    CHECK(pFiler->readDouble(&real) == Acad::eOk && real == 3.25);
+    AcGePoint2d point2d;
+    CHECK(pFiler->readPoint2d(&point2d) == Acad::eOk && point2d == AcGePoint2d(1, 2));
+    AcGePoint3d point3d;
+    CHECK(pFiler->readPoint3d(&point3d) == Acad::eOk && point3d == AcGePoint3d(1, 2, 3));
+    AcGeVector2d vector2d;
+    CHECK(pFiler->readVector2d(&vector2d) == Acad::eOk && vector2d.x == -1 && vector2d.y == 0.5);
+    AcGeVector3d vector3d;
+    CHECK(pFiler->readVector3d(&vector3d) == Acad::eOk && vector3d == AcGeVector3d(0, 0, 1));
+    AcGeScale3d scaleRead;
+    CHECK(pFiler->readScale3d(&scaleRead) == Acad::eOk && scaleRead.sx == 2 && scaleRead.sy == 3 &&
+          scaleRead.sz == -1);
+    char raw[4];
+    CHECK(pFiler->readBytes(raw, 4) == Acad::eOk && std::memcmp(raw, "raw!", 4) == 0);
+    void* pAddress = nullptr;
+    CHECK(pFiler->readAddress(&pAddress) == Acad::eOk && pAddress == &addressed);
+    AcGePoint3dArray pointsRead;
+    CHECK(filer.readArray(pointsRead) == Acad::eOk && pointsRead == points);
+    AcDbObjectIdArray idsRead;
+    CHECK(filer.readArray(idsRead) == Acad::eOk && idsRead == ids);
+    AcGeDoubleArray doublesRead;
+    CHECK(filer.readArray(doublesRead) == Acad::eOk && doublesRead == doubles);
+    Adesk::Int64 varInt = 0;
+    CHECK(filer.readVarInt(&varInt) == Acad::eOk && varInt == -9);
+    CHECK(filer.filerStatus() == Acad::eOk && filer.arena().remaining() == 0);
+}
+
+/* The first error sticks until it is reset; integers read narrower than
+   they were written, seeks out of the arena and lengths longer than what
+   is left fail without reading on. */
+void testDwgErrors()
+{
+    ArenaDwgFiler filer;
+    AcDbDwgFiler* pFiler = &filer;
+    double real = 0;
+    CHECK(pFiler->readDouble(&real) == Acad::eEndOfFile && filer.filerStatus() == Acad::eEndOfFile);
+    CHECK(pFiler->writeDouble(1) == Acad::eEndOfFile && filer.arena().size() == 0);
+    filer.resetFilerStatus();
+
+    pFiler->writeInt32(100000);
+    pFiler->writeUInt32(70000);
+    pFiler->writeInt32(-7);
+    filer.seek(0, AcDb::kSeekFromStart);
+    Adesk::Int16 int16 = 0;
+    CHECK(pFiler->readInt16(&int16) == Acad::eInvalidInput);
+    filer.resetFilerStatus();
+    Adesk::UInt16 uint16 = 0;
+    CHECK(pFiler->readUInt16(&uint16) == Acad::eInvalidInput);
+    filer.resetFilerStatus();
+    CHECK(pFiler->readInt16(&int16) == Acad::eOk && int16 == -7);
+
+    CHECK(filer.seek(-1, AcDb::kSeekFromEnd) == Acad::eOk && filer.tell() == Adesk::Int64(filer.arena().size()) - 1);
+    CHECK(filer.seek(1, AcDb::kSeekFromEnd) == Acad::eInvalidInput);
+    filer.resetFilerStatus();
+    CHECK(filer.seek(-1, AcDb::kSeekFromStart) == Acad::eInvalidInput);
+    filer.resetFilerStatus();
+
+    filer.clear();
+    filer.writeVarUInt(1000000);
+    filer.seek(0, AcDb::kSeekFromStart);
+    ACHAR* pString = nullptr;
+    CHECK(pFiler->readString(&pString) == Acad::eEndOfFile && pString == nullptr);
+    filer.resetFilerStatus();
+    filer.seek(0, AcDb::kSeekFromStart);
+    AcGePoint3dArray points;
+    CHECK(filer.readArray(points) == Acad::eEndOfFile && points.isEmpty());
+    filer.resetFilerStatus();
+
+    ArenaDwgFiler writer;
+    writer.writeInt32(77);
+    ArenaDwgFiler reader;
+    CHECK(reader.arena().assign(writer.arena().data(), writer.arena().size()) == Acad::eOk);
+    Adesk::Int32 int32 = 0;
+    CHECK(reader.readInt32(&int32) == Acad::eOk && int32 == 77);
+}
+
+/* DXF items come back as resbufs of the type their group code says, with
+   the subclass marker, extended data and the end found on the way, and
+   one item pushed back at a time. */
+void testDxfRoundTrip()
+{
+    ArenaDxfFiler filer;
+    AcDbDxfFiler* pFiler = &filer;
+    pFiler->writeString(AcDb::kDxfSubclass, L"AcDbCustom");
+    pFiler->writeInt16(AcDb::kDxfInt16, -7);
+    pFiler->writeInt32(AcDb::kDxfInt32, 123456789);
+    pFiler->writeInt64(AcDb::kDxfInt64, -5000000000ll);
+    pFiler->writeBool(AcDb::kDxfBool, true);
+    pFiler->writeDouble(AcDb::kDxfReal, 2.5, 3);
+    pFiler->writePoint3d(AcDb::kDxfXCoord, AcGePoint3d(1, 2, 3));
+    pFiler->writePoint2d(AcDb::kDxfXCoord, AcGePoint2d(4, 5));
+    pFiler->writeObjectId(AcDb::kDxfSoftPointerId, idOf(99));
+    pFiler->writeAcDbHandle(AcDb::kDxfHandle, AcDbHandle(0x2AF));
+    char chunk[3] = {9, 8, 7};
+    const ads_binary binary = {3, chunk};
+    pFiler->writeBChunk(AcDb::kDxfBinaryChunk, binary);
+    const AcGePoint3d vertices[] = {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}};
+    filer.writePoint3ds(AcDb::kDxfXCoord, vertices, 4);
+    const double widths[] = {0.1, 0.2, 0.3};
+    filer.writeDoubles(AcDb::kDxfReal, widths, 3);
+    const AcDbObjectId reactors[] = {idOf(5), idOf(6)};
+    filer.writeObjectIds(AcDb::kDxfSoftPointerId, reactors, 2);
+    resbuf item;
+    item.restype = 1000;
+    item.resval.rstring = const_cast<wchar_t*>(L"xdata");
+    pFiler->writeResBuf(item);
+    item.restype = 70;
+    item.resval.rint = 12;
+    pFiler->writeResBuf(item);
+    CHECK(filer.filerStatus() == Acad::eOk);
+
+    resbuf rb;
+    CHECK(pFiler->rewindFiler() == Acad::eOk);
+    CHECK(!pFiler->atSubclassData(L"AcDbOther") && pFiler->atSubclassData(L"AcDbCustom"));
+    CHECK(pFiler->readItem(&rb) == Acad::eOk && rb.restype == 70 && rb.resval.rint == -7);
+    CHECK(pFiler->pushBackItem() == Acad::eOk && pFiler->pushBackItem() != Acad::eOk);
+    CHECK(pFiler->readItem(&rb) == Acad::eOk && rb.restype == 70 && rb.resval.rint == -7);
+    CHECK(pFiler->readItem(&rb) == Acad::eOk && rb.restype == 90 && rb.resval.rlong == 123456789);
+    CHECK(pFiler->readItem(&rb) == Acad::eOk && rb.restype == 160 && rb.resval.mnInt64 == -5000000000ll);
+    CHECK(pFiler->readItem(&rb) == Acad::eOk && rb.restype == 290 && rb.resval.rint == 1);
+    CHECK(pFiler->readItem(&rb) == Acad::eOk && rb.restype == 40 && rb.resval.rreal == 2.5);
+    CHECK(pFiler->readItem(&rb) == Acad::eOk && rb.restype == 10 && rb.resval.rpoint[2] == 3);
+    CHECK(pFiler->readItem(&rb) == Acad::eOk && rb.resval.rpoint[0] == 4 && rb.resval.rpoint[2] == 0);
+    CHECK(pFiler->readItem(&rb) == Acad::eOk && rb.restype == 330 && rb.resval.rlname[0] == 99);
+    CHECK(pFiler->readItem(&rb) == Acad::eOk && rb.restype == 5 && std::wcscmp(rb.resval.rstring, L"2AF") == 0);
+    CHECK(pFiler->readItem(&rb) == Acad::eOk && rb.restype == 310 && rb.resval.rbinary.clen == 3 &&
+          rb.resval.rbinary.buf[2] == 7);
+
+    /* A run written in one call reads as separate items, and pushing one
+       back in the middle of it returns it again. */
+    for (int i = 0; i < 4; ++i)
+    {
+        CHECK(pFiler->readItem(&rb) == Acad::eOk && rb.restype == 10 && rb.resval.rpoint[0] == vertices[i].x &&
+              rb.resval.rpoint[1] == vertices[i].y);
+        if (i == 1)
+        {
+            CHECK(pFiler->pushBackItem() == Acad::eOk);
+            CHECK(pFiler->readItem(&rb) == Acad::eOk && rb.resval.rpoint[0] == 1 && rb.resval.rpoint[1] == 0);
+        }
+    }
+    for (double width : widths)
+        CHECK(pFiler->readItem(&rb) == Acad::eOk && rb.restype == 40 && rb.resval.rreal == width);
+    CHECK(pFiler->readItem(&rb) == Acad::eOk && rb.resval.rlname[0] == 5);
+    CHECK(!pFiler->atExtendedData());
+    CHECK(pFiler->readItem(&rb) == Acad::eOk && rb.resval.rlname[0] == 6);
+    CHECK(pFiler->atExtendedData());
+    CHECK(pFiler->readItem(&rb) == Acad::eOk && rb.restype == 1000 && std::wcscmp(rb.resval.rstring, L"xdata") == 0);
+    CHECK(!pFiler->atEOF());
+    CHECK(pFiler->readItem(&rb) == Acad::eOk && rb.restype == 70 && rb.resval.rint == 12);
+    CHECK(pFiler->atEOF() && pFiler->atEndOfObject());
+    CHECK(pFiler->readItem(&rb) == Acad::eEndOfFile && filer.filerStatus() == Acad::eOk);
+
+    ArenaDxfFiler damaged;
+    damaged.arena().assign("\xFF\xFF\xFF", 3);
+    CHECK(damaged.readItem(&rb) == Acad::eInvalidInput);
+
+    ArenaDxfFiler embedded;
+    embedded.writeEmbeddedObjectStart();
+    embedded.writeInt16(AcDb::kDxfInt16, 1);
+    embedded.rewindFiler();
+    CHECK(embedded.atEmbeddedObjectStart());
+    CHECK(embedded.readItem(&rb) == Acad::eOk && rb.resval.rint == 1);
+}
+
+/* Custom objects of ten fields each filed out and in, through the vector
+   filer and the arena filer; the same count of doubles as points, one
+   call a point and one call in all; and the fields as DXF items. */
+void benchmarkFields(unsigned long fieldCount)
+{
+    std::mt19937 random(1);
+    std::vector<CustomObject> objects(fieldCount / CustomObject::kFieldCount);
+    for (CustomObject& object : objects)
+    {
+        object.start = AcGePoint3d(random() % 1000, random() % 1000, 0);
+        object.end = AcGePoint3d(random() % 1000 * 0.1, 0, random() % 7);
+        object.radius = random() % 100 * 0.5;
+        object.flags = random() % 16;
+        object.owner = idOf(random() % 100000 + 1);
+        object.normal = AcGeVector3d(0, 0, 1);
+        object.color = random() % 256;
+        object.width = 0.25;
+    }
+    std::vector<CustomObject> objectsRead(objects.size());
+
+    VectorFiler vectorFiler;
+    ArenaDwgFiler arenaFiler;
+    for (bool arena : {false, true})
+    {
+        AcDbDwgFiler& filer = arena ? static_cast<AcDbDwgFiler&>(arenaFiler) : vectorFiler;
+        double writing = 1e9, reading = 1e9;
+        for (int repeat = 0; repeat < 3; ++repeat)
+        {
+            if (arena)
+                arenaFiler.clear();
+            else
+                vectorFiler.clear();
+            Stopwatch watch;
+            for (const CustomObject& object : objects)
+                object.dwgOutFields(&filer);
+            writing = std::min(writing, watch.milliseconds());
+            filer.seek(0, AcDb::kSeekFromStart);
+            watch.restart();
+            for (CustomObject& object : objectsRead)
+                object.dwgInFields(&filer);
+            reading = std::min(reading, watch.milliseconds());
+            CHECK(filer.filerStatus() == Acad::eOk && objectsRead == objects);
+        }
+        std::printf("%s, %lu fields: out %.1f ms (%.1f M fields/s), in %.1f ms (%.1f M fields/s), %.1f MB\n",
+                    arena ? "ArenaDwgFiler" : "vector filer", fieldCount, writing, fieldCount / 1e3 / writing,
+                    reading, fieldCount / 1e3 / reading,
+                    (arena ? arenaFiler.arena().size() : vectorFiler.size()) / 1e6);
+    }
+
+    std::vector<AcGePoint3d> points(fieldCount / 3);
+    for (AcGePoint3d& point : points)
+        point = AcGePoint3d(random() % 1000, random() % 1000, random() % 1000);
+    std::vector<AcGePoint3d> pointsRead(points.size());
+    AcDbDwgFiler& filer = arenaFiler;
+    double perPointOut = 1e9, perPointIn = 1e9, bulkOut = 1e9, bulkIn = 1e9;
+    for (int repeat = 0; repeat < 3; ++repeat)
+    {
+        arenaFiler.clear();
+        Stopwatch watch;
+        for (const AcGePoint3d& point : points)
+            filer.writePoint3d(point);
+        perPointOut = std::min(perPointOut, watch.milliseconds());
+        filer.seek(0, AcDb::kSeekFromStart);
+        watch.restart();
+        for (AcGePoint3d& point : pointsRead)
+            filer.readPoint3d(&point);
+        perPointIn = std::min(perPointIn, watch.milliseconds());
+        CHECK(pointsRead == points);
+
+        arenaFiler.clear();
+        watch.restart();
+        arenaFiler.writePoint3ds(points.data(), points.size());
+        bulkOut = std::min(bulkOut, watch.milliseconds());
+        filer.seek(0, AcDb::kSeekFromStart);
+        watch.restart();
+        arenaFiler.readPoint3ds(pointsRead.data(), pointsRead.size());
+        bulkIn = std::min(bulkIn, watch.milliseconds());
+        CHECK(pointsRead == points);
+    }
+    std::printf("%zu points: per point out %.2f ms, in %.2f ms; in one call out %.2f ms, in %.2f ms\n",
+                points.size(), perPointOut, perPointIn, bulkOut, bulkIn);
+
+    ArenaDxfFiler dxfFiler;
+    Stopwatch watch;
+    for (const CustomObject& object : objects)
+    {
+        dxfFiler.writeInt16(AcDb::kDxfInt16, object.version);
+        dxfFiler.writePoint3d(AcDb::kDxfXCoord, object.start);
+        dxfFiler.writePoint3d(AcDb::kDxfXCoord, object.end);
+        dxfFiler.writeDouble(AcDb::kDxfReal, object.radius);
+        dxfFiler.writeInt32(AcDb::kDxfInt32, object.flags);
+        dxfFiler.writeBool(AcDb::kDxfBool, object.visible);
+        dxfFiler.writeObjectId(AcDb::kDxfSoftPointerId, object.owner);
+        dxfFiler.writeVector3d(AcDb::kDxfXCoord, object.normal);
+        dxfFiler.writeUInt32(AcDb::kDxfInt32, object.color);
+        dxfFiler.writeDouble(AcDb::kDxfReal, object.width);
+    }
+    const double writing = watch.milliseconds();
+    dxfFiler.rewindFiler();
+    resbuf rb;
+    size_t items = 0;
+    watch.restart();
+    while (dxfFiler.readItem(&rb) == Acad::eOk)
+        ++items;
+    const double reading = watch.milliseconds();
+    CHECK(items == objects.size() * CustomObject::kFieldCount);
+    std::printf("ArenaDxfFiler, %zu items: out %.1f ms, in %.1f ms, %.1f MB\n", items, writing, reading,
+                dxfFiler.arena().size() / 1e6);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testVarInts();
+    testDwgRoundTrip();
+    testDwgErrors();
+    testDxfRoundTrip();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkFields(sizeArgument(argc, argv, 0, 200000));
+
+    return finish();
+}
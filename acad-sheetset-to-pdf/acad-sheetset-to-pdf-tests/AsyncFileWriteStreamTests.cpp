@@ -0,0 +1,175 @@
+#include "stdafx.h"
+#include "AsyncFileWriteStream.h"
+#include "ReadWriteStreams.h"
+
+#include <algorithm>
+#include <random>
+
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+const char kFile[] = "AsyncFileWriteStreamTests.bin";
+const wchar_t kFileName[] = L"AsyncFileWriteStreamTests.bin";
+const char kOtherFile[] = "AsyncFileWriteStreamTests.2.bin";
+const wchar_t kOtherFileName[] = L"AsyncFileWriteStreamTests.2.bin";
+
+std::vector<Adesk::UInt8> randomBytes(size_t size)
+{
+    std::mt19937 random(1);
+    std::vector<Adesk::UInt8> bytes(size);
+    for (Adesk::UInt8& byte : bytes)
+        byte = Adesk::UInt8(random());
+    return bytes;
+}
+
+/* Writes of every size through two small buffers, with flushes among
+   them, make the file in order; the stream says what it holds and what
+   is still to be written, and closes once. */
+void testRoundTrip()
+{
+    const std::vector<Adesk::UInt8> bytes = randomBytes(8 << 20);
+    AsyncFileWriteStreamSettings settings;
+    settings.bufferSize = 64 << 10;
+    settings.bufferCount = 2;
+    AsyncFileWriteStream output(settings);
+    CHECK(output.tell() == -1);
+    CHECK(output.control(AsyncFileWriteStream::kStatus) == IAcReadStream::eNotOpen);
+
+    CHECK(output.create(kFileName) == Acad::eOk && output.isOpen());
+    std::mt19937 random(3);
+    size_t written = 0;
+    for (size_t at = 0; at < bytes.size(); at += written)
+    {
+        const size_t piece = std::min<size_t>(bytes.size() - at, random() % 4 == 0 ? random() % 300000
+                                                                                    : random() % 300);
+        CHECK(output.write(bytes.data() + at, piece, &written) == IAcWriteStream::eOk && written == piece);
+        if (random() % 5000 == 0)
+        {
+            CHECK(output.flushBuffers() == IAcWriteStream::eOk);
+            CHECK(output.control(AsyncFileWriteStream::kPendingBytes) == 0);
+        }
+    }
+    CHECK(output.tell() == Adesk::Int64(bytes.size()));
+    CHECK(output.control(AsyncFileWriteStream::kDrain) == IAcReadStream::eOk);
+    CHECK(output.control(AsyncFileWriteStream::kPendingBytes) == 0);
+    CHECK(output.close() == IAcReadStream::eOk && !output.isOpen());
+    CHECK(output.close() == IAcReadStream::eNotOpen);
+    const std::string file = readFile(kFile);
+    CHECK(file.size() == bytes.size() && std::equal(bytes.begin(), bytes.end(), file.begin(),
+                                                    [](Adesk::UInt8 a, char b) { return a == Adesk::UInt8(b); }));
+
+    size_t read = 0;
+    char buffer[1];
+    CHECK(output.read(buffer, 1, &read) == IAcReadStream::eNotSupported);
+}
+
+/* Creating another file finishes the first, and destroying the stream
+   finishes the second. */
+void testReopen()
+{
+    {
+        AsyncFileWriteStream output;
+        size_t written = 0;
+        CHECK(output.create(kFileName) == Acad::eOk);
+        output.write("abc", 3, &written);
+        CHECK(output.create(kOtherFileName) == Acad::eOk);
+        output.write("de", 2, &written);
+        CHECK(output.tell() == 2);
+    }
+    CHECK(readFile(kFile) == "abc" && readFile(kOtherFile) == "de");
+    std::remove(kFile);
+    std::remove(kOtherFile);
+
+    AsyncFileWriteStream missing;
+    CHECK(missing.create(L"AsyncFileWriteStreamTests.missing/file.bin") != Acad::eOk && !missing.isOpen());
+}
+
+/* A disk that fills up shows on the producer's side: control() reports
+   it, waiting for the writer or not, and every later call returns it. */
+void testErrorsSurface()
+{
+#ifndef _WIN32
+    /* /dev/full fails every write with ENOSPC. */
+    AsyncFileWriteStreamSettings settings;
+    settings.bufferSize = 4096;
+    AsyncFileWriteStream output(settings);
+    CHECK(output.create(L"/dev/full") == Acad::eOk);
+    const std::vector<Adesk::UInt8> bytes = randomBytes(10000);
+    size_t written = 0;
+    int status = IAcWriteStream::eOk;
+    for (int i = 0; i < 100 && status == IAcWriteStream::eOk; ++i)
+        status = output.write(bytes.data(), bytes.size(), &written);
+    CHECK(output.control(AsyncFileWriteStream::kDrain) == IAcReadStream::eDiskFull);
+    CHECK(output.control(AsyncFileWriteStream::kStatus) == IAcReadStream::eDiskFull);
+    CHECK(output.write("x", 1, &written) == IAcReadStream::eDiskFull && written == 0);
+    CHECK(output.flushBuffers() == IAcReadStream::eDiskFull);
+    CHECK(output.close() == IAcReadStream::eDiskFull);
+#endif
+}
+
+/* Megabytes written 256 bytes at a time through BufferedFileWriteStream
+   and through AsyncFileWriteStream: throughput, and how long write()
+   keeps the producer. */
+void benchmarkWrites(unsigned long megabytes)
+{
+    const std::vector<Adesk::UInt8> bytes = randomBytes(size_t(megabytes) << 20);
+    std::vector<double> latencies;
+    latencies.reserve(bytes.size() / 256);
+
+    for (bool async : {false, true})
+    {
+        BufferedFileWriteStream buffered(4 << 20);
+        AsyncFileWriteStream asynchronous;
+        IAcWriteStream& output = async ? static_cast<IAcWriteStream&>(asynchronous) : buffered;
+        if (async)
+            asynchronous.create(kFileName);
+        else
+            buffered.create(kFileName);
+
+        latencies.clear();
+        size_t written = 0;
+        Stopwatch total;
+        Stopwatch call;
+        for (size_t at = 0; at + 256 <= bytes.size(); at += 256)
+        {
+            call.restart();
+            output.write(bytes.data() + at, 256, &written);
+            latencies.push_back(call.milliseconds());
+        }
+        call.restart();
+        CHECK(output.close() == IAcReadStream::eOk);
+        const double closing = call.milliseconds();
+        const double elapsed = total.milliseconds();
+
+        std::sort(latencies.begin(), latencies.end());
+        std::printf("%s, %lu MB in 256 B writes: %.0f MB/s, write p50 %.0f ns, p99 %.0f ns, p99.99 %.1f us, "
+                    "max %.2f ms, close %.2f ms",
+                    async ? "AsyncFileWriteStream" : "BufferedFileWriteStream", megabytes,
+                    bytes.size() / 1e3 / elapsed, latencies[latencies.size() / 2] * 1e6,
+                    latencies[latencies.size() * 99 / 100] * 1e6, latencies[latencies.size() * 9999 / 10000] * 1e3,
+                    latencies.back(), closing);
+        if (async)
+            std::printf(", %llu stalls", static_cast<unsigned long long>(asynchronous.stallCount()));
+        std::printf("\n");
+    }
+    std::remove(kFile);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testRoundTrip();
+    testReopen();
+    testErrorsSurface();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkWrites(sizeArgument(argc, argv, 0, 32));
+
+    std::remove(kFile);
+    return finish();
+}
@@ -0,0 +1,404 @@
+#include "stdafx.h"
+#include "AsyncPlotLogger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+const char kLogFile[] = "AsyncPlotLoggerTests.log";
+
+/// <summary>
+/// Keeps what is written in memory, taking delayMilliseconds per write as
+/// a congested log share would.
+/// </summary>
+class StubLogSink : public PlotLogSink
+{
+public:
+    Acad::ErrorStatus write(const char* pData, size_t size) override
+    {
+        if (delayMilliseconds != 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(delayMilliseconds));
+        data.append(pData, size);
+        ++writes;
+        return Acad::eOk;
+    }
+    Acad::ErrorStatus flush() override
+    {
+        ++flushes;
+        return Acad::eOk;
+    }
+
+    std::string data;
+    unsigned delayMilliseconds = 0;
+    int writes = 0;
+    int flushes = 0;
+};
+
+bool contains(const std::string& text, const char* part)
+{
+    return text.find(part) != std::string::npos;
+}
+
+/// <summary>
+/// The line of text that contains part, without its newline.
+/// </summary>
+std::string lineWith(const std::string& text, const char* part)
+{
+    const size_t found = text.find(part);
+    if (found == std::string::npos)
+        return std::string();
+    const size_t start = text.rfind('\n', found) == std::string::npos ? 0 : text.rfind('\n', found) + 1;
+    return text.substr(start, text.find('\n', found) - start);
+}
+
+/* On Windows the exception is real and the __except block ends it, after
+   the vectored handlers have seen it; the stub RaiseException only calls
+   the handlers. */
+void raiseStructuredException(DWORD code)
+{
+#ifdef _MSC_VER
+    __try
+    {
+        ::RaiseException(code, 0, 0, nullptr);
+    }
+    __except (EXCEPTION_EXECUTE_HANDLER)
+    {
+    }
+#else
+    ::RaiseException(code, 0, 0, nullptr);
+#endif
+}
+
+/* With the wait policy nothing is lost however many threads log, and the
+   records of each thread stay in the order it logged them. */
+void testWaitPolicyKeepsEverything()
+{
+    const int kThreads = 4;
+    const int kRecords = 20000;
+    StubLogSink sink;
+    AsyncPlotLoggerSettings settings;
+    settings.capacity = 256;
+    settings.overflow = kPlotLogWait;
+    {
+        AsyncPlotLogger logger(sink, settings);
+        logger.startJob();
+        logger.startSheet();
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t)
+        {
+            threads.emplace_back([&logger, t] {
+                ACHAR message[64];
+                for (int i = 0; i < kRecords; ++i)
+                {
+                    swprintf(message, 64, ACRX_T("t%d %d"), t, i);
+                    logger.log(kPlotLogMessage, ACRX_T("test"), message);
+                }
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        CHECK(logger.flush() == Acad::eOk);
+        CHECK(logger.discardedCount() == 0);
+    }
+
+    int counts[kThreads] = {};
+    bool ordered = true;
+    for (size_t pos = 0; (pos = sink.data.find("\"message\":\"t", pos)) != std::string::npos; ++pos)
+    {
+        int thread = -1, index = -1;
+        if (std::sscanf(sink.data.c_str() + pos + 12, "%d %d", &thread, &index) != 2 || thread < 0 ||
+            thread >= kThreads)
+        {
+            ordered = false;
+            continue;
+        }
+        if (index != counts[thread])
+            ordered = false;
+        ++counts[thread];
+    }
+    for (int count : counts)
+        CHECK(count == kRecords);
+    CHECK(ordered);
+    CHECK(sink.writes < kThreads * kRecords / 10);
+}
+
+/* A slow sink with the discard policy loses records but not the logging
+   thread's time, and says how many it lost. */
+void testDiscardPolicyReportsLosses()
+{
+    StubLogSink sink;
+    sink.delayMilliseconds = 20;
+    AsyncPlotLoggerSettings settings;
+    settings.capacity = 64;
+    settings.overflow = kPlotLogDiscard;
+    AsyncPlotLogger logger(sink, settings);
+    logger.startJob();
+
+    Stopwatch watch;
+    for (int i = 0; i < 1000; ++i)
+        logger.logInformation(ACRX_T("x"));
+    CHECK(watch.milliseconds() < 1000);
+    CHECK(logger.discardedCount() > 0);
+    CHECK(!logger.errorHasHappenedInJob());
+
+    /* The policy drops errors too while the ring is full. */
+    logger.flush();
+    logger.logError(ACRX_T("bad \"quote\" \x00e9\x4e2d\n"));
+    CHECK(logger.errorHasHappenedInJob());
+    CHECK(logger.flush() == Acad::eOk);
+    CHECK(contains(sink.data, "\"discarded\":"));
+    const std::string line = lineWith(sink.data, "bad");
+    CHECK(contains(line, "\"level\":\"error\""));
+    CHECK(contains(line, "\"category\":\"plot\""));
+    CHECK(contains(line, "\"message\":\"bad \\\"quote\\\" \xc3\xa9\xe4\xb8\xad\\n\""));
+}
+
+void testLongTextIsTruncated()
+{
+    StubLogSink sink;
+    AsyncPlotLogger logger(sink);
+    const std::wstring message(AsyncPlotLogger::kPlotLogMessageCapacity + 10, L'm');
+    logger.log(kPlotLogWarning, ACRX_T("long"), message.c_str());
+    logger.log(kPlotLogWarning, ACRX_T("short"), ACRX_T("fits"));
+    CHECK(logger.flush() == Acad::eOk);
+    const std::string longLine = lineWith(sink.data, "\"category\":\"long\"");
+    CHECK(contains(longLine, "\"truncated\":true"));
+    CHECK(contains(longLine, ("\"" + std::string(AsyncPlotLogger::kPlotLogMessageCapacity, 'm') + "\"").c_str()));
+    CHECK(!contains(lineWith(sink.data, "fits"), "truncated"));
+    CHECK(logger.log(PlotLogLevel(kPlotLogInformation + 1), ACRX_T("x"), ACRX_T("x")) == Acad::eInvalidInput);
+}
+
+/* Jobs and sheets are counted into every record, and the error and
+   warning flags start over with each. */
+void testJobAndSheetFields()
+{
+    StubLogSink sink;
+    AsyncPlotLogger logger(sink);
+    logger.startJob();
+    logger.startSheet();
+    logger.logWarning(ACRX_T("first sheet"));
+    CHECK(logger.warningHasHappenedInSheet());
+    CHECK(!logger.errorHasHappenedInSheet());
+    logger.endSheet();
+    logger.startSheet();
+    CHECK(!logger.warningHasHappenedInSheet());
+    CHECK(logger.warningHasHappenedInJob());
+    logger.logSevereError(ACRX_T("second sheet"));
+    CHECK(logger.errorHasHappenedInSheet());
+    logger.endSheet();
+    CHECK(logger.endJob() == Acad::eOk);
+    CHECK(contains(sink.data, "second sheet"));
+
+    logger.startJob();
+    CHECK(!logger.errorHasHappenedInJob());
+    CHECK(!logger.warningHasHappenedInJob());
+    logger.startSheet();
+    logger.logMessage(ACRX_T("next job"));
+    logger.endJob();
+
+    CHECK(contains(lineWith(sink.data, "first sheet"), "\"job\":1,\"sheet\":1"));
+    CHECK(contains(lineWith(sink.data, "second sheet"), "\"job\":1,\"sheet\":2"));
+    CHECK(contains(lineWith(sink.data, "second sheet"), "\"level\":\"severe\""));
+    CHECK(contains(lineWith(sink.data, "next job"), "\"job\":2,\"sheet\":1"));
+}
+
+/* Records at the flush level are in the sink before the call returns; the
+   rest wait for the writer thread. */
+void testFlushLevel()
+{
+    StubLogSink sink;
+    AsyncPlotLoggerSettings settings;
+    settings.drainIntervalMilliseconds = 60000;
+    settings.flushLevel = kPlotLogError;
+    AsyncPlotLogger logger(sink, settings);
+    logger.logWarning(ACRX_T("warning"));
+    CHECK(!contains(sink.data, "warning"));
+    logger.logError(ACRX_T("error"));
+    CHECK(contains(sink.data, "\"message\":\"warning\""));
+    CHECK(contains(sink.data, "\"message\":\"error\""));
+    CHECK(sink.flushes > 0);
+    logger.logTerminalError(ACRX_T("terminal"));
+    CHECK(contains(sink.data, "\"level\":\"terminal\""));
+}
+
+/* A fatal exception writes out what is queued; other exceptions, and a
+   logger that has not asked for it, are left alone. */
+void testCrashFlush()
+{
+    StubLogSink sink;
+    AsyncPlotLoggerSettings settings;
+    settings.drainIntervalMilliseconds = 60000;
+    AsyncPlotLogger logger(sink, settings);
+    logger.logWarning(ACRX_T("before crash"));
+    raiseStructuredException(EXCEPTION_ACCESS_VIOLATION);
+    CHECK(!contains(sink.data, "before crash"));
+
+    logger.enableCrashFlush(true);
+    raiseStructuredException(0xE06D7363);
+    CHECK(!contains(sink.data, "before crash"));
+    raiseStructuredException(EXCEPTION_ACCESS_VIOLATION);
+    CHECK(contains(sink.data, "before crash"));
+
+    logger.logWarning(ACRX_T("after crash"));
+    logger.enableCrashFlush(false);
+    raiseStructuredException(EXCEPTION_ACCESS_VIOLATION);
+    CHECK(!contains(sink.data, "after crash"));
+}
+
+/* An exception while the writer is stuck in a slow write costs the thread
+   that takes it 50 ms, not the wait for the write; what the writer has not
+   taken yet stays queued. */
+void testCrashFlushDoesNotWaitForTheWriter()
+{
+    StubLogSink sink;
+    sink.delayMilliseconds = 600;
+    AsyncPlotLoggerSettings settings;
+    settings.drainIntervalMilliseconds = 1;
+    AsyncPlotLogger logger(sink, settings);
+    logger.enableCrashFlush(true);
+    logger.logWarning(ACRX_T("being written"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    logger.logWarning(ACRX_T("still queued"));
+
+    Stopwatch watch;
+    raiseStructuredException(EXCEPTION_ACCESS_VIOLATION);
+    CHECK(watch.milliseconds() < 400);
+    logger.flush();
+    CHECK(contains(sink.data, "still queued"));
+    logger.enableCrashFlush(false);
+}
+
+/* Loggers destroyed while other threads take exceptions are never flushed
+   after they are gone. */
+void testCrashFlushWhileLoggersComeAndGo()
+{
+    std::atomic<bool> stop(false);
+    std::thread crashing([&stop]
+    {
+        while (!stop.load())
+            raiseStructuredException(EXCEPTION_ACCESS_VIOLATION);
+    });
+    AsyncPlotLoggerSettings settings;
+    settings.drainIntervalMilliseconds = 1;
+    size_t written = 0;
+    for (int i = 0; i < 200; ++i)
+    {
+        StubLogSink sink;
+        {
+            AsyncPlotLogger logger(sink, settings);
+            logger.enableCrashFlush(true);
+            logger.logWarning(ACRX_T("short lived"));
+        }
+        written += contains(sink.data, "short lived") ? 1 : 0;
+    }
+    stop.store(true);
+    crashing.join();
+    CHECK(written == 200);
+}
+
+void testInstalledPlotLog()
+{
+    std::remove(kLogFile);
+    {
+        InstalledPlotLog log;
+        CHECK(!log.isInstalled());
+        CHECK(log.install(nullptr) == Acad::eNullPtr);
+        CHECK(log.install(ACRX_T("AsyncPlotLoggerTests.log")) == Acad::eOk);
+        CHECK(log.isInstalled());
+        log.logger()->startJob();
+        log.logger()->logError(ACRX_T("installed"));
+        log.uninstall();
+        CHECK(!log.isInstalled());
+    }
+    CHECK(contains(readFile(kLogFile), "\"message\":\"installed\""));
+    std::remove(kLogFile);
+
+    CHECK(arx_stubs::sendAppMessage(AcRx::kInitAppMsg));
+    arx_stubs::queueEditorInput(ACRX_T("AsyncPlotLoggerTests.log"));
+    CHECK(arx_stubs::runCommand(ACRX_T("SHEETSETTOPDFPLOTLOG")));
+    CHECK(fileExists(kLogFile));
+    arx_stubs::queueEditorInput(ACRX_T(""));
+    CHECK(arx_stubs::runCommand(ACRX_T("SHEETSETTOPDFPLOTLOG")));
+    CHECK(arx_stubs::sendAppMessage(AcRx::kUnloadAppMsg));
+    std::remove(kLogFile);
+}
+
+/// <summary>
+/// Writes every record before returning, as AutoCAD's own logger does.
+/// </summary>
+class SynchronousPlotLogger
+{
+public:
+    explicit SynchronousPlotLogger(PlotLogSink& sink) : m_sink(sink) {}
+
+    void logMessage(const ACHAR* pMessage)
+    {
+        char line[256];
+        const int length = std::snprintf(line, sizeof(line), "{\"message\":\"%ls\"}\n", pMessage);
+        m_sink.write(line, size_t(length));
+    }
+
+private:
+    PlotLogSink& m_sink;
+};
+
+/* What a logging call costs the plot thread when every write to the log
+   takes 2 ms. */
+void benchmarkLatency(unsigned long records)
+{
+    for (int async = 0; async < 2; ++async)
+    {
+        StubLogSink sink;
+        sink.delayMilliseconds = 2;
+        AsyncPlotLoggerSettings settings;
+        settings.capacity = 4096;
+        AsyncPlotLogger asyncLogger(sink, settings);
+        SynchronousPlotLogger syncLogger(sink);
+
+        double total = 0, worst = 0;
+        for (unsigned long i = 0; i < records; ++i)
+        {
+            Stopwatch watch;
+            if (async != 0)
+                asyncLogger.logMessage(ACRX_T("sheet plotted"));
+            else
+                syncLogger.logMessage(ACRX_T("sheet plotted"));
+            const double microseconds = watch.milliseconds() * 1000;
+            total += microseconds;
+            worst = std::max(worst, microseconds);
+            if (i % 10 == 0)
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        asyncLogger.flush();
+        std::printf("%s logging to a 2 ms sink, %lu records: mean %.2f us, worst %.1f us, %d writes\n",
+                    async != 0 ? "asynchronous" : "synchronous", records, total / records, worst, sink.writes);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testWaitPolicyKeepsEverything();
+    testDiscardPolicyReportsLosses();
+    testLongTextIsTruncated();
+    testJobAndSheetFields();
+    testFlushLevel();
+    testCrashFlush();
+    testCrashFlushDoesNotWaitForTheWriter();
+    testCrashFlushWhileLoggersComeAndGo();
+    testInstalledPlotLog();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkLatency(sizeArgument(argc, argv, 0, 500));
+
+    return finish();
+}
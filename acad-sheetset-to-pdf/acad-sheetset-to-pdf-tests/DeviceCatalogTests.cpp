@@ -0,0 +1,338 @@
+#include "stdafx.h"
+#include "DeviceCatalog.h"
+
+#include <filesystem>
+#include <thread>
+
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+const char kPc3File[] = "DeviceCatalogTests.pc3";
+const char kCatalogFile[] = "DeviceCatalogTests.pmc";
+const char kCacheDirectory[] = "DeviceCatalogTests.cache";
+
+std::wstring mediaName(int index)
+{
+    return L"ISO_full_bleed_" + std::to_wstring(index) + L"_(420.00_x_594.00_MM)";
+}
+
+wchar_t* newString(const std::wstring& text)
+{
+    wchar_t* pText = new wchar_t[text.size() + 1];
+    std::wcscpy(pText, text.c_str());
+    return pText;
+}
+
+/* Busy, as a driver answering a query is, rather than asleep. */
+void spin(unsigned microseconds)
+{
+    const auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(microseconds);
+    while (std::chrono::steady_clock::now() < end)
+    {
+    }
+}
+
+/// <summary>
+/// A device with mediaCount media sizes that takes queryMicroseconds per
+/// query, as a driver reading its PC3 and PMP files does, and per media
+/// name for the list.  Media i is 420 + i by 594 with 5 margins.
+/// </summary>
+class StubPlotConfig : public AcPlPlotConfig
+{
+public:
+    StubPlotConfig(int media, const wchar_t* deviceName, const wchar_t* pc3Path) : mediaCount(media)
+    {
+        name = deviceName;
+        path = pc3Path;
+        dpi = 1200;
+    }
+
+    void getCanonicalMediaNameList(AcArray<ACHAR*>& mediaList) const override
+    {
+        ++calls;
+        spin(queryMicroseconds * mediaCount);
+        for (int i = 0; i < mediaCount; ++i)
+            mediaList.append(newString(mediaName(i)));
+    }
+    void getLocalMediaName(const ACHAR* pCanonicalName, ACHAR*& pLocalName) const override
+    {
+        ++calls;
+        spin(queryMicroseconds);
+        pLocalName = newString(std::wstring(L"Local ") + pCanonicalName);
+    }
+    void getMediaBounds(const ACHAR* pCanonicalName, AcGePoint2d& pageSize,
+                        AcGeBoundBlock2d& printableArea) const override
+    {
+        ++calls;
+        spin(queryMicroseconds);
+        const int index = std::wcstol(pCanonicalName + 15, nullptr, 10);
+        pageSize.set(420 + index, 594);
+        printableArea.set(AcGePoint2d(5, 5), AcGePoint2d(415 + index, 589));
+    }
+
+    int mediaCount;
+    unsigned queryMicroseconds = 0;
+    mutable long calls = 0;
+};
+
+void writePc3(const char* content)
+{
+    std::FILE* pFile = std::fopen(kPc3File, "wb");
+    std::fputs(content, pFile);
+    std::fclose(pFile);
+}
+
+/* Every answer of the catalog is the device's. */
+void checkMatchesDevice(const DeviceCatalog& catalog, const StubPlotConfig& config)
+{
+    CHECK(catalog.mediaCount() == size_t(config.mediaCount));
+    CHECK(catalog.maxDeviceDPI() == 1200);
+    CHECK(std::wstring(catalog.deviceName()) == config.name);
+    CHECK(std::wstring(catalog.fullPath()) == config.path);
+    for (int i = 0; i < config.mediaCount; ++i)
+    {
+        const std::wstring name = mediaName(i);
+        DeviceMedia media;
+        CHECK(catalog.findMedia(name.c_str(), media));
+        CHECK(std::wstring(media.canonicalName) == name);
+        CHECK(std::wstring(media.localName) == L"Local " + name);
+        CHECK(catalog.localMediaName(name.c_str()) == std::wstring(L"Local ") + name);
+
+        AcGePoint2d pageSize, printableMin, printableMax;
+        AcGeBoundBlock2d printableArea;
+        CHECK(catalog.getMediaBounds(name.c_str(), pageSize, printableArea));
+        printableArea.getMinMaxPoints(printableMin, printableMax);
+        CHECK(pageSize.x == 420 + i && pageSize.y == 594);
+        CHECK(printableMin.x == 5 && printableMax.x == 415 + i && printableMax.y == 589);
+        CHECK(media.pageSize.x == pageSize.x && media.printableMax.x == printableMax.x);
+    }
+
+    DeviceMedia media;
+    CHECK(!catalog.findMedia(L"Letter", media));
+    CHECK(catalog.localMediaName(L"Letter") == nullptr);
+    AcGePoint2d pageSize;
+    AcGeBoundBlock2d printableArea;
+    CHECK(!catalog.getMediaBounds(L"Letter", pageSize, printableArea));
+}
+
+void testBuildSaveAndLoad()
+{
+    StubPlotConfig config(150, L"DWG To PDF.pc3", L"C:\\Plotters\\DWG To PDF.pc3");
+    std::shared_ptr<const DeviceCatalog> pBuilt;
+    CHECK(DeviceCatalog::build(config, 42, 7, pBuilt) == Acad::eOk);
+    checkMatchesDevice(*pBuilt, config);
+    CHECK(pBuilt->sourceTime() == 42 && pBuilt->sourceSize() == 7);
+
+    std::remove(kCatalogFile);
+    CHECK(pBuilt->save(ACRX_T("DeviceCatalogTests.pmc")) == Acad::eOk);
+    std::shared_ptr<const DeviceCatalog> pLoaded;
+    CHECK(DeviceCatalog::load(ACRX_T("DeviceCatalogTests.pmc"), pLoaded) == Acad::eOk);
+    checkMatchesDevice(*pLoaded, config);
+    CHECK(pLoaded->sourceTime() == 42 && pLoaded->sourceSize() == 7);
+
+    /* A catalog that is not intact is refused, whatever byte was hit. */
+    const std::string image = readFile(kCatalogFile);
+    for (size_t offset : {size_t(0), size_t(20), image.size() / 2, image.size() - 1})
+    {
+        std::string damaged = image;
+        damaged[offset] ^= 0x20;
+        std::FILE* pFile = std::fopen(kCatalogFile, "wb");
+        std::fwrite(damaged.data(), 1, damaged.size(), pFile);
+        std::fclose(pFile);
+        CHECK(DeviceCatalog::load(ACRX_T("DeviceCatalogTests.pmc"), pLoaded) == Acad::eUnsupportedFileFormat);
+    }
+    std::FILE* pFile = std::fopen(kCatalogFile, "wb");
+    std::fwrite(image.data(), 1, image.size() / 2, pFile);
+    std::fclose(pFile);
+    CHECK(DeviceCatalog::load(ACRX_T("DeviceCatalogTests.pmc"), pLoaded) == Acad::eUnsupportedFileFormat);
+    std::remove(kCatalogFile);
+    CHECK(DeviceCatalog::load(ACRX_T("DeviceCatalogTests.pmc"), pLoaded) != Acad::eOk);
+
+    StubPlotConfig none(0, L"None", L"");
+    CHECK(DeviceCatalog::build(none, 0, 0, pBuilt) == Acad::eOk);
+    checkMatchesDevice(*pBuilt, none);
+}
+
+/* The cache builds a device once per PC3 file version, and later sessions
+   map it from the cache folder. */
+void testCacheFollowsThePc3File()
+{
+    std::filesystem::remove_all(kCacheDirectory);
+    std::filesystem::create_directory(kCacheDirectory);
+    writePc3("pc3 v1");
+    StubPlotConfig config(20, L"DWG To PDF.pc3", L"DeviceCatalogTests.pc3");
+    DeviceCatalogCacheSettings settings;
+    settings.directory = L"DeviceCatalogTests.cache";
+
+    std::shared_ptr<const DeviceCatalog> pCatalog;
+    {
+        DeviceCatalogCache cache(settings);
+        CHECK(cache.catalog(config, pCatalog) == Acad::eOk);
+        checkMatchesDevice(*pCatalog, config);
+        CHECK(cache.buildCount() == 1);
+        const long calls = config.calls;
+        CHECK(cache.catalog(config, pCatalog) == Acad::eOk);
+        CHECK(cache.catalog(ACRX_T("DeviceCatalogTests.pc3"), pCatalog) == Acad::eOk);
+        CHECK(cache.catalog(ACRX_T("DEVICECATALOGTESTS.PC3"), pCatalog) == Acad::eOk);
+        CHECK(config.calls == calls);
+        CHECK(cache.memoryHitCount() == 3);
+        CHECK(cache.catalog(ACRX_T("Other.pc3"), pCatalog) == Acad::eKeyNotFound);
+    }
+
+    settings.revalidateMilliseconds = 0;
+    DeviceCatalogCache cache(settings);
+    const long calls = config.calls;
+    CHECK(cache.catalog(ACRX_T("DeviceCatalogTests.pc3"), pCatalog) == Acad::eOk);
+    CHECK(cache.diskHitCount() == 1);
+    CHECK(cache.buildCount() == 0);
+    CHECK(config.calls == calls);
+
+    writePc3("pc3 v2, with another media");
+    CHECK(cache.catalog(ACRX_T("DeviceCatalogTests.pc3"), pCatalog) == Acad::eKeyNotFound);
+    config.mediaCount = 21;
+    CHECK(cache.catalog(config, pCatalog) == Acad::eOk);
+    CHECK(cache.buildCount() == 1);
+    checkMatchesDevice(*pCatalog, config);
+
+    /* A damaged cache file is built again. */
+    for (const auto& entry : std::filesystem::directory_iterator(kCacheDirectory))
+    {
+        std::FILE* pFile = std::fopen(entry.path().string().c_str(), "r+b");
+        std::fseek(pFile, 100, SEEK_SET);
+        std::fputc('X', pFile);
+        std::fclose(pFile);
+    }
+    DeviceCatalogCache fresh(settings);
+    CHECK(fresh.catalog(config, pCatalog) == Acad::eOk);
+    CHECK(fresh.buildCount() == 1 && fresh.diskHitCount() == 0);
+    checkMatchesDevice(*pCatalog, config);
+
+    /* Devices without a PC3 file are known by name. */
+    StubPlotConfig printer(3, L"\\\\server\\plotter", L"");
+    CHECK(fresh.catalog(printer, pCatalog) == Acad::eOk);
+    DeviceCatalogCache later(settings);
+    CHECK(later.catalog(printer, pCatalog) == Acad::eOk);
+    CHECK(later.buildCount() == 0 && later.diskHitCount() == 1);
+    checkMatchesDevice(*pCatalog, printer);
+
+    later.invalidate(ACRX_T("DeviceCatalogTests.pc3"));
+    later.invalidate(ACRX_T("\\\\server\\plotter"));
+    CHECK(std::filesystem::is_empty(kCacheDirectory));
+    std::filesystem::remove_all(kCacheDirectory);
+    std::remove(kPc3File);
+}
+
+/* Any number of threads may read a catalog and ask the cache for it. */
+void testConcurrentLookups()
+{
+    StubPlotConfig config(150, L"DWG To PDF.pc3", L"");
+    DeviceCatalogCache cache;
+    std::atomic<int> wrong(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < 5000; ++i)
+            {
+                std::shared_ptr<const DeviceCatalog> pCatalog;
+                DeviceMedia media;
+                if (cache.catalog(config, pCatalog) != Acad::eOk ||
+                    !pCatalog->findMedia(mediaName((i + t) % 150).c_str(), media) ||
+                    media.pageSize.x != 420 + (i + t) % 150)
+                    ++wrong;
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    CHECK(wrong == 0);
+}
+
+/* Media lookups against a device that takes about 20 us per query, with 150
+   media, as PDF drivers have. */
+void benchmarkLookups(unsigned long lookups)
+{
+    std::filesystem::remove_all(kCacheDirectory);
+    std::filesystem::create_directory(kCacheDirectory);
+    writePc3("pc3 v1");
+    StubPlotConfig config(150, L"DWG To PDF.pc3", L"DeviceCatalogTests.pc3");
+    config.queryMicroseconds = 20;
+    std::vector<std::wstring> names;
+    for (int i = 0; i < 150; ++i)
+        names.push_back(mediaName(i));
+
+    Stopwatch watch;
+    for (int i = 0; i < 300; ++i)
+    {
+        AcGePoint2d pageSize;
+        AcGeBoundBlock2d printableArea;
+        config.getMediaBounds(names[i % 150].c_str(), pageSize, printableArea);
+    }
+    std::printf("device getMediaBounds: %.2f us\n", watch.milliseconds() * 1000 / 300);
+
+    DeviceCatalogCacheSettings settings;
+    settings.directory = L"DeviceCatalogTests.cache";
+    DeviceCatalogCache cache(settings);
+    std::shared_ptr<const DeviceCatalog> pCatalog;
+    watch.restart();
+    cache.catalog(config, pCatalog);
+    std::printf("cold build: %.2f ms\n", watch.milliseconds());
+
+    watch.restart();
+    for (unsigned long i = 0; i < lookups; ++i)
+    {
+        AcGePoint2d pageSize;
+        AcGeBoundBlock2d printableArea;
+        pCatalog->getMediaBounds(names[i % 150].c_str(), pageSize, printableArea);
+    }
+    std::printf("warm catalog getMediaBounds: %.3f us\n", watch.milliseconds() * 1000 / lookups);
+
+    watch.restart();
+    for (unsigned long i = 0; i < lookups; ++i)
+    {
+        std::shared_ptr<const DeviceCatalog> pFound;
+        cache.catalog(config, pFound);
+        AcGePoint2d pageSize;
+        AcGeBoundBlock2d printableArea;
+        pFound->getMediaBounds(names[i % 150].c_str(), pageSize, printableArea);
+    }
+    std::printf("warm cache lookup and getMediaBounds: %.3f us\n", watch.milliseconds() * 1000 / lookups);
+
+    settings.revalidateMilliseconds = 0;
+    DeviceCatalogCache session(settings);
+    watch.restart();
+    session.catalog(ACRX_T("DeviceCatalogTests.pc3"), pCatalog);
+    std::printf("loading the saved catalog in a new session: %.3f ms\n", watch.milliseconds());
+
+    watch.restart();
+    for (unsigned long i = 0; i < lookups; ++i)
+    {
+        std::shared_ptr<const DeviceCatalog> pFound;
+        session.catalog(ACRX_T("DeviceCatalogTests.pc3"), pFound);
+        AcGePoint2d pageSize;
+        AcGeBoundBlock2d printableArea;
+        pFound->getMediaBounds(names[i % 150].c_str(), pageSize, printableArea);
+    }
+    std::printf("the same, checking the PC3 file on every lookup: %.3f us\n", watch.milliseconds() * 1000 / lookups);
+
+    std::filesystem::remove_all(kCacheDirectory);
+    std::remove(kPc3File);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testBuildSaveAndLoad();
+    testCacheFollowsThePc3File();
+    testConcurrentLookups();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkLookups(sizeArgument(argc, argv, 0, 200000));
+
+    return finish();
+}
@@ -0,0 +1,234 @@
+#include "stdafx.h"
+#include "DrawStreamBuilder.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <random>
+
+#include "StubWorkloads.h"
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+/// <summary>
+/// Streams of 400 drawables spread over 4 databases, one in ten with no
+/// owner, each costing 200 to 2200 iterations of the stub builder.
+/// </summary>
+struct StreamWorkload
+{
+    explicit StreamWorkload(size_t streamCount) : owners(400), streams(streamCount)
+    {
+        std::mt19937 random(3);
+        for (size_t i = 0; i < owners.size(); ++i)
+        {
+            owners[i].stubId.stubHandle = i + 1;
+            owners[i].stubId.pStubDatabase = &databases[i % 4];
+        }
+        for (AcGiDrawStream& stream : streams)
+        {
+            if (random() % 10 != 0)
+                stream.setOwner(&owners[random() % owners.size()]);
+            stream.stubWork = 200 + random() % 2000;
+            array.append(&stream);
+        }
+    }
+
+    size_t ownerless() const
+    {
+        size_t count = 0;
+        for (const AcGiDrawStream& stream : streams)
+            count += stream.getOwner() == nullptr ? 1 : 0;
+        return count;
+    }
+
+    AcDbDatabase databases[4];
+    std::vector<StubDrawable> owners;
+    std::vector<AcGiDrawStream> streams;
+    AcArray<AcGiDrawStream*> array;
+};
+
+/* What the builder below saw: whether two builds of one database ran at
+   once, and how many builds there were.  Streams whose work is a multiple
+   of s_failEvery make their build fail. */
+std::mutex s_mutex;
+std::map<AcDbDatabase*, int> s_building;
+std::atomic<bool> s_overlapped(false);
+std::atomic<int> s_builds(0);
+unsigned s_failEvery = 0;
+
+bool checkingBuilder(const AcArray<AcGiDrawStream*>& streamArray, GraphicsUpdateProc lpFunc)
+{
+    AcDbDatabase* pDatabase = nullptr;
+    if (streamArray.length() > 0 && streamArray[0]->getOwner() != nullptr)
+        pDatabase = streamArray[0]->getOwner()->id().database();
+    if (pDatabase != nullptr)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (s_building[pDatabase]++ > 0)
+            s_overlapped = true;
+    }
+    ++s_builds;
+
+    bool built = arx_stubs::buildDrawStreams(streamArray, lpFunc);
+    for (AcGiDrawStream* pStream : streamArray)
+        built = built && (s_failEvery == 0 || pStream->stubWork % s_failEvery != 0);
+
+    if (pDatabase != nullptr)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        --s_building[pDatabase];
+    }
+    return built;
+}
+
+std::atomic<int> s_updates(0);
+
+bool countUpdate(const AcArray<AcGiDrawable*>&)
+{
+    ++s_updates;
+    return true;
+}
+
+/* By owner, every owner is a group and so is every ownerless stream; by
+   database, the 400 owners make 4.  Groups keep array order and null
+   streams are left out. */
+void testPartition()
+{
+    StreamWorkload workload(5000);
+    workload.array.append(nullptr);
+    const size_t ownerless = workload.ownerless();
+
+    DrawStreamGroups groups;
+    DrawStreamBuilder::partition(workload.array, DrawStreamBuilder::kByOwner, groups);
+    CHECK(groups.size() == workload.owners.size() + ownerless);
+    CHECK(groups.streams.size() == workload.streams.size());
+    for (size_t g = 0; g < groups.size(); ++g)
+    {
+        for (size_t k = groups.offsets[g] + 1; k < groups.offsets[g + 1]; ++k)
+        {
+            CHECK(groups.streams[k - 1] < groups.streams[k]);
+            CHECK(workload.streams[groups.streams[k]].getOwner() == workload.streams[groups.streams[k - 1]].getOwner());
+        }
+    }
+
+    DrawStreamBuilder::partition(workload.array, DrawStreamBuilder::kByDatabase, groups);
+    CHECK(groups.size() == 4 + ownerless);
+    CHECK(groups.streams.size() == workload.streams.size());
+}
+
+/* The output is the same bytes for any number of threads and either
+   partition, and again on a second build; no database is built by two
+   threads at once, and every group calls lpFunc once. */
+void testSameOutput()
+{
+    StreamWorkload workload(3000);
+    arx_stubs::drawStreamBuilder = &checkingBuilder;
+
+    StubWriteStream expected;
+    {
+        DrawStreamBuilder builder(1, DrawStreamBuilder::kByOwner);
+        CHECK(builder.build(workload.array, nullptr, &expected));
+    }
+    size_t bytes = 0;
+    for (const AcGiDrawStream& stream : workload.streams)
+        bytes += 8 + stream.stubGraphics.size();
+    CHECK(expected.stubBytes.size() == bytes);
+
+    for (unsigned threads : {2u, 3u, 8u})
+    {
+        for (DrawStreamBuilder::Partition partition : {DrawStreamBuilder::kByOwner, DrawStreamBuilder::kByDatabase})
+        {
+            s_overlapped = false;
+            s_updates = 0;
+            DrawStreamBuilder builder(threads, partition);
+            StubWriteStream output;
+            CHECK(builder.build(workload.array, &countUpdate, &output));
+            CHECK(output.stubBytes == expected.stubBytes);
+            CHECK(size_t(s_updates) == builder.groups().size());
+            StubWriteStream again;
+            CHECK(builder.build(workload.array, nullptr, &again));
+            CHECK(again.stubBytes == expected.stubBytes);
+            if (partition == DrawStreamBuilder::kByDatabase)
+                CHECK(!s_overlapped);
+        }
+    }
+
+    arx_stubs::drawStreamBuilder = &arx_stubs::buildDrawStreams;
+}
+
+/* A group whose build fails is not built, the others are; an output that
+   fills up stops the streams from there on. */
+void testFailures()
+{
+    StreamWorkload workload(2000);
+    arx_stubs::drawStreamBuilder = &checkingBuilder;
+    s_failEvery = 97;
+
+    DrawStreamBuilder builder(4, DrawStreamBuilder::kByOwner);
+    StubWriteStream output;
+    CHECK(!builder.build(workload.array, nullptr, &output));
+    const DrawStreamGroups& groups = builder.groups();
+    for (size_t g = 0; g < groups.size(); ++g)
+    {
+        bool fails = false;
+        for (size_t k = groups.offsets[g]; k < groups.offsets[g + 1]; ++k)
+            fails = fails || workload.streams[groups.streams[k]].stubWork % s_failEvery == 0;
+        for (size_t k = groups.offsets[g]; k < groups.offsets[g + 1]; ++k)
+            CHECK(builder.built()[groups.streams[k]] == (fails ? 0 : 1));
+    }
+    s_failEvery = 0;
+    arx_stubs::drawStreamBuilder = &arx_stubs::buildDrawStreams;
+
+    StubWriteStream full;
+    full.stubFailAfter = 10000;
+    CHECK(!builder.build(workload.array, nullptr, &full));
+    size_t written = 0;
+    bool stopped = false;
+    for (size_t i = 0; i < workload.streams.size(); ++i)
+    {
+        if (builder.built()[i])
+        {
+            CHECK(!stopped);
+            written += 8 + workload.streams[i].stubGraphics.size();
+        }
+        stopped = stopped || !builder.built()[i];
+    }
+    CHECK(stopped && written <= full.stubFailAfter);
+}
+
+/* The streams built and serialized on 1, 2, 4 and 8 threads. */
+void benchmarkThreads(unsigned long streamCount)
+{
+    StreamWorkload workload(streamCount);
+    for (unsigned threads : {1u, 2u, 4u, 8u})
+    {
+        for (DrawStreamBuilder::Partition partition : {DrawStreamBuilder::kByOwner, DrawStreamBuilder::kByDatabase})
+        {
+            DrawStreamBuilder builder(threads, partition);
+            StubWriteStream output;
+            Stopwatch watch;
+            CHECK(builder.build(workload.array, nullptr, &output));
+            std::printf("%lu streams, %u threads, by %s: %.1f ms, %zu groups, %zu bytes\n", streamCount, threads,
+                        partition == DrawStreamBuilder::kByOwner ? "owner" : "database", watch.milliseconds(),
+                        builder.groups().size(), output.stubBytes.size());
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testPartition();
+    testSameOutput();
+    testFailures();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkThreads(sizeArgument(argc, argv, 0, 20000));
+
+    return finish();
+}
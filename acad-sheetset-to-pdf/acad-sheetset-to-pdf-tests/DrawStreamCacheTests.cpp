@@ -0,0 +1,443 @@
+#include "stdafx.h"
+#include "BlockGraphicsCache.h"
+#include "DrawStreamBuilder.h"
+#include "DrawStreamCache.h"
+
+#include <atomic>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+const char kCacheDirectory[] = "DrawStreamCacheTests.cache";
+const wchar_t kCacheFolder[] = L"DrawStreamCacheTests.cache/";
+const char kDrawingFile[] = "DrawStreamCacheTests.dwg";
+const char kXrefFile[] = "DrawStreamCacheTests.xref.dwg";
+
+void emptyCacheDirectory()
+{
+    std::filesystem::remove_all(kCacheDirectory);
+    std::filesystem::create_directory(kCacheDirectory);
+}
+
+std::string entryPath(Adesk::UInt64 key)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.dsc", static_cast<unsigned long long>(key));
+    return std::string(kCacheDirectory) + "/" + name;
+}
+
+/// <summary>
+/// Graphics as regenerating a block makes them: arcs arcs of 64 vertices
+/// each, placed by seed, every vertex three doubles after a 4-byte header
+/// per arc.
+/// </summary>
+void regenerate(std::vector<unsigned char>& graphics, Adesk::UInt64 seed, int arcs)
+{
+    graphics.clear();
+    graphics.reserve(size_t(arcs) * (4 + 64 * 24));
+    for (int arc = 0; arc < arcs; ++arc)
+    {
+        const double centerX = double(seed % 1000) * 10 + arc, centerY = arc * 0.5, radius = 1 + arc % 7;
+        const Adesk::UInt32 header = 0x10000 | 64;
+        graphics.insert(graphics.end(), reinterpret_cast<const unsigned char*>(&header),
+                        reinterpret_cast<const unsigned char*>(&header) + 4);
+        for (int i = 0; i < 64; ++i)
+        {
+            const double angle = i * 6.283185307179586 / 64;
+            const double vertex[3] = {centerX + radius * std::cos(angle), centerY + radius * std::sin(angle), 0};
+            graphics.insert(graphics.end(), reinterpret_cast<const unsigned char*>(vertex),
+                            reinterpret_cast<const unsigned char*>(vertex) + sizeof(vertex));
+        }
+    }
+}
+
+/* How many arcs regenerateBlocks gives each block, and how many streams
+   it has been asked for. */
+int s_arcsPerBlock = 20;
+std::atomic<int> s_regenerated(0);
+
+/// <summary>
+/// A draw stream builder that regenerates the blocks owning the streams.
+/// </summary>
+bool regenerateBlocks(const AcArray<AcGiDrawStream*>& streamArray, GraphicsUpdateProc lpFunc)
+{
+    bool built = true;
+    for (AcGiDrawStream* pStream : streamArray)
+    {
+        built = built && pStream->stubBuilding && pStream->getOwner() != nullptr;
+        if (pStream->getOwner() != nullptr)
+            regenerate(pStream->stubGraphics, pStream->getOwner()->id().handle(), s_arcsPerBlock);
+        ++s_regenerated;
+    }
+    return built;
+}
+
+/* Streams read back as they were stored, compressed or not, and a key
+   that was never stored misses. */
+void testRoundTrip()
+{
+    for (bool compress : {true, false})
+    {
+        emptyCacheDirectory();
+        DrawStreamCacheSettings settings;
+        settings.directory = kCacheFolder;
+        settings.compress = compress;
+        DrawStreamCache cache(settings);
+
+        std::vector<AcGiDrawStream> streams(20);
+        for (size_t i = 0; i < streams.size(); ++i)
+        {
+            regenerate(streams[i].stubGraphics, i, int(i) + 1);
+            CHECK(cache.store(i, streams[i]) == Acad::eOk);
+        }
+        const Adesk::UInt64 stored = std::filesystem::file_size(entryPath(19));
+        CHECK(compress ? stored < streams[19].stubGraphics.size() : stored > streams[19].stubGraphics.size());
+
+        DrawStreamCache later(settings);
+        for (size_t i = 0; i < streams.size(); ++i)
+        {
+            AcGiDrawStream stream;
+            CHECK(later.load(i, stream) == Acad::eOk);
+            CHECK(stream.stubGraphics == streams[i].stubGraphics);
+        }
+        AcGiDrawStream missing;
+        CHECK(later.load(1000, missing) == Acad::eKeyNotFound);
+        CHECK(later.hitCount() == streams.size() && later.missCount() == 1 && cache.storeCount() == streams.size());
+
+        cache.remove(3);
+        CHECK(cache.load(3, missing) == Acad::eKeyNotFound);
+    }
+
+    DrawStreamCache none(DrawStreamCacheSettings{});
+    AcGiDrawStream stream;
+    regenerate(stream.stubGraphics, 1, 1);
+    CHECK(none.store(1, stream) == Acad::eNotApplicable);
+    CHECK(none.load(1, stream) == Acad::eKeyNotFound);
+}
+
+/* A damaged entry, one cut short and one of another generation are not
+   read, and are deleted. */
+void testDamagedEntries()
+{
+    emptyCacheDirectory();
+    DrawStreamCacheSettings settings;
+    settings.directory = kCacheFolder;
+    DrawStreamCache cache(settings);
+    AcGiDrawStream stream;
+    regenerate(stream.stubGraphics, 7, 10);
+    for (Adesk::UInt64 key = 1; key <= 3; ++key)
+        CHECK(cache.store(key, stream) == Acad::eOk);
+
+    {
+        std::fstream file(entryPath(1), std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(100);
+        file.put('\x5a');
+    }
+    std::filesystem::resize_file(entryPath(2), std::filesystem::file_size(entryPath(2)) - 1);
+
+    AcGiDrawStream loaded;
+    CHECK(cache.load(1, loaded) == Acad::eUnsupportedFileFormat);
+    CHECK(!fileExists(entryPath(1).c_str()));
+    CHECK(cache.load(2, loaded) == Acad::eUnsupportedFileFormat);
+    CHECK(!fileExists(entryPath(2).c_str()));
+
+    settings.generation = 7;
+    DrawStreamCache newer(settings);
+    CHECK(newer.load(3, loaded) == Acad::eInvalidDwgVersion);
+    CHECK(cache.load(3, loaded) == Acad::eKeyNotFound);
+    CHECK(newer.missCount() == 1 && cache.missCount() == 3);
+}
+
+/* Trimming deletes the entries used longest ago, and a store that takes
+   the folder past its limit trims it. */
+void testEviction()
+{
+    emptyCacheDirectory();
+    DrawStreamCacheSettings settings;
+    settings.directory = kCacheFolder;
+    settings.maxBytes = 0;
+    std::vector<AcGiDrawStream> streams(50);
+    for (size_t i = 0; i < streams.size(); ++i)
+        regenerate(streams[i].stubGraphics, 5, 8);
+
+    {
+        DrawStreamCache cache(settings);
+        for (Adesk::UInt64 key = 0; key < 20; ++key)
+        {
+            CHECK(cache.store(key, streams[key]) == Acad::eOk);
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        AcGiDrawStream loaded;
+        CHECK(cache.load(0, loaded) == Acad::eOk && cache.load(1, loaded) == Acad::eOk);
+    }
+
+    const Adesk::UInt64 entrySize = std::filesystem::file_size(entryPath(0));
+    settings.maxBytes = entrySize * 10;
+    DrawStreamCache limited(settings);
+    limited.trim();
+    CHECK(limited.evictionCount() == 11);
+    for (Adesk::UInt64 key = 0; key < 20; ++key)
+        CHECK(fileExists(entryPath(key).c_str()) == (key < 2 || key >= 13));
+
+    emptyCacheDirectory();
+    DrawStreamCache storing(settings);
+    for (Adesk::UInt64 key = 0; key < streams.size(); ++key)
+        CHECK(storing.store(key, streams[key]) == Acad::eOk);
+    Adesk::UInt64 total = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(kCacheDirectory))
+        total += entry.file_size();
+    CHECK(total <= settings.maxBytes && storing.evictionCount() > 0);
+}
+
+/* Threads loading and storing the same keys only ever read what was
+   stored under them. */
+void testSharedBetweenThreads()
+{
+    emptyCacheDirectory();
+    DrawStreamCacheSettings settings;
+    settings.directory = kCacheFolder;
+    settings.maxBytes = 64 << 20;
+    DrawStreamCache cache(settings);
+    std::vector<AcGiDrawStream> streams(50);
+    for (size_t i = 0; i < streams.size(); ++i)
+        regenerate(streams[i].stubGraphics, i, 4);
+
+    std::atomic<int> wrong(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&, t]
+        {
+            for (int i = 0; i < 200; ++i)
+            {
+                const size_t key = size_t(i * 7 + t) % streams.size();
+                AcGiDrawStream stream;
+                if (cache.load(key, stream) == Acad::eOk)
+                    wrong += stream.stubGraphics != streams[key].stubGraphics ? 1 : 0;
+                else
+                    cache.store(key, streams[key]);
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+    CHECK(wrong == 0);
+}
+
+/// <summary>
+/// A saved drawing of blockCount blocks, a layout and an xref, on disk as
+/// kDrawingFile and kXrefFile.
+/// </summary>
+struct StubDrawing
+{
+    explicit StubDrawing(size_t blockCount) : blocks(blockCount + 2)
+    {
+        writeFile(kDrawingFile, "drawing");
+        writeFile(kXrefFile, "xref");
+        database.stubFileName = L"DrawStreamCacheTests.dwg";
+        database.pStubBlockTable = &table;
+        for (size_t i = 0; i < blocks.size(); ++i)
+        {
+            blocks[i].objectId.stubHandle = 0x100 + i;
+            blocks[i].objectId.pStubDatabase = &database;
+            blocks[i].objectId.pStubObject = &blocks[i];
+            table.ids.push_back(blocks[i].objectId);
+        }
+        blocks[0].layout = true;
+        blocks[1].xrefPath = L"DrawStreamCacheTests.xref.dwg";
+        layout.pDatabase = &database;
+        plotInfo.pLayout = &layout;
+    }
+
+    static void writeFile(const char* path, const std::string& content)
+    {
+        std::ofstream(path, std::ios::binary) << content;
+    }
+
+    size_t attached() const
+    {
+        size_t count = 0;
+        for (const AcDbBlockTableRecord& block : blocks)
+            count += block.drawStream() != nullptr ? 1 : 0;
+        return count;
+    }
+
+    AcDbDatabase database;
+    AcDbBlockTable table;
+    std::vector<AcDbBlockTableRecord> blocks;
+    AcDbLayout layout;
+    AcPlPlotInfo plotInfo;
+};
+
+/* The first plot of a drawing builds and stores the graphics of every
+   block but the layout, the second reads them all back, and changing the
+   xref builds them again.  Streams come off the blocks at the end of the
+   document. */
+void testBlockGraphicsCache()
+{
+    emptyCacheDirectory();
+    arx_stubs::drawStreamBuilder = &regenerateBlocks;
+    StubDrawing drawing(30);
+    BlockGraphicsCache reactor;
+    CHECK(reactor.prepare(&drawing.database) == Acad::eNotApplicable);
+    CHECK(reactor.setDirectory(kCacheFolder) == Acad::eOk);
+
+    reactor.beginDocument(drawing.plotInfo, L"DrawStreamCacheTests", 1, true, L"DrawStreamCacheTests.pdf");
+    BlockGraphicsCacheStats stats = reactor.lastStats();
+    CHECK(stats.blockCount == 31 && stats.builtCount == 31 && stats.storedCount == 31 && stats.loadedCount == 0);
+    CHECK(drawing.attached() == 31 && drawing.blocks[0].drawStream() == nullptr);
+    std::vector<std::vector<unsigned char>> graphics;
+    for (size_t i = 1; i < drawing.blocks.size(); ++i)
+        graphics.push_back(drawing.blocks[i].drawStream()->stubGraphics);
+    reactor.endDocument(AcPlPlotProgress::kPlotContinue);
+    CHECK(drawing.attached() == 0);
+
+    s_regenerated = 0;
+    CHECK(reactor.prepare(&drawing.database) == Acad::eOk);
+    stats = reactor.lastStats();
+    CHECK(stats.loadedCount == 31 && stats.builtCount == 0 && s_regenerated == 0);
+    for (size_t i = 1; i < drawing.blocks.size(); ++i)
+        CHECK(drawing.blocks[i].drawStream()->stubGraphics == graphics[i - 1]);
+    reactor.endPlot(AcPlPlotProgress::kPlotContinue);
+    CHECK(drawing.attached() == 0);
+
+    StubDrawing::writeFile(kXrefFile, "xref, edited");
+    CHECK(reactor.prepare(&drawing.database) == Acad::eOk);
+    CHECK(reactor.lastStats().builtCount == 31 && reactor.lastStats().loadedCount == 0);
+    CHECK(reactor.totalStats().documentCount == 3 && reactor.totalStats().loadedCount == 31);
+
+    drawing.database.stubFileName.clear();
+    CHECK(reactor.prepare(&drawing.database) == Acad::eNotApplicable);
+    CHECK(drawing.attached() == 0);
+    CHECK(reactor.setDirectory(nullptr) == Acad::eOk && reactor.cache() == nullptr);
+
+    arx_stubs::drawStreamBuilder = &arx_stubs::buildDrawStreams;
+    std::remove(kDrawingFile);
+    std::remove(kXrefFile);
+}
+
+/* The files only key what the databases hold while nothing is unsaved: a
+   drawing edited in its document, open in a document that is not current,
+   or with an xref edited or changed on disk since it was loaded, is
+   plotted without the cache, and neither reads nor stores anything. */
+void testModifiedDrawingsNotCached()
+{
+    emptyCacheDirectory();
+    arx_stubs::drawStreamBuilder = &regenerateBlocks;
+    StubDrawing drawing(4);
+    AcDbDatabase xrefDatabase;
+    drawing.database.stubXrefs.resize(1);
+    drawing.database.stubXrefs[0].pStubDatabase = &xrefDatabase;
+    BlockGraphicsCache reactor;
+    CHECK(reactor.setDirectory(kCacheFolder) == Acad::eOk);
+
+    AcApDocument document;
+    document.pStubDatabase = &drawing.database;
+    arx_stubs::openDocument(&document, true);
+    CHECK(reactor.prepare(&drawing.database) == Acad::eOk);
+    CHECK(reactor.lastStats().storedCount == 5 && drawing.attached() == 5);
+
+    document.stubDbmod = 1;
+    CHECK(reactor.prepare(&drawing.database) == Acad::eNotApplicable);
+    CHECK(drawing.attached() == 0 && reactor.lastStats().blockCount == 0);
+    arx_stubs::closeDocument(&document);
+    document.stubDbmod = 0;
+    arx_stubs::openDocument(&document, false);
+    CHECK(reactor.prepare(&drawing.database) == Acad::eNotApplicable);
+    arx_stubs::closeDocument(&document);
+
+    AcApDocument xrefDocument;
+    xrefDocument.pStubDatabase = &xrefDatabase;
+    xrefDocument.stubDbmod = 1;
+    arx_stubs::openDocument(&xrefDocument, true);
+    CHECK(reactor.prepare(&drawing.database) == Acad::eNotApplicable);
+    arx_stubs::closeDocument(&xrefDocument);
+    drawing.database.stubXrefs[0].stubNotificationStatus = AcDb::kXrfNotifyResolvedUpdateAvailable;
+    CHECK(reactor.prepare(&drawing.database) == Acad::eNotApplicable);
+
+    drawing.database.stubXrefs[0].stubNotificationStatus = AcDb::kXrfNotifyResolvedMatch;
+    CHECK(reactor.prepare(&drawing.database) == Acad::eOk);
+    CHECK(reactor.lastStats().loadedCount == 5 && reactor.totalStats().storedCount == 5);
+    CHECK(reactor.totalStats().documentCount == 2);
+    reactor.release();
+
+    arx_stubs::drawStreamBuilder = &arx_stubs::buildDrawStreams;
+    std::remove(kDrawingFile);
+    std::remove(kXrefFile);
+}
+
+/* A drawing of blockCount blocks of arcs arcs each regenerated without a
+   cache, then plotted with an empty cache and with the cache the first
+   plot filled.  Loading pays off for blocks that cost more per MB of
+   graphics to regenerate than it costs to read back. */
+void benchmarkRepeatedPublish(unsigned long blockCount, unsigned long arcs)
+{
+    emptyCacheDirectory();
+    arx_stubs::drawStreamBuilder = &regenerateBlocks;
+    s_arcsPerBlock = int(arcs);
+    StubDrawing drawing(blockCount);
+
+    AcArray<AcGiDrawStream*> streams;
+    std::vector<std::unique_ptr<AcGiDrawStream>> owned;
+    for (size_t i = 1; i < drawing.blocks.size(); ++i)
+    {
+        owned.emplace_back(new AcGiDrawStream(&drawing.blocks[i]));
+        streams.append(owned.back().get());
+    }
+    Stopwatch watch;
+    DrawStreamBuilder builder;
+    CHECK(builder.build(streams, nullptr));
+    const double regen = watch.milliseconds();
+    size_t bytes = 0;
+    for (const std::unique_ptr<AcGiDrawStream>& pStream : owned)
+        bytes += pStream->stubGraphics.size();
+
+    BlockGraphicsCache reactor;
+    reactor.setDirectory(kCacheFolder, 0);
+    CHECK(reactor.prepare(&drawing.database) == Acad::eOk);
+    const BlockGraphicsCacheStats first = reactor.lastStats();
+    reactor.release();
+    Adesk::UInt64 onDisk = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(kCacheDirectory))
+        onDisk += entry.file_size();
+    CHECK(reactor.prepare(&drawing.database) == Acad::eOk);
+    const BlockGraphicsCacheStats second = reactor.lastStats();
+    reactor.release();
+    CHECK(second.loadedCount == blockCount + 1);
+
+    const double load = second.loadNanoseconds / 1e6;
+    std::printf("%lu blocks, %.1f MB of graphics, %.1f MB cached: regen %.1f ms (%.2f ms/MB); first publish "
+                "build %.1f ms, store %.1f ms; next publish load %.1f ms (%.2f ms/MB), %.1f ms saved\n",
+                blockCount + 1, bytes / 1e6, onDisk / 1e6, regen, regen / (bytes / 1e6), first.buildNanoseconds / 1e6,
+                first.storeNanoseconds / 1e6, load, load / (bytes / 1e6), regen - load);
+
+    arx_stubs::drawStreamBuilder = &arx_stubs::buildDrawStreams;
+    std::remove(kDrawingFile);
+    std::remove(kXrefFile);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testRoundTrip();
+    testDamagedEntries();
+    testEviction();
+    testSharedBetweenThreads();
+    testBlockGraphicsCache();
+    testModifiedDrawingsNotCached();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkRepeatedPublish(sizeArgument(argc, argv, 0, 100), sizeArgument(argc, argv, 1, 100));
+
+    std::filesystem::remove_all(kCacheDirectory);
+    return finish();
+}
@@ -0,0 +1,211 @@
+#include "stdafx.h"
+#include "ExtentsIndex.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <random>
+
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+/// <summary>
+/// count entity extents of up to 20 by 20 by 5 scattered over a 10000 by
+/// 10000 by 100 drawing.
+/// </summary>
+std::vector<AcGeBoundBlock3d> drawingExtents(size_t count, unsigned seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> unit(0, 1);
+    std::vector<AcGeBoundBlock3d> boxes(count);
+    for (AcGeBoundBlock3d& box : boxes)
+    {
+        const AcGePoint3d corner(unit(random) * 10000, unit(random) * 10000, unit(random) * 100);
+        box.set(corner, corner + AcGeVector3d(unit(random) * 20, unit(random) * 20, unit(random) * 5));
+    }
+    return boxes;
+}
+
+/// <summary>
+/// count query windows of up to 100 by 100 by 50, and their corners as
+/// query points.
+/// </summary>
+void queryWindows(size_t count, unsigned seed, std::vector<AcGeBoundBlock3d>& windows,
+                  std::vector<AcGePoint3d>& points)
+{
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> unit(0, 1);
+    windows.resize(count);
+    points.resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        points[i].set(unit(random) * 10000, unit(random) * 10000, unit(random) * 100);
+        windows[i].set(points[i], points[i] + AcGeVector3d(unit(random) * 100, unit(random) * 100, unit(random) * 50));
+    }
+}
+
+/* What the index answers, by testing every box. */
+std::vector<Adesk::UInt32> scanWindow(const std::vector<AcGeBoundBlock3d>& boxes, const AcGeBoundBlock3d& window)
+{
+    AcGePoint3d windowMin, windowMax;
+    window.getMinMaxPoints(windowMin, windowMax);
+    std::vector<Adesk::UInt32> hits;
+    for (size_t k = 0; k < boxes.size(); ++k)
+    {
+        AcGePoint3d boxMin, boxMax;
+        boxes[k].getMinMaxPoints(boxMin, boxMax);
+        bool hit = true;
+        for (unsigned d = 0; d < 3; ++d)
+        {
+            if (boxMin[d] > windowMax[d] || boxMax[d] < windowMin[d])
+                hit = false;
+        }
+        if (hit)
+            hits.push_back(static_cast<Adesk::UInt32>(k));
+    }
+    return hits;
+}
+
+std::vector<Adesk::UInt32> sortedHits(const ExtentsQueryResult& result, size_t query)
+{
+    std::vector<Adesk::UInt32> hits(result.items.begin() + result.offsets[query],
+                                    result.items.begin() + result.offsets[query + 1]);
+    std::sort(hits.begin(), hits.end());
+    return hits;
+}
+
+/* Window and point queries find exactly the boxes a scan of all of them
+   finds, whatever the number of threads. */
+void testMatchesScan(size_t boxCount)
+{
+    const std::vector<AcGeBoundBlock3d> boxes = drawingExtents(boxCount, 3);
+    ExtentsIndex index;
+    CHECK(index.build(boxes.data(), boxes.size(), 2) == Acad::eOk);
+    CHECK(index.size() == boxes.size());
+
+    std::vector<AcGeBoundBlock3d> windows;
+    std::vector<AcGePoint3d> points;
+    queryWindows(200, 4, windows, points);
+
+    ExtentsQueryResult windowHits, pointHits;
+    index.queryWindows(windows.data(), windows.size(), windowHits, 1);
+    index.queryPoints(points.data(), points.size(), pointHits, 3);
+    CHECK(windowHits.offsets.size() == windows.size() + 1);
+    CHECK(pointHits.offsets.size() == points.size() + 1);
+
+    size_t total = 0;
+    for (size_t q = 0; q < windows.size(); ++q)
+    {
+        const std::vector<Adesk::UInt32> expected = scanWindow(boxes, windows[q]);
+        CHECK(sortedHits(windowHits, q) == expected);
+        total += expected.size();
+
+        AcGeBoundBlock3d point;
+        point.set(points[q], points[q]);
+        CHECK(sortedHits(pointHits, q) == scanWindow(boxes, point));
+
+        std::vector<Adesk::UInt32> single;
+        index.queryWindow(windows[q], single);
+        CHECK(std::equal(single.begin(), single.end(), windowHits.items.begin() + windowHits.offsets[q],
+                         windowHits.items.begin() + windowHits.offsets[q + 1]));
+    }
+    CHECK(total > 0);
+
+    ExtentsQueryResult parallelHits;
+    index.queryWindows(windows.data(), windows.size(), parallelHits, 4);
+    CHECK(parallelHits.offsets == windowHits.offsets && parallelHits.items == windowHits.items);
+
+    std::vector<AcGePoint3d> minPoints, maxPoints;
+    for (const AcGeBoundBlock3d& box : boxes)
+    {
+        AcGePoint3d boxMin, boxMax;
+        box.getMinMaxPoints(boxMin, boxMax);
+        minPoints.push_back(boxMin);
+        maxPoints.push_back(boxMax);
+    }
+    ExtentsIndex fromCorners;
+    CHECK(fromCorners.build(minPoints.data(), maxPoints.data(), boxes.size(), 1) == Acad::eOk);
+    ExtentsQueryResult cornerHits;
+    fromCorners.queryWindows(windows.data(), windows.size(), cornerHits, 1);
+    CHECK(cornerHits.offsets == windowHits.offsets && cornerHits.items == windowHits.items);
+}
+
+/* Touching counts, and tiny or empty indexes answer sensibly. */
+void testEdges()
+{
+    AcGeBoundBlock3d box;
+    box.set(AcGePoint3d(0, 0, 0), AcGePoint3d(1, 1, 1));
+    ExtentsIndex index;
+    CHECK(index.build(&box, 1) == Acad::eOk);
+
+    std::vector<Adesk::UInt32> hits;
+    index.queryPoint(AcGePoint3d(1, 1, 1), hits);
+    CHECK(hits.size() == 1);
+    hits.clear();
+    index.queryPoint(AcGePoint3d(-1, -1, -1), hits);
+    CHECK(hits.empty());
+
+    AcGeBoundBlock3d touching;
+    touching.set(AcGePoint3d(1, 0, 0), AcGePoint3d(2, 1, 1));
+    index.queryWindow(touching, hits);
+    CHECK(hits.size() == 1);
+
+    index.clear();
+    CHECK(index.isEmpty());
+    hits.clear();
+    index.queryWindow(touching, hits);
+    CHECK(hits.empty());
+
+    ExtentsIndex empty;
+    CHECK(empty.build(&box, 0) == Acad::eOk);
+    ExtentsQueryResult result;
+    empty.queryWindows(&touching, 1, result);
+    CHECK(result.offsets.size() == 2 && result.items.empty());
+}
+
+/* Build and query time against testing every box for every window. */
+void benchmarkQueries(size_t boxCount, size_t queryCount)
+{
+    const std::vector<AcGeBoundBlock3d> boxes = drawingExtents(boxCount, 3);
+    std::vector<AcGeBoundBlock3d> windows;
+    std::vector<AcGePoint3d> points;
+    queryWindows(queryCount, 4, windows, points);
+
+    ExtentsIndex index;
+    Stopwatch watch;
+    index.build(boxes.data(), boxes.size());
+    std::printf("%zu boxes: built in %.0f ms\n", boxCount, watch.milliseconds());
+
+    for (unsigned threads : {1u, 4u})
+    {
+        ExtentsQueryResult result;
+        watch.restart();
+        index.queryWindows(windows.data(), windows.size(), result, threads);
+        std::printf("%zu windows, %u thread(s): %zu hits in %.1f ms\n", queryCount, threads, result.items.size(),
+                    watch.milliseconds());
+    }
+
+    const size_t scanned = std::min<size_t>(queryCount, 100);
+    size_t hits = 0;
+    watch.restart();
+    for (size_t q = 0; q < scanned; ++q)
+        hits += scanWindow(boxes, windows[q]).size();
+    std::printf("scanning every box: %.1f ms per 1000 windows\n", watch.milliseconds() * 1000 / scanned);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testMatchesScan(20000);
+    testEdges();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkQueries(sizeArgument(argc, argv, 0, 200000), sizeArgument(argc, argv, 1, 2000));
+
+    stopWorkerThreads();
+    return finish();
+}
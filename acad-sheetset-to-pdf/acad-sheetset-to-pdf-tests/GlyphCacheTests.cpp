@@ -0,0 +1,492 @@
+#include "stdafx.h"
+#include "GlyphCache.h"
+#include "StubTextEngine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <thread>
+
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+/* The polylines a tessellation sent, and how many calls it took. */
+struct Polylines
+{
+    std::vector<int> counts;
+    std::vector<AcGePoint3d> points;
+    size_t calls = 0;
+    double sum = 0;
+
+    /* The polylines in a canonical order, rounded, for comparing output
+       whose scores may come in another order. */
+    std::vector<std::vector<double>> sorted() const
+    {
+        std::vector<std::vector<double>> lines;
+        size_t k = 0;
+        for (const int count : counts)
+        {
+            std::vector<double> line;
+            for (int i = 0; i < count; ++i, ++k)
+            {
+                line.push_back(std::round(points[k].x * 1e4));
+                line.push_back(std::round(points[k].y * 1e4));
+            }
+            lines.push_back(line);
+        }
+        std::sort(lines.begin(), lines.end());
+        return lines;
+    }
+};
+
+void collect(int polylineCount, int const* pCounts, AcGePoint3d const* pPoints, void* pVoid)
+{
+    Polylines& polylines = *static_cast<Polylines*>(pVoid);
+    ++polylines.calls;
+    size_t pointCount = 0;
+    for (int i = 0; i < polylineCount; ++i)
+    {
+        polylines.counts.push_back(pCounts[i]);
+        pointCount += size_t(pCounts[i]);
+    }
+    polylines.points.insert(polylines.points.end(), pPoints, pPoints + pointCount);
+}
+
+/* Only adds the points up, as a cheap consumer would. */
+void consume(int polylineCount, int const* pCounts, AcGePoint3d const* pPoints, void* pVoid)
+{
+    Polylines& polylines = *static_cast<Polylines*>(pVoid);
+    size_t pointCount = 0;
+    for (int i = 0; i < polylineCount; ++i)
+        pointCount += size_t(pCounts[i]);
+    for (size_t i = 0; i < pointCount; ++i)
+        polylines.sum += pPoints[i].x + pPoints[i].y;
+}
+
+bool samePolylines(const Polylines& a, const Polylines& b)
+{
+    if (a.counts != b.counts || a.points.size() != b.points.size() || a.calls != b.calls)
+        return false;
+    for (size_t i = 0; i < a.points.size(); ++i)
+    {
+        if (std::fabs(a.points[i].x - b.points[i].x) > 1e-5 || std::fabs(a.points[i].y - b.points[i].y) > 1e-5)
+            return false;
+    }
+    return true;
+}
+
+AcGiTextStyle slantedStyle()
+{
+    AcGiTextStyle style;
+    style.widthFactor = 0.8;
+    style.oblique = 0.2;
+    return style;
+}
+
+/* The strings of the title blocks and notes of sheetCount sheets. */
+std::vector<std::wstring> titleBlockStrings(size_t sheetCount)
+{
+    const wchar_t* const kFixed[] = {L"NOT FOR CONSTRUCTION", L"DRAWN BY:", L"CHECKED BY:", L"APPROVED:", L"SCALE",
+                                     L"DATE", L"PROJECT NO.", L"DRAWING TITLE", L"ACME ENGINEERING LTD",
+                                     L"ALL DIMENSIONS IN MILLIMETRES", L"DO NOT SCALE FROM THIS DRAWING",
+                                     L"REVISION", L"DESCRIPTION", L"GENERAL NOTES:"};
+    std::vector<std::wstring> strings;
+    std::mt19937 random(7);
+    for (size_t sheet = 0; sheet < sheetCount; ++sheet)
+    {
+        strings.insert(strings.end(), std::begin(kFixed), std::end(kFixed));
+        strings.push_back(L"SHEET " + std::to_wstring(sheet + 1) + L" OF " + std::to_wstring(sheetCount));
+        strings.push_back(L"A-" + std::to_wstring(sheet + 101));
+        strings.push_back(L"2024-" + std::to_wstring(1 + sheet % 12) + L"-" + std::to_wstring(1 + sheet % 28));
+        for (int revision = 0; revision < 5; ++revision)
+        {
+            strings.push_back(std::wstring(1, wchar_t(L'A' + revision)) + L"  2024-0" + std::to_wstring(1 + revision) +
+                              L"-1" + std::to_wstring(revision) + L"  ISSUED FOR REVIEW  JD/MK");
+        }
+        for (int note = 0; note < 12; ++note)
+        {
+            strings.push_back(std::to_wstring(note + 1) + L". REFER TO STRUCTURAL DRAWINGS S-" +
+                              std::to_wstring(random() % 400) + L" FOR ALL FIXINGS.");
+        }
+        strings.push_back(L"1:" + std::to_wstring((sheet % 3 + 1) * 50));
+    }
+    return strings;
+}
+
+/* Cached glyphs give what the engine gives, from the first string on; the
+   strings the cache cannot lay out go to the engine, and deviations in the
+   same bucket share glyphs. */
+void testSameAsTheEngine()
+{
+    const AcGiTextStyle style = slantedStyle();
+    std::shared_ptr<GlyphCache> pCache = std::make_shared<GlyphCache>();
+    StubTextEngine direct;
+    CachingTextEngine cached(new StubTextEngine(), pCache);
+    for (const wchar_t* text : {L"HELLO WORLD", L"A-101 SHEET 3 OF 9", L"", L"X", L"   "})
+    {
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            AcGiTextStyle a = style, b = style;
+            Polylines expected, actual;
+            direct.tessellate(a, text, -1, true, 1.0 / 64, &expected, collect);
+            cached.tessellate(b, text, -1, true, 1.0 / 64, &actual, collect);
+            CHECK(samePolylines(expected, actual));
+        }
+    }
+    CHECK(pCache->stats().hits > 0);
+
+    AcGiTextStyle a = style, b = style;
+    Polylines expected, actual;
+    direct.tessellate(a, L"ABCDEF", 3, true, 1.0 / 64, &expected, collect);
+    cached.tessellate(b, L"ABCDEF", 3, true, 1.0 / 64, &actual, collect);
+    CHECK(samePolylines(expected, actual));
+
+    const Adesk::UInt64 bypassed = pCache->stats().bypassedStrings;
+    Polylines ignored;
+    cached.tessellate(b, L"45\\P", -1, false, 1.0 / 64, &ignored, collect);
+    CHECK(pCache->stats().bypassedStrings == bypassed + 1);
+    cached.tessellate(b, L"%%c50", -1, false, 1.0 / 64, &ignored, collect);
+    CHECK(pCache->stats().bypassedStrings == bypassed + 2);
+    cached.tessellate(b, L"45%%d", -1, true, 1.0 / 64, &ignored, collect);
+    CHECK(pCache->stats().bypassedStrings == bypassed + 2);
+    AcGiTextStyle vertical = style;
+    vertical.vertical = true;
+    cached.tessellate(vertical, L"V", -1, true, 0.01, &ignored, collect);
+    CHECK(pCache->stats().bypassedStrings == bypassed + 3);
+
+    const size_t glyphs = pCache->stats().glyphCount;
+    cached.tessellate(b, L"HELLO", -1, true, 1.0 / 60, &ignored, collect);
+    CHECK(pCache->stats().glyphCount == glyphs);
+    cached.tessellate(b, L"HELLO", -1, true, 1.0 / 100, &ignored, collect);
+    CHECK(pCache->stats().glyphCount > glyphs);
+}
+
+/* %% codes are expanded and scored from the cached glyphs as the engine
+   would; only the order of the score lines may differ. */
+void testControlCodes()
+{
+    std::shared_ptr<GlyphCache> pCache = std::make_shared<GlyphCache>();
+    StubTextEngine direct;
+    CachingTextEngine cached(new StubTextEngine(), pCache);
+    const wchar_t* const kPieces[] = {L"%%u", L"%%O", L"%%k", L"%%d", L"%%p", L"%%%", L"%%065",
+                                      L"%%",  L"%",   L"A",   L"7",   L" ",   L"x"};
+    std::mt19937 random(5);
+    for (int trial = 0; trial < 3000; ++trial)
+    {
+        std::wstring text;
+        for (int n = int(random() % 10); n > 0; --n)
+            text += kPieces[random() % 13];
+        AcGiTextStyle a = slantedStyle();
+        a.oblique = (trial % 3) * 0.1;
+        AcGiTextStyle b = a;
+        Polylines expected, actual;
+        direct.tessellate(a, text.c_str(), -1, false, 1.0 / 64, &expected, collect);
+        cached.tessellate(b, text.c_str(), -1, false, 1.0 / 64, &actual, collect);
+        CHECK(expected.sorted() == actual.sorted());
+    }
+    CHECK(pCache->stats().bypassedStrings == 0);
+    CHECK(pCache->stats().cachedStrings == 3000);
+}
+
+bool sameExtents(const AcGePoint2d& a, const AcGePoint2d& b)
+{
+    return std::fabs(a.x - b.x) < 1e-9 && std::fabs(a.y - b.y) < 1e-9;
+}
+
+/* Short strings of title block characters, some with control codes. */
+std::wstring randomShortString(std::mt19937& random)
+{
+    static const wchar_t kAlphabet[] = L"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789 .-:/%\\";
+    std::wstring text;
+    for (int n = 3 + int(random() % 10); n > 0; --n)
+        text += kAlphabet[random() % (sizeof(kAlphabet) / sizeof(kAlphabet[0]) - 1)];
+    return text;
+}
+
+/* Extents come from the metric tables once a style is verified, one string
+   at a time or in a batch, raw or not and with or without pen ups, and are
+   what the engine measures; strings with control codes go to the engine. */
+void testExtentsMatchTheEngine()
+{
+    std::shared_ptr<GlyphCache> pCache = std::make_shared<GlyphCache>();
+    StubTextEngine direct;
+    CachingTextEngine cached(new StubTextEngine(), pCache);
+    AcGiTextStyle style;
+    style.widthFactor = 0.8;
+    std::mt19937 random(7);
+    for (int trial = 0; trial < 5000; ++trial)
+    {
+        std::wstring text = randomShortString(random).substr(0, size_t(trial % 12));
+        if (trial % 97 == 0)
+            text += L"%%d";
+        for (const bool penUp : {false, true})
+        {
+            for (const bool raw : {false, true})
+            {
+                AcGePoint2d expected, actual;
+                direct.getExtents(style, text.c_str(), int(text.size()), penUp, raw, expected);
+                cached.getExtents(style, text.c_str(), int(text.size()), penUp, raw, actual);
+                CHECK(sameExtents(expected, actual));
+            }
+        }
+    }
+    const GlyphCacheStats stats = pCache->stats();
+    CHECK(stats.measuredStrings > 15000);
+    CHECK(stats.unmeasuredStrings > 0);
+    CHECK(stats.metricBytes > 0);
+
+    std::vector<std::wstring> strings;
+    std::vector<const ACHAR*> pointers;
+    std::vector<int> lengths;
+    for (int n = 0; n < 500; ++n)
+        strings.push_back(randomShortString(random));
+    strings[10] += L"%%u";
+    for (const std::wstring& text : strings)
+    {
+        pointers.push_back(text.c_str());
+        lengths.push_back(int(text.size()) - 1);
+    }
+    std::vector<AcGePoint2d> batch(strings.size());
+    cached.getExtents(style, pointers.data(), lengths.data(), strings.size(), true, false, batch.data());
+    for (size_t i = 0; i < strings.size(); ++i)
+    {
+        AcGePoint2d expected;
+        direct.getExtents(style, pointers[i], lengths[i], true, false, expected);
+        CHECK(sameExtents(expected, batch[i]));
+    }
+    cached.getExtents(style, pointers.data(), nullptr, strings.size(), false, true, batch.data());
+    for (size_t i = 0; i < strings.size(); ++i)
+    {
+        AcGePoint2d expected;
+        direct.getExtents(style, pointers[i], -1, false, true, expected);
+        CHECK(sameExtents(expected, batch[i]));
+    }
+}
+
+/* A style whose text the tables cannot reproduce, here because the engine
+   kerns, is found out before it is measured from them and stays with the
+   engine. */
+void testKernedStyleGoesToTheEngine()
+{
+    std::shared_ptr<GlyphCache> pCache = std::make_shared<GlyphCache>();
+    StubTextEngine* pKerning = new StubTextEngine();
+    pKerning->kerning = true;
+    CachingTextEngine cached(pKerning, pCache);
+    StubTextEngine direct;
+    direct.kerning = true;
+    AcGiTextStyle style;
+    const wchar_t* const strings[] = {L"AV", L"xyz", L"AAA"};
+    AcGePoint2d extents[3];
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        cached.getExtents(style, strings, nullptr, 3, true, true, extents);
+        for (int i = 0; i < 3; ++i)
+        {
+            AcGePoint2d expected;
+            direct.getExtents(style, strings[i], -1, true, true, expected);
+            CHECK(sameExtents(expected, extents[i]));
+        }
+    }
+    CHECK(pCache->stats().measuredStrings == 0);
+    CHECK(pCache->stats().unmeasuredStrings == 6);
+}
+
+/* Threads measuring through a shared cache that is cleared under them. */
+void testExtentsSharedBetweenThreads()
+{
+    std::shared_ptr<GlyphCache> pCache = std::make_shared<GlyphCache>();
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&, t] {
+            CachingTextEngine cached(new StubTextEngine(), pCache);
+            StubTextEngine direct;
+            AcGiTextStyle style;
+            style.widthFactor = 0.8;
+            std::mt19937 random(static_cast<unsigned>(t));
+            for (int trial = 0; trial < 2000; ++trial)
+            {
+                std::wstring text;
+                for (int n = 1 + int(random() % 8); n > 0; --n)
+                    text += wchar_t(0x20 + random() % 2000);
+                AcGePoint2d expected, actual;
+                direct.getExtents(style, text.c_str(), -1, true, true, expected);
+                cached.getExtents(style, text.c_str(), -1, true, true, actual);
+                if (!sameExtents(expected, actual))
+                    ++mismatches;
+                if (trial % 500 == 0)
+                    pCache->clear();
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+    CHECK(mismatches == 0);
+}
+
+/* A tight cap evicts glyphs without changing what is drawn. */
+void testEviction()
+{
+    GlyphCacheSettings settings;
+    settings.maximumBytes = 4096;
+    std::shared_ptr<GlyphCache> pCache = std::make_shared<GlyphCache>(settings);
+    StubTextEngine direct;
+    CachingTextEngine cached(new StubTextEngine(), pCache);
+    for (const wchar_t* text : {L"THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG 0123456789", L"ABCDEFGHIJKLMNOPQRSTUVWXYZ"})
+    {
+        AcGiTextStyle a = slantedStyle(), b = slantedStyle();
+        Polylines expected, actual;
+        direct.tessellate(a, text, -1, true, 1.0 / 64, &expected, collect);
+        cached.tessellate(b, text, -1, true, 1.0 / 64, &actual, collect);
+        CHECK(samePolylines(expected, actual));
+    }
+    const GlyphCacheStats stats = pCache->stats();
+    CHECK(stats.evictions > 0);
+    CHECK(stats.byteCount <= 4096 || stats.glyphCount == 1);
+}
+
+/* Four threads with an engine each share a cache. */
+void testSharedBetweenThreads()
+{
+    const std::vector<std::wstring> strings = titleBlockStrings(20);
+    std::shared_ptr<GlyphCache> pCache = std::make_shared<GlyphCache>();
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&, t] {
+            CachingTextEngine cached(new StubTextEngine(), pCache);
+            StubTextEngine direct;
+            AcGiTextStyle style;
+            style.widthFactor = 1.0 + (t % 2) * 0.5;
+            for (size_t i = size_t(t); i < 1000; ++i)
+            {
+                const std::wstring& text = strings[i % strings.size()];
+                Polylines expected, actual;
+                direct.tessellate(style, text.c_str(), int(text.size()), true, 1.0 / 32, &expected, collect);
+                cached.tessellate(style, text.c_str(), int(text.size()), true, 1.0 / 32, &actual, collect);
+                if (!samePolylines(expected, actual))
+                    ++mismatches;
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+    CHECK(mismatches == 0);
+}
+
+/* The title blocks of sheetCount sheets, each viewport at a slightly
+   different deviation, through the engine and through the cache. */
+void benchmarkTitleBlocks(unsigned long sheetCount)
+{
+    const std::vector<std::wstring> strings = titleBlockStrings(sheetCount);
+    size_t characters = 0;
+    for (const std::wstring& text : strings)
+        characters += text.size();
+    std::mt19937 random(3);
+    std::uniform_real_distribution<double> jitter(0.9, 1.1);
+    std::vector<double> deviations(strings.size());
+    for (double& deviation : deviations)
+        deviation = 0.004 * jitter(random);
+
+    AcGiTextStyle style = slantedStyle();
+    StubTextEngine direct;
+    Polylines polylines;
+    Stopwatch watch;
+    for (size_t i = 0; i < strings.size(); ++i)
+        direct.tessellate(style, strings[i].c_str(), int(strings[i].size()), true, deviations[i], &polylines, consume);
+    const double directMilliseconds = watch.milliseconds();
+
+    std::shared_ptr<GlyphCache> pCache = std::make_shared<GlyphCache>();
+    CachingTextEngine cached(new StubTextEngine(), pCache);
+    watch.restart();
+    for (size_t i = 0; i < strings.size(); ++i)
+        cached.tessellate(style, strings[i].c_str(), int(strings[i].size()), true, deviations[i], &polylines, consume);
+    const double cachedMilliseconds = watch.milliseconds();
+
+    AcGePoint2d extents;
+    watch.restart();
+    for (const std::wstring& text : strings)
+        direct.getExtents(style, text.c_str(), int(text.size()), true, true, extents);
+    const double directExtents = watch.milliseconds();
+    watch.restart();
+    for (const std::wstring& text : strings)
+        cached.getExtents(style, text.c_str(), int(text.size()), true, true, extents);
+    const double cachedExtents = watch.milliseconds();
+
+    const GlyphCacheStats stats = pCache->stats();
+    std::printf("%lu sheets, %zu strings, %zu characters: tessellating %.1f ms direct, %.1f ms cached (hit rate %.4f, "
+                "%zu glyphs, %.0f KB); extents %.1f ms direct, %.1f ms cached\n",
+                sheetCount, strings.size(), characters, directMilliseconds, cachedMilliseconds, stats.hitRate(),
+                stats.glyphCount, stats.byteCount / 1024.0, directExtents, cachedExtents);
+}
+
+/* Extents of stringCount short strings of one style: one getExtents call a
+   string on the engine, and the batch call on the cache, cold and warm,
+   against one call a string on the cache. */
+void benchmarkBatchExtents(unsigned long stringCount)
+{
+    std::mt19937 random(11);
+    std::vector<std::wstring> strings(stringCount);
+    std::vector<const ACHAR*> pointers(stringCount);
+    std::vector<int> lengths(stringCount);
+    for (size_t i = 0; i < stringCount; ++i)
+    {
+        strings[i] = randomShortString(random);
+        pointers[i] = strings[i].c_str();
+        lengths[i] = int(strings[i].size());
+    }
+    AcGiTextStyle style;
+    style.widthFactor = 0.8;
+    std::vector<AcGePoint2d> expected(stringCount), actual(stringCount);
+
+    StubTextEngine direct;
+    Stopwatch watch;
+    for (size_t i = 0; i < stringCount; ++i)
+        direct.getExtents(style, pointers[i], lengths[i], true, true, expected[i]);
+    const double directMilliseconds = watch.milliseconds();
+
+    std::shared_ptr<GlyphCache> pCache = std::make_shared<GlyphCache>();
+    CachingTextEngine cached(new StubTextEngine(), pCache);
+    watch.restart();
+    cached.getExtents(style, pointers.data(), lengths.data(), stringCount, true, true, actual.data());
+    const double cold = watch.milliseconds();
+    watch.restart();
+    cached.getExtents(style, pointers.data(), lengths.data(), stringCount, true, true, actual.data());
+    const double warm = watch.milliseconds();
+    watch.restart();
+    for (size_t i = 0; i < stringCount; ++i)
+        cached.getExtents(style, pointers[i], lengths[i], true, true, actual[i]);
+    const double single = watch.milliseconds();
+    for (size_t i = 0; i < stringCount; ++i)
+        CHECK(sameExtents(expected[i], actual[i]));
+
+    std::printf("%lu short strings: engine %.1f ms, batch %.1f ms cold and %.1f ms warm, cached one at a time %.1f ms\n",
+                stringCount, directMilliseconds, cold, warm, single);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testSameAsTheEngine();
+    testControlCodes();
+    testExtentsMatchTheEngine();
+    testKernedStyleGoesToTheEngine();
+    testExtentsSharedBetweenThreads();
+    testEviction();
+    testSharedBetweenThreads();
+
+    if (benchmarkRequested(argc, argv))
+    {
+        benchmarkTitleBlocks(sizeArgument(argc, argv, 0, 200));
+        benchmarkBatchExtents(sizeArgument(argc, argv, 1, 100000));
+    }
+
+    return finish();
+}
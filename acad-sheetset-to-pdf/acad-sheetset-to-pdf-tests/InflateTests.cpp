@@ -0,0 +1,143 @@
+#include "stdafx.h"
+#include "Checksum.h"
+#include "Inflate.h"
+
+#include <random>
+
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+/* Written by zlib 1.2 (Python's zlib.compress), one stream for each kind of
+   block: level 0 stores, and at level 9 a short text gets the fixed code and
+   a longer one a dynamic code. */
+const char kStoredStream[] = "7801011c00e3ff73746f72656420626c6f636b2c206e6f20636f6d7072657373696f6e99110ab8";
+const char kFixedStream[] =
+    "78da530d707153c84fca4a4d2e51282e294a4dcc55305430503052303452b0b1d10fa92c48d50f484c4fb5b303000b960c4a";
+const char kDynamicStream[] =
+    "78da7dd4290e4231144051cf2aba0044dfd441b21444c91724885f04bb272195e5eaab4ede701e63cc94d3eb91e631d239e635"
+    "3def9fd77ba65bbe9cbf2adb2aabeab6eaaab6adb6aa6fabaf1adb1aab966d2dab561435147514494692089a441125862a711e"
+    "54a04b0ac32ac31ac33ac234234c0561aabc828630758469204c0bc32ac31ac33ac22cf37109c24c1166863073845920cc0ac3"
+    "2ac31ac33ac23c23cc0561ae087343983bc23cf81f168655863586758445465808c2421116c69fde111681b0280cab0c6b0ceb"
+    "7f605f82c65111";
+
+std::vector<Adesk::UInt8> fromHex(const char* pHex)
+{
+    std::vector<Adesk::UInt8> bytes;
+    for (; pHex[0] != 0 && pHex[1] != 0; pHex += 2)
+        bytes.push_back(Adesk::UInt8(std::stoi(std::string(pHex, 2), nullptr, 16)));
+    return bytes;
+}
+
+std::string stringOf(const std::vector<Adesk::UInt8>& bytes)
+{
+    return std::string(bytes.begin(), bytes.end());
+}
+
+/* What kDynamicStream holds. */
+std::string sheetLines(int count)
+{
+    std::string text;
+    for (int i = 0; i < count; ++i)
+        text += "sheet " + std::to_string(i) + " of the set, layout A" + std::to_string(i % 7) + "\n";
+    return text;
+}
+
+/* Every kind of block decompresses to what zlib compressed, and raw deflate
+   data reports where it ends. */
+void testBlockKinds()
+{
+    std::vector<Adesk::UInt8> output;
+    CHECK(zlibDecompress(fromHex(kStoredStream).data(), fromHex(kStoredStream).size(), output, 1 << 20) ==
+          Acad::eOk);
+    CHECK(stringOf(output) == "stored block, no compression");
+
+    const std::vector<Adesk::UInt8> fixed = fromHex(kFixedStream);
+    CHECK(zlibDecompress(fixed.data(), fixed.size(), output, 1 << 20) == Acad::eOk);
+    CHECK(stringOf(output) == "%PDF object stream 1 0 2 12 <</Type/Page>>");
+
+    const std::vector<Adesk::UInt8> dynamic = fromHex(kDynamicStream);
+    CHECK(zlibDecompress(dynamic.data(), dynamic.size(), output, 1 << 20) == Acad::eOk);
+    CHECK(stringOf(output) == sheetLines(60));
+
+    /* Raw data appends, and stops at the end of its last block. */
+    std::vector<Adesk::UInt8> appended(3, Adesk::UInt8('>'));
+    size_t consumed = 0;
+    CHECK(inflateRaw(dynamic.data() + 2, dynamic.size() - 2, appended, 1 << 20, consumed) == Acad::eOk);
+    CHECK(consumed == dynamic.size() - 6);
+    CHECK(stringOf(appended) == ">>>" + sheetLines(60));
+
+    CHECK(adler32("Wikipedia", 9) == 0x11E60398);
+    CHECK(adler32("pedia", 5, adler32("Wiki", 4)) == 0x11E60398);
+}
+
+/* Damaged streams, whether cut short, with a byte changed or with a wrong
+   header or checksum, are refused without reading or writing out of bounds,
+   and output is kept within its limit. */
+void testDamagedStreams()
+{
+    const std::vector<Adesk::UInt8> dynamic = fromHex(kDynamicStream);
+    std::vector<Adesk::UInt8> output;
+    for (size_t size = 0; size < dynamic.size(); ++size)
+        CHECK(zlibDecompress(dynamic.data(), size, output, 1 << 20) == Acad::eInvalidInput);
+
+    std::mt19937 random(5);
+    for (int trial = 0; trial < 2000; ++trial)
+    {
+        std::vector<Adesk::UInt8> damaged = dynamic;
+        damaged[random() % damaged.size()] ^= Adesk::UInt8(1 + random() % 255);
+        CHECK(zlibDecompress(damaged.data(), damaged.size(), output, 1 << 20) != Acad::eOk);
+    }
+
+    std::vector<Adesk::UInt8> preset = dynamic;
+    preset[1] |= 0x20;
+    preset[1] = Adesk::UInt8(preset[1] - (preset[0] * 256u + preset[1]) % 31);
+    CHECK(zlibDecompress(preset.data(), preset.size(), output, 1 << 20) == Acad::eInvalidInput);
+
+    CHECK(zlibDecompress(dynamic.data(), dynamic.size(), output, 1000) == Acad::eDataTooLarge);
+    CHECK(output.size() <= 1000);
+    const std::vector<Adesk::UInt8> stored = fromHex(kStoredStream);
+    CHECK(zlibDecompress(stored.data(), stored.size(), output, 10) == Acad::eDataTooLarge);
+
+    /* A fixed block whose first code is a match, reaching back before the
+       start of the output. */
+    const Adesk::UInt8 kReachesBack[] = {0x03, 0x02, 0x00};
+    size_t consumed = 0;
+    output.assign(10, 0);
+    CHECK(inflateRaw(kReachesBack, sizeof(kReachesBack), output, 1 << 20, consumed) == Acad::eInvalidInput);
+}
+
+/* How fast object and cross-reference streams come apart. */
+void benchmarkInflate(unsigned long megabytes)
+{
+    const std::vector<Adesk::UInt8> dynamic = fromHex(kDynamicStream);
+    const size_t rounds = megabytes * (1 << 20) / sheetLines(60).size() + 1;
+    std::vector<Adesk::UInt8> output;
+    size_t total = 0;
+    Stopwatch watch;
+    for (size_t i = 0; i < rounds; ++i)
+    {
+        zlibDecompress(dynamic.data(), dynamic.size(), output, 1 << 20);
+        total += output.size();
+    }
+    const double milliseconds = watch.milliseconds();
+    CHECK(total == rounds * sheetLines(60).size());
+    std::printf("inflate: %.1f MB of text in %.1f ms, %.1f MB/s\n", total / 1048576.0, milliseconds,
+                total / 1048576.0 / (milliseconds / 1000));
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testBlockKinds();
+    testDamagedStreams();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkInflate(sizeArgument(argc, argv, 0, 16));
+
+    return finish();
+}
@@ -0,0 +1,278 @@
+#include "stdafx.h"
+#include "LinetypePatternCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "StubWorkloads.h"
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+double distance(const AcGePoint3d& a, const AcGePoint3d& b)
+{
+    return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z));
+}
+
+/// <summary>
+/// The dashes AutoCAD draws along a run of length, as lengths: a run
+/// shorter than one pattern is solid; a pattern that starts with a dash is
+/// aligned so that the run starts and ends with half of what is left over
+/// added to that dash, and one that starts with a gap is laid from the
+/// start of the run.
+/// </summary>
+std::vector<double> referenceDashes(const std::vector<double>& lengths, double scale, double length)
+{
+    std::vector<double> dashes;
+    double period = 0;
+    for (double dash : lengths)
+        period += std::fabs(dash) * scale;
+    if (length < period)
+    {
+        if (length > 0)
+            dashes.push_back(length);
+        return dashes;
+    }
+
+    if (lengths[0] < 0)
+    {
+        size_t i = 0;
+        for (double at = 0; at < length; i = (i + 1) % lengths.size())
+        {
+            const double dash = std::fabs(lengths[i]) * scale;
+            if (lengths[i] >= 0)
+                dashes.push_back(std::min(at + dash, length) - at);
+            at += dash;
+        }
+        return dashes;
+    }
+
+    const double repeats = std::floor(length / period);
+    const double first = lengths[0] * scale;
+    const double end = (length - repeats * period + first) / 2;
+    dashes.push_back(end);
+    for (int repeat = 0; repeat < int(repeats); ++repeat)
+    {
+        for (size_t i = repeat == 0 ? 1 : 0; i < lengths.size(); ++i)
+        {
+            if (lengths[i] >= 0)
+                dashes.push_back(lengths[i] * scale);
+        }
+    }
+    dashes.push_back(end);
+    return dashes;
+}
+
+/* Random polylines, open and closed, in dashed, dotted and gap-first
+   patterns at random scales are cut into the dashes AutoCAD draws, as one
+   run or a run per segment. */
+void testSameAsReference(int trials)
+{
+    const std::vector<std::vector<double>> kPatterns = {{0.5, -0.25},
+                                                        {1.25, -0.25, 0.25, -0.25},
+                                                        {0.5, -0.25, 0, -0.25},
+                                                        {0, -0.3},
+                                                        {2, -0.1, 0, -0.1, 0, -0.1},
+                                                        {-0.2, 0.5, -0.2, 0}};
+    std::mt19937 random(5);
+    DashedPolylines dashes;
+    for (int trial = 0; trial < trials; ++trial)
+    {
+        const std::vector<double>& lengths = kPatterns[random() % kPatterns.size()];
+        const double scale = 0.2 + (random() % 100) / 25.0;
+        LinetypePattern pattern;
+        CHECK(pattern.setDashes(lengths.data(), int(lengths.size()), scale) == Acad::eOk);
+
+        std::vector<AcGePoint3d> points;
+        for (int i = 2 + int(random() % 12); i > 0; --i)
+            points.emplace_back((random() % 1000) / 37.0, (random() % 1000) / 41.0, (i % 3) * 0.5);
+        const bool closed = random() % 3 == 0;
+        std::vector<AcGePoint3d> path = points;
+        if (closed)
+            path.push_back(points[0]);
+        double length = 0;
+        for (size_t i = 1; i < path.size(); ++i)
+            length += distance(path[i - 1], path[i]);
+
+        dashes.clear();
+        pattern.dash(points.data(), points.size(), closed, true, dashes);
+        const std::vector<double> expected = referenceDashes(lengths, scale, length);
+        CHECK(dashes.size() == expected.size());
+        size_t at = 0;
+        for (size_t i = 0; i < std::min(dashes.size(), expected.size()); ++i)
+        {
+            double dash = 0;
+            for (size_t k = 1; k < dashes.counts[i]; ++k)
+                dash += distance(dashes.points[at + k - 1], dashes.points[at + k]);
+            at += dashes.counts[i];
+            CHECK(std::fabs(dash - expected[i]) < 1e-7 * std::max(1.0, length));
+        }
+
+        dashes.clear();
+        pattern.dash(points.data(), points.size(), closed, false, dashes);
+        size_t perSegment = 0;
+        for (size_t i = 1; i < path.size(); ++i)
+            perSegment += referenceDashes(lengths, scale, distance(path[i - 1], path[i])).size();
+        CHECK(dashes.size() == perSegment);
+    }
+}
+
+/* Only linetypes of dashes and gaps at a positive scale compile. */
+void testCompile()
+{
+    AcDbLinetypeTableRecord record;
+    LinetypePattern pattern;
+    record.dashes = {0.5, -0.25};
+    CHECK(LinetypePattern::compile(record, 2.0, pattern) == Acad::eOk);
+    CHECK(std::fabs(pattern.length() - 1.5) < 1e-12);
+    CHECK(pattern.continuousLinetype().stubHandle == 7);
+    CHECK(LinetypePattern::compile(record, 0.0, pattern) == Acad::eInvalidInput);
+    CHECK(LinetypePattern::compile(record, -1.0, pattern) == Acad::eInvalidInput);
+
+    record.shape = 3;
+    CHECK(LinetypePattern::compile(record, 1.0, pattern) == Acad::eNotApplicable);
+    record.shape = 0;
+    record.scaledToFit = true;
+    CHECK(LinetypePattern::compile(record, 1.0, pattern) == Acad::eNotApplicable);
+    record.scaledToFit = false;
+    record.dashes = {0.5};
+    CHECK(LinetypePattern::compile(record, 1.0, pattern) == Acad::eNotApplicable);
+}
+
+/* The engine draws a HIDDEN polyline as one polyPolyline in the continuous
+   linetype, puts the traits' linetype back and compiles the pattern once;
+   a linetype with shapes goes to AutoCAD's engine, every time. */
+void testEngine()
+{
+    AcDbLinetypeTableRecord hidden;
+    hidden.name = L"HIDDEN";
+    hidden.dashes = {0.25, -0.125};
+    AcDbObjectId hiddenId;
+    hiddenId.stubHandle = 100;
+    hiddenId.pStubObject = &hidden;
+
+    StubWorldDraw draw;
+    AcDbObjectId byLayer;
+    byLayer.stubHandle = 42;
+    draw.subEntityTraits().setLineType(byLayer);
+
+    const std::shared_ptr<LinetypePatternCache> pCache = std::make_shared<LinetypePatternCache>();
+    CachingLinetypeEngine engine(pCache);
+    const AcGePoint3d points[] = {{0, 0, 0}, {10, 0, 0}, {10, 10, 0}};
+    CHECK(engine.tessellate(false, false, 3, points, &draw, hiddenId, 1.0, nullptr, true) == Acad::eOk);
+    CHECK(draw.polyPolylineCalls == 1 && draw.polylines.size() == 54);
+    CHECK(std::all_of(draw.polylines.begin(), draw.polylines.end(),
+                      [](const StubWorldDraw::Polyline& polyline)
+                      { return polyline.linetype.stubHandle == 7 && polyline.points.size() >= 2; }));
+    CHECK(draw.subEntityTraits().lineTypeId() == byLayer);
+    CHECK(pCache->size() == 1);
+
+    engine.tessellate(false, false, 3, points, &draw, hiddenId, 1.0, nullptr, true);
+    CHECK(draw.polyPolylineCalls == 2 && draw.polylines.size() == 108 && pCache->size() == 1);
+
+    AcDbLinetypeTableRecord batting;
+    batting.dashes = {0.5, -0.2};
+    batting.shape = 3;
+    AcDbObjectId battingId;
+    battingId.stubHandle = 101;
+    battingId.pStubObject = &batting;
+    const int baseCalls = AcGiLinetypeEngine::stubBaseCalls;
+    engine.tessellate(false, false, 3, points, &draw, battingId, 1.0, nullptr, true);
+    CHECK(AcGiLinetypeEngine::stubBaseCalls == baseCalls + 1 && draw.polyPolylineCalls == 2);
+    engine.tessellate(false, false, 3, points, &draw, battingId, 1.0, nullptr, true);
+    CHECK(AcGiLinetypeEngine::stubBaseCalls == baseCalls + 2 && pCache->size() == 2);
+
+    pCache->clear();
+    CHECK(pCache->size() == 0);
+}
+
+/* A dense site plan of polylines of 2 to 40 vertices in HIDDEN and CENTER
+   at scale 4, with the pattern compiled for every polyline, taken from the
+   cache and compiled once. */
+void benchmarkDashing(unsigned long polylineCount)
+{
+    std::mt19937 random(9);
+    std::vector<std::vector<AcGePoint3d>> plan(polylineCount);
+    size_t segments = 0;
+    for (std::vector<AcGePoint3d>& polyline : plan)
+    {
+        double x = random() % 10000, y = random() % 10000;
+        for (int i = 2 + int(random() % 39); i > 0; --i)
+        {
+            polyline.emplace_back(x, y, 0);
+            x += int(random() % 200) / 10.0 - 10;
+            y += int(random() % 200) / 10.0 - 10;
+        }
+        segments += polyline.size() - 1;
+    }
+
+    AcDbLinetypeTableRecord hidden, center;
+    hidden.dashes = {0.25, -0.125};
+    center.dashes = {1.25, -0.25, 0.25, -0.25};
+    AcDbObjectId hiddenId, centerId;
+    hiddenId.stubHandle = 100;
+    hiddenId.pStubObject = &hidden;
+    centerId.stubHandle = 101;
+    centerId.pStubObject = &center;
+
+    DashedPolylines dashes;
+    size_t perCall = 0;
+    Stopwatch watch;
+    for (size_t i = 0; i < plan.size(); ++i)
+    {
+        LinetypePattern pattern;
+        LinetypePattern::compile(i % 2 != 0 ? hidden : center, 4.0, pattern);
+        dashes.clear();
+        pattern.dash(plan[i].data(), plan[i].size(), false, true, dashes);
+        perCall += dashes.size();
+    }
+    const double compiling = watch.milliseconds();
+
+    LinetypePatternCache cache;
+    size_t cached = 0;
+    watch.restart();
+    for (size_t i = 0; i < plan.size(); ++i)
+    {
+        const std::shared_ptr<const LinetypePattern> pPattern = cache.find(i % 2 != 0 ? hiddenId : centerId, 4.0);
+        dashes.clear();
+        pPattern->dash(plan[i].data(), plan[i].size(), false, true, dashes);
+        cached += dashes.size();
+    }
+    const double fromCache = watch.milliseconds();
+
+    LinetypePattern hiddenPattern, centerPattern;
+    LinetypePattern::compile(hidden, 4.0, hiddenPattern);
+    LinetypePattern::compile(center, 4.0, centerPattern);
+    size_t compiled = 0;
+    watch.restart();
+    for (size_t i = 0; i < plan.size(); ++i)
+    {
+        dashes.clear();
+        (i % 2 != 0 ? hiddenPattern : centerPattern).dash(plan[i].data(), plan[i].size(), false, true, dashes);
+        compiled += dashes.size();
+    }
+    const double precompiled = watch.milliseconds();
+
+    CHECK(cached == perCall && compiled == perCall);
+    std::printf("%lu polylines, %zu segments, %zu dashes: compiled per call %.1f ms, cache %.1f ms, "
+                "compiled once %.1f ms\n",
+                polylineCount, segments, perCall, compiling, fromCache, precompiled);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testSameAsReference(5000);
+    testCompile();
+    testEngine();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkDashing(sizeArgument(argc, argv, 0, 20000));
+
+    return finish();
+}
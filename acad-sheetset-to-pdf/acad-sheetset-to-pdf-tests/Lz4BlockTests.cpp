@@ -0,0 +1,140 @@
+#include "stdafx.h"
+#include "Lz4Block.h"
+
+#include <algorithm>
+#include <random>
+
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+enum SampleKind
+{
+    kRandom,
+    kFewLetters,
+    kOneByte,
+    kCoordinates
+};
+
+/// <summary>
+/// size bytes of kind: incompressible, drawn from a dozen letters, all the
+/// same, or the bytes of doubles counting up in quarters with one byte in
+/// fifty flipped, as serialized graphics are.
+/// </summary>
+std::vector<Adesk::UInt8> sample(size_t size, SampleKind kind, unsigned seed)
+{
+    std::mt19937 random(seed);
+    std::vector<Adesk::UInt8> bytes(size);
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (kind == kRandom)
+            bytes[i] = Adesk::UInt8(random());
+        else if (kind == kFewLetters)
+            bytes[i] = Adesk::UInt8("abcabcabdxyz"[random() % 12]);
+        else if (kind == kOneByte)
+            bytes[i] = 7;
+        else
+        {
+            const double value = double(i / 8) * 0.25;
+            bytes[i] = reinterpret_cast<const Adesk::UInt8*>(&value)[i % 8] ^ (random() % 50 == 0 ? 1 : 0);
+        }
+    }
+    return bytes;
+}
+
+/* Every kind of data at sizes round the minimum match and the hash table
+   compresses within the bound and back, and a destination one byte short
+   of the block is refused. */
+void testRoundTrip()
+{
+    for (SampleKind kind : {kRandom, kFewLetters, kOneByte, kCoordinates})
+    {
+        for (size_t size : {0, 1, 5, 12, 13, 14, 20, 100, 1000, 65536, 70000, 300000})
+        {
+            const std::vector<Adesk::UInt8> bytes = sample(size, kind, unsigned(size) + kind);
+            std::vector<Adesk::UInt8> packed(lz4CompressBound(size));
+            const size_t packedSize = lz4Compress(bytes.data(), size, packed.data(), packed.size());
+            CHECK(packedSize != 0 && packedSize <= packed.size());
+            if (kind == kOneByte && size >= 65536)
+                CHECK(packedSize < size / 100);
+
+            std::vector<Adesk::UInt8> unpacked(size + 1);
+            CHECK(lz4Decompress(packed.data(), packedSize, unpacked.data(), size) == Acad::eOk);
+            CHECK(std::equal(bytes.begin(), bytes.end(), unpacked.begin()));
+
+            size_t unpackedSize = 0;
+            CHECK(lz4Decompress(packed.data(), packedSize, unpacked.data(), unpacked.size(), unpackedSize) ==
+                  Acad::eOk);
+            CHECK(unpackedSize == size);
+            if (size > 20)
+            {
+                CHECK(lz4Compress(bytes.data(), size, packed.data(), packedSize - 1) == 0);
+                CHECK(lz4Decompress(packed.data(), packedSize, unpacked.data(), size - 1, unpackedSize) ==
+                      Acad::eInvalidInput);
+            }
+        }
+    }
+}
+
+/* Blocks with bits flipped, cut short or decoded to the wrong size are
+   refused or decoded within the buffers, never past them. */
+void testDamagedBlocks()
+{
+    std::mt19937 random(17);
+    for (SampleKind kind : {kFewLetters, kCoordinates})
+    {
+        const std::vector<Adesk::UInt8> bytes = sample(20000, kind, 1);
+        std::vector<Adesk::UInt8> packed(lz4CompressBound(bytes.size()));
+        packed.resize(lz4Compress(bytes.data(), bytes.size(), packed.data(), packed.size()));
+
+        /* Decoded into exactly its size, with nothing spare either side,
+           so that a write out of bounds lands outside the vector. */
+        std::vector<Adesk::UInt8> unpacked(bytes.size());
+        CHECK(lz4Decompress(packed.data(), packed.size(), unpacked.data(), bytes.size() + 1) == Acad::eInvalidInput);
+        CHECK(lz4Decompress(packed.data(), packed.size() - 1, unpacked.data(), bytes.size()) == Acad::eInvalidInput);
+        for (int trial = 0; trial < 2000; ++trial)
+        {
+            std::vector<Adesk::UInt8> damaged = packed;
+            damaged[random() % damaged.size()] ^= Adesk::UInt8(1u << (random() % 8));
+            const Acad::ErrorStatus es = lz4Decompress(damaged.data(), damaged.size(), unpacked.data(), unpacked.size());
+            CHECK(es == Acad::eOk || es == Acad::eInvalidInput);
+        }
+    }
+}
+
+/* Coordinates and text compressed and decompressed in one block. */
+void benchmarkBlocks(unsigned long megabytes)
+{
+    for (SampleKind kind : {kFewLetters, kCoordinates})
+    {
+        const std::vector<Adesk::UInt8> bytes = sample(size_t(megabytes) << 20, kind, 3);
+        std::vector<Adesk::UInt8> packed(lz4CompressBound(bytes.size()));
+        std::vector<Adesk::UInt8> unpacked(bytes.size());
+        Stopwatch watch;
+        const size_t packedSize = lz4Compress(bytes.data(), bytes.size(), packed.data(), packed.size());
+        const double compressing = watch.milliseconds();
+        watch.restart();
+        CHECK(lz4Decompress(packed.data(), packedSize, unpacked.data(), unpacked.size()) == Acad::eOk);
+        const double decompressing = watch.milliseconds();
+        CHECK(unpacked == bytes);
+        std::printf("%lu MB of %s: ratio %.3f, compress %.0f MB/s, decompress %.0f MB/s\n", megabytes,
+                    kind == kFewLetters ? "text" : "coordinates", double(packedSize) / bytes.size(),
+                    bytes.size() / 1e3 / compressing, bytes.size() / 1e3 / decompressing);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testRoundTrip();
+    testDamagedBlocks();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkBlocks(sizeArgument(argc, argv, 0, 16));
+
+    return finish();
+}
@@ -0,0 +1,324 @@
+#include "stdafx.h"
+#include "MappedPointCloudBuffer.h"
+#include "PointCloudTextConverter.h"
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+const char kText[] = "MappedPointCloudBufferTests.xyz";
+const wchar_t kTextName[] = L"MappedPointCloudBufferTests.xyz";
+const char kPtsText[] = "MappedPointCloudBufferTests.pts";
+const wchar_t kPtsTextName[] = L"MappedPointCloudBufferTests.pts";
+const char kColumns[] = "MappedPointCloudBufferTests.pcc";
+const wchar_t kColumnsName[] = L"MappedPointCloudBufferTests.pcc";
+
+void writeFile(const char* path, const std::string& content)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << content;
+}
+
+/* Converts text and opens what came out, or returns null. */
+MappedPointCloudBuffer* convert(const std::string& text, PointCloudTextFormat format = kPointCloudTextXyz,
+                                Acad::ErrorStatus* pStatus = nullptr)
+{
+    writeFile(kText, text);
+    Acad::ErrorStatus es = convertPointCloudText(kTextName, kColumnsName, format);
+    MappedPointCloudBuffer* pBuffer = nullptr;
+    if (es == Acad::eOk)
+        es = MappedPointCloudBuffer::open(kColumnsName, pBuffer);
+    if (pStatus != nullptr)
+        *pStatus = es;
+    return pBuffer;
+}
+
+/* Points, intensities scaled to the file's range, clamped colours and
+   normals come out of each XYZ layout; comments, blank lines, CRLF and
+   commas are skipped. */
+void testXyzLayouts()
+{
+    MappedPointCloudBuffer* pBuffer = convert("# x y z\r\n"
+                                              "1 2 3\r\n"
+                                              "\r\n"
+                                              "// a comment\n"
+                                              "-4.5,5e1,  6\n"
+                                              "\t7 8 -9");
+    CHECK(pBuffer != nullptr);
+    if (pBuffer != nullptr)
+    {
+        CHECK(pBuffer->numPoints() == 3);
+        CHECK(pBuffer->points()[1] == AcGePoint3d(-4.5, 50, 6) && pBuffer->points()[2] == AcGePoint3d(7, 8, -9));
+        CHECK(pBuffer->normals() == nullptr && pBuffer->colors() == nullptr && pBuffer->intensity() == nullptr &&
+              pBuffer->classifications() == nullptr);
+        CHECK(!pBuffer->hasData(IAcDbPointCloudDataBuffer::kIntensity));
+        AcGePoint3d minPoint, maxPoint;
+        pBuffer->extents(minPoint, maxPoint);
+        CHECK(minPoint == AcGePoint3d(-4.5, 2, -9) && maxPoint == AcGePoint3d(7, 50, 6));
+        CHECK(pBuffer->transform().entry[0][0] == 1 && pBuffer->transform().entry[0][3] == 0);
+        pBuffer->prefetch(2, 100, ~0u);
+        pBuffer->prefetch(3, 1);
+        pBuffer->freeObject();
+    }
+
+    pBuffer = convert("0 0 0 10\n1 1 1 30\n2 2 2 20\n");
+    CHECK(pBuffer != nullptr && pBuffer->hasData(IAcDbPointCloudDataBuffer::kIntensity));
+    if (pBuffer != nullptr)
+    {
+        const Adesk::UInt8* pIntensity = pBuffer->intensity();
+        CHECK(pIntensity[0] == 0 && pIntensity[1] == 255 && pIntensity[2] == 128);
+        pBuffer->freeObject();
+    }
+
+    pBuffer = convert("0 0 0 12 300 -4 0 0 1\n1 1 1 0 0 0 0.5 0.5 0\n");
+    CHECK(pBuffer != nullptr && pBuffer->hasData(IAcDbPointCloudDataBuffer::kColor) &&
+          pBuffer->hasData(IAcDbPointCloudDataBuffer::kNormal));
+    if (pBuffer != nullptr)
+    {
+        const IAcDbPointCloudDataBuffer::RGBA* pColors = pBuffer->colors();
+        CHECK(pColors[0][0] == 12 && pColors[0][1] == 255 && pColors[0][2] == 0 && pColors[0][3] == 0);
+        CHECK(pBuffer->normals()[0] == AcGeVector3d(0, 0, 1) && pBuffer->normals()[1] == AcGeVector3d(0.5, 0.5, 0));
+        CHECK(pBuffer->intensity() == nullptr);
+        pBuffer->freeObject();
+    }
+
+    pBuffer = convert("0 0 0 5 1 2 3\n");
+    CHECK(pBuffer != nullptr && pBuffer->hasData(IAcDbPointCloudDataBuffer::kIntensity) &&
+          pBuffer->hasData(IAcDbPointCloudDataBuffer::kColor));
+    if (pBuffer != nullptr)
+    {
+        CHECK(pBuffer->colors()[0][2] == 3 && pBuffer->intensity()[0] == 0);
+        pBuffer->freeObject();
+    }
+
+    pBuffer = convert("");
+    CHECK(pBuffer != nullptr && pBuffer->numPoints() == 0 && pBuffer->points() == nullptr);
+    if (pBuffer != nullptr)
+        pBuffer->freeObject();
+}
+
+/* PTS blocks start with a count line; intensities are scaled from
+   [-2048, 2047], and the extension picks the dialect. */
+void testPts()
+{
+    writeFile(kPtsText, "2\n0 0 0 -2048 1 2 3\n1 0 0 2047 4 5 6\n1\n2 0 0 0 7 8 9\n");
+    CHECK(convertPointCloudText(kPtsTextName, kColumnsName) == Acad::eOk);
+    MappedPointCloudBuffer* pBuffer = nullptr;
+    CHECK(MappedPointCloudBuffer::open(kColumnsName, pBuffer) == Acad::eOk);
+    if (pBuffer != nullptr)
+    {
+        CHECK(pBuffer->numPoints() == 3 && pBuffer->points()[2].x == 2);
+        CHECK(pBuffer->intensity()[0] == 0 && pBuffer->intensity()[1] == 255 && pBuffer->intensity()[2] == 128);
+        CHECK(pBuffer->colors()[2][0] == 7);
+        pBuffer->freeObject();
+    }
+    std::remove(kPtsText);
+
+    /* A count line is only a count line in PTS. */
+    Acad::ErrorStatus es = Acad::eOk;
+    CHECK(convert("1\n0 0 0\n", kPointCloudTextXyz, &es) == nullptr && es == Acad::eInvalidInput);
+}
+
+/* Text that is not a point cloud is refused before anything is written. */
+void testMalformedText()
+{
+    const char* const kMalformed[] = {
+        "0 0 0\n1 1 x\n",            // not a number
+        "0 0 0\n1 1 1.5abc\n",       // a number with something stuck to it
+        "0 0 0\n1 1 1 1\n",          // lines of different lengths
+        "0 0\n",                     // too few fields
+        "0 1 2 3 4 5 6 7 8 9\n",     // too many
+        "0 0 0\n\n1 1\n",
+    };
+    for (const char* pText : kMalformed)
+    {
+        std::remove(kColumns);
+        Acad::ErrorStatus es = Acad::eOk;
+        CHECK(convert(pText, kPointCloudTextXyz, &es) == nullptr && es == Acad::eInvalidInput);
+        CHECK(!fileExists(kColumns));
+    }
+
+    CHECK(convertPointCloudText(nullptr, kColumnsName) == Acad::eNullPtr);
+    CHECK(convertPointCloudText(kTextName, nullptr) == Acad::eNullPtr);
+    CHECK(convertPointCloudText(L"MappedPointCloudBufferTests.missing.xyz", kColumnsName) != Acad::eOk);
+}
+
+/* A column file cut short anywhere, with a header that never got written,
+   or with its header altered is refused. */
+void testDamagedColumns()
+{
+    std::string text;
+    for (int i = 0; i < 5000; ++i)
+        text += std::to_string(i) + " " + std::to_string(i % 7) + " 1.5 " + std::to_string(i % 100) + "\n";
+    MappedPointCloudBuffer* pBuffer = convert(text);
+    CHECK(pBuffer != nullptr && pBuffer->numPoints() == 5000);
+    if (pBuffer != nullptr)
+        pBuffer->freeObject();
+    const std::string good = readFile(kColumns);
+    const std::string kDamaged = "MappedPointCloudBufferTests.damaged.pcc";
+    const std::wstring damagedName(kDamaged.begin(), kDamaged.end());
+
+    auto openDamaged = [&](const std::string& bytes)
+    {
+        writeFile(kDamaged.c_str(), bytes);
+        MappedPointCloudBuffer* pDamaged = nullptr;
+        const Acad::ErrorStatus es = MappedPointCloudBuffer::open(damagedName.c_str(), pDamaged);
+        CHECK((es == Acad::eOk) == (pDamaged != nullptr));
+        if (pDamaged != nullptr)
+            pDamaged->freeObject();
+        return es;
+    };
+
+    CHECK(openDamaged(good) == Acad::eOk);
+    for (size_t size : {size_t(1), sizeof(PointCloudColumnHeader) - 1, sizeof(PointCloudColumnHeader),
+                        size_t(kPointCloudSectionAlignment), good.size() - 1})
+        CHECK(openDamaged(good.substr(0, size)) != Acad::eOk);
+    CHECK(openDamaged(std::string(good.size(), '\0')) == Acad::eUnsupportedFileFormat);
+
+    PointCloudColumnHeader header;
+    std::memcpy(&header, good.data(), sizeof(header));
+    auto withHeader = [&](const PointCloudColumnHeader& altered)
+    {
+        std::string bytes = good;
+        std::memcpy(&bytes[0], &altered, sizeof(altered));
+        return openDamaged(bytes);
+    };
+    PointCloudColumnHeader altered = header;
+    altered.magic[0] = 'X';
+    CHECK(withHeader(altered) == Acad::eUnsupportedFileFormat);
+    altered = header;
+    altered.version = kPointCloudColumnFileVersion + 1;
+    CHECK(withHeader(altered) == Acad::eInvalidDwgVersion);
+    altered = header;
+    altered.numPoints = ~0ull / 8;
+    CHECK(withHeader(altered) == Acad::eInvalidInput);
+    altered = header;
+    altered.numPoints = header.numPoints * 100;
+    CHECK(withHeader(altered) == Acad::eInvalidInput);
+    altered = header;
+    altered.sections[kIntensityColumn].offset += 8;
+    CHECK(withHeader(altered) == Acad::eInvalidInput);
+    altered = header;
+    altered.dataTypes |= IAcDbPointCloudDataBuffer::kNormal;
+    CHECK(withHeader(altered) == Acad::eInvalidInput);
+
+    std::remove(kDamaged.c_str());
+    MappedPointCloudBuffer* pMissing = nullptr;
+    CHECK(MappedPointCloudBuffer::open(L"MappedPointCloudBufferTests.missing.pcc", pMissing) != Acad::eOk &&
+          pMissing == nullptr);
+}
+
+/* Drops the file's pages from the system cache, so that the next read
+   goes to the disk. */
+void evictFromCache(const char* path)
+{
+#ifdef _WIN32
+    /* Opening a file unbuffered makes the cache manager flush and purge
+       what it holds of it. */
+    const std::wstring name = std::filesystem::path(path).wstring();
+    const HANDLE hFile = ::CreateFileW(name.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                       OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, nullptr);
+    if (hFile != INVALID_HANDLE_VALUE)
+        ::CloseHandle(hFile);
+#else
+    const int fd = ::open(path, O_RDONLY);
+    if (fd >= 0)
+    {
+        ::fdatasync(fd);
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    }
+#endif
+}
+
+/* Scans every point, or every point and intensity, of the column file
+   and returns the sum, so that nothing can be skipped. */
+double scan(bool withIntensity)
+{
+    MappedPointCloudBuffer* pBuffer = nullptr;
+    if (MappedPointCloudBuffer::open(kColumnsName, pBuffer) != Acad::eOk)
+        return 0;
+    pBuffer->prefetch(0, pBuffer->numPoints(), withIntensity ? IAcDbPointCloudDataBuffer::kIntensity : 0);
+    const AcGePoint3d* pPoints = pBuffer->points();
+    const Adesk::UInt8* pIntensity = pBuffer->intensity();
+    double sum = 0;
+    for (Adesk::UInt64 i = 0; i < pBuffer->numPoints(); ++i)
+        sum += pPoints[i].x + (withIntensity ? pIntensity[i] : 0);
+    pBuffer->freeObject();
+    return sum;
+}
+
+/* A scan with colours and intensities converted, then read cold, straight
+   after its pages were dropped from the cache, and warm, points alone and
+   with intensities. */
+void benchmarkReads(unsigned long pointCount)
+{
+    std::mt19937 random(11);
+    {
+        std::ofstream file(kText, std::ios::binary | std::ios::trunc);
+        char line[96];
+        for (unsigned long i = 0; i < pointCount; ++i)
+        {
+            const int length = std::snprintf(line, sizeof(line), "%.3f %.3f %.3f %u %u %u %u\n",
+                                             (random() % 100000) / 1000.0, (random() % 100000) / 1000.0,
+                                             (random() % 5000) / 1000.0, unsigned(random() % 4096),
+                                             unsigned(random() % 256), unsigned(random() % 256),
+                                             unsigned(random() % 256));
+            file.write(line, length);
+        }
+    }
+    const double textMegabytes = std::filesystem::file_size(kText) / 1e6;
+
+    Stopwatch watch;
+    CHECK(convertPointCloudText(kTextName, kColumnsName) == Acad::eOk);
+    const double converting = watch.milliseconds();
+    const double columnMegabytes = std::filesystem::file_size(kColumns) / 1e6;
+    std::printf("%lu points, %.1f MB of text: converted in %.1f ms (%.0f MB/s) to %.1f MB of columns\n", pointCount,
+                textMegabytes, converting, textMegabytes * 1e3 / converting, columnMegabytes);
+
+    const double pointMegabytes = pointCount * sizeof(AcGePoint3d) / 1e6;
+    for (bool withIntensity : {false, true})
+    {
+        const double megabytes = pointMegabytes + (withIntensity ? pointCount / 1e6 : 0);
+        evictFromCache(kColumns);
+        watch.restart();
+        const double cold = scan(withIntensity);
+        const double coldTime = watch.milliseconds();
+        watch.restart();
+        const double warm = scan(withIntensity);
+        const double warmTime = watch.milliseconds();
+        CHECK(cold == warm);
+        std::printf("%s: cold %.1f ms (%.0f MB/s), warm %.1f ms (%.0f MB/s)\n",
+                    withIntensity ? "points and intensities" : "points", coldTime, megabytes * 1e3 / coldTime,
+                    warmTime, megabytes * 1e3 / warmTime);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testXyzLayouts();
+    testPts();
+    testMalformedText();
+    testDamagedColumns();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkReads(sizeArgument(argc, argv, 0, 200000));
+
+    std::remove(kText);
+    std::remove(kColumns);
+    return finish();
+}
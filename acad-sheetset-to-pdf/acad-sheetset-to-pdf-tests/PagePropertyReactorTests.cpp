@@ -0,0 +1,295 @@
+#include "stdafx.h"
+#include "PagePropertyReactor.h"
+#include "PublishMetadataReactor.h"
+
+#include <algorithm>
+#include <cwchar>
+#include <map>
+
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+/* The DMM reactors added, as AutoCAD's DMM reactor manager keeps them. */
+std::vector<AcDMMReactor*> s_dmmReactors;
+
+void addDmmReactor(AcDMMReactor* pReactor)
+{
+    s_dmmReactors.push_back(pReactor);
+}
+
+void removeDmmReactor(AcDMMReactor* pReactor)
+{
+    s_dmmReactors.erase(std::remove(s_dmmReactors.begin(), s_dmmReactors.end(), pReactor), s_dmmReactors.end());
+}
+
+/// <summary>
+/// jobProperties properties Job0... for the job and sheetProperties
+/// properties Sheet0... for every sheet, whose values name the sheet by
+/// its title.  A sheet titled "plain" has none, and one titled "override"
+/// also sets Job0.
+/// </summary>
+class StubSource : public PublishMetadataSource
+{
+public:
+    StubSource(int jobProperties, int sheetProperties)
+        : m_jobProperties(jobProperties), m_sheetProperties(sheetProperties)
+    {
+    }
+
+    Acad::ErrorStatus prepare(const AcPlDSDData& dsd, AcNameValuePairVec& properties) override
+    {
+        for (int i = 0; i < m_jobProperties; ++i)
+            properties.append(AcNameValuePair((L"Job" + std::to_wstring(i)).c_str(), L"job value"));
+        return Acad::eOk;
+    }
+    Acad::ErrorStatus collect(const AcPlDSDEntry& entry, AcNameValuePairVec& properties) const override
+    {
+        const std::wstring title = entry.title();
+        if (title == L"plain")
+            return Acad::eOk;
+        for (int i = 0; i < m_sheetProperties; ++i)
+            properties.append(AcNameValuePair((L"Sheet" + std::to_wstring(i)).c_str(), (title + L" value").c_str()));
+        if (title == L"override")
+            properties.append(AcNameValuePair(L"Job0", L"sheet's own"));
+        return Acad::eOk;
+    }
+
+private:
+    int m_jobProperties;
+    int m_sheetProperties;
+};
+
+/// <summary>
+/// A starting job, keeping the private sections written to it.
+/// </summary>
+class StubBeginJobInfo : public AcPublishBeginJobInfo
+{
+public:
+    explicit StubBeginJobInfo(const AcPlDSDData& dsd) : m_dsd(dsd) {}
+
+    const AcPlDSDData* GetDSDData() override { return &m_dsd; }
+    const AcNameValuePairVec GetPrivateData(const ACHAR* sectionName) override { return sections[sectionName]; }
+    bool WritePrivateSection(const ACHAR* sectionName, const AcNameValuePairVec nameValuePairVec) override
+    {
+        sections[sectionName] = nameValuePairVec;
+        return true;
+    }
+    bool JobWillPublishInBackground() override { return false; }
+    AcPlPlotLogger* GetPlotLogger() override { return nullptr; }
+
+    std::map<std::wstring, AcNameValuePairVec> sections;
+
+private:
+    const AcPlDSDData& m_dsd;
+};
+
+class StubSheetInfo : public AcPublishSheetInfo
+{
+public:
+    explicit StubSheetInfo(const AcPlDSDEntry* pEntry) : m_pEntry(pEntry) {}
+
+    const AcPlDSDEntry* GetDSDEntry() override { return m_pEntry; }
+    const ACHAR* GetUniqueId() override { return ACRX_T(""); }
+    AcPlPlotLogger* GetPlotLogger() override { return nullptr; }
+
+private:
+    const AcPlDSDEntry* m_pEntry;
+};
+
+/// <summary>
+/// Keeps the properties added to the page.
+/// </summary>
+class StubSheetReactorInfo : public AcDMMSheetReactorInfo
+{
+public:
+    void AddPageProperties(AcDMMEPlotPropertyVec properties) override { this->properties.append(properties); }
+    void AddPageResources(AcDMMResourceVec resources) override {}
+
+    const AcDMMEPlotProperty* find(const wchar_t* name) const
+    {
+        for (int i = 0; i < properties.length(); ++i)
+        {
+            if (std::wcscmp(properties[i].GetName(), name) == 0)
+                return &properties[i];
+        }
+        return nullptr;
+    }
+
+    bool hasValue(const wchar_t* name, const wchar_t* value) const
+    {
+        const AcDMMEPlotProperty* pProperty = find(name);
+        return pProperty != nullptr && pProperty->GetValue() != nullptr && std::wcscmp(pProperty->GetValue(), value) == 0;
+    }
+
+    AcDMMEPlotPropertyVec properties;
+};
+
+AcPlDSDData makeDsd(const std::vector<std::wstring>& titles)
+{
+    AcPlDSDData dsd;
+    for (size_t i = 0; i < titles.size(); ++i)
+    {
+        AcPlDSDEntry entry;
+        entry.drawing = L"C:\\set\\d" + std::to_wstring(i / 2) + L".dwg";
+        entry.layoutName = L"Layout" + std::to_wstring(i);
+        entry.sheetTitle = titles[i];
+        dsd.entries.append(entry);
+    }
+    return dsd;
+}
+
+/* Publishes the sheet at entry as AutoCAD would once the job has begun:
+   the publish reactor hears of the sheet, then the DMM reactors of its
+   page. */
+void publishSheet(PagePropertyReactor& reactor, const AcPlDSDEntry& entry, StubSheetReactorInfo& page)
+{
+    StubSheetInfo sheet(&entry);
+    reactor.OnBeginPublishingSheet(&sheet);
+    for (AcDMMReactor* pReactor : s_dmmReactors)
+    {
+        pReactor->OnBeginSheet(&page);
+        pReactor->OnEndSheet(&page);
+    }
+}
+
+/* What PublishMetadataReactor writes to the DSD reaches every page, the
+   job's properties with their values and the sheets' with each sheet's, and
+   the DMM reactor is only there while the job is. */
+void testPagesGetTheirMetadata()
+{
+    StubSource source(2, 2);
+    PublishMetadataReactor metadata(source);
+    PagePropertyReactor reactor(&addDmmReactor, &removeDmmReactor);
+    const AcPlDSDData dsd = makeDsd({L"first", L"plain", L"override"});
+    StubBeginJobInfo begin(dsd);
+    metadata.OnAboutToBeginPublishing(&begin);
+    reactor.OnAboutToBeginPublishing(&begin);
+    CHECK(s_dmmReactors.size() == 1);
+
+    StubSheetReactorInfo pages[3];
+    for (int i = 0; i < 3; ++i)
+        publishSheet(reactor, dsd.entries[i], pages[i]);
+    CHECK(pages[0].properties.length() == 4);
+    CHECK(pages[0].hasValue(L"Job1", L"job value") && pages[0].hasValue(L"Sheet0", L"first value"));
+    CHECK(std::wcscmp(pages[0].find(L"Job0")->GetCategory(), PagePropertyReactor::kJobCategory) == 0);
+    CHECK(std::wcscmp(pages[0].find(L"Sheet1")->GetCategory(), PagePropertyReactor::kSheetCategory) == 0);
+    CHECK(pages[1].hasValue(L"Job0", L"job value") && pages[1].hasValue(L"Sheet0", L""));
+    CHECK(pages[2].hasValue(L"Job0", L"sheet's own") && pages[2].hasValue(L"Sheet1", L"override value"));
+    CHECK(reactor.emittedPageCount() == 3);
+
+    /* A sheet the DSD does not list gets nothing. */
+    AcPlDSDEntry stranger;
+    stranger.drawing = L"C:\\elsewhere.dwg";
+    stranger.layoutName = L"Layout0";
+    StubSheetReactorInfo strangerPage;
+    publishSheet(reactor, stranger, strangerPage);
+    CHECK(strangerPage.properties.isEmpty() && reactor.emittedPageCount() == 3);
+
+    reactor.OnEndPublish(nullptr);
+    CHECK(s_dmmReactors.empty());
+}
+
+/* A layout listed twice gets each entry's properties in turn, matched
+   whatever the case of its path. */
+void testRepeatedLayouts()
+{
+    StubSource source(0, 1);
+    PublishMetadataReactor metadata(source);
+    PagePropertyReactor reactor(&addDmmReactor, &removeDmmReactor);
+    AcPlDSDData dsd = makeDsd({L"once", L"twice"});
+    dsd.entries[1].drawing = dsd.entries[0].drawing;
+    dsd.entries[1].layoutName = dsd.entries[0].layoutName;
+    StubBeginJobInfo begin(dsd);
+    metadata.OnAboutToBeginPublishing(&begin);
+    reactor.OnAboutToBeginPublishing(&begin);
+
+    AcPlDSDEntry shouted = dsd.entries[0];
+    shouted.drawing = L"C:\\SET\\D0.DWG";
+    StubSheetReactorInfo first, second;
+    publishSheet(reactor, shouted, first);
+    publishSheet(reactor, shouted, second);
+    CHECK(first.hasValue(L"Sheet0", L"once value") && second.hasValue(L"Sheet0", L"twice value"));
+    reactor.OnCancelledOrFailedPublishing(nullptr);
+    CHECK(s_dmmReactors.empty());
+}
+
+/* A job without metadata, or a reactor without the DMM functions, adds no
+   DMM reactor; one destroyed during a job removes its own. */
+void testNothingToPublish()
+{
+    StubSource none(0, 0);
+    PublishMetadataReactor metadata(none);
+    const AcPlDSDData dsd = makeDsd({L"a", L"b"});
+    StubBeginJobInfo begin(dsd);
+    metadata.OnAboutToBeginPublishing(&begin);
+    PagePropertyReactor reactor(&addDmmReactor, &removeDmmReactor);
+    reactor.OnAboutToBeginPublishing(&begin);
+    CHECK(s_dmmReactors.empty());
+
+    StubSource source(1, 1);
+    PublishMetadataReactor withMetadata(source);
+    StubBeginJobInfo other(dsd);
+    withMetadata.OnAboutToBeginPublishing(&other);
+    PagePropertyReactor unregistered(nullptr, nullptr);
+    unregistered.OnAboutToBeginPublishing(&other);
+    CHECK(s_dmmReactors.empty());
+    {
+        PagePropertyReactor destroyed(&addDmmReactor, &removeDmmReactor);
+        destroyed.OnAboutToBeginPublishing(&other);
+        CHECK(s_dmmReactors.size() == 1);
+    }
+    CHECK(s_dmmReactors.empty());
+}
+
+/* A job of sheetCount sheets with 30 sheet set properties and 8 of each
+   sheet's: the time OnAboutToBeginPublishing takes to read the DSD and
+   build the sets, and the time per page. */
+void benchmarkPages(unsigned long sheetCount)
+{
+    StubSource source(30, 8);
+    PublishMetadataReactor metadata(source);
+    PagePropertyReactor reactor(&addDmmReactor, &removeDmmReactor);
+    std::vector<std::wstring> titles;
+    for (unsigned long i = 0; i < sheetCount; ++i)
+        titles.push_back(L"Sheet " + std::to_wstring(i));
+    const AcPlDSDData dsd = makeDsd(titles);
+    StubBeginJobInfo begin(dsd);
+    metadata.OnAboutToBeginPublishing(&begin);
+
+    Stopwatch watch;
+    reactor.OnAboutToBeginPublishing(&begin);
+    const double beginning = watch.milliseconds();
+    size_t properties = 0;
+    watch.restart();
+    for (unsigned long i = 0; i < sheetCount; ++i)
+    {
+        StubSheetReactorInfo page;
+        publishSheet(reactor, dsd.entries[int(i)], page);
+        properties += size_t(page.properties.length());
+    }
+    const double publishing = watch.milliseconds();
+    reactor.OnEndPublish(nullptr);
+    CHECK(reactor.emittedPageCount() == sheetCount && properties == sheetCount * 38);
+
+    std::printf("%lu pages, 38 properties each: job begins in %.2f ms, %.2f us per page, %llu vectors built\n",
+                sheetCount, beginning, publishing * 1e3 / sheetCount,
+                static_cast<unsigned long long>(reactor.emitter().buildCount()));
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testPagesGetTheirMetadata();
+    testRepeatedLayouts();
+    testNothingToPublish();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkPages(sizeArgument(argc, argv, 0, 2000));
+
+    return finish();
+}
@@ -0,0 +1,235 @@
+#include "stdafx.h"
+#include "PagePropertySet.h"
+
+#include <cwchar>
+#include <new>
+#include <random>
+
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+/* Every allocation of the program is counted, so the benchmark can report
+   what a sheet costs in allocations as well as in time. */
+static size_t s_allocations = 0;
+
+void* operator new(size_t size)
+{
+    ++s_allocations;
+    void* p = std::malloc(size != 0 ? size : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace {
+
+const int kPropertyCount = 30;
+
+/// <summary>
+/// Keeps the values of the last properties it was given.
+/// </summary>
+class StubSheetReactorInfo : public AcDMMSheetReactorInfo
+{
+public:
+    void AddPageProperties(AcDMMEPlotPropertyVec properties) override
+    {
+        propertyCount += size_t(properties.length());
+        if (!keepValues)
+            return;
+        values.clear();
+        for (int i = 0; i < properties.length(); ++i)
+            values.push_back(properties[i].GetValue());
+    }
+    void AddPageResources(AcDMMResourceVec resources) override { resourceCount += size_t(resources.length()); }
+
+    bool keepValues = false;
+    size_t propertyCount = 0;
+    size_t resourceCount = 0;
+    std::vector<std::wstring> values;
+};
+
+/* A template of title block fields as a sheet set would have them. */
+std::shared_ptr<const PagePropertyTemplate> makeTemplate()
+{
+    std::vector<PagePropertyDefinition> properties;
+    for (int i = 0; i < kPropertyCount; ++i)
+    {
+        properties.push_back(
+            {L"Prop" + std::to_wstring(i), L"Default value " + std::to_wstring(i), L"Sheet Set", L"string", L""});
+    }
+    std::shared_ptr<const PagePropertyTemplate> pTemplate;
+    PagePropertyTemplate::create(properties, {{L"thumbnail", L"image/png", L"C:\\thumbnail.png"}}, pTemplate);
+    return pTemplate;
+}
+
+/* Names must be present and unique. */
+void testTemplate()
+{
+    const std::shared_ptr<const PagePropertyTemplate> pTemplate = makeTemplate();
+    CHECK(pTemplate != nullptr);
+    CHECK(pTemplate->size() == kPropertyCount);
+    CHECK(pTemplate->find(ACRX_T("Prop7")) == 7);
+    CHECK(pTemplate->find(ACRX_T("prop7")) == PagePropertyTemplate::kNotFound);
+    CHECK(pTemplate->resources().size() == 1);
+
+    std::vector<PagePropertyDefinition> properties = {{L"A", L"1"}, {L"B", L"2"}, {L"A", L"3"}};
+    std::shared_ptr<const PagePropertyTemplate> pBad;
+    CHECK(PagePropertyTemplate::create(properties, {}, pBad) == Acad::eDuplicateKey);
+    CHECK(pBad == nullptr);
+    properties[2].name.clear();
+    CHECK(PagePropertyTemplate::create(properties, {}, pBad) == Acad::eInvalidInput);
+}
+
+/* Copies share their overrides until one of them is written to, and a
+   value set back to the template's is no override at all. */
+void testCopiesShareOverrides()
+{
+    const std::shared_ptr<const PagePropertyTemplate> pTemplate = makeTemplate();
+    PagePropertySet a(pTemplate);
+    CHECK(a.setValue(ACRX_T("Prop3"), ACRX_T("x")) == Acad::eOk);
+    CHECK(a.setValue(ACRX_T("nope"), ACRX_T("1")) == Acad::eKeyNotFound);
+
+    PagePropertySet b = a;
+    CHECK(b.setValue(3, ACRX_T("y")) == Acad::eOk);
+    CHECK(std::wcscmp(a.value(3), L"x") == 0);
+    CHECK(std::wcscmp(b.value(3), L"y") == 0);
+    CHECK(std::wcscmp(b.value(4), L"Default value 4") == 0);
+
+    CHECK(b.setValue(3, ACRX_T("Default value 3")) == Acad::eOk);
+    CHECK(b.overrideCount() == 0);
+    CHECK(a.overrideCount() == 1);
+
+    PagePropertySet c = a;
+    c.resetValue(3);
+    CHECK(c.overrideCount() == 0);
+    CHECK(a.overrideCount() == 1);
+
+    AcNameValuePairVec values;
+    values.append(AcNameValuePair(ACRX_T("Prop1"), ACRX_T("one")));
+    values.append(AcNameValuePair(ACRX_T("Other"), ACRX_T("two")));
+    CHECK(c.setValues(values) == 1);
+    CHECK(std::wcscmp(c.value(1), L"one") == 0);
+    c.resetAll();
+    CHECK(c.overrideCount() == 0);
+}
+
+/* Whatever sheets come one after another, the emitted values are those of
+   the sheet, and the template's vector is built only once. */
+void testEmitterDiffs()
+{
+    const std::shared_ptr<const PagePropertyTemplate> pTemplate = makeTemplate();
+    std::mt19937 random(7);
+    PagePropertyEmitter emitter;
+    StubSheetReactorInfo info;
+    info.keepValues = true;
+    for (int sheet = 0; sheet < 2000; ++sheet)
+    {
+        PagePropertySet set(pTemplate);
+        const int changes = int(random() % 8);
+        for (int n = 0; n < changes; ++n)
+            set.setValue(int(random() % kPropertyCount), (L"v" + std::to_wstring(random() % 4)).c_str());
+        emitter.emit(set, info);
+        CHECK(info.values.size() == size_t(kPropertyCount));
+        for (int i = 0; i < kPropertyCount && i < int(info.values.size()); ++i)
+            CHECK(info.values[size_t(i)] == set.value(i));
+    }
+    CHECK(emitter.buildCount() == 1);
+    CHECK(info.resourceCount == 2000);
+    CHECK(emitter.properties(PagePropertySet()).length() == 0);
+
+    /* A template more than the emitter keeps drops the oldest. */
+    PagePropertyEmitter small(1);
+    const std::shared_ptr<const PagePropertyTemplate> pOther = makeTemplate();
+    small.emit(PagePropertySet(pTemplate), info);
+    small.emit(PagePropertySet(pOther), info);
+    small.emit(PagePropertySet(pTemplate), info);
+    CHECK(small.buildCount() == 3);
+}
+
+/* Sheets of a set that differ in five of thirty properties: building the
+   property vector for every sheet against the emitter, and the copy that
+   AddPageProperties makes either way. */
+void benchmarkEmitter(unsigned long sheetCount)
+{
+    const std::shared_ptr<const PagePropertyTemplate> pTemplate = makeTemplate();
+    std::vector<PagePropertySet> sheets;
+    const PagePropertySet base(pTemplate);
+    for (unsigned long n = 0; n < sheetCount; ++n)
+    {
+        PagePropertySet set = base;
+        set.setValue(0, (L"Sheet " + std::to_wstring(n)).c_str());
+        set.setValue(1, (L"A-" + std::to_wstring(100 + n)).c_str());
+        set.setValue(2, ACRX_T("Layout1"));
+        set.setValue(5 + int(n % 20), ACRX_T("Rev B"));
+        set.setValue(27, (L"2026-10-" + std::to_wstring(1 + n % 28)).c_str());
+        sheets.push_back(set);
+    }
+    StubSheetReactorInfo info;
+
+    size_t allocations = s_allocations;
+    Stopwatch watch;
+    for (const PagePropertySet& set : sheets)
+    {
+        AcDMMEPlotPropertyVec properties;
+        for (int i = 0; i < kPropertyCount; ++i)
+        {
+            const PagePropertyDefinition& definition = pTemplate->property(i);
+            AcDMMEPlotProperty property(definition.name.c_str(), set.value(i));
+            property.SetCategory(definition.category.c_str());
+            property.SetType(definition.type.c_str());
+            properties.append(property);
+        }
+        info.AddPageProperties(properties);
+    }
+    const double rebuilt = watch.milliseconds();
+    const size_t rebuiltAllocations = s_allocations - allocations;
+
+    PagePropertyEmitter emitter;
+    allocations = s_allocations;
+    watch.restart();
+    for (const PagePropertySet& set : sheets)
+        emitter.emit(set, info);
+    const double emitted = watch.milliseconds();
+    const size_t emittedAllocations = s_allocations - allocations;
+
+    const AcDMMEPlotPropertyVec& properties = emitter.properties(sheets[0]);
+    allocations = s_allocations;
+    watch.restart();
+    for (unsigned long n = 0; n < sheetCount; ++n)
+        info.AddPageProperties(properties);
+    const double copied = watch.milliseconds();
+    const size_t copiedAllocations = s_allocations - allocations;
+
+    std::printf("%lu sheets, per sheet: rebuilding %.2f us and %.1f allocations, emitter %.2f us and %.1f "
+                "allocations (%.1f values set), AddPageProperties' copy alone %.2f us and %.1f allocations\n",
+                sheetCount, rebuilt * 1000 / sheetCount, double(rebuiltAllocations) / sheetCount,
+                emitted * 1000 / sheetCount, double(emittedAllocations) / sheetCount,
+                double(emitter.valueUpdateCount()) / sheetCount, copied * 1000 / sheetCount,
+                double(copiedAllocations) / sheetCount);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testTemplate();
+    testCopiesShareOverrides();
+    testEmitterDiffs();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkEmitter(sizeArgument(argc, argv, 0, 2000));
+
+    return finish();
+}
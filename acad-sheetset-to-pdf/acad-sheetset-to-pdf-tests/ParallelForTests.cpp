@@ -0,0 +1,129 @@
+#include "stdafx.h"
+#include "ParallelFor.h"
+
+#include <stdexcept>
+#include <thread>
+
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+void testEveryIndexRunsOnce()
+{
+    for (unsigned threads : {1u, 2u, 4u, 16u})
+    {
+        std::vector<std::atomic<int>> hits(1000);
+        std::atomic<bool> badWorker(false);
+        CHECK(parallelFor(hits.size(), threads, [&](size_t index, unsigned worker) {
+            ++hits[index];
+            if (worker >= threads)
+                badWorker = true;
+        }));
+        for (const auto& hit : hits)
+            CHECK(hit == 1);
+        CHECK(!badWorker);
+    }
+}
+
+void testCancellation()
+{
+    std::atomic<int> ran(0);
+    CHECK(!parallelFor(
+        100000, 4,
+        [&](size_t, unsigned) {
+            ++ran;
+            std::this_thread::sleep_for(std::chrono::microseconds(10));
+        },
+        [&](size_t completed) { return completed < 50; }));
+    CHECK(ran < 100000);
+}
+
+void testExceptionIsRethrown()
+{
+    bool threw = false;
+    try
+    {
+        parallelFor(100, 3, [&](size_t index, unsigned) {
+            if (index == 7)
+                throw std::runtime_error("item 7");
+        });
+    }
+    catch (const std::runtime_error&)
+    {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+void testNestedAndConcurrentCalls()
+{
+    std::atomic<int> inner(0);
+    CHECK(parallelFor(8, 8, [&](size_t, unsigned) { parallelFor(8, 8, [&](size_t, unsigned) { ++inner; }); }));
+    CHECK(inner == 64);
+
+    std::atomic<int> total(0);
+    std::vector<std::thread> callers;
+    for (int c = 0; c < 4; ++c)
+    {
+        callers.emplace_back([&] {
+            for (int k = 0; k < 200; ++k)
+                parallelFor(16, 4, [&](size_t, unsigned) { ++total; });
+        });
+    }
+    for (auto& caller : callers)
+        caller.join();
+    CHECK(total == 4 * 200 * 16);
+}
+
+void testRestartAfterStop()
+{
+    stopWorkerThreads();
+    std::atomic<int> ran(0);
+    CHECK(parallelFor(10, 2, [&](size_t, unsigned) { ++ran; }));
+    CHECK(ran == 10);
+    stopWorkerThreads();
+}
+
+/* The cost of a small loop on pooled threads against starting threads for
+   it, as parallelFor used to. */
+void benchmarkSmallLoops(unsigned long loops)
+{
+    std::atomic<int> sink(0);
+    Stopwatch watch;
+    for (unsigned long k = 0; k < loops; ++k)
+        parallelFor(8, 8, [&](size_t, unsigned) { ++sink; });
+    const double pooled = watch.milliseconds() * 1000 / loops;
+
+    watch.restart();
+    for (unsigned long k = 0; k < loops; ++k)
+    {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 8; ++i)
+            threads.emplace_back([&] { ++sink; });
+        for (auto& thread : threads)
+            thread.join();
+    }
+    const double started = watch.milliseconds() * 1000 / loops;
+
+    std::printf("8-item loop on 8 threads: pooled %.1f us, started threads %.1f us\n", pooled, started);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testEveryIndexRunsOnce();
+    testCancellation();
+    testExceptionIsRethrown();
+    testNestedAndConcurrentCalls();
+    testRestartAfterStop();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkSmallLoops(sizeArgument(argc, argv, 0, 2000));
+
+    stopWorkerThreads();
+    return finish();
+}
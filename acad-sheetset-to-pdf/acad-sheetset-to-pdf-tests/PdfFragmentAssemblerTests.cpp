@@ -0,0 +1,458 @@
+#include "stdafx.h"
+#include "Checksum.h"
+#include "PdfFragmentAssembler.h"
+#include "StubPlotBackend.h"
+
+#include <random>
+
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+const ACHAR kJournal[] = ACRX_T("PdfFragmentAssemblerTests.pjnl");
+const ACHAR kOutput[] = ACRX_T("PdfFragmentAssemblerTests.pdf");
+const ACHAR kReassembled[] = ACRX_T("PdfFragmentAssemblerTests.again.pdf");
+const ACHAR kSheetList[] = ACRX_T("PdfFragmentAssemblerTests.sheets");
+const ACHAR kPending[] = ACRX_T("PdfFragmentAssemblerTests.pjnl.pending");
+
+std::string narrow(const std::wstring& path)
+{
+    return std::string(path.begin(), path.end());
+}
+
+std::wstring fragmentPath(size_t sheet)
+{
+    return L"PdfFragmentAssemblerTests." + std::to_wstring(sheet) + L".pdf";
+}
+
+void writeFile(const std::wstring& path, const std::string& content)
+{
+    std::FILE* pFile = std::fopen(narrow(path).c_str(), "wb");
+    std::fwrite(content.data(), 1, content.size(), pFile);
+    std::fclose(pFile);
+}
+
+void removeFiles(size_t sheetCount)
+{
+    for (const ACHAR* path : {kJournal, kOutput, kReassembled, kSheetList, kPending})
+    {
+        std::remove(narrow(path).c_str());
+        std::remove((narrow(path) + ".tmp").c_str());
+    }
+    for (size_t sheet = 0; sheet < sheetCount; ++sheet)
+        std::remove(narrow(fragmentPath(sheet)).c_str());
+}
+
+/* The ways a single-sheet PDF comes: with a cross-reference table, with a
+   cross-reference stream and its page objects packed into an object stream,
+   saved again with an incremental update, and encrypted. */
+enum FragmentKind
+{
+    kXrefTable,
+    kXrefStream,
+    kUpdated,
+    kEncrypted
+};
+
+std::string entry(size_t offset)
+{
+    char text[21];
+    std::snprintf(text, sizeof(text), "%010llu 00000 n \n", static_cast<unsigned long long>(offset));
+    return text;
+}
+
+void appendBigEndian(std::string& out, unsigned long long value, int bytes)
+{
+    while (bytes-- > 0)
+        out += char((value >> (bytes * 8)) & 0xFF);
+}
+
+/* A zlib stream of stored blocks, which FlateDecode reads like any other. */
+std::string zlibStored(const std::string& data)
+{
+    std::string out = "\x78\x01";
+    size_t position = 0;
+    do
+    {
+        const size_t size = std::min<size_t>(data.size() - position, 65535);
+        out += char(position + size == data.size() ? 1 : 0);
+        out += char(size & 0xFF);
+        out += char(size >> 8);
+        out += char(~size & 0xFF);
+        out += char((~size >> 8) & 0xFF);
+        out.append(data, position, size);
+        position += size;
+    } while (position < data.size());
+    appendBigEndian(out, adler32(data.data(), data.size()), 4);
+    return out;
+}
+
+/* Sheet n's PDF: a catalog with outlines and a layer, one page whose
+   content stream has its length in an object of its own, and a link whose
+   /Doc points back at the catalog. */
+std::string sheetFragment(size_t n, FragmentKind kind, size_t padding = 0)
+{
+    const std::string content = "BT /F1 12 Tf (sheet " + std::to_string(n) + ") Tj ET\n" + std::string(padding, '%');
+    const std::string bodies[] = {
+        "",
+        "<</Type /Catalog /Pages 2 0 R /Outlines 7 0 R /OCProperties <</OCGs [5 0 R] /D <</Order [5 0 R] /ON [5 0 "
+        "R]>>>>>>",
+        "<</Type /Pages /Kids [3 0 R] /Count 1 /MediaBox [0 0 842 595]>>",
+        "<</Type /Page /Parent 2 0 R /Contents 4 0 R /Resources <</Properties <</oc1 5 0 R>>>> /Annots [6 0 R]>>",
+        "<</Length 8 0 R>>\nstream\n" + content + "\nendstream",
+        "<</Type /OCG /Name (Layer " + std::to_string(n) + ")>>",
+        "<</Type /Annot /Subtype /Link /Rect [0 0 10 10] /P 3 0 R /Doc 1 0 R>>",
+        "<</Type /Outlines /Count 0>>",
+        std::to_string(content.size())};
+
+    std::string text = kind == kXrefStream ? "%PDF-1.6\n%\xE2\xE3\xCF\xD3\n" : "%PDF-1.5\n%\xE2\xE3\xCF\xD3\n";
+    std::vector<size_t> offsets(11, 0);
+    const auto add = [&](size_t number, const std::string& body)
+    {
+        offsets[number] = text.size();
+        text += std::to_string(number) + " 0 obj\n" + body + "\nendobj\n";
+    };
+
+    if (kind != kXrefStream)
+    {
+        for (size_t number = 1; number <= 8; ++number)
+            add(number, bodies[number]);
+        const size_t xref = text.size();
+        text += "xref\n0 9\n0000000000 65535 f \n";
+        for (size_t number = 1; number <= 8; ++number)
+            text += entry(offsets[number]);
+        text += "trailer\n<</Size 9 /Root 1 0 R";
+        if (kind == kEncrypted)
+            text += " /Encrypt <</Filter /Standard /V 2 /R 3>>";
+        text += ">>\nstartxref\n" + std::to_string(xref) + "\n%%EOF\n";
+
+        if (kind == kUpdated)
+        {
+            add(5, "<</Type /OCG /Name (Layer " + std::to_string(n) + " revised)>>");
+            const size_t update = text.size();
+            text += "xref\n0 1\n0000000000 65535 f \n5 1\n" + entry(offsets[5]) +
+                    "trailer\n<</Size 9 /Root 1 0 R /Prev " + std::to_string(xref) + ">>\nstartxref\n" +
+                    std::to_string(update) + "\n%%EOF\n";
+        }
+        return text;
+    }
+
+    for (const size_t number : {1, 4, 7, 8})
+        add(number, bodies[number]);
+
+    /* Objects 2, 3, 5 and 6 go into object stream 9. */
+    std::string header, packed;
+    for (const size_t number : {2, 3, 5, 6})
+    {
+        header += std::to_string(number) + " " + std::to_string(packed.size()) + " ";
+        packed += bodies[number] + "\n";
+    }
+    std::string stream = zlibStored(header + packed);
+    add(9, "<</Type /ObjStm /N 4 /First " + std::to_string(header.size()) + " /Filter /FlateDecode /Length " +
+               std::to_string(stream.size()) + ">>\nstream\n" + stream + "\nendstream");
+
+    /* The cross-reference stream, object 10, has rows of type, offset or
+       object stream, and generation or index, each row predicted from the one
+       above as PNG "Up" does. */
+    offsets[10] = text.size();
+    const int indices[] = {0, 0, 0, 1, 0, 0, 2, 3};
+    std::string rows, previous(7, '\0');
+    for (size_t number = 0; number <= 10; ++number)
+    {
+        std::string row;
+        if (number == 0)
+            row = std::string("\0\0\0\0\0\xFF\xFF", 7);
+        else if (number == 2 || number == 3 || number == 5 || number == 6)
+        {
+            row += '\x02';
+            appendBigEndian(row, 9, 4);
+            appendBigEndian(row, indices[number], 2);
+        }
+        else
+        {
+            row += '\x01';
+            appendBigEndian(row, offsets[number], 4);
+            appendBigEndian(row, 0, 2);
+        }
+        rows += '\x02';
+        for (size_t i = 0; i < 7; ++i)
+            rows += char(row[i] - previous[i]);
+        previous = row;
+    }
+    stream = zlibStored(rows);
+    add(10, "<</Type /XRef /Size 11 /W [1 4 2] /Root 1 0 R /Filter /FlateDecode /DecodeParms <</Predictor 12 "
+            "/Columns 7>> /Length " +
+                std::to_string(stream.size()) + ">>\nstream\n" + stream + "\nendstream");
+    text += "startxref\n" + std::to_string(offsets[10]) + "\n%%EOF\n";
+    return text;
+}
+
+size_t occurrences(const std::string& text, const std::string& what)
+{
+    size_t count = 0;
+    for (size_t at = text.find(what); at != std::string::npos; at = text.find(what, at + 1))
+        ++count;
+    return count;
+}
+
+/* The output's cross-reference table points at every object it lists. */
+bool xrefIsExact(const std::string& pdf)
+{
+    const size_t startxref = pdf.rfind("startxref\n");
+    if (startxref == std::string::npos)
+        return false;
+    const size_t xref = std::stoul(pdf.substr(startxref + 10));
+    if (pdf.compare(xref, 7, "xref\n0 ") != 0)
+        return false;
+    const size_t count = std::stoul(pdf.substr(xref + 7));
+    size_t position = pdf.find('\n', xref + 7) + 1 + 20;
+    for (size_t number = 1; number < count; ++number, position += 20)
+    {
+        const size_t offset = std::stoul(pdf.substr(position, 10));
+        if (pdf.compare(offset, std::to_string(number).size() + 6, std::to_string(number) + " 0 obj") != 0)
+            return false;
+    }
+    return pdf.compare(position, 8, "trailer\n") == 0;
+}
+
+/* Fragments of every kind are merged in order into one document with their
+   pages, contents and layers, the newest revision of an updated object
+   winning, without what only their catalogs refer to; the output reads back
+   as a fragment itself. */
+void testMergesEveryKind()
+{
+    const FragmentKind kinds[] = {kXrefTable, kXrefStream, kUpdated, kXrefTable};
+    std::vector<std::wstring> fragments;
+    for (size_t n = 0; n < 4; ++n)
+    {
+        fragments.push_back(fragmentPath(n));
+        writeFile(fragments.back(), sheetFragment(n, kinds[n]));
+    }
+
+    PdfFragmentAssembler assembler;
+    CHECK(assembler.assemble(fragments, kOutput) == Acad::eOk);
+    CHECK(assembler.pageCount() == 4);
+    CHECK(assembler.objectCount() == 4 * 5 + 2);
+
+    const std::string pdf = readFile(narrow(kOutput).c_str());
+    CHECK(pdf.compare(0, 9, "%PDF-1.6\n") == 0);
+    CHECK(xrefIsExact(pdf));
+    CHECK(pdf.find("2 0 obj\n<</Type /Pages /Kids [3 0 R 8 0 R 13 0 R 18 0 R] /Count 4>>") != std::string::npos);
+    CHECK(pdf.find("/OCProperties <</OCGs [4 0 R 9 0 R 14 0 R 19 0 R] /D <</Order [4 0 R 9 0 R 14 0 R 19 0 R]") !=
+          std::string::npos);
+    for (size_t n = 0; n < 4; ++n)
+        CHECK(occurrences(pdf, "(sheet " + std::to_string(n) + ") Tj") == 1);
+    CHECK(occurrences(pdf, "/Type /Page /Parent") == 4);
+    CHECK(occurrences(pdf, "/Type /Pages /Kids [") == 5);
+    CHECK(occurrences(pdf, "/Parent 2 0 R") == 4);
+    CHECK(pdf.find("(Layer 2 revised)") != std::string::npos);
+    CHECK(pdf.find("(Layer 2)") == std::string::npos);
+    CHECK(pdf.find("/Outlines") == std::string::npos);
+    CHECK(occurrences(pdf, "/Doc null") == 4);
+    CHECK(!fileExists((narrow(kOutput) + ".tmp").c_str()));
+
+    PdfFragmentAssembler again;
+    CHECK(again.assemble({kOutput, kOutput}, kReassembled) == Acad::eOk);
+    CHECK(again.pageCount() == 8);
+    CHECK(again.objectCount() == 2 * (assembler.objectCount() - 1) + 2);
+    CHECK(xrefIsExact(readFile(narrow(kReassembled).c_str())));
+    removeFiles(4);
+}
+
+/* Encrypted fragments and files that are not PDF are refused, and damaged
+   ones either merged or refused, never with a partial output left behind. */
+void testRefusesWhatItCannotMerge()
+{
+    const std::vector<std::wstring> fragments = {fragmentPath(0), fragmentPath(1)};
+    writeFile(fragments[0], sheetFragment(0, kXrefTable));
+    for (const std::string& second : {sheetFragment(1, kEncrypted), std::string("IN;SP1;PU0,0;\n")})
+    {
+        writeFile(fragments[1], second);
+        writeFile(kOutput, "old");
+        PdfFragmentAssembler assembler;
+        CHECK(assembler.assemble(fragments, kOutput) == Acad::eUnsupportedFileFormat);
+        CHECK(readFile(narrow(kOutput).c_str()) == "old");
+        CHECK(!fileExists((narrow(kOutput) + ".tmp").c_str()));
+    }
+
+    std::mt19937 random(11);
+    for (const FragmentKind kind : {kXrefTable, kXrefStream, kUpdated})
+    {
+        const std::string good = sheetFragment(1, kind);
+        const size_t startxref = good.find("startxref");
+        for (size_t size = 0; size < good.size(); size += 1 + size / 16)
+        {
+            writeFile(fragments[1], good.substr(0, size));
+            PdfFragmentAssembler assembler;
+            const Acad::ErrorStatus es = assembler.assemble(fragments, kOutput);
+            CHECK(size > startxref || es != Acad::eOk);
+            CHECK(!fileExists((narrow(kOutput) + ".tmp").c_str()));
+        }
+        for (int trial = 0; trial < 300; ++trial)
+        {
+            std::string damaged = good;
+            for (int flips = 1 + int(random() % 3); flips > 0; --flips)
+                damaged[random() % damaged.size()] ^= char(1 + random() % 255);
+            writeFile(fragments[1], damaged);
+            PdfFragmentAssembler assembler;
+            if (assembler.assemble(fragments, kOutput) == Acad::eOk)
+                CHECK(xrefIsExact(readFile(narrow(kOutput).c_str())));
+            CHECK(!fileExists((narrow(kOutput) + ".tmp").c_str()));
+        }
+    }
+    removeFiles(2);
+}
+
+/* A job publishing one PDF per sheet through the journal, as the driver
+   does, assembles into one document once every sheet is done. */
+void testJournaledSheets()
+{
+    const size_t kSheets = 12;
+    removeFiles(kSheets);
+    std::vector<AcString> keys;
+    std::vector<StubPlotSheet> sheets(kSheets);
+    for (size_t n = 0; n < kSheets; ++n)
+    {
+        AcString key;
+        key.format(ACRX_T("drawing%d.dwg|Layout1"), int(n));
+        keys.push_back(key);
+        sheets[n].content = sheetFragment(n, n % 2 == 0 ? kXrefTable : kXrefStream);
+    }
+
+    PublishJournal journal;
+    CHECK(journal.open(kJournal, keys, kOutput) == Acad::eOk);
+    PublishCheckpointReactor reactor(journal);
+    StubPlotBackend backend;
+    backend.addReactor(&reactor);
+    for (const size_t n : journal.pendingSheets())
+        backend.plot(keys[n].kwszPtr(), {sheets[n]}, fragmentPath(n).c_str());
+    CHECK(journal.pendingSheets().empty());
+
+    PdfFragmentAssembler assembler;
+    CHECK(journal.assemble(kOutput, assembler) == Acad::eOk);
+    CHECK(assembler.pageCount() == kSheets);
+    CHECK(xrefIsExact(readFile(narrow(kOutput).c_str())));
+    journal.close();
+    removeFiles(kSheets);
+}
+
+/* Publishes the pending sheets of the module's journal, one document each,
+   through the reactors registered with acplPlotReactorMgr. */
+void publishPending(const std::vector<StubPlotSheet>& sheets, size_t count)
+{
+    StubPlotBackend backend;
+    for (AcPlPlotReactor* pReactor : acplPlotReactorMgr->reactors)
+        backend.addReactor(pReactor);
+    const std::string pending = readFile(narrow(kPending).c_str());
+    for (size_t at = 0; at < pending.size() && count > 0; at = pending.find('\n', at) + 1, --count)
+    {
+        const size_t n = std::stoul(pending.substr(at));
+        AcString key;
+        key.format(ACRX_T("drawing%d.dwg|Layout1"), int(n));
+        backend.plot(key.kwszPtr(), {sheets[n]}, fragmentPath(n).c_str());
+    }
+}
+
+/* What the driver runs: SHEETSETTOPDFJOURNAL opens the journal, registers
+   its reactor and lists the sheets to publish; when a job dies, running it
+   again lists only the rest; SHEETSETTOPDFASSEMBLE merges the sheets once
+   all are done; and an empty journal, like unloading, removes the reactor. */
+void testJournalCommands()
+{
+    const size_t kSheets = 5;
+    removeFiles(kSheets);
+    std::vector<StubPlotSheet> sheets(kSheets);
+    std::string list = "\xEF\xBB\xBF";
+    for (size_t n = 0; n < kSheets; ++n)
+    {
+        sheets[n].content = sheetFragment(n, n % 2 == 0 ? kXrefStream : kXrefTable);
+        list += "drawing" + std::to_string(n) + ".dwg|Layout1\r\n";
+    }
+    writeFile(kSheetList, list);
+
+    const auto countReactors = []()
+    {
+        size_t count = 0;
+        for (AcPlPlotReactor* pReactor : acplPlotReactorMgr->reactors)
+            count += dynamic_cast<PublishCheckpointReactor*>(pReactor) != nullptr ? 1 : 0;
+        return count;
+    };
+    const auto openJournal = []()
+    {
+        arx_stubs::queueEditorInput(kJournal);
+        arx_stubs::queueEditorInput(kSheetList);
+        arx_stubs::queueEditorInput(kOutput);
+        return arx_stubs::runCommand(ACRX_T("SHEETSETTOPDFJOURNAL"));
+    };
+
+    CHECK(arx_stubs::sendAppMessage(AcRx::kInitAppMsg));
+    CHECK(openJournal());
+    CHECK(countReactors() == 1);
+    CHECK(readFile(narrow(kPending).c_str()) == "0\r\n1\r\n2\r\n3\r\n4\r\n");
+    publishPending(sheets, 2);
+
+    CHECK(openJournal());
+    CHECK(countReactors() == 1);
+    CHECK(readFile(narrow(kPending).c_str()) == "2\r\n3\r\n4\r\n");
+    CHECK(arx_stubs::runCommand(ACRX_T("SHEETSETTOPDFASSEMBLE")));
+    CHECK(!fileExists(narrow(kOutput).c_str()));
+
+    publishPending(sheets, kSheets);
+    CHECK(arx_stubs::runCommand(ACRX_T("SHEETSETTOPDFASSEMBLE")));
+    const std::string pdf = readFile(narrow(kOutput).c_str());
+    CHECK(occurrences(pdf, "/Type /Page /Parent") == kSheets);
+    CHECK(xrefIsExact(pdf));
+
+    arx_stubs::queueEditorInput(ACRX_T(""));
+    CHECK(arx_stubs::runCommand(ACRX_T("SHEETSETTOPDFJOURNAL")));
+    CHECK(countReactors() == 0);
+    CHECK(openJournal());
+    CHECK(readFile(narrow(kPending).c_str()).empty());
+    CHECK(arx_stubs::sendAppMessage(AcRx::kUnloadAppMsg));
+    CHECK(countReactors() == 0);
+    removeFiles(kSheets);
+}
+
+/* How long merging takes per sheet, with a content stream of a typical
+   plotted layout's size. */
+void benchmarkAssembly(unsigned long sheetCount)
+{
+    const size_t kPadding = 256 * 1024;
+    std::vector<std::wstring> fragments;
+    size_t bytes = 0;
+    for (size_t n = 0; n < sheetCount; ++n)
+    {
+        const std::string fragment = sheetFragment(n, n % 2 == 0 ? kXrefTable : kXrefStream, kPadding);
+        fragments.push_back(fragmentPath(n));
+        writeFile(fragments.back(), fragment);
+        bytes += fragment.size();
+    }
+
+    PdfFragmentAssembler assembler;
+    Stopwatch watch;
+    CHECK(assembler.assemble(fragments, kOutput) == Acad::eOk);
+    const double milliseconds = watch.milliseconds();
+    CHECK(assembler.pageCount() == sheetCount);
+    std::printf("assemble: %lu sheets, %.1f MB in %.1f ms, %.3f ms per sheet, %.1f MB/s\n", sheetCount,
+                bytes / 1048576.0, milliseconds, milliseconds / sheetCount,
+                bytes / 1048576.0 / (milliseconds / 1000));
+    removeFiles(sheetCount);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testMergesEveryKind();
+    testRefusesWhatItCannotMerge();
+    testJournaledSheets();
+    testJournalCommands();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkAssembly(sizeArgument(argc, argv, 0, 200));
+
+    return finish();
+}
@@ -0,0 +1,282 @@
+#include "stdafx.h"
+#include "AsyncPlotLogger.h"
+#include "PlotPreflight.h"
+
+#include <map>
+#include <thread>
+
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+/// <summary>
+/// Validates by looking the device up among the configs it knows, taking
+/// delayMilliseconds per call as AutoCAD's validator takes to load a PC3
+/// file and match media.  The merged settings are those of the override or
+/// the layout, with the media name the device matched.
+/// </summary>
+class StubPlotInfoValidator : public AcPlPlotInfoValidator
+{
+public:
+    StubPlotInfoValidator()
+    {
+        for (const wchar_t* name : {L"DWG To PDF.pc3", L"Plotter.pc3"})
+        {
+            configs[name].name = name;
+            configs[name].path = std::wstring(L"C:\\Plotters\\") + name;
+        }
+    }
+
+    Acad::ErrorStatus validate(AcPlPlotInfo& info) override
+    {
+        ++calls;
+        if (delayMilliseconds != 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(delayMilliseconds));
+
+        AcDbObjectPointer<AcDbLayout> pLayout(info.layout(), AcDb::kForRead);
+        const AcDbPlotSettings* pSettings =
+            info.overrideSettings() != nullptr ? info.overrideSettings() : pLayout.object();
+        if (pSettings == nullptr)
+            return Acad::eNullObjectPointer;
+        const std::wstring device =
+            info.deviceOverride() != nullptr ? info.deviceOverride()->deviceName() : pSettings->plotCfgName;
+        const auto config = configs.find(device);
+        if (config == configs.end())
+            return Acad::eDeviceNotFound;
+
+        AcDbPlotSettings merged = *pSettings;
+        merged.canonicalMediaName = L"matched " + pSettings->canonicalMediaName;
+        info.setValidatedSettings(&merged);
+        info.setValidatedConfig(&config->second);
+        info.merge = 4;
+        return Acad::eOk;
+    }
+
+    std::map<std::wstring, AcPlPlotConfig> configs;
+    unsigned delayMilliseconds = 0;
+    int calls = 0;
+};
+
+class StubLogSink : public PlotLogSink
+{
+public:
+    Acad::ErrorStatus write(const char* pData, size_t size) override
+    {
+        data.append(pData, size);
+        return Acad::eOk;
+    }
+    Acad::ErrorStatus flush() override { return Acad::eOk; }
+
+    std::string data;
+};
+
+/// <summary>
+/// A sheet set whose sheets reuse a few page setups: every sheet plots
+/// layout sheet % setups of drawing sheet in folder sheet % folders.
+/// </summary>
+struct StubSheetSet
+{
+    StubSheetSet(size_t sheetCount, size_t setups, size_t folders) : layouts(setups), infos(sheetCount)
+    {
+        for (size_t n = 0; n < setups; ++n)
+        {
+            layouts[n].name = L"Layout" + std::to_wstring(n);
+            layouts[n].plotCfgName = n % 2 == 0 ? L"DWG To PDF.pc3" : L"Plotter.pc3";
+            layouts[n].canonicalMediaName = L"ISO_A" + std::to_wstring(n % 4) + L"_(420.00_x_297.00_MM)";
+            layouts[n].stdScale = double(n + 1);
+        }
+        for (size_t n = 0; n < sheetCount; ++n)
+        {
+            infos[n].pLayout = &layouts[n % setups];
+            infos[n].OrgFilePath().format(ACRX_T("C:\\Sets\\Folder%d\\Drawing%d.dwg"), int(n % folders), int(n));
+        }
+    }
+
+    std::vector<AcPlPlotInfo*> pointers()
+    {
+        std::vector<AcPlPlotInfo*> result;
+        for (AcPlPlotInfo& info : infos)
+            result.push_back(&info);
+        return result;
+    }
+
+    std::vector<AcDbLayout> layouts;
+    std::vector<AcPlPlotInfo> infos;
+};
+
+/* Sheets are grouped by setup and folder; each group is validated once and
+   its merged settings and config handed to every sheet in it. */
+void testValidatesEachGroupOnce()
+{
+    StubSheetSet set(12, 3, 2);
+    StubPlotInfoValidator validator;
+    PlotPreflight preflight(validator);
+    PlotPreflightReport report;
+    CHECK(preflight.run(set.pointers(), report) == Acad::eOk);
+    CHECK(report.allValid());
+    CHECK(validator.calls == 6);
+    CHECK(report.groupCount == 6);
+    CHECK(report.validateCount == 6);
+    CHECK(report.cacheHitCount == 6);
+    CHECK(preflight.cachedGroupCount() == 6);
+    CHECK(report.sheets.size() == 12);
+
+    for (size_t n = 0; n < set.infos.size(); ++n)
+    {
+        const AcPlPlotInfo& info = set.infos[n];
+        const PlotPreflightSheet& sheet = report.sheets[n];
+        CHECK(info.isValidated());
+        CHECK(info.validatedSettings()->canonicalMediaName == L"matched " + set.layouts[n % 3].canonicalMediaName);
+        CHECK(info.validatedConfig() == &validator.configs[set.layouts[n % 3].plotCfgName]);
+        CHECK(sheet.status == Acad::eOk);
+        CHECK(sheet.mergeStatus == 4);
+        CHECK(!sheet.cached);
+        CHECK(sheet.layout == set.layouts[n % 3].name.c_str());
+        CHECK(sheet.group == report.sheets[n % 6].group);
+    }
+}
+
+/* An override of the settings or the device is a setup of its own. */
+void testOverridesMakeTheirOwnGroups()
+{
+    StubSheetSet set(4, 1, 1);
+    AcDbPlotSettings overrides = set.layouts[0];
+    overrides.canonicalMediaName = L"ANSI_B";
+    AcPlPlotConfig plotter = StubPlotInfoValidator().configs[L"Plotter.pc3"];
+    set.infos[1].pOverrideSettings = &overrides;
+    set.infos[2].pDeviceOverride = &plotter;
+
+    StubPlotInfoValidator validator;
+    PlotPreflight preflight(validator);
+    PlotPreflightReport report;
+    CHECK(preflight.run(set.pointers(), report) == Acad::eOk);
+    CHECK(validator.calls == 3);
+    CHECK(report.sheets[3].group == report.sheets[0].group);
+    CHECK(report.sheets[1].group != report.sheets[0].group);
+    CHECK(report.sheets[2].group != report.sheets[0].group);
+    CHECK(set.infos[1].validatedSettings()->canonicalMediaName == L"matched ANSI_B");
+    CHECK(set.infos[2].validatedConfig()->deviceName() == std::wstring(L"Plotter.pc3"));
+}
+
+/* Every sheet of an invalid group is reported, and logged, by the run. */
+void testInvalidSheetsAreReported()
+{
+    StubSheetSet set(9, 3, 1);
+    set.layouts[1].plotCfgName = L"Missing.pc3";
+    StubPlotInfoValidator validator;
+    PlotPreflight preflight(validator);
+    PlotPreflightReport report;
+    StubLogSink sink;
+    {
+        AsyncPlotLogger logger(sink);
+        CHECK(preflight.run(set.pointers(), report, &logger) == Acad::eInvalidPlotInfo);
+    }
+    CHECK(!report.allValid());
+    CHECK(report.invalidSheets == (std::vector<size_t>{1, 4, 7}));
+    CHECK(report.sheets[4].status == Acad::eDeviceNotFound);
+    CHECK(report.sheets[3].status == Acad::eOk);
+    CHECK(!set.infos[4].isValidated());
+    CHECK(validator.calls == 3);
+    CHECK(sink.data.find("Sheet 5 (Layout1 in C:\\\\Sets\\\\Folder0\\\\Drawing4.dwg) cannot be plotted") !=
+          std::string::npos);
+
+    std::vector<AcPlPlotInfo*> infos = set.pointers();
+    infos[2] = nullptr;
+    CHECK(preflight.run(infos, report) == Acad::eNullPtr);
+    CHECK(report.sheets[2].status == Acad::eNullPtr);
+}
+
+/* A second run of the same set validates nothing until clear(). */
+void testResultsAreKeptAcrossRuns()
+{
+    StubSheetSet set(10, 2, 1);
+    StubPlotInfoValidator validator;
+    PlotPreflight preflight(validator);
+    PlotPreflightReport report;
+    CHECK(preflight.run(set.pointers(), report) == Acad::eOk);
+    CHECK(validator.calls == 2);
+
+    StubSheetSet again(10, 2, 1);
+    CHECK(preflight.run(again.pointers(), report) == Acad::eOk);
+    CHECK(validator.calls == 2);
+    CHECK(report.validateCount == 0);
+    CHECK(report.cacheHitCount == 10);
+    CHECK(report.groupCount == 2);
+    CHECK(report.sheets[0].cached && report.sheets[9].cached);
+    for (const AcPlPlotInfo& info : again.infos)
+        CHECK(info.isValidated());
+
+    preflight.clear();
+    CHECK(preflight.cachedGroupCount() == 0);
+    CHECK(preflight.run(again.pointers(), report) == Acad::eOk);
+    CHECK(validator.calls == 4);
+}
+
+/* A sheet whose layout cannot be opened is validated on its own. */
+void testUnopenedLayoutsAreNotGrouped()
+{
+    StubSheetSet set(3, 1, 1);
+    AcPlPlotConfig pdf = StubPlotInfoValidator().configs[L"DWG To PDF.pc3"];
+    AcDbPlotSettings overrides = set.layouts[0];
+    for (AcPlPlotInfo& info : set.infos)
+    {
+        info.pLayout = nullptr;
+        info.pOverrideSettings = &overrides;
+        info.pDeviceOverride = &pdf;
+    }
+    StubPlotInfoValidator validator;
+    PlotPreflight preflight(validator);
+    PlotPreflightReport report;
+    CHECK(preflight.run(set.pointers(), report) == Acad::eOk);
+    CHECK(validator.calls == 3);
+    CHECK(report.groupCount == 3);
+    CHECK(preflight.cachedGroupCount() == 0);
+}
+
+/* Pre-flight of a set of sheets that share a few setups, against validating
+   every sheet, with a validator that costs 2 ms a call. */
+void benchmarkPreflight(unsigned long sheetCount)
+{
+    StubSheetSet set(sheetCount, 3, 2);
+    StubPlotInfoValidator validator;
+    validator.delayMilliseconds = 2;
+
+    Stopwatch watch;
+    for (AcPlPlotInfo& info : set.infos)
+        validator.validate(info);
+    const double everySheet = watch.milliseconds();
+
+    StubSheetSet fresh(sheetCount, 3, 2);
+    PlotPreflight preflight(validator);
+    PlotPreflightReport report;
+    watch.restart();
+    preflight.run(fresh.pointers(), report);
+    const double first = watch.milliseconds();
+    const size_t validations = report.validateCount;
+    StubSheetSet again(sheetCount, 3, 2);
+    watch.restart();
+    preflight.run(again.pointers(), report);
+    const double second = watch.milliseconds();
+
+    std::printf("%lu sheets: validating every sheet %.0f ms, pre-flight %.1f ms (%zu validations), again %.2f ms\n",
+                sheetCount, everySheet, first, validations, second);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testValidatesEachGroupOnce();
+    testOverridesMakeTheirOwnGroups();
+    testInvalidSheetsAreReported();
+    testResultsAreKeptAcrossRuns();
+    testUnopenedLayoutsAreNotGrouped();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkPreflight(sizeArgument(argc, argv, 0, 300));
+
+    return finish();
+}
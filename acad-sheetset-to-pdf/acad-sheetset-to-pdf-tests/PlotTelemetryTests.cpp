@@ -0,0 +1,226 @@
+#include "stdafx.h"
+#include "PlotTelemetry.h"
+#include "StubPlotBackend.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+const char kJsonFile[] = "PlotTelemetryTests.json";
+const char kPrometheusFile[] = "PlotTelemetryTests.prom";
+
+bool contains(const std::string& text, const char* part)
+{
+    return text.find(part) != std::string::npos;
+}
+
+/* Percentiles are within 1/64 of the exact ones over a range of nine orders
+   of magnitude, and single values come back as the top of their bucket. */
+void testHistogramAccuracy()
+{
+    LatencyHistogram histogram;
+    std::mt19937_64 random(1);
+    std::vector<Adesk::UInt64> values;
+    for (int i = 0; i < 100000; ++i)
+    {
+        const Adesk::UInt64 value = random() % 5000000000ull;
+        values.push_back(value);
+        histogram.record(value);
+    }
+    std::sort(values.begin(), values.end());
+    CHECK(histogram.count() == values.size());
+    CHECK(histogram.minimum() == values.front());
+    CHECK(histogram.maximum() == values.back());
+
+    for (const double percentile : {50.0, 90.0, 99.0, 99.9, 100.0})
+    {
+        const Adesk::UInt64 exact = values[size_t(std::ceil(percentile / 100 * values.size())) - 1];
+        const Adesk::UInt64 reported = histogram.valueAtPercentile(percentile);
+        CHECK(reported >= exact);
+        CHECK(double(reported - exact) <= double(exact) / 64);
+    }
+
+    for (const Adesk::UInt64 value : {0ull, 1ull, 127ull, 128ull, 129ull, 255ull, 256ull, 1000ull, 123456789ull, ~0ull})
+    {
+        LatencyHistogram single;
+        single.record(value);
+        const Adesk::UInt64 reported = single.valueAtPercentile(50);
+        CHECK(reported == value);
+        const Adesk::UInt64 bucketTop = value + value / 64;
+        CHECK(bucketTop < value || single.countAtOrBelow(bucketTop) == 1);
+        CHECK(value == 0 || single.countAtOrBelow(value - 1) == 0);
+    }
+
+    LatencyHistogram sum;
+    sum.add(histogram);
+    sum.add(histogram);
+    CHECK(sum.count() == 2 * histogram.count());
+    CHECK(sum.valueAtPercentile(50) == histogram.valueAtPercentile(50));
+    sum.clear();
+    CHECK(sum.count() == 0 && sum.valueAtPercentile(99) == 0);
+}
+
+std::vector<StubPlotSheet> sheetSet()
+{
+    std::vector<StubPlotSheet> sheets(4);
+    for (int i = 0; i < 4; ++i)
+    {
+        sheets[i].drawing = ACRX_T("C:\\Projects\\a \"b\"\\Sheet.dwg");
+        sheets[i].setupMilliseconds = 2;
+        sheets[i].plotMilliseconds = 5 + 5 * i;
+    }
+    return sheets;
+}
+
+/* A plot through StubPlotBackend leaves both files behind, with every sheet,
+   the way it ended and how long each phase took. */
+void testExport()
+{
+    std::remove(kJsonFile);
+    std::remove(kPrometheusFile);
+
+    PlotTelemetry telemetry;
+    telemetry.setExportPaths(ACRX_T("PlotTelemetryTests.json"), ACRX_T("PlotTelemetryTests.prom"));
+    StubPlotBackend backend;
+    backend.addReactor(&telemetry);
+
+    std::vector<StubPlotSheet> sheets = sheetSet();
+    sheets[1].status = AcPlPlotProgress::kSheetCanceledByCancelButton;
+    CHECK(backend.plot(ACRX_T("Set1"), sheets) == Acad::eOk);
+    CHECK(telemetry.lastExportStatus() == Acad::eOk);
+    sheets[2].status = AcPlPlotProgress::kSheetCanceledByCancelAllButton;
+    CHECK(backend.plot(ACRX_T("Set2"), sheets) == Acad::eUserBreak);
+    CHECK(telemetry.lastExportStatus() == Acad::eOk);
+
+    const std::vector<PlotSheetTelemetry> recorded = telemetry.sheets();
+    CHECK(recorded.size() == 7);
+    if (recorded.size() == 7)
+    {
+        CHECK(recorded[0].plot == 1 && recorded[0].page == 1 && recorded[0].document == ACRX_T("Set1"));
+        CHECK(recorded[1].status == AcPlPlotProgress::kSheetCanceledByCancelButton);
+        CHECK(recorded[6].plot == 2 && recorded[6].page == 3);
+        CHECK(recorded[6].status == AcPlPlotProgress::kSheetCanceledByCancelAllButton);
+        for (const PlotSheetTelemetry& sheet : recorded)
+        {
+            CHECK(sheet.setupStart <= sheet.pageStart && sheet.pageStart <= sheet.pageEnd);
+            CHECK(sheet.pageEnd - sheet.pageStart >= 5000000);
+        }
+    }
+    CHECK(telemetry.histogram(kPlotPhaseWhole).count() == 2);
+    CHECK(telemetry.histogram(kPlotPhaseSheet).count() == 7);
+    CHECK(telemetry.histogram(kPlotPhaseSheetSetup).minimum() >= 2000000);
+
+    const std::string json = readFile(kJsonFile);
+    CHECK(json == telemetry.json());
+    CHECK(contains(json, "\"plots\": { \"total\": 2, \"cancelled\": 1 }"));
+    CHECK(contains(json, "\"completed\": 4, \"cancelled\": 2, \"cancelled_all\": 1"));
+    CHECK(contains(json, "\"drawing\": \"C:\\\\Projects\\\\a \\\"b\\\"\\\\Sheet.dwg\""));
+
+    const std::string prometheus = readFile(kPrometheusFile);
+    CHECK(prometheus == telemetry.prometheus());
+    CHECK(contains(prometheus, "# TYPE acad_plot_phase_duration_seconds histogram\n"));
+    CHECK(contains(prometheus, "acad_plot_phase_duration_seconds_bucket{phase=\"sheet\",le=\"+Inf\"} 7\n"));
+    CHECK(contains(prometheus, "acad_plot_phase_duration_seconds_bucket{phase=\"sheet\",le=\"0.005\"} 0\n"));
+    CHECK(contains(prometheus, "acad_plot_sheets_total{status=\"cancelled\"} 2\n"));
+    CHECK(contains(prometheus, "acad_plot_cancelled_plots_total 1\n"));
+
+    telemetry.reset();
+    CHECK(telemetry.sheets().empty() && telemetry.histogram(kPlotPhaseSheet).count() == 0);
+
+    telemetry.setExportPaths(ACRX_T("no such folder/telemetry.json"), nullptr);
+    CHECK(backend.plot(ACRX_T("Set3"), sheetSet()) == Acad::eOk);
+    CHECK(telemetry.lastExportStatus() != Acad::eOk);
+
+    std::remove(kJsonFile);
+    std::remove(kPrometheusFile);
+}
+
+/* Loading the module registers a PlotTelemetry with acplPlotReactorMgr,
+   SHEETSETTOPDFTELEMETRY sets where it exports to, and unloading removes
+   it again. */
+void testModuleRegistersTelemetry()
+{
+    std::remove(kJsonFile);
+    CHECK(arx_stubs::sendAppMessage(AcRx::kInitAppMsg));
+    PlotTelemetry* pTelemetry = nullptr;
+    for (AcPlPlotReactor* pReactor : acplPlotReactorMgr->reactors)
+    {
+        if (PlotTelemetry* pFound = dynamic_cast<PlotTelemetry*>(pReactor))
+            pTelemetry = pFound;
+    }
+    CHECK(pTelemetry != nullptr);
+
+    arx_stubs::queueEditorInput(ACRX_T("PlotTelemetryTests.json"));
+    arx_stubs::queueEditorInput(ACRX_T(""));
+    CHECK(arx_stubs::runCommand(ACRX_T("SHEETSETTOPDFTELEMETRY")));
+
+    StubPlotBackend backend;
+    for (AcPlPlotReactor* pReactor : acplPlotReactorMgr->reactors)
+        backend.addReactor(pReactor);
+    CHECK(backend.plot(ACRX_T("Set1"), sheetSet()) == Acad::eOk);
+    CHECK(contains(readFile(kJsonFile), "\"document\": \"Set1\""));
+
+    CHECK(arx_stubs::sendAppMessage(AcRx::kUnloadAppMsg));
+    for (AcPlPlotReactor* pReactor : acplPlotReactorMgr->reactors)
+        CHECK(dynamic_cast<PlotTelemetry*>(pReactor) == nullptr);
+    std::remove(kJsonFile);
+}
+
+/* What the reactor adds to every sheet, and what an export of a full
+   sheet history costs. */
+void benchmarkOverhead(unsigned long sheetCount)
+{
+    std::mt19937_64 random(1);
+    std::vector<Adesk::UInt64> values(1000000);
+    for (Adesk::UInt64& value : values)
+        value = random() % 5000000000ull;
+    LatencyHistogram histogram;
+    Stopwatch watch;
+    for (int pass = 0; pass < 10; ++pass)
+    {
+        for (const Adesk::UInt64 value : values)
+            histogram.record(value);
+    }
+    std::printf("LatencyHistogram::record: %.1f ns\n", watch.milliseconds() * 1e6 / (10.0 * values.size()));
+
+    PlotTelemetry telemetry;
+    StubPlotBackend plain, observed;
+    observed.addReactor(&telemetry);
+    const std::vector<StubPlotSheet> sheets(sheetCount);
+    watch.restart();
+    plain.plot(ACRX_T("Set"), sheets);
+    const double plainMilliseconds = watch.milliseconds();
+    watch.restart();
+    observed.plot(ACRX_T("Set"), sheets);
+    std::printf("%lu sheets: %.0f ns per sheet for the telemetry\n", sheetCount,
+                (watch.milliseconds() - plainMilliseconds) * 1e6 / sheetCount);
+
+    watch.restart();
+    const std::string json = telemetry.json();
+    const double jsonMilliseconds = watch.milliseconds();
+    watch.restart();
+    const std::string prometheus = telemetry.prometheus();
+    std::printf("export of %zu sheets: JSON %.2f ms (%zu bytes), Prometheus %.2f ms (%zu bytes)\n",
+                telemetry.sheets().size(), jsonMilliseconds, json.size(), watch.milliseconds(), prometheus.size());
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testHistogramAccuracy();
+    testExport();
+    testModuleRegistersTelemetry();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkOverhead(sizeArgument(argc, argv, 0, 100000));
+
+    return finish();
+}
@@ -0,0 +1,172 @@
+#include "stdafx.h"
+#include "ParallelFor.h"
+#include "PointCloudCylinderDetector.h"
+
+#include "StubWorkloads.h"
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+PointCloudCylinderDetectionSettings plantSettings(unsigned threads)
+{
+    PointCloudCylinderDetectionSettings settings;
+    settings.distanceThreshold = 0.006;
+    settings.maxRadius = 0.5;
+    settings.seed = 42;
+    settings.threadCount = threads;
+    return settings;
+}
+
+/// <summary>
+/// Whether cylinder is pipe: the same axis either way round, the axis line
+/// through the pipe's, the radius to within 5% and the ends to within
+/// endTolerance.
+/// </summary>
+bool isPipe(const AcPointCloudExtractedCylinder& cylinder, const StubPipe& pipe, double endTolerance)
+{
+    const AcGeVector3d axis = pipe.axis.normal();
+    if (std::fabs(cylinder.getAxis().dotProduct(axis)) < std::cos(0.02))
+        return false;
+    if (std::fabs(cylinder.getRadius() - pipe.radius) > 0.05 * pipe.radius)
+        return false;
+
+    const AcGePoint3d start = cylinder.getOrigin();
+    const AcGePoint3d end = start + cylinder.getAxis() * cylinder.getHeight();
+    auto offAxis = [&](const AcGePoint3d& point) {
+        const AcGeVector3d offset = point - pipe.origin;
+        return (offset - axis * offset.dotProduct(axis)).length();
+    };
+    if (offAxis(start) > 0.01 || offAxis(end) > 0.01)
+        return false;
+
+    const AcGePoint3d top = pipe.origin + axis * pipe.height;
+    return (start.distanceTo(pipe.origin) < endTolerance && end.distanceTo(top) < endTolerance) ||
+           (start.distanceTo(top) < endTolerance && end.distanceTo(pipe.origin) < endTolerance);
+}
+
+bool findsEveryPipe(const AcArray<AcPointCloudExtractedCylinder>& cylinders)
+{
+    for (const StubPipe& pipe : plantPipes())
+    {
+        int matches = 0;
+        for (const AcPointCloudExtractedCylinder& cylinder : cylinders)
+            matches += isPipe(cylinder, pipe, 0.05) ? 1 : 0;
+        if (matches != 1)
+            return false;
+    }
+    return true;
+}
+
+bool identical(const AcGePoint3d& a, const AcGePoint3d& b)
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+bool identical(const AcGeVector3d& a, const AcGeVector3d& b)
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+bool sameCylinders(const AcArray<AcPointCloudExtractedCylinder>& first,
+                   const AcArray<AcPointCloudExtractedCylinder>& second)
+{
+    if (first.length() != second.length())
+        return false;
+    for (int i = 0; i < first.length(); ++i)
+    {
+        if (!identical(first[i].getOrigin(), second[i].getOrigin()) ||
+            !identical(first[i].getAxis(), second[i].getAxis()) ||
+            first[i].getRadius() != second[i].getRadius() || first[i].getHeight() != second[i].getHeight())
+            return false;
+    }
+    return true;
+}
+
+/* Every pipe is found once, with or without normals in the buffer, and
+   neither the floor nor the clutter gives a cylinder.  The same seed gives
+   the same cylinders on any number of threads. */
+void testFindsEveryPipe(StubPointCloudBuffer& plant)
+{
+    const std::vector<AcGeVector3d> normals = plant.stubNormals;
+    for (const bool withNormals : {true, false})
+    {
+        plant.stubNormals = withNormals ? normals : std::vector<AcGeVector3d>();
+
+        AcArray<AcPointCloudExtractedCylinder> single;
+        CHECK(PointCloudCylinderDetector::detect(plant, plantSettings(1), single) == Acad::eOk);
+        CHECK(findsEveryPipe(single));
+        CHECK(single.length() == static_cast<int>(plantPipes().size()));
+
+        AcArray<AcPointCloudExtractedCylinder> parallel;
+        CHECK(PointCloudCylinderDetector::detect(plant, plantSettings(4), parallel) == Acad::eOk);
+        CHECK(sameCylinders(single, parallel));
+    }
+    plant.stubNormals = normals;
+}
+
+/* Cylinders found before a cancellation are kept. */
+void testCancellation(const StubPointCloudBuffer& plant)
+{
+    StubExtractionProgress progress(1);
+    AcArray<AcPointCloudExtractedCylinder> cylinders;
+    CHECK(PointCloudCylinderDetector::detect(plant, plantSettings(2), cylinders, &progress) == Acad::eUserBreak);
+    CHECK(progress.ended);
+    CHECK(cylinders.length() < static_cast<int>(plantPipes().size()));
+    for (const AcPointCloudExtractedCylinder& cylinder : cylinders)
+        CHECK(cylinder.isValid());
+}
+
+void testInvalidInput(const StubPointCloudBuffer& plant)
+{
+    AcArray<AcPointCloudExtractedCylinder> cylinders;
+    CHECK(PointCloudCylinderDetector::detect(plant, PointCloudCylinderDetectionSettings(), cylinders) ==
+          Acad::eInvalidInput);
+    CHECK(cylinders.isEmpty());
+
+    StubPointCloudBuffer empty;
+    CHECK(PointCloudCylinderDetector::detect(empty, plantSettings(1), cylinders) == Acad::eOk);
+    CHECK(cylinders.isEmpty());
+}
+
+/* Detection time by thread count, with normals from the buffer and
+   estimated ones. */
+void benchmarkThreads(StubPointCloudBuffer& plant)
+{
+    const std::vector<AcGeVector3d> normals = plant.stubNormals;
+    for (const bool withNormals : {true, false})
+    {
+        plant.stubNormals = withNormals ? normals : std::vector<AcGeVector3d>();
+        for (unsigned threads : {1u, 4u, 8u})
+        {
+            AcArray<AcPointCloudExtractedCylinder> cylinders;
+            Stopwatch watch;
+            PointCloudCylinderDetector::detect(plant, plantSettings(threads), cylinders);
+            std::printf("%zu points, %s normals, %u thread(s): %d cylinders in %.0f ms\n", plant.stubPoints.size(),
+                        withNormals ? "given" : "estimated", threads, cylinders.length(), watch.milliseconds());
+        }
+    }
+    plant.stubNormals = normals;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const bool benchmark = benchmarkRequested(argc, argv);
+
+    StubPointCloudBuffer plant;
+    scanPlant(plant, static_cast<double>(sizeArgument(argc, argv, 0, 20000)));
+
+    testFindsEveryPipe(plant);
+    testCancellation(plant);
+    testInvalidInput(plant);
+
+    if (benchmark)
+        benchmarkThreads(plant);
+
+    stopWorkerThreads();
+    return finish();
+}
@@ -0,0 +1,307 @@
+#include "stdafx.h"
+#include "ParallelFor.h"
+#include "PointCloudLineExtractor.h"
+
+#include "StubWorkloads.h"
+#include "TestSupport.h"
+
+#include <algorithm>
+#include <tuple>
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+const AcGeVector3d kPlaneNormal(0, 0, 1);
+const AcGeVector3d kPlaneXAxis(1, 0, 0);
+const AcGePoint3d kSlabCut(0, 0, 1.5);
+
+/// <summary>
+/// Settings with a slab a third of the walls' height, so the quick default
+/// density still leaves every cell along a wall occupied.
+/// </summary>
+PointCloudLineExtractionSettings wallSettings(unsigned threads = 0)
+{
+    PointCloudLineExtractionSettings settings;
+    settings.slabThickness = 1.0;
+    settings.threadCount = threads;
+    return settings;
+}
+
+ExtractOption wallOptions(ExtractOption::ExtractionType type)
+{
+    ExtractOption options;
+    options.m_extractionType = type;
+    options.m_processPoints = 2000000;
+    options.m_fillGap = 0.05;
+    options.m_snapAngle = 3;
+    options.m_minSegLength = 0.5;
+    options.m_useLineSegmentOnly = true;
+    return options;
+}
+
+/// <summary>
+/// Whether one of curves runs from start to end, either way round, to
+/// within tolerance.
+/// </summary>
+bool hasLine(const AcArray<ProfileCurve2d>& curves, const AcGePoint2d& start, const AcGePoint2d& end,
+             double tolerance)
+{
+    for (const ProfileCurve2d& curve : curves)
+    {
+        const AcGeLineSeg2d line = curve.lineSeg();
+        const bool forward =
+            line.startPoint().distanceTo(start) < tolerance && line.endPoint().distanceTo(end) < tolerance;
+        const bool backward =
+            line.startPoint().distanceTo(end) < tolerance && line.endPoint().distanceTo(start) < tolerance;
+        if (forward || backward)
+            return true;
+    }
+    return false;
+}
+
+/// <summary>
+/// Keeps what extractStreaming delivers, and when the first curves came.
+/// </summary>
+class RecordingCurves : public IPointCloudProfileCurveCallback
+{
+public:
+    void begin(const AcGeMatrix3d& transform, const AcGePlane& projectedPlane) override { ++beginCalls; }
+    void addCurves(const AcArray<ProfileCurve2d>& batch) override
+    {
+        if (curves.isEmpty())
+            firstCurveMilliseconds = watch.milliseconds();
+        curves.append(batch);
+        ++batches;
+    }
+
+    AcArray<ProfileCurve2d> curves;
+    int beginCalls = 0;
+    int batches = 0;
+    Stopwatch watch;
+    double firstCurveMilliseconds = 0.0;
+};
+
+/// <summary>
+/// curves in the order of their endpoints, the order extractStreaming
+/// delivers them in being up to the tiles.
+/// </summary>
+std::vector<AcGeLineSeg2d> sortedLines(const AcArray<ProfileCurve2d>& curves)
+{
+    std::vector<AcGeLineSeg2d> lines;
+    for (const ProfileCurve2d& curve : curves)
+        lines.push_back(curve.lineSeg());
+    auto key = [](const AcGeLineSeg2d& line) {
+        const AcGePoint2d start = line.startPoint();
+        const AcGePoint2d end = line.endPoint();
+        return std::make_tuple(start.x, start.y, end.x, end.y);
+    };
+    std::sort(lines.begin(), lines.end(),
+              [&](const AcGeLineSeg2d& a, const AcGeLineSeg2d& b) { return key(a) < key(b); });
+    return lines;
+}
+
+bool sameLines(const AcArray<ProfileCurve2d>& first, const AcArray<ProfileCurve2d>& second)
+{
+    if (first.length() != second.length())
+        return false;
+    for (int i = 0; i < first.length(); ++i)
+    {
+        const AcGeLineSeg2d a = first[i].lineSeg();
+        const AcGeLineSeg2d b = second[i].lineSeg();
+        if (a.startPoint().distanceTo(b.startPoint()) > 1e-9 || a.endPoint().distanceTo(b.endPoint()) > 1e-9)
+            return false;
+    }
+    return true;
+}
+
+/* Every wall is found whole, although the tiles cut the long ones into
+   pieces, and the result does not depend on the number of threads. */
+void testFindsEveryWall(const StubPointCloudBuffer& cloud)
+{
+    const ExtractOption options = wallOptions(ExtractOption::kAllLine);
+
+    AcPointCloudExtractResult single;
+    PointCloudLineExtractionSettings settings = wallSettings(1);
+    StubExtractionProgress progress;
+    CHECK(PointCloudLineExtractor::extract(cloud, kPlaneNormal, kPlaneXAxis, kSlabCut, options, single, &progress,
+                                           settings) == Acad::eOk);
+    CHECK(progress.lastProgress == 99);
+    CHECK(progress.ended);
+
+    const double tolerance = 0.1;
+    CHECK(hasLine(single.Curves, AcGePoint2d(0, 0), AcGePoint2d(40, 0), tolerance));
+    CHECK(hasLine(single.Curves, AcGePoint2d(40, 0), AcGePoint2d(40, 20), tolerance));
+    CHECK(hasLine(single.Curves, AcGePoint2d(0, 20), AcGePoint2d(40, 20), tolerance));
+    CHECK(hasLine(single.Curves, AcGePoint2d(0, 0), AcGePoint2d(0, 20), tolerance));
+    CHECK(hasLine(single.Curves, AcGePoint2d(20, 0), AcGePoint2d(20, 12), tolerance));
+    CHECK(hasLine(single.Curves, AcGePoint2d(0, 10), AcGePoint2d(15, 10), tolerance));
+
+    for (unsigned threads : {2u, 4u})
+    {
+        AcPointCloudExtractResult parallel;
+        settings.threadCount = threads;
+        CHECK(PointCloudLineExtractor::extract(cloud, kPlaneNormal, kPlaneXAxis, kSlabCut, options, parallel,
+                                               nullptr, settings) == Acad::eOk);
+        CHECK(sameLines(single.Curves, parallel.Curves));
+    }
+
+    /* Smaller tiles cut the walls into more pieces, which merge back the
+       same. */
+    AcPointCloudExtractResult smallTiles;
+    settings.threadCount = 2;
+    settings.tileCells = 64;
+    CHECK(PointCloudLineExtractor::extract(cloud, kPlaneNormal, kPlaneXAxis, kSlabCut, options, smallTiles, nullptr,
+                                           settings) == Acad::eOk);
+    CHECK(hasLine(smallTiles.Curves, AcGePoint2d(0, 0), AcGePoint2d(40, 0), tolerance));
+    CHECK(hasLine(smallTiles.Curves, AcGePoint2d(0, 20), AcGePoint2d(40, 20), tolerance));
+}
+
+/* kOutLine keeps the outline and drops the walls inside it. */
+void testOutlineOnly(const StubPointCloudBuffer& cloud)
+{
+    AcPointCloudExtractResult outline;
+    CHECK(PointCloudLineExtractor::extract(cloud, kPlaneNormal, kPlaneXAxis, kSlabCut,
+                                           wallOptions(ExtractOption::kOutLine), outline, nullptr,
+                                           wallSettings()) == Acad::eOk);
+    CHECK(hasLine(outline.Curves, AcGePoint2d(0, 0), AcGePoint2d(40, 0), 0.1));
+    CHECK(!hasLine(outline.Curves, AcGePoint2d(20, 0), AcGePoint2d(20, 12), 0.1));
+}
+
+/* extractStreaming delivers exactly the curves extract returns, only in
+the order their tiles completed in, on any number of threads. */
+void testStreamingMatchesExtract(const StubPointCloudBuffer& cloud)
+{
+    for (const ExtractOption::ExtractionType type : {ExtractOption::kAllLine, ExtractOption::kOutLine})
+    {
+        const ExtractOption options = wallOptions(type);
+        AcPointCloudExtractResult batch;
+        CHECK(PointCloudLineExtractor::extract(cloud, kPlaneNormal, kPlaneXAxis, kSlabCut, options, batch, nullptr,
+                                               wallSettings(1)) == Acad::eOk);
+        const std::vector<AcGeLineSeg2d> expected = sortedLines(batch.Curves);
+
+        for (unsigned threads : {1u, 3u})
+        {
+            RecordingCurves streamed;
+            CHECK(PointCloudLineExtractor::extractStreaming(cloud, kPlaneNormal, kPlaneXAxis, kSlabCut, options,
+                                                            streamed, nullptr, wallSettings(threads)) == Acad::eOk);
+            CHECK(streamed.beginCalls == 1);
+            const std::vector<AcGeLineSeg2d> lines = sortedLines(streamed.curves);
+            CHECK(lines.size() == expected.size());
+            for (size_t i = 0; i < std::min(lines.size(), expected.size()); ++i)
+            {
+                CHECK(lines[i].startPoint() == expected[i].startPoint());
+                CHECK(lines[i].endPoint() == expected[i].endPoint());
+            }
+        }
+    }
+}
+
+/* Curves streamed before a cancellation are final: each is one of the
+curves of a full run.  How many came depends on when progress was
+reported. */
+void testStreamingCancellation(const StubPointCloudBuffer& cloud)
+{
+    const ExtractOption options = wallOptions(ExtractOption::kAllLine);
+    PointCloudLineExtractionSettings settings = wallSettings(1);
+    settings.tileCells = 64;
+    AcPointCloudExtractResult full;
+    CHECK(PointCloudLineExtractor::extract(cloud, kPlaneNormal, kPlaneXAxis, kSlabCut, options, full, nullptr,
+                                           settings) == Acad::eOk);
+
+    StubExtractionProgress progress(60);
+    RecordingCurves streamed;
+    CHECK(PointCloudLineExtractor::extractStreaming(cloud, kPlaneNormal, kPlaneXAxis, kSlabCut, options, streamed,
+                                                    &progress, settings) == Acad::eUserBreak);
+    for (const ProfileCurve2d& curve : streamed.curves)
+    {
+        const AcGeLineSeg2d line = curve.lineSeg();
+        CHECK(hasLine(full.Curves, line.startPoint(), line.endPoint(), 1e-12));
+    }
+}
+
+void testCancellation(const StubPointCloudBuffer& cloud)
+{
+    StubExtractionProgress progress(30);
+    AcPointCloudExtractResult result;
+    CHECK(PointCloudLineExtractor::extract(cloud, kPlaneNormal, kPlaneXAxis, kSlabCut,
+                                           wallOptions(ExtractOption::kAllLine), result, &progress,
+                                           wallSettings()) == Acad::eUserBreak);
+    CHECK(progress.lastProgress < 99);
+}
+
+void testEmptyCloud()
+{
+    StubPointCloudBuffer empty;
+    AcPointCloudExtractResult result;
+    const Acad::ErrorStatus es = PointCloudLineExtractor::extract(empty, kPlaneNormal, kPlaneXAxis, kSlabCut,
+                                                                  wallOptions(ExtractOption::kAllLine), result);
+    CHECK(es == Acad::eOk || es == Acad::eInvalidInput);
+    CHECK(result.Curves.length() == 0);
+}
+
+/* Extraction time by thread count.  Repeated runs also show what reusing
+   the pool threads and per-worker scratch buffers saves. */
+void benchmarkThreads(const StubPointCloudBuffer& cloud)
+{
+    const ExtractOption options = wallOptions(ExtractOption::kAllLine);
+    for (unsigned threads : {1u, 2u, 4u, 8u})
+    {
+        AcPointCloudExtractResult result;
+        Stopwatch watch;
+        PointCloudLineExtractor::extract(cloud, kPlaneNormal, kPlaneXAxis, kSlabCut, options, result, nullptr,
+                                         wallSettings(threads));
+        std::printf("%zu points, %u thread(s): %d lines in %.1f ms\n", cloud.stubPoints.size(), threads,
+                    result.Curves.length(), watch.milliseconds());
+    }
+}
+
+/* How soon extractStreaming delivers its first curves, against the time
+extract takes to return all of them, for a site of many small rooms. */
+void benchmarkFirstCurves(double density)
+{
+    StubPointCloudBuffer cloud;
+    scanRooms(cloud, 20, 20, density);
+    const ExtractOption options = wallOptions(ExtractOption::kAllLine);
+    const PointCloudLineExtractionSettings settings = wallSettings(1);
+
+    Stopwatch watch;
+    AcPointCloudExtractResult batch;
+    PointCloudLineExtractor::extract(cloud, kPlaneNormal, kPlaneXAxis, kSlabCut, options, batch, nullptr, settings);
+    const double batchMilliseconds = watch.milliseconds();
+
+    RecordingCurves streamed;
+    PointCloudLineExtractor::extractStreaming(cloud, kPlaneNormal, kPlaneXAxis, kSlabCut, options, streamed, nullptr,
+                                              settings);
+    std::printf("%zu points, %d lines: first of %d streamed batches after %.1f ms, extract %.1f ms\n",
+                cloud.stubPoints.size(), streamed.curves.length(), streamed.batches, streamed.firstCurveMilliseconds,
+                batchMilliseconds);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const bool benchmark = benchmarkRequested(argc, argv);
+
+    const double density = static_cast<double>(sizeArgument(argc, argv, 0, benchmark ? 4000 : 1000));
+    StubPointCloudBuffer cloud;
+    scanFloorPlan(cloud, density);
+
+    testFindsEveryWall(cloud);
+    testOutlineOnly(cloud);
+    testStreamingMatchesExtract(cloud);
+    testStreamingCancellation(cloud);
+    testCancellation(cloud);
+    testEmptyCloud();
+
+    if (benchmark)
+    {
+        benchmarkThreads(cloud);
+        benchmarkFirstCurves(density / 4);
+    }
+
+    stopWorkerThreads();
+    return finish();
+}
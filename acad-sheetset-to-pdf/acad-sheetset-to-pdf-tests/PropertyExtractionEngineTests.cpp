@@ -0,0 +1,246 @@
+#include "stdafx.h"
+#include "PropertyExtractionEngine.h"
+
+#include <cwchar>
+#include <thread>
+
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+const wchar_t* const kLayers[] = {L"0", L"A-WALL", L"A-DOOR", L"A-GLAZ", L"E-LITE", L"M-DUCT", L"S-COLS", L"A-ANNO"};
+const Adesk::UInt64 kFirstHandle = 0x100;
+const size_t kFailingObject = 777;
+
+/// <summary>
+/// objectCount objects of a dozen properties each, of every type the store
+/// keeps.  Every latencyEvery-th object takes latencyMicroseconds more, as
+/// one that has to be read from an xref would; object kFailingObject fails.
+/// </summary>
+class StubExtractionSource : public PropertyExtractionSource
+{
+public:
+    explicit StubExtractionSource(size_t objectCount) : m_objectCount(objectCount) {}
+
+    Acad::ErrorStatus prepare(std::vector<PropertyExtractionObject>& objects) override
+    {
+        for (size_t n = 0; n < m_objectCount; ++n)
+        {
+            PropertyExtractionObject object;
+            object.id.stubHandle = kFirstHandle + n;
+            object.viewableId = L"Model";
+            objects.push_back(object);
+        }
+        return Acad::eOk;
+    }
+
+    Acad::ErrorStatus extract(const PropertyExtractionObject& object, PropertyWriter& writer) const override
+    {
+        const size_t n = size_t(object.id.stubHandle - kFirstHandle);
+        if (latencyEvery != 0 && n % latencyEvery == 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(latencyMicroseconds));
+
+        writer.add(ACRX_T("General"), ACRX_T("Layer"), AcRxValue(kLayers[n % 8]));
+        writer.addInt32(ACRX_T("General"), ACRX_T("Color"), int(n % 256));
+        writer.addString(ACRX_T("General"), ACRX_T("Linetype"), n % 3 != 0 ? ACRX_T("ByLayer") : ACRX_T("Continuous"));
+        writer.addDouble(ACRX_T("Geometry"), ACRX_T("Length"), double(n) * 0.5, ACRX_T("mm"));
+        writer.add(ACRX_T("Geometry"), ACRX_T("Area"), AcRxValue(double(n) * 2.0), ACRX_T("mm2"));
+        writer.addPoint(ACRX_T("Geometry"), ACRX_T("Position"), AcGePoint3d(double(n), 2.0 * double(n), 0));
+        AcDbObjectId owner;
+        owner.stubHandle = 0x1F;
+        writer.add(ACRX_T("General"), ACRX_T("Owner"), AcRxValue(owner), ACRX_T(""), true);
+        writer.addBool(ACRX_T("General"), ACRX_T("Visible"), n % 7 != 0);
+        writer.addString(ACRX_T("Attributes"), ACRX_T("Tag"), (L"T-" + std::to_wstring(n % 5000)).c_str());
+        writer.add(ACRX_T("Attributes"), ACRX_T("Count"), AcRxValue(Adesk::Int64(n)));
+        if (n % 10 == 0)
+            writer.add(ACRX_T("Attributes"), ACRX_T("Scale"), AcRxValue(1.5f));
+        writer.add(ACRX_T("Attributes"), ACRX_T("Empty"), AcRxValue());
+        return n == kFailingObject ? Acad::eInvalidInput : Acad::eOk;
+    }
+
+    size_t latencyEvery = 0;
+    unsigned latencyMicroseconds = 0;
+
+private:
+    size_t m_objectCount;
+};
+
+bool sameStores(const PropertyStore& a, const PropertyStore& b)
+{
+    if (a.entityCount() != b.entityCount() || a.propertyCount() != b.propertyCount() ||
+        a.stringCount() != b.stringCount())
+        return false;
+    for (size_t e = 0; e < a.entityCount(); ++e)
+    {
+        if (a.handle(e) != b.handle(e) || a.firstProperty(e) != b.firstProperty(e) ||
+            std::wcscmp(a.viewableId(e), b.viewableId(e)) != 0)
+            return false;
+    }
+    for (size_t p = 0; p < a.propertyCount(); ++p)
+    {
+        if (a.categoryId(p) != b.categoryId(p) || a.nameId(p) != b.nameId(p) || a.unitsId(p) != b.unitsId(p) ||
+            a.type(p) != b.type(p) || a.isHidden(p) != b.isHidden(p))
+            return false;
+        if (a.type(p) == kPropertyPoint ? !a.pointValue(p).isEqualTo(b.pointValue(p))
+                                      : a.handleValue(p) != b.handleValue(p))
+            return false;
+    }
+    return true;
+}
+
+/* One thread and eight with odd blocks give the same store, which holds
+   every property with its type, units and hidden flag, and the failure of
+   one object is reported without losing the others. */
+void testThreadsGiveTheSameStore()
+{
+    const size_t kObjects = 5000;
+    StubExtractionSource source(kObjects);
+    std::vector<PropertyExtractionObject> objects;
+    source.prepare(objects);
+
+    PropertyExtractionSettings settings;
+    settings.threadCount = 1;
+    PropertyExtractionEngine serial(source, settings);
+    std::shared_ptr<const PropertyStore> pSerial;
+    PropertyExtractionStats stats;
+    CHECK(serial.extract(objects, pSerial, &stats) == Acad::eInvalidInput);
+    CHECK(stats.status == Acad::eInvalidInput);
+    CHECK(stats.objectCount == kObjects);
+
+    settings.threadCount = 8;
+    settings.blockSize = 37;
+    PropertyExtractionEngine parallel(source, settings);
+    std::shared_ptr<const PropertyStore> pStore;
+    CHECK(parallel.extract(objects, pStore) == Acad::eInvalidInput);
+    if (pSerial == nullptr || pStore == nullptr)
+    {
+        CHECK(!"no store");
+        return;
+    }
+    CHECK(sameStores(*pSerial, *pStore));
+
+    const PropertyStore& store = *pStore;
+    CHECK(store.entityCount() == kObjects);
+    CHECK(stats.propertyCount == store.propertyCount());
+    const size_t e = 1234;
+    CHECK(store.handle(e) == kFirstHandle + e);
+    CHECK(std::wcscmp(store.viewableId(e), L"Model") == 0);
+    size_t p = store.findProperty(e, ACRX_T("General"), ACRX_T("Layer"));
+    CHECK(p != PropertyStore::kNotFound && std::wcscmp(store.stringValue(p), kLayers[e % 8]) == 0);
+    p = store.findProperty(e, ACRX_T("Geometry"), ACRX_T("Length"));
+    CHECK(store.type(p) == kPropertyDouble && store.doubleValue(p) == double(e) * 0.5);
+    CHECK(std::wcscmp(store.units(p), L"mm") == 0);
+    p = store.findProperty(e, ACRX_T("Geometry"), ACRX_T("Position"));
+    CHECK(store.type(p) == kPropertyPoint && store.pointValue(p).y == 2.0 * double(e));
+    p = store.findProperty(e, ACRX_T("General"), ACRX_T("Owner"));
+    CHECK(store.type(p) == kPropertyHandle && store.handleValue(p) == 0x1F && store.isHidden(p));
+    p = store.findProperty(e, ACRX_T("Attributes"), ACRX_T("Count"));
+    CHECK(store.type(p) == kPropertyInt64 && store.intValue(p) == Adesk::Int64(e));
+    p = store.findProperty(e, ACRX_T("General"), ACRX_T("Color"));
+    CHECK(store.type(p) == kPropertyInt32 && store.intValue(p) == Adesk::Int64(e % 256));
+    p = store.findProperty(e, ACRX_T("Attributes"), ACRX_T("Empty"));
+    CHECK(store.type(p) == kPropertyEmpty);
+    p = store.findProperty(10, ACRX_T("Attributes"), ACRX_T("Scale"));
+    CHECK(store.type(p) == kPropertyDouble && store.doubleValue(p) == 1.5);
+    CHECK(store.findProperty(e, ACRX_T("Attributes"), ACRX_T("Nope")) == PropertyStore::kNotFound);
+    CHECK(store.findProperty(kFailingObject, ACRX_T("General"), ACRX_T("Layer")) != PropertyStore::kNotFound);
+    for (Adesk::UInt32 i = 1; i < store.stringCount(); ++i)
+        CHECK(std::wcscmp(store.string(i - 1), store.string(i)) < 0);
+}
+
+/* As a reactor, the engine queues the source's objects in beginExtraction
+   and hands every property to addProperty in endExtraction. */
+void testReactor()
+{
+    const size_t kObjects = 2000;
+    StubExtractionSource source(kObjects);
+    PropertyExtractionSettings settings;
+    settings.threadCount = 4;
+    PropertyExtractionEngine engine(source, settings);
+    AcDwgExtractor::BeginExtractionEventArgs begin;
+    AcDwgExtractor::EndExtractionEventArgs end;
+    engine.beginExtraction(begin);
+    CHECK(begin.queued.size() == kObjects);
+    engine.endExtraction(end);
+    const std::shared_ptr<const PropertyStore> pStore = engine.lastStore();
+    CHECK(pStore != nullptr);
+    CHECK(engine.lastStats().status == Acad::eInvalidInput);
+    CHECK(pStore != nullptr && end.propertyCount == pStore->propertyCount());
+
+    settings.forwardProperties = false;
+    PropertyExtractionEngine keeping(source, settings);
+    AcDwgExtractor::BeginExtractionEventArgs keptBegin;
+    AcDwgExtractor::EndExtractionEventArgs keptEnd;
+    keeping.beginExtraction(keptBegin);
+    keeping.endExtraction(keptEnd);
+    CHECK(keptEnd.propertyCount == 0);
+    CHECK(keeping.lastStore() != nullptr && keeping.lastStore()->entityCount() == kObjects);
+}
+
+/* The serial addProperty calls a reactor would make, against the engine on
+   one to eight threads, with objects that cost only CPU and with one in 64
+   waiting 200 us. */
+void benchmarkExtraction(unsigned long objectCount)
+{
+    StubExtractionSource source(objectCount);
+    std::vector<PropertyExtractionObject> objects;
+    source.prepare(objects);
+
+    AcDwgExtractor::EndExtractionEventArgs end;
+    Stopwatch watch;
+    for (size_t n = 0; n < objectCount; ++n)
+    {
+        AcDbObjectId id;
+        id.stubHandle = kFirstHandle + n;
+        AcDbObjectId owner;
+        owner.stubHandle = 0x1F;
+        end.addProperty(id, L"General", L"Layer", AcRxValue(AcString(kLayers[n % 8])));
+        end.addProperty(id, L"General", L"Color", AcRxValue(int(n % 256)));
+        end.addProperty(id, L"General", L"Linetype", AcRxValue(AcString(n % 3 != 0 ? L"ByLayer" : L"Continuous")));
+        end.addProperty(id, L"Geometry", L"Length", AcRxValue(double(n) * 0.5), L"mm");
+        end.addProperty(id, L"Geometry", L"Area", AcRxValue(double(n) * 2.0), L"mm2");
+        end.addProperty(id, L"Geometry", L"Position", AcRxValue(AcGePoint3d(double(n), 2.0 * double(n), 0)));
+        end.addProperty(id, L"General", L"Owner", AcRxValue(owner), L"", true);
+        end.addProperty(id, L"General", L"Visible", AcRxValue(n % 7 != 0));
+        end.addProperty(id, L"Attributes", L"Tag", AcRxValue(AcString((L"T-" + std::to_wstring(n % 5000)).c_str())));
+        end.addProperty(id, L"Attributes", L"Count", AcRxValue(Adesk::Int64(n)));
+        end.addProperty(id, L"Attributes", L"Empty", AcRxValue());
+    }
+    std::printf("%lu objects, serial addProperty: %.1f ms\n", objectCount, watch.milliseconds());
+
+    for (const size_t latencyEvery : {size_t(0), size_t(64)})
+    {
+        source.latencyEvery = latencyEvery;
+        source.latencyMicroseconds = 200;
+        for (const unsigned threads : {1u, 2u, 4u, 8u})
+        {
+            PropertyExtractionSettings settings;
+            settings.threadCount = threads;
+            PropertyExtractionEngine engine(source, settings);
+            std::shared_ptr<const PropertyStore> pStore;
+            PropertyExtractionStats stats;
+            watch.restart();
+            engine.extract(objects, pStore, &stats);
+            std::printf("%lu objects, %s, %u threads: %.1f ms (extract %.1f ms, merge %.1f ms), %.1f bytes a property\n",
+                        objectCount, latencyEvery != 0 ? "one in 64 waiting 200 us" : "CPU only", threads,
+                        watch.milliseconds(), stats.extractNanoseconds / 1e6, stats.mergeNanoseconds / 1e6,
+                        double(stats.storeBytes) / double(stats.propertyCount));
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testThreadsGiveTheSameStore();
+    testReactor();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkExtraction(sizeArgument(argc, argv, 0, 20000));
+
+    return finish();
+}
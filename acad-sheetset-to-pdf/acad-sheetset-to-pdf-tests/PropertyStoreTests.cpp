@@ -0,0 +1,289 @@
+#include "stdafx.h"
+#include "PropertyStore.h"
+
+#include <cwchar>
+#include <random>
+
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+const ACHAR kStoreFile[] = ACRX_T("PropertyStoreTests.acprops");
+const ACHAR kDamagedFile[] = ACRX_T("PropertyStoreTests.damaged.acprops");
+
+const wchar_t* const kLayers[] = {L"0", L"A-WALL", L"A-DOOR", L"A-GLAZ", L"E-LITE", L"M-DUCT", L"S-COLS", L"A-ANNO"};
+const wchar_t* const kMaterials[] = {L"Concrete", L"Steel", L"Glass", L"Timber", L"Brick"};
+
+std::string narrow(const ACHAR* path)
+{
+    return std::string(path, path + std::wcslen(path));
+}
+
+Adesk::UInt64 handleOf(size_t entity, size_t entityCount)
+{
+    return 0x1000 + (entityCount - entity) * 3;
+}
+
+/// <summary>
+/// entityCount entities of ten properties each, written by writerCount
+/// writers taking blocks of blockSize entities in turn, as extraction
+/// threads would.  Handles run backwards, so finding an entity by handle
+/// needs the handle order.
+/// </summary>
+struct StubPropertyWorkload
+{
+    StubPropertyWorkload(size_t entityCount, unsigned writerCount, size_t blockSize) : entityCount(entityCount)
+    {
+        for (unsigned n = 0; n < writerCount; ++n)
+            writers.emplace_back(new PropertyWriter());
+        for (size_t i = 0; i < entityCount; ++i)
+        {
+            PropertyWriter& writer = *writers[(i / blockSize) % writerCount];
+            writer.beginEntity(i, handleOf(i, entityCount), ACRX_T("Model"));
+            writer.addString(ACRX_T("General"), ACRX_T("Layer"), kLayers[i % 8]);
+            writer.addInt32(ACRX_T("General"), ACRX_T("Color"), int(i % 256));
+            writer.addDouble(ACRX_T("Geometry"), ACRX_T("Length"), double(i) * 0.25, ACRX_T("mm"));
+            writer.addString(ACRX_T("Attributes"), ACRX_T("Tag"), (L"T-" + std::to_wstring(i % 100000)).c_str());
+            writer.addPoint(ACRX_T("Geometry"), ACRX_T("Position"), AcGePoint3d(double(i % 1000), double(i / 1000), 0));
+            writer.addBool(ACRX_T("General"), ACRX_T("Visible"), i % 7 != 0);
+            AcDbObjectId owner;
+            owner.stubHandle = 0x1F + i % 3;
+            writer.add(ACRX_T("General"), ACRX_T("Owner"), AcRxValue(owner), ACRX_T(""), true);
+            writer.addString(ACRX_T("Attributes"), ACRX_T("Material"), kMaterials[i % 5]);
+            writer.addDouble(ACRX_T("Geometry"), ACRX_T("Elevation"), double(i % 100), ACRX_T("mm"));
+            writer.addInt64(ACRX_T("Attributes"), ACRX_T("Count"), Adesk::Int64(i));
+        }
+    }
+
+    Acad::ErrorStatus merge(unsigned threadCount, std::shared_ptr<const PropertyStore>& pStore) const
+    {
+        std::vector<const PropertyWriter*> pointers;
+        for (const std::unique_ptr<PropertyWriter>& pWriter : writers)
+            pointers.push_back(pWriter.get());
+        return PropertyStore::merge(pointers, entityCount, threadCount, pStore);
+    }
+
+    size_t entityCount;
+    std::vector<std::unique_ptr<PropertyWriter>> writers;
+};
+
+void writeFile(const ACHAR* path, const std::string& content)
+{
+    std::FILE* pFile = std::fopen(narrow(path).c_str(), "wb");
+    std::fwrite(content.data(), 1, content.size(), pFile);
+    std::fclose(pFile);
+}
+
+/* However the entities were split between writers and threads, the merged
+   store is the same, byte for byte once saved. */
+void testMergeDoesNotDependOnWriters()
+{
+    const size_t kEntities = 5000;
+    std::shared_ptr<const PropertyStore> pOne, pMany;
+    CHECK(StubPropertyWorkload(kEntities, 1, kEntities).merge(1, pOne) == Acad::eOk);
+    CHECK(StubPropertyWorkload(kEntities, 5, 37).merge(4, pMany) == Acad::eOk);
+    if (pOne == nullptr || pMany == nullptr)
+        return;
+    CHECK(pOne->save(kStoreFile) == Acad::eOk);
+    const std::string one = readFile(narrow(kStoreFile).c_str());
+    CHECK(pMany->save(kStoreFile) == Acad::eOk);
+    CHECK(readFile(narrow(kStoreFile).c_str()) == one);
+    CHECK(one.size() == pOne->byteCount());
+    CHECK(pOne->verify() == Acad::eOk);
+}
+
+/* Lookups by handle, by property and by value, on a store opened from
+   disk. */
+void testQueries()
+{
+    const size_t kEntities = 20000;
+    {
+        std::shared_ptr<const PropertyStore> pBuilt;
+        CHECK(StubPropertyWorkload(kEntities, 4, 1000).merge(4, pBuilt) == Acad::eOk);
+        CHECK(pBuilt != nullptr && pBuilt->save(kStoreFile) == Acad::eOk);
+    }
+    std::shared_ptr<const PropertyStore> pStore;
+    CHECK(PropertyStore::open(kStoreFile, pStore) == Acad::eOk);
+    if (pStore == nullptr)
+        return;
+    const PropertyStore& store = *pStore;
+    CHECK(store.isMapped());
+    CHECK(store.verify() == Acad::eOk);
+    CHECK(store.entityCount() == kEntities);
+    CHECK(store.propertyCount() == kEntities * 10);
+    for (Adesk::UInt32 i = 1; i < store.stringCount(); ++i)
+        CHECK(std::wcscmp(store.string(i - 1), store.string(i)) < 0);
+    CHECK(store.findString(ACRX_T("A-WALL")) != StringPool::kNotFound);
+    CHECK(store.findString(ACRX_T("nope")) == StringPool::kNotFound);
+
+    const size_t entity = store.findEntity(handleOf(5, kEntities));
+    CHECK(entity == 5);
+    CHECK(store.findEntity(7) == PropertyStore::kNotFound);
+    size_t p = store.findProperty(entity, ACRX_T("Attributes"), ACRX_T("Count"));
+    CHECK(store.type(p) == kPropertyInt64 && store.intValue(p) == 5);
+    p = store.findProperty(entity, ACRX_T("General"), ACRX_T("Owner"));
+    CHECK(store.type(p) == kPropertyHandle && store.handleValue(p) == 0x1F + 2 && store.isHidden(p));
+    p = store.findProperty(entity, ACRX_T("Geometry"), ACRX_T("Length"));
+    CHECK(store.type(p) == kPropertyDouble && store.doubleValue(p) == 1.25);
+    CHECK(std::wcscmp(store.units(p), L"mm") == 0);
+    p = store.findProperty(entity, ACRX_T("General"), ACRX_T("Visible"));
+    CHECK(store.type(p) == kPropertyBool && store.boolValue(p));
+    CHECK(store.findProperty(entity, ACRX_T("General"), ACRX_T("Nope")) == PropertyStore::kNotFound);
+
+    std::vector<Adesk::UInt32> hits;
+    CHECK(store.findEntities(ACRX_T("General"), ACRX_T("Layer"), AcRxValue(kLayers[1]), hits) == kEntities / 8);
+    CHECK(hits.size() == kEntities / 8 && hits[0] == 1 && hits[1] == 9);
+    hits.clear();
+    CHECK(store.findEntities(ACRX_T("Attributes"), ACRX_T("Tag"), AcRxValue(static_cast<const ACHAR*>(L"T-4242")), hits) == 1);
+    CHECK(hits.size() == 1 && hits[0] == 4242);
+    hits.clear();
+    CHECK(store.findEntities(ACRX_T("Geometry"), ACRX_T("Elevation"), AcRxValue(42.0), hits) == kEntities / 100);
+    hits.clear();
+    CHECK(store.findEntities(nullptr, ACRX_T("Color"), AcRxValue(Adesk::Int64(7)), hits) == (kEntities + 255 - 7) / 256);
+    hits.clear();
+    CHECK(store.findEntities(ACRX_T("Geometry"), ACRX_T("Position"), AcRxValue(AcGePoint3d(42, 17, 0)), hits) == 1);
+    CHECK(hits.size() == 1 && hits[0] == 17042);
+    hits.clear();
+    CHECK(store.findEntities(ACRX_T("Attributes"), ACRX_T("Tag"), AcRxValue(static_cast<const ACHAR*>(L"nope")), hits) == 0);
+}
+
+/* A file that is not a store, or one from another version, does not open;
+   one damaged inside its columns opens and fails verify(). */
+void testDamagedFiles()
+{
+    {
+        std::shared_ptr<const PropertyStore> pBuilt;
+        StubPropertyWorkload(500, 2, 100).merge(1, pBuilt);
+        CHECK(pBuilt != nullptr && pBuilt->save(kStoreFile) == Acad::eOk);
+    }
+    const std::string good = readFile(narrow(kStoreFile).c_str());
+    PropertyStoreHeader header;
+    std::memcpy(&header, good.data(), sizeof(header));
+    std::shared_ptr<const PropertyStore> pStore;
+
+    writeFile(kDamagedFile, good.substr(0, good.size() / 2));
+    CHECK(PropertyStore::open(kDamagedFile, pStore) != Acad::eOk);
+
+    std::string damaged = good;
+    damaged[0] = 'X';
+    writeFile(kDamagedFile, damaged);
+    CHECK(PropertyStore::open(kDamagedFile, pStore) == Acad::eUnsupportedFileFormat);
+
+    damaged = good;
+    damaged[offsetof(PropertyStoreHeader, version)] = char(kPropertyStoreFileVersion + 1);
+    writeFile(kDamagedFile, damaged);
+    CHECK(PropertyStore::open(kDamagedFile, pStore) == Acad::eInvalidDwgVersion);
+
+    damaged = good;
+    damaged[offsetof(PropertyStoreHeader, propertyCount) + 3] ^= 0x40;
+    writeFile(kDamagedFile, damaged);
+    CHECK(PropertyStore::open(kDamagedFile, pStore) == Acad::eInvalidInput);
+
+    damaged = good;
+    const size_t category = size_t(header.sections[kPropertyCategoryColumn].offset) + 4 * 17;
+    std::memset(&damaged[category], 0xFF, 4);
+    writeFile(kDamagedFile, damaged);
+    CHECK(PropertyStore::open(kDamagedFile, pStore) == Acad::eOk);
+    CHECK(pStore != nullptr && pStore->verify() == Acad::eInvalidInput);
+    pStore.reset();
+    std::remove(narrow(kDamagedFile).c_str());
+}
+
+/* Merging, saving, opening and querying a store of entityCount entities,
+   and the same scans over loose category, name and value strings. */
+void benchmarkStore(unsigned long entityCount)
+{
+    Stopwatch watch;
+    std::unique_ptr<StubPropertyWorkload> pWorkload(new StubPropertyWorkload(entityCount, 4, 1000));
+    const double written = watch.milliseconds();
+    std::shared_ptr<const PropertyStore> pBuilt;
+    watch.restart();
+    pWorkload->merge(4, pBuilt);
+    const double merged = watch.milliseconds();
+    pWorkload.reset();
+    watch.restart();
+    pBuilt->save(kStoreFile);
+    const double saved = watch.milliseconds();
+    std::printf("%lu entities: writing %.0f ms, merging %.0f ms, saving %.0f ms, %.1f MB (%.1f bytes a property)\n",
+                entityCount, written, merged, saved, pBuilt->byteCount() / 1e6,
+                double(pBuilt->byteCount()) / double(pBuilt->propertyCount()));
+    pBuilt.reset();
+
+    std::shared_ptr<const PropertyStore> pStore;
+    watch.restart();
+    PropertyStore::open(kStoreFile, pStore);
+    const double opened = watch.milliseconds();
+    watch.restart();
+    pStore->verify();
+    std::printf("%lu entities: opening %.3f ms, verifying %.0f ms\n", entityCount, opened, watch.milliseconds());
+
+    std::vector<Adesk::UInt32> hits;
+    watch.restart();
+    pStore->findEntities(ACRX_T("General"), ACRX_T("Layer"), AcRxValue(kLayers[1]), hits);
+    const double layerScan = watch.milliseconds();
+    hits.clear();
+    watch.restart();
+    pStore->findEntities(ACRX_T("Attributes"), ACRX_T("Tag"), AcRxValue(static_cast<const ACHAR*>(L"T-4242")), hits);
+    const double tagScan = watch.milliseconds();
+
+    std::mt19937 random(1);
+    const size_t kQueries = 100000;
+    size_t found = 0;
+    watch.restart();
+    for (size_t n = 0; n < kQueries; ++n)
+    {
+        const size_t entity = pStore->findEntity(handleOf(random() % entityCount, entityCount));
+        if (entity != PropertyStore::kNotFound &&
+            pStore->findProperty(entity, ACRX_T("General"), ACRX_T("Layer")) != PropertyStore::kNotFound)
+            ++found;
+    }
+    const double lookups = watch.milliseconds();
+    std::printf("%lu entities, store: Layer = A-WALL %.2f ms, Tag = T-4242 %.2f ms, handle to Layer %.0f ns\n",
+                entityCount, layerScan, tagScan, lookups * 1e6 / kQueries);
+
+    struct LooseProperty
+    {
+        std::wstring category;
+        std::wstring name;
+        std::wstring value;
+    };
+    std::vector<LooseProperty> loose;
+    for (size_t i = 0; i < entityCount; ++i)
+    {
+        loose.push_back({L"General", L"Layer", kLayers[i % 8]});
+        loose.push_back({L"General", L"Color", std::to_wstring(i % 256)});
+        loose.push_back({L"Geometry", L"Length", std::to_wstring(double(i) * 0.25)});
+        loose.push_back({L"Attributes", L"Tag", L"T-" + std::to_wstring(i % 100000)});
+        loose.push_back({L"Attributes", L"Material", kMaterials[i % 5]});
+        loose.push_back({L"Attributes", L"Count", std::to_wstring(i)});
+    }
+    size_t count = 0;
+    watch.restart();
+    for (const LooseProperty& property : loose)
+        count += property.name == L"Layer" && property.category == L"General" && property.value == L"A-WALL";
+    const double looseLayer = watch.milliseconds();
+    watch.restart();
+    for (const LooseProperty& property : loose)
+        count += property.name == L"Tag" && property.category == L"Attributes" && property.value == L"T-4242";
+    std::printf("%lu entities, loose strings: Layer = A-WALL %.2f ms, Tag = T-4242 %.2f ms (%zu hits)\n", entityCount,
+                looseLayer, watch.milliseconds(), count);
+    pStore.reset();
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testMergeDoesNotDependOnWriters();
+    testQueries();
+    testDamagedFiles();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkStore(sizeArgument(argc, argv, 0, 100000));
+
+    std::remove(narrow(kStoreFile).c_str());
+    return finish();
+}
@@ -0,0 +1,264 @@
+#include "stdafx.h"
+#include "PublishJournal.h"
+#include "StubPlotBackend.h"
+
+#include <random>
+
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+const ACHAR kJournal[] = ACRX_T("PublishJournalTests.pjnl");
+const ACHAR kOutput[] = ACRX_T("PublishJournalTests.plt");
+
+std::string narrow(const std::wstring& path)
+{
+    return std::string(path.begin(), path.end());
+}
+
+std::wstring fragmentPath(size_t sheet)
+{
+    return L"PublishJournalTests." + std::to_wstring(sheet) + L".plt";
+}
+
+void removeFiles(size_t sheetCount)
+{
+    std::remove(narrow(kJournal).c_str());
+    std::remove(narrow(kOutput).c_str());
+    for (size_t sheet = 0; sheet < sheetCount; ++sheet)
+        std::remove(narrow(fragmentPath(sheet)).c_str());
+}
+
+/* A job of plain plot files, which ConcatenatingFragmentAssembler may join,
+   each sheet of a different length. */
+struct StubPublishJob
+{
+    explicit StubPublishJob(size_t sheetCount) : sheets(sheetCount)
+    {
+        for (size_t n = 0; n < sheetCount; ++n)
+        {
+            AcString key;
+            key.format(ACRX_T("drawing%d.dwg|Layout1"), int(n));
+            keys.push_back(key);
+            sheets[n].content = "IN;sheet " + std::to_string(n) + std::string(100 + n * 37, char('a' + n % 26)) + "\n";
+            expected += sheets[n].content;
+        }
+    }
+
+    /* Publishes the pending sheets one document each, as the driver does,
+       until the backend dies or every sheet is done.  False if it died. */
+    bool run(PublishJournal& journal, StubPlotBackend& backend, PublishCheckpointReactor& reactor)
+    {
+        backend.addReactor(&reactor);
+        for (const size_t n : journal.pendingSheets())
+        {
+            if (backend.plot(keys[n].kwszPtr(), {sheets[n]}, fragmentPath(n).c_str()) == Acad::eInvalidEngineState)
+                return false;
+        }
+        return true;
+    }
+
+    std::vector<AcString> keys;
+    std::vector<StubPlotSheet> sheets;
+    std::string expected;
+};
+
+/* Kills the job at random sheets, sometimes tearing the last journal record
+   as a crash in the middle of writing it would, and reruns it until it is
+   complete: every run resumes after the last good sheet, and the assembled
+   output is what an uninterrupted job would have written. */
+void testResumesAfterFaults(unsigned trials)
+{
+    const size_t kSheets = 40;
+    StubPublishJob job(kSheets);
+    std::mt19937 random(7);
+    for (unsigned trial = 0; trial < trials; ++trial)
+    {
+        removeFiles(kSheets);
+        int runs = 0;
+        size_t done = 0;
+        for (;;)
+        {
+            PublishJournal journal;
+            CHECK(journal.open(kJournal, job.keys, kOutput) == Acad::eOk);
+            CHECK(journal.resumedCount() >= done);
+            done = journal.resumedCount();
+            if (journal.isComplete() || ++runs > 100)
+                break;
+
+            PublishCheckpointReactor reactor(journal);
+            StubPlotBackend backend;
+            const std::vector<size_t> pending = journal.pendingSheets();
+            CHECK(!pending.empty() && pending.front() == done);
+            if (random() % 4 != 0)
+                backend.injectFault(1 + unsigned(random() % pending.size()));
+            const bool completed = job.run(journal, backend, reactor);
+            CHECK(reactor.status() == Acad::eOk);
+            journal.close();
+
+            if (!completed && random() % 2 != 0)
+            {
+                std::FILE* pFile = std::fopen(narrow(kJournal).c_str(), "ab");
+                std::fwrite("SHT1\x30\0\0\0garbage", 1, 15, pFile);
+                std::fclose(pFile);
+            }
+        }
+        CHECK(runs <= 100);
+
+        PublishJournal journal;
+        CHECK(journal.open(kJournal, job.keys, kOutput) == Acad::eOk);
+        CHECK(journal.resumedCount() == kSheets);
+        ConcatenatingFragmentAssembler assembler;
+        CHECK(journal.assemble(kOutput, assembler) == Acad::eOk);
+        CHECK(readFile(narrow(kOutput).c_str()) == job.expected);
+    }
+}
+
+/* A fragment changed after it was journaled is caught at assembly and its
+   sheet is published again; one that is missing is pending as soon as the
+   journal is opened.  A journal for other sheets or another target starts
+   over. */
+void testChangedFragmentAndTarget()
+{
+    const size_t kSheets = 8;
+    StubPublishJob job(kSheets);
+    removeFiles(kSheets);
+    {
+        PublishJournal journal;
+        CHECK(journal.open(kJournal, job.keys, kOutput) == Acad::eOk);
+        PublishCheckpointReactor reactor(journal);
+        StubPlotBackend backend;
+        CHECK(job.run(journal, backend, reactor));
+        CHECK(journal.isComplete());
+        ConcatenatingFragmentAssembler assembler;
+        CHECK(journal.assemble(kOutput, assembler) == Acad::eOk);
+    }
+
+    std::FILE* pFile = std::fopen(narrow(fragmentPath(5)).c_str(), "r+b");
+    std::fputc('X', pFile);
+    std::fclose(pFile);
+    {
+        PublishJournal journal;
+        CHECK(journal.open(kJournal, job.keys, kOutput) == Acad::eOk);
+        CHECK(journal.resumedCount() == kSheets);
+        ConcatenatingFragmentAssembler assembler;
+        CHECK(journal.assemble(kOutput, assembler) == Acad::eDwgCRCDoesNotMatch);
+        CHECK(!journal.isDone(5));
+        CHECK(journal.pendingSheets() == std::vector<size_t>{5});
+    }
+
+    std::remove(narrow(fragmentPath(2)).c_str());
+    {
+        PublishJournal journal;
+        CHECK(journal.open(kJournal, job.keys, kOutput) == Acad::eOk);
+        CHECK(!journal.isDone(2));
+        CHECK(journal.pendingSheets().front() == 2);
+        ConcatenatingFragmentAssembler assembler;
+        CHECK(journal.assemble(kOutput, assembler) == Acad::eNotApplicable);
+    }
+    {
+        PublishJournal journal;
+        CHECK(journal.open(kJournal, job.keys, ACRX_T("PublishJournalTests.other.plt")) == Acad::eOk);
+        CHECK(journal.resumedCount() == 0);
+    }
+    {
+        std::vector<AcString> otherKeys = job.keys;
+        otherKeys.pop_back();
+        PublishJournal journal;
+        CHECK(journal.open(kJournal, otherKeys, kOutput) == Acad::eOk);
+        CHECK(journal.resumedCount() == 0);
+    }
+    removeFiles(kSheets);
+}
+
+/* A cancelled sheet stays pending. */
+void testCancelledSheetStaysPending()
+{
+    const size_t kSheets = 4;
+    StubPublishJob job(kSheets);
+    job.sheets[1].status = AcPlPlotProgress::kSheetCanceledByCancelButton;
+    removeFiles(kSheets);
+    PublishJournal journal;
+    CHECK(journal.open(kJournal, job.keys, kOutput) == Acad::eOk);
+    PublishCheckpointReactor reactor(journal);
+    StubPlotBackend backend;
+    job.run(journal, backend, reactor);
+    CHECK(reactor.status() == Acad::eOk);
+    CHECK(journal.pendingSheets() == std::vector<size_t>{1});
+    journal.close();
+    removeFiles(kSheets);
+}
+
+/* PDF, DWF and DWFx fragments cannot be joined byte for byte, and the
+   output is left as it was. */
+void testDocumentFormatsAreRefused()
+{
+    for (const char* header : {"%PDF-1.7\n%%EOF\n", "(DWF V06.00)PK", "PK\x03\x04"})
+    {
+        const std::vector<std::wstring> fragments = {fragmentPath(0), fragmentPath(1)};
+        for (const std::wstring& fragment : fragments)
+        {
+            std::FILE* pFile = std::fopen(narrow(fragment).c_str(), "wb");
+            std::fputs(header, pFile);
+            std::fclose(pFile);
+        }
+        std::FILE* pFile = std::fopen(narrow(kOutput).c_str(), "wb");
+        std::fputs("old", pFile);
+        std::fclose(pFile);
+
+        ConcatenatingFragmentAssembler assembler;
+        CHECK(assembler.assemble(fragments, kOutput) == Acad::eUnsupportedFileFormat);
+        CHECK(readFile(narrow(kOutput).c_str()) == "old");
+        CHECK(!fileExists((narrow(kOutput) + ".tmp").c_str()));
+    }
+    removeFiles(2);
+}
+
+/* What journaling adds to every sheet: the CRC of the fragment and a record
+   flushed to disk. */
+void benchmarkJournaling(unsigned long sheetCount)
+{
+    StubPublishJob job(sheetCount);
+    removeFiles(sheetCount);
+
+    StubPlotBackend plain;
+    Stopwatch watch;
+    for (size_t n = 0; n < sheetCount; ++n)
+        plain.plot(job.keys[n].kwszPtr(), {job.sheets[n]}, fragmentPath(n).c_str());
+    const double plainMilliseconds = watch.milliseconds();
+
+    PublishJournal journal;
+    journal.open(kJournal, job.keys, kOutput);
+    PublishCheckpointReactor reactor(journal);
+    StubPlotBackend journaled;
+    watch.restart();
+    job.run(journal, journaled, reactor);
+    const double journaledMilliseconds = watch.milliseconds();
+    journal.close();
+
+    watch.restart();
+    journal.open(kJournal, job.keys, kOutput);
+    const double openMilliseconds = watch.milliseconds();
+    std::printf("%lu sheets: journaling %.3f ms per sheet, reopening %.2f ms\n", sheetCount,
+                (journaledMilliseconds - plainMilliseconds) / sheetCount, openMilliseconds);
+    journal.close();
+    removeFiles(sheetCount);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testResumesAfterFaults(20);
+    testChangedFragmentAndTarget();
+    testCancelledSheetStaysPending();
+    testDocumentFormatsAreRefused();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkJournaling(sizeArgument(argc, argv, 0, 400));
+
+    return finish();
+}
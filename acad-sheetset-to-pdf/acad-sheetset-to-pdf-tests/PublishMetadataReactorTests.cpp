@@ -0,0 +1,361 @@
+#include "stdafx.h"
+#include "PublishMetadataReactor.h"
+
+#include <atomic>
+#include <cwchar>
+#include <filesystem>
+#include <map>
+#include <thread>
+
+#include "StubWorkloads.h"
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+const char kSheetSetFile[] = "PublishMetadataReactorTests.dst";
+
+/* A sheet set of sheetCount sheets, two to a drawing, with a job property
+   Client, a sheet property Checked and a sheet-only property Rev. */
+std::string sheetSetXml(int sheetCount)
+{
+    std::string xml =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<!-- comment -->\n"
+        "<AcSmDatabase clsid=\"g1\" ID=\"g2\">\n<AcSmProp propname=\"DbVersion\" vt=\"8\">1.1</AcSmProp>\n"
+        "<AcSmSheetSet clsid=\"x\" ID=\"y\"><AcSmProp propname=\"Name\" vt=\"8\">My &amp; Set</AcSmProp>"
+        "<AcSmCustomPropertyBag clsid=\"b\" propname=\"CustomPropertyBag\" vt=\"13\">"
+        "<AcSmCustomPropertyValue propname=\"Client\" vt=\"13\"><AcSmProp propname=\"Flags\" vt=\"3\">1</AcSmProp>"
+        "<AcSmProp propname=\"Value\" vt=\"8\">ACME &lt;Corp&gt; &#x20AC;</AcSmProp></AcSmCustomPropertyValue>"
+        "<AcSmCustomPropertyValue propname=\"Checked\" vt=\"13\"><AcSmProp propname=\"Flags\" vt=\"3\">2</AcSmProp>"
+        "<AcSmProp propname=\"Value\" vt=\"8\">default</AcSmProp></AcSmCustomPropertyValue>"
+        "</AcSmCustomPropertyBag><AcSmSubset><AcSmProp propname=\"Name\" vt=\"8\">Sub</AcSmProp>"
+        "<AcSmCustomPropertyBag><AcSmCustomPropertyValue propname=\"Nope\"><AcSmProp propname=\"Value\">x</AcSmProp>"
+        "</AcSmCustomPropertyValue></AcSmCustomPropertyBag>\n";
+    for (int i = 0; i < sheetCount; ++i)
+    {
+        char sheet[2048];
+        std::snprintf(
+            sheet, sizeof(sheet),
+            "<AcSmSheet clsid='s' ID='i%d'><AcSmProp propname=\"Title\" vt=\"8\">Sheet %d</AcSmProp>"
+            "<AcSmProp propname=\"Number\" vt=\"8\">A-%d</AcSmProp>"
+            "<AcSmCustomPropertyBag propname=\"CustomPropertyBag\" vt=\"13\">"
+            "<AcSmCustomPropertyValue propname=\"Checked\" vt=\"13\"><AcSmProp propname=\"Flags\" vt=\"3\">2</AcSmProp>"
+            "<AcSmProp propname=\"Value\" vt=\"8\">JD%d</AcSmProp></AcSmCustomPropertyValue>"
+            "<AcSmCustomPropertyValue propname=\"Rev\"><AcSmProp propname=\"Flags\">2</AcSmProp>"
+            "<AcSmProp propname=\"Value\"><![CDATA[r<%d>]]></AcSmProp></AcSmCustomPropertyValue>"
+            "</AcSmCustomPropertyBag>"
+            "<AcSmAcDbViewReference propname=\"View\"><AcSmProp propname=\"Name\">WrongView</AcSmProp>"
+            "</AcSmAcDbViewReference>"
+            "<AcSmAcDbLayoutReference clsid='l' propname=\"Layout\" vt=\"13\">"
+            "<AcSmProp propname=\"Relative_FileName\" vt=\"8\">.\\dwg\\..\\dwg\\D%d.dwg</AcSmProp>"
+            "<AcSmProp propname=\"FileName\" vt=\"8\">C:\\old\\dwg\\D%d.dwg</AcSmProp>"
+            "<AcSmProp propname=\"Name\" vt=\"8\">Layout%d</AcSmProp></AcSmAcDbLayoutReference><Empty/></AcSmSheet>\n",
+            i, i, i, i, i, i / 2, i / 2, i);
+        xml += sheet;
+    }
+    xml += "</AcSmSubset></AcSmSheetSet></AcSmDatabase>\n";
+    return xml;
+}
+
+std::wstring sheetSetFolder()
+{
+    return std::filesystem::current_path().wstring();
+}
+
+std::wstring sheetSetPath()
+{
+    return sheetSetFolder() + L"/" + std::filesystem::path(kSheetSetFile).wstring();
+}
+
+/* The DSD of a job publishing sheets first to end - 1 of the sheet set. */
+AcPlDSDData makeDsd(int end, int first = 0)
+{
+    AcPlDSDData dsd;
+    dsd.setName = L"My & Set";
+    dsd.sections.append(AcString(L"Target"));
+    dsd.data.append(AcString(L"Type=6\r\n"));
+    dsd.sections.append(AcString(L"SheetSet Properties"));
+    dsd.data.append(
+        AcString((L"IsSheetSet=TRUE\r\nDSTPath=" + sheetSetPath() + L"\r\nPublishSheetMetadata=FALSE\r\n").c_str()));
+    for (int i = first; i < end; ++i)
+    {
+        AcPlDSDEntry entry;
+        entry.drawing = sheetSetFolder() + L"/DWG/d" + std::to_wstring(i / 2) + L".dwg";
+        entry.layoutName = L"layout" + std::to_wstring(i);
+        entry.sheetTitle = L"Sheet " + std::to_wstring(i);
+        dsd.entries.append(entry);
+    }
+    return dsd;
+}
+
+const wchar_t* valueOf(const AcNameValuePairVec& properties, const wchar_t* name)
+{
+    for (int i = 0; i < properties.length(); ++i)
+    {
+        if (std::wcscmp(properties[i].name(), name) == 0)
+            return properties[i].value();
+    }
+    return nullptr;
+}
+
+bool hasValue(const AcNameValuePairVec& properties, const wchar_t* name, const wchar_t* value)
+{
+    const wchar_t* found = valueOf(properties, name);
+    return found != nullptr && std::wcscmp(found, value) == 0;
+}
+
+/// <summary>
+/// Passes on to a source, taking delayMicroseconds per sheet as walking an
+/// AcSmCustomPropertyBag over COM does, and counts the calls made on the
+/// thread that created it, which stands for AutoCAD's main thread.
+/// </summary>
+class StubSlowSource : public PublishMetadataSource
+{
+public:
+    StubSlowSource(PublishMetadataSource& source, unsigned delayMicroseconds)
+        : m_source(source), m_delayMicroseconds(delayMicroseconds), m_mainThread(std::this_thread::get_id())
+    {
+    }
+
+    Acad::ErrorStatus prepare(const AcPlDSDData& dsd, AcNameValuePairVec& properties) override
+    {
+        if (std::this_thread::get_id() == m_mainThread)
+            ++mainThreadCalls;
+        return m_source.prepare(dsd, properties);
+    }
+    Acad::ErrorStatus collect(const AcPlDSDEntry& entry, AcNameValuePairVec& properties) const override
+    {
+        if (std::this_thread::get_id() == m_mainThread)
+            ++mainThreadCalls;
+        std::this_thread::sleep_for(std::chrono::microseconds(m_delayMicroseconds));
+        return m_source.collect(entry, properties);
+    }
+
+    mutable std::atomic<int> mainThreadCalls{0};
+
+private:
+    PublishMetadataSource& m_source;
+    unsigned m_delayMicroseconds;
+    std::thread::id m_mainThread;
+};
+
+class StubBeforeJobInfo : public AcPublishBeforeJobInfo
+{
+public:
+    explicit StubBeforeJobInfo(const AcPlDSDData& dsd) : m_dsd(dsd) {}
+
+    const AcPlDSDData* GetDSDData() override { return &m_dsd; }
+    const AcNameValuePairVec GetPrivateData(const ACHAR* sectionName) override { return AcNameValuePairVec(); }
+    bool WritePrivateSection(const ACHAR* sectionName, const AcNameValuePairVec nameValuePairVec) override
+    {
+        return true;
+    }
+    bool JobWillPublishInBackground() override { return true; }
+
+private:
+    const AcPlDSDData& m_dsd;
+};
+
+/// <summary>
+/// A starting job, keeping the private sections written to it.
+/// </summary>
+class StubBeginJobInfo : public AcPublishBeginJobInfo
+{
+public:
+    StubBeginJobInfo(const AcPlDSDData& dsd, bool background) : m_dsd(dsd), m_background(background) {}
+
+    const AcPlDSDData* GetDSDData() override { return &m_dsd; }
+    const AcNameValuePairVec GetPrivateData(const ACHAR* sectionName) override { return sections[sectionName]; }
+    bool WritePrivateSection(const ACHAR* sectionName, const AcNameValuePairVec nameValuePairVec) override
+    {
+        sections[sectionName] = nameValuePairVec;
+        return true;
+    }
+    bool JobWillPublishInBackground() override { return m_background; }
+    AcPlPlotLogger* GetPlotLogger() override { return nullptr; }
+
+    const AcNameValuePairVec& sheet(int index) { return sections[PublishMetadataReactor::sheetSection(index).kwszPtr()]; }
+
+    std::map<std::wstring, AcNameValuePairVec> sections;
+
+private:
+    const AcPlDSDData& m_dsd;
+    bool m_background;
+};
+
+class StubSheetInfo : public AcPublishSheetInfo
+{
+public:
+    const AcPlDSDEntry* GetDSDEntry() override { return nullptr; }
+    const ACHAR* GetUniqueId() override { return ACRX_T(""); }
+    AcPlPlotLogger* GetPlotLogger() override { return nullptr; }
+};
+
+/* The sheet set is read natively, as the Sheet Set Manager would. */
+void testSheetSetFile()
+{
+    writeSheetSetFile(kSheetSetFile, sheetSetXml(40));
+    SheetSetFile file;
+    CHECK(file.load(sheetSetPath().c_str()) == Acad::eOk);
+    CHECK(file.name() == L"My & Set");
+    CHECK(file.sheets().size() == 40);
+    CHECK(file.properties().size() == 2);
+    CHECK(file.properties()[0].value == L"ACME <Corp> \u20AC" && file.properties()[0].flags == 1);
+    const SheetSetSheet& sheet = file.sheets()[3];
+    CHECK(sheet.layout == L"Layout3" && sheet.title == L"Sheet 3" && sheet.number == L"A-3");
+    CHECK(sheet.properties.size() == 2 && sheet.properties[1].value == L"r<3>");
+
+    const std::wstring drawing = sheetSetFolder() + L"/DWG/D2.dwg";
+    CHECK(file.findSheet(drawing.c_str(), L"LAYOUT5") == &file.sheets()[5]);
+    CHECK(file.findSheet(L"/elsewhere/d2.DWG", L"layout5") == &file.sheets()[5]);
+    CHECK(file.findSheet(L"/elsewhere/d3.DWG", L"layout5") == nullptr);
+
+    std::FILE* pFile = std::fopen("PublishMetadataReactorTests.bad.dst", "wb");
+    std::fputs("garbage", pFile);
+    std::fclose(pFile);
+    CHECK(file.load(ACRX_T("PublishMetadataReactorTests.bad.dst")) == Acad::eUnsupportedFileFormat);
+    std::remove("PublishMetadataReactorTests.bad.dst");
+}
+
+/* Queued, started and foreground jobs all get their sheet set's properties,
+   and the source is never called on the publishing thread. */
+void testJobsGetTheirMetadata()
+{
+    const int kSheets = 40;
+    writeSheetSetFile(kSheetSetFile, sheetSetXml(kSheets));
+    SheetSetMetadataSource dstSource;
+    StubSlowSource source(dstSource, 100);
+    const AcPlDSDData dsd = makeDsd(kSheets);
+    StubSheetInfo sheet;
+    {
+        PublishMetadataSettings settings;
+        settings.threadCount = 4;
+        PublishMetadataReactor reactor(source, settings);
+
+        StubBeforeJobInfo before(dsd);
+        reactor.OnAboutToBeginBackgroundPublishing(&before);
+        CHECK(reactor.queuedJobCount() == 1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        const AcPlDSDData started(dsd);
+        StubBeginJobInfo begin(started, true);
+        reactor.OnAboutToBeginPublishing(&begin);
+        reactor.OnBeginPublishingSheet(&sheet);
+        PublishMetadataStats stats = reactor.lastJobStats();
+        CHECK(reactor.queuedJobCount() == 0);
+        CHECK(stats.status == Acad::eOk && stats.background);
+        CHECK(stats.sheetCount == size_t(kSheets) && stats.enrichedSheetCount == size_t(kSheets));
+        CHECK(begin.sections.size() == size_t(kSheets) + 1);
+        const AcNameValuePairVec& job = begin.sections[PublishMetadataReactor::kJobSection];
+        CHECK(hasValue(job, L"Client", L"ACME <Corp> \u20AC"));
+        CHECK(valueOf(job, L"Checked") == nullptr);
+        CHECK(hasValue(begin.sheet(7), L"Checked", L"JD7"));
+        CHECK(hasValue(begin.sheet(7), L"Rev", L"r<7>"));
+
+        StubBeginJobInfo foreground(started, false);
+        reactor.OnAboutToBeginPublishing(&foreground);
+        reactor.OnBeginPublishingSheet(&sheet);
+        stats = reactor.lastJobStats();
+        CHECK(!stats.background);
+        CHECK(foreground.sections.size() == size_t(kSheets) + 1);
+        CHECK(hasValue(foreground.sheet(39), L"Checked", L"JD39"));
+
+        /* Two jobs queued and started the other way round. */
+        const AcPlDSDData first = makeDsd(10), second = makeDsd(20, 10);
+        StubBeforeJobInfo beforeFirst(first), beforeSecond(second);
+        reactor.OnAboutToBeginBackgroundPublishing(&beforeFirst);
+        reactor.OnAboutToBeginBackgroundPublishing(&beforeSecond);
+        StubBeginJobInfo beginSecond(second, true);
+        reactor.OnAboutToBeginPublishing(&beginSecond);
+        CHECK(hasValue(beginSecond.sheet(0), L"Checked", L"JD10"));
+        CHECK(reactor.queuedJobCount() == 1);
+        StubBeginJobInfo beginFirst(first, true);
+        reactor.OnAboutToBeginPublishing(&beginFirst);
+        CHECK(hasValue(beginFirst.sheet(9), L"Checked", L"JD9"));
+        CHECK(reactor.queuedJobCount() == 0);
+
+        /* The queue is bounded, and the reactor can go with jobs queued. */
+        for (int i = 0; i < 20; ++i)
+            reactor.OnAboutToBeginBackgroundPublishing(&before);
+        CHECK(reactor.queuedJobCount() == settings.maxQueuedJobs);
+    }
+    CHECK(source.mainThreadCalls == 0);
+
+    /* A DSD that does not come from a sheet set gets nothing. */
+    AcPlDSDData plain;
+    AcPlDSDEntry entry;
+    entry.drawing = L"x.dwg";
+    entry.layoutName = L"L";
+    plain.entries.append(entry);
+    PublishMetadataReactor reactor(dstSource);
+    StubBeginJobInfo begin(plain, false);
+    reactor.OnAboutToBeginPublishing(&begin);
+    CHECK(begin.sections.empty());
+    CHECK(reactor.lastJobStats().status == Acad::eOk);
+}
+
+/* Time to the first sheet with metadata that takes 2 ms a sheet to collect:
+   collected by the driver before the job, while the job is queued, and when
+   the job starts. */
+void benchmarkTimeToFirstSheet(unsigned long sheetCount)
+{
+    writeSheetSetFile(kSheetSetFile, sheetSetXml(int(sheetCount)));
+    SheetSetMetadataSource dstSource;
+    StubSlowSource source(dstSource, 2000);
+    const AcPlDSDData dsd = makeDsd(int(sheetCount));
+
+    Stopwatch watch;
+    AcNameValuePairVec properties;
+    source.prepare(dsd, properties);
+    for (int i = 0; i < dsd.entries.length(); ++i)
+    {
+        AcNameValuePairVec sheetProperties;
+        source.collect(dsd.entries[i], sheetProperties);
+    }
+    std::printf("%lu sheets, driver collecting before the job: %.1f ms to the first sheet\n", sheetCount,
+                watch.milliseconds());
+
+    PublishMetadataSettings settings;
+    settings.threadCount = 8;
+    PublishMetadataReactor reactor(source, settings);
+    StubBeforeJobInfo before(dsd);
+    StubSheetInfo sheet;
+    const auto report = [&](const char* what) {
+        const PublishMetadataStats stats = reactor.lastJobStats();
+        std::printf("%lu sheets, %s: %.1f ms to the first sheet (%.0f ms of work, %.0f ms saved)\n", sheetCount, what,
+                    stats.firstSheetNanoseconds / 1e6, stats.workNanoseconds / 1e6, stats.savedNanoseconds() / 1e6);
+    };
+
+    reactor.OnAboutToBeginBackgroundPublishing(&before);
+    std::this_thread::sleep_for(std::chrono::milliseconds(sheetCount));
+    StubBeginJobInfo queued(dsd, true);
+    reactor.OnAboutToBeginPublishing(&queued);
+    reactor.OnBeginPublishingSheet(&sheet);
+    report("background job queued for a while");
+
+    reactor.OnAboutToBeginBackgroundPublishing(&before);
+    StubBeginJobInfo immediate(dsd, true);
+    reactor.OnAboutToBeginPublishing(&immediate);
+    reactor.OnBeginPublishingSheet(&sheet);
+    report("background job started at once");
+
+    StubBeginJobInfo foreground(dsd, false);
+    reactor.OnAboutToBeginPublishing(&foreground);
+    reactor.OnBeginPublishingSheet(&sheet);
+    report("foreground job");
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testSheetSetFile();
+    testJobsGetTheirMetadata();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkTimeToFirstSheet(sizeArgument(argc, argv, 0, 400));
+
+    std::remove(kSheetSetFile);
+    return finish();
+}
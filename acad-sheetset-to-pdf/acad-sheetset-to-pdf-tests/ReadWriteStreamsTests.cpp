@@ -0,0 +1,452 @@
+#include "stdafx.h"
+#include "ReadWriteStreams.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+const char kFile[] = "ReadWriteStreamsTests.bin";
+const wchar_t kFileName[] = L"ReadWriteStreamsTests.bin";
+
+/* 70000 bytes of toolPattern() as the lz4 tool 1.9.4 frames them, with
+   lz4 -B4: 64 KB independent blocks and a content checksum. */
+const Adesk::UInt8 kToolIndependentFrame[] =
+{
+    0x04, 0x22, 0x4d, 0x18, 0x64, 0x40, 0xa7, 0x48, 0x01, 0x00, 0x00, 0xf5, 0x02, 0x30, 0x37, 0x65,
+    0x31, 0x38, 0x66, 0x32, 0x39, 0x67, 0x33, 0x61, 0x68, 0x34, 0x63, 0x6a, 0x36, 0x64, 0x11, 0x00,
+    0x45, 0x34, 0x62, 0x69, 0x35, 0x11, 0x00, 0x01, 0x1f, 0x00, 0x04, 0x11, 0x00, 0x05, 0x30, 0x00,
+    0x00, 0x11, 0x00, 0x05, 0x30, 0x00, 0x0f, 0x41, 0x00, 0xcf, 0x0f, 0xeb, 0x00, 0xd8, 0x00, 0xcd,
+    0x01, 0x00, 0xde, 0x01, 0x00, 0x11, 0x02, 0x0f, 0xef, 0x01, 0x22, 0x0f, 0x2c, 0x01, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x8e, 0x50, 0x37, 0x65,
+    0x31, 0x38, 0x66, 0x66, 0x00, 0x00, 0x00, 0xf5, 0x09, 0x32, 0x39, 0x67, 0x33, 0x61, 0x68, 0x34,
+    0x63, 0x6a, 0x36, 0x64, 0x30, 0x37, 0x65, 0x31, 0x38, 0x66, 0x32, 0x39, 0x67, 0x34, 0x62, 0x69,
+    0x35, 0x11, 0x00, 0x01, 0x1f, 0x00, 0x04, 0x11, 0x00, 0x01, 0x1f, 0x00, 0x00, 0x30, 0x00, 0x00,
+    0x11, 0x00, 0x05, 0x30, 0x00, 0x00, 0x11, 0x00, 0x05, 0x30, 0x00, 0x0f, 0x41, 0x00, 0x40, 0x0f,
+    0x69, 0x00, 0x56, 0x00, 0xc9, 0x00, 0x00, 0xda, 0x00, 0x00, 0x0d, 0x01, 0x0f, 0xeb, 0x00, 0x63,
+    0x0f, 0x82, 0x00, 0x2e, 0x0f, 0x2c, 0x01, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x97, 0x50, 0x63, 0x6a, 0x36, 0x64, 0x30, 0x00, 0x00, 0x00,
+    0x00, 0xb9, 0xc5, 0x23, 0x94
+};
+
+/* The same with lz4 -B4 -BD -BX --content-size: 64 KB blocks that match
+   into the block before, block checksums and the content size. */
+const Adesk::UInt8 kToolDependentFrame[] =
+{
+    0x04, 0x22, 0x4d, 0x18, 0x5c, 0x40, 0x70, 0x11, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0xe3, 0x43,
+    0x01, 0x00, 0x00, 0xf5, 0x02, 0x30, 0x37, 0x65, 0x31, 0x38, 0x66, 0x32, 0x39, 0x67, 0x33, 0x61,
+    0x68, 0x34, 0x63, 0x6a, 0x36, 0x64, 0x11, 0x00, 0x45, 0x34, 0x62, 0x69, 0x35, 0x11, 0x00, 0x01,
+    0x1f, 0x00, 0x04, 0x11, 0x00, 0x05, 0x30, 0x00, 0x45, 0x62, 0x69, 0x35, 0x63, 0x30, 0x00, 0x0f,
+    0x41, 0x00, 0xcf, 0x0f, 0xeb, 0x00, 0xd8, 0x04, 0xde, 0x01, 0x0f, 0xef, 0x01, 0x26, 0x0f, 0x2c,
+    0x01, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x8e,
+    0x50, 0x37, 0x65, 0x31, 0x38, 0x66, 0x63, 0xfb, 0xdf, 0x0f, 0x1e, 0x00, 0x00, 0x00, 0x0f, 0xb9,
+    0xff, 0x91, 0x0f, 0x4c, 0xfe, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xc4, 0x50, 0x63, 0x6a, 0x36, 0x64, 0x30, 0xb1, 0x3c, 0x01, 0x1f,
+    0x00, 0x00, 0x00, 0x00, 0xb9, 0xc5, 0x23, 0x94
+};
+
+/// <summary>
+/// What the frames above hold: 300 letters repeated.
+/// </summary>
+std::vector<Adesk::UInt8> toolPattern()
+{
+    std::vector<Adesk::UInt8> bytes(70000);
+    for (size_t i = 0; i < bytes.size(); ++i)
+    {
+        const size_t k = i % 300;
+        bytes[i] = Adesk::UInt8("0123456789abcdefghij"[(k * 7 + k / 13) % 20]);
+    }
+    return bytes;
+}
+
+/// <summary>
+/// The bytes of doubles counting up in quarters, one byte in fifty
+/// flipped, as serialized graphics are.
+/// </summary>
+std::vector<Adesk::UInt8> coordinates(size_t size, unsigned seed)
+{
+    std::mt19937 random(seed);
+    std::vector<Adesk::UInt8> bytes(size);
+    for (size_t i = 0; i < size; ++i)
+    {
+        const double value = double(i / 8) * 0.25;
+        bytes[i] = reinterpret_cast<const Adesk::UInt8*>(&value)[i % 8] ^ (random() % 50 == 0 ? 1 : 0);
+    }
+    return bytes;
+}
+
+/// <summary>
+/// Everything input gives, size bytes at a time, and the status that
+/// ended it.
+/// </summary>
+std::vector<Adesk::UInt8> readAll(IAcReadStream& input, size_t size, int& status)
+{
+    std::vector<Adesk::UInt8> bytes;
+    std::vector<Adesk::UInt8> buffer(size);
+    size_t read = 0;
+    do
+    {
+        status = input.read(buffer.data(), size, &read);
+        bytes.insert(bytes.end(), buffer.begin(), buffer.begin() + read);
+    } while (status == IAcReadStream::eOk);
+    return bytes;
+}
+
+/* xxh32 gives the reference hashes, and in pieces the same as whole. */
+void testXxh32()
+{
+    CHECK(xxh32("", 0) == 0x02CC5D05u);
+    CHECK(xxh32("abc", 3) == 0x32D153FFu);
+    const char kSentence[] = "Nobody inspects the spammish repetition";
+    CHECK(xxh32(kSentence, std::strlen(kSentence)) == 0xE2293B2Fu);
+
+    const std::vector<Adesk::UInt8> bytes = coordinates(1000, 1);
+    std::mt19937 random(2);
+    for (int trial = 0; trial < 100; ++trial)
+    {
+        Xxh32Stream hash(static_cast<Adesk::UInt32>(trial));
+        for (size_t at = 0; at < bytes.size();)
+        {
+            const size_t piece = std::min<size_t>(bytes.size() - at, random() % 40);
+            hash.update(bytes.data() + at, piece);
+            at += piece;
+        }
+        CHECK(hash.digest() == xxh32(bytes.data(), bytes.size(), Adesk::UInt32(trial)));
+    }
+}
+
+/* Reads, takes and seeks within the bytes, and stops at their end. */
+void testMemoryReadStream()
+{
+    const char kDigits[] = "0123456789";
+    MemoryReadStream stream(kDigits, 10);
+    char buffer[8];
+    size_t read = 0;
+    CHECK(stream.read(buffer, 4, &read) == IAcReadStream::eOk && read == 4 && std::memcmp(buffer, "0123", 4) == 0);
+    const Adesk::UInt8* pTaken = stream.take(3);
+    CHECK(pTaken == reinterpret_cast<const Adesk::UInt8*>(kDigits) + 4 && stream.tell() == 7);
+    CHECK(stream.take(4) == nullptr && stream.tell() == 7 && stream.remaining() == 3);
+    CHECK(stream.read(buffer, 8, &read) == IAcReadStream::eEndOfFile && read == 3);
+    CHECK(stream.seek(-2, IAcReadStream::eFromEnd) == IAcReadStream::eOk && stream.tell() == 8);
+    CHECK(stream.seek(1, IAcReadStream::eFromEnd) != IAcReadStream::eOk && stream.tell() == 8);
+    CHECK(stream.seek(-9, IAcReadStream::eFromCurrent) != IAcReadStream::eOk);
+    CHECK(stream.seek(3, IAcReadStream::eFromStart) == IAcReadStream::eOk && *stream.take(1) == '3');
+}
+
+/* Writes overwrite and then extend, setEndOfFile and truncate cut, and
+   reads stop at the end. */
+void testArenaStream()
+{
+    ArenaStream stream;
+    size_t written = 0;
+    CHECK(stream.write("hello world", 11, &written) == IAcWriteStream::eOk && written == 11);
+    stream.seek(6, IAcReadStream::eFromStart);
+    stream.write("WORLD!!", 7, &written);
+    CHECK(stream.size() == 13 && std::memcmp(stream.data(), "hello WORLD!!", 13) == 0);
+    stream.seek(5, IAcReadStream::eFromStart);
+    CHECK(stream.setEndOfFile() == IAcWriteStream::eOk && stream.size() == 5);
+    stream.truncate(2);
+    CHECK(stream.tell() == 2);
+    stream.write("y", 1, &written);
+    CHECK(stream.size() == 3 && std::memcmp(stream.data(), "hey", 3) == 0);
+
+    stream.seek(0, IAcReadStream::eFromStart);
+    char buffer[4];
+    size_t read = 0;
+    CHECK(stream.read(buffer, 4, &read) == IAcReadStream::eEndOfFile && read == 3);
+    stream.clear();
+    CHECK(stream.size() == 0 && stream.tell() == 0);
+}
+
+/* A file written in pieces of every size, large ones straight through,
+   and patched at the start, maps back as written, read or taken in
+   pieces of every size. */
+void testFileRoundTrip()
+{
+    const std::vector<Adesk::UInt8> bytes = coordinates(8 << 20, 1);
+    {
+        BufferedFileWriteStream output(64 << 10);
+        CHECK(output.create(kFileName) == Acad::eOk);
+        std::mt19937 random(5);
+        size_t written = 0;
+        for (size_t at = 0; at < bytes.size(); at += written)
+        {
+            const size_t piece = std::min<size_t>(bytes.size() - at, random() % 3 == 0 ? random() % (300 << 10)
+                                                                                         : random() % 300);
+            CHECK(output.write(bytes.data() + at, piece, &written) == IAcWriteStream::eOk && written == piece);
+        }
+        CHECK(output.tell() == Adesk::Int64(bytes.size()));
+        CHECK(output.seek(0, IAcReadStream::eFromStart) == IAcReadStream::eOk);
+        CHECK(output.write("XY", 2, &written) == IAcWriteStream::eOk);
+        CHECK(output.close() == IAcReadStream::eOk && !output.isOpen());
+    }
+    std::vector<Adesk::UInt8> expected = bytes;
+    expected[0] = 'X';
+    expected[1] = 'Y';
+    const std::string file = readFile(kFile);
+    CHECK(file.size() == expected.size() && std::memcmp(file.data(), expected.data(), expected.size()) == 0);
+
+    MappedReadStream input(1 << 20);
+    CHECK(input.open(kFileName) == Acad::eOk && input.isOpen());
+    std::vector<Adesk::UInt8> back(expected.size());
+    std::mt19937 random(9);
+    size_t read = 0;
+    for (size_t at = 0; at < back.size(); at += read)
+    {
+        const size_t piece = std::min<size_t>(back.size() - at, random() % 100000 + 1);
+        if (random() % 2 != 0)
+        {
+            CHECK(input.read(back.data() + at, piece, &read) == IAcReadStream::eOk && read == piece);
+        }
+        else
+        {
+            const Adesk::UInt8* pTaken = input.take(piece);
+            CHECK(pTaken != nullptr);
+            std::copy(pTaken, pTaken + piece, back.begin() + at);
+            read = piece;
+        }
+    }
+    CHECK(back == expected);
+    CHECK(input.read(back.data(), 1, &read) == IAcReadStream::eEndOfFile && read == 0);
+    CHECK(input.close() == IAcReadStream::eOk && !input.isOpen());
+    std::remove(kFile);
+
+    BufferedFileWriteStream missing;
+    CHECK(missing.create(L"ReadWriteStreamsTests.missing/file.bin") != Acad::eOk);
+    size_t written = 0;
+    CHECK(missing.write("x", 1, &written) != IAcWriteStream::eOk && written == 0);
+    MappedReadStream absent;
+    CHECK(absent.open(L"ReadWriteStreamsTests.missing/file.bin") != Acad::eOk);
+}
+
+/* Frames of every block size written in pieces of every size read back
+   whole; damaged ones fail without reading out of bounds; an empty frame
+   is empty, and a flush in the middle only starts a new block. */
+void testLz4Frames()
+{
+    for (Lz4WriteStream::BlockSize blockSize :
+         {Lz4WriteStream::k64KB, Lz4WriteStream::k256KB, Lz4WriteStream::k1MB, Lz4WriteStream::k4MB})
+    {
+        const std::vector<Adesk::UInt8> bytes = coordinates(3 << 20, blockSize);
+        ArenaStream packed;
+        {
+            Lz4WriteStream output(&packed, blockSize);
+            std::mt19937 random(blockSize);
+            size_t written = 0;
+            for (size_t at = 0; at < bytes.size(); at += written)
+            {
+                const size_t piece = std::min<size_t>(bytes.size() - at, random() % 200000);
+                CHECK(output.write(bytes.data() + at, piece, &written) == IAcWriteStream::eOk && written == piece);
+            }
+            CHECK(output.tell() == Adesk::Int64(bytes.size()));
+            CHECK(output.close() == IAcWriteStream::eOk);
+        }
+        CHECK(packed.size() < bytes.size() * 3 / 4);
+        CHECK(packed.data()[4] == 0x70 && packed.data()[5] == Adesk::UInt8(blockSize << 4));
+
+        MemoryReadStream input(packed.data(), packed.size());
+        Lz4ReadStream unpacked(&input);
+        int status = 0;
+        CHECK(readAll(unpacked, 7777, status) == bytes);
+        CHECK(status == IAcReadStream::eEndOfFile && unpacked.tell() == Adesk::Int64(bytes.size()));
+
+        std::mt19937 random(blockSize + 100);
+        for (int trial = 0; trial < 20; ++trial)
+        {
+            std::vector<Adesk::UInt8> damaged(packed.data(), packed.data() + packed.size());
+            damaged[random() % damaged.size()] ^= 0x10;
+            MemoryReadStream damagedInput(damaged.data(), damaged.size());
+            Lz4ReadStream damagedFrame(&damagedInput);
+            const std::vector<Adesk::UInt8> read = readAll(damagedFrame, 65536, status);
+            CHECK(status == IAcReadStream::eJustAnError || (status == IAcReadStream::eEndOfFile && read != bytes));
+            CHECK(read.size() <= bytes.size());
+        }
+    }
+
+    ArenaStream empty;
+    {
+        Lz4WriteStream output(&empty);
+    }
+    MemoryReadStream emptyInput(empty.data(), empty.size());
+    Lz4ReadStream emptyFrame(&emptyInput);
+    int status = 0;
+    CHECK(readAll(emptyFrame, 1, status).empty() && status == IAcReadStream::eEndOfFile);
+
+    ArenaStream flushed;
+    Lz4WriteStream output(&flushed, Lz4WriteStream::k64KB);
+    size_t written = 0;
+    output.write("abc", 3, &written);
+    CHECK(output.flushBuffers() == IAcWriteStream::eOk && flushed.size() > 7);
+    output.write("def", 3, &written);
+    CHECK(output.close() == IAcWriteStream::eOk);
+    MemoryReadStream flushedInput(flushed.data(), flushed.size());
+    Lz4ReadStream flushedFrame(&flushedInput);
+    const std::vector<Adesk::UInt8> read = readAll(flushedFrame, 8, status);
+    CHECK(std::string(read.begin(), read.end()) == "abcdef" && status == IAcReadStream::eEndOfFile);
+}
+
+/* Frames the lz4 tool wrote read back, dependent blocks included, one
+   after another with a skippable frame between; a content checksum that
+   does not match fails once the frame's data has been read. */
+void testLz4ToolFrames()
+{
+    const std::vector<Adesk::UInt8> pattern = toolPattern();
+    for (const std::vector<Adesk::UInt8>& frame :
+         {std::vector<Adesk::UInt8>(std::begin(kToolIndependentFrame), std::end(kToolIndependentFrame)),
+          std::vector<Adesk::UInt8>(std::begin(kToolDependentFrame), std::end(kToolDependentFrame))})
+    {
+        MemoryReadStream input(frame.data(), frame.size());
+        Lz4ReadStream unpacked(&input);
+        int status = 0;
+        CHECK(readAll(unpacked, 10000, status) == pattern && status == IAcReadStream::eEndOfFile);
+    }
+
+    std::vector<Adesk::UInt8> frames(std::begin(kToolIndependentFrame), std::end(kToolIndependentFrame));
+    const Adesk::UInt8 kSkippable[] = {0x50, 0x2a, 0x4d, 0x18, 3, 0, 0, 0, 1, 2, 3};
+    frames.insert(frames.end(), std::begin(kSkippable), std::end(kSkippable));
+    frames.insert(frames.end(), std::begin(kToolDependentFrame), std::end(kToolDependentFrame));
+    MemoryReadStream input(frames.data(), frames.size());
+    Lz4ReadStream unpacked(&input);
+    int status = 0;
+    std::vector<Adesk::UInt8> twice = pattern;
+    twice.insert(twice.end(), pattern.begin(), pattern.end());
+    CHECK(readAll(unpacked, 4096, status) == twice && status == IAcReadStream::eEndOfFile);
+
+    std::vector<Adesk::UInt8> wrongSum(std::begin(kToolIndependentFrame), std::end(kToolIndependentFrame));
+    wrongSum.back() ^= 1;
+    MemoryReadStream wrongInput(wrongSum.data(), wrongSum.size());
+    Lz4ReadStream wrongFrame(&wrongInput);
+    CHECK(readAll(wrongFrame, 4096, status) == pattern && status == IAcReadStream::eJustAnError);
+}
+
+/* Each stream moving megabytes of coordinates in 256-byte or 4 KB
+   pieces. */
+void benchmarkStreams(unsigned long megabytes)
+{
+    const std::vector<Adesk::UInt8> bytes = coordinates(size_t(megabytes) << 20, 1);
+    const double total = double(bytes.size());
+    size_t moved = 0;
+
+    ArenaStream arena;
+    Stopwatch watch;
+    for (size_t at = 0; at + 256 <= bytes.size(); at += 256)
+        arena.write(bytes.data() + at, 256, &moved);
+    std::printf("ArenaStream, 256 B writes: %.0f MB/s\n", total / 1e3 / watch.milliseconds());
+
+    {
+        BufferedFileWriteStream output;
+        output.create(kFileName);
+        watch.restart();
+        for (size_t at = 0; at + 256 <= bytes.size(); at += 256)
+            output.write(bytes.data() + at, 256, &moved);
+        output.close();
+        std::printf("BufferedFileWriteStream, 256 B writes: %.0f MB/s\n", total / 1e3 / watch.milliseconds());
+    }
+    {
+        BufferedFileWriteStream output(0);
+        output.create(kFileName);
+        watch.restart();
+        for (size_t at = 0; at + 256 <= bytes.size() / 8; at += 256)
+            output.write(bytes.data() + at, 256, &moved);
+        output.close();
+        std::printf("BufferedFileWriteStream, 256 B writes unbuffered: %.0f MB/s\n",
+                    total / 8 / 1e3 / watch.milliseconds());
+    }
+    {
+        BufferedFileWriteStream output;
+        output.create(kFileName);
+        output.write(bytes.data(), bytes.size(), &moved);
+        output.close();
+
+        MappedReadStream input;
+        input.open(kFileName);
+        std::vector<Adesk::UInt8> buffer(4096);
+        watch.restart();
+        while (input.read(buffer.data(), buffer.size(), &moved) == IAcReadStream::eOk)
+        {
+        }
+        const double reading = watch.milliseconds();
+        input.seek(0, IAcReadStream::eFromStart);
+        Adesk::UInt64 sum = 0;
+        watch.restart();
+        while (const Adesk::UInt8* pTaken = input.take(4096))
+            sum += pTaken[0];
+        const double taking = watch.milliseconds();
+        std::printf("MappedReadStream, 4 KB: read %.0f MB/s, take %.0f MB/s (%llu)\n", total / 1e3 / reading,
+                    total / 1e3 / taking, static_cast<unsigned long long>(sum));
+        input.close();
+        std::remove(kFile);
+    }
+
+    ArenaStream packed;
+    {
+        Lz4WriteStream output(&packed);
+        watch.restart();
+        for (size_t at = 0; at + 4096 <= bytes.size(); at += 4096)
+            output.write(bytes.data() + at, 4096, &moved);
+        output.close();
+        std::printf("Lz4WriteStream, 4 KB writes: %.0f MB/s, ratio %.3f\n", total / 1e3 / watch.milliseconds(),
+                    packed.size() / total);
+    }
+    MemoryReadStream input(packed.data(), packed.size());
+    Lz4ReadStream unpacked(&input);
+    std::vector<Adesk::UInt8> buffer(4096);
+    watch.restart();
+    while (unpacked.read(buffer.data(), buffer.size(), &moved) == IAcReadStream::eOk)
+    {
+    }
+    std::printf("Lz4ReadStream, 4 KB reads: %.0f MB/s\n", total / 1e3 / watch.milliseconds());
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testXxh32();
+    testMemoryReadStream();
+    testArenaStream();
+    testFileRoundTrip();
+    testLz4Frames();
+    testLz4ToolFrames();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkStreams(sizeArgument(argc, argv, 0, 32));
+
+    return finish();
+}
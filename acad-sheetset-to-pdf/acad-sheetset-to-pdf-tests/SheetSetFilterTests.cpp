@@ -0,0 +1,313 @@
+#include "stdafx.h"
+#include "SheetSetFilter.h"
+
+#include <algorithm>
+#include <cwctype>
+#include <functional>
+
+#include "StubWorkloads.h"
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+const char kSheetSetFile[] = "SheetSetFilterTests.dst";
+
+const char* const kPropertyNames[] = {"Discipline", "Revision", "Status",  "Drawn By", "Checked By",
+                                      "Zone",       "Package",  "Scale",   "Phase",    "Level"};
+const char* const kDisciplines[] = {"A", "S", "M", "E", "P", "C"};
+const char* const kStatuses[] = {"IFC", "For Tender", "Draft", "Void"};
+
+/* The ten custom properties of sheet n. */
+std::vector<std::string> sheetProperties(size_t n)
+{
+    return {kDisciplines[n % 6],
+            std::to_string((n / 6) % 21),
+            kStatuses[(n / 3) % 4],
+            "User" + std::to_string(n % 20),
+            "Chk" + std::to_string(n % 13),
+            (n % 50 < 10 ? "Z0" : "Z") + std::to_string(n % 50),
+            "P" + std::string((n / 50) % 200 < 10 ? "00" : (n / 50) % 200 < 100 ? "0" : "") + std::to_string((n / 50) % 200),
+            n % 2 != 0 ? "1:100" : "1:50",
+            std::to_string(1 + n % 5),
+            (n % 31 < 10 ? "L0" : "L") + std::to_string(n % 31)};
+}
+
+/* A sheet set of sheetCount sheets, ten to a drawing, with the ten
+   properties on every sheet and a sheet property Client on the set. */
+void writeSheetSet(size_t sheetCount)
+{
+    std::string xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<AcSmDatabase clsid=\"x\"><AcSmSheetSet clsid=\"y\">"
+                      "<AcSmProp propname=\"Name\" vt=\"8\">Big Set</AcSmProp>\n"
+                      "<AcSmCustomPropertyBag propname=\"CustomPropertyBag\">";
+    for (const char* name : kPropertyNames)
+    {
+        xml += std::string("<AcSmCustomPropertyValue propname=\"") + name +
+               "\"><AcSmProp propname=\"Flags\">2</AcSmProp><AcSmProp propname=\"Value\"></AcSmProp>"
+               "</AcSmCustomPropertyValue>";
+    }
+    xml += "<AcSmCustomPropertyValue propname=\"Client\"><AcSmProp propname=\"Flags\">2</AcSmProp>"
+           "<AcSmProp propname=\"Value\">ACME</AcSmProp></AcSmCustomPropertyValue>"
+           "</AcSmCustomPropertyBag><AcSmSubset clsid=\"s\">\n";
+    for (size_t n = 0; n < sheetCount; ++n)
+    {
+        const std::string index = std::to_string(n);
+        xml += "<AcSmSheet clsid=\"z\"><AcSmProp propname=\"Title\">Sheet " + index +
+               "</AcSmProp><AcSmProp propname=\"Number\">" + index + "</AcSmProp>"
+               "<AcSmAcDbLayoutReference propname=\"Layout\"><AcSmProp propname=\"Name\">L" + index +
+               "</AcSmProp><AcSmProp propname=\"FileName\">C:\\dwg\\d" + std::to_string(n / 10) +
+               ".dwg</AcSmProp></AcSmAcDbLayoutReference><AcSmCustomPropertyBag propname=\"CustomPropertyBag\">";
+        const std::vector<std::string> values = sheetProperties(n);
+        for (size_t k = 0; k < values.size(); ++k)
+        {
+            xml += std::string("<AcSmCustomPropertyValue propname=\"") + kPropertyNames[k] +
+                   "\"><AcSmProp propname=\"Flags\">2</AcSmProp><AcSmProp propname=\"Value\">" + values[k] +
+                   "</AcSmProp></AcSmCustomPropertyValue>";
+        }
+        xml += "</AcSmCustomPropertyBag></AcSmSheet>\n";
+    }
+    xml += "</AcSmSubset></AcSmSheetSet></AcSmDatabase>\n";
+    writeSheetSetFile(kSheetSetFile, xml);
+}
+
+std::wstring lower(std::wstring text)
+{
+    for (wchar_t& c : text)
+        c = wchar_t(std::towlower(c));
+    return text;
+}
+
+/// <summary>
+/// Answers the questions of a filter the way a caller without one would,
+/// by walking every sheet's properties and then the set's.
+/// </summary>
+class SheetWalker
+{
+public:
+    explicit SheetWalker(const SheetSetFile& file) : m_file(file) {}
+
+    const std::wstring* property(size_t sheet, const wchar_t* name) const
+    {
+        const std::wstring key = lower(name);
+        for (const SheetSetProperty& property : m_file.sheets()[sheet].properties)
+        {
+            if (lower(property.name) == key)
+                return &property.value;
+        }
+        for (const SheetSetProperty& property : m_file.properties())
+        {
+            if ((property.flags & 2) != 0 && lower(property.name) == key)
+                return &property.value;
+        }
+        return nullptr;
+    }
+    bool equals(size_t sheet, const wchar_t* name, const wchar_t* value) const
+    {
+        const std::wstring* pValue = property(sheet, name);
+        return pValue != nullptr && lower(*pValue) == lower(value);
+    }
+    double number(size_t sheet, const wchar_t* name) const
+    {
+        const std::wstring* pValue = property(sheet, name);
+        return pValue != nullptr ? std::wcstod(pValue->c_str(), nullptr) : -1;
+    }
+
+private:
+    const SheetSetFile& m_file;
+};
+
+struct FilterCase
+{
+    const wchar_t* expression;
+    std::function<bool(const SheetWalker&, size_t)> selects;
+};
+
+std::vector<FilterCase> filterCases()
+{
+    return {
+        {L"Discipline = A", [](const SheetWalker& w, size_t s) { return w.equals(s, L"Discipline", L"A"); }},
+        {L"discipline = a and Revision >= 3",
+         [](const SheetWalker& w, size_t s) { return w.equals(s, L"Discipline", L"A") && w.number(s, L"Revision") >= 3; }},
+        {L"Status in (\"IFC\", 'For Tender') and not Discipline = M",
+         [](const SheetWalker& w, size_t s) {
+             return (w.equals(s, L"Status", L"IFC") || w.equals(s, L"Status", L"For Tender")) &&
+                    !w.equals(s, L"Discipline", L"M");
+         }},
+        {L"Package = P042", [](const SheetWalker& w, size_t s) { return w.equals(s, L"Package", L"P042"); }},
+        {L"Zone like 'z0*' and [Drawn By] <> User3",
+         [](const SheetWalker& w, size_t s) {
+             const std::wstring* pZone = w.property(s, L"Zone");
+             return pZone != nullptr && (*pZone)[1] == L'0' && !w.equals(s, L"Drawn By", L"User3");
+         }},
+        {L"Revision < 2 or (Phase = 2 and Level not in (L01, L02))",
+         [](const SheetWalker& w, size_t s) {
+             return w.number(s, L"Revision") < 2 ||
+                    (w.equals(s, L"Phase", L"2") && !w.equals(s, L"Level", L"L01") && !w.equals(s, L"Level", L"L02"));
+         }},
+        {L"Client = acme and Discipline = E",
+         [](const SheetWalker& w, size_t s) { return w.equals(s, L"Client", L"ACME") && w.equals(s, L"Discipline", L"E"); }},
+        {L"", [](const SheetWalker&, size_t) { return true; }},
+    };
+}
+
+/* Every filter selects what walking the sheets would. */
+void testSelectsWhatAWalkWould()
+{
+    const size_t kSheets = 3000;
+    writeSheetSet(kSheets);
+    SheetSetFile file;
+    CHECK(file.load(ACRX_T("SheetSetFilterTests.dst")) == Acad::eOk);
+    CHECK(file.sheets().size() == kSheets);
+    const SheetWalker walker(file);
+    for (const FilterCase& filterCase : filterCases())
+    {
+        SheetSetFilter filter;
+        CHECK(SheetSetFilter::parse(filterCase.expression, filter) == Acad::eOk);
+        std::vector<size_t> selected, expected;
+        filter.select(file, selected);
+        for (size_t s = 0; s < kSheets; ++s)
+        {
+            if (filterCase.selects(walker, s))
+                expected.push_back(s);
+        }
+        CHECK(selected == expected);
+    }
+}
+
+/* Bad expressions are refused with where they went wrong, however deep. */
+void testBadExpressions()
+{
+    const struct
+    {
+        const wchar_t* expression;
+        size_t offset;
+    } bad[] = {{L"Discipline", 10},     {L"Discipline = ", 13},     {L"(Discipline = A", 15},
+               {L"Discipline = A or", 17}, {L"Discipline in (A, ", 18}, {L"Discipline = A)", 14}};
+    for (const auto& expression : bad)
+    {
+        SheetSetFilter filter;
+        size_t offset = 999;
+        CHECK(SheetSetFilter::parse(expression.expression, filter, &offset) == Acad::eInvalidInput);
+        CHECK(offset == expression.offset);
+    }
+    for (const wchar_t* expression : {L"\"unterminated = 3", L"a ! b", L"and = 3"})
+    {
+        SheetSetFilter filter;
+        CHECK(SheetSetFilter::parse(expression, filter) == Acad::eInvalidInput);
+    }
+
+    SheetSetFilter filter;
+    CHECK(SheetSetFilter::parse(std::wstring(100000, L'(').c_str(), filter) == Acad::eInvalidInput);
+    std::wstring nots;
+    for (int n = 0; n < 300; ++n)
+        nots += L"not ";
+    CHECK(SheetSetFilter::parse((nots + L"a = b").c_str(), filter) == Acad::eInvalidInput);
+}
+
+/* Setting a property updates the index the next select() reads, and a
+   sheet's own value hides the set's. */
+void testPropertiesSetAfterLoading()
+{
+    const size_t kSheets = 200;
+    writeSheetSet(kSheets);
+    SheetSetFile file;
+    CHECK(file.load(ACRX_T("SheetSetFilterTests.dst")) == Acad::eOk);
+    std::vector<size_t> selected;
+
+    SheetSetFilter architectural;
+    SheetSetFilter::parse(ACRX_T("Discipline = A"), architectural);
+    CHECK(file.setSheetProperty(6, ACRX_T("DISCIPLINE"), ACRX_T("S")) == Acad::eOk);
+    architectural.select(file, selected);
+    CHECK(std::find(selected.begin(), selected.end(), 6) == selected.end());
+    CHECK(file.setSheetProperty(7, ACRX_T("discipline"), ACRX_T("a")) == Acad::eOk);
+    architectural.select(file, selected);
+    CHECK(std::find(selected.begin(), selected.end(), 7) != selected.end());
+    CHECK(std::is_sorted(selected.begin(), selected.end()));
+
+    SheetSetFilter other, mine;
+    SheetSetFilter::parse(ACRX_T("Client = Other"), other);
+    SheetSetFilter::parse(ACRX_T("client = mine"), mine);
+    CHECK(file.setSheetProperty(3, ACRX_T("Client"), ACRX_T("Mine")) == Acad::eOk);
+    CHECK(file.setProperty(ACRX_T("Client"), ACRX_T("Other")) == Acad::eOk);
+    other.select(file, selected);
+    CHECK(selected.size() == kSheets - 1 && std::find(selected.begin(), selected.end(), 3) == selected.end());
+    mine.select(file, selected);
+    CHECK(selected == std::vector<size_t>{3});
+    CHECK(file.setSheetProperty(kSheets, ACRX_T("x"), ACRX_T("y")) == Acad::eInvalidIndex);
+
+    const SheetSetPropertyIndex& index = file.propertyIndex();
+    const Adesk::UInt32 name = index.findName(ACRX_T("discipline"));
+    CHECK(name != SheetSetPropertyIndex::kNotFound);
+    CHECK(index.sheets(name, index.findValue(ACRX_T("A"))).size() == (kSheets + 5) / 6);
+    CHECK(index.findValue(ACRX_T("nothing")) == SheetSetPropertyIndex::kNotFound);
+}
+
+/* A package becomes DSD entries, with its page setup from the drawing named
+   or its own. */
+void testDsdEntries()
+{
+    writeSheetSet(200);
+    SheetSetFile file;
+    CHECK(file.load(ACRX_T("SheetSetFilterTests.dst")) == Acad::eOk);
+    SheetSetFilter package;
+    CHECK(SheetSetFilter::parse(ACRX_T("Package = P001"), package) == Acad::eOk);
+    AcPlDSDEntries entries;
+    CHECK(package.appendDsdEntries(file, ACRX_T("PDF A1"), ACRX_T("c:/dwg/D5.dwg"), entries) == Acad::eOk);
+    CHECK(entries.length() == 50);
+    if (entries.length() != 50)
+        return;
+    CHECK(std::wcscmp(entries[0].layout(), L"L50") == 0);
+    CHECK(std::wcscmp(entries[0].dwgName(), L"C:\\dwg\\d5.dwg") == 0);
+    CHECK(entries[0].setupType() == AcPlDSDEntry::kNPSSameDWG);
+    CHECK(entries[10].setupType() == AcPlDSDEntry::kNPSOtherDWG);
+    CHECK(std::wcscmp(entries[10].NPSSourceDWG(), L"c:/dwg/D5.dwg") == 0);
+    CHECK(std::wcscmp(entries[10].NPS(), L"PDF A1") == 0);
+}
+
+/* Loading a set of sheetCount sheets, and every filter answered from the
+   index against walking the sheets. */
+void benchmarkFilters(unsigned long sheetCount)
+{
+    writeSheetSet(sheetCount);
+    SheetSetFile file;
+    Stopwatch watch;
+    file.load(ACRX_T("SheetSetFilterTests.dst"));
+    std::printf("%lu sheets: loading %.1f ms\n", sheetCount, watch.milliseconds());
+
+    const SheetWalker walker(file);
+    for (const FilterCase& filterCase : filterCases())
+    {
+        SheetSetFilter filter;
+        SheetSetFilter::parse(filterCase.expression, filter);
+        std::vector<size_t> selected;
+        const int kRepeats = 50;
+        watch.restart();
+        for (int n = 0; n < kRepeats; ++n)
+            filter.select(file, selected);
+        const double indexed = watch.milliseconds() / kRepeats;
+        size_t walked = 0;
+        watch.restart();
+        for (size_t s = 0; s < sheetCount; ++s)
+            walked += filterCase.selects(walker, s);
+        std::printf("%lu sheets, %-58ls %5zu sheets: index %8.1f us, walk %9.1f us\n", sheetCount,
+                    filterCase.expression, walked, indexed * 1000, watch.milliseconds() * 1000);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testSelectsWhatAWalkWould();
+    testBadExpressions();
+    testPropertiesSetAfterLoading();
+    testDsdEntries();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkFilters(sizeArgument(argc, argv, 0, 10000));
+
+    std::remove(kSheetSetFile);
+    return finish();
+}
@@ -0,0 +1,499 @@
+#pragma once
+
+/*
+ * Made-up inputs for the tests and benchmarks: point clouds of walls and
+ * pipes held in memory, a progress callback that can cancel, sheet set
+ * files, a world draw that records what is drawn through it, drawables
+ * and a write stream held in memory.  Every generator is seeded, so a run
+ * is the same every time.
+ */
+
+#include "stdafx.h"
+#include "AcDbPointCloudApi.h"
+#include "AcPointCloudExtractor.h"
+#include "IAcReadWriteStream.h"
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace acad_sheetset_to_pdf {
+namespace tests {
+
+/// <summary>
+/// A point cloud buffer over points held in memory, with normals if
+/// stubNormals is not empty.
+/// </summary>
+class StubPointCloudBuffer : public IAcDbPointCloudDataBuffer
+{
+public:
+    Adesk::UInt64 numPoints() const override { return stubPoints.size(); }
+    const AcGePoint3d* points() const override { return stubPoints.data(); }
+    const AcGeVector3d* normals() const override { return stubNormals.empty() ? nullptr : stubNormals.data(); }
+    const RGBA* colors() const override { return nullptr; }
+    const Adesk::UInt8* intensity() const override { return nullptr; }
+    const Adesk::UInt8* classifications() const override { return nullptr; }
+    const AcGeMatrix3d& transform() const override { return stubTransform; }
+    void freeObject() override {}
+    void* getBuffer() const override { return nullptr; }
+
+    std::vector<AcGePoint3d> stubPoints;
+    std::vector<AcGeVector3d> stubNormals;
+    AcGeMatrix3d stubTransform;
+};
+
+/// <summary>
+/// A scan of walls 3 high standing on a floor: a 40 by 20 outline, one
+/// wall across it at x = 20 and a shorter one at y = 10.  density is the
+/// number of wall points per unit of wall length; the floor gets as many
+/// points as all walls together, all of them below a slab cut at height
+/// 1.5.
+/// </summary>
+inline void scanFloorPlan(StubPointCloudBuffer& buffer, double density, unsigned seed = 1)
+{
+    std::mt19937 random(seed);
+    std::normal_distribution<double> noise(0, 0.005);
+    std::uniform_real_distribution<double> unit(0, 1);
+
+    const double walls[][4] = {{0, 0, 40, 0}, {40, 0, 40, 20}, {40, 20, 0, 20},
+                               {0, 20, 0, 0}, {20, 0, 20, 12}, {0, 10, 15, 10}};
+    size_t wallPoints = 0;
+    for (const auto& wall : walls)
+    {
+        const double length = std::hypot(wall[2] - wall[0], wall[3] - wall[1]);
+        const size_t count = static_cast<size_t>(length * density);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const double t = unit(random);
+            buffer.stubPoints.emplace_back(wall[0] + (wall[2] - wall[0]) * t + noise(random),
+                                       wall[1] + (wall[3] - wall[1]) * t + noise(random), unit(random) * 3);
+        }
+        wallPoints += count;
+    }
+    for (size_t i = 0; i < wallPoints; ++i)
+        buffer.stubPoints.emplace_back(unit(random) * 40, unit(random) * 20, 0);
+}
+
+/// <summary>
+/// A scan of columns by rows separate rooms, each 6 by 4 with walls 3
+/// high, 2 apart, with no floor.  density is as for scanFloorPlan.
+/// </summary>
+inline void scanRooms(StubPointCloudBuffer& buffer, int columns, int rows, double density, unsigned seed = 1)
+{
+    std::mt19937 random(seed);
+    std::normal_distribution<double> noise(0, 0.005);
+    std::uniform_real_distribution<double> unit(0, 1);
+
+    for (int row = 0; row < rows; ++row)
+    {
+        for (int column = 0; column < columns; ++column)
+        {
+            const double x = column * 8.0;
+            const double y = row * 6.0;
+            const double walls[][4] = {{x, y, x + 6, y}, {x + 6, y, x + 6, y + 4},
+                                       {x + 6, y + 4, x, y + 4}, {x, y + 4, x, y}};
+            for (const auto& wall : walls)
+            {
+                const double length = std::hypot(wall[2] - wall[0], wall[3] - wall[1]);
+                const size_t count = static_cast<size_t>(length * density);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    const double t = unit(random);
+                    buffer.stubPoints.emplace_back(wall[0] + (wall[2] - wall[0]) * t + noise(random),
+                                                   wall[1] + (wall[3] - wall[1]) * t + noise(random),
+                                                   unit(random) * 3);
+                }
+            }
+        }
+    }
+}
+
+/// <summary>
+/// A pipe of a scanned plant: the centre of its bottom cap, its axis, its
+/// radius and its length.
+/// </summary>
+struct StubPipe
+{
+    AcGePoint3d  origin;
+    AcGeVector3d axis;
+    double       radius;
+    double       height;
+};
+
+/// <summary>
+/// The pipes scanPlant scans, far from the origin as survey coordinates
+/// are: a horizontal, a sloping, a vertical and a diagonal one.
+/// </summary>
+inline std::vector<StubPipe> plantPipes()
+{
+    return {{AcGePoint3d(1000, 2000, 3), AcGeVector3d(1, 0, 0), 0.15, 6},
+            {AcGePoint3d(1000, 2001, 3), AcGeVector3d(0, 0.6, 0.8), 0.05, 3},
+            {AcGePoint3d(1003, 1998, 2), AcGeVector3d(0, 0, 1), 0.3, 4},
+            {AcGePoint3d(998, 2003, 4), AcGeVector3d(0.7071, 0.7071, 0), 0.08, 5}};
+}
+
+/// <summary>
+/// A scan of plantPipes() over a 10 by 10 floor, with clutter of points
+/// scattered through the room.  Each pipe is seen from one side only, 234
+/// degrees around, with density points per unit of pipe surface; normals
+/// are exact on the pipes and the floor and random on the clutter.
+/// </summary>
+inline void scanPlant(StubPointCloudBuffer& buffer, double density, unsigned seed = 7)
+{
+    std::mt19937 random(seed);
+    std::normal_distribution<double> noise(0, 0.002);
+    std::uniform_real_distribution<double> unit(0, 1);
+
+    for (const StubPipe& pipe : plantPipes())
+    {
+        const AcGeVector3d axis = pipe.axis.normal();
+        const AcGeVector3d e1 = axis.perpVector().normal();
+        const AcGeVector3d e2 = axis.crossProduct(e1);
+        const size_t count = static_cast<size_t>(pipe.radius * pipe.height * density);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const double theta = unit(random) * 3.14159265 * 1.3;
+            const AcGeVector3d radial = e1 * std::cos(theta) + e2 * std::sin(theta);
+            buffer.stubPoints.push_back(pipe.origin + axis * (unit(random) * pipe.height) +
+                                        radial * (pipe.radius + noise(random)));
+            buffer.stubNormals.push_back(radial);
+        }
+    }
+    for (int i = 0; i < 100000; ++i)
+    {
+        buffer.stubPoints.emplace_back(995 + unit(random) * 10, 1995 + unit(random) * 10, unit(random) * 0.01);
+        buffer.stubNormals.push_back(AcGeVector3d(0, 0, 1));
+    }
+    for (int i = 0; i < 20000; ++i)
+    {
+        buffer.stubPoints.emplace_back(995 + unit(random) * 10, 1995 + unit(random) * 10, unit(random) * 8);
+        buffer.stubNormals.push_back(AcGeVector3d(unit(random), unit(random), unit(random)).normal());
+    }
+}
+
+/// <summary>
+/// Progress callback that records what it is told and cancels once
+/// progress reaches cancelAt.
+/// </summary>
+class StubExtractionProgress : public IPointCloudExtracProgressCallback
+{
+public:
+    explicit StubExtractionProgress(int cancelAt = 1000) : m_cancelAt(cancelAt) {}
+
+    void updateProgress(int progress) override
+    {
+        lastProgress = progress;
+        ++progressCalls;
+        if (progress >= m_cancelAt)
+            m_cancelled = true;
+    }
+    void updateCaption(const AcString& caption) override {}
+    bool cancelled() const override { return m_cancelled; }
+    void cancel() override { m_cancelled = true; }
+    void updateRemainTime(double remainTime) override {}
+    void end() override { ended = true; }
+
+    int lastProgress = -1;
+    int progressCalls = 0;
+    bool ended = false;
+
+private:
+    int m_cancelAt;
+    bool m_cancelled = false;
+};
+
+/// <summary>
+/// Writes xml to path as the Sheet Set Manager writes a DST file: with a
+/// byte order mark and every byte put through the DST substitution.
+/// </summary>
+inline void writeSheetSetFile(const char* path, const std::string& xml)
+{
+    /* kDecode of SheetSetFile.cpp, turned around below. */
+    static const Adesk::UInt8 kDecode[256] =
+    {
+        0x8c, 0x8b, 0x8e, 0x8d, 0x88, 0x87, 0x8a, 0x89, 0x84, 0x83, 0x86, 0x85, 0x80, 0x7f, 0x82, 0x81,
+        0x7c, 0x7b, 0x7e, 0x7d, 0x78, 0x77, 0x7a, 0x79, 0x74, 0x73, 0x76, 0x75, 0x70, 0x6f, 0x72, 0x71,
+        0xac, 0xab, 0xae, 0xad, 0xa8, 0xa7, 0xaa, 0xa9, 0xa4, 0xa3, 0xa6, 0xa5, 0xa0, 0x9f, 0xa2, 0xa1,
+        0x9c, 0x9b, 0x9e, 0x9d, 0x98, 0x97, 0x9a, 0x99, 0x94, 0x93, 0x96, 0x95, 0x90, 0x8f, 0x92, 0x91,
+        0xcc, 0xcb, 0xce, 0xcd, 0xc8, 0xc7, 0xca, 0xc9, 0xc4, 0xc3, 0xc6, 0xc5, 0xc0, 0xbf, 0xc2, 0xc1,
+        0xbc, 0xbb, 0xbe, 0xbd, 0xb8, 0xb7, 0xba, 0xb9, 0xb4, 0xb3, 0xb6, 0xb5, 0xb0, 0xaf, 0xb2, 0xb1,
+        0xec, 0xeb, 0xee, 0xed, 0xe8, 0xe7, 0xea, 0xe9, 0xe4, 0xe3, 0xe6, 0xe5, 0xe0, 0xdf, 0xe2, 0xe1,
+        0xdc, 0xdb, 0xde, 0xdd, 0xd8, 0xd7, 0xda, 0xd9, 0xd4, 0xd3, 0xd6, 0xd5, 0xd0, 0xcf, 0xd2, 0xd1,
+        0x0c, 0x0b, 0x0e, 0x0d, 0x08, 0x07, 0x0a, 0x09, 0x04, 0x03, 0x06, 0x05, 0x00, 0x0f, 0x02, 0x01,
+        0xfc, 0xfb, 0xfe, 0xfd, 0xf8, 0xf7, 0xfa, 0xf9, 0xf4, 0xf3, 0xf6, 0xf5, 0xf0, 0xef, 0xf2, 0xf1,
+        0x2c, 0x2b, 0x2e, 0x2d, 0x28, 0x27, 0x2a, 0x29, 0x24, 0x23, 0x26, 0x25, 0x20, 0x1f, 0x22, 0x21,
+        0x1c, 0x1b, 0x1e, 0x1d, 0x18, 0x17, 0x1a, 0x19, 0x14, 0x13, 0x16, 0x15, 0x10, 0x0f, 0x12, 0x11,
+        0x4c, 0x4b, 0x4e, 0x4d, 0x48, 0x47, 0x4a, 0x49, 0x44, 0x43, 0x46, 0x45, 0x40, 0x3f, 0x42, 0x41,
+        0x3c, 0x3b, 0x3e, 0x3d, 0x38, 0x37, 0x3a, 0x39, 0x34, 0x33, 0x36, 0x35, 0x30, 0x2f, 0x32, 0x31,
+        0x6c, 0x6b, 0x6e, 0x6d, 0x68, 0x67, 0x6a, 0x69, 0x64, 0x63, 0x66, 0x65, 0x60, 0x5f, 0x62, 0x61,
+        0x5c, 0x5b, 0x5e, 0x5d, 0x58, 0x57, 0x5a, 0x59, 0x54, 0x53, 0x56, 0x55, 0x50, 0x4f, 0x52, 0x51
+    };
+    Adesk::UInt8 encode[256] = {};
+    for (int i = 0; i < 256; ++i)
+        encode[kDecode[i]] = Adesk::UInt8(i);
+
+    std::string bytes = "\xEF\xBB\xBF" + xml;
+    for (char& c : bytes)
+        c = char(encode[Adesk::UInt8(c)]);
+    std::FILE* pFile = std::fopen(path, "wb");
+    std::fwrite(bytes.data(), 1, bytes.size(), pFile);
+    std::fclose(pFile);
+}
+
+/// <summary>
+/// Sub-entity traits that only hold what they are set to.
+/// </summary>
+class StubSubEntityTraits : public AcGiSubEntityTraits
+{
+public:
+    void setColor(const Adesk::UInt16 color) override { m_color = color; }
+    void setTrueColor(const AcCmEntityColor& color) override { m_trueColor = color; }
+    void setLayer(const AcDbObjectId layerId) override { m_layer = layerId; }
+    void setLineType(const AcDbObjectId linetypeId) override { m_linetype = linetypeId; }
+    void setSelectionMarker(const Adesk::LongPtr markerId) override {}
+    void setFillType(const AcGiFillType fillType) override { m_fillType = fillType; }
+    void setLineWeight(const AcDb::LineWeight lineWeight) override { m_lineWeight = lineWeight; }
+    void setLineTypeScale(double scale = 1.0) override { m_linetypeScale = scale; }
+    void setThickness(double thickness) override { m_thickness = thickness; }
+
+    Adesk::UInt16 color() const override { return m_color; }
+    AcCmEntityColor trueColor() const override { return m_trueColor; }
+    AcDbObjectId layerId() const override { return m_layer; }
+    AcDbObjectId lineTypeId() const override { return m_linetype; }
+    AcGiFillType fillType() const override { return m_fillType; }
+    AcDb::LineWeight lineWeight() const override { return m_lineWeight; }
+    double lineTypeScale() const override { return m_linetypeScale; }
+    double thickness() const override { return m_thickness; }
+
+private:
+    Adesk::UInt16 m_color = 256;
+    AcCmEntityColor m_trueColor;
+    AcDbObjectId m_layer;
+    AcDbObjectId m_linetype;
+    AcGiFillType m_fillType = kAcGiFillNever;
+    AcDb::LineWeight m_lineWeight = AcDb::kLnWtByLayer;
+    double m_linetypeScale = 1.0;
+    double m_thickness = 0.0;
+};
+
+/// <summary>
+/// A world draw whose geometry records the polylines drawn through it,
+/// each with the linetype the traits had when it was drawn.  The other
+/// primitives are accepted and dropped.
+/// </summary>
+class StubWorldDraw : public AcGiWorldDraw
+{
+public:
+    struct Polyline
+    {
+        std::vector<AcGePoint3d> points;
+        AcDbObjectId linetype;
+    };
+
+    StubWorldDraw() : m_geometry(*this) {}
+
+    AcGiRegenType regenType() const override { return kAcGiStandardDisplay; }
+    Adesk::Boolean regenAbort() const override { return false; }
+    AcGiSubEntityTraits& subEntityTraits() const override { return m_traits; }
+    AcGiGeometry* rawGeometry() const override { return &m_geometry; }
+    Adesk::Boolean isDragging() const override { return false; }
+    double deviation(const AcGiDeviationType type, const AcGePoint3d& point) const override { return 0.0; }
+    Adesk::UInt32 numberOfIsolines() const override { return 4; }
+    AcGiContext* context() override { return nullptr; }
+    AcGiWorldGeometry& geometry() const override { return m_geometry; }
+
+    /* What was drawn: polyPolylineCalls counts the calls, polylines has
+       every polyline of every call, and of polyline(). */
+    int polyPolylineCalls = 0;
+    std::vector<Polyline> polylines;
+
+private:
+    class Geometry : public AcGiWorldGeometry
+    {
+    public:
+        explicit Geometry(StubWorldDraw& draw) : m_draw(draw) {}
+
+        void setExtents(AcGePoint3d* pNewExtents) const override {}
+        void getModelToWorldTransform(AcGeMatrix3d& matrix) const override { matrix.setToIdentity(); }
+        void getWorldToModelTransform(AcGeMatrix3d& matrix) const override { matrix.setToIdentity(); }
+        Adesk::Boolean pushModelTransform(const AcGeVector3d& normal) override { return true; }
+        Adesk::Boolean pushModelTransform(const AcGeMatrix3d& matrix) override { return true; }
+        Adesk::Boolean popModelTransform() override { return true; }
+        AcGeMatrix3d pushPositionTransform(AcGiPositionTransformBehavior behavior, const AcGePoint3d& offset) override
+        {
+            return AcGeMatrix3d();
+        }
+        AcGeMatrix3d pushPositionTransform(AcGiPositionTransformBehavior behavior, const AcGePoint2d& offset) override
+        {
+            return AcGeMatrix3d();
+        }
+        AcGeMatrix3d pushScaleTransform(AcGiScaleTransformBehavior behavior, const AcGePoint3d& extents) override
+        {
+            return AcGeMatrix3d();
+        }
+        AcGeMatrix3d pushScaleTransform(AcGiScaleTransformBehavior behavior, const AcGePoint2d& extents) override
+        {
+            return AcGeMatrix3d();
+        }
+        AcGeMatrix3d pushOrientationTransform(AcGiOrientationTransformBehavior behavior) override
+        {
+            return AcGeMatrix3d();
+        }
+
+        Adesk::Boolean circle(const AcGePoint3d& center, const double radius, const AcGeVector3d& normal) const override
+        {
+            return false;
+        }
+        Adesk::Boolean circle(const AcGePoint3d& first, const AcGePoint3d& second,
+                              const AcGePoint3d& third) const override
+        {
+            return false;
+        }
+        Adesk::Boolean circularArc(const AcGePoint3d& center, const double radius, const AcGeVector3d& normal,
+                                   const AcGeVector3d& startVector, const double sweepAngle,
+                                   const AcGiArcType arcType = kAcGiArcSimple) const override
+        {
+            return false;
+        }
+        Adesk::Boolean circularArc(const AcGePoint3d& start, const AcGePoint3d& point, const AcGePoint3d& end,
+                                   const AcGiArcType arcType = kAcGiArcSimple) const override
+        {
+            return false;
+        }
+        Adesk::Boolean polyline(const Adesk::UInt32 nbPoints, const AcGePoint3d* pVertexList,
+                                const AcGeVector3d* pNormal = nullptr,
+                                Adesk::LongPtr lBaseSubEntMarker = -1) const override
+        {
+            record(nbPoints, pVertexList);
+            return false;
+        }
+        Adesk::Boolean polyline(const AcGiPolyline& polylineObj) const override
+        {
+            record(polylineObj.points(), polylineObj.vertexList());
+            return false;
+        }
+        Adesk::Boolean polyPolyline(Adesk::UInt32 nbPolylines, const AcGiPolyline* pPolylines) const override
+        {
+            ++m_draw.polyPolylineCalls;
+            for (Adesk::UInt32 i = 0; i < nbPolylines; ++i)
+                record(pPolylines[i].points(), pPolylines[i].vertexList());
+            return false;
+        }
+        Adesk::Boolean polygon(const Adesk::UInt32 nbPoints, const AcGePoint3d* pVertexList) const override
+        {
+            return false;
+        }
+        Adesk::Boolean polyPolygon(const Adesk::UInt32 numPolygonIndices, const Adesk::UInt32* numPolygonPositions,
+                                   const AcGePoint3d* polygonPositions, const Adesk::UInt32* numPolygonPoints,
+                                   const AcGePoint3d* polygonPoints, const AcCmEntityColor* outlineColors = nullptr,
+                                   const AcGiLineType* outlineTypes = nullptr,
+                                   const AcCmEntityColor* fillColors = nullptr,
+                                   const AcCmTransparency* fillOpacities = nullptr) const override
+        {
+            return false;
+        }
+        Adesk::Boolean mesh(const Adesk::UInt32 rows, const Adesk::UInt32 columns, const AcGePoint3d* pVertexList,
+                            const AcGiEdgeData* pEdgeData = nullptr, const AcGiFaceData* pFaceData = nullptr,
+                            const AcGiVertexData* pVertexData = nullptr,
+                            const bool bAutoGenerateNormals = true) const override
+        {
+            return false;
+        }
+        Adesk::Boolean shell(const Adesk::UInt32 nbVertex, const AcGePoint3d* pVertexList,
+                             const Adesk::UInt32 faceListSize, const Adesk::Int32* pFaceList,
+                             const AcGiEdgeData* pEdgeData = nullptr, const AcGiFaceData* pFaceData = nullptr,
+                             const AcGiVertexData* pVertexData = nullptr, const struct resbuf* pResBuf = nullptr,
+                             const bool bAutoGenerateNormals = true) const override
+        {
+            return false;
+        }
+        Adesk::Boolean text(const AcGePoint3d& position, const AcGeVector3d& normal, const AcGeVector3d& direction,
+                            const double height, const double width, const double oblique,
+                            const ACHAR* pMsg) const override
+        {
+            return false;
+        }
+        Adesk::Boolean text(const AcGePoint3d& position, const AcGeVector3d& normal, const AcGeVector3d& direction,
+                            const ACHAR* pMsg, const Adesk::Int32 length, const Adesk::Boolean raw,
+                            const AcGiTextStyle& textStyle) const override
+        {
+            return false;
+        }
+        Adesk::Boolean xline(const AcGePoint3d& first, const AcGePoint3d& second) const override { return false; }
+        Adesk::Boolean ray(const AcGePoint3d& origin, const AcGePoint3d& through) const override { return false; }
+        Adesk::Boolean pline(const AcDbPolyline& lwBuf, Adesk::UInt32 fromIndex = 0,
+                             Adesk::UInt32 numSegs = 0) const override
+        {
+            return false;
+        }
+        Adesk::Boolean draw(AcGiDrawable* pDrawable) const override { return false; }
+        Adesk::Boolean image(const AcGiImageBGRA32& imageSource, const AcGePoint3d& position, const AcGeVector3d& u,
+                             const AcGeVector3d& v, TransparencyMode transparencyMode = kTransparency8Bit) const override
+        {
+            return false;
+        }
+        Adesk::Boolean rowOfDots(int count, const AcGePoint3d& start, const AcGeVector3d& step) const override
+        {
+            return false;
+        }
+        Adesk::Boolean ellipticalArc(const AcGePoint3d& center, const AcGeVector3d& normal, double majorAxisLength,
+                                     double minorAxisLength, double startDegreeInRads, double endDegreeInRads,
+                                     double tiltDegreeInRads, AcGiArcType arcType = kAcGiArcSimple) const override
+        {
+            return false;
+        }
+        Adesk::Boolean pushClipBoundary(AcGiClipBoundary* pBoundary) override { return true; }
+        void popClipBoundary() override {}
+        Adesk::Boolean edge(const AcArray<AcGeCurve2d*>& edges) const override { return false; }
+
+    private:
+        void record(Adesk::UInt32 count, const AcGePoint3d* pPoints) const
+        {
+            m_draw.polylines.push_back({std::vector<AcGePoint3d>(pPoints, pPoints + count),
+                                        m_draw.m_traits.lineTypeId()});
+        }
+
+        StubWorldDraw& m_draw;
+    };
+
+    mutable StubSubEntityTraits m_traits;
+    mutable Geometry m_geometry;
+};
+
+/// <summary>
+/// A drawable that is the object stubId stands for.
+/// </summary>
+class StubDrawable : public AcGiDrawable
+{
+public:
+    AcDbObjectId id() const override { return stubId; }
+
+    AcDbObjectId stubId;
+};
+
+/// <summary>
+/// A write stream that keeps what is written to it in stubBytes, and
+/// fails every write once stubFailAfter bytes are in.
+/// </summary>
+class StubWriteStream : public IAcWriteStream
+{
+public:
+    int read(void* pDestBuf, size_t nNumBytes, size_t* pNumRead) override { return eNotSupported; }
+    int write(const void* pSrcBuf, size_t nNumBytes, size_t* pNumWritten) override
+    {
+        *pNumWritten = 0;
+        if (stubBytes.size() + nNumBytes > stubFailAfter)
+            return eDiskFull;
+        const unsigned char* pBytes = static_cast<const unsigned char*>(pSrcBuf);
+        stubBytes.insert(stubBytes.end(), pBytes, pBytes + nNumBytes);
+        *pNumWritten = nNumBytes;
+        return eOk;
+    }
+
+    std::vector<unsigned char> stubBytes;
+    size_t stubFailAfter = size_t(-1);
+};
+
+} // namespace tests
+} // namespace acad_sheetset_to_pdf
@@ -0,0 +1,114 @@
+#pragma once
+
+/*
+ * What every test program shares.  CHECK records a failure and carries on,
+ * so one run reports every broken expectation; main ends with
+ * return finish().  A program started with --benchmark also runs its timed
+ * workloads, which print one line per measurement; sizes can follow on the
+ * command line to make them larger than the quick defaults.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+namespace acad_sheetset_to_pdf {
+namespace tests {
+
+inline int& failureCount()
+{
+    static int s_failures = 0;
+    return s_failures;
+}
+
+inline void fail(const char* file, int line, const char* condition)
+{
+    std::printf("FAILED %s:%d: %s\n", file, line, condition);
+    std::fflush(stdout);
+    ++failureCount();
+}
+
+/// <summary>
+/// Reports the outcome of the program and returns its exit code.
+/// </summary>
+inline int finish()
+{
+    if (failureCount() != 0)
+        std::printf("%d check(s) failed\n", failureCount());
+    else
+        std::printf("all checks passed\n");
+    return failureCount() != 0 ? 1 : 0;
+}
+
+/// <summary>
+/// Whether the program was started with --benchmark.
+/// </summary>
+inline bool benchmarkRequested(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--benchmark") == 0)
+            return true;
+    }
+    return false;
+}
+
+/// <summary>
+/// The index-th number given on the command line after the options, or
+/// fallback.
+/// </summary>
+inline unsigned long sizeArgument(int argc, char** argv, int index, unsigned long fallback)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (argv[i][0] == '-')
+            continue;
+        if (index-- == 0)
+            return std::strtoul(argv[i], nullptr, 10);
+    }
+    return fallback;
+}
+
+/// <summary>
+/// The whole content of the file at path, or an empty string if it cannot
+/// be read.
+/// </summary>
+inline std::string readFile(const char* path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+inline bool fileExists(const char* path)
+{
+    return std::ifstream(path).good();
+}
+
+class Stopwatch
+{
+public:
+    Stopwatch() : m_start(std::chrono::steady_clock::now()) {}
+
+    void restart() { m_start = std::chrono::steady_clock::now(); }
+    double milliseconds() const
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point m_start;
+};
+
+} // namespace tests
+} // namespace acad_sheetset_to_pdf
+
+#define CHECK(condition)                                                                                          \
+    do                                                                                                            \
+    {                                                                                                             \
+        if (!(condition))                                                                                         \
+            acad_sheetset_to_pdf::tests::fail(__FILE__, __LINE__, #condition);                                    \
+    } while (0)
@@ -0,0 +1,282 @@
+#include "stdafx.h"
+#include "TextControlCodes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cwctype>
+#include <random>
+
+#include "TestSupport.h"
+
+using namespace acad_sheetset_to_pdf;
+using namespace acad_sheetset_to_pdf::tests;
+
+namespace {
+
+/// <summary>
+/// The %% codes handled in two passes, as process_uc_string and then
+/// process_underoverline do: the first expands the text and notes where
+/// each score is turned on or off, the second turns those toggles into
+/// segments and runs.
+/// </summary>
+struct TwoPassControlCodes
+{
+    TwoPassControlCodes(const std::wstring& string, bool phiForDiameter)
+    {
+        for (size_t i = 0; i < string.size();)
+        {
+            if (string.compare(i, 2, L"%%") != 0 || i + 2 >= string.size())
+            {
+                text += string[i++];
+                continue;
+            }
+            const wchar_t code = wchar_t(std::towlower(string[i + 2]));
+            if (code == L'o' || code == L'u' || code == L'k')
+            {
+                toggles.push_back({int(text.size()),
+                                   code == L'o'   ? unsigned(TextControlCodes::kOverline)
+                                   : code == L'u' ? unsigned(TextControlCodes::kUnderline)
+                                                  : unsigned(TextControlCodes::kStrikethrough)});
+                i += 3;
+            }
+            else if (code == L'd' || code == L'p' || code == L'c' || code == L'%')
+            {
+                text += code == L'd'   ? wchar_t(UC_DEGREE_SYMBOL)
+                        : code == L'p' ? wchar_t(UC_PLUSMINUS_SYMBOL)
+                        : code == L'c' ? wchar_t(phiForDiameter ? UC_PHI_SYMBOL : UC_DIAMETER_SYMBOL)
+                                       : L'%';
+                i += 3;
+            }
+            else if (i + 4 < string.size() && std::iswdigit(string[i + 2]) && std::iswdigit(string[i + 3]) &&
+                     std::iswdigit(string[i + 4]))
+            {
+                text += wchar_t(std::stoi(string.substr(i + 2, 3)));
+                i += 5;
+            }
+            else
+            {
+                text += L"%%";
+                i += 2;
+            }
+        }
+
+        const int length = int(text.size());
+        int start[3] = {};
+        unsigned on = 0;
+        for (const std::pair<int, unsigned>& toggle : toggles)
+        {
+            const int k = toggle.second == 1 ? 0 : toggle.second == 2 ? 1 : 2;
+            if ((on & toggle.second) == 0)
+                start[k] = toggle.first;
+            else if (toggle.first > start[k])
+                segments.push_back({toggle.second, start[k], toggle.first});
+            on ^= toggle.second;
+        }
+        for (int k = 0; k < 3; ++k)
+        {
+            if ((on & (1u << k)) != 0 && length > start[k])
+                segments.push_back({1u << k, start[k], length});
+        }
+
+        unsigned scores = 0;
+        size_t next = 0;
+        for (int p = 0; p < length; ++p)
+        {
+            const size_t before = next;
+            while (next < toggles.size() && toggles[next].first == p)
+                scores ^= toggles[next++].second;
+            if (!runs.empty() && runs.back().scores == scores && next == before)
+                runs.back().end = p + 1;
+            else
+                runs.push_back({p, p + 1, scores});
+        }
+    }
+
+    std::wstring text;
+    std::vector<std::pair<int, unsigned>> toggles;
+    std::vector<ScoreSegment> segments;
+    std::vector<TextRun> runs;
+};
+
+/// <summary>
+/// A TextControlBuffer over buffers of its own, as big as TextControlCodes
+/// says a string of length characters needs.
+/// </summary>
+struct OwnedControlBuffer
+{
+    explicit OwnedControlBuffer(int length)
+        : text(size_t(length) + 1), runs(size_t(TextControlCodes::runCapacity(length))),
+          segments(size_t(TextControlCodes::segmentCapacity(length)) + 1)
+    {
+        buffer.pText = text.data();
+        buffer.pRuns = runs.data();
+        buffer.runCapacity = int(runs.size());
+        buffer.pSegments = segments.data();
+        buffer.segmentCapacity = int(segments.size()) - 1;
+    }
+
+    std::vector<wchar_t> text;
+    std::vector<TextRun> runs;
+    std::vector<ScoreSegment> segments;
+    TextControlBuffer buffer;
+};
+
+/* Random strings of codes, partial codes and text expand to what the two
+   passes make of them, in place as well, and a buffer one segment short
+   says how many it needed. */
+void testSameAsTwoPasses(int trials)
+{
+    const wchar_t* const kPieces[] = {L"%%", L"%",   L"o",   L"U",    L"k",      L"d",    L"P",    L"c",
+                                      L"0",  L"6",   L"5",   L"a",    L" ",      L"%%o",  L"%%u",  L"%%k",
+                                      L"%%d", L"%%%", L"%%065", L"%%12", L"\x4e2d", L"x"};
+    std::mt19937 random(11);
+    for (int trial = 0; trial < trials; ++trial)
+    {
+        std::wstring string;
+        for (int n = int(random() % 14); n > 0; --n)
+            string += kPieces[random() % 22];
+        const bool phi = random() % 2 != 0;
+        const unsigned flags = phi ? unsigned(TextControlCodes::kPhiForDiameter) : 0;
+        const TwoPassControlCodes expected(string, phi);
+        const int length = int(string.size());
+
+        OwnedControlBuffer owned(length);
+        TextControlBuffer& buffer = owned.buffer;
+        CHECK(TextControlCodes::expand(string.c_str(), length, flags, buffer) == Acad::eOk);
+        CHECK(std::wstring(owned.text.data(), size_t(buffer.textLength)) == expected.text);
+        CHECK(buffer.segmentCount == int(expected.segments.size()));
+        CHECK(buffer.runCount == int(expected.runs.size()));
+        for (int i = 0; i < std::min(buffer.segmentCount, int(expected.segments.size())); ++i)
+        {
+            const ScoreSegment& segment = owned.segments[size_t(i)];
+            CHECK(segment.score == expected.segments[size_t(i)].score);
+            CHECK(segment.begin == expected.segments[size_t(i)].begin && segment.end == expected.segments[size_t(i)].end);
+        }
+        for (int i = 0; i < std::min(buffer.runCount, int(expected.runs.size())); ++i)
+        {
+            const TextRun& run = owned.runs[size_t(i)];
+            CHECK(run.begin == expected.runs[size_t(i)].begin && run.end == expected.runs[size_t(i)].end);
+            CHECK(run.scores == expected.runs[size_t(i)].scores);
+        }
+
+        std::wstring inPlace = string;
+        TextControlBuffer inPlaceBuffer = buffer;
+        inPlaceBuffer.pText = &inPlace[0];
+        CHECK(TextControlCodes::expand(inPlace.c_str(), length, flags, inPlaceBuffer) == Acad::eOk);
+        CHECK(inPlace.substr(0, size_t(inPlaceBuffer.textLength)) == expected.text);
+
+        if (buffer.segmentCount > 0)
+        {
+            TextControlBuffer small = buffer;
+            small.segmentCapacity = buffer.segmentCount - 1;
+            CHECK(TextControlCodes::expand(string.c_str(), length, flags, small) == Acad::eBufferTooSmall);
+            CHECK(small.segmentCount == buffer.segmentCount);
+        }
+    }
+
+    TextControlBuffer empty;
+    CHECK(TextControlCodes::expand(nullptr, 0, 0, empty) == Acad::eInvalidInput);
+}
+
+std::vector<AcGePoint3d> s_drawn;
+
+void collectSegment(const AcGePoint3d& start, const AcGePoint3d& end, const void*)
+{
+    s_drawn.push_back(start);
+    s_drawn.push_back(end);
+}
+
+void collectSegments(const AcGePoint3d* pPoints, int segmentCount, const void*)
+{
+    s_drawn.insert(s_drawn.end(), pPoints, pPoints + 2 * segmentCount);
+}
+
+/* Scores are drawn at their heights from the pen positions, rotated and
+   mirrored with the text, and the same one at a time or batched. */
+void testDrawScores()
+{
+    OwnedControlBuffer owned(64);
+    CHECK(TextControlCodes::expand(L"%%uAB%%u C%%o%%kDE", -1, 0, owned.buffer) == Acad::eOk);
+    const double pen[] = {0, 1, 2, 3, 4, 5, 6};
+    TextParams params{2.0, 1.0, 0.0, 0.0, 1.0, 0};
+
+    s_drawn.clear();
+    TextControlCodes::drawScores(owned.buffer, pen, params, collectSegment, nullptr);
+    CHECK(s_drawn.size() == 6);
+    if (s_drawn.size() == 6)
+    {
+        CHECK(s_drawn[0].x == 0 && s_drawn[1].x == 2 && std::fabs(s_drawn[0].y + 0.4) < 1e-12);
+        CHECK(s_drawn[2].x == 4 && s_drawn[3].x == 6 && std::fabs(s_drawn[2].y - 2.4) < 1e-12);
+        CHECK(std::fabs(s_drawn[4].y - 1.0) < 1e-12);
+    }
+    const std::vector<AcGePoint3d> single = s_drawn;
+    s_drawn.clear();
+    TextControlCodes::drawScores(owned.buffer, pen, params, collectSegments, nullptr);
+    CHECK(s_drawn.size() == single.size());
+    for (size_t i = 0; i < std::min(s_drawn.size(), single.size()); ++i)
+        CHECK(s_drawn[i].isEqualTo(single[i]));
+
+    params.rotation_angle = std::atan(1.0) * 2;
+    params.flags = 2;
+    s_drawn.clear();
+    TextControlCodes::drawScores(owned.buffer, pen, params, collectSegment, nullptr);
+    CHECK(s_drawn.size() == 6 && std::fabs(s_drawn[1].x - 0.4) < 1e-12 && std::fabs(s_drawn[1].y + 2) < 1e-12);
+
+    params.visible = false;
+    s_drawn.clear();
+    TextControlCodes::drawScores(owned.buffer, pen, params, collectSegment, nullptr);
+    CHECK(s_drawn.empty());
+}
+
+/* Dimension and section labels through the two passes and through
+   expand(). */
+void benchmarkExpand(unsigned long stringCount)
+{
+    std::vector<std::wstring> strings;
+    for (unsigned long n = 0; n < stringCount; ++n)
+    {
+        if (n % 3 != 0)
+        {
+            strings.push_back(L"%%uSECTION " + std::to_wstring(n % 97) + L"-" + std::to_wstring(n % 1000) +
+                              L"%%u  %%c" + std::to_wstring(n % 60) + L" %%p0.5");
+        }
+        else
+        {
+            strings.push_back(L"ELEV. +" + std::to_wstring(n % 97) + L"." + std::to_wstring(n % 1000) + L"  %%d" +
+                              std::to_wstring(n % 60));
+        }
+    }
+
+    size_t characters = 0;
+    Stopwatch watch;
+    for (const std::wstring& string : strings)
+    {
+        const TwoPassControlCodes passes(string, false);
+        characters += passes.text.size() + passes.segments.size();
+    }
+    const double twoPasses = watch.milliseconds();
+
+    OwnedControlBuffer owned(256);
+    watch.restart();
+    for (const std::wstring& string : strings)
+    {
+        TextControlCodes::expand(string.c_str(), int(string.size()), 0, owned.buffer);
+        characters -= size_t(owned.buffer.textLength + owned.buffer.segmentCount);
+    }
+    const double onePass = watch.milliseconds();
+    CHECK(characters == 0);
+    std::printf("%lu strings: two passes %.1f ms, expand %.1f ms\n", stringCount, twoPasses, onePass);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    testSameAsTwoPasses(100000);
+    testDrawScores();
+
+    if (benchmarkRequested(argc, argv))
+        benchmarkExpand(sizeArgument(argc, argv, 0, 200000));
+
+    return finish();
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+/*
+ * The SDK's point cloud interfaces.  The SDK gives the pure virtual
+ * destructors inline bodies, which only MSVC accepts, so they are plain
+ * virtual destructors here.
+ */
+
+class IAcDbPointCloudDataBuffer
+{
+public:
+    enum DataType
+    {
+        kIntensity = 0x00000001,
+        kClassification = 0x00000002,
+        kColor = 0x00000004,
+        kNormal = 0x00000008,
+    };
+
+    typedef Adesk::UInt8 RGBA[4];
+
+    virtual ~IAcDbPointCloudDataBuffer() {}
+
+    virtual Adesk::UInt64 numPoints() const = 0;
+    virtual const AcGePoint3d* points() const = 0;
+    virtual const AcGeVector3d* normals() const = 0;
+    virtual const RGBA* colors() const = 0;
+    virtual const Adesk::UInt8* intensity() const = 0;
+    virtual const Adesk::UInt8* classifications() const = 0;
+    virtual const AcGeMatrix3d& transform() const = 0;
+    virtual void freeObject() = 0;
+    virtual void* getBuffer() const = 0;
+};
+
+class IAcDbPointCloudSpatialFilter
+{
+public:
+    enum FilterResult
+    {
+        FILTER_INSIDE = 0,
+        FILTER_OUTSIDE,
+        FILTER_INTERSECTS
+    };
+
+    virtual ~IAcDbPointCloudSpatialFilter() {}
+
+    virtual FilterResult testCell(const AcGePoint3d& min, const AcGePoint3d& max) const = 0;
+    virtual FilterResult testPoint(const AcGePoint3d& point) const = 0;
+    virtual IAcDbPointCloudSpatialFilter* transformFilter(const AcGeMatrix3d& mat) const = 0;
+    virtual IAcDbPointCloudSpatialFilter* clone() const = 0;
+    virtual void freeObject() = 0;
+};
+
+class IAcDbPointCloudAttributeFilter
+{
+public:
+    virtual ~IAcDbPointCloudAttributeFilter() {}
+
+    virtual bool testPoint(const Adesk::UInt8 rgba[4], Adesk::UInt8 intensity, const float normal[3],
+                           Adesk::UInt8 classification) const = 0;
+    virtual IAcDbPointCloudAttributeFilter* clone() const = 0;
+    virtual IAcDbPointCloudAttributeFilter* transformFilter(const AcGeMatrix3d& mat) const = 0;
+    virtual void freeObject() = 0;
+};
+
+class IAcDbPointCloudPointProcessor
+{
+public:
+    enum ProcessSate
+    {
+        Abort,
+        Continue
+    };
+
+    virtual ~IAcDbPointCloudPointProcessor() {}
+
+    virtual ProcessSate process(const IAcDbPointCloudDataBuffer* buffer) = 0;
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+/*
+ * AcPointCloudExtractedCylinder with the SDK's members, holding its values
+ * directly instead of behind the SDK's private implementation.
+ */
+
+class ACDB_PORT AcPointCloudExtractedCylinder
+{
+public:
+    AcPointCloudExtractedCylinder() {}
+    AcPointCloudExtractedCylinder(double radius, double height, AcGeVector3d axis = AcGeVector3d::kZAxis,
+                                  AcGePoint3d origin = AcGePoint3d::kOrigin)
+        : m_axis(axis), m_origin(origin), m_height(height), m_radius(radius)
+    {
+    }
+    virtual ~AcPointCloudExtractedCylinder() {}
+
+    bool isValid() const { return m_radius > 0; }
+    void clear() { *this = AcPointCloudExtractedCylinder(); }
+
+    AcGeVector3d getAxis() const { return m_axis; }
+    void setAxis(AcGeVector3d axis) { m_axis = axis; }
+    AcGePoint3d getOrigin() const { return m_origin; }
+    void setOrigin(AcGePoint3d origin) { m_origin = origin; }
+    double getHeight() const { return m_height; }
+    void setHeight(double height) { m_height = height; }
+    double getRadius() const { return m_radius; }
+    void setRadius(double radius) { m_radius = radius; }
+
+private:
+    AcGeVector3d m_axis = AcGeVector3d::kZAxis;
+    AcGePoint3d m_origin;
+    double m_height = 0;
+    double m_radius = 0;
+};
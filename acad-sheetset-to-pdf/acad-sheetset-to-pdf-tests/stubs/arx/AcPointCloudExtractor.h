@@ -0,0 +1,55 @@
+#pragma once
+
+/*
+ * The SDK's AcPointCloudExtractor.h without its AcDbPointCloudEx.h include,
+ * which drags in the whole database.  The profile curve types are the SDK's
+ * own; AcPointCloudExtractor itself is declared but not defined, since the
+ * modules only name it in comments.
+ */
+
+#include "../../../objectarx-for-autocad-2025-win-64bit/inc/AcPointCloudExtractProfileCurve.h"
+
+class AcDbPointCloudEx;
+
+class ACDB_PORT ExtractOption
+{
+public:
+    enum ExtractionType
+    {
+        kOutLine,
+        kAllLine,
+    };
+
+public:
+    ExtractionType m_extractionType;
+    unsigned int m_processPoints;
+    double m_fillGap;
+    unsigned int m_snapAngle;
+    double m_minSegLength;
+    bool m_useLineSegmentOnly;
+
+    ExtractOption();
+};
+
+class ACDB_PORT IPointCloudExtracProgressCallback
+{
+public:
+    IPointCloudExtracProgressCallback(void) {}
+    virtual ~IPointCloudExtracProgressCallback(void) {}
+
+    virtual void updateProgress(int progress) = 0;
+    virtual void updateCaption(const AcString& caption) = 0;
+    virtual bool cancelled() const = 0;
+    virtual void cancel() = 0;
+    virtual void updateRemainTime(double remainTime) = 0;
+    virtual void end() = 0;
+};
+
+class ACDB_PORT AcPointCloudExtractor
+{
+public:
+    static Acad::ErrorStatus extract(AcDbPointCloudEx* pointCloud, const AcGeVector3d& planeZDirection,
+                                     const AcGeVector3d& planeXDirection, AcGePoint3d pointPlane,
+                                     const ExtractOption& extractOption, AcPointCloudExtractResult& outlineResult,
+                                     IPointCloudExtracProgressCallback* progress = 0);
+};
@@ -0,0 +1,8 @@
+#pragma once
+
+/*
+ * The SDK's stream interfaces need nothing from AutoCAD, so the real header
+ * is used as it is.
+ */
+
+#include "../../../objectarx-for-autocad-2025-win-64bit/inc/IAcReadWriteStream.h"
@@ -0,0 +1,450 @@
+/*
+ * The out-of-line parts of the ObjectARX stand-ins: constants, the editor,
+ * documents, the plot reactor manager, filer helpers and draw stream
+ * building.
+ */
+
+#include <windows.h>
+
+#include "arxHeaders.h"
+#include "AcPointCloudExtractor.h"
+#include "acgidrawstream.h"
+#include "linetypeengine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cwchar>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+/* AcGe -------------------------------------------------------------------- */
+
+AcGeTol AcGeContext::gTol;
+const AcGeVector2d AcGeVector2d::kXAxis(1, 0);
+const AcGePoint2d AcGePoint2d::kOrigin(0, 0);
+const AcGeVector3d AcGeVector3d::kXAxis(1, 0, 0);
+const AcGeVector3d AcGeVector3d::kYAxis(0, 1, 0);
+const AcGeVector3d AcGeVector3d::kZAxis(0, 0, 1);
+const AcGePoint3d AcGePoint3d::kOrigin(0, 0, 0);
+const AcGeMatrix3d AcGeMatrix3d::kIdentity;
+
+/* Runtime ----------------------------------------------------------------- */
+
+HINSTANCE _hdllInstance = nullptr;
+
+const AcDbObjectId AcDbObjectId::kNull;
+
+const ACHAR* acadErrorStatusText(Acad::ErrorStatus es)
+{
+#define ARX_STUBS_STATUS(name)                                                                                   \
+    case Acad::name:                                                                                             \
+        return ACRX_T(#name);
+
+    switch (es)
+    {
+        ARX_STUBS_STATUS(eOk)
+        ARX_STUBS_STATUS(eNotImplemented)
+        ARX_STUBS_STATUS(eNotApplicable)
+        ARX_STUBS_STATUS(eInvalidInput)
+        ARX_STUBS_STATUS(eOutOfMemory)
+        ARX_STUBS_STATUS(eBufferTooSmall)
+        ARX_STUBS_STATUS(eKeyNotFound)
+        ARX_STUBS_STATUS(eDuplicateKey)
+        ARX_STUBS_STATUS(eInvalidIndex)
+        ARX_STUBS_STATUS(eInvalidExtents)
+        ARX_STUBS_STATUS(eWrongObjectType)
+        ARX_STUBS_STATUS(eInvalidDwgVersion)
+        ARX_STUBS_STATUS(eEndOfFile)
+        ARX_STUBS_STATUS(eFileAccessErr)
+        ARX_STUBS_STATUS(eFileSystemErr)
+        ARX_STUBS_STATUS(eFileNotFound)
+        ARX_STUBS_STATUS(eOutOfRange)
+        ARX_STUBS_STATUS(eUserBreak)
+        ARX_STUBS_STATUS(eNullPtr)
+        ARX_STUBS_STATUS(eNullObjectPointer)
+        ARX_STUBS_STATUS(eInvalidPlotInfo)
+        ARX_STUBS_STATUS(eUnsupportedFileFormat)
+        ARX_STUBS_STATUS(eFileSharingViolation)
+        ARX_STUBS_STATUS(eNotHandled)
+        ARX_STUBS_STATUS(eDataTooLarge)
+        ARX_STUBS_STATUS(eAlreadyActive)
+        ARX_STUBS_STATUS(eNotInitializedYet)
+        ARX_STUBS_STATUS(eInvalidContext)
+        ARX_STUBS_STATUS(eStringTooLong)
+        ARX_STUBS_STATUS(eDeviceNotFound)
+        ARX_STUBS_STATUS(eNotOpenForRead)
+        ARX_STUBS_STATUS(eNotOpenForWrite)
+        ARX_STUBS_STATUS(eMakeMeProxy)
+        ARX_STUBS_STATUS(eIsWriting)
+        ARX_STUBS_STATUS(eWasErased)
+        ARX_STUBS_STATUS(eDwgObjectImproperlyRead)
+        ARX_STUBS_STATUS(eBadDxfSequence)
+        ARX_STUBS_STATUS(eInetFileGenericError)
+        ARX_STUBS_STATUS(eDwgCRCDoesNotMatch)
+        ARX_STUBS_STATUS(eInvalidEngineState)
+        ARX_STUBS_STATUS(ePlotCancelled)
+        ARX_STUBS_STATUS(ePageCancelled)
+        ARX_STUBS_STATUS(eFileInternalErr)
+    }
+    return ACRX_T("eError");
+
+#undef ARX_STUBS_STATUS
+}
+
+bool acrxServiceIsRegistered(const ACHAR* serviceName)
+{
+    return false;
+}
+
+int acrxLoadModule(const ACHAR* moduleName, bool printit, bool asCmd)
+{
+    return 0;
+}
+
+namespace {
+
+/* Function statics, since the module registers from its own statics. */
+AcRxArxApp*& registeredApplication()
+{
+    static AcRxArxApp* s_pApp = nullptr;
+    return s_pApp;
+}
+
+std::vector<const _ARXCOMMAND_ENTRY*>& registeredCommands()
+{
+    static std::vector<const _ARXCOMMAND_ENTRY*> s_commands;
+    return s_commands;
+}
+
+} // namespace
+
+void arx_stubs::registerApplication(AcRxArxApp* pApp)
+{
+    registeredApplication() = pApp;
+}
+
+void arx_stubs::registerCommand(const _ARXCOMMAND_ENTRY* pCommand)
+{
+    registeredCommands().push_back(pCommand);
+}
+
+bool arx_stubs::sendAppMessage(AcRx::AppMsgCode message)
+{
+    AcRxArxApp* pApp = registeredApplication();
+    if (pApp == nullptr)
+        return false;
+    if (message == AcRx::kInitAppMsg)
+        pApp->On_kInitAppMsg(nullptr);
+    else
+        pApp->On_kUnloadAppMsg(nullptr);
+    return true;
+}
+
+bool arx_stubs::runCommand(const ACHAR* globalName)
+{
+    for (const _ARXCOMMAND_ENTRY* pCommand : registeredCommands())
+    {
+        if (std::wcscmp(pCommand->globalName, globalName) == 0)
+        {
+            pCommand->function();
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace {
+
+std::mutex s_editorMutex;
+std::deque<std::wstring> s_editorInput;
+
+/// <summary>
+/// The format as the C library reads it: a plain %s or %c in a Windows wide
+/// format is a wide string or character, which here needs the l modifier.
+/// </summary>
+std::wstring toPosixFormat(const wchar_t* format)
+{
+    std::wstring result;
+    for (const wchar_t* p = format; *p != L'\0'; ++p)
+    {
+        result += *p;
+        if (*p != L'%')
+            continue;
+        if (p[1] == L'%')
+        {
+            result += *++p;
+            continue;
+        }
+
+        bool sized = false;
+        while (p[1] != L'\0' && std::wcschr(L"-+ #0123456789.*hlLjzt", p[1]) != nullptr)
+        {
+            sized = sized || std::wcschr(L"hlLjzt", p[1]) != nullptr;
+            result += *++p;
+        }
+        if (!sized && (p[1] == L's' || p[1] == L'c'))
+            result += L'l';
+    }
+    return result;
+}
+
+} // namespace
+
+AcString& AcString::format(const wchar_t* format, ...)
+{
+    wchar_t buffer[4096];
+    va_list arguments;
+    va_start(arguments, format);
+    const int length = std::vswprintf(buffer, 4096, toPosixFormat(format).c_str(), arguments);
+    va_end(arguments);
+    m_string = length >= 0 ? buffer : L"";
+    return *this;
+}
+
+int acutPrintf(const ACHAR* format, ...)
+{
+    va_list arguments;
+    va_start(arguments, format);
+    wchar_t buffer[4096];
+    const int length = std::vswprintf(buffer, 4096, toPosixFormat(format).c_str(), arguments);
+    va_end(arguments);
+    if (length < 0)
+        return 0;
+
+    const int size = WideCharToMultiByte(CP_UTF8, 0, buffer, length, nullptr, 0, nullptr, nullptr);
+    std::string text(static_cast<size_t>(size), '\0');
+    WideCharToMultiByte(CP_UTF8, 0, buffer, length, &text[0], size, nullptr, nullptr);
+    std::fputs(text.c_str(), stdout);
+    return length;
+}
+
+int acedGetString(int cronly, const ACHAR* prompt, AcString& result)
+{
+    std::lock_guard<std::mutex> lock(s_editorMutex);
+    if (s_editorInput.empty())
+        return RTCAN;
+    result = s_editorInput.front().c_str();
+    s_editorInput.pop_front();
+    return RTNORM;
+}
+
+void arx_stubs::queueEditorInput(const ACHAR* answer)
+{
+    std::lock_guard<std::mutex> lock(s_editorMutex);
+    s_editorInput.emplace_back(answer);
+}
+
+/* AcDb -------------------------------------------------------------------- */
+
+AcDbHostApplicationServices* acdbHostApplicationServices()
+{
+    static AcDbHostApplicationServices s_services;
+    return &s_services;
+}
+
+/// <summary>
+/// The type AutoCAD stores each group code range as.
+/// </summary>
+AcDb::DwgDataType acdbGroupCodeToType(AcDb::DxfCode code)
+{
+    const int c = code;
+    if (c >= 10 && c < 40)
+        return AcDb::kDwg3Real;
+    if (c >= 40 && c < 60)
+        return AcDb::kDwgReal;
+    if (c >= 60 && c < 90)
+        return AcDb::kDwgInt16;
+    if (c >= 90 && c < 100)
+        return AcDb::kDwgInt32;
+    if (c >= 160 && c < 170)
+        return AcDb::kDwgInt64;
+    if (c >= 280 && c < 300)
+        return AcDb::kDwgInt8;
+    if (c >= 310 && c < 320)
+        return AcDb::kDwgBChunk;
+    if (c >= 330 && c < 340)
+        return AcDb::kDwgSoftPointerId;
+    if (c >= 360 && c < 370)
+        return AcDb::kDwgHardOwnershipId;
+    if (c == 5 || c == 105)
+        return AcDb::kDwgHandle;
+    if ((c >= 0 && c < 10) || c == 100 || c == 101 || c == 1000 || c == 1001)
+        return AcDb::kDwgText;
+    return AcDb::kDwgNotRecognized;
+}
+
+/// <summary>
+/// An ads_name is the id's old id, tagged so a test can tell it was made
+/// here.
+/// </summary>
+Acad::ErrorStatus acdbGetAdsName(ads_name& name, AcDbObjectId id)
+{
+    name[0] = id.asOldId();
+    name[1] = 7;
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus acdbGetObjectId(AcDbObjectId& id, const ads_name name)
+{
+    id.setFromOldId(static_cast<Adesk::IntPtr>(name[0]));
+    return Acad::eOk;
+}
+
+Acad::ErrorStatus acdbGetHostDwgXrefGraph(AcDbDatabase* pHostDb, AcDbXrefGraph& graph, Adesk::Boolean)
+{
+    if (pHostDb == nullptr)
+        return Acad::eNullObjectPointer;
+    graph.stubNodes.assign(1, AcDbXrefGraphNode());
+    graph.stubNodes[0].pStubDatabase = pHostDb;
+    graph.stubNodes[0].stubStatus = AcDb::kXrfNotAnXref;
+    graph.stubNodes.insert(graph.stubNodes.end(), pHostDb->stubXrefs.begin(), pHostDb->stubXrefs.end());
+    return Acad::eOk;
+}
+
+/* Documents --------------------------------------------------------------- */
+
+namespace {
+
+std::vector<AcApDocument*> s_documents;
+AcApDocument* s_pCurDocument = nullptr;
+
+} // namespace
+
+AcApDocument* AcApDocManager::curDocument() const
+{
+    return s_pCurDocument;
+}
+
+AcApDocument* AcApDocManager::document(const AcDbDatabase* pDb) const
+{
+    for (AcApDocument* pDocument : s_documents)
+    {
+        if (pDocument->database() == pDb)
+            return pDocument;
+    }
+    return nullptr;
+}
+
+AcApDocManager* acDocManagerPtr()
+{
+    static AcApDocManager s_manager;
+    return &s_manager;
+}
+
+int acedGetVar(const ACHAR* sym, resbuf* result)
+{
+    if (s_pCurDocument == nullptr || std::wcscmp(sym, L"DBMOD") != 0)
+        return RTERROR;
+    result->rbnext = nullptr;
+    result->restype = RTSHORT;
+    result->resval.rint = s_pCurDocument->stubDbmod;
+    return RTNORM;
+}
+
+void arx_stubs::openDocument(AcApDocument* pDocument, bool current)
+{
+    s_documents.push_back(pDocument);
+    if (current)
+        s_pCurDocument = pDocument;
+}
+
+void arx_stubs::closeDocument(AcApDocument* pDocument)
+{
+    s_documents.erase(std::remove(s_documents.begin(), s_documents.end(), pDocument), s_documents.end());
+    if (s_pCurDocument == pDocument)
+        s_pCurDocument = nullptr;
+}
+
+/* AcPl -------------------------------------------------------------------- */
+
+void AcPlPlotReactorMgr::addReactor(AcPlPlotReactor* pReactor)
+{
+    reactors.push_back(pReactor);
+}
+
+void AcPlPlotReactorMgr::removeReactor(AcPlPlotReactor* pReactor)
+{
+    reactors.erase(std::remove(reactors.begin(), reactors.end(), pReactor), reactors.end());
+}
+
+AcPlPlotReactorMgr* acplPlotReactorMgrPtr()
+{
+    static AcPlPlotReactorMgr s_manager;
+    return &s_manager;
+}
+
+/* AcGi -------------------------------------------------------------------- */
+
+int AcGiLinetypeEngine::stubBaseCalls = 0;
+
+ExtractOption::ExtractOption()
+    : m_extractionType(kAllLine), m_processPoints(1000000), m_fillGap(0.01), m_snapAngle(0), m_minSegLength(0),
+      m_useLineSegmentOnly(false)
+{
+}
+
+arx_stubs::DrawStreamBuilder arx_stubs::drawStreamBuilder = &arx_stubs::buildDrawStreams;
+
+bool acdbBeginDrawStreamBuilding(AcGiDrawStream* pStream)
+{
+    if (pStream == nullptr || pStream->stubBuilding)
+        return false;
+    pStream->stubBuilding = true;
+    return true;
+}
+
+void acdbEndDrawStreamBuilding(AcGiDrawStream* pStream)
+{
+    if (pStream != nullptr)
+        pStream->stubBuilding = false;
+}
+
+bool AcGiDrawStream::build(const AcArray<AcGiDrawStream*>& streamArray, GraphicsUpdateProc lpFunc)
+{
+    return arx_stubs::drawStreamBuilder(streamArray, lpFunc);
+}
+
+bool arx_stubs::buildDrawStreams(const AcArray<AcGiDrawStream*>& streamArray, GraphicsUpdateProc lpFunc)
+{
+    bool built = true;
+    for (AcGiDrawStream* pStream : streamArray)
+    {
+        if (pStream == nullptr)
+            continue;
+        if (!pStream->stubBuilding)
+            built = false;
+
+        /* Regenerating a drawable costs time in proportion to what it draws. */
+        double sum = 0;
+        for (unsigned k = 0; k < pStream->stubWork; ++k)
+            sum += std::sqrt(static_cast<double>(k) + pStream->stubWork);
+        pStream->stubGraphics.assign(16 + pStream->stubWork % 64,
+                                     static_cast<unsigned char>(pStream->stubWork * 31 + (sum > 0 ? 1 : 0)));
+    }
+    if (lpFunc != nullptr)
+        lpFunc(AcArray<AcGiDrawable*>());
+    return built;
+}
+
+bool AcGiDrawStream::serializeOut(IAcWriteStream* pOutput) const
+{
+    size_t written = 0;
+    return pOutput->write(stubGraphics.data(), stubGraphics.size(), &written) == IAcWriteStream::eOk &&
+           written == stubGraphics.size();
+}
+
+bool AcGiDrawStream::serializeIn(IAcReadStream* pInput, AcDbDatabase* pDb)
+{
+    stubGraphics.clear();
+    unsigned char buffer[4096];
+    size_t read = 0;
+    int status = IAcReadStream::eOk;
+    do
+    {
+        status = pInput->read(buffer, sizeof(buffer), &read);
+        stubGraphics.insert(stubGraphics.end(), buffer, buffer + read);
+    } while (status == IAcReadStream::eOk && read == sizeof(buffer));
+    return !stubGraphics.empty();
+}
@@ -0,0 +1,736 @@
+#pragma once
+
+/*
+ * Stand-ins for the AcDb classes the modules use.  There is no database:
+ * an object id carries its handle, its database and the object it stands
+ * for as plain values the tests set, and opening an id yields that object.
+ */
+
+#include <memory>
+
+namespace AcDb {
+
+enum OpenMode
+{
+    kForRead,
+    kForWrite,
+    kForNotify
+};
+
+enum LineWeight
+{
+    kLnWtByLayer = -1
+};
+
+enum FilerType
+{
+    kFileFiler = 0,
+    kCopyFiler = 1,
+    kUndoFiler = 2,
+    kBagFiler = 3,
+    kIdXlateFiler = 4,
+    kPageFiler = 5,
+    kDeepCloneFiler = 6,
+    kIdFiler = 7,
+    kPurgeFiler = 8,
+    kWblockCloneFiler = 9
+};
+
+enum FilerSeekType
+{
+    kSeekFromStart = 0,
+    kSeekFromCurrent = 1,
+    kSeekFromEnd = 2
+};
+
+enum DwgDataType
+{
+    kDwgNull = 0,
+    kDwgReal = 1,
+    kDwgInt32 = 2,
+    kDwgInt16 = 3,
+    kDwgInt8 = 4,
+    kDwgText = 5,
+    kDwgBChunk = 6,
+    kDwgHandle = 7,
+    kDwgHardOwnershipId = 8,
+    kDwgSoftOwnershipId = 9,
+    kDwgHardPointerId = 10,
+    kDwgSoftPointerId = 11,
+    kDwg3Real = 12,
+    kDwgInt64 = 13,
+    kDwgNotRecognized = 19
+};
+
+enum DxfCode
+{
+    kDxfXDataStart = -3,
+    kDxfStart = 0,
+    kDxfText = 1,
+    kDxfHandle = 5,
+    kDxfXCoord = 10,
+    kDxfReal = 40,
+    kDxfInt16 = 70,
+    kDxfInt32 = 90,
+    kDxfSubclass = 100,
+    kDxfEmbeddedObjectStart = 101,
+    kDxfInt64 = 160,
+    kDxfInt8 = 280,
+    kDxfBool = 290,
+    kDxfBinaryChunk = 310,
+    kDxfSoftPointerId = 330,
+    kDxfHardOwnershipId = 360,
+    kDxfXdAsciiString = 1000,
+    kDxfRegAppName = 1001,
+    kDxfXdInteger32 = 1071
+};
+
+enum XrefStatus
+{
+    kXrfNotAnXref = 0,
+    kXrfResolved = 1,
+    kXrfUnloaded = 2,
+    kXrfUnreferenced = 3,
+    kXrfFileNotFound = 4,
+    kXrfUnresolved = 5
+};
+
+enum XrefNotificationStatus
+{
+    kXrfNotifyNone = 0,
+    kXrfNotifyResolvedMatch = 1,
+    kXrfNotifyResolvedElsewhere = 2,
+    kXrfNotifyResolvedWithUpdate = 3,
+    kXrfNotifyResolvedUpdateAvailable = 4
+};
+
+} // namespace AcDb
+
+class AcDbDatabase;
+
+class AcDbHandle
+{
+public:
+    AcDbHandle() : m_value(0) {}
+    AcDbHandle(Adesk::UInt64 value) : m_value(value) {}
+    AcDbHandle(const wchar_t* hex) : m_value(hex != nullptr ? wcstoull(hex, nullptr, 16) : 0) {}
+
+    operator Adesk::UInt64() const { return m_value; }
+    Adesk::UInt32 low() const { return static_cast<Adesk::UInt32>(m_value); }
+    Adesk::UInt32 high() const { return static_cast<Adesk::UInt32>(m_value >> 32); }
+
+    bool getIntoAsciiBuffer(wchar_t* buffer, size_t size) const
+    {
+        swprintf(buffer, size, L"%llX", static_cast<unsigned long long>(m_value));
+        return true;
+    }
+
+private:
+    Adesk::UInt64 m_value;
+};
+
+class AcDbObjectId
+{
+public:
+    AcDbObjectId() {}
+
+    bool isNull() const { return stubHandle == 0; }
+    AcDbHandle handle() const { return AcDbHandle(stubHandle); }
+    AcDbDatabase* database() const { return pStubDatabase; }
+
+    Adesk::IntPtr asOldId() const { return static_cast<Adesk::IntPtr>(stubHandle); }
+    AcDbObjectId& setFromOldId(Adesk::IntPtr oldId)
+    {
+        stubHandle = static_cast<Adesk::UInt64>(oldId);
+        return *this;
+    }
+
+    bool operator==(const AcDbObjectId& other) const
+    {
+        return stubHandle == other.stubHandle && pStubDatabase == other.pStubDatabase;
+    }
+    bool operator!=(const AcDbObjectId& other) const { return !(*this == other); }
+    bool operator<(const AcDbObjectId& other) const { return stubHandle < other.stubHandle; }
+
+    static const AcDbObjectId kNull;
+
+    /* What the id stands for, set by the tests. */
+    Adesk::UInt64 stubHandle = 0;
+    AcDbDatabase* pStubDatabase = nullptr;
+    void* pStubObject = nullptr;
+};
+
+typedef AcArray<AcDbObjectId> AcDbObjectIdArray;
+
+class AcDbHardOwnershipId : public AcDbObjectId
+{
+};
+class AcDbSoftOwnershipId : public AcDbObjectId
+{
+};
+class AcDbHardPointerId : public AcDbObjectId
+{
+};
+class AcDbSoftPointerId : public AcDbObjectId
+{
+};
+
+class AcCmColor
+{
+public:
+    AcCmColor() {}
+
+    bool operator==(const AcCmColor&) const { return true; }
+};
+
+class AcCmEntityColor
+{
+public:
+    int color = 0;
+};
+
+class AcCmTransparency;
+
+/// <summary>
+/// Opens the object the id stands for; an id that stands for none fails to
+/// open.
+/// </summary>
+template <class T>
+class AcDbObjectPointer
+{
+public:
+    AcDbObjectPointer(AcDbObjectId id, AcDb::OpenMode) : m_pObject(static_cast<T*>(id.pStubObject)) {}
+
+    Acad::ErrorStatus openStatus() const { return m_pObject != nullptr ? Acad::eOk : Acad::eNullObjectPointer; }
+    T* operator->() const { return m_pObject; }
+    T* object() const { return m_pObject; }
+
+private:
+    T* m_pObject;
+};
+
+/// <summary>
+/// One drawing of an xref graph, with what AutoCAD knows of it as public
+/// fields.
+/// </summary>
+class AcDbXrefGraphNode
+{
+public:
+    AcDbDatabase* database() const { return pStubDatabase; }
+    AcDb::XrefStatus xrefStatus() const { return stubStatus; }
+    AcDb::XrefNotificationStatus xrefNotificationStatus() const { return stubNotificationStatus; }
+
+    AcDbDatabase* pStubDatabase = nullptr;
+    AcDb::XrefStatus stubStatus = AcDb::kXrfResolved;
+    AcDb::XrefNotificationStatus stubNotificationStatus = AcDb::kXrfNotifyNone;
+};
+
+/// <summary>
+/// The host drawing, node 0, and the xrefs it resolves.
+/// </summary>
+class AcDbXrefGraph
+{
+public:
+    int numNodes() const { return static_cast<int>(stubNodes.size()); }
+    AcDbXrefGraphNode* xrefNode(int idx) const { return const_cast<AcDbXrefGraphNode*>(&stubNodes[idx]); }
+    AcDbXrefGraphNode* hostDwg() const { return stubNodes.empty() ? nullptr : xrefNode(0); }
+
+    std::vector<AcDbXrefGraphNode> stubNodes;
+};
+
+/// <summary>
+/// The host node for pHostDb followed by its stubXrefs.
+/// </summary>
+Acad::ErrorStatus acdbGetHostDwgXrefGraph(AcDbDatabase* pHostDb, AcDbXrefGraph& graph,
+                                          Adesk::Boolean includeGhosts = Adesk::kFalse);
+
+class AcDbDatabase
+{
+public:
+    AcDbObjectId linetypeTableId() const { return stubTableId(pStubLinetypeTable); }
+    AcDbObjectId blockTableId() const { return stubTableId(pStubBlockTable); }
+
+    Acad::ErrorStatus getFilename(const ACHAR*& pFileName) const
+    {
+        pFileName = stubFileName.empty() ? nullptr : stubFileName.c_str();
+        return stubFileName.empty() ? Acad::eNotApplicable : Acad::eOk;
+    }
+
+    std::wstring stubFileName;
+    void* pStubLinetypeTable = nullptr;
+    void* pStubBlockTable = nullptr;
+    std::vector<AcDbXrefGraphNode> stubXrefs;   // the graph's nodes after the host
+
+private:
+    AcDbObjectId stubTableId(void* pTable) const
+    {
+        AcDbObjectId id;
+        id.stubHandle = 1;
+        id.pStubDatabase = const_cast<AcDbDatabase*>(this);
+        id.pStubObject = pTable;
+        return id;
+    }
+};
+
+/* Plot settings ----------------------------------------------------------- */
+
+/// <summary>
+/// AcDbPlotSettings with every setting a public field, for the tests to set.
+/// </summary>
+class AcDbPlotSettings
+{
+public:
+    virtual ~AcDbPlotSettings() {}
+
+    bool modelType() const { return model; }
+    Acad::ErrorStatus getPlotCfgName(const ACHAR*& p) const
+    {
+        p = plotCfgName.c_str();
+        return Acad::eOk;
+    }
+    Acad::ErrorStatus getCanonicalMediaName(const ACHAR*& p) const
+    {
+        p = canonicalMediaName.c_str();
+        return Acad::eOk;
+    }
+    Acad::ErrorStatus getCurrentStyleSheet(const ACHAR*& p) const
+    {
+        p = styleSheet.c_str();
+        return Acad::eOk;
+    }
+    Acad::ErrorStatus getPlotViewName(const ACHAR*& p) const
+    {
+        p = viewName.c_str();
+        return Acad::eOk;
+    }
+    Acad::ErrorStatus getPlotPaperMargins(double& left, double& bottom, double& right, double& top) const
+    {
+        left = margins[0];
+        bottom = margins[1];
+        right = margins[2];
+        top = margins[3];
+        return Acad::eOk;
+    }
+    Acad::ErrorStatus getPlotPaperSize(double& width, double& height) const
+    {
+        width = paperSize[0];
+        height = paperSize[1];
+        return Acad::eOk;
+    }
+    Acad::ErrorStatus getPlotOrigin(double& x, double& y) const
+    {
+        x = origin[0];
+        y = origin[1];
+        return Acad::eOk;
+    }
+    Acad::ErrorStatus getPlotWindowArea(double& xMin, double& yMin, double& xMax, double& yMax) const
+    {
+        xMin = window[0];
+        yMin = window[1];
+        xMax = window[2];
+        yMax = window[3];
+        return Acad::eOk;
+    }
+    Acad::ErrorStatus getCustomPrintScale(double& numerator, double& denominator) const
+    {
+        numerator = customScale[0];
+        denominator = customScale[1];
+        return Acad::eOk;
+    }
+    Acad::ErrorStatus getStdScale(double& scale) const
+    {
+        scale = stdScale;
+        return Acad::eOk;
+    }
+    int plotPaperUnits() const { return paperUnits; }
+    int plotRotation() const { return rotation; }
+    int plotType() const { return type; }
+    int stdScaleType() const { return scaleType; }
+    bool useStandardScale() const { return standardScale; }
+    bool plotCentered() const { return centered; }
+    bool plotHidden() const { return hidden; }
+    int shadePlot() const { return shade; }
+    int shadePlotResLevel() const { return shadeResolution; }
+    short shadePlotCustomDPI() const { return shadeDpi; }
+    AcDbObjectId shadePlotId() const { return AcDbObjectId(); }
+    bool plotViewportBorders() const { return viewportBorders; }
+    bool plotTransparency() const { return transparency; }
+    bool plotPlotStyles() const { return plotStyles; }
+    bool showPlotStyles() const { return showStyles; }
+    bool scaleLineweights() const { return scaledLineweights; }
+    bool printLineweights() const { return lineweights; }
+    bool drawViewportsFirst() const { return viewportsFirst; }
+
+    std::wstring plotCfgName;
+    std::wstring canonicalMediaName;
+    std::wstring styleSheet;
+    std::wstring viewName;
+    double margins[4] = {};
+    double paperSize[2] = {};
+    double origin[2] = {};
+    double window[4] = {};
+    double customScale[2] = {1, 1};
+    double stdScale = 1;
+    int paperUnits = 0;
+    int rotation = 0;
+    int type = 0;
+    int scaleType = 0;
+    int shade = 0;
+    int shadeResolution = 0;
+    short shadeDpi = 100;
+    bool model = false;
+    bool standardScale = true;
+    bool centered = false;
+    bool hidden = false;
+    bool viewportBorders = false;
+    bool transparency = false;
+    bool plotStyles = true;
+    bool showStyles = false;
+    bool scaledLineweights = false;
+    bool lineweights = true;
+    bool viewportsFirst = false;
+};
+
+class AcDbLayout : public AcDbPlotSettings
+{
+public:
+    Acad::ErrorStatus getLayoutName(const ACHAR*& pName) const
+    {
+        pName = name.empty() ? nullptr : name.c_str();
+        return name.empty() ? Acad::eNotApplicable : Acad::eOk;
+    }
+    AcDbDatabase* database() const { return pDatabase; }
+
+    std::wstring name;
+    AcDbDatabase* pDatabase = nullptr;
+};
+
+/* Symbol tables ----------------------------------------------------------- */
+
+/// <summary>
+/// A linetype whose dashes the tests set.  A dash with a shape or text
+/// makes the linetype one CachingLinetypeEngine leaves to AutoCAD.
+/// </summary>
+class AcDbLinetypeTableRecord
+{
+public:
+    Acad::ErrorStatus getName(AcString& result) const
+    {
+        result = name.c_str();
+        return Acad::eOk;
+    }
+    int numDashes() const { return static_cast<int>(dashes.size()); }
+    double dashLengthAt(int index) const { return dashes[index]; }
+    bool isScaledToFit() const { return scaledToFit; }
+    AcDbObjectId shapeStyleAt(int) const { return AcDbObjectId(); }
+    int shapeNumberAt(int) const { return shape; }
+    Acad::ErrorStatus textAt(int, AcString& text) const
+    {
+        text = L"";
+        return Acad::eOk;
+    }
+    AcDbDatabase* database() const { return nullptr; }
+
+    std::wstring name;
+    std::vector<double> dashes;
+    bool scaledToFit = false;
+    int shape = 0;
+};
+
+/// <summary>
+/// Symbol table iterator over the record ids a test lists.
+/// </summary>
+class AcDbStubTableIterator
+{
+public:
+    explicit AcDbStubTableIterator(const std::vector<AcDbObjectId>& ids) : m_ids(ids), m_index(0) {}
+
+    bool done() const { return m_index >= m_ids.size(); }
+    void step(bool = true, bool = true) { ++m_index; }
+    Acad::ErrorStatus getRecordId(AcDbObjectId& id) const
+    {
+        id = m_ids[m_index];
+        return Acad::eOk;
+    }
+
+private:
+    std::vector<AcDbObjectId> m_ids;
+    size_t m_index;
+};
+
+template <class Iterator>
+class AcDbStubTable
+{
+public:
+    Acad::ErrorStatus newIterator(Iterator*& pIterator, bool = true, bool = true) const
+    {
+        pIterator = new Iterator(ids);
+        return Acad::eOk;
+    }
+
+    std::vector<AcDbObjectId> ids;
+};
+
+/// <summary>
+/// Opens the table the id stands for, or an empty one.
+/// </summary>
+template <class Table>
+class AcDbStubTablePointer
+{
+public:
+    AcDbStubTablePointer(AcDbObjectId id, AcDb::OpenMode)
+    {
+        if (const Table* pTable = static_cast<const Table*>(id.pStubObject))
+            m_table = *pTable;
+    }
+
+    Acad::ErrorStatus openStatus() const { return Acad::eOk; }
+    Table* operator->() { return &m_table; }
+
+private:
+    Table m_table;
+};
+
+class AcDbLinetypeTableIterator : public AcDbStubTableIterator
+{
+public:
+    using AcDbStubTableIterator::AcDbStubTableIterator;
+};
+typedef AcDbStubTable<AcDbLinetypeTableIterator> AcDbLinetypeTable;
+typedef AcDbStubTablePointer<AcDbLinetypeTable> AcDbLinetypeTablePointer;
+
+class AcDbBlockTableIterator : public AcDbStubTableIterator
+{
+public:
+    using AcDbStubTableIterator::AcDbStubTableIterator;
+};
+typedef AcDbStubTable<AcDbBlockTableIterator> AcDbBlockTable;
+typedef AcDbStubTablePointer<AcDbBlockTable> AcDbBlockTablePointer;
+
+struct AcDbSymbolUtilities
+{
+    /// <summary>
+    /// Always an id with handle 7.
+    /// </summary>
+    AcDbObjectId linetypeContinuousId(AcDbDatabase*) const
+    {
+        AcDbObjectId id;
+        id.stubHandle = 7;
+        return id;
+    }
+};
+
+inline const AcDbSymbolUtilities* acdbSymUtil()
+{
+    static const AcDbSymbolUtilities s_utilities;
+    return &s_utilities;
+}
+
+/* Host application -------------------------------------------------------- */
+
+class AcDbHostApplicationServices
+{
+public:
+    AcDbDatabase* workingDatabase() const { return nullptr; }
+
+    /// <summary>
+    /// Finds a file by its name as given.
+    /// </summary>
+    Acad::ErrorStatus findFile(AcString& fileOut, const ACHAR* pcFilename, AcDbDatabase* = nullptr)
+    {
+        fileOut = pcFilename;
+        return Acad::eOk;
+    }
+
+    int releaseMajorVersion() { return 25; }
+    int releaseMinorVersion() { return 0; }
+};
+
+AcDbHostApplicationServices* acdbHostApplicationServices();
+
+/* Filers ------------------------------------------------------------------ */
+
+struct ads_binary
+{
+    short clen;
+    char* buf;
+};
+
+struct resbuf
+{
+    resbuf* rbnext;
+    short restype;
+    union
+    {
+        double rreal;
+        double rpoint[3];
+        short rint;
+        wchar_t* rstring;
+        int64_t rlname[2];
+        int32_t rlong;
+        int64_t mnInt64;
+        ads_binary rbinary;
+    } resval;
+};
+
+typedef int64_t ads_name[2];
+
+AcDb::DwgDataType acdbGroupCodeToType(AcDb::DxfCode code);
+Acad::ErrorStatus acdbGetAdsName(ads_name& name, AcDbObjectId id);
+Acad::ErrorStatus acdbGetObjectId(AcDbObjectId& id, const ads_name name);
+
+/* Documents --------------------------------------------------------------- */
+
+#define RTERROR (-5001)
+#define RTSHORT 5003
+
+/// <summary>
+/// A drawing open in the editor.  stubDbmod is its DBMOD, which acedGetVar
+/// reads while it is the current document.
+/// </summary>
+class AcApDocument
+{
+public:
+    AcDbDatabase* database() const { return pStubDatabase; }
+
+    AcDbDatabase* pStubDatabase = nullptr;
+    short stubDbmod = 0;
+};
+
+/// <summary>
+/// The documents arx_stubs::openDocument opened; there are none until a
+/// test opens one.
+/// </summary>
+class AcApDocManager
+{
+public:
+    AcApDocument* curDocument() const;
+    AcApDocument* document(const AcDbDatabase* pDb) const;
+};
+
+AcApDocManager* acDocManagerPtr();
+#define acDocManager acDocManagerPtr()
+
+/// <summary>
+/// Reads DBMOD of the current document; any other variable, or DBMOD
+/// without a current document, is RTERROR.
+/// </summary>
+int acedGetVar(const ACHAR* sym, resbuf* result);
+
+namespace arx_stubs {
+
+/// <summary>
+/// Opens pDocument in the editor, as the current document if current is
+/// set, and closes it again.
+/// </summary>
+void openDocument(AcApDocument* pDocument, bool current);
+void closeDocument(AcApDocument* pDocument);
+
+} // namespace arx_stubs
+
+#define ARX_STUBS_FILER_VALUE(Name, Type)                      \
+    virtual Acad::ErrorStatus read##Name(Type* pValue) = 0; \
+    virtual Acad::ErrorStatus write##Name(Type value) = 0;
+#define ARX_STUBS_FILER_REFERENCE(Name, Type)              \
+    virtual Acad::ErrorStatus read##Name(Type* pValue) = 0; \
+    virtual Acad::ErrorStatus write##Name(const Type& value) = 0;
+
+class AcDbDwgFiler : public AcRxObject
+{
+public:
+    virtual Acad::ErrorStatus filerStatus() const = 0;
+    virtual AcDb::FilerType filerType() const = 0;
+    virtual void setFilerStatus(Acad::ErrorStatus status) = 0;
+    virtual void resetFilerStatus() = 0;
+
+    ARX_STUBS_FILER_REFERENCE(HardOwnershipId, AcDbHardOwnershipId)
+    ARX_STUBS_FILER_REFERENCE(SoftOwnershipId, AcDbSoftOwnershipId)
+    ARX_STUBS_FILER_REFERENCE(HardPointerId, AcDbHardPointerId)
+    ARX_STUBS_FILER_REFERENCE(SoftPointerId, AcDbSoftPointerId)
+    ARX_STUBS_FILER_VALUE(Int8, Adesk::Int8)
+    virtual Acad::ErrorStatus readString(ACHAR** pString) = 0;
+    virtual Acad::ErrorStatus writeString(const ACHAR* pString) = 0;
+    virtual Acad::ErrorStatus readString(AcString& value) = 0;
+    virtual Acad::ErrorStatus writeString(const AcString& value) = 0;
+    ARX_STUBS_FILER_REFERENCE(BChunk, ads_binary)
+    ARX_STUBS_FILER_REFERENCE(AcDbHandle, AcDbHandle)
+    ARX_STUBS_FILER_VALUE(Int64, Adesk::Int64)
+    ARX_STUBS_FILER_VALUE(Int32, Adesk::Int32)
+    ARX_STUBS_FILER_VALUE(Int16, Adesk::Int16)
+    ARX_STUBS_FILER_VALUE(UInt64, Adesk::UInt64)
+    ARX_STUBS_FILER_VALUE(UInt32, Adesk::UInt32)
+    ARX_STUBS_FILER_VALUE(UInt16, Adesk::UInt16)
+    ARX_STUBS_FILER_VALUE(UInt8, Adesk::UInt8)
+    ARX_STUBS_FILER_VALUE(Bool, bool)
+    ARX_STUBS_FILER_VALUE(Double, double)
+    ARX_STUBS_FILER_REFERENCE(Point2d, AcGePoint2d)
+    ARX_STUBS_FILER_REFERENCE(Point3d, AcGePoint3d)
+    ARX_STUBS_FILER_REFERENCE(Vector2d, AcGeVector2d)
+    ARX_STUBS_FILER_REFERENCE(Vector3d, AcGeVector3d)
+    ARX_STUBS_FILER_REFERENCE(Scale3d, AcGeScale3d)
+    virtual Acad::ErrorStatus readBytes(void* pDest, Adesk::UIntPtr size) = 0;
+    virtual Acad::ErrorStatus writeBytes(const void* pSrc, Adesk::UIntPtr size) = 0;
+    virtual Acad::ErrorStatus readAddress(void**) { return Acad::eNotImplemented; }
+    virtual Acad::ErrorStatus writeAddress(const void*) { return Acad::eNotImplemented; }
+    virtual Acad::ErrorStatus seek(Adesk::Int64 offset, int method) = 0;
+    virtual Adesk::Int64 tell() const = 0;
+};
+
+#undef ARX_STUBS_FILER_VALUE
+#undef ARX_STUBS_FILER_REFERENCE
+
+class AcDbDxfFiler : public AcRxObject
+{
+public:
+    enum
+    {
+        kDfltPrec = -1,
+        kMaxPrec = 16
+    };
+
+    virtual int rewindFiler() = 0;
+    virtual Acad::ErrorStatus filerStatus() const = 0;
+    virtual void resetFilerStatus() = 0;
+    virtual AcDb::FilerType filerType() const = 0;
+    virtual AcDbDatabase* database() const = 0;
+
+    virtual Acad::ErrorStatus readResBuf(resbuf*) { return Acad::eNotImplemented; }
+    virtual Acad::ErrorStatus writeResBuf(const resbuf&) { return Acad::eNotImplemented; }
+    Acad::ErrorStatus readItem(resbuf* pItem) { return readResBuf(pItem); }
+
+    virtual Acad::ErrorStatus writeObjectId(AcDb::DxfCode code, const AcDbObjectId& id) = 0;
+    virtual Acad::ErrorStatus writeInt8(AcDb::DxfCode code, Adesk::Int8 value) = 0;
+    virtual Acad::ErrorStatus writeString(AcDb::DxfCode code, const ACHAR* pString) = 0;
+    virtual Acad::ErrorStatus writeString(AcDb::DxfCode code, const AcString& value) = 0;
+    virtual Acad::ErrorStatus writeBChunk(AcDb::DxfCode code, const ads_binary& value) = 0;
+    virtual Acad::ErrorStatus writeAcDbHandle(AcDb::DxfCode code, const AcDbHandle& value) = 0;
+    virtual Acad::ErrorStatus writeInt64(AcDb::DxfCode code, Adesk::Int64 value) = 0;
+    virtual Acad::ErrorStatus writeInt32(AcDb::DxfCode code, Adesk::Int32 value) = 0;
+    virtual Acad::ErrorStatus writeInt16(AcDb::DxfCode code, Adesk::Int16 value) = 0;
+    virtual Acad::ErrorStatus writeUInt64(AcDb::DxfCode code, Adesk::UInt64 value) = 0;
+    virtual Acad::ErrorStatus writeUInt32(AcDb::DxfCode code, Adesk::UInt32 value) = 0;
+    virtual Acad::ErrorStatus writeUInt16(AcDb::DxfCode code, Adesk::UInt16 value) = 0;
+    virtual Acad::ErrorStatus writeUInt8(AcDb::DxfCode code, Adesk::UInt8 value) = 0;
+    virtual Acad::ErrorStatus writeBool(AcDb::DxfCode code, bool value) = 0;
+    virtual Acad::ErrorStatus writeDouble(AcDb::DxfCode code, double value, int precision = kDfltPrec) = 0;
+    virtual Acad::ErrorStatus writePoint2d(AcDb::DxfCode code, const AcGePoint2d& value,
+                                           int precision = kDfltPrec) = 0;
+    virtual Acad::ErrorStatus writePoint3d(AcDb::DxfCode code, const AcGePoint3d& value,
+                                           int precision = kDfltPrec) = 0;
+    virtual Acad::ErrorStatus writeVector2d(AcDb::DxfCode code, const AcGeVector2d& value,
+                                            int precision = kDfltPrec) = 0;
+    virtual Acad::ErrorStatus writeVector3d(AcDb::DxfCode code, const AcGeVector3d& value,
+                                            int precision = kDfltPrec) = 0;
+    virtual Acad::ErrorStatus writeScale3d(AcDb::DxfCode code, const AcGeScale3d& value,
+                                           int precision = kDfltPrec) = 0;
+
+    virtual bool includesDefaultValues() const = 0;
+
+    virtual Acad::ErrorStatus pushBackItem() { return Acad::eNotImplemented; }
+    virtual bool atEOF() { return false; }
+    virtual bool atSubclassData(const ACHAR*) { return false; }
+    virtual bool atExtendedData() { return false; }
+    virtual bool atEndOfObject() { return false; }
+    virtual Acad::ErrorStatus writeEmbeddedObjectStart() { return Acad::eNotImplemented; }
+    virtual bool atEmbeddedObjectStart() { return false; }
+};
@@ -0,0 +1,378 @@
+#pragma once
+
+/*
+ * Stand-ins for the AcGe classes the modules use: plain value types with
+ * the SDK's member names, implemented inline.
+ */
+
+#include <cmath>
+
+class AcGeMatrix3d;
+
+class AcGeTol
+{
+public:
+    double equalPoint() const { return 1e-10; }
+    double equalVector() const { return 1e-12; }
+};
+
+struct AcGeContext
+{
+    static AcGeTol gTol;
+};
+
+class AcGeVector2d
+{
+public:
+    AcGeVector2d() : x(0), y(0) {}
+    AcGeVector2d(double xx, double yy) : x(xx), y(yy) {}
+
+    AcGeVector2d& set(double xx, double yy)
+    {
+        x = xx;
+        y = yy;
+        return *this;
+    }
+    double length() const { return std::hypot(x, y); }
+    double angle() const { return std::atan2(y, x); }
+    double dotProduct(const AcGeVector2d& v) const { return x * v.x + y * v.y; }
+    AcGeVector2d& normalize()
+    {
+        const double l = length();
+        if (l > 0)
+        {
+            x /= l;
+            y /= l;
+        }
+        return *this;
+    }
+    AcGeVector2d operator*(double s) const { return AcGeVector2d(x * s, y * s); }
+    AcGeVector2d operator+(const AcGeVector2d& v) const { return AcGeVector2d(x + v.x, y + v.y); }
+    AcGeVector2d operator-(const AcGeVector2d& v) const { return AcGeVector2d(x - v.x, y - v.y); }
+
+    double x, y;
+
+    static const AcGeVector2d kXAxis;
+};
+
+class AcGePoint2d
+{
+public:
+    AcGePoint2d() : x(0), y(0) {}
+    AcGePoint2d(double xx, double yy) : x(xx), y(yy) {}
+
+    AcGePoint2d& set(double xx, double yy)
+    {
+        x = xx;
+        y = yy;
+        return *this;
+    }
+    AcGeVector2d operator-(const AcGePoint2d& p) const { return AcGeVector2d(x - p.x, y - p.y); }
+    AcGePoint2d operator+(const AcGeVector2d& v) const { return AcGePoint2d(x + v.x, y + v.y); }
+    AcGePoint2d operator-(const AcGeVector2d& v) const { return AcGePoint2d(x - v.x, y - v.y); }
+    double distanceTo(const AcGePoint2d& p) const { return std::hypot(x - p.x, y - p.y); }
+    bool isEqualTo(const AcGePoint2d& p, const AcGeTol& tol = AcGeContext::gTol) const
+    {
+        return distanceTo(p) <= tol.equalPoint();
+    }
+    bool operator==(const AcGePoint2d& p) const { return isEqualTo(p); }
+
+    double x, y;
+
+    static const AcGePoint2d kOrigin;
+};
+
+class AcGeVector3d
+{
+public:
+    AcGeVector3d() : x(0), y(0), z(0) {}
+    AcGeVector3d(double xx, double yy, double zz) : x(xx), y(yy), z(zz) {}
+
+    AcGeVector3d& set(double xx, double yy, double zz)
+    {
+        x = xx;
+        y = yy;
+        z = zz;
+        return *this;
+    }
+    double length() const { return std::sqrt(lengthSqrd()); }
+    double lengthSqrd() const { return x * x + y * y + z * z; }
+    bool isZeroLength(const AcGeTol& tol = AcGeContext::gTol) const { return length() <= tol.equalVector(); }
+    AcGeVector3d& normalize()
+    {
+        const double l = length();
+        if (l > 0)
+        {
+            x /= l;
+            y /= l;
+            z /= l;
+        }
+        return *this;
+    }
+    AcGeVector3d normal() const
+    {
+        AcGeVector3d v(*this);
+        return v.normalize();
+    }
+    AcGeVector3d& negate()
+    {
+        x = -x;
+        y = -y;
+        z = -z;
+        return *this;
+    }
+    bool isEqualTo(const AcGeVector3d& v, const AcGeTol& tol = AcGeContext::gTol) const
+    {
+        return (*this - v).length() <= tol.equalVector();
+    }
+    bool operator==(const AcGeVector3d& v) const { return isEqualTo(v); }
+    double dotProduct(const AcGeVector3d& v) const { return x * v.x + y * v.y + z * v.z; }
+    AcGeVector3d crossProduct(const AcGeVector3d& v) const
+    {
+        return AcGeVector3d(y * v.z - z * v.y, z * v.x - x * v.z, x * v.y - y * v.x);
+    }
+    AcGeVector3d perpVector() const
+    {
+        return std::fabs(x) < 0.9 ? crossProduct(AcGeVector3d(1, 0, 0)) : crossProduct(AcGeVector3d(0, 1, 0));
+    }
+
+    AcGeVector3d operator*(double s) const { return AcGeVector3d(x * s, y * s, z * s); }
+    AcGeVector3d operator+(const AcGeVector3d& v) const { return AcGeVector3d(x + v.x, y + v.y, z + v.z); }
+    AcGeVector3d operator-(const AcGeVector3d& v) const { return AcGeVector3d(x - v.x, y - v.y, z - v.z); }
+    AcGeVector3d operator-() const { return AcGeVector3d(-x, -y, -z); }
+    AcGeVector3d& operator+=(const AcGeVector3d& v)
+    {
+        x += v.x;
+        y += v.y;
+        z += v.z;
+        return *this;
+    }
+    double operator[](unsigned int i) const { return (&x)[i]; }
+    double& operator[](unsigned int i) { return (&x)[i]; }
+
+    double x, y, z;
+
+    static const AcGeVector3d kXAxis;
+    static const AcGeVector3d kYAxis;
+    static const AcGeVector3d kZAxis;
+};
+
+inline AcGeVector3d operator*(double s, const AcGeVector3d& v)
+{
+    return v * s;
+}
+
+class AcGePoint3d
+{
+public:
+    AcGePoint3d() : x(0), y(0), z(0) {}
+    AcGePoint3d(double xx, double yy, double zz) : x(xx), y(yy), z(zz) {}
+
+    AcGePoint3d& set(double xx, double yy, double zz)
+    {
+        x = xx;
+        y = yy;
+        z = zz;
+        return *this;
+    }
+    AcGeVector3d operator-(const AcGePoint3d& p) const { return AcGeVector3d(x - p.x, y - p.y, z - p.z); }
+    AcGePoint3d operator+(const AcGeVector3d& v) const { return AcGePoint3d(x + v.x, y + v.y, z + v.z); }
+    AcGePoint3d operator-(const AcGeVector3d& v) const { return AcGePoint3d(x - v.x, y - v.y, z - v.z); }
+    AcGePoint3d& operator+=(const AcGeVector3d& v)
+    {
+        x += v.x;
+        y += v.y;
+        z += v.z;
+        return *this;
+    }
+    AcGeVector3d asVector() const { return AcGeVector3d(x, y, z); }
+    AcGePoint2d convert2d() const { return AcGePoint2d(x, y); }
+    double distanceTo(const AcGePoint3d& p) const { return (*this - p).length(); }
+    bool isEqualTo(const AcGePoint3d& p, const AcGeTol& tol = AcGeContext::gTol) const
+    {
+        return distanceTo(p) <= tol.equalPoint();
+    }
+    bool operator==(const AcGePoint3d& p) const { return isEqualTo(p); }
+    AcGePoint3d& transformBy(const AcGeMatrix3d& matrix);
+    double operator[](unsigned int i) const { return (&x)[i]; }
+    double& operator[](unsigned int i) { return (&x)[i]; }
+
+    double x, y, z;
+
+    static const AcGePoint3d kOrigin;
+};
+
+class AcGeMatrix3d
+{
+public:
+    AcGeMatrix3d() { setToIdentity(); }
+
+    AcGeMatrix3d& setToIdentity()
+    {
+        for (int i = 0; i < 4; ++i)
+            for (int j = 0; j < 4; ++j)
+                entry[i][j] = i == j ? 1.0 : 0.0;
+        return *this;
+    }
+
+    AcGeMatrix3d& setCoordSystem(const AcGePoint3d& origin, const AcGeVector3d& xAxis, const AcGeVector3d& yAxis,
+                                 const AcGeVector3d& zAxis)
+    {
+        setToIdentity();
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            entry[i][0] = xAxis[i];
+            entry[i][1] = yAxis[i];
+            entry[i][2] = zAxis[i];
+            entry[i][3] = origin[i];
+        }
+        return *this;
+    }
+
+    bool operator==(const AcGeMatrix3d& other) const
+    {
+        for (int i = 0; i < 4; ++i)
+            for (int j = 0; j < 4; ++j)
+                if (entry[i][j] != other.entry[i][j])
+                    return false;
+        return true;
+    }
+
+    double entry[4][4];
+
+    static const AcGeMatrix3d kIdentity;
+};
+
+inline AcGePoint3d operator*(const AcGeMatrix3d& m, const AcGePoint3d& p)
+{
+    AcGePoint3d r;
+    for (unsigned int i = 0; i < 3; ++i)
+        r[i] = m.entry[i][0] * p.x + m.entry[i][1] * p.y + m.entry[i][2] * p.z + m.entry[i][3];
+    return r;
+}
+
+inline AcGeVector3d operator*(const AcGeMatrix3d& m, const AcGeVector3d& v)
+{
+    AcGeVector3d r;
+    for (unsigned int i = 0; i < 3; ++i)
+        r[i] = m.entry[i][0] * v.x + m.entry[i][1] * v.y + m.entry[i][2] * v.z;
+    return r;
+}
+
+inline AcGePoint3d& AcGePoint3d::transformBy(const AcGeMatrix3d& matrix)
+{
+    return *this = matrix * *this;
+}
+
+class AcGeMatrix2d
+{
+public:
+    double entry[3][3];
+};
+
+class AcGeScale3d
+{
+public:
+    double sx = 1;
+    double sy = 1;
+    double sz = 1;
+};
+
+class AcGeBoundBlock2d
+{
+public:
+    AcGeBoundBlock2d& set(const AcGePoint2d& minimum, const AcGePoint2d& maximum)
+    {
+        m_minimum = minimum;
+        m_maximum = maximum;
+        return *this;
+    }
+    void getMinMaxPoints(AcGePoint2d& minimum, AcGePoint2d& maximum) const
+    {
+        minimum = m_minimum;
+        maximum = m_maximum;
+    }
+
+private:
+    AcGePoint2d m_minimum;
+    AcGePoint2d m_maximum;
+};
+
+class AcGeBoundBlock3d
+{
+public:
+    AcGeBoundBlock3d() {}
+    AcGeBoundBlock3d(const AcGePoint3d& minimum, const AcGePoint3d& maximum) : m_minimum(minimum), m_maximum(maximum)
+    {
+    }
+
+    AcGeBoundBlock3d& set(const AcGePoint3d& minimum, const AcGePoint3d& maximum)
+    {
+        m_minimum = minimum;
+        m_maximum = maximum;
+        return *this;
+    }
+    void getMinMaxPoints(AcGePoint3d& minimum, AcGePoint3d& maximum) const
+    {
+        minimum = m_minimum;
+        maximum = m_maximum;
+    }
+    bool isBox() const { return true; }
+    AcGeBoundBlock3d& extend(const AcGePoint3d& p)
+    {
+        for (unsigned int k = 0; k < 3; ++k)
+        {
+            m_minimum[k] = std::fmin(m_minimum[k], p[k]);
+            m_maximum[k] = std::fmax(m_maximum[k], p[k]);
+        }
+        return *this;
+    }
+
+private:
+    AcGePoint3d m_minimum;
+    AcGePoint3d m_maximum;
+};
+
+class AcGePlane
+{
+public:
+    AcGePlane() {}
+    AcGePlane(const AcGePoint3d& origin, const AcGeVector3d& normal) : m_origin(origin), m_normal(normal) {}
+
+    AcGeVector3d normal() const { return m_normal; }
+    AcGePoint3d pointOnPlane() const { return m_origin; }
+
+private:
+    AcGePoint3d m_origin;
+    AcGeVector3d m_normal;
+};
+
+class AcGeLineSeg2d
+{
+public:
+    AcGeLineSeg2d() {}
+    AcGeLineSeg2d(const AcGePoint2d& start, const AcGePoint2d& end) : m_start(start), m_end(end) {}
+
+    AcGePoint2d startPoint() const { return m_start; }
+    AcGePoint2d endPoint() const { return m_end; }
+    double length() const { return m_start.distanceTo(m_end); }
+
+private:
+    AcGePoint2d m_start;
+    AcGePoint2d m_end;
+};
+
+class AcGeCircArc2d
+{
+public:
+    AcGeCircArc2d() {}
+};
+
+class AcGeCircArc3d;
+class AcGeLineSeg3d;
+class AcGeCurve2d;
+
+typedef AcArray<AcGePoint3d> AcGePoint3dArray;
+typedef AcArray<AcGePoint2d> AcGePoint2dArray;
+typedef AcArray<AcGeVector3d> AcGeVector3dArray;
+typedef AcArray<double> AcGeDoubleArray;
@@ -0,0 +1,315 @@
+#pragma once
+
+/*
+ * Stand-ins for the AcGi interfaces the modules draw through.  The pure
+ * virtuals are the SDK's, so the modules' implementations of them compile
+ * unchanged and the tests implement them to record what was drawn.
+ */
+
+class AcGiEdgeData;
+class AcGiFaceData;
+class AcGiVertexData;
+class AcGiTextStyle;
+class AcDbPolyline;
+class AcGiDrawable;
+class AcGiImageBGRA32;
+class AcGiClipBoundary;
+class AcGiLineType;
+
+typedef enum
+{
+    kAcGiFillAlways = 1,
+    kAcGiFillNever
+} AcGiFillType;
+
+typedef enum
+{
+    kAcGiStandardDisplay = 2
+} AcGiRegenType;
+
+typedef enum
+{
+    kAcGiMaxDevForCircle = 0
+} AcGiDeviationType;
+
+typedef enum
+{
+    kAcGiArcSimple = 0
+} AcGiArcType;
+
+typedef enum
+{
+    kAcGiWorldPosition
+} AcGiPositionTransformBehavior;
+
+typedef enum
+{
+    kAcGiWorldScale
+} AcGiScaleTransformBehavior;
+
+typedef enum
+{
+    kAcGiWorldOrientation
+} AcGiOrientationTransformBehavior;
+
+class AcGiPolyline
+{
+public:
+    Adesk::UInt32 points() const { return m_count; }
+    const AcGePoint3d* vertexList() const { return m_pVertices; }
+    const AcGeVector3d* normal() const { return m_pNormal; }
+
+    void setVertexList(Adesk::UInt32 count, const AcGePoint3d* pVertices)
+    {
+        m_count = count;
+        m_pVertices = pVertices;
+    }
+    void setNormal(const AcGeVector3d* pNormal) { m_pNormal = pNormal; }
+
+private:
+    Adesk::UInt32 m_count = 0;
+    const AcGePoint3d* m_pVertices = nullptr;
+    const AcGeVector3d* m_pNormal = nullptr;
+};
+
+class AcGiContext : public AcRxObject
+{
+public:
+    virtual Adesk::Boolean isPsOut() const = 0;
+    virtual Adesk::Boolean isPlotGeneration() const = 0;
+    virtual AcDbDatabase* database() const = 0;
+    virtual bool isBoundaryClipping() const = 0;
+};
+
+class AcGiSubEntityTraits : public AcRxObject
+{
+public:
+    virtual void setColor(const Adesk::UInt16 color) = 0;
+    virtual void setTrueColor(const AcCmEntityColor& color) = 0;
+    virtual void setLayer(const AcDbObjectId layerId) = 0;
+    virtual void setLineType(const AcDbObjectId linetypeId) = 0;
+    virtual void setSelectionMarker(const Adesk::LongPtr markerId) = 0;
+    virtual void setFillType(const AcGiFillType fillType) = 0;
+    virtual void setLineWeight(const AcDb::LineWeight lineWeight) = 0;
+    virtual void setLineTypeScale(double scale = 1.0) = 0;
+    virtual void setThickness(double thickness) = 0;
+
+    virtual Adesk::UInt16 color() const = 0;
+    virtual AcCmEntityColor trueColor() const = 0;
+    virtual AcDbObjectId layerId() const = 0;
+    virtual AcDbObjectId lineTypeId() const = 0;
+    virtual AcGiFillType fillType() const = 0;
+    virtual AcDb::LineWeight lineWeight() const = 0;
+    virtual double lineTypeScale() const = 0;
+    virtual double thickness() const = 0;
+};
+
+class AcGiGeometry : public AcRxObject
+{
+public:
+    enum TransparencyMode
+    {
+        kTransparencyOff,
+        kTransparency1Bit,
+        kTransparency8Bit
+    };
+
+    virtual void getModelToWorldTransform(AcGeMatrix3d& matrix) const = 0;
+    virtual void getWorldToModelTransform(AcGeMatrix3d& matrix) const = 0;
+    virtual Adesk::Boolean pushModelTransform(const AcGeVector3d& normal) = 0;
+    virtual Adesk::Boolean pushModelTransform(const AcGeMatrix3d& matrix) = 0;
+    virtual Adesk::Boolean popModelTransform() = 0;
+    virtual AcGeMatrix3d pushPositionTransform(AcGiPositionTransformBehavior behavior, const AcGePoint3d& offset) = 0;
+    virtual AcGeMatrix3d pushPositionTransform(AcGiPositionTransformBehavior behavior, const AcGePoint2d& offset) = 0;
+    virtual AcGeMatrix3d pushScaleTransform(AcGiScaleTransformBehavior behavior, const AcGePoint3d& extents) = 0;
+    virtual AcGeMatrix3d pushScaleTransform(AcGiScaleTransformBehavior behavior, const AcGePoint2d& extents) = 0;
+    virtual AcGeMatrix3d pushOrientationTransform(AcGiOrientationTransformBehavior behavior) = 0;
+
+    virtual Adesk::Boolean circle(const AcGePoint3d& center, const double radius, const AcGeVector3d& normal) const = 0;
+    virtual Adesk::Boolean circle(const AcGePoint3d& first, const AcGePoint3d& second,
+                                  const AcGePoint3d& third) const = 0;
+    virtual Adesk::Boolean circularArc(const AcGePoint3d& center, const double radius, const AcGeVector3d& normal,
+                                       const AcGeVector3d& startVector, const double sweepAngle,
+                                       const AcGiArcType arcType = kAcGiArcSimple) const = 0;
+    virtual Adesk::Boolean circularArc(const AcGePoint3d& start, const AcGePoint3d& point, const AcGePoint3d& end,
+                                       const AcGiArcType arcType = kAcGiArcSimple) const = 0;
+    virtual Adesk::Boolean polyline(const Adesk::UInt32 nbPoints, const AcGePoint3d* pVertexList,
+                                    const AcGeVector3d* pNormal = nullptr,
+                                    Adesk::LongPtr lBaseSubEntMarker = -1) const = 0;
+    virtual Adesk::Boolean polyline(const AcGiPolyline& polylineObj) const = 0;
+    virtual Adesk::Boolean polyPolyline(Adesk::UInt32 nbPolylines, const AcGiPolyline* pPolylines) const = 0;
+    virtual Adesk::Boolean polygon(const Adesk::UInt32 nbPoints, const AcGePoint3d* pVertexList) const = 0;
+    virtual Adesk::Boolean polyPolygon(const Adesk::UInt32 numPolygonIndices, const Adesk::UInt32* numPolygonPositions,
+                                       const AcGePoint3d* polygonPositions, const Adesk::UInt32* numPolygonPoints,
+                                       const AcGePoint3d* polygonPoints, const AcCmEntityColor* outlineColors = nullptr,
+                                       const AcGiLineType* outlineTypes = nullptr,
+                                       const AcCmEntityColor* fillColors = nullptr,
+                                       const AcCmTransparency* fillOpacities = nullptr) const = 0;
+    virtual Adesk::Boolean mesh(const Adesk::UInt32 rows, const Adesk::UInt32 columns, const AcGePoint3d* pVertexList,
+                                const AcGiEdgeData* pEdgeData = nullptr, const AcGiFaceData* pFaceData = nullptr,
+                                const AcGiVertexData* pVertexData = nullptr,
+                                const bool bAutoGenerateNormals = true) const = 0;
+    virtual Adesk::Boolean shell(const Adesk::UInt32 nbVertex, const AcGePoint3d* pVertexList,
+                                 const Adesk::UInt32 faceListSize, const Adesk::Int32* pFaceList,
+                                 const AcGiEdgeData* pEdgeData = nullptr, const AcGiFaceData* pFaceData = nullptr,
+                                 const AcGiVertexData* pVertexData = nullptr, const struct resbuf* pResBuf = nullptr,
+                                 const bool bAutoGenerateNormals = true) const = 0;
+    virtual Adesk::Boolean text(const AcGePoint3d& position, const AcGeVector3d& normal,
+                                const AcGeVector3d& direction, const double height, const double width,
+                                const double oblique, const ACHAR* pMsg) const = 0;
+    virtual Adesk::Boolean text(const AcGePoint3d& position, const AcGeVector3d& normal,
+                                const AcGeVector3d& direction, const ACHAR* pMsg, const Adesk::Int32 length,
+                                const Adesk::Boolean raw, const AcGiTextStyle& textStyle) const = 0;
+    virtual Adesk::Boolean xline(const AcGePoint3d& first, const AcGePoint3d& second) const = 0;
+    virtual Adesk::Boolean ray(const AcGePoint3d& origin, const AcGePoint3d& through) const = 0;
+    virtual Adesk::Boolean pline(const AcDbPolyline& lwBuf, Adesk::UInt32 fromIndex = 0,
+                                 Adesk::UInt32 numSegs = 0) const = 0;
+    virtual Adesk::Boolean draw(AcGiDrawable* pDrawable) const = 0;
+    virtual Adesk::Boolean image(const AcGiImageBGRA32& imageSource, const AcGePoint3d& position,
+                                 const AcGeVector3d& u, const AcGeVector3d& v,
+                                 TransparencyMode transparencyMode = kTransparency8Bit) const = 0;
+    virtual Adesk::Boolean rowOfDots(int count, const AcGePoint3d& start, const AcGeVector3d& step) const = 0;
+    virtual Adesk::Boolean ellipticalArc(const AcGePoint3d& center, const AcGeVector3d& normal,
+                                         double majorAxisLength, double minorAxisLength, double startDegreeInRads,
+                                         double endDegreeInRads, double tiltDegreeInRads,
+                                         AcGiArcType arcType = kAcGiArcSimple) const = 0;
+    virtual Adesk::Boolean pushClipBoundary(AcGiClipBoundary* pBoundary) = 0;
+    virtual void popClipBoundary() = 0;
+    virtual Adesk::Boolean edge(const AcArray<AcGeCurve2d*>& edges) const = 0;
+};
+
+class AcGiWorldGeometry : public AcGiGeometry
+{
+public:
+    virtual void setExtents(AcGePoint3d* pNewExtents) const = 0;
+};
+
+class AcGiViewportGeometry : public AcGiGeometry
+{
+};
+
+class AcGiCommonDraw : public AcRxObject
+{
+public:
+    virtual AcGiRegenType regenType() const = 0;
+    virtual Adesk::Boolean regenAbort() const = 0;
+    virtual AcGiSubEntityTraits& subEntityTraits() const = 0;
+    virtual AcGiGeometry* rawGeometry() const = 0;
+    virtual Adesk::Boolean isDragging() const = 0;
+    virtual double deviation(const AcGiDeviationType type, const AcGePoint3d& point) const = 0;
+    virtual Adesk::UInt32 numberOfIsolines() const = 0;
+    virtual AcGiContext* context() = 0;
+};
+
+class AcGiWorldDraw : public AcGiCommonDraw
+{
+public:
+    virtual AcGiWorldGeometry& geometry() const = 0;
+};
+
+class AcGiViewportDraw : public AcGiCommonDraw
+{
+public:
+    virtual AcGiViewportGeometry& geometry() const = 0;
+};
+
+class AcGiDrawStream;
+
+class AcGiDrawable : public AcRxObject
+{
+public:
+    virtual AcDbObjectId id() const = 0;
+    virtual void setDrawStream(AcGiDrawStream* pStream) { m_pDrawStream = pStream; }
+    virtual AcGiDrawStream* drawStream() const { return m_pDrawStream; }
+
+private:
+    AcGiDrawStream* m_pDrawStream = nullptr;
+};
+
+/* Text style --------------------------------------------------------------- */
+
+enum Charset
+{
+    kAnsiCharset = 0
+};
+
+namespace Autodesk { namespace AutoCAD { namespace PAL { namespace FontUtils {
+enum FontPitch
+{
+    kDefault
+};
+enum FontFamily
+{
+    kDoNotCare
+};
+}}}} // namespace Autodesk::AutoCAD::PAL::FontUtils
+
+/// <summary>
+/// AcGiTextStyle with every setting a public field, for the tests to set.
+/// </summary>
+class AcGiTextStyle
+{
+public:
+    double textSize() const { return size; }
+    double xScale() const { return widthFactor; }
+    double obliquingAngle() const { return oblique; }
+    double trackingPercent() const { return tracking; }
+    bool isBackward() const { return backward; }
+    bool isUpsideDown() const { return upsideDown; }
+    bool isVertical() const { return vertical; }
+    bool isUnderlined() const { return underlined; }
+    bool isOverlined() const { return overlined; }
+    bool isStrikethrough() const { return strikethrough; }
+    const ACHAR* fileName() const { return file.c_str(); }
+    const ACHAR* bigFontFileName() const { return bigFontFile.c_str(); }
+    const ACHAR* styleName() const { return L"Standard"; }
+
+    Acad::ErrorStatus font(AcString& typeFace, bool& bold, bool& italic, Charset& charset,
+                           Autodesk::AutoCAD::PAL::FontUtils::FontPitch& pitch,
+                           Autodesk::AutoCAD::PAL::FontUtils::FontFamily& family) const
+    {
+        typeFace = this->typeFace.c_str();
+        bold = italic = false;
+        charset = kAnsiCharset;
+        pitch = Autodesk::AutoCAD::PAL::FontUtils::kDefault;
+        family = Autodesk::AutoCAD::PAL::FontUtils::kDoNotCare;
+        return Acad::eOk;
+    }
+
+    std::wstring file = L"txt.shx";
+    std::wstring bigFontFile;
+    std::wstring typeFace;
+    double size = 1;
+    double widthFactor = 1;
+    double oblique = 0;
+    double tracking = 1;
+    bool backward = false;
+    bool upsideDown = false;
+    bool vertical = false;
+    bool underlined = false;
+    bool overlined = false;
+    bool strikethrough = false;
+};
+
+/* Block table records ------------------------------------------------------ */
+
+/// <summary>
+/// A block: a drawable, so a draw stream can be attached to it, and maybe an
+/// external reference to the drawing at xrefPath.
+/// </summary>
+class AcDbBlockTableRecord : public AcGiDrawable
+{
+public:
+    AcDbObjectId id() const override { return objectId; }
+    bool isLayout() const { return layout; }
+    bool isFromExternalReference() const { return !xrefPath.empty(); }
+    Acad::ErrorStatus pathName(AcString& path) const
+    {
+        path = xrefPath.c_str();
+        return Acad::eOk;
+    }
+
+    AcDbObjectId objectId;
+    bool layout = false;
+    std::wstring xrefPath;
+};
@@ -0,0 +1,271 @@
+#pragma once
+
+/*
+ * Stand-ins for the AcPl plot API.  Plot info, configurations and page info
+ * hold what a test gives them in public fields; the reactor, progress and
+ * logger interfaces are the SDK's, for the modules to implement.
+ */
+
+#include <memory>
+
+class AcPlObject : public AcRxObject
+{
+};
+
+/// <summary>
+/// A plot device: the name, path, media and resolution a test gives it.
+/// </summary>
+class AcPlPlotConfig : public AcPlObject
+{
+public:
+    virtual const ACHAR* deviceName() const { return name.c_str(); }
+    virtual const ACHAR* fullPath() const { return path.c_str(); }
+    virtual unsigned int maxDeviceDPI() const { return dpi; }
+    virtual void getCanonicalMediaNameList(AcArray<ACHAR*>& mediaList) const {}
+    virtual void getLocalMediaName(const ACHAR* pCanonicalName, ACHAR*& pLocalName) const { pLocalName = nullptr; }
+    virtual void getMediaBounds(const ACHAR* pCanonicalName, AcGePoint2d& pageSize,
+                                AcGeBoundBlock2d& printableArea) const
+    {
+    }
+
+    std::wstring name;
+    std::wstring path;
+    unsigned int dpi = 0;
+};
+
+/// <summary>
+/// The plot info of one sheet.  layout() is an id that opens pLayout;
+/// copyFrom counts the copies a module makes.
+/// </summary>
+class AcPlPlotInfo : public AcPlObject
+{
+public:
+    AcDbObjectId layout() const
+    {
+        AcDbObjectId id;
+        id.stubHandle = 1;
+        id.pStubObject = pLayout;
+        return id;
+    }
+    AcString& OrgFilePath() { return m_orgFilePath; }
+
+    const AcDbPlotSettings* overrideSettings() const { return pOverrideSettings; }
+    const AcPlPlotConfig* deviceOverride() const { return pDeviceOverride; }
+
+    const AcDbPlotSettings* validatedSettings() const { return pValidatedSettings.get(); }
+    Acad::ErrorStatus setValidatedSettings(const AcDbPlotSettings* pSettings)
+    {
+        pValidatedSettings = pSettings != nullptr ? std::make_shared<AcDbPlotSettings>(*pSettings) : nullptr;
+        return Acad::eOk;
+    }
+    const AcPlPlotConfig* validatedConfig() const { return pValidatedConfig; }
+    void setValidatedConfig(const AcPlPlotConfig* pConfig) { pValidatedConfig = pConfig; }
+    unsigned long mergeStatus() const { return merge; }
+    bool isValidated() const { return pValidatedSettings != nullptr; }
+
+    Acad::ErrorStatus copyFrom(const AcRxObject* pOther)
+    {
+        *this = *static_cast<const AcPlPlotInfo*>(pOther);
+        ++copyCount;
+        return Acad::eOk;
+    }
+
+    AcDbLayout* pLayout = nullptr;
+    const AcDbPlotSettings* pOverrideSettings = nullptr;
+    const AcPlPlotConfig* pDeviceOverride = nullptr;
+    std::shared_ptr<AcDbPlotSettings> pValidatedSettings;
+    const AcPlPlotConfig* pValidatedConfig = nullptr;
+    unsigned long merge = 0;
+    int copyCount = 0;
+
+private:
+    AcString m_orgFilePath;
+};
+
+/// <summary>
+/// The SDK's validator with its default weights; validate is left to the
+/// test.
+/// </summary>
+class AcPlPlotInfoValidator : public AcPlObject
+{
+public:
+    enum MatchingPolicy
+    {
+        kMatchDisabled = 1,
+        kMatchEnabled
+    };
+
+    virtual Acad::ErrorStatus validate(AcPlPlotInfo& info) = 0;
+
+    MatchingPolicy matchingPolicy() const { return kMatchEnabled; }
+    unsigned mediaGroupWeight() const { return 50; }
+    unsigned sheetMediaGroupWeight() const { return 10; }
+    unsigned mediaBoundsWeight() const { return 100; }
+    unsigned printableBoundsWeight() const { return 10; }
+    unsigned dimensionalWeight() const { return 50; }
+    unsigned sheetDimensionalWeight() const { return 10; }
+    unsigned mediaMatchingThreshold() const { return 500; }
+};
+
+class AcPlPlotPageInfo : public AcPlObject
+{
+public:
+    Adesk::Int32 entityCount() const { return entities; }
+
+    Adesk::Int32 entities = 0;
+};
+
+class AcPlPlotProgress
+{
+public:
+    enum SheetCancelStatus
+    {
+        kSheetContinue,
+        kSheetCanceledByCancelButton,
+        kSheetCanceledByCancelAllButton,
+        kSheetCanceledByCaller,
+        kSheetCancelStatusCount
+    };
+    enum PlotCancelStatus
+    {
+        kPlotContinue,
+        kPlotCanceledByCaller,
+        kPlotCanceledByCancelAllButton,
+        kPlotCancelStatusCount
+    };
+
+    virtual ~AcPlPlotProgress() {}
+
+    virtual bool isPlotCancelled() const = 0;
+    virtual void setPlotCancelStatus(PlotCancelStatus status) = 0;
+    virtual PlotCancelStatus plotCancelStatus() const = 0;
+    virtual void setPlotProgressRange(int lower, int upper) = 0;
+    virtual void getPlotProgressRange(int& lower, int& upper) const = 0;
+    virtual void setPlotProgressPos(int pos) = 0;
+    virtual int plotProgressPos() const = 0;
+    virtual bool isSheetCancelled() const = 0;
+    virtual void setSheetCancelStatus(SheetCancelStatus status) = 0;
+    virtual SheetCancelStatus sheetCancelStatus() const = 0;
+    virtual void setSheetProgressRange(int lower, int upper) = 0;
+    virtual void getSheetProgressRange(int& lower, int& upper) const = 0;
+    virtual void setSheetProgressPos(int pos) = 0;
+    virtual int sheetProgressPos() const = 0;
+    virtual bool setIsVisible(bool visible) = 0;
+    virtual bool isVisible() const = 0;
+    virtual bool setStatusMsgString(const ACHAR* pMessage) = 0;
+    virtual bool getStatusMsgString(AcString& message) const = 0;
+    virtual void heartbeat() = 0;
+};
+
+class AcPlPlotReactor : public AcRxObject
+{
+public:
+    enum PlotType
+    {
+        kPlot,
+        kPreview,
+        kBackgroundPackaging,
+        kBackgroundPlot
+    };
+
+    virtual void beginPlot(AcPlPlotProgress* pPlotProgress, PlotType type) {}
+    virtual void beginDocument(AcPlPlotInfo& plotInfo, const ACHAR* pDocname, Adesk::Int32 nCopies = 1,
+                               bool bPlotToFile = false, const ACHAR* pFilename = nullptr)
+    {
+    }
+    virtual void beginPage(AcPlPlotPageInfo& pageInfo, AcPlPlotInfo& plotInfo, bool bLastPage) {}
+    virtual void endPage(AcPlPlotProgress::SheetCancelStatus status) {}
+    virtual void endDocument(AcPlPlotProgress::PlotCancelStatus status) {}
+    virtual void endPlot(AcPlPlotProgress::PlotCancelStatus status) {}
+    virtual void plotCancelled() {}
+    virtual void pageCancelled() {}
+};
+
+/// <summary>
+/// Keeps the reactors added to it, in order, for a test to drive.
+/// </summary>
+class AcPlPlotReactorMgr
+{
+public:
+    void addReactor(AcPlPlotReactor* pReactor);
+    void removeReactor(AcPlPlotReactor* pReactor);
+
+    std::vector<AcPlPlotReactor*> reactors;
+};
+
+AcPlPlotReactorMgr* acplPlotReactorMgrPtr();
+#define acplPlotReactorMgr acplPlotReactorMgrPtr()
+
+/* Logging ------------------------------------------------------------------ */
+
+class AcPlPlotLogger
+{
+public:
+    AcPlPlotLogger() {}
+    virtual ~AcPlPlotLogger() {}
+
+    virtual Acad::ErrorStatus startJob() = 0;
+    virtual Acad::ErrorStatus startSheet() = 0;
+    virtual Acad::ErrorStatus logTerminalError(const ACHAR* pErrorString) = 0;
+    virtual Acad::ErrorStatus logARIError(const ACHAR* pErrorString) = 0;
+    virtual Acad::ErrorStatus logSevereError(const ACHAR* pErrorString) = 0;
+    virtual Acad::ErrorStatus logError(const ACHAR* pErrorString) = 0;
+    virtual Acad::ErrorStatus logWarning(const ACHAR* pWarningString) = 0;
+    virtual Acad::ErrorStatus logMessage(const ACHAR* pMessageString) = 0;
+    virtual Acad::ErrorStatus logInformation(const ACHAR* pMessageString) = 0;
+    virtual Acad::ErrorStatus endSheet() = 0;
+    virtual bool errorHasHappenedInSheet() const = 0;
+    virtual bool warningHasHappenedInSheet() const = 0;
+    virtual Acad::ErrorStatus endJob() = 0;
+    virtual bool errorHasHappenedInJob() const = 0;
+    virtual bool warningHasHappenedInJob() const = 0;
+};
+
+class AcPlPlotErrorHandler
+{
+public:
+    virtual ~AcPlPlotErrorHandler() {}
+};
+
+class AcPlPlotLoggingErrorHandler : public AcPlPlotErrorHandler
+{
+public:
+    AcPlPlotLoggingErrorHandler() {}
+    explicit AcPlPlotLoggingErrorHandler(AcPlPlotLogger* pLogger) : pStubLogger(pLogger) {}
+
+    AcPlPlotLogger* pStubLogger = nullptr;
+};
+
+/// <summary>
+/// Holds the error handler it is locked with, as AutoCAD would use it for
+/// the plots that follow.
+/// </summary>
+class AcPlPlotErrorHandlerLock : public AcPlObject
+{
+public:
+    enum LockStatus
+    {
+        kLocked,
+        kUnLocked
+    };
+
+    LockStatus status() const { return m_pHandler != nullptr ? kLocked : kUnLocked; }
+    bool lock(AcPlPlotErrorHandler* pAppErrHandler, const ACHAR* pAppName)
+    {
+        if (m_pHandler != nullptr)
+            return false;
+        m_pHandler = pAppErrHandler;
+        return true;
+    }
+    bool unLock(AcPlPlotErrorHandler* pAppErrHandler)
+    {
+        if (m_pHandler != pAppErrHandler)
+            return false;
+        m_pHandler = nullptr;
+        return true;
+    }
+    void getErrorHandler(AcPlPlotErrorHandler*& pAppErrHandler) const { pAppErrHandler = m_pHandler; }
+
+private:
+    AcPlPlotErrorHandler* m_pHandler = nullptr;
+};
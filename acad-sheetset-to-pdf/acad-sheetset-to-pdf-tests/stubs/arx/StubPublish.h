@@ -0,0 +1,242 @@
+#pragma once
+
+/*
+ * Stand-ins for the publish API: the sheet set data (DSD) a publish job is
+ * made from, the publish reactor and its event interfaces, and the DWF/PDF
+ * metadata (DMM) types.  The DSD classes hold what a test gives them.
+ */
+
+class AcNameValuePair
+{
+public:
+    AcNameValuePair() {}
+    AcNameValuePair(const ACHAR* pName, const ACHAR* pValue)
+    {
+        setName(pName);
+        setValue(pValue);
+    }
+
+    const ACHAR* name() const { return m_hasName ? m_name.c_str() : nullptr; }
+    const ACHAR* value() const { return m_hasValue ? m_value.c_str() : nullptr; }
+    void setName(const ACHAR* pName)
+    {
+        m_hasName = pName != nullptr;
+        m_name = pName != nullptr ? pName : L"";
+    }
+    void setValue(const ACHAR* pValue)
+    {
+        m_hasValue = pValue != nullptr;
+        m_value = pValue != nullptr ? pValue : L"";
+    }
+
+private:
+    std::wstring m_name;
+    std::wstring m_value;
+    bool m_hasName = false;
+    bool m_hasValue = false;
+};
+
+typedef AcArray<AcNameValuePair> AcNameValuePairVec;
+
+class AcPlDSDEntry
+{
+public:
+    enum SetupType
+    {
+        kOriginalPS = 0,
+        kNPSSameDWG = 1,
+        kNPSOtherDWG = 2
+    };
+
+    const ACHAR* dwgName() const { return drawing.c_str(); }
+    void setDwgName(const ACHAR* pName) { drawing = pName; }
+    const ACHAR* layout() const { return layoutName.c_str(); }
+    void setLayout(const ACHAR* pLayoutName) { layoutName = pLayoutName; }
+    const ACHAR* title() const { return sheetTitle.c_str(); }
+    void setTitle(const ACHAR* pTitle) { sheetTitle = pTitle; }
+    const ACHAR* NPS() const { return pageSetup.c_str(); }
+    void setNPS(const ACHAR* pNPSName) { pageSetup = pNPSName; }
+    const ACHAR* NPSSourceDWG() const { return pageSetupDrawing.c_str(); }
+    void setNPSSourceDWG(const ACHAR* pDwgName) { pageSetupDrawing = pDwgName; }
+    SetupType setupType() const { return setup; }
+    void setSetupType(SetupType type) { setup = type; }
+    const ACHAR* orgSheetPath() const { return drawing.c_str(); }
+
+    std::wstring drawing;
+    std::wstring layoutName;
+    std::wstring sheetTitle;
+    std::wstring pageSetup;
+    std::wstring pageSetupDrawing;
+    SetupType setup = kOriginalPS;
+};
+
+typedef AcArray<AcPlDSDEntry, AcArrayObjectCopyReallocator<AcPlDSDEntry>> AcPlDSDEntries;
+
+class AcPlDSDData : public AcPlObject
+{
+public:
+    int numberOfDSDEntries() const { return entries.length(); }
+    AcPlDSDEntry& DSDEntryAt(int index) { return entries[index]; }
+    void getDSDEntries(AcPlDSDEntries& result) const { result = entries; }
+    const ACHAR* sheetSetName() const { return setName.c_str(); }
+    void getUnrecognizedData(AcStringArray& sectionArray, AcStringArray& dataArray) const
+    {
+        sectionArray = sections;
+        dataArray = data;
+    }
+
+    AcPlDSDEntries entries;
+    std::wstring setName;
+    AcStringArray sections;
+    AcStringArray data;
+};
+
+class AcPublishBeforeJobInfo
+{
+public:
+    virtual ~AcPublishBeforeJobInfo() {}
+
+    virtual const AcPlDSDData* GetDSDData() = 0;
+    virtual const AcNameValuePairVec GetPrivateData(const ACHAR* sectionName) = 0;
+    virtual bool WritePrivateSection(const ACHAR* sectionName, const AcNameValuePairVec nameValuePairVec) = 0;
+    virtual bool JobWillPublishInBackground() = 0;
+};
+
+class AcPublishBeginJobInfo
+{
+public:
+    virtual ~AcPublishBeginJobInfo() {}
+
+    virtual const AcPlDSDData* GetDSDData() = 0;
+    virtual const AcNameValuePairVec GetPrivateData(const ACHAR* sectionName) = 0;
+    virtual bool WritePrivateSection(const ACHAR* sectionName, const AcNameValuePairVec nameValuePairVec) = 0;
+    virtual bool JobWillPublishInBackground() = 0;
+    virtual AcPlPlotLogger* GetPlotLogger() = 0;
+};
+
+class AcPublishSheetInfo
+{
+public:
+    virtual ~AcPublishSheetInfo() {}
+
+    virtual const AcPlDSDEntry* GetDSDEntry() = 0;
+    virtual const ACHAR* GetUniqueId() = 0;
+    virtual AcPlPlotLogger* GetPlotLogger() = 0;
+};
+
+class AcPublishReactorInfo
+{
+public:
+    virtual ~AcPublishReactorInfo() {}
+};
+
+class AcPublishAggregationInfo
+{
+public:
+    virtual ~AcPublishAggregationInfo() {}
+};
+
+class AcPublishReactor : public AcRxObject
+{
+public:
+    virtual void OnAboutToBeginBackgroundPublishing(AcPublishBeforeJobInfo* pInfo) {}
+    virtual void OnAboutToBeginPublishing(AcPublishBeginJobInfo* pInfo) {}
+    virtual void OnBeginPublishingSheet(AcPublishSheetInfo* pInfo) {}
+    virtual void OnBeginAggregation(AcPublishAggregationInfo* pInfo) {}
+    virtual void OnAboutToEndPublishing(AcPublishReactorInfo* pInfo) {}
+    virtual void OnAboutToMoveFile(AcPublishReactorInfo* pInfo) {}
+    virtual void OnEndPublish(AcPublishReactorInfo* pInfo) {}
+    virtual void OnCancelledOrFailedPublishing(AcPublishReactorInfo* pInfo) {}
+
+protected:
+    AcPublishReactor() {}
+};
+
+typedef void (*ACGLOBADDPUBLISHREACTOR)(AcPublishReactor*);
+typedef void (*ACGLOBREMOVEPUBLISHREACTOR)(AcPublishReactor*);
+
+/* Metadata ----------------------------------------------------------------- */
+
+class AcDMMEPlotProperty
+{
+public:
+    AcDMMEPlotProperty() {}
+    AcDMMEPlotProperty(const wchar_t* name, const wchar_t* value)
+    {
+        SetName(name);
+        SetValue(value);
+    }
+
+    const wchar_t* GetName() const { return m_name.c_str(); }
+    void SetName(const wchar_t* name) { m_name = name != nullptr ? name : L""; }
+    const wchar_t* GetValue() const { return m_hasValue ? m_value.c_str() : nullptr; }
+    void SetValue(const wchar_t* value)
+    {
+        m_hasValue = value != nullptr;
+        m_value = value != nullptr ? value : L"";
+    }
+    const wchar_t* GetCategory() const { return m_category.c_str(); }
+    void SetCategory(const wchar_t* category) { m_category = category != nullptr ? category : L""; }
+    const wchar_t* GetType() const { return m_type.c_str(); }
+    void SetType(const wchar_t* type) { m_type = type != nullptr ? type : L""; }
+    const wchar_t* GetUnits() const { return m_units.c_str(); }
+    void SetUnits(const wchar_t* units) { m_units = units != nullptr ? units : L""; }
+
+private:
+    std::wstring m_name;
+    std::wstring m_value;
+    std::wstring m_category;
+    std::wstring m_type;
+    std::wstring m_units;
+    bool m_hasValue = false;
+};
+
+typedef AcArray<AcDMMEPlotProperty> AcDMMEPlotPropertyVec;
+
+class AcDMMResourceInfo
+{
+public:
+    AcDMMResourceInfo() {}
+    AcDMMResourceInfo(const wchar_t* role, const wchar_t* mime, const wchar_t* path)
+        : m_role(role), m_mime(mime), m_path(path)
+    {
+    }
+
+    const wchar_t* GetRole() const { return m_role.c_str(); }
+    const wchar_t* GetMime() const { return m_mime.c_str(); }
+    const wchar_t* GetPath() const { return m_path.c_str(); }
+
+private:
+    std::wstring m_role;
+    std::wstring m_mime;
+    std::wstring m_path;
+};
+
+typedef AcArray<AcDMMResourceInfo> AcDMMResourceVec;
+
+class AcDMMSheetReactorInfo
+{
+public:
+    virtual ~AcDMMSheetReactorInfo() {}
+
+    virtual void AddPageProperties(AcDMMEPlotPropertyVec properties) = 0;
+    virtual void AddPageResources(AcDMMResourceVec resources) = 0;
+};
+
+class AcDMMEntityReactorInfo;
+
+class AcDMMReactor : public AcRxObject
+{
+public:
+    virtual void OnBeginSheet(AcDMMSheetReactorInfo* pInfo) {}
+    virtual void OnBeginEntity(AcDMMEntityReactorInfo* pInfo) {}
+    virtual void OnEndEntity(AcDMMEntityReactorInfo* pInfo) {}
+    virtual void OnEndSheet(AcDMMSheetReactorInfo* pInfo) {}
+    virtual ~AcDMMReactor() {}
+
+protected:
+    AcDMMReactor() {}
+};
+
+typedef void (*ACGLOBADDDMMREACTOR)(AcDMMReactor*);
+typedef void (*ACGLOBREMOVEDMMREACTOR)(AcDMMReactor*);
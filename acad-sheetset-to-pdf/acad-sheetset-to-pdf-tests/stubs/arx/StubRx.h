@@ -0,0 +1,321 @@
+#pragma once
+
+/*
+ * Stand-ins for the ObjectARX runtime basics: character and integer types,
+ * error statuses, AcString, AcArray, the application class and the editor
+ * functions the commands call.  Only what the modules use is declared, with
+ * the SDK's signatures; behaviour is the simplest that lets the modules run.
+ */
+
+#include <cstdarg>
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+typedef wchar_t ACHAR;
+#define ACRX_T(x) L##x
+#define _T(x) L##x
+
+#define ACDB_PORT
+#define ADESK_NO_VTABLE
+#define ADESK_UNREFED_PARAM(x) (void)(x)
+
+namespace Adesk {
+typedef int8_t Int8;
+typedef uint8_t UInt8;
+typedef int16_t Int16;
+typedef uint16_t UInt16;
+typedef int32_t Int32;
+typedef uint32_t UInt32;
+typedef int64_t Int64;
+typedef uint64_t UInt64;
+typedef int64_t IntDbId;
+typedef intptr_t IntPtr;
+typedef uintptr_t UIntPtr;
+typedef intptr_t LongPtr;
+typedef bool Boolean;
+const bool kTrue = true;
+const bool kFalse = false;
+} // namespace Adesk
+
+namespace Acad {
+enum ErrorStatus
+{
+    eOk,
+    eNotImplemented,
+    eNotApplicable,
+    eInvalidInput,
+    eOutOfMemory,
+    eBufferTooSmall,
+    eKeyNotFound,
+    eDuplicateKey,
+    eInvalidIndex,
+    eInvalidExtents,
+    eWrongObjectType,
+    eInvalidDwgVersion,
+    eEndOfFile,
+    eFileAccessErr,
+    eFileSystemErr,
+    eFileNotFound,
+    eOutOfRange,
+    eUserBreak,
+    eNullPtr,
+    eNullObjectPointer,
+    eInvalidPlotInfo,
+    eUnsupportedFileFormat,
+    eFileSharingViolation,
+    eNotHandled,
+    eDataTooLarge,
+    eAlreadyActive,
+    eNotInitializedYet,
+    eInvalidContext,
+    eStringTooLong,
+    eDeviceNotFound,
+    eNotOpenForRead,
+    eNotOpenForWrite,
+    eMakeMeProxy,
+    eIsWriting,
+    eWasErased,
+    eDwgObjectImproperlyRead,
+    eBadDxfSequence,
+    eInetFileGenericError,
+    eDwgCRCDoesNotMatch,
+    eInvalidEngineState,
+    ePlotCancelled,
+    ePageCancelled,
+    eFileInternalErr
+};
+} // namespace Acad
+
+/// <summary>
+/// The name of es, as AutoCAD's acadErrorStatusText gives it for the
+/// statuses the tests look at, and "eError" for the others.
+/// </summary>
+const ACHAR* acadErrorStatusText(Acad::ErrorStatus es);
+
+class AcRxObject
+{
+public:
+    virtual ~AcRxObject() {}
+};
+
+struct AcRx
+{
+    enum AppMsgCode
+    {
+        kInitAppMsg,
+        kUnloadAppMsg
+    };
+    enum AppRetCode
+    {
+        kRetOK
+    };
+};
+
+class AcRxArxApp
+{
+public:
+    virtual ~AcRxArxApp() {}
+    virtual AcRx::AppRetCode On_kInitAppMsg(void*) { return AcRx::kRetOK; }
+    virtual AcRx::AppRetCode On_kUnloadAppMsg(void*) { return AcRx::kRetOK; }
+    virtual void RegisterServerComponents() = 0;
+};
+
+/* Also hands the application to arx_stubs, for a test to load and unload. */
+#define IMPLEMENT_ARX_ENTRYPOINT(classname)                                                                      \
+    classname s_entryPointObject;                                                                              \
+    static const bool s_entryPointRegistered = (arx_stubs::registerApplication(&s_entryPointObject), true);
+
+/* The module instance, as the SDK's entry point support declares it. */
+extern HINSTANCE _hdllInstance;
+
+bool acrxServiceIsRegistered(const ACHAR* serviceName);
+int acrxLoadModule(const ACHAR* moduleName, bool printit, bool asCmd);
+
+class AcString
+{
+public:
+    AcString() {}
+    AcString(const wchar_t* p) : m_string(p != nullptr ? p : L"") {}
+    AcString(const wchar_t* p, Adesk::UInt32 length) : m_string(p, std::find(p, p + length, L'\0')) {}
+
+    const wchar_t* kwszPtr() const { return m_string.c_str(); }
+    const wchar_t* constPtr() const { return m_string.c_str(); }
+    operator const wchar_t*() const { return m_string.c_str(); }
+
+    bool isEmpty() const { return m_string.empty(); }
+    int length() const { return static_cast<int>(m_string.size()); }
+
+    AcString& operator=(const wchar_t* p)
+    {
+        m_string = p != nullptr ? p : L"";
+        return *this;
+    }
+    AcString& operator+=(const wchar_t* p)
+    {
+        m_string += p;
+        return *this;
+    }
+    bool operator==(const AcString& other) const { return m_string == other.m_string; }
+    bool operator==(const wchar_t* p) const { return m_string == (p != nullptr ? p : L""); }
+    bool operator<(const AcString& other) const { return m_string < other.m_string; }
+
+    AcString& setEmpty()
+    {
+        m_string.clear();
+        return *this;
+    }
+
+    /// <summary>
+    /// Formats as on Windows, where %s in a wide format is a wide string.
+    /// </summary>
+    AcString& format(const wchar_t* format, ...);
+
+    int findRev(wchar_t c) const
+    {
+        const size_t index = m_string.rfind(c);
+        return index == std::wstring::npos ? -1 : static_cast<int>(index);
+    }
+
+    AcString substr(int count) const { return AcString(m_string.substr(0, count).c_str()); }
+
+private:
+    std::wstring m_string;
+};
+
+/// <summary>
+/// AcArray over a std::vector, with the members the modules use.
+/// </summary>
+template <class T, class R = void>
+class AcArray
+{
+public:
+    AcArray(int = 0, int = 8) {}
+
+    int length() const { return static_cast<int>(m_items.size()); }
+    int logicalLength() const { return static_cast<int>(m_items.size()); }
+    bool isEmpty() const { return m_items.empty(); }
+
+    T& operator[](int i) { return m_items[i]; }
+    const T& operator[](int i) const { return m_items[i]; }
+    T& at(int i) { return m_items[i]; }
+    const T& at(int i) const { return m_items[i]; }
+    bool operator==(const AcArray& other) const { return m_items == other.m_items; }
+
+    AcArray& append(const T& item)
+    {
+        m_items.push_back(item);
+        return *this;
+    }
+    AcArray& append(const AcArray& other)
+    {
+        m_items.insert(m_items.end(), other.m_items.begin(), other.m_items.end());
+        return *this;
+    }
+    AcArray& setLogicalLength(int length)
+    {
+        m_items.resize(length);
+        return *this;
+    }
+    AcArray& setPhysicalLength(int length)
+    {
+        m_items.reserve(length);
+        return *this;
+    }
+    AcArray& removeAll()
+    {
+        m_items.clear();
+        return *this;
+    }
+
+    T* asArrayPtr() { return m_items.data(); }
+    const T* asArrayPtr() const { return m_items.data(); }
+    T* begin() { return m_items.data(); }
+    T* end() { return m_items.data() + m_items.size(); }
+    const T* begin() const { return m_items.data(); }
+    const T* end() const { return m_items.data() + m_items.size(); }
+
+private:
+    std::vector<T> m_items;
+};
+
+template <class T>
+class AcArrayObjectCopyReallocator
+{
+};
+
+typedef AcArray<AcString> AcStringArray;
+
+inline void acutDelString(wchar_t*& p)
+{
+    delete[] p;
+    p = nullptr;
+}
+
+/* Editor ------------------------------------------------------------------ */
+
+#define RTNORM 5100
+#define RTCAN (-5002)
+
+#define ACRX_CMD_MODAL 0
+#define ACRX_CMD_SESSION 0x200000
+
+/// <summary>
+/// Writes to standard output; %s is a wide string, as on Windows.
+/// </summary>
+int acutPrintf(const ACHAR* format, ...);
+
+/// <summary>
+/// Answers with the next string queued by arx_stubs::queueEditorInput, or
+/// returns RTCAN when there is none.
+/// </summary>
+int acedGetString(int cronly, const ACHAR* prompt, AcString& result);
+
+struct _ARXCOMMAND_ENTRY
+{
+    const ACHAR* group;
+    const ACHAR* globalName;
+    const ACHAR* localName;
+    int flags;
+    void (*function)();
+    void* pUIContext;
+    unsigned id;
+};
+
+/* Also hands the command to arx_stubs, for a test to run. */
+#define ACED_ARXCOMMAND_ENTRY_AUTO(classname, group, globCmd, locCmd, cmdFlags, UIContext)                     \
+    static _ARXCOMMAND_ENTRY s_arxCommand_##group##globCmd = {ACRX_T(#group), ACRX_T(#globCmd), ACRX_T(#locCmd), \
+                                                              cmdFlags, classname::group##globCmd, UIContext, 0};   \
+    static const bool s_arxCommandRegistered_##group##globCmd =                                                 \
+        (arx_stubs::registerCommand(&s_arxCommand_##group##globCmd), true);
+
+namespace arx_stubs {
+
+/// <summary>
+/// Queues answer for the next acedGetString call.
+/// </summary>
+void queueEditorInput(const ACHAR* answer);
+
+/// <summary>
+/// Called by IMPLEMENT_ARX_ENTRYPOINT and ACED_ARXCOMMAND_ENTRY_AUTO while
+/// the module's statics are constructed.
+/// </summary>
+void registerApplication(AcRxArxApp* pApp);
+void registerCommand(const _ARXCOMMAND_ENTRY* pCommand);
+
+/// <summary>
+/// Sends the module's application kInitAppMsg or kUnloadAppMsg, as AutoCAD
+/// does when it loads or unloads the module.  False if there is none.
+/// </summary>
+bool sendAppMessage(AcRx::AppMsgCode message);
+
+/// <summary>
+/// Runs the command registered under globalName, as typing it would.  False
+/// if there is none.
+/// </summary>
+bool runCommand(const ACHAR* globalName);
+
+} // namespace arx_stubs
@@ -0,0 +1,196 @@
+#pragma once
+
+/*
+ * AcRxValue and AcRxValueType as the modules see them.  Like the SDK's, an
+ * AcRxValue keeps values of up to 24 bytes inline and boxes larger ones on
+ * the heap, so the costs the modules avoid by not making AcRxValues are
+ * there to measure.  Every type has one AcRxValueType, and two types are
+ * equal when they are the same object.
+ */
+
+#include <new>
+#include <type_traits>
+
+class AcRxValueType
+{
+public:
+    template <class T>
+    struct Desc
+    {
+        static const AcRxValueType& value();
+    };
+
+    bool operator==(const AcRxValueType& other) const { return this == &other; }
+    bool operator!=(const AcRxValueType& other) const { return this != &other; }
+
+    size_t size;
+    void* (*clone)(const void* pValue);
+    void (*destroy)(void* pValue);
+    void (*format)(const void* pValue, std::wstring& text);
+};
+
+namespace arx_stubs {
+
+template <class T>
+void* cloneRxValue(const void* pValue)
+{
+    return new T(*static_cast<const T*>(pValue));
+}
+
+template <class T>
+void destroyRxValue(void* pValue)
+{
+    delete static_cast<T*>(pValue);
+}
+
+/// <summary>
+/// The text AcRxValue::toString makes: True or False, numbers in full, the
+/// string itself, and "<value>" for everything else.
+/// </summary>
+template <class T>
+void formatRxValue(const void* pValue, std::wstring& text)
+{
+    if constexpr (std::is_same<T, bool>::value)
+        text = *static_cast<const bool*>(pValue) ? L"True" : L"False";
+    else if constexpr (std::is_arithmetic<T>::value)
+        text = std::to_wstring(*static_cast<const T*>(pValue));
+    else if constexpr (std::is_same<T, const wchar_t*>::value)
+        text = *static_cast<const wchar_t* const*>(pValue);
+    else
+        text = L"<value>";
+}
+
+} // namespace arx_stubs
+
+template <class T>
+const AcRxValueType& AcRxValueType::Desc<T>::value()
+{
+    static const AcRxValueType s_type = {sizeof(T), &arx_stubs::cloneRxValue<T>, &arx_stubs::destroyRxValue<T>,
+                                         &arx_stubs::formatRxValue<T>};
+    return s_type;
+}
+
+template <>
+inline const AcRxValueType& AcRxValueType::Desc<void>::value()
+{
+    static const AcRxValueType s_type = {0, nullptr, nullptr, nullptr};
+    return s_type;
+}
+
+class AcRxValue
+{
+public:
+    AcRxValue() : m_pType(&AcRxValueType::Desc<void>::value()) { std::memset(m_inline, 0, sizeof(m_inline)); }
+
+    template <class T>
+    AcRxValue(const T& value) : m_pType(&AcRxValueType::Desc<T>::value())
+    {
+        if constexpr (sizeof(T) <= kInlineSize)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "inline AcRxValues are copied bytewise");
+            std::memcpy(m_inline, &value, sizeof(T));
+        }
+        else
+        {
+            m_pBoxed = new T(value);
+        }
+    }
+
+    /// <summary>
+    /// A string value, which keeps its own copy of the string.
+    /// </summary>
+    AcRxValue(const AcString& value)
+        : m_pType(&AcRxValueType::Desc<const wchar_t*>::value()), m_pString(new std::wstring(value.kwszPtr()))
+    {
+        pointAtString();
+    }
+
+    AcRxValue(const AcRxValue& other) : m_pType(other.m_pType)
+    {
+        if (other.m_pString != nullptr)
+        {
+            m_pString = new std::wstring(*other.m_pString);
+            pointAtString();
+        }
+        else if (isInline())
+        {
+            std::memcpy(m_inline, other.m_inline, sizeof(m_inline));
+        }
+        else
+        {
+            m_pBoxed = m_pType->clone(other.m_pBoxed);
+        }
+    }
+
+    ~AcRxValue()
+    {
+        delete m_pString;
+        if (!isInline())
+            m_pType->destroy(m_pBoxed);
+    }
+
+    AcRxValue& operator=(const AcRxValue& other)
+    {
+        if (this != &other)
+        {
+            this->~AcRxValue();
+            new (this) AcRxValue(other);
+        }
+        return *this;
+    }
+
+    const AcRxValueType& type() const { return *m_pType; }
+    bool isEmpty() const { return m_pType == &AcRxValueType::Desc<void>::value(); }
+    static const AcRxValue& empty()
+    {
+        static const AcRxValue s_empty;
+        return s_empty;
+    }
+
+    const void* valuePtr() const { return isInline() ? static_cast<const void*>(m_inline) : m_pBoxed; }
+
+    /// <summary>
+    /// Copies as much of the text of the value as fits in buffer, and
+    /// returns the length of the whole text.
+    /// </summary>
+    int toString(ACHAR* buffer, size_t size) const
+    {
+        std::wstring text;
+        if (!isEmpty())
+            m_pType->format(valuePtr(), text);
+        if (buffer != nullptr && size > 0)
+        {
+            const size_t length = std::min(size - 1, text.size());
+            std::wmemcpy(buffer, text.c_str(), length);
+            buffer[length] = L'\0';
+        }
+        return static_cast<int>(text.size());
+    }
+
+private:
+    static const size_t kInlineSize = 24;
+
+    bool isInline() const { return m_pType->size <= kInlineSize; }
+
+    void pointAtString()
+    {
+        const wchar_t* pText = m_pString->c_str();
+        std::memcpy(m_inline, &pText, sizeof(pText));
+    }
+
+    const AcRxValueType* m_pType;
+    union
+    {
+        void* m_pBoxed;
+        alignas(8) unsigned char m_inline[kInlineSize];
+    };
+    std::wstring* m_pString = nullptr;
+};
+
+template <class T>
+const T* rxvalue_cast(const AcRxValue* pValue)
+{
+    return pValue != nullptr && pValue->type() == AcRxValueType::Desc<T>::value()
+               ? static_cast<const T*>(pValue->valuePtr())
+               : nullptr;
+}
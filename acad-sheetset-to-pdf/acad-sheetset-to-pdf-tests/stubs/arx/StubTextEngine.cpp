@@ -0,0 +1,161 @@
+#include <windows.h>
+
+#include "arxHeaders.h"
+#include "StubTextEngine.h"
+
+#include <cwctype>
+
+namespace {
+
+volatile double s_lookupSink;
+
+/// <summary>
+/// Spends about the time a lookup of count table entries would.
+/// </summary>
+void lookUp(int count, double seed)
+{
+    double sum = 0;
+    for (int k = 0; k < count; ++k)
+        sum += std::sqrt(static_cast<double>(k) + seed);
+    s_lookupSink = sum;
+}
+
+void drawGlyph(const AcGiTextStyle& ts, wchar_t c, double deviation, double pen, std::vector<int>& counts,
+               std::vector<AcGePoint3d>& points)
+{
+    const int strokes = 1 + c % 3;
+    const int segments = std::max(2, static_cast<int>(std::ceil(1.0 / std::sqrt(std::max(deviation, 1e-6)))));
+    const double shear = std::tan(ts.obliquingAngle());
+    for (int s = 0; s < strokes; ++s)
+    {
+        counts.push_back(segments);
+        for (int i = 0; i < segments; ++i)
+        {
+            const double angle = (s + 1) * 0.7 + i * 3.0 / segments + c * 0.01;
+            const double x = 0.3 + 0.25 * std::cos(angle) * ts.xScale();
+            const double y = 0.5 + 0.45 * std::sin(angle * 1.3);
+            points.emplace_back(pen + x + y * shear, y, 0);
+        }
+    }
+}
+
+} // namespace
+
+AcGiTextEngine* AcGiTextEngine::create()
+{
+    return new StubTextEngine();
+}
+
+double StubTextEngine::advanceOf(const AcGiTextStyle& ts, wchar_t c)
+{
+    return (0.6 + (c % 5) * 0.1) * ts.xScale() * ts.trackingPercent();
+}
+
+void StubTextEngine::getExtents(AcGiTextStyle& ts, ACHAR const* pStr, int nLength, bool bPenUp, bool bRaw,
+                                AcGePoint2d& extents)
+{
+    ++extentCalls;
+    if (nLength < 0)
+        nLength = static_cast<int>(std::wcslen(pStr));
+    lookUp(40, nLength);
+
+    double pen = 0;
+    double right = 0;
+    double top = 0;
+    for (int i = 0; i < nLength; ++i)
+    {
+        lookUp(8, pStr[i]);
+        double advance = advanceOf(ts, pStr[i]);
+        if (kerning && i > 0 && pStr[i - 1] == L'A')
+            advance -= 0.05;
+        right = std::max(right, pen + advance * 0.9);
+        top = std::max(top, bPenUp ? 1.0 : 0.7 + (pStr[i] % 4) * 0.1);
+        pen += advance;
+    }
+    extents.set(bPenUp ? std::max(pen, right) : right, top);
+}
+
+void StubTextEngine::tessellate(AcGiTextStyle& ts, ACHAR const* pStr, int nLength, bool bRaw, double deviation,
+                                void* pVoid, PolylineCallback pPolylineCallback)
+{
+    if (nLength < 0)
+        nLength = static_cast<int>(std::wcslen(pStr));
+    if (nLength == 1)
+        ++glyphCalls;
+    else
+        ++stringCalls;
+
+    /* Expand %% codes, noting where each score toggles: 0 overline,
+       1 underline, 2 strikethrough. */
+    std::wstring text;
+    std::vector<std::pair<size_t, int>> toggles;
+    for (int i = 0; i < nLength;)
+    {
+        if (!bRaw && i + 2 < nLength && pStr[i] == L'%' && pStr[i + 1] == L'%')
+        {
+            const wchar_t code = static_cast<wchar_t>(std::towlower(pStr[i + 2]));
+            if (code == L'o' || code == L'u' || code == L'k')
+            {
+                toggles.emplace_back(text.size(), code == L'o' ? 0 : code == L'u' ? 1 : 2);
+                i += 3;
+                continue;
+            }
+            if (code == L'd' || code == L'p' || code == L'%')
+            {
+                text += code == L'd' ? wchar_t(0xB0) : code == L'p' ? wchar_t(0xB1) : L'%';
+                i += 3;
+                continue;
+            }
+            if (i + 4 < nLength && std::iswdigit(pStr[i + 2]) && std::iswdigit(pStr[i + 3]) &&
+                std::iswdigit(pStr[i + 4]))
+            {
+                text += static_cast<wchar_t>((pStr[i + 2] - L'0') * 100 + (pStr[i + 3] - L'0') * 10 +
+                                             (pStr[i + 4] - L'0'));
+                i += 5;
+                continue;
+            }
+        }
+        text += pStr[i++];
+    }
+
+    std::vector<int> counts;
+    std::vector<AcGePoint3d> points;
+    std::vector<double> pens;
+    double pen = 0;
+    for (wchar_t c : text)
+    {
+        pens.push_back(pen);
+        drawGlyph(ts, c, deviation, pen, counts, points);
+        pen += advanceOf(ts, c);
+    }
+    pens.push_back(pen);
+
+    const double heights[3] = {1.2, -0.2, 0.5};
+    const double shear = std::tan(ts.obliquingAngle());
+    size_t starts[3] = {0, 0, 0};
+    bool scoring[3] = {false, false, false};
+    const auto drawScore = [&](int score, size_t begin, size_t end) {
+        if (end <= begin)
+            return;
+        const double y = heights[score];
+        counts.push_back(2);
+        points.emplace_back(pens[begin] + y * shear, y, 0);
+        points.emplace_back(pens[end] + y * shear, y, 0);
+    };
+    for (const auto& toggle : toggles)
+    {
+        if (scoring[toggle.second])
+            drawScore(toggle.second, starts[toggle.second], toggle.first);
+        else
+            starts[toggle.second] = toggle.first;
+        scoring[toggle.second] = !scoring[toggle.second];
+    }
+    for (int score = 0; score < 3; ++score)
+    {
+        if (scoring[score])
+            drawScore(score, starts[score], text.size());
+    }
+
+    if (!counts.empty())
+        pPolylineCallback(static_cast<int>(counts.size()), counts.data(), points.data(), pVoid);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+/*
+ * A stand-in for AutoCAD's shape font engine.  Each glyph is a few strokes
+ * flattened to the deviation asked for, and every call first spends the
+ * time a font and shape lookup would, so the cost CachingTextEngine saves is
+ * there to measure.  Unless raw, %% codes are expanded and scored the way
+ * AutoCAD's engine does it: one pass to expand, then a line per stretch of
+ * each score at 1.2, -0.2 and 0.5 heights up, sheared by the obliquing angle.
+ */
+
+#include <atomic>
+
+#include "textengine.h"
+
+class StubTextEngine : public AcGiTextEngine
+{
+public:
+    void getExtents(AcGiTextStyle& ts, ACHAR const* pStr, int nLength, bool bPenUp, bool bRaw,
+                    AcGePoint2d& extents) override;
+    void tessellate(AcGiTextStyle& ts, ACHAR const* pStr, int nLength, bool bRaw, double deviation, void* pVoid,
+                    PolylineCallback pPolylineCallback) override;
+    void tessellate(AcGiTextStyle& ts, ACHAR const* pString, int nLength, bool bRaw, void* pVoid,
+                    UnicodeCallback pUnicodeCallback, PolylineCallback pPolylineCallback) override
+    {
+    }
+
+    /// <summary>
+    /// The pen advance of c.
+    /// </summary>
+    static double advanceOf(const AcGiTextStyle& ts, wchar_t c);
+
+    /* Calls made, for the tests to count: tessellations of one character and
+       of longer strings, and extents. */
+    std::atomic<long> glyphCalls{0};
+    std::atomic<long> stringCalls{0};
+    std::atomic<long> extentCalls{0};
+
+    /* Whether an A pulls the character after it 0.05 closer. */
+    bool kerning = false;
+};
@@ -0,0 +1,4 @@
+#pragma once
+
+// acdbGetHostDwgXrefGraph and the xref graph are declared with the other AcDb
+// stand-ins, in StubDb.h.
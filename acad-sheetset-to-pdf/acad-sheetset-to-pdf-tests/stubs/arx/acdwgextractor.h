@@ -0,0 +1,50 @@
+#pragma once
+
+/*
+ * The SDK's AcDwgExtractor event interfaces, with event arguments that
+ * keep what the reactor queues and adds for the tests to look at.
+ */
+
+#include <utility>
+
+namespace AcDwgExtractor {
+
+class BeginExtractionEventArgs
+{
+public:
+    Acad::ErrorStatus queueForExtraction(const AcDbObjectId& idObject, const AcString& viewableId)
+    {
+        queued.emplace_back(idObject, viewableId.kwszPtr());
+        return Acad::eOk;
+    }
+
+    std::vector<std::pair<AcDbObjectId, std::wstring>> queued;
+};
+
+class EndExtractionEventArgs
+{
+public:
+    Acad::ErrorStatus addProperty(const AcDbObjectId& idEntity, const AcString& propertyCategory,
+                                  const AcString& propertyName, const AcRxValue& propertyValue,
+                                  const AcString& units = L"", bool hidden = false)
+    {
+        ++propertyCount;
+        if (const double* pNumber = rxvalue_cast<double>(&propertyValue))
+            numberSum += *pNumber;
+        return Acad::eOk;
+    }
+
+    size_t propertyCount = 0;
+    double numberSum = 0;
+};
+
+class ExtractorReactor
+{
+public:
+    virtual ~ExtractorReactor() {}
+
+    virtual void beginExtraction(BeginExtractionEventArgs& args) = 0;
+    virtual void endExtraction(EndExtractionEventArgs& args) = 0;
+};
+
+} // namespace AcDwgExtractor
@@ -0,0 +1,61 @@
+#pragma once
+
+/*
+ * AcGiDrawStream with the SDK's members.  Its graphics are the bytes in
+ * stubGraphics, and AcGiDrawStream::build fills them in through
+ * arx_stubs::drawStreamBuilder, which a test can replace.  The default
+ * builder spends stubWork iterations on each stream, as regenerating a
+ * drawable would.
+ */
+
+#include "IAcReadWriteStream.h"
+
+class AcGiDrawStream;
+
+bool acdbBeginDrawStreamBuilding(AcGiDrawStream* pStream);
+void acdbEndDrawStreamBuilding(AcGiDrawStream* pStream);
+
+typedef bool (*GraphicsUpdateProc)(const AcArray<AcGiDrawable*>& drawableArray);
+
+class AcGiDrawStream : public AcGiDrawable
+{
+public:
+    static bool build(const AcArray<AcGiDrawStream*>& streamArray, GraphicsUpdateProc lpFunc);
+
+    AcGiDrawStream() {}
+    AcGiDrawStream(const AcGiDrawable* pOwner) : m_pOwner(pOwner) {}
+
+    AcGiDrawable* getOwner() const { return const_cast<AcGiDrawable*>(m_pOwner); }
+    void setOwner(const AcGiDrawable* pOwner) { m_pOwner = pOwner; }
+    bool isValid() const { return !stubGraphics.empty(); }
+
+    bool serializeOut(IAcWriteStream* pOutput) const;
+    bool serializeIn(IAcReadStream* pInput, AcDbDatabase* pDb = nullptr);
+
+    AcDbObjectId id() const override { return AcDbObjectId(); }
+
+    std::vector<unsigned char> stubGraphics;
+    bool stubBuilding = false;
+    unsigned stubWork = 0;
+
+private:
+    const AcGiDrawable* m_pOwner = nullptr;
+};
+
+namespace arx_stubs {
+
+typedef bool (*DrawStreamBuilder)(const AcArray<AcGiDrawStream*>& streamArray, GraphicsUpdateProc lpFunc);
+
+/// <summary>
+/// What AcGiDrawStream::build calls; buildDrawStreams unless a test sets
+/// another.
+/// </summary>
+extern DrawStreamBuilder drawStreamBuilder;
+
+/// <summary>
+/// Gives every stream in streamArray graphics made from its stubWork, and
+/// fails when one of them was not begun with acdbBeginDrawStreamBuilding.
+/// </summary>
+bool buildDrawStreams(const AcArray<AcGiDrawStream*>& streamArray, GraphicsUpdateProc lpFunc);
+
+} // namespace arx_stubs
@@ -0,0 +1,15 @@
+#pragma once
+
+/*
+ * What the modules get from the ObjectARX SDK, for building and testing
+ * them outside AutoCAD.  The stand-ins declare only what the modules use,
+ * with the SDK's names and signatures; see ObjectArx.cpp for what they do.
+ */
+
+#include "StubRx.h"
+#include "StubGe.h"
+#include "StubDb.h"
+#include "StubGi.h"
+#include "StubRxValue.h"
+#include "StubPlot.h"
+#include "StubPublish.h"
@@ -0,0 +1,3 @@
+#pragma once
+
+// AcGeBoundBlock3d is declared with the other AcGe stand-ins, in StubGe.h.
@@ -0,0 +1,45 @@
+#pragma once
+
+/*
+ * The SDK's AcGiLinetypeEngine.  AutoCAD's own engine is not available, so
+ * the base class tessellate overloads only count how often they are called,
+ * in stubBaseCalls; a test checks that CachingLinetypeEngine hands AutoCAD
+ * exactly the linetypes it cannot draw itself.
+ */
+
+class AcGiLinetypeEngine : public AcRxObject
+{
+public:
+    virtual Acad::ErrorStatus tessellate(bool bIsArc, bool bIsCircle, const Adesk::UInt32 nPoints,
+                                         const AcGePoint3d* pVertexList, AcGiWorldDraw* pWorldDraw,
+                                         const AcDbObjectId linetypeId, double linetypeScale,
+                                         const AcGeVector3d* pNormal, bool plineGen = false)
+    {
+        ++stubBaseCalls;
+        return Acad::eOk;
+    }
+    virtual Acad::ErrorStatus tessellate(bool bIsArc, bool bIsCircle, const Adesk::UInt32 nPoints,
+                                         const AcGePoint3d* pVertexList, AcGiViewportDraw* pViewportDraw,
+                                         const AcDbObjectId linetypeId, double linetypeScale,
+                                         const AcGeVector3d* pNormal, bool plineGen = false)
+    {
+        ++stubBaseCalls;
+        return Acad::eOk;
+    }
+    virtual Acad::ErrorStatus tessellate(const AcGeCircArc3d& arcSeg, const AcGeMatrix3d& ecsMat, double startWidth,
+                                         double endWidth, AcGiCommonDraw* pDraw, const AcDbObjectId linetypeId,
+                                         double linetypeScale, double thick)
+    {
+        ++stubBaseCalls;
+        return Acad::eOk;
+    }
+    virtual Acad::ErrorStatus tessellate(const AcGeLineSeg3d& lineSeg, const AcGeMatrix3d& ecsMat, double startWidth,
+                                         double endWidth, AcGiCommonDraw* pDraw, const AcDbObjectId linetypeId,
+                                         double linetypeScale)
+    {
+        ++stubBaseCalls;
+        return Acad::eOk;
+    }
+
+    static int stubBaseCalls;
+};
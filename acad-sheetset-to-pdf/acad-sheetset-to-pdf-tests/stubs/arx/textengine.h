@@ -0,0 +1,26 @@
+#pragma once
+
+/*
+ * The SDK's AcGiTextEngine interface.  AcGiTextEngine::create hands out a
+ * StubTextEngine, which draws made-up glyphs at the cost of a font lookup.
+ */
+
+class AcFontHandle;
+
+typedef void (*PolylineCallback)(int, int const*, AcGePoint3d const*, void*);
+typedef void (*UnicodeCallback)(AcFontHandle*, wchar_t const*, int, void*);
+
+class AcGiTextEngine
+{
+public:
+    static AcGiTextEngine* create();
+
+    virtual ~AcGiTextEngine() {}
+
+    virtual void getExtents(AcGiTextStyle& ts, ACHAR const* pStr, int nLength, bool bPenUp, bool bRaw,
+                            AcGePoint2d& extents) = 0;
+    virtual void tessellate(AcGiTextStyle& ts, ACHAR const* pStr, int nLength, bool bRaw, double deviation,
+                            void* pVoid, PolylineCallback pPolylineCallback) = 0;
+    virtual void tessellate(AcGiTextStyle& ts, ACHAR const* pString, int nLength, bool bRaw, void* pVoid,
+                            UnicodeCallback pUnicodeCallback, PolylineCallback pPolylineCallback) = 0;
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+/*
+ * The symbols and callback types of the SDK's truetypetext.h that the
+ * modules use.
+ */
+
+#define UC_DEGREE_SYMBOL 0x00B0
+#define UC_PLUSMINUS_SYMBOL 0x00B1
+#define UC_PHI_SYMBOL 0x00D8
+#define UC_DIAMETER_SYMBOL 0x2205
+
+typedef void (*LineSegmentCallback)(const AcGePoint3d&, const AcGePoint3d&, const void*);
+
+struct TextParams
+{
+    double height;
+    double width_scale;
+    double oblique_angle;
+    double rotation_angle;
+    double spacing;
+    short flags;
+    bool visible = true;
+};
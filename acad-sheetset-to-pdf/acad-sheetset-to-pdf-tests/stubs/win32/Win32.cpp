@@ -0,0 +1,571 @@
+/*
+ * POSIX implementations of the Win32 calls in windows.h.  A HANDLE is a
+ * StubHandle: an open file, a mapping of one, or a directory listing.
+ */
+
+#include "windows.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <cwctype>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct StubHandle
+{
+    enum Kind
+    {
+        kFile,
+        kMapping,
+        kFind
+    };
+
+    explicit StubHandle(Kind handleKind) : kind(handleKind) {}
+
+    Kind kind;
+    int fd = -1;
+    bool writable = false;
+    std::vector<std::pair<std::string, struct stat>> entries;
+    size_t nextEntry = 0;
+};
+
+thread_local DWORD s_lastError = ERROR_SUCCESS;
+
+std::map<const void*, size_t> s_views;
+std::mutex s_viewsMutex;
+
+std::vector<PVECTORED_EXCEPTION_HANDLER> s_exceptionHandlers;
+std::mutex s_exceptionHandlersMutex;
+
+/* Helpers ------------------------------------------------------------------ */
+
+BOOL fail(DWORD error)
+{
+    s_lastError = error;
+    return FALSE;
+}
+
+BOOL failFromErrno()
+{
+    switch (errno)
+    {
+    case ENOENT:
+        return fail(ERROR_FILE_NOT_FOUND);
+    case ENOTDIR:
+        return fail(ERROR_PATH_NOT_FOUND);
+    case ENOSPC:
+        return fail(ERROR_DISK_FULL);
+    case EROFS:
+        return fail(ERROR_WRITE_PROTECT);
+    case ENOMEM:
+        return fail(ERROR_NOT_ENOUGH_MEMORY);
+    case EIO:
+        return fail(ERROR_WRITE_FAULT);
+    default:
+        return fail(ERROR_ACCESS_DENIED);
+    }
+}
+
+std::string toUtf8(const wchar_t* pText)
+{
+    const int length = WideCharToMultiByte(CP_UTF8, 0, pText, -1, nullptr, 0, nullptr, nullptr);
+    std::string result(static_cast<size_t>(length), '\0');
+    WideCharToMultiByte(CP_UTF8, 0, pText, -1, &result[0], length, nullptr, nullptr);
+    result.resize(std::strlen(result.c_str()));
+    return result;
+}
+
+std::string toPath(const wchar_t* pPath)
+{
+    std::string path = toUtf8(pPath);
+    for (char& c : path)
+    {
+        if (c == '\\')
+            c = '/';
+    }
+    return path;
+}
+
+int fileDescriptor(HANDLE hFile)
+{
+    const StubHandle* pHandle = static_cast<const StubHandle*>(hFile);
+    return pHandle != nullptr && pHandle != INVALID_HANDLE_VALUE && pHandle->kind == StubHandle::kFile ? pHandle->fd
+                                                                                                      : -1;
+}
+
+/* FILETIME counts 100ns intervals; the Unix epoch is as good a start as 1601
+   for the comparisons the modules make. */
+FILETIME toFileTime(const struct timespec& time)
+{
+    const ULONGLONG ticks = static_cast<ULONGLONG>(time.tv_sec) * 10000000ull + time.tv_nsec / 100;
+    FILETIME result;
+    result.dwLowDateTime = static_cast<DWORD>(ticks);
+    result.dwHighDateTime = static_cast<DWORD>(ticks >> 32);
+    return result;
+}
+
+void fillAttributes(const struct stat& status, DWORD& attributes, FILETIME& lastWriteTime, DWORD& sizeHigh,
+                    DWORD& sizeLow)
+{
+    attributes = S_ISDIR(status.st_mode) ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_NORMAL;
+    lastWriteTime = toFileTime(status.st_mtim);
+    sizeHigh = static_cast<DWORD>(static_cast<ULONGLONG>(status.st_size) >> 32);
+    sizeLow = static_cast<DWORD>(status.st_size);
+}
+
+void fillFindData(const std::pair<std::string, struct stat>& entry, WIN32_FIND_DATAW* pFindData)
+{
+    *pFindData = WIN32_FIND_DATAW();
+    fillAttributes(entry.second, pFindData->dwFileAttributes, pFindData->ftLastWriteTime, pFindData->nFileSizeHigh,
+                   pFindData->nFileSizeLow);
+    MultiByteToWideChar(CP_UTF8, 0, entry.first.c_str(), static_cast<int>(entry.first.size()), pFindData->cFileName,
+                        259);
+}
+
+/// <summary>
+/// Matches the masks the modules use: "*", "*suffix" and exact names.
+/// </summary>
+bool matchesMask(const std::string& name, const std::string& mask)
+{
+    if (mask.empty() || mask[0] != '*')
+        return name == mask;
+    const std::string suffix = mask.substr(1);
+    return name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+} // namespace
+
+/* Files -------------------------------------------------------------------- */
+
+DWORD GetLastError()
+{
+    return s_lastError;
+}
+
+HANDLE CreateFileW(const wchar_t* pFileName, DWORD desiredAccess, DWORD shareMode, void* pSecurityAttributes,
+                   DWORD creationDisposition, DWORD flagsAndAttributes, HANDLE hTemplateFile)
+{
+    const bool read = (desiredAccess & GENERIC_READ) != 0;
+    const bool write = (desiredAccess & (GENERIC_WRITE | FILE_WRITE_DATA | FILE_APPEND_DATA)) != 0;
+
+    int flags = read && write ? O_RDWR : write ? O_WRONLY : O_RDONLY;
+    if ((desiredAccess & FILE_APPEND_DATA) != 0 && (desiredAccess & (GENERIC_WRITE | FILE_WRITE_DATA)) == 0)
+        flags |= O_APPEND;
+    if (creationDisposition == CREATE_ALWAYS)
+        flags |= O_CREAT | O_TRUNC;
+    else if (creationDisposition == OPEN_ALWAYS)
+        flags |= O_CREAT;
+
+    const int fd = ::open(toPath(pFileName).c_str(), flags | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        failFromErrno();
+        return INVALID_HANDLE_VALUE;
+    }
+
+    StubHandle* pHandle = new StubHandle(StubHandle::kFile);
+    pHandle->fd = fd;
+    pHandle->writable = write;
+    s_lastError = ERROR_SUCCESS;
+    return pHandle;
+}
+
+BOOL CloseHandle(HANDLE hObject)
+{
+    StubHandle* pHandle = static_cast<StubHandle*>(hObject);
+    if (pHandle == nullptr || pHandle == INVALID_HANDLE_VALUE)
+        return fail(ERROR_ACCESS_DENIED);
+    const bool closed = pHandle->kind != StubHandle::kFile || ::close(pHandle->fd) == 0;
+    delete pHandle;
+    return closed ? TRUE : failFromErrno();
+}
+
+BOOL WriteFile(HANDLE hFile, const void* pBuffer, DWORD bytesToWrite, DWORD* pBytesWritten, OVERLAPPED* pOverlapped)
+{
+    const ssize_t written = ::write(fileDescriptor(hFile), pBuffer, bytesToWrite);
+    if (written < 0)
+        return failFromErrno();
+    if (pBytesWritten != nullptr)
+        *pBytesWritten = static_cast<DWORD>(written);
+    return TRUE;
+}
+
+BOOL ReadFile(HANDLE hFile, void* pBuffer, DWORD bytesToRead, DWORD* pBytesRead, OVERLAPPED* pOverlapped)
+{
+    const ssize_t read = ::read(fileDescriptor(hFile), pBuffer, bytesToRead);
+    if (read < 0)
+        return failFromErrno();
+    if (pBytesRead != nullptr)
+        *pBytesRead = static_cast<DWORD>(read);
+    return TRUE;
+}
+
+BOOL FlushFileBuffers(HANDLE hFile)
+{
+    return ::fsync(fileDescriptor(hFile)) == 0 ? TRUE : failFromErrno();
+}
+
+BOOL GetFileSizeEx(HANDLE hFile, LARGE_INTEGER* pFileSize)
+{
+    struct stat status;
+    if (::fstat(fileDescriptor(hFile), &status) != 0)
+        return failFromErrno();
+    pFileSize->QuadPart = status.st_size;
+    return TRUE;
+}
+
+BOOL SetFilePointerEx(HANDLE hFile, LARGE_INTEGER distance, LARGE_INTEGER* pNewPointer, DWORD moveMethod)
+{
+    const int whence = moveMethod == FILE_BEGIN ? SEEK_SET : moveMethod == FILE_CURRENT ? SEEK_CUR : SEEK_END;
+    const off_t position = ::lseek(fileDescriptor(hFile), distance.QuadPart, whence);
+    if (position < 0)
+        return failFromErrno();
+    if (pNewPointer != nullptr)
+        pNewPointer->QuadPart = position;
+    return TRUE;
+}
+
+BOOL SetEndOfFile(HANDLE hFile)
+{
+    const int fd = fileDescriptor(hFile);
+    const off_t position = ::lseek(fd, 0, SEEK_CUR);
+    return position >= 0 && ::ftruncate(fd, position) == 0 ? TRUE : failFromErrno();
+}
+
+BOOL SetFileTime(HANDLE hFile, const FILETIME* pCreationTime, const FILETIME* pLastAccessTime,
+                 const FILETIME* pLastWriteTime)
+{
+    struct timespec times[2];
+    times[0].tv_sec = 0;
+    times[0].tv_nsec = UTIME_OMIT;
+    times[1].tv_sec = 0;
+    times[1].tv_nsec = UTIME_OMIT;
+    if (pLastWriteTime != nullptr)
+    {
+        const ULONGLONG ticks =
+            (static_cast<ULONGLONG>(pLastWriteTime->dwHighDateTime) << 32) | pLastWriteTime->dwLowDateTime;
+        times[1].tv_sec = static_cast<time_t>(ticks / 10000000ull);
+        times[1].tv_nsec = static_cast<long>((ticks % 10000000ull) * 100);
+    }
+    return ::futimens(fileDescriptor(hFile), times) == 0 ? TRUE : failFromErrno();
+}
+
+BOOL MoveFileExW(const wchar_t* pExistingFileName, const wchar_t* pNewFileName, DWORD flags)
+{
+    const std::string target = toPath(pNewFileName);
+    if ((flags & MOVEFILE_REPLACE_EXISTING) == 0 && ::access(target.c_str(), F_OK) == 0)
+        return fail(ERROR_ALREADY_EXISTS);
+    return ::rename(toPath(pExistingFileName).c_str(), target.c_str()) == 0 ? TRUE : failFromErrno();
+}
+
+BOOL DeleteFileW(const wchar_t* pFileName)
+{
+    return ::unlink(toPath(pFileName).c_str()) == 0 ? TRUE : failFromErrno();
+}
+
+BOOL GetFileAttributesExW(const wchar_t* pFileName, GET_FILEEX_INFO_LEVELS infoLevel, void* pFileInformation)
+{
+    struct stat status;
+    if (::stat(toPath(pFileName).c_str(), &status) != 0)
+        return failFromErrno();
+    WIN32_FILE_ATTRIBUTE_DATA* pData = static_cast<WIN32_FILE_ATTRIBUTE_DATA*>(pFileInformation);
+    *pData = WIN32_FILE_ATTRIBUTE_DATA();
+    fillAttributes(status, pData->dwFileAttributes, pData->ftLastWriteTime, pData->nFileSizeHigh,
+                   pData->nFileSizeLow);
+    return TRUE;
+}
+
+HANDLE FindFirstFileW(const wchar_t* pFileName, WIN32_FIND_DATAW* pFindData)
+{
+    const std::string pattern = toPath(pFileName);
+    const size_t slash = pattern.rfind('/');
+    const std::string directory = slash == std::string::npos ? "." : pattern.substr(0, slash);
+    const std::string mask = slash == std::string::npos ? pattern : pattern.substr(slash + 1);
+
+    DIR* pDirectory = ::opendir(directory.c_str());
+    if (pDirectory == nullptr)
+    {
+        fail(ERROR_PATH_NOT_FOUND);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    StubHandle* pHandle = new StubHandle(StubHandle::kFind);
+    while (const dirent* pEntry = ::readdir(pDirectory))
+    {
+        const std::string name = pEntry->d_name;
+        struct stat status;
+        if (matchesMask(name, mask) && ::stat((directory + "/" + name).c_str(), &status) == 0)
+            pHandle->entries.emplace_back(name, status);
+    }
+    ::closedir(pDirectory);
+
+    if (pHandle->entries.empty())
+    {
+        delete pHandle;
+        fail(ERROR_FILE_NOT_FOUND);
+        return INVALID_HANDLE_VALUE;
+    }
+    fillFindData(pHandle->entries[0], pFindData);
+    pHandle->nextEntry = 1;
+    return pHandle;
+}
+
+BOOL FindNextFileW(HANDLE hFindFile, WIN32_FIND_DATAW* pFindData)
+{
+    StubHandle* pHandle = static_cast<StubHandle*>(hFindFile);
+    if (pHandle->nextEntry >= pHandle->entries.size())
+        return fail(ERROR_FILE_NOT_FOUND);
+    fillFindData(pHandle->entries[pHandle->nextEntry++], pFindData);
+    return TRUE;
+}
+
+BOOL FindClose(HANDLE hFindFile)
+{
+    delete static_cast<StubHandle*>(hFindFile);
+    return TRUE;
+}
+
+void GetSystemTimeAsFileTime(FILETIME* pSystemTimeAsFileTime)
+{
+    struct timespec now;
+    ::clock_gettime(CLOCK_REALTIME, &now);
+    *pSystemTimeAsFileTime = toFileTime(now);
+}
+
+/* Mappings ----------------------------------------------------------------- */
+
+HANDLE CreateFileMappingW(HANDLE hFile, void* pAttributes, DWORD protect, DWORD maximumSizeHigh,
+                          DWORD maximumSizeLow, const wchar_t* pName)
+{
+    const int fd = fileDescriptor(hFile);
+    if (fd < 0)
+    {
+        fail(ERROR_ACCESS_DENIED);
+        return nullptr;
+    }
+
+    const off_t maximumSize = static_cast<off_t>((static_cast<ULONGLONG>(maximumSizeHigh) << 32) | maximumSizeLow);
+    struct stat status;
+    if (maximumSize > 0 && ::fstat(fd, &status) == 0 && status.st_size < maximumSize &&
+        ::ftruncate(fd, maximumSize) != 0)
+    {
+        failFromErrno();
+        return nullptr;
+    }
+
+    StubHandle* pHandle = new StubHandle(StubHandle::kMapping);
+    pHandle->fd = fd;
+    pHandle->writable = protect == PAGE_READWRITE;
+    return pHandle;
+}
+
+void* MapViewOfFile(HANDLE hFileMappingObject, DWORD desiredAccess, DWORD fileOffsetHigh, DWORD fileOffsetLow,
+                    SIZE_T numberOfBytesToMap)
+{
+    const StubHandle* pMapping = static_cast<const StubHandle*>(hFileMappingObject);
+    const off_t offset = static_cast<off_t>((static_cast<ULONGLONG>(fileOffsetHigh) << 32) | fileOffsetLow);
+
+    size_t length = numberOfBytesToMap;
+    if (length == 0)
+    {
+        struct stat status;
+        if (::fstat(pMapping->fd, &status) != 0)
+        {
+            failFromErrno();
+            return nullptr;
+        }
+        length = static_cast<size_t>(status.st_size - offset);
+    }
+
+    const int protection = PROT_READ | (pMapping->writable ? PROT_WRITE : 0);
+    void* pView = ::mmap(nullptr, length, protection, MAP_SHARED, pMapping->fd, offset);
+    if (pView == MAP_FAILED)
+    {
+        fail(ERROR_NOT_ENOUGH_MEMORY);
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(s_viewsMutex);
+    s_views[pView] = length;
+    return pView;
+}
+
+BOOL UnmapViewOfFile(const void* pBaseAddress)
+{
+    std::lock_guard<std::mutex> lock(s_viewsMutex);
+    const auto view = s_views.find(pBaseAddress);
+    if (view == s_views.end())
+        return fail(ERROR_ACCESS_DENIED);
+    ::munmap(const_cast<void*>(pBaseAddress), view->second);
+    s_views.erase(view);
+    return TRUE;
+}
+
+BOOL FlushViewOfFile(const void* pBaseAddress, SIZE_T numberOfBytesToFlush)
+{
+    std::lock_guard<std::mutex> lock(s_viewsMutex);
+    const auto view = s_views.find(pBaseAddress);
+    if (view == s_views.end())
+        return fail(ERROR_ACCESS_DENIED);
+    return ::msync(const_cast<void*>(pBaseAddress), view->second, MS_SYNC) == 0 ? TRUE : failFromErrno();
+}
+
+BOOL PrefetchVirtualMemory(HANDLE hProcess, ULONG_PTR numberOfEntries, WIN32_MEMORY_RANGE_ENTRY* pVirtualAddresses,
+                           ULONG flags)
+{
+    for (ULONG_PTR i = 0; i < numberOfEntries; ++i)
+        ::madvise(pVirtualAddresses[i].VirtualAddress, pVirtualAddresses[i].NumberOfBytes, MADV_WILLNEED);
+    return TRUE;
+}
+
+HANDLE GetCurrentProcess()
+{
+    return nullptr;
+}
+
+/* Text --------------------------------------------------------------------- */
+
+int WideCharToMultiByte(unsigned codePage, DWORD flags, const wchar_t* pWideCharStr, int cchWideChar,
+                        char* pMultiByteStr, int cbMultiByte, const char* pDefaultChar, BOOL* pUsedDefaultChar)
+{
+    std::string result;
+    for (int i = 0; cchWideChar < 0 || i < cchWideChar; ++i)
+    {
+        const unsigned long c = static_cast<unsigned long>(pWideCharStr[i]);
+        if (c < 0x80)
+        {
+            result += static_cast<char>(c);
+        }
+        else if (c < 0x800)
+        {
+            result += static_cast<char>(0xC0 | (c >> 6));
+            result += static_cast<char>(0x80 | (c & 0x3F));
+        }
+        else if (c < 0x10000)
+        {
+            result += static_cast<char>(0xE0 | (c >> 12));
+            result += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            result += static_cast<char>(0x80 | (c & 0x3F));
+        }
+        else
+        {
+            result += static_cast<char>(0xF0 | (c >> 18));
+            result += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+            result += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            result += static_cast<char>(0x80 | (c & 0x3F));
+        }
+        if (cchWideChar < 0 && c == 0)
+            break;
+    }
+
+    if (cbMultiByte == 0)
+        return static_cast<int>(result.size());
+    if (static_cast<int>(result.size()) > cbMultiByte)
+        return 0;
+    std::memcpy(pMultiByteStr, result.data(), result.size());
+    return static_cast<int>(result.size());
+}
+
+int MultiByteToWideChar(unsigned codePage, DWORD flags, const char* pMultiByteStr, int cbMultiByte,
+                        wchar_t* pWideCharStr, int cchWideChar)
+{
+    const int length = cbMultiByte < 0 ? static_cast<int>(std::strlen(pMultiByteStr)) + 1 : cbMultiByte;
+
+    std::wstring result;
+    for (int i = 0; i < length;)
+    {
+        const unsigned char lead = static_cast<unsigned char>(pMultiByteStr[i]);
+        const int trailing = lead < 0x80 ? 0 : lead < 0xE0 ? 1 : lead < 0xF0 ? 2 : 3;
+        unsigned long c = trailing == 0 ? lead : lead & (0x3F >> trailing);
+        for (int j = 1; j <= trailing && i + j < length; ++j)
+            c = (c << 6) | (static_cast<unsigned char>(pMultiByteStr[i + j]) & 0x3F);
+        result += static_cast<wchar_t>(c);
+        i += trailing + 1;
+    }
+
+    if (cchWideChar == 0)
+        return static_cast<int>(result.size());
+    if (static_cast<int>(result.size()) > cchWideChar)
+        return 0;
+    std::wmemcpy(pWideCharStr, result.data(), result.size());
+    return static_cast<int>(result.size());
+}
+
+int _wcsicmp(const wchar_t* pString1, const wchar_t* pString2)
+{
+    for (;; ++pString1, ++pString2)
+    {
+        const wint_t c1 = std::towlower(*pString1);
+        const wint_t c2 = std::towlower(*pString2);
+        if (c1 != c2 || c1 == 0)
+            return static_cast<int>(c1) - static_cast<int>(c2);
+    }
+}
+
+/* Modules and exceptions --------------------------------------------------- */
+
+HMODULE GetModuleHandleW(const wchar_t* pModuleName)
+{
+    return nullptr;
+}
+
+void* GetProcAddress(HMODULE hModule, const char* pProcName)
+{
+    return nullptr;
+}
+
+BOOL DisableThreadLibraryCalls(HMODULE hLibModule)
+{
+    return TRUE;
+}
+
+PVOID AddVectoredExceptionHandler(ULONG first, PVECTORED_EXCEPTION_HANDLER pHandler)
+{
+    std::lock_guard<std::mutex> lock(s_exceptionHandlersMutex);
+    std::vector<PVECTORED_EXCEPTION_HANDLER>& handlers = s_exceptionHandlers;
+    handlers.insert(first != 0 ? handlers.begin() : handlers.end(), pHandler);
+    return reinterpret_cast<PVOID>(pHandler);
+}
+
+ULONG RemoveVectoredExceptionHandler(PVOID pHandle)
+{
+    std::lock_guard<std::mutex> lock(s_exceptionHandlersMutex);
+    std::vector<PVECTORED_EXCEPTION_HANDLER>& handlers = s_exceptionHandlers;
+    for (auto it = handlers.begin(); it != handlers.end(); ++it)
+    {
+        if (reinterpret_cast<PVOID>(*it) == pHandle)
+        {
+            handlers.erase(it);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void RaiseException(DWORD exceptionCode, DWORD exceptionFlags, DWORD numberOfArguments, const ULONG_PTR* pArguments)
+{
+    std::vector<PVECTORED_EXCEPTION_HANDLER> handlers;
+    {
+        std::lock_guard<std::mutex> lock(s_exceptionHandlersMutex);
+        handlers = s_exceptionHandlers;
+    }
+    EXCEPTION_RECORD record = {exceptionCode, exceptionFlags};
+    _EXCEPTION_POINTERS pointers = {&record, nullptr};
+    for (PVECTORED_EXCEPTION_HANDLER pHandler : handlers)
+    {
+        if (pHandler(&pointers) != EXCEPTION_CONTINUE_SEARCH)
+            break;
+    }
+}
@@ -0,0 +1,221 @@
+#pragma once
+
+/*
+ * The parts of windows.h the modules use, for building them where there is
+ * no Windows SDK.  Win32.cpp implements the functions over POSIX: files are
+ * file descriptors, mappings are mmap views, and errors are the Win32 codes
+ * the modules look for.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cwchar>
+
+#define __declspec(x)
+#define __stdcall
+#define APIENTRY
+#define NTAPI
+
+typedef unsigned long DWORD;
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef long LONG;
+typedef unsigned long ULONG;
+typedef long long LONGLONG;
+typedef unsigned long long ULONGLONG;
+typedef uintptr_t ULONG_PTR;
+typedef size_t SIZE_T;
+typedef void* PVOID;
+typedef void* LPVOID;
+typedef void* HANDLE;
+typedef void* HINSTANCE;
+typedef void* HMODULE;
+
+union LARGE_INTEGER
+{
+    struct
+    {
+        DWORD LowPart;
+        LONG HighPart;
+    };
+    LONGLONG QuadPart;
+};
+
+struct FILETIME
+{
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+};
+
+struct OVERLAPPED
+{
+    ULONG_PTR Internal;
+    ULONG_PTR InternalHigh;
+    DWORD Offset;
+    DWORD OffsetHigh;
+    HANDLE hEvent;
+};
+
+struct WIN32_FILE_ATTRIBUTE_DATA
+{
+    DWORD dwFileAttributes;
+    FILETIME ftCreationTime;
+    FILETIME ftLastAccessTime;
+    FILETIME ftLastWriteTime;
+    DWORD nFileSizeHigh;
+    DWORD nFileSizeLow;
+};
+
+struct WIN32_FIND_DATAW
+{
+    DWORD dwFileAttributes;
+    FILETIME ftCreationTime;
+    FILETIME ftLastAccessTime;
+    FILETIME ftLastWriteTime;
+    DWORD nFileSizeHigh;
+    DWORD nFileSizeLow;
+    wchar_t cFileName[260];
+};
+
+struct WIN32_MEMORY_RANGE_ENTRY
+{
+    PVOID VirtualAddress;
+    SIZE_T NumberOfBytes;
+};
+
+enum GET_FILEEX_INFO_LEVELS
+{
+    GetFileExInfoStandard
+};
+
+#define TRUE 1
+#define FALSE 0
+#define INFINITE 0xFFFFFFFF
+#define MAXDWORD 0xFFFFFFFF
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+#define DLL_PROCESS_ATTACH 1
+#define CP_UTF8 65001
+
+#define ERROR_SUCCESS 0
+#define ERROR_FILE_NOT_FOUND 2
+#define ERROR_PATH_NOT_FOUND 3
+#define ERROR_ACCESS_DENIED 5
+#define ERROR_NOT_ENOUGH_MEMORY 8
+#define ERROR_OUTOFMEMORY 14
+#define ERROR_WRITE_PROTECT 19
+#define ERROR_WRITE_FAULT 29
+#define ERROR_SHARING_VIOLATION 32
+#define ERROR_LOCK_VIOLATION 33
+#define ERROR_HANDLE_EOF 38
+#define ERROR_HANDLE_DISK_FULL 39
+#define ERROR_ALREADY_EXISTS 183
+#define ERROR_DISK_FULL 112
+#define ERROR_COMMITMENT_LIMIT 1455
+
+#define GENERIC_READ 0x80000000
+#define GENERIC_WRITE 0x40000000
+#define FILE_WRITE_DATA 0x0002
+#define FILE_APPEND_DATA 0x0004
+#define FILE_WRITE_ATTRIBUTES 0x0100
+#define FILE_SHARE_READ 0x1
+#define FILE_SHARE_WRITE 0x2
+#define FILE_SHARE_DELETE 0x4
+#define CREATE_ALWAYS 2
+#define OPEN_EXISTING 3
+#define OPEN_ALWAYS 4
+#define FILE_ATTRIBUTE_DIRECTORY 0x10
+#define FILE_ATTRIBUTE_NORMAL 0x80
+#define FILE_FLAG_WRITE_THROUGH 0x80000000
+#define FILE_FLAG_RANDOM_ACCESS 0x10000000
+#define FILE_FLAG_SEQUENTIAL_SCAN 0x08000000
+#define FILE_BEGIN 0
+#define FILE_CURRENT 1
+#define FILE_END 2
+#define PAGE_READONLY 0x02
+#define PAGE_READWRITE 0x04
+#define FILE_MAP_WRITE 0x0002
+#define FILE_MAP_READ 0x0004
+#define MOVEFILE_REPLACE_EXISTING 0x1
+#define MOVEFILE_WRITE_THROUGH 0x8
+
+DWORD GetLastError();
+
+HANDLE CreateFileW(const wchar_t* pFileName, DWORD desiredAccess, DWORD shareMode, void* pSecurityAttributes,
+                   DWORD creationDisposition, DWORD flagsAndAttributes, HANDLE hTemplateFile);
+BOOL CloseHandle(HANDLE hObject);
+BOOL WriteFile(HANDLE hFile, const void* pBuffer, DWORD bytesToWrite, DWORD* pBytesWritten, OVERLAPPED* pOverlapped);
+BOOL ReadFile(HANDLE hFile, void* pBuffer, DWORD bytesToRead, DWORD* pBytesRead, OVERLAPPED* pOverlapped);
+BOOL FlushFileBuffers(HANDLE hFile);
+BOOL GetFileSizeEx(HANDLE hFile, LARGE_INTEGER* pFileSize);
+BOOL SetFilePointerEx(HANDLE hFile, LARGE_INTEGER distance, LARGE_INTEGER* pNewPointer, DWORD moveMethod);
+BOOL SetEndOfFile(HANDLE hFile);
+BOOL SetFileTime(HANDLE hFile, const FILETIME* pCreationTime, const FILETIME* pLastAccessTime,
+                 const FILETIME* pLastWriteTime);
+BOOL MoveFileExW(const wchar_t* pExistingFileName, const wchar_t* pNewFileName, DWORD flags);
+BOOL DeleteFileW(const wchar_t* pFileName);
+BOOL GetFileAttributesExW(const wchar_t* pFileName, GET_FILEEX_INFO_LEVELS infoLevel, void* pFileInformation);
+HANDLE FindFirstFileW(const wchar_t* pFileName, WIN32_FIND_DATAW* pFindData);
+BOOL FindNextFileW(HANDLE hFindFile, WIN32_FIND_DATAW* pFindData);
+BOOL FindClose(HANDLE hFindFile);
+void GetSystemTimeAsFileTime(FILETIME* pSystemTimeAsFileTime);
+
+HANDLE CreateFileMappingW(HANDLE hFile, void* pAttributes, DWORD protect, DWORD maximumSizeHigh,
+                          DWORD maximumSizeLow, const wchar_t* pName);
+void* MapViewOfFile(HANDLE hFileMappingObject, DWORD desiredAccess, DWORD fileOffsetHigh, DWORD fileOffsetLow,
+                    SIZE_T numberOfBytesToMap);
+BOOL UnmapViewOfFile(const void* pBaseAddress);
+BOOL FlushViewOfFile(const void* pBaseAddress, SIZE_T numberOfBytesToFlush);
+BOOL PrefetchVirtualMemory(HANDLE hProcess, ULONG_PTR numberOfEntries, WIN32_MEMORY_RANGE_ENTRY* pVirtualAddresses,
+                           ULONG flags);
+HANDLE GetCurrentProcess();
+
+int WideCharToMultiByte(unsigned codePage, DWORD flags, const wchar_t* pWideCharStr, int cchWideChar,
+                        char* pMultiByteStr, int cbMultiByte, const char* pDefaultChar, BOOL* pUsedDefaultChar);
+int MultiByteToWideChar(unsigned codePage, DWORD flags, const char* pMultiByteStr, int cbMultiByte,
+                        wchar_t* pWideCharStr, int cchWideChar);
+int _wcsicmp(const wchar_t* pString1, const wchar_t* pString2);
+
+HMODULE GetModuleHandleW(const wchar_t* pModuleName);
+void* GetProcAddress(HMODULE hModule, const char* pProcName);
+BOOL DisableThreadLibraryCalls(HMODULE hLibModule);
+
+/* Structured exceptions ---------------------------------------------------- */
+
+struct EXCEPTION_RECORD
+{
+    DWORD ExceptionCode;
+    DWORD ExceptionFlags;
+};
+
+struct _EXCEPTION_POINTERS
+{
+    EXCEPTION_RECORD* ExceptionRecord;
+    void* ContextRecord;
+};
+
+typedef _EXCEPTION_POINTERS* PEXCEPTION_POINTERS;
+typedef LONG (*PVECTORED_EXCEPTION_HANDLER)(PEXCEPTION_POINTERS pExceptionInfo);
+
+#define EXCEPTION_CONTINUE_SEARCH 0
+#define EXCEPTION_NONCONTINUABLE 0x1
+#define EXCEPTION_ACCESS_VIOLATION 0xC0000005u
+#define EXCEPTION_IN_PAGE_ERROR 0xC0000006u
+#define EXCEPTION_ILLEGAL_INSTRUCTION 0xC000001Du
+#define EXCEPTION_INT_DIVIDE_BY_ZERO 0xC0000094u
+#define EXCEPTION_PRIV_INSTRUCTION 0xC0000096u
+#define EXCEPTION_STACK_OVERFLOW 0xC00000FDu
+#define STATUS_HEAP_CORRUPTION 0xC0000374u
+
+/// <summary>
+/// Keeps the handler for RaiseException to call.
+/// </summary>
+PVOID AddVectoredExceptionHandler(ULONG first, PVECTORED_EXCEPTION_HANDLER pHandler);
+ULONG RemoveVectoredExceptionHandler(PVOID pHandle);
+
+/// <summary>
+/// Calls the vectored handlers with the exception, first added first, and
+/// returns as if the caller's own __except block had handled it.  Nothing
+/// here can really fault, so this is the only way a handler runs.
+/// </summary>
+void RaiseException(DWORD exceptionCode, DWORD exceptionFlags, DWORD numberOfArguments, const ULONG_PTR* pArguments);
@@ -55,6 +55,12 @@ namespace acad_sheetset_to_pdf
 
             [Option(Required = true, HelpText = "The path of the pdf file to be generated.")]
             public String OutputPdfFile { get; set; }
+
+            [Option(Required = false, HelpText = "The path of the acad-sheetset-to-pdf-arx module to load into AutoCAD. Defaults to the one next to this executable.")]
+            public String ArxFile { get; set; }
+
+            [Option(Required = false, Default = false, HelpText = "Cache the graphics of blocks and xrefs in a folder per user, so that publishing the same blocks again reads them back. Off unless given.")]
+            public bool CacheBlockGraphics { get; set; }
         }
 
 
@@ -117,6 +123,9 @@ namespace acad_sheetset_to_pdf
             String baseName = System.IO.Path.GetTempFileName();
             String nameOfTheTemporaryDsdFile = baseName + ".dsd";
             String nameOfTheTemporaryPlotLogFile = baseName + "-plot" +  ".log";
+            String nameOfThePlotLogFile = baseName + "-plot" + ".jsonl";
+            String nameOfTheTelemetryJsonFile = baseName + "-telemetry" + ".json";
+            String nameOfTheTelemetryPrometheusFile = baseName + "-telemetry" + ".prom";
 
             //TO DO: compose a help message.
 
@@ -262,12 +271,10 @@ namespace acad_sheetset_to_pdf
             Console.WriteLine("pathOfDwgFileContainingThePageSetup: " + pathOfDwgFileContainingThePageSetup);
             Console.WriteLine("nameOfThePageSetup: " + nameOfThePageSetup);
 
-            string dsdContent = "";
-            dsdContent +=
-                "[DWF6Version]" + "\r\n" +
-                "Ver=1" + "\r\n" +
-                "[DWF6MinorVersion]" + "\r\n" +
-                "MinorVer=1" + "\r\n";
+            /* The [DWF6Sheet] section of every sheet, and what identifies the
+             sheet to the publish journal, in publishing order. */
+            List<string> sheetSections = new List<string>();
+            List<string> sheetIds = new List<string>();
 
             IAcSmEnumComponent myAcSmEnumComponent = sheetSet.GetSheetEnumerator();
             IAcSmComponent thisAcSmComponent;
@@ -281,21 +288,33 @@ namespace acad_sheetset_to_pdf
                 Console.WriteLine("thisSheet.GetLayout().ResolveFileName(): " + thisSheet.GetLayout().ResolveFileName());       //                 thisSheet.GetLayout().ResolveFileName()
                 Console.WriteLine("thisSheet.GetLayout().GetFileName(): " + thisSheet.GetLayout().GetFileName());		//                 thisSheet.GetLayout().GetFileName()
 
-                dsdContent +=
+                sheetSections.Add(
                     "[DWF6Sheet:" + thisSheet.GetName() + "]" + "\r\n" +
                     "DWG=" + thisSheet.GetLayout().ResolveFileName() + "\r\n" +
                     "Layout=" + thisSheet.GetLayout().GetName() + "\r\n" +
                     "Setup=" + nameOfThePageSetup + "|" + pathOfDwgFileContainingThePageSetup + "\r\n" +
                     "OriginalSheetPath=" + thisSheet.GetLayout().ResolveFileName() + "\r\n" +
                     "Has Plot Port=" + "0" + "\r\n" + 
-                    "Has3DDWF=" + "0" + "\r\n";
+                    "Has3DDWF=" + "0" + "\r\n"
+                );
+                sheetIds.Add(thisSheet.GetLayout().ResolveFileName() + "|" + thisSheet.GetLayout().GetName());
             }
 
-            dsdContent +=
+            /* A dsd file publishing the given sheet sections.  Target type 6
+             is a single multi-sheet pdf file, written to targetFile; type 5
+             is a pdf file per sheet, written into outputDirectory. */
+            string ComposeDsd(IEnumerable<string> sections, int targetType, string targetFile, string outputDirectory)
+            {
+                return
+                "[DWF6Version]" + "\r\n" +
+                "Ver=1" + "\r\n" +
+                "[DWF6MinorVersion]" + "\r\n" +
+                "MinorVer=1" + "\r\n" +
+                String.Concat(sections) +
                 "[Target]" + "\r\n" +
-                "Type=6" + "\r\n" +
-                "DWF=" + nameOfPdfOutputFile + "\r\n" +
-                "OUT=" + System.IO.Path.GetDirectoryName(nameOfPdfOutputFile) /*+ System.IO.Path.DirectorySeparatorChar*/ + "\r\n" + 
+                "Type=" + targetType + "\r\n" +
+                "DWF=" + targetFile + "\r\n" +
+                "OUT=" + outputDirectory /*+ System.IO.Path.DirectorySeparatorChar*/ + "\r\n" + 
                 "PWD=" + "" + "\r\n" +
                 "[PdfOptions]" + "\r\n" +
                 "IncludeHyperlinks=FALSE" + "\r\n" +
@@ -331,19 +350,138 @@ namespace acad_sheetset_to_pdf
                 "PublishSheetMetadata=FALSE" + "\r\n" +
                 "3DDWFOptions=0 0" + "\r\n" + "\r\n" +
                 "";
+            }
 
-            System.IO.File.WriteAllText(path: nameOfTheTemporaryDsdFile, contents: dsdContent);
-
-            Console.WriteLine(nameOfTheTemporaryDsdFile);
- 
             if (sheetdb.GetLockStatus() != 0){ sheetdb.UnlockDb(sheetdb);}
+
+            /* The ObjectARX module registers the reactors and commands that
+             have to run inside AutoCAD. Publishing works without it, just
+             without what it adds, so a missing module is not an error. */
+            String pathOfArxFile = commandLineOptions.ArxFile ?? Path.Combine(
+                AppDomain.CurrentDomain.BaseDirectory,
+                "acad-sheetset-to-pdf-arx.arx"
+            );
+            bool arxLoaded = File.Exists(pathOfArxFile);
+            if (arxLoaded)
+            {
+                Console.WriteLine("loading " + pathOfArxFile);
+                acad.LoadArx(pathOfArxFile);
+            }
+            else
+            {
+                Console.WriteLine("not loading the ObjectARX module, because " + pathOfArxFile + " does not exist.");
+            }
+
             IAcadDocument workingDocument = acad.Documents.Add();
             while (acad.GetAcadState().IsQuiescent == false)
             {
                 Console.WriteLine("waiting for autoCAD to become quiescent.");
             }
             workingDocument.SetVariable("FILEDIA", 0);
-            workingDocument.SendCommand("-PUBLISH" + "\n" + nameOfTheTemporaryDsdFile + "\n");
+            if (arxLoaded)
+            {
+                workingDocument.SendCommand("SHEETSETTOPDFTELEMETRY" + "\n" + nameOfTheTelemetryJsonFile + "\n" + nameOfTheTelemetryPrometheusFile + "\n");
+                Console.WriteLine("plot telemetry will be written to " + nameOfTheTelemetryJsonFile + " and " + nameOfTheTelemetryPrometheusFile);
+                workingDocument.SendCommand("SHEETSETTOPDFPLOTLOG" + "\n" + nameOfThePlotLogFile + "\n");
+                Console.WriteLine("plots will be logged to " + nameOfThePlotLogFile);
+
+                /* Block and xref graphics are cached per user, so that
+                 publishing a set again, or another set using the same
+                 xrefs, reads them back instead of generating them.  Only
+                 on request: the cache has not been timed on a real publish
+                 yet, and a publish without it plots exactly as AutoCAD
+                 alone would. */
+                if (commandLineOptions.CacheBlockGraphics)
+                {
+                    String nameOfTheBlockCacheDirectory = Path.Combine(
+                        Environment.GetFolderPath(Environment.SpecialFolder.LocalApplicationData),
+                        "acad-sheetset-to-pdf",
+                        "draw-streams"
+                    );
+                    Directory.CreateDirectory(nameOfTheBlockCacheDirectory);
+                    workingDocument.SendCommand("SHEETSETTOPDFBLOCKCACHE" + "\n" + nameOfTheBlockCacheDirectory + "\n");
+                    Console.WriteLine("block graphics will be cached in " + nameOfTheBlockCacheDirectory);
+                }
+            }
+
+            /* With the module loaded, every sheet is published to a pdf file
+             of its own and journaled as it is finished, and the files are
+             merged into the output at the end.  A run that dies part way is
+             picked up by running it again: the journal, the sheet files and
+             the list of sheets stay next to the output, and only the sheets
+             the journal does not have are published again.  They are removed
+             once the output has been assembled.  Plotting in the foreground
+             keeps the sheets in the order the journal expects them. */
+            bool publishedThroughTheJournal = false;
+            if (arxLoaded)
+            {
+                String nameOfTheJournalFile = nameOfPdfOutputFile + ".journal";
+                String nameOfTheSheetListFile = nameOfTheJournalFile + ".sheets";
+                String nameOfThePendingSheetsFile = nameOfTheJournalFile + ".pending";
+                String nameOfTheSheetDirectory = nameOfPdfOutputFile + ".sheets";
+                DateTime publishStarted = DateTime.Now;
+
+                Directory.CreateDirectory(nameOfTheSheetDirectory);
+                File.WriteAllLines(nameOfTheSheetListFile, sheetIds);
+                File.Delete(nameOfThePendingSheetsFile);
+                workingDocument.SetVariable("BACKGROUNDPLOT", 0);
+                workingDocument.SendCommand("SHEETSETTOPDFJOURNAL" + "\n" + nameOfTheJournalFile + "\n" + nameOfTheSheetListFile + "\n" + nameOfPdfOutputFile + "\n");
+                while (acad.GetAcadState().IsQuiescent == false)
+                {
+                    Console.WriteLine("waiting for autoCAD to become quiescent.");
+                }
+
+                if (File.Exists(nameOfThePendingSheetsFile))
+                {
+                    List<int> pendingSheets = File.ReadAllLines(nameOfThePendingSheetsFile)
+                        .Where(line => line.Length > 0)
+                        .Select(int.Parse)
+                        .ToList();
+                    Console.WriteLine((sheetIds.Count - pendingSheets.Count) + " of " + sheetIds.Count + " sheets were published by an earlier run; publishing " + pendingSheets.Count + ".");
+                    if (pendingSheets.Count > 0)
+                    {
+                        System.IO.File.WriteAllText(
+                            path: nameOfTheTemporaryDsdFile,
+                            contents: ComposeDsd(pendingSheets.Select(i => sheetSections[i]), 5, nameOfPdfOutputFile, nameOfTheSheetDirectory)
+                        );
+                        Console.WriteLine(nameOfTheTemporaryDsdFile);
+                        workingDocument.SendCommand("-PUBLISH" + "\n" + nameOfTheTemporaryDsdFile + "\n");
+                        while (acad.GetAcadState().IsQuiescent == false)
+                        {
+                            Console.WriteLine("waiting for autoCAD to become quiescent.");
+                        }
+                    }
+                    workingDocument.SendCommand("SHEETSETTOPDFASSEMBLE" + "\n");
+                    workingDocument.SendCommand("SHEETSETTOPDFJOURNAL" + "\n" + "\n");
+                    publishedThroughTheJournal = true;
+
+                    if (File.Exists(nameOfPdfOutputFile) && File.GetLastWriteTime(nameOfPdfOutputFile) >= publishStarted)
+                    {
+                        Directory.Delete(nameOfTheSheetDirectory, recursive: true);
+                        foreach (String path in new[] { nameOfTheJournalFile, nameOfTheSheetListFile, nameOfThePendingSheetsFile })
+                        {
+                            File.Delete(path);
+                        }
+                    }
+                    else
+                    {
+                        Console.WriteLine("the sheets were not all published; run again to publish the rest.");
+                    }
+                }
+                else
+                {
+                    Console.WriteLine("could not open the publish journal " + nameOfTheJournalFile + "; publishing the sheet set in one piece.");
+                }
+            }
+            if (!publishedThroughTheJournal)
+            {
+                System.IO.File.WriteAllText(
+                    path: nameOfTheTemporaryDsdFile,
+                    contents: ComposeDsd(sheetSections, 6, nameOfPdfOutputFile, System.IO.Path.GetDirectoryName(nameOfPdfOutputFile))
+                );
+                Console.WriteLine(nameOfTheTemporaryDsdFile);
+                workingDocument.SendCommand("-PUBLISH" + "\n" + nameOfTheTemporaryDsdFile + "\n");
+            }
             
 
             try